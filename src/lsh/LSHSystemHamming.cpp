@@ -20,17 +20,50 @@
  */
 
 #include "LSHSystemHamming.h"
-#include "Random.h"
 #include <iostream>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #include <assert.h>
 
+/**
+ * bit counting on 64 bit words.
+ */
+#ifdef __GNUC__
+#define lsh_ctz64(x) __builtin_ctzll(x)
+#define lsh_popcount64(x) __builtin_popcountll(x)
+#else
+static int lsh_ctz64(uint64_t x)
+{
+  int n = 0;
+  while (!(x & 1))
+    {
+      x >>= 1;
+      n++;
+    }
+  return n;
+}
+
+static int lsh_popcount64(uint64_t x)
+{
+  int n = 0;
+  while (x)
+    {
+      x &= x - 1;
+      n++;
+    }
+  return n;
+}
+#endif
+
 namespace lsh
 {
 
+  std::map<unsigned long int,LSHSystemHamming*> LSHSystemHamming::_shared;
+  pthread_mutex_t LSHSystemHamming::_shared_mutex = PTHREAD_MUTEX_INITIALIZER;
+
   LSHSystemHamming::LSHSystemHamming(const unsigned int &k, const unsigned int &L)
-      :LSHSystem(k,L),_g(NULL),_controlHash(NULL),_mainHash(NULL),_initialized(false)
+      :LSHSystem(k,L),_g(NULL),_gwords(NULL),_controlHash(NULL),_mainHash(NULL),_initialized(false)
   {
     _smpl_bits = LSHSystemHamming::_char_bit * _k;
     initLSHSystemHamming();
@@ -48,9 +81,28 @@ namespace lsh
         delete[] _controlHash;
         delete[] _mainHash;
         delete[] _g;
+        delete[] _gwords;
       }
   }
 
+  const LSHSystemHamming* LSHSystemHamming::getShared(const unsigned int &k, const unsigned int &L)
+  {
+    unsigned long int key = (static_cast<unsigned long int> (k) << 16) | L;
+    LSHSystemHamming *lsh_h = NULL;
+
+    pthread_mutex_lock(&LSHSystemHamming::_shared_mutex);
+    std::map<unsigned long int,LSHSystemHamming*>::const_iterator mit;
+    if ((mit = LSHSystemHamming::_shared.find(key)) != LSHSystemHamming::_shared.end())
+      lsh_h = (*mit).second;
+    else
+      {
+        lsh_h = new LSHSystemHamming(k,L);
+        LSHSystemHamming::_shared.insert(std::pair<unsigned long int,LSHSystemHamming*>(key,lsh_h));
+      }
+    pthread_mutex_unlock(&LSHSystemHamming::_shared_mutex);
+    return lsh_h;
+  }
+
   void LSHSystemHamming::initHashingFunctionsFactors ()
   {
     unsigned int nk = LSHSystemHamming::_total_bits;
@@ -61,17 +113,17 @@ namespace lsh
 
         /**
          * we use two different seeds.
+         * Factors are only ever used modulo the hashing prime.
          */
-        unsigned int seed_control = 907452457;
-        unsigned int seed_main = 918747475;
-
-        srandom (seed_control);
+        RandomGenerator rng_control(907452457);
         for (unsigned int k=0; k<nk; k++)
-          _controlHash[l][k] = Random::genUniformUnsInt32 (1, LSHSystem::_max_hash_rnd);
+          _controlHash[l][k] = rng_control.genUniformUnsInt32 (1, LSHSystem::_max_hash_rnd)
+                               % LSHSystem::_control_hash_prime_bits;
 
-        srandom (seed_main);
+        RandomGenerator rng_main(918747475);
         for (unsigned int k=0; k<nk; k++)
-          _mainHash[l][k] = Random::genUniformUnsInt32 (1, LSHSystem::_max_hash_rnd);
+          _mainHash[l][k] = rng_main.genUniformUnsInt32 (1, LSHSystem::_max_hash_rnd)
+                            % LSHSystem::_control_hash_prime_bits;
       }
   }
 
@@ -80,45 +132,31 @@ namespace lsh
     /**
      * Init static dynamic structures.
      */
-    if (_controlHash) delete[] _controlHash;
-    if (_mainHash) delete[] _mainHash;
-    for (unsigned int l=0; l<_Ld; l++)
+    if (static_cast<unsigned int> (CHAR_BIT) != LSHSystemHamming::_char_bit)
       {
-        if (_controlHash)
-          delete[] _controlHash[l];
-        if (_mainHash)
-          delete[] _mainHash[l];
+        std::cout << "[Error]: system CHAR_BIT is different than 8, see your compiler settings\
+		       or wait til we get a proper conversion scheme ready. Exiting.\n";
+        exit (-1);
       }
 
-    if (_g) delete[] _g;
-
     _controlHash = new unsigned long int*[_Ld];
     _mainHash = new unsigned long int*[_Ld];
     _g = new std::bitset<_total_bits> [_Ld];
+    _gwords = new uint64_t[_Ld * LSHSystemHamming::_total_words];
 
     /**
      * Init the local dispersion sampling parameter.
      */
     _smpl_bits = LSHSystemHamming::_char_bit * _k;
 
-    /**
-     * Init the L g functions using a random bits generator.
-     * We need each g as an array of CHAR_BIT * k bits.
-     */
-    if (static_cast<unsigned int> (CHAR_BIT) != LSHSystemHamming::_char_bit)
-      {
-        std::cout << "[Error]: system CHAR_BIT is different than 8, see your compiler settings\
-		       or wait til we get a proper conversion scheme ready. Exiting.\n";
-        exit (-1);
-      }
-
     /**
      * Initialize the sampling functions:
      * keep the same seed along the whole generation process, so to get the same numbers
-     * on all machines.
+     * on all machines. The generator is private to this system, so that concurrent
+     * constructions do not interfere.
      */
-    srandom (Random::getRbitsSeed ());  /* reseed. */
-    initG ();
+    RandomGenerator rng(Random::getRbitsSeed ());
+    initG (rng);
 
     /**
      * Initialize the hashing functions factors.
@@ -128,7 +166,7 @@ namespace lsh
     _initialized = true;
   }
 
-  void LSHSystemHamming::initG ()
+  void LSHSystemHamming::initG (RandomGenerator &rng)
   {
     for (unsigned int l=0; l<_Ld; l++)
       {
@@ -140,7 +178,7 @@ namespace lsh
         unsigned int k=0;
         while (k < _smpl_bits)
           {
-            unsigned long int r_pos = Random::genUniformUnsInt32 (0, _total_bits-2);
+            unsigned long int r_pos = rng.genUniformUnsInt32 (0, _total_bits-2);
             if (! _g[l].test(r_pos+1))
               {
                 _g[l].flip (r_pos+1);
@@ -148,13 +186,24 @@ namespace lsh
               }
           }
 
+        /**
+         * same sampling function, as words.
+         */
+        uint64_t *gw = _gwords + l * LSHSystemHamming::_total_words;
+        memset(gw, 0, LSHSystemHamming::_total_words * sizeof(uint64_t));
+        for (unsigned int i=0; i<_total_bits; i++)
+          {
+            if (_g[l].test(i))
+              gw[i / 64] |= static_cast<uint64_t> (1) << (i % 64);
+          }
+
         //debug
         //std::cout << "g[" << l << "]: " << _g[l] << std::endl;
         //debug
       }
   }
 
-  unsigned int LSHSystemHamming::getG (const int &l, const int &k)
+  unsigned int LSHSystemHamming::getG (const int &l, const int &k) const
   {
     return static_cast<unsigned int> (getG (l)[k]);
   }
@@ -172,7 +221,7 @@ namespace lsh
       }
   }
 
-  void LSHSystemHamming::strToBits (const std::string &str, std::bitset<_total_bits> &bb_str)
+  void LSHSystemHamming::strToBits (const std::string &str, std::bitset<_total_bits> &bb_str) const
   {
     /**
      * take the string's first fixed_str_size characters and turn them into bits.
@@ -203,9 +252,25 @@ namespace lsh
     //debug
   }
 
+  void LSHSystemHamming::strToWords (const std::string &str, uint64_t *words)
+  {
+    /**
+     * bit m of character i is bit i*8+m of the string, as with strToBits,
+     * and strings are filled up with spaces.
+     */
+    memset(words, 0, LSHSystemHamming::_total_words * sizeof(uint64_t));
+    const size_t len = str.length ();
+    const char *str_ptr = str.data ();
+    for (unsigned int i=0; i<_fixed_str_size; i++)
+      {
+        unsigned char c = i < len ? static_cast<unsigned char> (str_ptr[i]) : ' ';
+        words[i / 8] |= static_cast<uint64_t> (c) << (8 * (i % 8));
+      }
+  }
+
   void LSHSystemHamming::LprojectStr (const std::bitset<_total_bits> &bb_str,
                                       const unsigned int L,
-                                      std::bitset<_total_bits> *bb_hash)
+                                      std::bitset<_total_bits> *bb_hash) const
   {
     /**
      * This simply is a bit-by-bit logical AND between each g function and
@@ -221,9 +286,9 @@ namespace lsh
       }
   }
 
-  unsigned long int LSHSystemHamming::bitHash (std::bitset<_total_bits> &bb,
+  unsigned long int LSHSystemHamming::bitHash (const std::bitset<_total_bits> &bb,
       unsigned long int **hash_params,
-      const unsigned int &l)
+      const unsigned int &l) const
   {
     unsigned long int r = 0;
     for (unsigned int i=0; i<bb.size (); i++)
@@ -234,8 +299,26 @@ namespace lsh
     return r;
   }
 
-  unsigned long int LSHSystemHamming::controlHash (std::bitset<_total_bits> &bb,
-      const unsigned int &l)
+  unsigned long int LSHSystemHamming::wordHash (const uint64_t *words,
+      const unsigned long int *factors,
+      const unsigned int &l) const
+  {
+    const uint64_t *gw = _gwords + l * LSHSystemHamming::_total_words;
+    unsigned long int r = 0;
+    for (unsigned int w=0; w<LSHSystemHamming::_total_words; w++)
+      {
+        uint64_t bits = gw[w] & words[w];
+        while (bits)
+          {
+            r += factors[w * 64 + lsh_ctz64(bits)];
+            bits &= bits - 1;
+          }
+      }
+    return r;
+  }
+
+  unsigned long int LSHSystemHamming::controlHash (const std::bitset<_total_bits> &bb,
+      const unsigned int &l) const
   {
     unsigned long int r = bitHash (bb, _controlHash, l);
 
@@ -246,8 +329,8 @@ namespace lsh
     return r;
   }
 
-  void LSHSystemHamming::LcontrolHash (std::bitset<_total_bits> *bb,
-                                       unsigned long int *Lchashes)
+  void LSHSystemHamming::LcontrolHash (const std::bitset<_total_bits> *bb,
+                                       unsigned long int *Lchashes) const
   {
     for (unsigned int l=0; l<_Ld; l++)
       {
@@ -255,9 +338,9 @@ namespace lsh
       }
   }
 
-  unsigned long int LSHSystemHamming::mainHash (std::bitset<_total_bits> &bb,
+  unsigned long int LSHSystemHamming::mainHash (const std::bitset<_total_bits> &bb,
       const unsigned int &l,
-      const unsigned long int &hsize)
+      const unsigned long int &hsize) const
   {
     unsigned long int r = bitHash (bb, _mainHash, l) % hsize;
 
@@ -268,9 +351,9 @@ namespace lsh
     return r;
   }
 
-  void LSHSystemHamming::LmainHash (std::bitset<_total_bits> *bb,
+  void LSHSystemHamming::LmainHash (const std::bitset<_total_bits> *bb,
                                     const unsigned long int &hsize,
-                                    unsigned long int *Lmhashes)
+                                    unsigned long int *Lmhashes) const
   {
     for (unsigned int l=0; l<_Ld; l++)
       {
@@ -278,97 +361,69 @@ namespace lsh
       }
   }
 
-  void LSHSystemHamming::LmainKeyFromStr(std::string str,
+  void LSHSystemHamming::LmainKeyFromStr(const std::string &str,
                                          unsigned long int *Lmkeys,
-                                         const unsigned int &uhsize)
+                                         const unsigned int &uhsize) const
   {
-    std::bitset<_total_bits> bb_str;
-    strToBits (str, bb_str);
-
-    //debug
-    /* std::cout << "[Debug]:LSHUniformHashTableHamming::LcomputeMKey: bit conversion:\n"
-       << bb_str << std::endl; */
-    //debug
-
-    std::bitset<_total_bits> *bb_hash
-    = new std::bitset<_total_bits> [_Ld];
-
-    LprojectStr (bb_str, _Ld, bb_hash);
-
-    LmainHash (bb_hash, uhsize, Lmkeys);
-
-    //debug
-    /* std::cout << "[Debug]:LSHUniformHashTableHamming::LcomputeMKey: L bit keys:\n";
-       for (unsigned int l=0; l<_Ld; l++)
-       std::cout << Lmkeys[l] << std::endl; */
-    //debug
-
-    delete []bb_hash;
+    uint64_t words[LSHSystemHamming::_total_words];
+    strToWords (str, words);
+    for (unsigned int l=0; l<_Ld; l++)
+      Lmkeys[l] = wordHash (words, _mainHash[l], l) % uhsize;
   }
 
-  void LSHSystemHamming::LcontrolKeyFromStr(std::string str,
-      unsigned long int *Lckeys)
+  void LSHSystemHamming::LcontrolKeyFromStr(const std::string &str,
+      unsigned long int *Lckeys) const
   {
-    std::bitset<_total_bits> bb_str;
-    strToBits (str, bb_str);
-
-    //debug
-    /*  std::cout << "[Debug]:LSHUniformHashTableHamming::LcomputeCKey: bit conversion:\n"
-        << bb_str << std::endl; */
-    //debug
-
-    std::bitset<_total_bits> *bb_hash
-    = new std::bitset<_total_bits> [_Ld];
-
-    LprojectStr (bb_str, _Ld, bb_hash);
-
-    LcontrolHash (bb_hash, Lckeys);
-
-    //debug
-    /* std::cout << "[Debug]:LSHUniformHashTableHamming::LcomputeCKey: L bit keys:\n";
-       for (unsigned int l=0; l<_Ld; l++)
-       std::cout << Lmkeys[l] << std::endl; */
-    //debug
-
-    delete []bb_hash;
+    uint64_t words[LSHSystemHamming::_total_words];
+    strToWords (str, words);
+    for (unsigned int l=0; l<_Ld; l++)
+      Lckeys[l] = wordHash (words, _controlHash[l], l);
   }
 
-  void LSHSystemHamming::LKeysFromStr(std::string str,
+  void LSHSystemHamming::LKeysFromStr(const std::string &str,
                                       unsigned long int *Lmkeys,
                                       unsigned long int *Lckeys,
-                                      const unsigned int &uhsize)
+                                      const unsigned int &uhsize) const
   {
     /**
-     * turn the string into bits and projects onto the k planes.
-     */
-    std::bitset<_total_bits> bb_str;
-    strToBits (str, bb_str);
-    std::bitset<_total_bits> *bb_hash
-    = new std::bitset<_total_bits> [_Ld];
-    LprojectStr (bb_str, _Ld, bb_hash);
-
-    /**
-     * compute main key.
+     * turn the string into words, and compute both keys of each
+     * projection in a single pass over its bits.
      */
-    LmainHash (bb_hash, uhsize, Lmkeys);
-
-    /**
-     * compute control key.
-     */
-    LcontrolHash (bb_hash, Lckeys);
-
-    delete []bb_hash;
+    uint64_t words[LSHSystemHamming::_total_words];
+    strToWords (str, words);
+    for (unsigned int l=0; l<_Ld; l++)
+      {
+        const uint64_t *gw = _gwords + l * LSHSystemHamming::_total_words;
+        const unsigned long int *mfactors = _mainHash[l];
+        const unsigned long int *cfactors = _controlHash[l];
+        unsigned long int rm = 0, rc = 0;
+        for (unsigned int w=0; w<LSHSystemHamming::_total_words; w++)
+          {
+            uint64_t bits = gw[w] & words[w];
+            while (bits)
+              {
+                unsigned int i = w * 64 + lsh_ctz64(bits);
+                rm += mfactors[i];
+                rc += cfactors[i];
+                bits &= bits - 1;
+              }
+          }
+        Lmkeys[l] = rm % uhsize;
+        Lckeys[l] = rc;
+      }
   }
 
   int LSHSystemHamming::distance(const std::bitset<_total_bits> &str1,
-                                 const std::bitset<_total_bits> &str2)
+                                 const std::bitset<_total_bits> &str2) const
+  {
+    return static_cast<int> ((str1 ^ str2).count ());
+  }
+
+  int LSHSystemHamming::distance(const uint64_t *words1, const uint64_t *words2) const
   {
     int dist = 0;
-    for (unsigned int i=0; i<_total_bits; i++)
-      {
-        if (str1[i] != str2[i])
-          dist++;
-      }
+    for (unsigned int w=0; w<LSHSystemHamming::_total_words; w++)
+      dist += lsh_popcount64(words1[w] ^ words2[w]);
     return dist;
   }
 
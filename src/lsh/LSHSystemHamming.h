@@ -28,8 +28,12 @@
 #define LSHSYSTEMHAMMING_H
 
 #include "LSHSystem.h"
+#include "Random.h"
 #include <string>
 #include <bitset>
+#include <map>
+#include <stdint.h>
+#include <pthread.h>
 
 namespace lsh
 {
@@ -37,6 +41,11 @@ namespace lsh
   /**
    * \class LSHSystemHamming
    * \brief String sampling based on the Hamming distance.
+   *
+   * The sampling functions and hashing factors are generated from fixed seeds,
+   * and never change once the system is built, so that a system can be shared
+   * by concurrent threads, see getShared. Strings are hashed as arrays of
+   * 64 bit words.
    */
   class LSHSystemHamming : public LSHSystem
   {
@@ -45,6 +54,13 @@ namespace lsh
 
       ~LSHSystemHamming();
 
+      /**
+       * \brief returns the process-wide system with parameters k and L, that
+       *        is built on first call and lives until the process exits.
+       *        Thread-safe.
+       */
+      static const LSHSystemHamming* getShared(const unsigned int &k, const unsigned int &L);
+
     private:
       /**
       * const parameters, aka #define.
@@ -59,6 +75,8 @@ namespace lsh
     public:
       static const unsigned int _total_bits = LSHSystemHamming::_char_bit * LSHSystemHamming::_fixed_str_size;
 
+      static const unsigned int _total_words = (LSHSystemHamming::_total_bits + 63) / 64; /**< 64 bit words per string. */
+
       unsigned int _smpl_bits;
 
     public:
@@ -70,14 +88,22 @@ namespace lsh
 
       void initLSHSystemHamming ();
 
-      void initG ();
+      void initG (RandomGenerator &rng);
 
       /**
        * \brief turns a string into an array of bits.
        * @param str string to be converted.
        * @param bb_str result vector of bits.
        */
-      void strToBits (const std::string &str, std::bitset<LSHSystemHamming::_total_bits> &bb_str);
+      void strToBits (const std::string &str, std::bitset<LSHSystemHamming::_total_bits> &bb_str) const;
+
+      /**
+       * \brief turns a string into an array of _total_words 64 bit words, with
+       *        the same bit layout as strToBits.
+       * @param str string to be converted.
+       * @param words (pre-allocated) result array of words.
+       */
+      static void strToWords (const std::string &str, uint64_t *words);
 
       /**
        * \brief projects bit string bb_str L times with gs.
@@ -87,56 +113,69 @@ namespace lsh
        */
       void LprojectStr (const std::bitset<LSHSystemHamming::_total_bits> &bb_str,
                         const unsigned int L,
-                        std::bitset<LSHSystemHamming::_total_bits> *bb_hash);
+                        std::bitset<LSHSystemHamming::_total_bits> *bb_hash) const;
 
       /**
        *
        *
        */
-      unsigned long int bitHash (std::bitset<LSHSystemHamming::_total_bits> &bb,
+      unsigned long int bitHash (const std::bitset<LSHSystemHamming::_total_bits> &bb,
                                  unsigned long int **hash_params,
-                                 const unsigned int &l);
+                                 const unsigned int &l) const;
 
-      unsigned long int controlHash (std::bitset<LSHSystemHamming::_total_bits> &bb,
-                                     const unsigned int &l);
+      /**
+       * \brief hash of the projection of a string with g_l, i.e. bitHash
+       *        of the string ANDed with g_l, one word at a time.
+       * @param words string as an array of words, see strToWords.
+       * @param factors hashing factors of g_l, modulo _control_hash_prime_bits.
+       * @param l rank of the projection.
+       */
+      unsigned long int wordHash (const uint64_t *words,
+                                  const unsigned long int *factors,
+                                  const unsigned int &l) const;
 
+      unsigned long int controlHash (const std::bitset<LSHSystemHamming::_total_bits> &bb,
+                                     const unsigned int &l) const;
 
-      void LcontrolHash (std::bitset<LSHSystemHamming::_total_bits> *bb,
-                         unsigned long int *Lchashes);
+
+      void LcontrolHash (const std::bitset<LSHSystemHamming::_total_bits> *bb,
+                         unsigned long int *Lchashes) const;
 
       /**
        *
        *
        */
-      unsigned long int mainHash (std::bitset<LSHSystemHamming::_total_bits> &bb,
+      unsigned long int mainHash (const std::bitset<LSHSystemHamming::_total_bits> &bb,
                                   const unsigned int &l,
-                                  const unsigned long int &hsize);
+                                  const unsigned long int &hsize) const;
 
-      void LmainHash (std::bitset<LSHSystemHamming::_total_bits> *bb,
+      void LmainHash (const std::bitset<LSHSystemHamming::_total_bits> *bb,
                       const unsigned long int &hsize,
-                      unsigned long int *Lmhashes);
+                      unsigned long int *Lmhashes) const;
 
       /**
        * Integrated key management.
        */
-      void LcontrolKeyFromStr(std::string str,
-                              unsigned long int *Lmkeys);
+      void LcontrolKeyFromStr(const std::string &str,
+                              unsigned long int *Lckeys) const;
 
-      void LmainKeyFromStr(std::string str,
-                           unsigned long int *Lckeys,
-                           const unsigned int &uhsize);
+      void LmainKeyFromStr(const std::string &str,
+                           unsigned long int *Lmkeys,
+                           const unsigned int &uhsize) const;
 
-      void LKeysFromStr(std::string str,
+      void LKeysFromStr(const std::string &str,
                         unsigned long int *Lmkeys,
                         unsigned long int *Lckeys,
-                        const unsigned int &uhsize);
+                        const unsigned int &uhsize) const;
 
 
       /**
        * Hamming distance.
        */
       int distance(const std::bitset<LSHSystemHamming::_total_bits> &str1,
-                   const std::bitset<LSHSystemHamming::_total_bits> &str2);
+                   const std::bitset<LSHSystemHamming::_total_bits> &str2) const;
+
+      int distance(const uint64_t *words1, const uint64_t *words2) const;
 
       /**
        * accessors.
@@ -149,36 +188,45 @@ namespace lsh
       {
         return LSHSystemHamming::_fixed_str_size;
       }
-      unsigned int getTotalBits ()
+      unsigned int getTotalBits () const
       {
         return LSHSystemHamming::_total_bits;
       }
-      unsigned int getG (const int &l, const int &k);
-      std::bitset<LSHSystemHamming::_total_bits>& getG (const int &l)
+      unsigned int getG (const int &l, const int &k) const;
+      const std::bitset<LSHSystemHamming::_total_bits>& getG (const int &l) const
       {
         return _g[l];
       }
-      bool isInitialized ()
+      bool isInitialized () const
       {
         return _initialized;
       }
 
     private:
-      void charToBits (const char &c, std::bitset<LSHSystemHamming::_char_bit> &bb_char);
+      static void charToBits (const char &c, std::bitset<LSHSystemHamming::_char_bit> &bb_char);
 
       /**
        * Dispersion functions as L arrays of n*k bits.
        */
       std::bitset<LSHSystemHamming::_total_bits> *_g;
 
+      /**
+       * Dispersion functions as L arrays of _total_words words.
+       */
+      uint64_t *_gwords;
+
       /**
        * hashing function random parameters:
        * 2 Lxnk-dimensionnal arrays of factors, where n is the number of bits / char.
+       * Factors are stored modulo _control_hash_prime_bits.
        */
       unsigned long int **_controlHash;
       unsigned long int **_mainHash;
 
       bool _initialized;  /**< the static structures have been initialized. */
+
+      static std::map<unsigned long int,LSHSystemHamming*> _shared; /**< shared systems by (k,L). */
+      static pthread_mutex_t _shared_mutex;
   };
 
 }
@@ -23,12 +23,12 @@
 namespace lsh
 {
 
-  LSHUniformHashTableHamming::LSHUniformHashTableHamming(LSHSystemHamming *lsh_h)
+  LSHUniformHashTableHamming::LSHUniformHashTableHamming(const LSHSystemHamming *lsh_h)
       : LSHUniformHashTable<std::string>(),_lsh_h(lsh_h)
   {
   }
 
-  LSHUniformHashTableHamming::LSHUniformHashTableHamming(LSHSystemHamming *lsh_h,
+  LSHUniformHashTableHamming::LSHUniformHashTableHamming(const LSHSystemHamming *lsh_h,
       const unsigned long int &uhsize)
       : LSHUniformHashTable<std::string>(uhsize),_lsh_h(lsh_h)
   {
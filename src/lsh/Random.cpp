@@ -36,6 +36,51 @@ namespace lsh
     return r;
   }
 
+  /*- RandomGenerator -*/
+  RandomGenerator::RandomGenerator(const unsigned int &seed)
+    :_front(RandomGenerator::_separation),_rear(0)
+  {
+    /**
+     * same initialization as srandom(): a linear congruential generator,
+     * whose first outputs are thrown away.
+     */
+    int32_t word = seed == 0 ? 1 : static_cast<int32_t> (seed);
+    _state[0] = word;
+    for (int i=1; i<RandomGenerator::_degree; i++)
+      {
+        long int hi = word / 127773;
+        long int lo = word % 127773;
+        word = 16807 * lo - 2836 * hi;
+        if (word < 0)
+          word += 2147483647;
+        _state[i] = word;
+      }
+    for (int i=0; i<RandomGenerator::_degree * 10; i++)
+      next();
+  }
+
+  long RandomGenerator::next()
+  {
+    uint32_t val = static_cast<uint32_t> (_state[_front]) + static_cast<uint32_t> (_state[_rear]);
+    _state[_front] = static_cast<int32_t> (val);
+    if (++_front >= RandomGenerator::_degree)
+      _front = 0;
+    if (++_rear >= RandomGenerator::_degree)
+      _rear = 0;
+    return static_cast<long> (val >> 1);
+  }
+
+  unsigned long int RandomGenerator::genUniformUnsInt32 (const unsigned long int &minB,
+      const unsigned long int &maxB)
+  {
+    static const double range = 2147483648.0; // 2^31, i.e. the maximum of next() + 1.
+    if (range > maxB - minB)
+      return minB + static_cast<unsigned long int> ((maxB - minB + 1.0) * next () / range);
+    unsigned long long int hi = next ();
+    unsigned long long int lo = next ();
+    return minB + static_cast<unsigned long int> ((maxB - minB + 1.0) * (hi * range + lo) / (range * range));
+  }
+
   double Random::genUniformDbl32 (const double &minB, const double &maxB)
   {
     double r = 0.0;
@@ -27,6 +27,8 @@
 #ifndef RANDOM_H
 #define RANDOM_H
 
+#include <stdint.h>
+
 namespace lsh
 {
   class Random
@@ -62,6 +64,40 @@ namespace lsh
       //static const long _rbits_seed = 9457920459875;
       static const long _rbits_seed = 945792045;  //32 bits.
   };
+
+  /**
+   * \brief random number generator with its own state, that yields the same
+   *        sequence as random() after srandom(seed) with the default state
+   *        size of the GNU C library (additive feedback, degree 31), without
+   *        touching the process-wide state of random().
+   */
+  class RandomGenerator
+  {
+    public:
+      RandomGenerator(const unsigned int &seed);
+
+      ~RandomGenerator() {};
+
+      /**
+       * \brief next random integer in [0,2^31-1].
+       */
+      long next();
+
+      /**
+       * \brief generate a random 32 bit unsigned integer between minB and maxB,
+       *        as Random::genUniformUnsInt32.
+       */
+      unsigned long int genUniformUnsInt32 (const unsigned long int &minB,
+                                            const unsigned long int &maxB);
+
+    private:
+      static const int _degree = 31;
+      static const int _separation = 3;
+
+      int32_t _state[RandomGenerator::_degree];
+      int _front; /**< front pointer, _separation ahead of the rear one. */
+      int _rear;
+  };
 }
 
 #endif
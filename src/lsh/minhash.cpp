@@ -0,0 +1,217 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "minhash.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+
+/**
+ * FNV-1a 64 bit parameters.
+ */
+#define MINHASH_FNV_OFFSET 14695981039346656037ULL
+#define MINHASH_FNV_PRIME 1099511628211ULL
+
+namespace lsh
+{
+
+  /*- minhash_signature -*/
+  minhash_signature::minhash_signature()
+    :_nfeatures(0)
+  {
+    memset(_h,0xff,sizeof(_h));
+  }
+
+  double minhash_signature::similarity(const minhash_signature &sig) const
+  {
+    if (empty() || sig.empty())
+      return 0.0;
+    int same = 0;
+    for (int i=0; i<MINHASH_SIZE; i++)
+      {
+        if (_h[i] == sig._h[i])
+          same++;
+      }
+    return same / static_cast<double>(MINHASH_SIZE);
+  }
+
+  /*- minhash -*/
+  /**
+   * odd multipliers of the hash functions, h_i(f) = upper 32 bits of f * m_i.
+   */
+  const uint64_t minhash::_mult[MINHASH_SIZE] =
+  {
+    0xc549d4a08e6c11f3ULL, 0xe7b0d7230811d5d9ULL, 0xcce8048ebebad04bULL,
+    0x5432587f7ab3dd1fULL, 0x769fbb362d1de751ULL, 0xd8dd8ff1b60043efULL,
+    0x242aafd02368f3f5ULL, 0x07b979ddce798f6fULL, 0x1b95f9001fe88001ULL,
+    0x3f478da4435e3373ULL, 0x8be7fcb6fc63dbedULL, 0x2a1e46fb9fc0be07ULL,
+    0xee2bb7fd5e6dffd9ULL, 0x40144b137b418f0bULL, 0x247bf0bd45374ec9ULL,
+    0xa74e24aa29914d69ULL, 0xc8e7bb1ba6b7394dULL, 0x1453664d12d47e63ULL,
+    0x06ff5c93e7b11ea9ULL, 0x3966177c584f0607ULL, 0xe7c2f8b8a79f86f1ULL,
+    0x571939fa49eefd55ULL, 0x2aeb8afe19bd84c3ULL, 0xf92d298cbffc07d5ULL,
+    0xb6b1bfa062bc41c5ULL, 0x976e36e5acec606fULL, 0x2662ad07df4dfe5dULL,
+    0x7c9edde5125087d3ULL, 0x42cb75d821b3961bULL, 0xf4f7c798c3180261ULL,
+    0x43b789e672945405ULL, 0xc33a9e67efd5b653ULL
+  };
+
+  uint64_t minhash::hash(const char *str, const size_t &len)
+  {
+    uint64_t h = MINHASH_FNV_OFFSET;
+    for (size_t i=0; i<len; i++)
+      {
+        h ^= static_cast<unsigned char>(tolower(static_cast<unsigned char>(str[i])));
+        h *= MINHASH_FNV_PRIME;
+      }
+    return h;
+  }
+
+  void minhash::add_feature(const uint64_t &f, minhash_signature &sig)
+  {
+    for (int i=0; i<MINHASH_SIZE; i++)
+      {
+        uint32_t h = static_cast<uint32_t>((f * minhash::_mult[i]) >> 32);
+        if (h < sig._h[i])
+          sig._h[i] = h;
+      }
+    sig._nfeatures++;
+  }
+
+  void minhash::signature(const std::string &txt,
+                          const std::string &delims,
+                          minhash_signature &sig,
+                          const size_t &min_words)
+  {
+    bool is_delim[256];
+    memset(is_delim,0,sizeof(is_delim));
+    for (size_t i=0; i<delims.size(); i++)
+      is_delim[static_cast<unsigned char>(delims[i])] = true;
+
+    // words and pairs of words, hashed in place.
+    minhash_signature s;
+    const char *str = txt.c_str();
+    const size_t len = txt.size();
+    uint64_t prev = 0;
+    size_t nwords = 0;
+    size_t i = 0;
+    while (i < len)
+      {
+        while (i < len && is_delim[static_cast<unsigned char>(str[i])])
+          i++;
+        size_t start = i;
+        while (i < len && !is_delim[static_cast<unsigned char>(str[i])])
+          i++;
+        if (i == start)
+          break;
+        uint64_t h = minhash::hash(str + start,i - start);
+        minhash::add_feature(h,s);
+        if (nwords > 0)
+          minhash::add_feature((prev * MINHASH_FNV_PRIME) ^ (h >> 1),s);
+        prev = h;
+        nwords++;
+      }
+    if (nwords >= min_words && nwords > 0)
+      sig = s;
+    else sig = minhash_signature();
+  }
+
+  /*- minhash_index -*/
+  minhash_index::minhash_index()
+  {
+  }
+
+  minhash_index::~minhash_index()
+  {
+    clear();
+  }
+
+  uint32_t minhash_index::band_key(const minhash_signature &sig, const int &b)
+  {
+    const int rows = MINHASH_SIZE / MINHASH_BANDS;
+    uint32_t key = static_cast<uint32_t>(b) * 0x9e3779b9u;
+    for (int r=b*rows; r<(b+1)*rows; r++)
+      key = (key ^ sig._h[r]) * 0x01000193u;
+    return key;
+  }
+
+  void minhash_index::add(const minhash_signature &sig, const uint32_t &id)
+  {
+    if (sig.empty())
+      return;
+
+    uint32_t slot = _sigs.size();
+    _sigs.push_back(sig);
+    _ids.push_back(id);
+    for (int b=0; b<MINHASH_BANDS; b++)
+      {
+        uint32_t key = minhash_index::band_key(sig,b);
+        hash_map<uint32_t,std::vector<uint32_t>*,id_hash_uint>::iterator hit;
+        std::vector<uint32_t> *slots = NULL;
+        if ((hit = _bands.find(key)) != _bands.end())
+          slots = (*hit).second;
+        else
+          {
+            slots = new std::vector<uint32_t>();
+            _bands.insert(std::pair<uint32_t,std::vector<uint32_t>*>(key,slots));
+          }
+        if (slots->empty() || slots->back() != slot) // bands may collide.
+          slots->push_back(slot);
+      }
+  }
+
+  void minhash_index::find(const minhash_signature &sig, const double &min_similarity,
+                           std::vector<uint32_t> &ids) const
+  {
+    if (sig.empty())
+      return;
+
+    std::vector<uint32_t> slots;
+    for (int b=0; b<MINHASH_BANDS; b++)
+      {
+        hash_map<uint32_t,std::vector<uint32_t>*,id_hash_uint>::const_iterator hit;
+        if ((hit = _bands.find(minhash_index::band_key(sig,b))) != _bands.end())
+          slots.insert(slots.end(),(*hit).second->begin(),(*hit).second->end());
+      }
+    std::sort(slots.begin(),slots.end());
+    slots.erase(std::unique(slots.begin(),slots.end()),slots.end());
+
+    std::vector<std::pair<double,uint32_t> > found;
+    for (size_t s=0; s<slots.size(); s++)
+      {
+        double sim = sig.similarity(_sigs[slots[s]]);
+        if (sim >= min_similarity)
+          found.push_back(std::pair<double,uint32_t>(-sim,_ids[slots[s]]));
+      }
+    std::stable_sort(found.begin(),found.end());
+    for (size_t i=0; i<found.size(); i++)
+      ids.push_back(found[i].second);
+  }
+
+  void minhash_index::clear()
+  {
+    hash_map<uint32_t,std::vector<uint32_t>*,id_hash_uint>::iterator hit;
+    for (hit=_bands.begin(); hit!=_bands.end(); ++hit)
+      delete (*hit).second;
+    _bands.clear();
+    _sigs.clear();
+    _ids.clear();
+  }
+
+} /* end of namespace. */
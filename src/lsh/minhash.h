@@ -0,0 +1,160 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINHASH_H
+#define MINHASH_H
+
+#include "stl_hash.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Number of hash functions in a signature.
+ */
+#define MINHASH_SIZE 32
+
+/**
+ * Number of bands a signature is cut into for indexing, each of
+ * MINHASH_SIZE / MINHASH_BANDS hashes.
+ */
+#define MINHASH_BANDS 8
+
+namespace lsh
+{
+
+  /**
+   * \brief MinHash signature of a set of features: for each of MINHASH_SIZE
+   *        hash functions, the smallest hash of the features. The share of
+   *        equal hashes between two signatures estimates the Jaccard
+   *        similarity of the two sets.
+   */
+  class minhash_signature
+  {
+    public:
+      minhash_signature();
+
+      ~minhash_signature() {};
+
+      /**
+       * \brief estimated Jaccard similarity, in [0,1].
+       */
+      double similarity(const minhash_signature &sig) const;
+
+      /**
+       * \brief whether the signature is of an empty set.
+       */
+      bool empty() const
+      {
+        return _nfeatures == 0;
+      };
+
+      uint32_t _h[MINHASH_SIZE];
+      uint32_t _nfeatures; /**< number of features hashed. */
+  };
+
+  /**
+   * \brief MinHash signatures of texts, whose features are the lower case
+   *        words and pairs of consecutive words.
+   */
+  class minhash
+  {
+    public:
+      /**
+       * \brief signature of a text, that is left empty if the text has
+       *        less than min_words words.
+       * @param txt text.
+       * @param delims word delimiters.
+       * @param sig result signature.
+       * @param min_words number of words below which texts are too short to compare.
+       */
+      static void signature(const std::string &txt,
+                            const std::string &delims,
+                            minhash_signature &sig,
+                            const size_t &min_words=1);
+
+      /**
+       * \brief adds a hashed feature to a signature.
+       */
+      static void add_feature(const uint64_t &f, minhash_signature &sig);
+
+      /**
+       * \brief 64 bit hash of a string, lower case.
+       */
+      static uint64_t hash(const char *str, const size_t &len);
+
+    private:
+      static const uint64_t _mult[MINHASH_SIZE];
+  };
+
+  /**
+   * \brief an index of signatures by band: signatures with a high similarity
+   *        are likely to have a band in common, so that lookups only compare
+   *        a signature to those that share one of its bands.
+   *        With MINHASH_BANDS bands of r hashes, a signature with similarity s
+   *        is found with probability 1-(1-s^r)^MINHASH_BANDS.
+   */
+  class minhash_index
+  {
+    public:
+      minhash_index();
+
+      ~minhash_index();
+
+      /**
+       * \brief indexes signature sig of object id. Empty signatures are ignored.
+       */
+      void add(const minhash_signature &sig, const uint32_t &id);
+
+      /**
+       * \brief finds the indexed objects whose signature has a similarity
+       *        of at least min_similarity with sig.
+       * @param sig signature.
+       * @param min_similarity minimum estimated similarity.
+       * @param ids result objects, by decreasing similarity.
+       */
+      void find(const minhash_signature &sig, const double &min_similarity,
+                std::vector<uint32_t> &ids) const;
+
+      /**
+       * \brief removes every signature.
+       */
+      void clear();
+
+      /**
+       * \brief number of indexed signatures.
+       */
+      size_t size() const
+      {
+        return _sigs.size();
+      };
+
+    private:
+      static uint32_t band_key(const minhash_signature &sig, const int &b);
+
+      std::vector<minhash_signature> _sigs; /**< indexed signatures, by slot. */
+      std::vector<uint32_t> _ids; /**< indexed objects, by slot. */
+      hash_map<uint32_t,std::vector<uint32_t>*,id_hash_uint> _bands; /**< slots, by band key. */
+  };
+
+} /* end of namespace. */
+
+#endif
@@ -126,6 +126,140 @@ namespace lsh
     return fr;
   };
 
+  /*-- mrf_token --*/
+  void mrf_token::set(const char *str, const uint32_t &len)
+  {
+    _str = str;
+    _len = len;
+    _skip = (len == 6 && memcmp(str,"<skip>",6) == 0);
+    if (_skip)
+      set_skip_token<uint32_t>(_hash);
+    else mrf_hash_m<uint32_t>(str,len,_hash);
+  }
+
+  bool mrf_token::less(const mrf_token &t1, const mrf_token &t2)
+  {
+    int c = memcmp(t1._str,t2._str,std::min(t1._len,t2._len));
+    if (c != 0)
+      return c < 0;
+    return t1._len < t2._len;
+  }
+
+  /*-- mrf_chains --*/
+  mrf_chains::mrf_chains(const uint32_t &length, const int &radius)
+    :_length(length),_radius(radius),_level(0),_mask(0)
+  {
+  }
+
+  bool mrf_chains::next()
+  {
+    if (_level >= _length)
+      return false;
+
+    // the chain at a level is the first token, then one token or skip per
+    // position, as given by the mask bits, highest bit first, and the
+    // token at the level.
+    _chain._idx[0] = 0;
+    _chain._size = _level + 1;
+    _chain._radius = _radius;
+    for (uint32_t j=1; j<_level; j++)
+      {
+        if ((_mask >> (_level-1-j)) & 1)
+          _chain._idx[j] = MRF_SKIP;
+        else
+          {
+            _chain._idx[j] = j;
+            _chain._radius--;
+          }
+      }
+    if (_level > 0)
+      {
+        _chain._idx[_level] = _level;
+        _chain._radius--;
+      }
+
+    if (_level == 0 || ++_mask == (1u << (_level-1)))
+      {
+        ++_level;
+        _mask = 0;
+      }
+    return true;
+  }
+
+  /**
+   * \brief ranks chains which do not contain any skipped token, as
+   *        str_chain::rank_alpha does. Returns whether the chain has a skip.
+   */
+  static bool mrf_rank_chain(const mrf_token *tokens, const mrf_chain &chain,
+                             uint8_t *idx)
+  {
+    bool skip = false;
+    for (uint32_t i=0; i<chain._size; i++)
+      {
+        idx[i] = chain._idx[i];
+        if (idx[i] == MRF_SKIP || tokens[idx[i]]._skip)
+          skip = true;
+      }
+    if (skip)
+      return true;
+
+    // insertion sort, chains are short.
+    for (uint32_t i=1; i<chain._size; i++)
+      {
+        uint8_t c = idx[i];
+        uint32_t j = i;
+        while (j > 0 && mrf_token::less(tokens[c],tokens[idx[j-1]]))
+          {
+            idx[j] = idx[j-1];
+            --j;
+          }
+        idx[j] = c;
+      }
+    return false;
+  }
+
+  template<>
+  uint32_t mrf_hash_w<uint32_t>(const mrf_token *tokens, const mrf_chain &chain,
+                                std::string &buf)
+  {
+    uint8_t idx[MRF_MAX_WINDOW];
+    mrf_rank_chain(tokens,chain,idx);
+
+    uint32_t h = 0;
+    size_t csize = std::min(10,(int)chain._size); // as mrf_hash_c.
+    for (size_t i=0; i<csize; i++)
+      {
+        uint32_t hashed_token;
+        if (idx[i] == MRF_SKIP)
+          set_skip_token<uint32_t>(hashed_token);
+        else hashed_token = tokens[idx[i]]._hash;
+        h += hashed_token * mrf::_hctable[i];
+      }
+    return h;
+  }
+
+  template<>
+  f160r mrf_hash_w<f160r>(const mrf_token *tokens, const mrf_chain &chain,
+                          std::string &buf)
+  {
+    uint8_t idx[MRF_MAX_WINDOW];
+    mrf_rank_chain(tokens,chain,idx);
+
+    buf.clear();
+    for (uint32_t i=0; i<chain._size; i++)
+      {
+        if (i > 0)
+          buf += ' '; // space as a pre-hashing delimiter of words.
+        if (idx[i] == MRF_SKIP)
+          buf.append("<skip>",6);
+        else buf.append(tokens[idx[i]]._str,tokens[idx[i]]._len);
+      }
+    char *hashed_token = NULL;
+    mrf_hash_m<char*>(buf.c_str(),buf.size(),hashed_token);
+    f160r fr(hashed_token,chain._radius);
+    return fr;
+  }
+
   /*-- str_chain --*/
   str_chain::str_chain()
     :_radius(0),_skip(false)
@@ -299,6 +433,46 @@ namespace lsh
       }
   }
 
+  void mrf::tokenize(const std::string &str,
+                     std::vector<mrf_token> &tokens,
+                     const std::string &delim)
+  {
+    bool delims[256];
+    mrf::delims_table(delim,delims);
+    size_t pos = 0, begin = 0, end = 0;
+    while (mrf::next_token(str,delims,pos,begin,end))
+      {
+        mrf_token token;
+        token.set(str.c_str()+begin,end-begin);
+        tokens.push_back(token);
+      }
+  }
+
+  void mrf::delims_table(const std::string &delim, bool *delims)
+  {
+    memset(delims,0,256*sizeof(bool));
+    for (size_t i=0; i<delim.size(); i++)
+      delims[(unsigned char)delim[i]] = true;
+  }
+
+  bool mrf::next_token(const std::string &str,
+                       const bool *delims,
+                       size_t &pos,
+                       size_t &begin,
+                       size_t &end)
+  {
+    size_t len = str.size();
+    while (pos < len && delims[(unsigned char)str[pos]])
+      ++pos;
+    if (pos == len)
+      return false;
+    begin = pos;
+    while (pos < len && !delims[(unsigned char)str[pos]])
+      ++pos;
+    end = pos;
+    return true;
+  }
+
   void mrf::unique_features(std::vector<uint32_t> &sorted_features)
   {
     if (sorted_features.size() == 1)
@@ -334,14 +508,22 @@ namespace lsh
                          const int &step,
                          const uint32_t &window_length_default)
   {
-    while (!tokens.empty())
+    size_t ntokens = tokens.size();
+    std::vector<mrf_token> vtokens(ntokens);
+    for (size_t i=0; i<ntokens; i++)
+      vtokens.at(i).set(tokens.at(i).c_str(),tokens.at(i).size());
+
+    std::string buf;
+    size_t t = 0;
+    while (t < ntokens)
       {
-        mrf::mrf_build(tokens,features,
-                       0, max_radius,0,window_length_default);
-        if ((int)tokens.size()>step)
-          tokens.erase(tokens.begin(),tokens.begin()+step);
-        else tokens.clear();
+        mrf::mrf_build(&vtokens.at(t),ntokens-t,features,
+                       0,max_radius,window_length_default,buf);
+        if ((int)(ntokens-t)>step)
+          t += step;
+        else t = ntokens;
       }
+    tokens.clear();
     std::sort(features.begin(),features.end());
   }
 
@@ -352,11 +534,14 @@ namespace lsh
                                       const int &step,
                                       const uint32_t &window_length_default)
   {
-    // Skip delimiters at beginning.
-    std::string::size_type lastPos = str.find_first_not_of(delim, 0);
-    // Find first "non-delimiter".
-    std::string::size_type pos = str.find_first_of(delim, lastPos);
-    std::vector<std::string> tokens;
+    bool delims[256];
+    mrf::delims_table(delim,delims);
+    size_t pos = 0, begin = 0, end = 0;
+
+    // sliding window of tokens, as views into str.
+    std::vector<mrf_token> tokens;
+    tokens.reserve(std::min(window_length_default,(uint32_t)MRF_MAX_WINDOW));
+    std::string buf;
 
     while (true)
       {
@@ -366,22 +551,20 @@ namespace lsh
           }
         else tokens.clear();
 
-        while ((std::string::npos != pos || std::string::npos != lastPos)
-               && tokens.size() < window_length_default)
+        while (tokens.size() < window_length_default
+               && mrf::next_token(str,delims,pos,begin,end))
           {
-            // Found a token, add it to the vector.
-            tokens.push_back(str.substr(lastPos, pos - lastPos));
-            // Skip the delimiters.
-            lastPos = str.find_first_not_of(delim,pos);
-            // Find next "non-delimiter".
-            pos = str.find_first_of(delim, lastPos);
+            mrf_token token;
+            token.set(str.c_str()+begin,end-begin);
+            tokens.push_back(token);
           }
 
         if (tokens.empty() || tokens.size()<window_length_default-max_radius)
           break;
 
         // produce the features out of the tokens.
-        mrf::mrf_build(tokens,features,0,max_radius,0,window_length_default);
+        mrf::mrf_build(&tokens.at(0),tokens.size(),features,0,max_radius,
+                       window_length_default,buf);
       }
     std::sort(features.begin(),features.end());
   }
@@ -396,16 +579,24 @@ namespace lsh
                                       const uint32_t &window_length_default,
                                       const std::string &lang)
   {
-    // Skip delimiters at beginning.
-    std::string::size_type lastPos = str.find_first_not_of(delim, 0);
-    // Find first "non-delimiter".
-    std::string::size_type pos = str.find_first_of(delim, lastPos);
-    std::vector<std::string> tokens;
+    bool delims[256];
+    mrf::delims_table(delim,delims);
+    size_t pos = 0, begin = 0, end = 0;
 
     stopwordlist *swl = NULL;
     if (!lang.empty())
       swl = lsh_configuration::_config->get_wordlist(lang);
 
+    // lower-cased tokens are written in place into a single copy of the
+    // text, each terminated for the stop word lookup.
+    std::string lstr(str.size()+1,'\0');
+    mrf_token stop_word;
+    stop_word.set(mrf::_stop_word_token.c_str(),mrf::_stop_word_token.size());
+
+    // sliding window of tokens, as views into lstr.
+    std::vector<mrf_token> tokens;
+    tokens.reserve(std::min(window_length_default,(uint32_t)MRF_MAX_WINDOW));
+
     while (true)
       {
         if ((int)tokens.size()>step)
@@ -414,50 +605,98 @@ namespace lsh
           }
         else tokens.clear();
 
-        while ((std::string::npos != pos || std::string::npos != lastPos)
-               && tokens.size() < window_length_default)
+        while (tokens.size() < window_length_default
+               && mrf::next_token(str,delims,pos,begin,end))
           {
             // Found a token, chomp it.
-            std::string token = str.substr(lastPos, pos - lastPos);
-            size_t cpos = 0;
-            while (cpos<token.size() && isspace(token[cpos]))
+            while (begin<end && isspace(str[begin]))
               {
-                ++cpos;
+                ++begin;
               }
-            if (cpos>0)
-              token = token.substr(cpos);
 
             // bypasse digit-beginning tokens, look into stop word list if available, & add to token list.
-            if (!token.empty() && !isdigit(token.c_str()[0]))
+            if (begin<end && !isdigit(str[begin]))
               {
-                std::transform(token.begin(),token.end(),token.begin(),tolower);
+                char *ltoken = &lstr[begin];
+                for (size_t i=begin; i<end; i++)
+                  lstr[i] = tolower(str[i]);
+                lstr[end] = '\0';
                 bool sw = false;
                 if (swl)
                   {
-                    sw = swl->has_word(token);
+                    sw = swl->has_word(ltoken);
                   }
                 if (!sw)
                   {
+                    mrf_token token;
+                    token.set(ltoken,end-begin);
                     tokens.push_back(token);
                   }
                 else if (window_length_default > 1)
-                  tokens.push_back(mrf::_stop_word_token);
+                  tokens.push_back(stop_word);
               }
-            // Skip the delimiters.
-            lastPos = str.find_first_not_of(delim,pos);
-            // Find next "non-delimiter".
-            pos = str.find_first_of(delim, lastPos);
           }
 
         if (tokens.empty() || tokens.size()<window_length_default-max_radius)
           break;
 
         // produce the features out of the tokens.
-        mrf::mrf_build(tokens,wfeatures,bow,0,max_radius,0,
+        mrf::mrf_build(&tokens.at(0),tokens.size(),wfeatures,bow,0,max_radius,
                        window_length_default);
       }
   }
 
+  void mrf::mrf_build(const mrf_token *tokens,
+                      const uint32_t &ntokens,
+                      hash_map<uint32_t,float,id_hash_uint> &wfeatures,
+                      hash_map<uint32_t,std::string,id_hash_uint> *bow,
+                      const int &min_radius,
+                      const int &max_radius,
+                      const uint32_t &window_length)
+  {
+    if (window_length > MRF_MAX_WINDOW)
+      {
+        std::vector<std::string> stokens;
+        for (uint32_t i=0; i<ntokens; i++)
+          stokens.push_back(std::string(tokens[i]._str,tokens[i]._len));
+        mrf::mrf_build(stokens,wfeatures,bow,min_radius,max_radius,0,window_length);
+        return;
+      }
+
+    short offset = mrf::_array_size-window_length;
+    int radius_chain = window_length - std::max(1,(int)(window_length-ntokens));
+    std::string buf;
+    mrf_chains chains(std::min(ntokens,window_length),radius_chain);
+    while (chains.next())
+      {
+        const mrf_chain &chain = chains._chain;
+        if (chain._radius < min_radius
+            || chain._radius > max_radius)
+          continue;
+        if (chain._size == 1 && tokens[0]._len <= 1)
+          continue;
+
+        uint32_t h = mrf_hash_w<uint32_t>(tokens,chain,buf);
+
+        // count features, increment total, and sets an exponential weight.
+        float w = mrf::_feature_weights[chain._radius+offset];
+        hash_map<uint32_t,float,id_hash_uint>::iterator hit;
+        if ((hit=wfeatures.find(h))!=wfeatures.end())
+          (*hit).second += w;
+        else wfeatures.insert(std::pair<uint32_t,float>(h,w));
+
+        // populate the words, if required.
+        if (bow && chain._size == 1 && tokens[0]._len>2)
+          {
+            hash_map<uint32_t,std::string,id_hash_uint>::iterator bit;
+            if ((bit=bow->find(h))==bow->end())
+              {
+                bow->insert(std::pair<uint32_t,std::string>(h,std::string(tokens[0]._str,tokens[0]._len)));
+              }
+          }
+      }
+  }
+
   void mrf::mrf_build(const std::vector<std::string> &tokens,
                       hash_map<uint32_t,float,id_hash_uint> &wfeatures,
                       hash_map<uint32_t,std::string,id_hash_uint> *bow,
@@ -593,31 +832,36 @@ namespace lsh
   void mrf::compute_tf_idf(std::vector<hash_map<uint32_t,float,id_hash_uint>*> &bags)
   {
     size_t nbags = bags.size();
+
+    // df, in a single pass over the bags.
     hash_map<uint32_t,uint32_t,id_hash_uint> cached_df;
-    hash_map<uint32_t,uint32_t,id_hash_uint>::const_iterator cache_hit;
+    hash_map<uint32_t,uint32_t,id_hash_uint>::iterator cache_hit;
     hash_map<uint32_t,float,id_hash_uint>::const_iterator chit;
+    for (size_t j=0; j<nbags; j++)
+      {
+        chit = bags.at(j)->begin();
+        while (chit!=bags.at(j)->end())
+          {
+            if ((*chit).second != 0.0) // secure...
+              {
+                if ((cache_hit = cached_df.find((*chit).first))!=cached_df.end())
+                  (*cache_hit).second++;
+                else cached_df.insert(std::pair<uint32_t,uint32_t>((*chit).first,1));
+              }
+            ++chit;
+          }
+      }
+
     for (size_t i=0; i<nbags; i++)
       {
         float norm = 0.0;
         hash_map<uint32_t,float,id_hash_uint>::iterator hit = bags.at(i)->begin();
         while (hit!=bags.at(i)->end())
           {
-            // compute df.
+            // idf.
             uint32_t df = 0;
             if ((cache_hit = cached_df.find((*hit).first))!=cached_df.end())
               df = (*cache_hit).second;
-            else
-              {
-                for (size_t j=0; j<nbags; j++)
-                  {
-                    if ((chit=bags.at(j)->find((*hit).first))!=bags.at(j)->end())
-                      if ((*chit).second != 0.0) // secure...
-                        df++;
-                  }
-                cached_df.insert(std::pair<uint32_t,uint32_t>((*hit).first,df)); // df in cache.
-              }
-
-            // idf.
             float idf = logf(static_cast<float>(nbags) / (static_cast<float>(df)));
 
             // tf-idf.
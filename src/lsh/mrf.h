@@ -155,6 +155,79 @@ namespace lsh
   template<>
   f160r mrf_hash_c<f160r>(const str_chain &chain);
 
+  /*- mrf_token -*/
+  /**
+   * \brief a token as a view into the tokenized text, hashed once when read.
+   */
+  class mrf_token
+  {
+    public:
+      void set(const char *str, const uint32_t &len);
+
+      /**
+       * \brief same ordering as std::string, used to rank chains.
+       */
+      static bool less(const mrf_token &t1, const mrf_token &t2);
+
+    public:
+      const char *_str;
+      uint32_t _len;
+      uint32_t _hash; /**< hash of the token, or skip token. */
+      bool _skip;     /**< whether the token reads "<skip>". */
+  };
+
+#define MRF_MAX_WINDOW 16
+#define MRF_SKIP 0xff
+
+  /*- mrf_chain -*/
+  /**
+   * \brief a chain as indexes of tokens into a window, MRF_SKIP marks a
+   *        skipped token.
+   */
+  class mrf_chain
+  {
+    public:
+      uint8_t _idx[MRF_MAX_WINDOW];
+      uint32_t _size;
+      int _radius;
+  };
+
+  /**
+   * \brief enumerates the chains rooted at the first token of a window that
+   *        yield a feature, i.e. that end with a token, in the order they are
+   *        generated by mrf::mrf_build on a str_chain queue.
+   */
+  class mrf_chains
+  {
+    public:
+      mrf_chains(const uint32_t &length, const int &radius);
+
+      ~mrf_chains() {};
+
+      bool next();
+
+    public:
+      mrf_chain _chain;
+
+    private:
+      uint32_t _length;
+      int _radius;
+      uint32_t _level;
+      uint32_t _mask;
+  };
+
+  template<typename feat>
+  feat mrf_hash_w(const mrf_token *tokens, const mrf_chain &chain,
+                  std::string &buf);
+
+  template<>
+  uint32_t mrf_hash_w<uint32_t>(const mrf_token *tokens, const mrf_chain &chain,
+                                std::string &buf);
+
+  template<>
+  f160r mrf_hash_w<f160r>(const mrf_token *tokens, const mrf_chain &chain,
+                          std::string &buf);
+
   class mrf
   {
     public:
@@ -162,6 +235,18 @@ namespace lsh
                            std::vector<std::string> &tokens,
                            const std::string &delim);
 
+      static void tokenize(const std::string &str,
+                           std::vector<mrf_token> &tokens,
+                           const std::string &delim);
+
+      static void delims_table(const std::string &delim, bool *delims);
+
+      static bool next_token(const std::string &str,
+                             const bool *delims,
+                             size_t &pos,
+                             size_t &begin,
+                             size_t &end);
+
       static void unique_features(std::vector<uint32_t> &sorted_features);
 
       // straight hash of a query string.
@@ -174,19 +259,15 @@ namespace lsh
                                      const int &max_radius,
                                      const uint32_t &window_length_default=5)
       {
-        std::vector<std::string> tokens;
+        std::vector<mrf_token> tokens;
         mrf::tokenize(str,tokens,mrf::_default_delims);
         uint32_t window_length = std::min((int)tokens.size(),(int)window_length_default);
 
-        int gen_radius = 0;
-        while (!tokens.empty())
-          {
-            mrf::mrf_build(tokens,features,
-                           min_radius,max_radius,
-                           gen_radius, window_length);
-            tokens.erase(tokens.begin());
-            ++gen_radius;
-          }
+        std::string buf;
+        size_t ntokens = tokens.size();
+        for (size_t t=0; t<ntokens; t++)
+          mrf::mrf_build(&tokens.at(t),ntokens-t,features,
+                         min_radius,max_radius,window_length,buf);
       }
 
       static void mrf_features(std::vector<std::string> &tokens,
@@ -202,6 +283,39 @@ namespace lsh
                                             const int &step,
                                             const uint32_t &window_length_default=5);
 
+      /**
+       * \brief produces the features of the chains rooted at the first of
+       *        ntokens tokens. Same features, in the same order, as
+       *        mrf_build on strings, without copying tokens or chains.
+       *        buf is scratch space, reused across calls.
+       */
+      template<typename feat>
+      static void mrf_build(const mrf_token *tokens,
+                            const uint32_t &ntokens,
+                            std::vector<feat> &features,
+                            const int &min_radius,
+                            const int &max_radius,
+                            const uint32_t &window_length,
+                            std::string &buf)
+      {
+        if (window_length > MRF_MAX_WINDOW)
+          {
+            std::vector<std::string> stokens;
+            for (uint32_t i=0; i<ntokens; i++)
+              stokens.push_back(std::string(tokens[i]._str,tokens[i]._len));
+            mrf::mrf_build(stokens,features,min_radius,max_radius,0,window_length);
+            return;
+          }
+
+        mrf_chains chains(std::min(ntokens,window_length),window_length-1);
+        while (chains.next())
+          {
+            if (chains._chain._radius >= min_radius
+                && chains._chain._radius <= max_radius)
+              features.push_back(mrf_hash_w<feat>(tokens,chains._chain,buf));
+          }
+      }
+
       template<typename feat>
       static void mrf_build(const std::vector<std::string> &tokens,
                             std::vector<feat> &features,
@@ -315,6 +429,14 @@ namespace lsh
                                             const uint32_t &window_length_default=5,
                                             const std::string &lang="");
 
+      static void mrf_build(const mrf_token *tokens,
+                            const uint32_t &ntokens,
+                            hash_map<uint32_t,float,id_hash_uint> &wfeatures,
+                            hash_map<uint32_t,std::string,id_hash_uint> *bow,
+                            const int &min_radius,
+                            const int &max_radius,
+                            const uint32_t &window_length_default);
+
       static void mrf_build(const std::vector<std::string> &tokens,
                             hash_map<uint32_t,float,id_hash_uint> &wfeatures,
                             hash_map<uint32_t,std::string,id_hash_uint> *bow,
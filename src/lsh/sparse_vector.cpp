@@ -0,0 +1,219 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sparse_vector.h"
+
+#include <algorithm>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace lsh
+{
+
+  sparse_vector::sparse_vector(const hash_map<uint32_t,float,id_hash_uint> &features)
+  {
+    std::vector<std::pair<uint32_t,float> > sfeatures(features.begin(),features.end());
+    std::sort(sfeatures.begin(),sfeatures.end());
+    _ids.reserve(sfeatures.size());
+    _weights.reserve(sfeatures.size());
+    for (size_t i=0; i<sfeatures.size(); i++)
+      {
+        _ids.push_back(sfeatures[i].first);
+        _weights.push_back(sfeatures[i].second);
+      }
+  }
+
+  float sparse_vector::get(const uint32_t &id) const
+  {
+    std::vector<uint32_t>::const_iterator vit = std::lower_bound(_ids.begin(),_ids.end(),id);
+    if (vit == _ids.end() || (*vit) != id)
+      return 0.0;
+    return _weights[vit - _ids.begin()];
+  }
+
+  float sparse_vector::dot(const sparse_vector &v) const
+  {
+    const size_t na = _ids.size();
+    const size_t nb = v._ids.size();
+    if (na == 0 || nb == 0)
+      return 0.0;
+    const uint32_t *a = &_ids[0];
+    const uint32_t *b = &v._ids[0];
+    const float *wa = &_weights[0];
+    const float *wb = &v._weights[0];
+    size_t i = 0, j = 0;
+    float d = 0.0;
+
+#ifdef __SSE2__
+    /**
+     * blocks of four ids are compared all against all, by rotating the
+     * second block, and the weights of the matching pairs are multiplied
+     * under the comparison masks. Ids are unique, so that an id matches
+     * at most once.
+     */
+    __m128 acc = _mm_setzero_ps();
+    while (i + 4 <= na && j + 4 <= nb)
+      {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+        __m128 vwa = _mm_loadu_ps(wa + i);
+        __m128 vwb = _mm_loadu_ps(wb + j);
+
+        __m128 m = _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va,vb)),vwb);
+        vb = _mm_shuffle_epi32(vb,_MM_SHUFFLE(0,3,2,1));
+        vwb = _mm_shuffle_ps(vwb,vwb,_MM_SHUFFLE(0,3,2,1));
+        m = _mm_or_ps(m,_mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va,vb)),vwb));
+        vb = _mm_shuffle_epi32(vb,_MM_SHUFFLE(0,3,2,1));
+        vwb = _mm_shuffle_ps(vwb,vwb,_MM_SHUFFLE(0,3,2,1));
+        m = _mm_or_ps(m,_mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va,vb)),vwb));
+        vb = _mm_shuffle_epi32(vb,_MM_SHUFFLE(0,3,2,1));
+        vwb = _mm_shuffle_ps(vwb,vwb,_MM_SHUFFLE(0,3,2,1));
+        m = _mm_or_ps(m,_mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va,vb)),vwb));
+        acc = _mm_add_ps(acc,_mm_mul_ps(vwa,m));
+
+        const uint32_t amax = a[i + 3];
+        const uint32_t bmax = b[j + 3];
+        if (amax <= bmax)
+          i += 4;
+        if (bmax <= amax)
+          j += 4;
+      }
+    float accs[4];
+    _mm_storeu_ps(accs,acc);
+    d = (accs[0] + accs[1]) + (accs[2] + accs[3]);
+#endif
+
+    // scalar merge of what remains.
+    while (i < na && j < nb)
+      {
+        if (a[i] < b[j])
+          i++;
+        else if (b[j] < a[i])
+          j++;
+        else
+          {
+            d += wa[i] * wb[j];
+            i++;
+            j++;
+          }
+      }
+    return d;
+  }
+
+  float sparse_vector::norm() const
+  {
+    const size_t n = _weights.size();
+    if (n == 0)
+      return 0.0;
+    const float *w = &_weights[0];
+    size_t i = 0;
+    float s = 0.0;
+
+#ifdef __SSE2__
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+      {
+        __m128 vw = _mm_loadu_ps(w + i);
+        acc = _mm_add_ps(acc,_mm_mul_ps(vw,vw));
+      }
+    float accs[4];
+    _mm_storeu_ps(accs,acc);
+    s = (accs[0] + accs[1]) + (accs[2] + accs[3]);
+#endif
+
+    for (; i<n; i++)
+      s += w[i] * w[i];
+    return sqrt(s);
+  }
+
+  void sparse_vector::scale(const float &f)
+  {
+    for (size_t i=0; i<_weights.size(); i++)
+      _weights[i] *= f;
+  }
+
+  float sparse_vector::add(const sparse_vector &v, const float &f)
+  {
+    const size_t na = _ids.size();
+    const size_t nb = v._ids.size();
+
+    // count the features of v that are not in this vector.
+    size_t missing = 0;
+    size_t i = 0, j = 0;
+    while (j < nb)
+      {
+        if (i < na && _ids[i] < v._ids[j])
+          i++;
+        else if (i < na && _ids[i] == v._ids[j])
+          {
+            i++;
+            j++;
+          }
+        else
+          {
+            missing++;
+            j++;
+          }
+      }
+
+    /**
+     * merge from the end, in place, so that the arrays are
+     * only grown once.
+     */
+    float updated = 0.0;
+    _ids.resize(na + missing);
+    _weights.resize(na + missing);
+    size_t k = na + missing;
+    i = na;
+    j = nb;
+    while (j > 0)
+      {
+        if (i > 0 && _ids[i-1] > v._ids[j-1])
+          {
+            --k;
+            --i;
+            _ids[k] = _ids[i];
+            _weights[k] = _weights[i];
+          }
+        else if (i > 0 && _ids[i-1] == v._ids[j-1])
+          {
+            --k;
+            --i;
+            --j;
+            _ids[k] = _ids[i];
+            _weights[k] = _weights[i] + f * v._weights[j];
+            updated += _weights[k];
+          }
+        else
+          {
+            --k;
+            --j;
+            _ids[k] = v._ids[j];
+            _weights[k] = f * v._weights[j];
+            updated += _weights[k];
+          }
+      }
+    return updated;
+  }
+
+} /* end of namespace. */
@@ -0,0 +1,100 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARSE_VECTOR_H
+#define SPARSE_VECTOR_H
+
+#include "stl_hash.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace lsh
+{
+
+  /**
+   * \brief a sparse vector of weighted features, as two arrays of feature ids
+   *        in increasing order and of their weights. Dot products are computed
+   *        by merging the arrays of ids, four at a time when SSE2 is available.
+   */
+  class sparse_vector
+  {
+    public:
+      sparse_vector()
+      {};
+
+      /**
+       * \brief builds a vector from a map of features to weights.
+       */
+      sparse_vector(const hash_map<uint32_t,float,id_hash_uint> &features);
+
+      ~sparse_vector()
+      {};
+
+      size_t size() const
+      {
+        return _ids.size();
+      };
+
+      bool empty() const
+      {
+        return _ids.empty();
+      };
+
+      void clear()
+      {
+        _ids.clear();
+        _weights.clear();
+      };
+
+      /**
+       * \brief weight of a feature, 0 if it is not in the vector.
+       */
+      float get(const uint32_t &id) const;
+
+      /**
+       * \brief dot product.
+       */
+      float dot(const sparse_vector &v) const;
+
+      /**
+       * \brief euclidian norm.
+       */
+      float norm() const;
+
+      /**
+       * \brief multiplies every weight by f.
+       */
+      void scale(const float &f);
+
+      /**
+       * \brief adds f.v to this vector.
+       * @return the sum of the updated weights of the features of v.
+       */
+      float add(const sparse_vector &v, const float &f=1.0);
+
+    public:
+      std::vector<uint32_t> _ids; /**< feature ids, in increasing order. */
+      std::vector<float> _weights; /**< feature weights. */
+  };
+
+} /* end of namespace. */
+
+#endif
@@ -86,9 +86,14 @@ namespace lsh
   }
 
   bool stopwordlist::has_word(const std::string &w) const
+  {
+    return has_word(w.c_str());
+  }
+
+  bool stopwordlist::has_word(const char *w) const
   {
     hash_map<const char*,bool,hash<const char*>,eqstr>::const_iterator hit;
-    if ((hit=_swlist.find(w.c_str()))!=_swlist.end())
+    if ((hit=_swlist.find(w))!=_swlist.end())
       return true;
     else return false;
   }
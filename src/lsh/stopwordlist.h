@@ -38,6 +38,8 @@ namespace lsh
 
       bool has_word(const std::string &w) const;
 
+      bool has_word(const char *w) const;
+
       std::string _swlistfile;
       hash_map<const char*,bool,hash<const char*>,eqstr> _swlist;
       bool _loaded;
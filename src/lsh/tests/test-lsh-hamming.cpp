@@ -0,0 +1,130 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Benchmark of the Hamming LSH system, as used for regrouping results:
+ * a system built for every query and strings hashed bit by bit, against
+ * the shared system and strings hashed as 64 bit words.
+ */
+
+#include "LSHSystemHamming.h"
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace lsh;
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+// keys of a string, bit by bit.
+static void bit_keys(const LSHSystemHamming *lsh, const std::string &str,
+                     unsigned long int *Lmkeys, unsigned long int *Lckeys,
+                     const unsigned int &uhsize)
+{
+  std::bitset<LSHSystemHamming::_total_bits> bb_str;
+  lsh->strToBits(str,bb_str);
+  std::bitset<LSHSystemHamming::_total_bits> *bb_hash
+  = new std::bitset<LSHSystemHamming::_total_bits>[lsh->_Ld];
+  lsh->LprojectStr(bb_str,lsh->_Ld,bb_hash);
+  lsh->LmainHash(bb_hash,uhsize,Lmkeys);
+  lsh->LcontrolHash(bb_hash,Lckeys);
+  delete[] bb_hash;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 3)
+    {
+      std::cout << "Usage: <number of queries> <strings per query>\n";
+      exit(0);
+    }
+
+  int nqueries = atoi(argv[1]);
+  int nstrings = atoi(argv[2]);
+
+  std::vector<std::string> strs;
+  for (int s=0; s<nstrings; s++)
+    {
+      char buf[128];
+      snprintf(buf,sizeof(buf),"http://www.seeks-project.info/search?q=query%d&page=%d&expansion=%d",
+               s,s%10,s%3);
+      strs.push_back(buf);
+    }
+
+  unsigned long int Lmkeys[30], Lckeys[30];
+  unsigned long int check_bits = 0, check_words = 0;
+
+  // a system per query, bit keys.
+  struct timeval tv_start;
+  gettimeofday(&tv_start,NULL);
+  double setup_bits = 0.0;
+  for (int q=0; q<nqueries; q++)
+    {
+      struct timeval tv_setup;
+      gettimeofday(&tv_setup,NULL);
+      LSHSystemHamming *lsh = new LSHSystemHamming(55,5);
+      setup_bits += elapsed_ms(tv_setup);
+      for (int s=0; s<nstrings; s++)
+        {
+          bit_keys(lsh,strs[s],Lmkeys,Lckeys,150);
+          check_bits += Lmkeys[0] + Lckeys[lsh->_Ld-1];
+        }
+      delete lsh;
+    }
+  double bits_ms = elapsed_ms(tv_start);
+
+  // shared system, word keys.
+  gettimeofday(&tv_start,NULL);
+  double setup_words = 0.0;
+  for (int q=0; q<nqueries; q++)
+    {
+      struct timeval tv_setup;
+      gettimeofday(&tv_setup,NULL);
+      const LSHSystemHamming *lsh = LSHSystemHamming::getShared(55,5);
+      setup_words += elapsed_ms(tv_setup);
+      for (int s=0; s<nstrings; s++)
+        {
+          lsh->LKeysFromStr(strs[s],Lmkeys,Lckeys,150);
+          check_words += Lmkeys[0] + Lckeys[lsh->_Ld-1];
+        }
+    }
+  double words_ms = elapsed_ms(tv_start);
+
+  if (check_bits != check_words)
+    {
+      std::cout << "[Error]: keys differ\n";
+      return 1;
+    }
+
+  double nkeys = nqueries * (double)nstrings;
+  std::cout << nqueries << " queries, " << nstrings << " strings each\n";
+  std::cout << "system per query, bits: " << setup_bits * 1000.0 / nqueries << " us setup/query, "
+            << nkeys * 1000.0 / (bits_ms - setup_bits) << " keys/s\n";
+  std::cout << "shared system, words: " << setup_words * 1000.0 / nqueries << " us setup/query, "
+            << nkeys * 1000.0 / (words_ms - setup_words) << " keys/s\n";
+  return 0;
+}
@@ -0,0 +1,193 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Precision and latency of near-duplicate detection with MinHash signatures
+ * and a banded index, against pairwise comparison of the exact sets of
+ * features, as when merging search results. Snippets are read from a file
+ * of recorded engine outputs, one 'url<tab>title<tab>summary' per line, or
+ * generated as variants of random texts.
+ */
+
+#include "minhash.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+using namespace lsh;
+
+static std::string delims = " \t\n,.;:!?()-'\"|/";
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+// exact set of features, as hashed by minhash.
+static void features(const std::string &txt, std::vector<uint64_t> &feats)
+{
+  std::vector<std::string> words;
+  std::string w;
+  for (size_t i=0; i<=txt.size(); i++)
+    {
+      if (i == txt.size() || strchr(delims.c_str(),txt[i]))
+        {
+          if (!w.empty())
+            words.push_back(w);
+          w.clear();
+        }
+      else w += txt[i];
+    }
+  for (size_t i=0; i<words.size(); i++)
+    {
+      uint64_t h = minhash::hash(words[i].c_str(),words[i].size());
+      feats.push_back(h);
+      if (i > 0)
+        {
+          uint64_t p = minhash::hash(words[i-1].c_str(),words[i-1].size());
+          feats.push_back((p * 1099511628211ULL) ^ (h >> 1));
+        }
+    }
+  std::sort(feats.begin(),feats.end());
+  feats.erase(std::unique(feats.begin(),feats.end()),feats.end());
+}
+
+static double jaccard(const std::vector<uint64_t> &f1, const std::vector<uint64_t> &f2)
+{
+  if (f1.empty() || f2.empty())
+    return 0.0;
+  std::vector<uint64_t> inter;
+  std::set_intersection(f1.begin(),f1.end(),f2.begin(),f2.end(),std::back_inserter(inter));
+  return inter.size() / static_cast<double>(f1.size() + f2.size() - inter.size());
+}
+
+static void generate(const int &nbase, std::vector<std::string> &txts)
+{
+  srandom(1);
+  for (int b=0; b<nbase; b++)
+    {
+      std::vector<std::string> words;
+      int nwords = 15 + random() % 25;
+      for (int i=0; i<nwords; i++)
+        {
+          char w[16];
+          snprintf(w,sizeof(w),"w%ld",random() % 5000);
+          words.push_back(w);
+        }
+
+      // variants with a few edited words, as from several engines.
+      int nvariants = 1 + random() % 3;
+      for (int v=0; v<nvariants; v++)
+        {
+          std::vector<std::string> vw = words;
+          int nedits = v == 0 ? 0 : random() % 3;
+          for (int e=0; e<nedits; e++)
+            vw[random() % vw.size()] = "edit";
+          std::string txt;
+          for (size_t i=0; i<vw.size(); i++)
+            txt += vw[i] + " ";
+          txts.push_back(txt);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+    {
+      std::cout << "Usage: <recorded snippets file | number of random texts> [similarity threshold]\n";
+      exit(0);
+    }
+
+  double threshold = 0.7;
+  if (argc > 2)
+    threshold = atof(argv[2]);
+
+  std::vector<std::string> txts;
+  std::ifstream in(argv[1]);
+  if (in)
+    {
+      std::string line;
+      while (std::getline(in,line))
+        {
+          size_t t = line.find('\t');
+          if (t != std::string::npos)
+            txts.push_back(line.substr(t+1));
+        }
+    }
+  else generate(atoi(argv[1]),txts);
+  size_t n = txts.size();
+
+  // pairwise exact comparison.
+  struct timeval tv_start;
+  gettimeofday(&tv_start,NULL);
+  std::vector<std::vector<uint64_t> > feats(n);
+  std::set<std::pair<size_t,size_t> > ref_dups;
+  for (size_t i=0; i<n; i++)
+    {
+      features(txts[i],feats[i]);
+      for (size_t j=0; j<i; j++)
+        {
+          if (jaccard(feats[i],feats[j]) >= threshold)
+            ref_dups.insert(std::pair<size_t,size_t>(j,i));
+        }
+    }
+  double ref_ms = elapsed_ms(tv_start);
+
+  // signatures and banded index.
+  gettimeofday(&tv_start,NULL);
+  minhash_index index;
+  std::set<std::pair<size_t,size_t> > dups;
+  for (size_t i=0; i<n; i++)
+    {
+      minhash_signature sig;
+      minhash::signature(txts[i],delims,sig);
+      std::vector<uint32_t> ids;
+      index.find(sig,threshold,ids);
+      for (size_t d=0; d<ids.size(); d++)
+        dups.insert(std::pair<size_t,size_t>(ids[d],i));
+      index.add(sig,i);
+    }
+  double idx_ms = elapsed_ms(tv_start);
+
+  size_t tp = 0;
+  std::set<std::pair<size_t,size_t> >::const_iterator sit;
+  for (sit=dups.begin(); sit!=dups.end(); ++sit)
+    {
+      if (ref_dups.find(*sit) != ref_dups.end())
+        tp++;
+    }
+
+  std::cout << n << " snippets, " << ref_dups.size() << " duplicate pairs at similarity "
+            << threshold << std::endl;
+  std::cout << "pairwise exact: " << ref_ms * 1000.0 / n << " us/snippet\n";
+  std::cout << "minhash index: " << idx_ms * 1000.0 / n << " us/snippet, precision "
+            << (dups.empty() ? 1.0 : tp / (double)dups.size()) << ", recall "
+            << (ref_dups.empty() ? 1.0 : tp / (double)ref_dups.size()) << std::endl;
+  return 0;
+}
@@ -0,0 +1,248 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Time and heap allocations to produce the mrf features of snippet
+ * summaries and queries, with string tokens and str_chain queues
+ * against token views and chains of token indexes.
+ */
+
+#include "mrf.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace lsh;
+
+typedef hash_map<uint32_t,float,id_hash_uint> bag;
+
+static unsigned long nallocs = 0;
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+  ++nallocs;
+  void *p = malloc(size);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) throw()
+{
+  free(p);
+}
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+static void generate(const int &n, std::vector<std::string> &txts)
+{
+  for (int s=0; s<n; s++)
+    {
+      std::string txt;
+      int nwords = 15 + random() % 25;
+      for (int i=0; i<nwords; i++)
+        {
+          char w[16];
+          long r = random() % 5000;
+          snprintf(w,sizeof(w),"w%ld ",r * r / 5000);
+          txt += w;
+        }
+      txts.push_back(txt);
+    }
+}
+
+// features with string tokens and str_chain queues.
+static void str_chain_features(const std::string &str,
+                               std::vector<uint32_t> &features,
+                               const int &max_radius,
+                               const uint32_t &window_length)
+{
+  std::vector<std::string> tokens;
+  mrf::tokenize(str,tokens,mrf::_default_delims);
+  while (!tokens.empty())
+    {
+      std::vector<std::string> wtokens(tokens.begin(),
+                                       tokens.begin()+std::min((size_t)window_length,tokens.size()));
+      if (wtokens.size() < window_length-max_radius)
+        break;
+      mrf::mrf_build(wtokens,features,0,max_radius,0,window_length);
+      tokens.erase(tokens.begin());
+    }
+  std::sort(features.begin(),features.end());
+}
+
+static void str_chain_wfeatures(const std::string &str,
+                                bag &wfeatures,
+                                const int &max_radius,
+                                const uint32_t &window_length)
+{
+  std::vector<std::string> tokens;
+  mrf::tokenize(str,tokens,mrf::_default_delims);
+  for (size_t i=0; i<tokens.size(); i++)
+    std::transform(tokens[i].begin(),tokens[i].end(),tokens[i].begin(),tolower);
+  while (!tokens.empty())
+    {
+      std::vector<std::string> wtokens(tokens.begin(),
+                                       tokens.begin()+std::min((size_t)window_length,tokens.size()));
+      if (wtokens.size() < window_length-max_radius)
+        break;
+      mrf::mrf_build(wtokens,wfeatures,NULL,0,max_radius,0,window_length);
+      tokens.erase(tokens.begin());
+    }
+}
+
+static void str_chain_query(const std::string &str,
+                            std::vector<f160r> &features)
+{
+  std::vector<std::string> tokens;
+  mrf::tokenize(str,tokens,mrf::_default_delims);
+  uint32_t window_length = std::min((int)tokens.size(),5);
+  while (!tokens.empty())
+    {
+      mrf::mrf_build(tokens,features,0,5,0,window_length);
+      tokens.erase(tokens.begin());
+    }
+}
+
+static void free_features(std::vector<f160r> &features)
+{
+  for (size_t i=0; i<features.size(); i++)
+    delete[] features[i]._feat;
+  features.clear();
+}
+
+static void report(const char *name, const int &n,
+                   const double &ref_ms, const unsigned long &ref_allocs,
+                   const double &ms, const unsigned long &allocs,
+                   const bool &same)
+{
+  std::cout << name << "\t" << ref_ms << "\t\t" << ms << "\t\t" << ref_ms / ms
+            << "x\t\t" << ref_allocs / n << " / " << allocs / n
+            << "\t\t" << (same ? "yes" : "NO") << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+    {
+      std::cout << "Usage: <snippets>\n";
+      exit(0);
+    }
+
+  int n = atoi(argv[1]);
+  srandom(1);
+  std::vector<std::string> txts;
+  generate(n,txts);
+
+  std::cout << "features\tstr_chain (ms)\tviews (ms)\tspeedup\t\tallocs per call\t\tidentical\n";
+
+  // uint32 features of windows of 5 tokens, as for snippet fingerprints.
+  struct timeval tv_start;
+  bool same = true;
+  unsigned long allocs = nallocs;
+  gettimeofday(&tv_start,NULL);
+  std::vector<std::vector<uint32_t> > ref(n);
+  for (int i=0; i<n; i++)
+    str_chain_features(txts[i],ref[i],5,5);
+  double ref_ms = elapsed_ms(tv_start);
+  unsigned long ref_allocs = nallocs - allocs;
+
+  allocs = nallocs;
+  gettimeofday(&tv_start,NULL);
+  std::vector<std::vector<uint32_t> > features(n);
+  for (int i=0; i<n; i++)
+    mrf::tokenize_and_mrf_features(txts[i],mrf::_default_delims,features[i],5,1,5);
+  double ms = elapsed_ms(tv_start);
+  allocs = nallocs - allocs;
+  for (int i=0; i<n; i++)
+    same = same && (ref[i] == features[i]);
+  report("window 5",n,ref_ms,ref_allocs,ms,allocs,same);
+
+  // tf-idf bags of windows of 2 tokens.
+  same = true;
+  allocs = nallocs;
+  gettimeofday(&tv_start,NULL);
+  std::vector<bag> ref_bags(n);
+  for (int i=0; i<n; i++)
+    str_chain_wfeatures(txts[i],ref_bags[i],1,2);
+  ref_ms = elapsed_ms(tv_start);
+  ref_allocs = nallocs - allocs;
+
+  allocs = nallocs;
+  gettimeofday(&tv_start,NULL);
+  std::vector<bag> bags(n);
+  for (int i=0; i<n; i++)
+    mrf::tokenize_and_mrf_features(txts[i],mrf::_default_delims,bags[i],NULL,1,1,2);
+  ms = elapsed_ms(tv_start);
+  allocs = nallocs - allocs;
+  for (int i=0; i<n; i++)
+    {
+      same = same && (ref_bags[i].size() == bags[i].size());
+      bag::const_iterator hit = ref_bags[i].begin();
+      while (same && hit!=ref_bags[i].end())
+        {
+          bag::const_iterator bit = bags[i].find((*hit).first);
+          same = (bit != bags[i].end() && (*bit).second == (*hit).second);
+          ++hit;
+        }
+    }
+  report("tf-idf 2",n,ref_ms,ref_allocs,ms,allocs,same);
+
+  // 160bit features of queries.
+  same = true;
+  std::vector<std::string> queries;
+  for (int i=0; i<n; i++)
+    queries.push_back(txts[i].substr(0,txts[i].find(' ',20)));
+  ref_ms = ms = 0.0;
+  ref_allocs = allocs = 0;
+  for (int i=0; i<n; i++)
+    {
+      std::vector<f160r> ref_query, query;
+      unsigned long a = nallocs;
+      gettimeofday(&tv_start,NULL);
+      str_chain_query(queries[i],ref_query);
+      ref_ms += elapsed_ms(tv_start);
+      ref_allocs += nallocs - a;
+
+      a = nallocs;
+      gettimeofday(&tv_start,NULL);
+      mrf::mrf_features_query(queries[i],query,0,5);
+      ms += elapsed_ms(tv_start);
+      allocs += nallocs - a;
+
+      same = same && ref_query.size() == query.size();
+      for (size_t j=0; same && j<query.size(); j++)
+        same = (ref_query[j]._radius == query[j]._radius
+                && memcmp(ref_query[j]._feat,query[j]._feat,20) == 0);
+      free_features(ref_query);
+      free_features(query);
+    }
+  report("query 160",n,ref_ms,ref_allocs,ms,allocs,same);
+}
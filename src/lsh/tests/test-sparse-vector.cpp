@@ -0,0 +1,220 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Benchmark of tf-idf feature vectors as hash maps, probed one feature at a
+ * time, against sorted sparse vectors, on the two uses of snippet features:
+ * similarity scoring against a reference snippet, and online k-means as in
+ * the websearch plugin's oskmeans.
+ */
+
+#include "sparse_vector.h"
+
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace lsh;
+
+typedef hash_map<uint32_t,float,id_hash_uint> hfeatures;
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+/*- hash map kernels. -*/
+static float hdot(const hfeatures &p1, const hfeatures &p2)
+{
+  float dist = 0.0;
+  hfeatures::const_iterator hit, hit2;
+  for (hit=p1.begin(); hit!=p1.end(); ++hit)
+    {
+      if ((hit2=p2.find((*hit).first))!=p2.end())
+        dist += (*hit).second * (*hit2).second;
+    }
+  return dist;
+}
+
+static float hnorm(const hfeatures &p)
+{
+  float n = 0.0;
+  hfeatures::const_iterator hit;
+  for (hit=p.begin(); hit!=p.end(); ++hit)
+    n += (*hit).second * (*hit).second;
+  return sqrt(n);
+}
+
+static void hkmeans(const std::vector<hfeatures*> &points, const int &K, const int &niter,
+                    std::vector<hfeatures> &centroids)
+{
+  centroids.clear();
+  for (int c=0; c<K; c++)
+    centroids.push_back(*points[c * points.size() / K]);
+  float t = 0;
+  for (int it=0; it<niter; it++)
+    for (size_t p=0; p<points.size(); p++)
+      {
+        float lr = pow(0.01,t / (points.size() * niter));
+        float max_d = 0.0;
+        int cl = -1;
+        for (int c=0; c<K; c++)
+          {
+            float d = hdot(*points[p],centroids[c]);
+            if (d > max_d)
+              {
+                max_d = d;
+                cl = c;
+              }
+          }
+        if (cl >= 0)
+          {
+            float cl_norm = 0.0;
+            hfeatures::const_iterator phit;
+            hfeatures::iterator chit;
+            for (phit=points[p]->begin(); phit!=points[p]->end(); ++phit)
+              {
+                float update = lr * (*phit).second;
+                if ((chit=centroids[cl].find((*phit).first))!=centroids[cl].end())
+                  {
+                    (*chit).second += update;
+                    cl_norm += (*chit).second;
+                  }
+                else
+                  {
+                    centroids[cl].insert(std::pair<uint32_t,float>((*phit).first,update));
+                    cl_norm += update;
+                  }
+              }
+            for (chit=centroids[cl].begin(); chit!=centroids[cl].end(); ++chit)
+              (*chit).second /= cl_norm;
+          }
+        t++;
+      }
+}
+
+/*- sparse vector kernels. -*/
+static void skmeans(const std::vector<sparse_vector*> &points, const int &K, const int &niter,
+                    std::vector<sparse_vector> &centroids)
+{
+  centroids.clear();
+  for (int c=0; c<K; c++)
+    centroids.push_back(*points[c * points.size() / K]);
+  float t = 0;
+  for (int it=0; it<niter; it++)
+    for (size_t p=0; p<points.size(); p++)
+      {
+        float lr = pow(0.01,t / (points.size() * niter));
+        float max_d = 0.0;
+        int cl = -1;
+        for (int c=0; c<K; c++)
+          {
+            float d = points[p]->dot(centroids[c]);
+            if (d > max_d)
+              {
+                max_d = d;
+                cl = c;
+              }
+          }
+        if (cl >= 0)
+          {
+            float cl_norm = centroids[cl].add(*points[p],lr);
+            centroids[cl].scale(1.0 / cl_norm);
+          }
+        t++;
+      }
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 3)
+    {
+      std::cout << "Usage: <number of snippets> <features per snippet> [number of clusters] [iterations]\n";
+      exit(0);
+    }
+
+  int nsnippets = atoi(argv[1]);
+  int nfeatures = atoi(argv[2]);
+  int K = argc > 3 ? atoi(argv[3]) : 10;
+  int niter = argc > 4 ? atoi(argv[4]) : 20;
+
+  // snippets share features drawn from a vocabulary, zipf-like.
+  srandom(1);
+  std::vector<hfeatures*> hpoints;
+  std::vector<sparse_vector*> spoints;
+  uint32_t vocabulary = nfeatures * 20;
+  for (int s=0; s<nsnippets; s++)
+    {
+      hfeatures *f = new hfeatures();
+      while ((int)f->size() < nfeatures)
+        {
+          double u = (random() + 1.0) / ((double)RAND_MAX + 2.0);
+          uint32_t id = static_cast<uint32_t>(vocabulary * u * u) * 2654435761u;
+          (*f)[id] = (random() % 1000) / 1000.0;
+        }
+      hpoints.push_back(f);
+      spoints.push_back(new sparse_vector(*f));
+    }
+
+  // similarity scoring: every snippet against every other as reference.
+  struct timeval tv_start;
+  gettimeofday(&tv_start,NULL);
+  double hsum = 0.0;
+  for (int r=0; r<nsnippets; r++)
+    for (int s=0; s<nsnippets; s++)
+      hsum += hdot(*hpoints[r],*hpoints[s]) / (hnorm(*hpoints[r]) * hnorm(*hpoints[s]));
+  double hscore_ms = elapsed_ms(tv_start);
+
+  gettimeofday(&tv_start,NULL);
+  double ssum = 0.0;
+  for (int r=0; r<nsnippets; r++)
+    for (int s=0; s<nsnippets; s++)
+      ssum += spoints[r]->dot(*spoints[s]) / (spoints[r]->norm() * spoints[s]->norm());
+  double sscore_ms = elapsed_ms(tv_start);
+
+  // clustering.
+  std::vector<hfeatures> hcentroids;
+  gettimeofday(&tv_start,NULL);
+  hkmeans(hpoints,K,niter,hcentroids);
+  double hkm_ms = elapsed_ms(tv_start);
+
+  std::vector<sparse_vector> scentroids;
+  gettimeofday(&tv_start,NULL);
+  skmeans(spoints,K,niter,scentroids);
+  double skm_ms = elapsed_ms(tv_start);
+
+  double npairs = nsnippets * (double)nsnippets;
+  std::cout << nsnippets << " snippets, " << nfeatures << " features each, "
+            << K << " clusters, " << niter << " iterations\n";
+  std::cout << "hash maps: " << hscore_ms * 1000000.0 / npairs << " ns/similarity, k-means "
+            << hkm_ms << " ms (checksum " << hsum << ")\n";
+  std::cout << "sparse vectors: " << sscore_ms * 1000000.0 / npairs << " ns/similarity, k-means "
+            << skm_ms << " ms (checksum " << ssum << ")\n";
+
+  for (int s=0; s<nsnippets; s++)
+    {
+      delete hpoints[s];
+      delete spoints[s];
+    }
+  return 0;
+}
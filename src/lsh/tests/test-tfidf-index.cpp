@@ -0,0 +1,184 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Time to compute the tf-idf features of the cached snippets of a query
+ * context as it is expanded, each expansion bringing in a page of new
+ * snippets: recomputing the features of every snippet, with the former
+ * df computation that probes every bag for every feature or with
+ * mrf::compute_tf_idf, against maintaining document frequencies in a
+ * tfidf_index so that only the new snippets are tokenized.
+ */
+
+#include "tfidf_index.h"
+#include "mrf.h"
+
+#include <iostream>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace lsh;
+
+typedef hash_map<uint32_t,float,id_hash_uint> bag;
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+// snippet summaries, with words drawn from a skewed vocabulary.
+static void generate(const int &n, std::vector<std::string> &txts)
+{
+  for (int s=0; s<n; s++)
+    {
+      std::string txt;
+      int nwords = 15 + random() % 25;
+      for (int i=0; i<nwords; i++)
+        {
+          char w[16];
+          long r = random() % 5000;
+          snprintf(w,sizeof(w),"w%ld ",r * r / 5000);
+          txt += w;
+        }
+      txts.push_back(txt);
+    }
+}
+
+static void features(const std::string &txt, bag &tf)
+{
+  mrf::tokenize_and_mrf_features(txt,mrf::_default_delims,tf,NULL,1,1,1); // as for snippets.
+}
+
+// the former computation, df of each feature by probing every bag.
+static void probing_tf_idf(std::vector<bag*> &bags)
+{
+  size_t nbags = bags.size();
+  hash_map<uint32_t,uint32_t,id_hash_uint> cached_df;
+  hash_map<uint32_t,uint32_t,id_hash_uint>::const_iterator cache_hit;
+  bag::const_iterator chit;
+  for (size_t i=0; i<nbags; i++)
+    {
+      float norm = 0.0;
+      bag::iterator hit = bags.at(i)->begin();
+      while (hit!=bags.at(i)->end())
+        {
+          uint32_t df = 0;
+          if ((cache_hit = cached_df.find((*hit).first))!=cached_df.end())
+            df = (*cache_hit).second;
+          else
+            {
+              for (size_t j=0; j<nbags; j++)
+                {
+                  if ((chit=bags.at(j)->find((*hit).first))!=bags.at(j)->end())
+                    if ((*chit).second != 0.0)
+                      df++;
+                }
+              cached_df.insert(std::pair<uint32_t,uint32_t>((*hit).first,df));
+            }
+          float idf = logf(static_cast<float>(nbags) / (static_cast<float>(df)));
+          (*hit).second *= idf;
+          norm += (*hit).second;
+          ++hit;
+        }
+      if (norm == 0.0)
+        continue;
+      hit = bags.at(i)->begin();
+      while (hit!=bags.at(i)->end())
+        {
+          (*hit).second /= norm;
+          ++hit;
+        }
+    }
+}
+
+// features of every snippet, from scratch.
+static double full(const std::vector<std::string> &txts, const size_t &n,
+                   void (*tf_idf)(std::vector<bag*>&),
+                   std::vector<sparse_vector> &weights)
+{
+  struct timeval tv_start;
+  gettimeofday(&tv_start,NULL);
+  std::vector<bag*> bags;
+  for (size_t i=0; i<n; i++)
+    {
+      bags.push_back(new bag());
+      features(txts[i],*bags.back());
+    }
+  tf_idf(bags);
+  weights.resize(n);
+  for (size_t i=0; i<n; i++)
+    {
+      weights[i] = sparse_vector(*bags[i]);
+      delete bags[i];
+    }
+  return elapsed_ms(tv_start);
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 3)
+    {
+      std::cout << "Usage: <snippets per expansion> <expansion depth>\n";
+      exit(0);
+    }
+
+  int page = atoi(argv[1]);
+  int depth = atoi(argv[2]);
+  srandom(1);
+  std::vector<std::string> txts;
+  generate(page * depth,txts);
+
+  tfidf_index ti;
+  std::vector<sparse_vector> ref, weights;
+  double max_err = 0.0;
+  std::cout << "expansion\tsnippets\tprobing df (ms)\tfull recompute (ms)\tincremental (ms)\n";
+  for (int d=1; d<=depth; d++)
+    {
+      size_t n = d * page;
+      double probing_ms = full(txts,n,&probing_tf_idf,ref);
+      double full_ms = full(txts,n,&mrf::compute_tf_idf,ref);
+
+      struct timeval tv_start;
+      gettimeofday(&tv_start,NULL);
+      for (size_t i=n-page; i<n; i++)
+        {
+          bag tf;
+          features(txts[i],tf);
+          ti.add(i,tf);
+        }
+      weights.resize(n);
+      for (size_t i=0; i<n; i++)
+        ti.weights(i,weights[i]);
+      double inc_ms = elapsed_ms(tv_start);
+
+      for (size_t i=0; i<n; i++)
+        for (size_t f=0; f<weights[i].size(); f++)
+          max_err = std::max(max_err,(double)fabs(weights[i]._weights[f] - ref[i]._weights[f]));
+
+      std::cout << d << "\t\t" << n << "\t\t" << probing_ms << "\t\t" << full_ms
+                << "\t\t\t" << inc_ms << std::endl;
+    }
+  std::cout << "max weight difference: " << max_err << std::endl;
+  return 0;
+}
@@ -0,0 +1,139 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "LSHSystemHamming.h"
+#include "LSHUniformHashTableHamming.h"
+
+#include <stdlib.h>
+
+using namespace lsh;
+
+static const char *strs[] =
+{
+  "seeks project", "http://www.seeks-project.info/", "",
+  "a very long string that goes well beyond the hundred characters limit of the hamming system, so that it gets truncated at some point",
+  "\xe9t\xe9 \xe0 Paris", NULL
+};
+
+TEST(LSHSystemHammingTest, random_generator)
+{
+  // same sequence as the C library generator.
+  unsigned int seeds[] = { 0, 1, 945792045, 907452457 };
+  for (int s=0; s<4; s++)
+    {
+      RandomGenerator rng(seeds[s]);
+      srandom(seeds[s]);
+      for (int i=0; i<1000; i++)
+        ASSERT_EQ(random(),rng.next());
+    }
+}
+
+TEST(LSHSystemHammingTest, get_shared)
+{
+  const LSHSystemHamming *lsh1 = LSHSystemHamming::getShared(55,5);
+  const LSHSystemHamming *lsh2 = LSHSystemHamming::getShared(55,5);
+  const LSHSystemHamming *lsh3 = LSHSystemHamming::getShared(7,30);
+  EXPECT_EQ(lsh1,lsh2);
+  EXPECT_NE(lsh1,lsh3);
+  EXPECT_EQ(5u,lsh1->_Ld);
+  EXPECT_EQ(30u,lsh3->_Ld);
+  EXPECT_TRUE(lsh1->isInitialized());
+}
+
+TEST(LSHSystemHammingTest, fixed_keys)
+{
+  // keys do not change across versions and machines.
+  const LSHSystemHamming *lsh = LSHSystemHamming::getShared(55,5);
+  unsigned long int Lmkeys[5], Lckeys[5];
+  lsh->LKeysFromStr(strs[0],Lmkeys,Lckeys,150);
+  unsigned long int mkeys[5] = { 119, 44, 33, 147, 6 };
+  unsigned long int ckeys[5] = { 7411705518ul, 7159868632ul, 7964283580ul, 7202942758ul, 6504172949ul };
+  for (int l=0; l<5; l++)
+    {
+      EXPECT_EQ(mkeys[l],Lmkeys[l]);
+      EXPECT_EQ(ckeys[l],Lckeys[l]);
+    }
+
+  lsh = LSHSystemHamming::getShared(7,30);
+  unsigned long int Lmkeys2[30], Lckeys2[30];
+  lsh->LKeysFromStr(strs[1],Lmkeys2,Lckeys2,150);
+  EXPECT_EQ(136u,Lmkeys2[0]);
+  EXPECT_EQ(1286099932ul,Lckeys2[0]);
+  EXPECT_EQ(92u,Lmkeys2[2]);
+  EXPECT_EQ(1953644314ul,Lckeys2[2]);
+}
+
+TEST(LSHSystemHammingTest, words_bits)
+{
+  const LSHSystemHamming *lsh = LSHSystemHamming::getShared(7,30);
+  std::bitset<LSHSystemHamming::_total_bits> bb_hash[30];
+  for (int s=0; strs[s]!=NULL; s++)
+    {
+      // word and bit keys.
+      std::bitset<LSHSystemHamming::_total_bits> bb_str;
+      lsh->strToBits(strs[s],bb_str);
+      lsh->LprojectStr(bb_str,lsh->_Ld,bb_hash);
+      unsigned long int bmkeys[30], bckeys[30];
+      lsh->LmainHash(bb_hash,150,bmkeys);
+      lsh->LcontrolHash(bb_hash,bckeys);
+
+      unsigned long int Lmkeys[30], Lckeys[30], Lmkeys2[30], Lckeys2[30];
+      lsh->LKeysFromStr(strs[s],Lmkeys,Lckeys,150);
+      lsh->LmainKeyFromStr(strs[s],Lmkeys2,150);
+      lsh->LcontrolKeyFromStr(strs[s],Lckeys2);
+      for (unsigned int l=0; l<lsh->_Ld; l++)
+        {
+          EXPECT_EQ(bmkeys[l],Lmkeys[l]);
+          EXPECT_EQ(bckeys[l],Lckeys[l]);
+          EXPECT_EQ(bmkeys[l],Lmkeys2[l]);
+          EXPECT_EQ(bckeys[l],Lckeys2[l]);
+        }
+
+      // distances.
+      uint64_t words[LSHSystemHamming::_total_words], words0[LSHSystemHamming::_total_words];
+      std::bitset<LSHSystemHamming::_total_bits> bb_str0;
+      lsh->strToBits(strs[0],bb_str0);
+      LSHSystemHamming::strToWords(strs[s],words);
+      LSHSystemHamming::strToWords(strs[0],words0);
+      EXPECT_EQ(lsh->distance(bb_str,bb_str0),lsh->distance(words,words0));
+    }
+}
+
+TEST(LSHSystemHammingTest, uniform_hashtable)
+{
+  const LSHSystemHamming *lsh = LSHSystemHamming::getShared(55,5);
+  LSHUniformHashTableHamming ulsh(lsh,150);
+  ulsh.add("seeks project",lsh->_Ld);
+  ulsh.add("www.google.com",lsh->_Ld);
+  std::map<double,const std::string,std::greater<double> > res
+  = ulsh.getLEltsWithProbabilities("seeks project",lsh->_Ld);
+  ASSERT_FALSE(res.empty());
+  EXPECT_EQ("seeks project",(*res.begin()).second);
+  EXPECT_DOUBLE_EQ(1.0,(*res.begin()).first);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
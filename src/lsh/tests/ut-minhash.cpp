@@ -0,0 +1,106 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "minhash.h"
+
+using namespace lsh;
+
+static std::string delims = " \t\n,.;:!?()-";
+
+static std::string txt1 = "Seeks is a free and open source search platform that captures, ranks and shares the results of your queries with other users in a decentralized manner.";
+static std::string txt2 = "Seeks is a free and open source search platform that captures, ranks and shares the results of your queries with other users in a distributed manner.";
+static std::string txt3 = "The weather in Paris will be sunny with a light breeze from the west, temperatures are expected to rise slowly during the afternoon.";
+
+TEST(MinhashTest, signature)
+{
+  minhash_signature sig1, sig1b, sig1c, sig2, sig3;
+  minhash::signature(txt1,delims,sig1);
+  EXPECT_FALSE(sig1.empty());
+  minhash::signature(txt1,delims,sig1b);
+  EXPECT_DOUBLE_EQ(1.0,sig1.similarity(sig1b));
+
+  // case and delimiters do not matter.
+  minhash::signature("  SEEKS is a free, and open source search platform that captures ranks and shares the results of your queries with other users in a decentralized manner",delims,sig1c);
+  EXPECT_DOUBLE_EQ(1.0,sig1.similarity(sig1c));
+
+  minhash::signature(txt2,delims,sig2);
+  minhash::signature(txt3,delims,sig3);
+  EXPECT_GE(sig1.similarity(sig2),0.7);
+  EXPECT_LT(sig1.similarity(sig3),0.2);
+}
+
+TEST(MinhashTest, min_words)
+{
+  minhash_signature sig;
+  minhash::signature("",delims,sig);
+  EXPECT_TRUE(sig.empty());
+  minhash::signature(" , ",delims,sig);
+  EXPECT_TRUE(sig.empty());
+  minhash::signature("home page",delims,sig,8);
+  EXPECT_TRUE(sig.empty());
+  EXPECT_DOUBLE_EQ(0.0,sig.similarity(sig));
+  minhash::signature("home page",delims,sig,2);
+  EXPECT_FALSE(sig.empty());
+  EXPECT_EQ(3u,sig._nfeatures);
+}
+
+TEST(MinhashTest, index)
+{
+  minhash_signature sig1, sig2, sig3, empty;
+  minhash::signature(txt1,delims,sig1);
+  minhash::signature(txt2,delims,sig2);
+  minhash::signature(txt3,delims,sig3);
+
+  minhash_index index;
+  index.add(sig2,2);
+  index.add(sig3,3);
+  index.add(sig1,1);
+  index.add(empty,4);
+  EXPECT_EQ(3u,index.size());
+
+  std::vector<uint32_t> ids;
+  index.find(sig1,0.7,ids);
+  ASSERT_EQ(2u,ids.size());
+  EXPECT_EQ(1u,ids[0]);
+  EXPECT_EQ(2u,ids[1]);
+
+  ids.clear();
+  index.find(sig3,0.7,ids);
+  ASSERT_EQ(1u,ids.size());
+  EXPECT_EQ(3u,ids[0]);
+
+  ids.clear();
+  index.find(empty,0.0,ids);
+  EXPECT_TRUE(ids.empty());
+
+  index.clear();
+  EXPECT_EQ(0u,index.size());
+  index.find(sig1,0.7,ids);
+  EXPECT_TRUE(ids.empty());
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
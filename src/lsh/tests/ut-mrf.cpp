@@ -23,6 +23,9 @@
 
 #include "mrf.h"
 
+#include <algorithm>
+#include <cctype>
+
 using namespace lsh;
 
 TEST(MrfTest, str_chain)
@@ -57,6 +60,148 @@ TEST(MrfTest, str_chain)
   EXPECT_FALSE(s3.has_skip());
 }
 
+TEST(MrfTest, mrf_chains)
+{
+  // chains ending with a token, in generation order, skips as 'S'.
+  const char *ref[] = { "0", "01", "012", "0S2", "0123", "01S3", "0S23", "0SS3" };
+  const int ref_radius[] = { 3, 2, 1, 2, 0, 1, 1, 2 };
+  mrf_chains chains(4,3);
+  int c = 0;
+  while (chains.next())
+    {
+      ASSERT_LT(c,8);
+      std::string sc;
+      for (uint32_t i=0; i<chains._chain._size; i++)
+        sc += (chains._chain._idx[i] == MRF_SKIP) ? 'S' : '0' + chains._chain._idx[i];
+      EXPECT_EQ(ref[c],sc);
+      EXPECT_EQ(ref_radius[c],chains._chain._radius);
+      ++c;
+    }
+  EXPECT_EQ(8,c);
+}
+
+// features from string tokens and str_chain, sliding the window by step
+// (by the window when it is shorter).
+static void str_chain_features(const std::string &str,
+                               std::vector<uint32_t> &features,
+                               const int &max_radius,
+                               const int &step,
+                               const uint32_t &window_length)
+{
+  std::vector<std::string> tokens;
+  mrf::tokenize(str,tokens,mrf::_default_delims);
+  while (!tokens.empty())
+    {
+      std::vector<std::string> wtokens(tokens.begin(),
+                                       tokens.begin()+std::min((size_t)window_length,tokens.size()));
+      if (wtokens.size() < window_length-max_radius)
+        break;
+      mrf::mrf_build(wtokens,features,0,max_radius,0,window_length);
+      if ((int)wtokens.size()>step)
+        tokens.erase(tokens.begin(),tokens.begin()+step);
+      else tokens.erase(tokens.begin(),tokens.begin()+wtokens.size());
+    }
+  std::sort(features.begin(),features.end());
+}
+
+static void str_chain_wfeatures(const std::string &str,
+                                hash_map<uint32_t,float,id_hash_uint> &wfeatures,
+                                hash_map<uint32_t,std::string,id_hash_uint> *bow,
+                                const int &max_radius,
+                                const uint32_t &window_length)
+{
+  std::vector<std::string> tokens;
+  mrf::tokenize(str,tokens,mrf::_default_delims);
+  std::vector<std::string> ltokens;
+  for (size_t i=0; i<tokens.size(); i++)
+    {
+      if (isdigit(tokens[i][0]))
+        continue;
+      std::transform(tokens[i].begin(),tokens[i].end(),tokens[i].begin(),tolower);
+      ltokens.push_back(tokens[i]);
+    }
+  while (!ltokens.empty())
+    {
+      std::vector<std::string> wtokens(ltokens.begin(),
+                                       ltokens.begin()+std::min((size_t)window_length,ltokens.size()));
+      if (wtokens.size() < window_length-max_radius)
+        break;
+      mrf::mrf_build(wtokens,wfeatures,bow,0,max_radius,0,window_length);
+      ltokens.erase(ltokens.begin());
+    }
+}
+
+const char *texts[] =
+{
+  "seeks project",
+  "one two three four five six seven",
+  "The Seeks project is an open, decentralized platform for collaborative search.",
+  "a b a b a <skip> c 10 ab Ab aB zz, zz; zz",
+  ""
+};
+
+TEST(MrfTest, features_as_str_chains)
+{
+  for (size_t t=0; t<sizeof(texts)/sizeof(char*); t++)
+    for (uint32_t wl=1; wl<=6; wl++)
+      for (int r=0; r<(int)wl; r++)
+        for (int step=1; step<=2; step++)
+          {
+            std::vector<uint32_t> features, ref_features;
+            mrf::tokenize_and_mrf_features(texts[t],mrf::_default_delims,features,r,step,wl);
+            str_chain_features(texts[t],ref_features,r,step,wl);
+            ASSERT_EQ(ref_features,features);
+          }
+}
+
+TEST(MrfTest, wfeatures_as_str_chains)
+{
+  for (size_t t=0; t<sizeof(texts)/sizeof(char*); t++)
+    for (uint32_t wl=1; wl<=5; wl++)
+      for (int r=0; r<(int)wl; r++)
+        {
+          hash_map<uint32_t,float,id_hash_uint> wfeatures, ref_wfeatures;
+          hash_map<uint32_t,std::string,id_hash_uint> bow, ref_bow;
+          mrf::tokenize_and_mrf_features(texts[t],mrf::_default_delims,wfeatures,&bow,r,1,wl);
+          str_chain_wfeatures(texts[t],ref_wfeatures,&ref_bow,r,wl);
+          ASSERT_EQ(ref_wfeatures.size(),wfeatures.size());
+          hash_map<uint32_t,float,id_hash_uint>::const_iterator hit = ref_wfeatures.begin();
+          while (hit!=ref_wfeatures.end())
+            {
+              ASSERT_TRUE(wfeatures.find((*hit).first)!=wfeatures.end());
+              EXPECT_EQ((*hit).second,wfeatures[(*hit).first]);
+              ++hit;
+            }
+          ASSERT_EQ(ref_bow.size(),bow.size());
+          hash_map<uint32_t,std::string,id_hash_uint>::const_iterator bit = ref_bow.begin();
+          while (bit!=ref_bow.end())
+            {
+              EXPECT_EQ((*bit).second,bow[(*bit).first]);
+              ++bit;
+            }
+        }
+}
+
+TEST(MrfTest, query_features_as_str_chains)
+{
+  for (size_t t=0; t<sizeof(texts)/sizeof(char*); t++)
+    for (int r=0; r<=5; r++)
+      {
+        std::vector<uint32_t> features, ref_features;
+        mrf::mrf_features_query(texts[t],features,0,r);
+
+        std::vector<std::string> tokens;
+        mrf::tokenize(texts[t],tokens,mrf::_default_delims);
+        uint32_t window_length = std::min((int)tokens.size(),5);
+        while (!tokens.empty())
+          {
+            mrf::mrf_build(tokens,ref_features,0,r,0,window_length);
+            tokens.erase(tokens.begin());
+          }
+        ASSERT_EQ(ref_features,features);
+      }
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
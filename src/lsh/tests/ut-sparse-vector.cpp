@@ -0,0 +1,136 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "sparse_vector.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+using namespace lsh;
+
+// random features, with ids in a range small enough for many to be shared.
+static void random_features(const size_t &n, const uint32_t &range,
+                            hash_map<uint32_t,float,id_hash_uint> &features)
+{
+  while (features.size() < n)
+    {
+      uint32_t id = random() % range;
+      features[id] = (random() % 1000) / 100.0;
+    }
+}
+
+static float ref_dot(const hash_map<uint32_t,float,id_hash_uint> &f1,
+                     const hash_map<uint32_t,float,id_hash_uint> &f2)
+{
+  float d = 0.0;
+  hash_map<uint32_t,float,id_hash_uint>::const_iterator hit, hit2;
+  for (hit=f1.begin(); hit!=f1.end(); ++hit)
+    {
+      if ((hit2=f2.find((*hit).first))!=f2.end())
+        d += (*hit).second * (*hit2).second;
+    }
+  return d;
+}
+
+TEST(SparseVectorTest, build)
+{
+  hash_map<uint32_t,float,id_hash_uint> features;
+  features[12] = 1.0;
+  features[3] = 2.0;
+  features[7] = 3.0;
+  sparse_vector v(features);
+  ASSERT_EQ(3u,v.size());
+  EXPECT_EQ(3u,v._ids[0]);
+  EXPECT_EQ(7u,v._ids[1]);
+  EXPECT_EQ(12u,v._ids[2]);
+  EXPECT_FLOAT_EQ(2.0,v.get(3));
+  EXPECT_FLOAT_EQ(3.0,v.get(7));
+  EXPECT_FLOAT_EQ(0.0,v.get(8));
+  EXPECT_FLOAT_EQ(sqrt(14.0),v.norm());
+
+  sparse_vector e;
+  EXPECT_TRUE(e.empty());
+  EXPECT_FLOAT_EQ(0.0,e.norm());
+  EXPECT_FLOAT_EQ(0.0,e.dot(v));
+  EXPECT_FLOAT_EQ(0.0,v.dot(e));
+}
+
+TEST(SparseVectorTest, dot)
+{
+  srandom(7);
+  size_t sizes[] = { 1, 3, 4, 5, 17, 64, 250 };
+  for (int s1=0; s1<7; s1++)
+    for (int s2=0; s2<7; s2++)
+      {
+        hash_map<uint32_t,float,id_hash_uint> f1, f2;
+        random_features(sizes[s1],300,f1);
+        random_features(sizes[s2],300,f2);
+        sparse_vector v1(f1), v2(f2);
+        float d = ref_dot(f1,f2);
+        EXPECT_NEAR(d,v1.dot(v2),1e-4 * (1.0 + d));
+        EXPECT_NEAR(d,v2.dot(v1),1e-4 * (1.0 + d));
+        EXPECT_NEAR(sqrt(ref_dot(f1,f1)),v1.norm(),1e-4 * v1.norm());
+      }
+}
+
+TEST(SparseVectorTest, add)
+{
+  srandom(11);
+  hash_map<uint32_t,float,id_hash_uint> f1, f2;
+  random_features(40,100,f1);
+  random_features(30,100,f2);
+  sparse_vector v1(f1), v2(f2);
+
+  float updated = v1.add(v2,0.5);
+  float ref_updated = 0.0;
+  hash_map<uint32_t,float,id_hash_uint>::const_iterator hit;
+  for (hit=f2.begin(); hit!=f2.end(); ++hit)
+    {
+      f1[(*hit).first] += 0.5 * (*hit).second;
+      ref_updated += f1[(*hit).first];
+    }
+  EXPECT_NEAR(ref_updated,updated,1e-3);
+
+  sparse_vector ref(f1);
+  ASSERT_EQ(ref.size(),v1.size());
+  for (size_t i=0; i<ref.size(); i++)
+    {
+      EXPECT_EQ(ref._ids[i],v1._ids[i]);
+      EXPECT_FLOAT_EQ(ref._weights[i],v1._weights[i]);
+    }
+
+  // adding to an empty vector copies.
+  sparse_vector e;
+  e.add(v2);
+  ASSERT_EQ(v2.size(),e.size());
+  EXPECT_FLOAT_EQ(v2.norm(),e.norm());
+
+  e.scale(2.0);
+  EXPECT_FLOAT_EQ(2.0 * v2.norm(),e.norm());
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,148 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "tfidf_index.h"
+#include "mrf.h"
+
+#include <math.h>
+
+using namespace lsh;
+
+static const char *docs[] =
+{
+  "the seeks project is an open decentralized platform for collaborative search",
+  "seeks is a collaborative web search engine",
+  "a decentralized search platform, built on a peer to peer network",
+  "search results are shared among the users of the network",
+  "web search with a personalized filter"
+};
+
+static void features(const char *txt, hash_map<uint32_t,float,id_hash_uint> &tf)
+{
+  mrf::tokenize_and_mrf_features(txt,mrf::_default_delims,tf,NULL,1,1,1); // as for snippets.
+}
+
+// weights of the documents in the index against a full computation.
+static void expect_full_weights(const tfidf_index &ti, const std::vector<int> &ids)
+{
+  std::vector<hash_map<uint32_t,float,id_hash_uint>*> bags;
+  for (size_t i=0; i<ids.size(); i++)
+    {
+      bags.push_back(new hash_map<uint32_t,float,id_hash_uint>());
+      features(docs[ids[i]],*bags.back());
+    }
+  mrf::compute_tf_idf(bags);
+  for (size_t i=0; i<ids.size(); i++)
+    {
+      sparse_vector w;
+      ASSERT_TRUE(ti.weights(ids[i],w));
+      sparse_vector ref(*bags[i]);
+      ASSERT_EQ(ref.size(),w.size());
+      for (size_t f=0; f<w.size(); f++)
+        {
+          EXPECT_EQ(ref._ids[f],w._ids[f]);
+          EXPECT_NEAR(ref._weights[f],w._weights[f],1e-5);
+        }
+      delete bags[i];
+    }
+}
+
+TEST(TfidfIndexTest, add_remove)
+{
+  tfidf_index ti;
+  hash_map<uint32_t,float,id_hash_uint> tf0, tf1;
+  features(docs[0],tf0);
+  features(docs[1],tf1);
+  EXPECT_TRUE(ti.add(0,tf0,1));
+  EXPECT_FALSE(ti.add(0,tf0,1));
+  EXPECT_TRUE(ti.add(1,tf1));
+  EXPECT_EQ(2u,ti.size());
+  EXPECT_TRUE(ti.has(0));
+  EXPECT_TRUE(ti.has(0,1));
+  EXPECT_FALSE(ti.has(0,2));
+
+  uint32_t seeks = mrf::mrf_single_feature("seeks");
+  uint32_t engine = mrf::mrf_single_feature("engine");
+  EXPECT_EQ(2u,ti.df(seeks));
+  EXPECT_EQ(1u,ti.df(engine));
+  size_t nfeatures = ti.nfeatures();
+
+  EXPECT_TRUE(ti.remove(1));
+  EXPECT_FALSE(ti.remove(1));
+  EXPECT_FALSE(ti.has(1));
+  EXPECT_EQ(1u,ti.df(seeks));
+  EXPECT_EQ(0u,ti.df(engine));
+  EXPECT_EQ(tf0.size(),ti.nfeatures());
+
+  // freed slots are reused.
+  EXPECT_TRUE(ti.add(1,tf1));
+  EXPECT_EQ(nfeatures,ti.nfeatures());
+  EXPECT_EQ(2u,ti.df(seeks));
+
+  ti.clear();
+  EXPECT_EQ(0u,ti.size());
+  EXPECT_EQ(0u,ti.nfeatures());
+}
+
+TEST(TfidfIndexTest, weights)
+{
+  tfidf_index ti;
+  sparse_vector w;
+  EXPECT_FALSE(ti.weights(0,w));
+
+  // a feature in every document weighs nothing.
+  hash_map<uint32_t,float,id_hash_uint> tf;
+  features(docs[0],tf);
+  ti.add(0,tf);
+  ASSERT_TRUE(ti.weights(0,w));
+  EXPECT_EQ(tf.size(),w.size());
+  for (size_t f=0; f<w.size(); f++)
+    EXPECT_EQ(0.0,w._weights[f]);
+}
+
+TEST(TfidfIndexTest, incremental)
+{
+  // documents arrive in batches, as with query expansions.
+  tfidf_index ti;
+  std::vector<int> ids;
+  for (int i=0; i<5; i++)
+    {
+      hash_map<uint32_t,float,id_hash_uint> tf;
+      features(docs[i],tf);
+      ti.add(i,tf);
+      ids.push_back(i);
+      if (i % 2 == 0)
+        expect_full_weights(ti,ids);
+    }
+  expect_full_weights(ti,ids);
+
+  ti.remove(1);
+  ids.erase(ids.begin()+1);
+  expect_full_weights(ti,ids);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
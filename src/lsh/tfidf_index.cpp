@@ -0,0 +1,175 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tfidf_index.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace lsh
+{
+
+  tfidf_index::tfidf_index()
+  {
+  }
+
+  tfidf_index::~tfidf_index()
+  {
+    clear();
+  }
+
+  bool tfidf_index::add(const uint32_t &id, const hash_map<uint32_t,float,id_hash_uint> &tf,
+                        const uint32_t &stamp)
+  {
+    if (has(id))
+      return false;
+
+    tfidf_document *doc = new tfidf_document(stamp);
+    doc->_tf = sparse_vector(tf);
+
+    // features with a null frequency do not count towards df.
+    size_t j = 0;
+    for (size_t i=0; i<doc->_tf.size(); i++)
+      {
+        if (doc->_tf._weights[i] == 0.0)
+          continue;
+        doc->_tf._ids[j] = doc->_tf._ids[i];
+        doc->_tf._weights[j] = doc->_tf._weights[i];
+        j++;
+      }
+    doc->_tf._ids.resize(j);
+    doc->_tf._weights.resize(j);
+
+    // only the frequencies of the features of the new document change.
+    doc->_slots.reserve(j);
+    hash_map<uint32_t,uint32_t,id_hash_uint>::const_iterator hit;
+    for (size_t i=0; i<j; i++)
+      {
+        uint32_t slot;
+        if ((hit=_slots.find(doc->_tf._ids[i]))!=_slots.end())
+          slot = (*hit).second;
+        else
+          {
+            if (!_free_slots.empty())
+              {
+                slot = _free_slots.back();
+                _free_slots.pop_back();
+              }
+            else
+              {
+                slot = _df.size();
+                _df.push_back(0);
+                _log_df.push_back(0.0);
+              }
+            _slots.insert(std::pair<uint32_t,uint32_t>(doc->_tf._ids[i],slot));
+          }
+        _log_df[slot] = logf(static_cast<float>(++_df[slot]));
+        doc->_slots.push_back(slot);
+      }
+
+    _docs.insert(std::pair<uint32_t,tfidf_document*>(id,doc));
+    return true;
+  }
+
+  bool tfidf_index::remove(const uint32_t &id)
+  {
+    hash_map<uint32_t,tfidf_document*,id_hash_uint>::iterator dit;
+    if ((dit=_docs.find(id))==_docs.end())
+      return false;
+
+    tfidf_document *doc = (*dit).second;
+    _docs.erase(dit);
+    for (size_t i=0; i<doc->_slots.size(); i++)
+      {
+        uint32_t slot = doc->_slots[i];
+        if (--_df[slot] > 0)
+          _log_df[slot] = logf(static_cast<float>(_df[slot]));
+        else
+          {
+            _slots.erase(doc->_tf._ids[i]);
+            _free_slots.push_back(slot);
+          }
+      }
+    delete doc;
+    return true;
+  }
+
+  bool tfidf_index::has(const uint32_t &id) const
+  {
+    return _docs.find(id) != _docs.end();
+  }
+
+  bool tfidf_index::has(const uint32_t &id, const uint32_t &stamp) const
+  {
+    hash_map<uint32_t,tfidf_document*,id_hash_uint>::const_iterator dit;
+    if ((dit=_docs.find(id))==_docs.end())
+      return false;
+    return (*dit).second->_stamp == stamp;
+  }
+
+  bool tfidf_index::weights(const uint32_t &id, sparse_vector &v) const
+  {
+    hash_map<uint32_t,tfidf_document*,id_hash_uint>::const_iterator dit;
+    if ((dit=_docs.find(id))==_docs.end())
+      return false;
+
+    // idf is log(N) - log(df), a single pass over the document, without lookups.
+    const tfidf_document *doc = (*dit).second;
+    const float log_n = logf(static_cast<float>(_docs.size()));
+    const size_t nf = doc->_tf.size();
+    v._ids = doc->_tf._ids;
+    v._weights.resize(nf);
+    float norm = 0.0;
+    for (size_t i=0; i<nf; i++)
+      {
+        float w = doc->_tf._weights[i] * (log_n - _log_df[doc->_slots[i]]);
+        v._weights[i] = w;
+        norm += w;
+      }
+    if (norm != 0.0)
+      for (size_t i=0; i<nf; i++)
+        v._weights[i] /= norm;
+    return true;
+  }
+
+  uint32_t tfidf_index::df(const uint32_t &feature) const
+  {
+    hash_map<uint32_t,uint32_t,id_hash_uint>::const_iterator hit;
+    if ((hit=_slots.find(feature))==_slots.end())
+      return 0;
+    return _df[(*hit).second];
+  }
+
+  void tfidf_index::clear()
+  {
+    hash_map<uint32_t,tfidf_document*,id_hash_uint>::iterator dit = _docs.begin();
+    while (dit!=_docs.end())
+      {
+        delete (*dit).second;
+        ++dit;
+      }
+    _docs.clear();
+    _slots.clear();
+    _df.clear();
+    _log_df.clear();
+    _free_slots.clear();
+  }
+
+} /* end of namespace. */
@@ -0,0 +1,137 @@
+/**
+ * The Locality Sensitive Hashing (LSH) library is part of the SEEKS project and
+ * does provide several locality sensitive hashing schemes for pattern matching over
+ * continuous and discrete spaces.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TFIDF_INDEX_H
+#define TFIDF_INDEX_H
+
+#include "sparse_vector.h"
+#include "stl_hash.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace lsh
+{
+
+  /**
+   * \brief raw term frequencies of an indexed document, sorted by feature id,
+   *        along with the slots of the features in the index.
+   */
+  class tfidf_document
+  {
+    public:
+      tfidf_document(const uint32_t &stamp)
+        :_stamp(stamp)
+      {};
+
+      ~tfidf_document()
+      {};
+
+      sparse_vector _tf; /**< term frequencies. */
+      std::vector<uint32_t> _slots; /**< index slot of each feature. */
+      uint32_t _stamp; /**< identifies the version of the document that is indexed. */
+  };
+
+  /**
+   * \brief document frequencies of the features of a set of documents,
+   *        maintained as documents come and go, so that tf-idf weights are
+   *        obtained without tokenizing the documents again nor probing every
+   *        document for every feature.
+   *
+   *        Weights are tf.log(N/df), normalized by their sum, as computed by
+   *        mrf::compute_tf_idf. The index is not thread safe.
+   */
+  class tfidf_index
+  {
+    public:
+      tfidf_index();
+
+      ~tfidf_index();
+
+      /**
+       * \brief indexes the term frequencies of document id.
+       * @param stamp version of the document, e.g. a hash of its text.
+       * @return false if the document is already in the index.
+       */
+      bool add(const uint32_t &id, const hash_map<uint32_t,float,id_hash_uint> &tf,
+               const uint32_t &stamp=0);
+
+      /**
+       * \brief removes document id from the index.
+       * @return false if the document is not in the index.
+       */
+      bool remove(const uint32_t &id);
+
+      /**
+       * \brief whether document id is in the index.
+       */
+      bool has(const uint32_t &id) const;
+
+      /**
+       * \brief whether version stamp of document id is in the index.
+       */
+      bool has(const uint32_t &id, const uint32_t &stamp) const;
+
+      /**
+       * \brief fills up v with the normalized tf-idf weights of document id.
+       * @return false if the document is not in the index.
+       */
+      bool weights(const uint32_t &id, sparse_vector &v) const;
+
+      /**
+       * \brief document frequency of a feature.
+       */
+      uint32_t df(const uint32_t &feature) const;
+
+      /**
+       * \brief removes every document.
+       */
+      void clear();
+
+      /**
+       * \brief number of indexed documents.
+       */
+      size_t size() const
+      {
+        return _docs.size();
+      };
+
+      /**
+       * \brief number of distinct features in the index.
+       */
+      size_t nfeatures() const
+      {
+        return _slots.size();
+      };
+
+    private:
+      tfidf_index(const tfidf_index &ti); // not copyable.
+      tfidf_index& operator=(const tfidf_index &ti);
+
+      hash_map<uint32_t,tfidf_document*,id_hash_uint> _docs; /**< documents, by id. */
+      hash_map<uint32_t,uint32_t,id_hash_uint> _slots; /**< feature slots, by feature id. */
+      std::vector<uint32_t> _df; /**< document frequencies, by slot. */
+      std::vector<float> _log_df; /**< log of the document frequencies, by slot. */
+      std::vector<uint32_t> _free_slots; /**< slots of the features no document has anymore. */
+  };
+
+} /* end of namespace. */
+
+#endif
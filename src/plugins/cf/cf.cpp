@@ -23,6 +23,7 @@
 #include "json_renderer_private.h"
 #include "cf_configuration.h"
 #include "rank_estimators.h"
+#include "peer_fanout.h"
 #include "query_recommender.h"
 #include "uri_capture.h"
 #include "query_capture.h"
@@ -54,6 +55,7 @@ namespace seeks_plugins
   plugin* cf::_uc_plugin = NULL;
   plugin* cf::_xs_plugin = NULL;
   bool cf::_xs_plugin_activated = false;
+  peer_summary_refresher* cf::_psr = NULL;
 
   cf::cf()
     :plugin()
@@ -92,6 +94,10 @@ namespace seeks_plugins
     cgi_dispatcher *cgid_recommendation
     = new cgi_dispatcher("recommendation",&cf::cgi_recommendation,NULL,TRUE);
     _cgi_dispatchers.push_back(cgid_recommendation);
+
+    cgi_dispatcher *cgid_record_cache
+    = new cgi_dispatcher("record_cache",&cf::cgi_record_cache,NULL,TRUE);
+    _cgi_dispatchers.push_back(cgid_record_cache);
   }
 
   cf::~cf()
@@ -110,10 +116,35 @@ namespace seeks_plugins
     _xs_plugin_activated = seeks_proxy::_config->is_plugin_activated("xsl-serializer");
 #endif
 
+    // limits of the cache of remote records.
+    rank_estimator::_store.set_limits((size_t)cf_configuration::_config->_record_cache_size * 1024 * 1024,
+                                      cf_configuration::_config->_record_cache_timeout,
+                                      cf_configuration::_config->_record_cache_negative_timeout,
+                                      cf_configuration::_config->_record_cache_stale);
+
+    // periodic refresh of the peers' user db summaries.
+    if (cf_configuration::_config->_peer_summary_refresh > 0)
+      {
+        cf::_psr = new peer_summary_refresher(cf_configuration::_config->_pl);
+        sweeper::register_recurrent(cf::_psr);
+      }
   }
 
   void cf::stop()
   {
+    if (cf::_psr)
+      {
+        sweeper::unregister_recurrent(cf::_psr);
+        mutex_lock(&cf::_psr->_ref_mutex);
+        bool running = cf::_psr->_running;
+        mutex_unlock(&cf::_psr->_ref_mutex);
+        if (!running)
+          delete cf::_psr; // otherwise the running refresh is let to finish.
+        cf::_psr = NULL;
+      }
+
+    // running fetches update peers that are destroyed with the configuration.
+    peer_fanout::wait_fetches();
   }
 
   sp_err cf::cgi_peers(client_state *csp,
@@ -153,6 +184,27 @@ namespace seeks_plugins
 #endif
   }
 
+  sp_err cf::cgi_record_cache(client_state *csp,
+                              http_response *rsp,
+                              const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters)
+  {
+    cr_store_stats stats;
+    rank_estimator::_store.get_stats(stats);
+    const std::string json_str = "{\"hits\":" + miscutil::to_string(stats._hits)
+                                 + ",\"stale_hits\":" + miscutil::to_string(stats._stale_hits)
+                                 + ",\"negative_hits\":" + miscutil::to_string(stats._negative_hits)
+                                 + ",\"misses\":" + miscutil::to_string(stats._misses)
+                                 + ",\"refreshes\":" + miscutil::to_string(stats._refreshes)
+                                 + ",\"refresh_errors\":" + miscutil::to_string(stats._refresh_errors)
+                                 + ",\"evictions\":" + miscutil::to_string(stats._evictions)
+                                 + ",\"entries\":" + miscutil::to_string(stats._entries)
+                                 + ",\"bytes\":" + miscutil::to_string(stats._bytes)
+                                 + ",\"hit_rate\":" + miscutil::to_string(stats.hit_rate()) + "}";
+    const std::string body = jsonp(json_str,miscutil::lookup(parameters,"callback"));
+    response(rsp,body);
+    return SP_ERR_OK;
+  }
+
   sp_err cf::cgi_tbd(client_state *csp,
                      http_response *rsp,
                      const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters)
@@ -29,6 +29,8 @@ using namespace sp;
 namespace seeks_plugins
 {
 
+  class peer_summary_refresher;
+
   class cf : public plugin
   {
     public:
@@ -44,6 +46,13 @@ namespace seeks_plugins
                               http_response *rsp,
                               const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters);
 
+      /**
+       * \brief counters of the cache of remote records, in JSON.
+       */
+      static sp_err cgi_record_cache(client_state *csp,
+                                     http_response *rsp,
+                                     const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters);
+
       static sp_err cgi_tbd(client_state *csp,
                             http_response *rsp,
                             const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters);
@@ -99,6 +108,7 @@ namespace seeks_plugins
       static plugin *_uc_plugin;
       static plugin* _xs_plugin;
       static bool _xs_plugin_activated;
+      static peer_summary_refresher *_psr; /**< refreshes the summaries of the peers' user dbs. */
 
   };
 
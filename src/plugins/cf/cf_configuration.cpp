@@ -43,6 +43,13 @@ namespace seeks_plugins
 #define hash_remote_post              4059800377ul  /* "remote-post" */
 #define hash_use_http_url             1825269331ul  /* "use-http-urls-only" */
 #define hash_cf_estimator             1689657696ul  /* "cf-estimator" */
+#define hash_perso_deadline           3724905680ul  /* "perso-deadline" */
+#define hash_peer_hedge_delay         4267334420ul  /* "peer-hedge-delay" */
+#define hash_cf_peer_replica          3155534366ul  /* "cf-peer-replica" */
+#define hash_peer_summary_refresh     2871693330ul  /* "peer-summary-refresh" */
+#define hash_record_cache_size         548292573ul  /* "record-cache-size" */
+#define hash_record_cache_negative_timeout 4016442178ul /* "record-cache-negative-timeout" */
+#define hash_record_cache_stale       2429287350ul  /* "record-cache-stale" */
 
   cf_configuration* cf_configuration::_config = NULL;
 
@@ -82,8 +89,14 @@ namespace seeks_plugins
   {
     _domain_name_weight = 0.7;
     _record_cache_timeout = 600; // 10 mins.
+    _record_cache_size = 32; // 32 MB.
+    _record_cache_negative_timeout = 60;
+    _record_cache_stale = 300; // 5 mins.
     _dead_peer_check = 300; // 5 mins.
     _dead_peer_retries = 3;
+    _perso_deadline = 1500; // 1.5 sec.
+    _peer_hedge_delay = 300;
+    _peer_summary_refresh = 600; // 10 mins.
     _post_url_check = true;
     _post_radius = 5;
     _post_url_ua = "Mozilla/5.0 (X11; Linux x86_64; rv:2.0.1) Gecko/20100101 Firefox/4.0.1"; // default.
@@ -100,8 +113,8 @@ namespace seeks_plugins
     int vec_count;
     char *vec[4];
     int port;
-    std::vector<std::string> elts;
-    std::string host, path, address, port_str;
+    std::string host, path, port_str;
+    peer *pe = NULL;
 
     switch (cmd_hash)
       {
@@ -117,6 +130,24 @@ namespace seeks_plugins
                                            "Timeout on cached remote records, in seconds");
         break;
 
+      case hash_record_cache_size:
+        _record_cache_size = atoi(arg);
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "Size limit of the cache of remote records, in megabytes");
+        break;
+
+      case hash_record_cache_negative_timeout:
+        _record_cache_negative_timeout = atoi(arg);
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "Timeout on cached absences of remote records, in seconds");
+        break;
+
+      case hash_record_cache_stale:
+        _record_cache_stale = atoi(arg);
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "Time during which a timed out remote record is served while it is refreshed, in seconds");
+        break;
+
       case hash_cf_peer:
         strlcpy(tmp,arg,sizeof(tmp));
         vec_count = miscutil::ssplit(tmp," \t",vec,SZ(vec),1,1);
@@ -127,15 +158,7 @@ namespace seeks_plugins
             errlog::log_error(LOG_LEVEL_ERROR,"Wrong number of parameter when specifying static collaborative filtering peer");
             break;
           }
-        address = vec[0];
-        urlmatch::parse_url_host_and_path(address,host,path);
-        miscutil::tokenize(host,elts,":");
-        port = -1;
-        if (elts.size()>1)
-          {
-            host = elts.at(0);
-            port = atoi(elts.at(1).c_str());
-          }
+        cf_configuration::parse_peer_address(vec[0],host,port,path);
         port_str = (port != -1) ? ":" + miscutil::to_string(port) : "";
         errlog::log_error(LOG_LEVEL_DEBUG,"adding peer %s%s%s with resource %s",
                           host.c_str(),port_str.c_str(),path.c_str(),vec[1]);
@@ -144,6 +167,32 @@ namespace seeks_plugins
                                            "Remote peer address for collaborative filtering");
         break;
 
+      case hash_cf_peer_replica:
+        strlcpy(tmp,arg,sizeof(tmp));
+        vec_count = miscutil::ssplit(tmp," \t",vec,SZ(vec),1,1);
+        if (vec_count != 2)
+          {
+            errlog::log_error(LOG_LEVEL_ERROR,"Wrong number of parameter when specifying a collaborative filtering peer replica");
+            break;
+          }
+        cf_configuration::parse_peer_address(vec[0],host,port,path);
+        pe = _pl->get(peer::generate_key(host,port,path));
+        if (!pe)
+          {
+            errlog::log_error(LOG_LEVEL_ERROR,"Unknown peer %s for replica %s",vec[0],vec[1]);
+            break;
+          }
+        if (!pe->_replica) // replicas are kept across reloads, as peers are.
+          {
+            cf_configuration::parse_peer_address(vec[1],host,port,path);
+            pe->_replica = new peer(host,port,path,pe->_rsc);
+            errlog::log_error(LOG_LEVEL_DEBUG,"adding replica %s to peer %s",
+                              pe->_replica->_key.c_str(),pe->_key.c_str());
+          }
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "Replica of a remote peer, queried when the peer is late or fails");
+        break;
+
       case hash_dead_peer_check:
         _dead_peer_check = atoi(arg);
         configuration_spec::html_table_row(_config_args,cmd,arg,
@@ -156,6 +205,24 @@ namespace seeks_plugins
                                            "Number of retries before marking a peer as dead");
         break;
 
+      case hash_perso_deadline:
+        _perso_deadline = atoi(arg);
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "Time given to remote peers to answer, in milliseconds");
+        break;
+
+      case hash_peer_hedge_delay:
+        _peer_hedge_delay = atoi(arg);
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "Delay before querying the replica of a late peer, in milliseconds");
+        break;
+
+      case hash_peer_summary_refresh:
+        _peer_summary_refresh = atoi(arg);
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "Interval between two fetches of the peers' user db summaries, in seconds");
+        break;
+
       case hash_post_url_check:
         _post_url_check = static_cast<bool>(atoi(arg));
         configuration_spec::html_table_row(_config_args,cmd,arg,
@@ -207,4 +274,18 @@ namespace seeks_plugins
   {
   }
 
+  void cf_configuration::parse_peer_address(const std::string &address,
+      std::string &host, int &port, std::string &path)
+  {
+    std::vector<std::string> elts;
+    urlmatch::parse_url_host_and_path(address,host,path);
+    miscutil::tokenize(host,elts,":");
+    port = -1;
+    if (elts.size()>1)
+      {
+        host = elts.at(0);
+        port = atoi(elts.at(1).c_str());
+      }
+  }
+
 } /* end of namespace. */
@@ -42,13 +42,25 @@ namespace seeks_plugins
 
       virtual void finalize_configuration();
 
+      /**
+       * \brief host, port (-1 if none) and path of a peer address.
+       */
+      static void parse_peer_address(const std::string &address,
+                                     std::string &host, int &port, std::string &path);
+
       // main options.
       float _domain_name_weight; /**< weight given to domain names. */
       int _record_cache_timeout; /**< timeout on cached remote records, in seconds. */
+      int _record_cache_size; /**< size limit of the cache of remote records, in megabytes. */
+      int _record_cache_negative_timeout; /**< timeout on cached absences of remote records, in seconds. */
+      int _record_cache_stale; /**< time after the timeout during which a remote record is served while it is refreshed, in seconds. */
       peer_list *_pl; /**< list of peers for collaborative filtering. */
       peer_list *_dpl; /**< list of dead peers, used in operations, to check/uncheck dead peers from the list. */
       int _dead_peer_check; /**< interval of time between two dead peer checks. */
       int _dead_peer_retries; /**< number of retries before marking a peer as dead. */
+      int _perso_deadline; /**< time given to remote peers to answer, in milliseconds, 0 for no limit. */
+      int _peer_hedge_delay; /**< delay before querying the replica of a late peer, in milliseconds, 0 for failures only. */
+      int _peer_summary_refresh; /**< interval between two fetches of the peers' user db summaries, in seconds, 0 for none. */
 
       bool _post_url_check; /**< whether to ping on posted URLs. */
       std::string _post_url_ua; /**< default 'User-Agent' header for retrieving posted URLS. */
@@ -17,215 +17,355 @@
  */
 
 #include "cr_store.h"
-#include "cf_configuration.h"
+#include "plugin_manager.h"
+#include "plugin.h"
 #include "miscutil.h"
 #include "errlog.h"
 
-#include <time.h>
-#include <sys/time.h>
+#include <pthread.h>
 
-#include <iostream>
-
-using sp::sweeper;
+using sp::plugin_manager;
+using sp::plugin;
 using sp::miscutil;
 using sp::errlog;
 
 namespace seeks_plugins
 {
 
-  /*- cached_records. -*/
-
+  /*- cached_record -*/
   cached_record::cached_record(const std::string &key,
-                               db_record *rec,
-                               cr_cache *cache)
-    :_key(key),_rec(rec),_cache(cache)
+                               const std::string &pn)
+    :_key(key),_pn(pn),_negative(false),_date(time(NULL)),_refreshing(false)
   {
-    update_last_use();
   }
 
-  cached_record::~cached_record()
+  /*- cr_stripe -*/
+  cr_stripe::cr_stripe()
+    :_bytes(0)
   {
-    // remove from cache object and destroy record.
-    _cache->remove(_key);
-    if (_rec)
-      delete _rec;
-    if (_cache->_records.empty())
-      delete _cache;
+    mutex_init(&_mutex);
   }
 
-  bool cached_record::sweep_me()
+  cr_stripe::~cr_stripe()
   {
-    struct timeval tv_now;
-    gettimeofday(&tv_now, NULL);
-    double dt = difftime(tv_now.tv_sec,_last_use);
+    std::list<cached_record*>::iterator lit = _lru.begin();
+    while (lit!=_lru.end())
+      {
+        delete (*lit);
+        ++lit;
+      }
+    mutex_destroy(&_mutex);
+  }
 
-    if (dt >= cf_configuration::_config->_record_cache_timeout)
-      return true;
-    else return false;
+  /*- cr_store -*/
+  cr_store::cr_store(const size_t &nstripes)
+    :_max_bytes(32*1024*1024),_timeout(600),_negative_timeout(60),_stale(300)
+  {
+    size_t n = nstripes > 0 ? nstripes : 1;
+    _stripes.reserve(n);
+    for (size_t i=0; i<n; i++)
+      _stripes.push_back(new cr_stripe());
   }
 
-  void cached_record::update_last_use()
+  cr_store::~cr_store()
   {
-    struct timeval tv_now;
-    gettimeofday(&tv_now,NULL);
-    _last_use = tv_now.tv_sec;
+    for (size_t i=0; i<_stripes.size(); i++)
+      delete _stripes[i];
   }
 
-  /*- cr_cache -*/
-  cr_cache::cr_cache(const std::string &peer,
-                     cr_store *store)
-    :_peer(peer),_store(store)
+  void cr_store::set_limits(const size_t &max_bytes,
+                            const int &timeout,
+                            const int &negative_timeout,
+                            const int &stale)
   {
-    mutex_init(&_cache_mutex);
+    _max_bytes = max_bytes;
+    _timeout = timeout;
+    _negative_timeout = negative_timeout;
+    _stale = stale;
   }
 
-  cr_cache::~cr_cache()
+  cr_stripe* cr_store::stripe(const std::string &key) const
   {
-    _store->remove(_peer);
+    size_t h = hash<const char*>()(key.c_str());
+    return _stripes[h % _stripes.size()];
   }
 
-  void cr_cache::add(const std::string &key,
-                     db_record *rec)
+  void cr_store::add(const std::string &host,
+                     const int &port,
+                     const std::string &path,
+                     const std::string &key,
+                     const db_record *rec,
+                     const std::string &pn)
   {
-    mutex_lock(&_cache_mutex);
-    hash_map<const char*,cached_record*,hash<const char*>,eqstr>::iterator hit;
-    if ((hit=_records.find(key.c_str()))!=_records.end())
-      {
-        // update existing record with new one.
-        // Beware as old record is 'sweepable', a call to unregister_sweepable
-        // may be under way.
-        cached_record *cro = (*hit).second;
-        sweeper::unregister_sweepable(cro);
-        mutex_unlock(&_cache_mutex);
-        delete cro; // down to top: removes and delete cro;
-        mutex_lock(&_cache_mutex);
-      }
-    cached_record *cr = new cached_record(key,rec,this);
-    _records.insert(std::pair<const char*,cached_record*>(cr->_key.c_str(),cr));
-    sweeper::register_sweepable(cr);
-    mutex_unlock(&_cache_mutex);
+    std::string peer = cr_store::generate_peer(host,port,path);
+    add(peer,key,rec,pn);
   }
 
-  void cr_cache::remove(const std::string &key)
+  void cr_store::add(const std::string &peer,
+                     const std::string &key,
+                     const db_record *rec,
+                     const std::string &pn)
   {
-    mutex_lock(&_cache_mutex);
-    hash_map<const char*,cached_record*,hash<const char*>,eqstr>::iterator hit;
-    if ((hit=_records.find(key.c_str()))!=_records.end())
+    cached_record *cr = new cached_record(cr_store::generate_key(peer,key),pn);
+    if (!rec)
+      cr->_negative = true;
+    else if (rec->serialize(cr->_data) != 0)
       {
-        _records.erase(hit);
+        errlog::log_error(LOG_LEVEL_ERROR,"cannot serialize record %s from %s for caching",
+                          key.c_str(),peer.c_str());
+        delete cr;
+        return;
       }
-    mutex_unlock(&_cache_mutex);
-  }
 
-  cached_record* cr_cache::find(const std::string &key)
-  {
-    mutex_lock(&_cache_mutex);
-    hash_map<const char*,cached_record*,hash<const char*>,eqstr>::const_iterator hit;
-    if ((hit=_records.find(key.c_str()))!=_records.end())
+    // a record larger than the share of a stripe would empty it.
+    size_t max_bytes = _max_bytes / _stripes.size();
+    if (cr->size() > max_bytes)
       {
-        mutex_unlock(&_cache_mutex);
-        return (*hit).second;
+        delete cr;
+        return;
       }
-    mutex_unlock(&_cache_mutex);
-    return NULL;
+
+    cr_stripe *crs = stripe(cr->_key);
+    mutex_lock(&crs->_mutex);
+    hash_map<const char*,cached_record*,hash<const char*>,eqstr>::iterator hit;
+    if ((hit=crs->_records.find(cr->_key.c_str()))!=crs->_records.end())
+      drop_record(crs,(*hit).second);
+    add_record(crs,cr);
+    while (crs->_bytes > max_bytes)
+      {
+        drop_record(crs,crs->_lru.back());
+        crs->_stats._evictions++;
+      }
+    mutex_unlock(&crs->_mutex);
   }
 
-  /*- cr_store -*/
+  void cr_store::add_record(cr_stripe *crs, cached_record *cr)
+  {
+    crs->_lru.push_front(cr);
+    cr->_lru = crs->_lru.begin();
+    crs->_records.insert(std::pair<const char*,cached_record*>(cr->_key.c_str(),cr));
+    crs->_bytes += cr->size();
+  }
 
-  cr_store::cr_store()
+  void cr_store::drop_record(cr_stripe *crs, cached_record *cr)
   {
-    mutex_init(&_store_mutex);
+    crs->_records.erase(cr->_key.c_str());
+    crs->_lru.erase(cr->_lru);
+    crs->_bytes -= cr->size();
+    delete cr;
   }
 
-  cr_store::~cr_store()
+  void cr_store::remove(const std::string &peer,
+                        const std::string &key)
   {
+    std::string ckey = cr_store::generate_key(peer,key);
+    cr_stripe *crs = stripe(ckey);
+    mutex_lock(&crs->_mutex);
+    hash_map<const char*,cached_record*,hash<const char*>,eqstr>::iterator hit;
+    if ((hit=crs->_records.find(ckey.c_str()))!=crs->_records.end())
+      drop_record(crs,(*hit).second);
+    mutex_unlock(&crs->_mutex);
   }
 
-  void cr_store::add(const std::string &host,
-                     const int &port,
-                     const std::string &path,
-                     const std::string &key,
-                     db_record *rec)
+  db_record* cr_store::find(const std::string &host,
+                            const int &port,
+                            const std::string &path,
+                            const std::string &key,
+                            bool &has_key,
+                            cr_fetcher *fetcher)
   {
     std::string peer = cr_store::generate_peer(host,port,path);
-    add(peer,key,rec);
+    return find(peer,key,has_key,fetcher);
   }
 
-  void cr_store::add(const std::string &peer,
-                     const std::string &key,
-                     db_record *rec)
+  db_record* cr_store::find(const std::string &peer,
+                            const std::string &key,
+                            bool &has_key,
+                            cr_fetcher *fetcher)
   {
-    mutex_lock(&_store_mutex);
-    hash_map<const char*,cr_cache*,hash<const char*>,eqstr>::iterator hit;
-    if ((hit=_store.find(peer.c_str()))!=_store.end())
+    has_key = false;
+    std::string ckey = cr_store::generate_key(peer,key);
+    cr_stripe *crs = stripe(ckey);
+    time_t now = time(NULL);
+    mutex_lock(&crs->_mutex);
+    hash_map<const char*,cached_record*,hash<const char*>,eqstr>::iterator hit;
+    if ((hit=crs->_records.find(ckey.c_str()))==crs->_records.end())
+      {
+        crs->_stats._misses++;
+        mutex_unlock(&crs->_mutex);
+        delete fetcher;
+        return NULL;
+      }
+
+    cached_record *cr = (*hit).second;
+    double age = difftime(now,cr->_date);
+    if ((cr->_negative && age >= _negative_timeout)
+        || (!cr->_negative && age >= _timeout + _stale))
+      {
+        // expired.
+        drop_record(crs,cr);
+        crs->_stats._misses++;
+        mutex_unlock(&crs->_mutex);
+        delete fetcher;
+        return NULL;
+      }
+
+    // most recently used.
+    crs->_lru.splice(crs->_lru.begin(),crs->_lru,cr->_lru);
+    has_key = true;
+    if (cr->_negative)
+      {
+        crs->_stats._negative_hits++;
+        mutex_unlock(&crs->_mutex);
+        delete fetcher;
+        return NULL;
+      }
+    if (age >= _timeout)
+      {
+        // stale, served while it is refreshed.
+        crs->_stats._stale_hits++;
+        if (fetcher && !cr->_refreshing)
+          {
+            start_refresh(peer,key,cr,fetcher);
+            fetcher = NULL;
+          }
+      }
+    else crs->_stats._hits++;
+    std::string pn = cr->_pn;
+    std::string data = cr->_data;
+    mutex_unlock(&crs->_mutex);
+    delete fetcher;
+
+    db_record *rec = cr_store::restore(pn,data);
+    if (!rec)
       {
-        cr_cache *crc = (*hit).second;
-        crc->add(key,rec);
+        errlog::log_error(LOG_LEVEL_ERROR,"cannot restore cached record %s from %s",
+                          key.c_str(),peer.c_str());
+        remove(peer,key);
+        has_key = false;
       }
+    return rec;
+  }
+
+  db_record* cr_store::restore(const std::string &pn, const std::string &data)
+  {
+    db_record *rec = NULL;
+    if (pn.empty())
+      rec = new db_record();
     else
       {
-        cr_cache *crc = new cr_cache(peer,this);
-        crc->add(key,rec);
-        _store.insert(std::pair<const char*,cr_cache*>(crc->_peer.c_str(),crc));
+        plugin *pl = plugin_manager::get_plugin(pn);
+        if (!pl)
+          return NULL;
+        rec = pl->create_db_record();
       }
-    mutex_unlock(&_store_mutex);
+    if (rec->deserialize(data) != 0)
+      {
+        delete rec;
+        return NULL;
+      }
+    return rec;
   }
 
-  void cr_store::remove(const std::string &host,
-                        const int &port,
-                        const std::string &path)
+  void cr_store::start_refresh(const std::string &peer, const std::string &key,
+                               cached_record *cr, cr_fetcher *fetcher)
   {
-    std::string peer = cr_store::generate_peer(host,port,path);
-    remove(peer);
+    cr_refresh *crf = new cr_refresh(this,peer,key,cr->_pn,fetcher);
+    pthread_t refresh_thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&refresh_thread,&attr,&cr_store::run_refresh,crf);
+    pthread_attr_destroy(&attr);
+    if (err != 0)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"Error creating thread for refreshing record %s from %s: %d",
+                          key.c_str(),peer.c_str(),err);
+        delete crf;
+      }
+    else cr->_refreshing = true;
   }
 
-  void cr_store::remove(const std::string &peer)
+  void* cr_store::run_refresh(void *arg)
   {
-    mutex_lock(&_store_mutex);
-    hash_map<const char*,cr_cache*,hash<const char*>,eqstr>::iterator hit;
-    if ((hit=_store.find(peer.c_str()))!=_store.end())
+    cr_refresh *crf = static_cast<cr_refresh*>(arg);
+    db_record *rec = NULL;
+    bool refreshed = true;
+    try
+      {
+        rec = crf->_fetcher->fetch();
+      }
+    catch (sp_exception &e)
+      {
+        errlog::log_error(LOG_LEVEL_DEBUG,"refresh of record %s from %s failed: %s",
+                          crf->_key.c_str(),crf->_peer.c_str(),e.what().c_str());
+        refreshed = false;
+      }
+    if (refreshed)
       {
-        _store.erase(hit);
+        crf->_store->add(crf->_peer,crf->_key,rec,crf->_pn);
+        delete rec;
       }
-    else errlog::log_error(LOG_LEVEL_ERROR,"cannot find record cache entry %s",peer.c_str());
-    mutex_unlock(&_store_mutex);
+    crf->_store->end_refresh(crf->_peer,crf->_key,refreshed);
+    delete crf;
+    return NULL;
   }
 
-  db_record* cr_store::find(const std::string &host,
-                            const int &port,
-                            const std::string &path,
-                            const std::string &key,
-                            bool &has_key)
+  void cr_store::end_refresh(const std::string &peer, const std::string &key,
+                             const bool &refreshed)
   {
-    std::string peer = cr_store::generate_peer(host,port,path);
-    return find(peer,key,has_key);
+    std::string ckey = cr_store::generate_key(peer,key);
+    cr_stripe *crs = stripe(ckey);
+    mutex_lock(&crs->_mutex);
+    if (refreshed)
+      crs->_stats._refreshes++;
+    else crs->_stats._refresh_errors++;
+
+    // the entry may not have been replaced, e.g. a failed fetch, or a fetched
+    // record too large for the store: the stale record is served until it
+    // expires, and may be refreshed again.
+    hash_map<const char*,cached_record*,hash<const char*>,eqstr>::iterator hit;
+    if ((hit=crs->_records.find(ckey.c_str()))!=crs->_records.end())
+      (*hit).second->_refreshing = false;
+    mutex_unlock(&crs->_mutex);
   }
 
-  db_record* cr_store::find(const std::string &peer,
-                            const std::string &key,
-                            bool &has_key)
+  void cr_store::clear()
   {
-    mutex_lock(&_store_mutex);
-    hash_map<const char*,cr_cache*,hash<const char*>,eqstr>::const_iterator hit;
-    if ((hit=_store.find(peer.c_str()))!=_store.end())
+    for (size_t i=0; i<_stripes.size(); i++)
       {
-        cr_cache *crc = (*hit).second;
-        cached_record *cr = crc->find(key);
-        mutex_unlock(&_store_mutex);
-        if (!cr)
-          {
-            has_key = false;
-            mutex_unlock(&_store_mutex);
-            return NULL;
-          }
-        has_key = true;
-        cr->update_last_use();
-        mutex_unlock(&_store_mutex);
-        return cr->_rec;
+        cr_stripe *crs = _stripes[i];
+        mutex_lock(&crs->_mutex);
+        while (!crs->_lru.empty())
+          drop_record(crs,crs->_lru.back());
+        mutex_unlock(&crs->_mutex);
       }
-    has_key = false;
-    mutex_unlock(&_store_mutex);
-    return NULL;
+  }
+
+  void cr_store::get_stats(cr_store_stats &stats)
+  {
+    stats = cr_store_stats();
+    for (size_t i=0; i<_stripes.size(); i++)
+      {
+        cr_stripe *crs = _stripes[i];
+        mutex_lock(&crs->_mutex);
+        stats._hits += crs->_stats._hits;
+        stats._stale_hits += crs->_stats._stale_hits;
+        stats._negative_hits += crs->_stats._negative_hits;
+        stats._misses += crs->_stats._misses;
+        stats._refreshes += crs->_stats._refreshes;
+        stats._refresh_errors += crs->_stats._refresh_errors;
+        stats._evictions += crs->_stats._evictions;
+        stats._entries += crs->_records.size();
+        stats._bytes += crs->_bytes;
+        mutex_unlock(&crs->_mutex);
+      }
+  }
+
+  std::string cr_store::generate_key(const std::string &peer,
+                                     const std::string &key)
+  {
+    return peer + " " + key;
   }
 
   std::string cr_store::generate_peer(const std::string &host,
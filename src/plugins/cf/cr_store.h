@@ -17,117 +17,260 @@
  */
 
 /**
- * \brief cr_store is a record store in which items are put from a
- *        cr_store object. Item removal however is automatic. Every time
- *        a cached_record is deleted, its removal trickles up the chain
- *        and frees cr_cache entries as needed.
+ * \brief cr_store is a cache of the records fetched from remote peers.
+ *        Records are kept serialized, so that the cache is bounded by its
+ *        size in bytes, and so that every lookup hands out a record that
+ *        belongs to the caller.
  *
- *        Adding an item to the cr_store registers a cached_record object
- *        with the Seeks' proxy sweeper. When a cached_record object times
- *        out, the sweeper deletes it, triggering the deletion chain.
+ *        Entries are spread over several locks by peer and key, each lock
+ *        with its own least recently used list, so that threads that do not
+ *        look up the same entries do not contend. Peers that have no record
+ *        for a key are cached as negative entries, with a shorter timeout.
+ *        Timed out entries are still served for a while, during which a
+ *        background refresh is run with the fetcher given on lookup.
  */
 
 #ifndef CR_STORE_H
 #define CR_STORE_H
 
 #include "stl_hash.h"
-#include "sweeper.h"
 #include "db_record.h"
 #include "mutexes.h"
+#include "sp_exception.h"
+
+#include <time.h>
+#include <list>
+#include <vector>
 
-using sp::sweepable;
 using sp::db_record;
 
+#define CR_STORE_STRIPES 16
+
 namespace seeks_plugins
 {
 
-  class cr_cache;
-  class cr_store;
-
-  class cached_record : public sweepable
+  /**
+   * \brief fetches a record from a peer, for refreshing a stale entry.
+   */
+  class cr_fetcher
   {
     public:
-      cached_record(const std::string &key,
-                    db_record *rec,
-                    cr_cache *cache);
+      cr_fetcher() {};
 
-      virtual ~cached_record();
+      virtual ~cr_fetcher() {};
 
-      virtual bool sweep_me();
+      /**
+       * \brief returns the record, or NULL if the peer has none.
+       *        The record belongs to the caller.
+       */
+      virtual db_record* fetch() throw (sp_exception) = 0;
+  };
 
-      void update_last_use();
+  /**
+   * \brief a serialized record, or a negative entry.
+   */
+  class cached_record
+  {
+    public:
+      cached_record(const std::string &key,
+                    const std::string &pn);
 
-      std::string _key;
-      db_record *_rec;
-      time_t _last_use;
+      ~cached_record() {};
 
-    private:
-      cr_cache *_cache;
+      /**
+       * \brief bytes held by the entry.
+       */
+      size_t size() const
+      {
+        return sizeof(cached_record) + _key.size() + _pn.size() + _data.size();
+      };
+
+      std::string _key; /**< peer and record key. */
+      std::string _pn; /**< name of the plugin the record belongs to, empty for base records. */
+      std::string _data; /**< serialized record, empty for a negative entry. */
+      bool _negative; /**< whether the peer has no record for the key. */
+      time_t _date; /**< time the record was fetched. */
+      bool _refreshing; /**< whether a background refresh is under way. */
+      std::list<cached_record*>::iterator _lru;
   };
 
-  class cr_cache
+  /**
+   * \brief counters of a record store.
+   */
+  class cr_store_stats
   {
     public:
-      cr_cache(const std::string &peer,
-               cr_store *store);
+      cr_store_stats()
+        :_hits(0),_stale_hits(0),_negative_hits(0),_misses(0),
+         _refreshes(0),_refresh_errors(0),_evictions(0),_entries(0),_bytes(0)
+      {};
 
-      ~cr_cache();
+      ~cr_store_stats() {};
 
-      void add(const std::string &key,
-               db_record *rec);
+      /**
+       * \brief share of the lookups that were served from the store.
+       */
+      double hit_rate() const
+      {
+        unsigned long lookups = _hits + _stale_hits + _negative_hits + _misses;
+        return lookups ? (_hits + _stale_hits + _negative_hits) / (double)lookups : 0.0;
+      };
 
-      void remove(const std::string &key);
+      unsigned long _hits; /**< lookups served a fresh record. */
+      unsigned long _stale_hits; /**< lookups served a timed out record while it is refreshed. */
+      unsigned long _negative_hits; /**< lookups served a negative entry. */
+      unsigned long _misses; /**< lookups with no usable entry. */
+      unsigned long _refreshes; /**< background refreshes that completed. */
+      unsigned long _refresh_errors; /**< background refreshes that failed. */
+      unsigned long _evictions; /**< entries dropped to stay within the size limit. */
+      size_t _entries;
+      size_t _bytes;
+  };
 
-      cached_record *find(const std::string &key);
+  /**
+   * \brief a lock and the entries it covers.
+   */
+  class cr_stripe
+  {
+    public:
+      cr_stripe();
 
-      std::string _peer;
-      hash_map<const char*,cached_record*,hash<const char*>,eqstr> _records;
+      ~cr_stripe();
 
-    private:
-      cr_store *_store;
-      sp_mutex_t _cache_mutex;
+      sp_mutex_t _mutex;
+      hash_map<const char*,cached_record*,hash<const char*>,eqstr> _records;
+      std::list<cached_record*> _lru; /**< most recently used first. */
+      size_t _bytes;
+      cr_store_stats _stats;
   };
 
   class cr_store
   {
     public:
-      cr_store();
+      cr_store(const size_t &nstripes=CR_STORE_STRIPES);
 
       ~cr_store();
 
+      /**
+       * \brief sets the size limit and timeouts of the store.
+       * @param max_bytes size limit, over which the least recently used entries are dropped.
+       * @param timeout time during which a record is served as is, in seconds.
+       * @param negative_timeout time during which a negative entry is served, in seconds.
+       * @param stale time after the timeout during which a record is served
+       *        while it is refreshed, in seconds.
+       */
+      void set_limits(const size_t &max_bytes,
+                      const int &timeout,
+                      const int &negative_timeout,
+                      const int &stale);
+
+      /**
+       * \brief stores a copy of rec, or a negative entry if rec is NULL.
+       */
       void add(const std::string &host,
                const int &port,
                const std::string &path,
                const std::string &key,
-               db_record *rec);
+               const db_record *rec,
+               const std::string &pn="query-capture");
 
       void add(const std::string &peer,
                const std::string &key,
-               db_record *rec);
+               const db_record *rec,
+               const std::string &pn="query-capture");
 
-      void remove(const std::string &host,
-                  const int &port,
-                  const std::string &path);
-
-      void remove(const std::string &peer);
+      void remove(const std::string &peer,
+                  const std::string &key);
 
+      /**
+       * \brief looks up a record.
+       * @param has_key set if the store holds an entry, which may be negative.
+       * @param fetcher used to refresh a stale entry in the background.
+       *        The store takes ownership of it.
+       * @return a copy of the record that belongs to the caller, NULL if
+       *         there is none or the entry is negative.
+       */
       db_record* find(const std::string &host,
                       const int &port,
                       const std::string &path,
                       const std::string &key,
-                      bool &has_key);
+                      bool &has_key,
+                      cr_fetcher *fetcher=NULL);
 
       db_record* find(const std::string &peer,
                       const std::string &key,
-                      bool &has_key);
+                      bool &has_key,
+                      cr_fetcher *fetcher=NULL);
+
+      /**
+       * \brief drops all entries.
+       */
+      void clear();
+
+      /**
+       * \brief fills up the counters of the store.
+       */
+      void get_stats(cr_store_stats &stats);
+
+      static std::string generate_key(const std::string &peer,
+                                      const std::string &key);
 
       static std::string generate_peer(const std::string &host,
                                        const int &port,
                                        const std::string &path="");
 
-      hash_map<const char*,cr_cache*,hash<const char*>,eqstr> _store;
     private:
-      sp_mutex_t _store_mutex;
+      cr_store(const cr_store &crs); // not copyable.
+      cr_store& operator=(const cr_store &crs);
+
+      cr_stripe* stripe(const std::string &key) const;
+
+      void add_record(cr_stripe *crs, cached_record *cr);
+
+      void drop_record(cr_stripe *crs, cached_record *cr);
+
+      static db_record* restore(const std::string &pn, const std::string &data);
+
+      void start_refresh(const std::string &peer, const std::string &key,
+                         cached_record *cr, cr_fetcher *fetcher);
+
+      void end_refresh(const std::string &peer, const std::string &key,
+                       const bool &refreshed);
+
+      static void* run_refresh(void *arg);
+
+    public:
+      size_t _max_bytes;
+      int _timeout;
+      int _negative_timeout;
+      int _stale;
+
+    private:
+      std::vector<cr_stripe*> _stripes;
+  };
+
+  /**
+   * \brief a background refresh of an entry.
+   */
+  class cr_refresh
+  {
+    public:
+      cr_refresh(cr_store *store, const std::string &peer,
+                 const std::string &key, const std::string &pn,
+                 cr_fetcher *fetcher)
+        :_store(store),_peer(peer),_key(key),_pn(pn),_fetcher(fetcher)
+      {};
+
+      ~cr_refresh()
+      {
+        delete _fetcher;
+      };
+
+      cr_store *_store;
+      std::string _peer;
+      std::string _key;
+      std::string _pn;
+      cr_fetcher *_fetcher;
   };
 
 } /* end of namespace. */
@@ -0,0 +1,311 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "peer_fanout.h"
+#include "rank_estimators.h"
+#include "cf_configuration.h"
+#include "db_err.h"
+#include "udbs_err.h"
+#include "errlog.h"
+
+#include <pthread.h>
+
+using sp::errlog;
+
+namespace seeks_plugins
+{
+
+  /*- peer_fetch -*/
+  peer_fetch::peer_fetch(peer_fanout *pf, peer *pe, const bool &hedge)
+    :_fanout(pf),_pe(pe),_target(pe->_host,pe->_port,pe->_path,pe->_rsc),_hedge(hedge),
+     _err(SP_ERR_OK),_latency(0.0),_done(false),_taken(false)
+  {
+  }
+
+  peer_fetch::~peer_fetch()
+  {
+    rank_estimator::destroy_query_data(_qdata);
+    rank_estimator::destroy_inv_qdata_key(_inv_qdata);
+  }
+
+  /*- peer_fanout -*/
+  int peer_fanout::_running = 0;
+  sp_mutex_t peer_fanout::_running_mutex = PTHREAD_MUTEX_INITIALIZER;
+  sp_cond_t peer_fanout::_running_cond = PTHREAD_COND_INITIALIZER;
+
+  peer_fanout::peer_fanout(const std::string &query,
+                           const std::string &lang,
+                           const int &radius,
+                           const bool &swf,
+                           const int &hedge_delay,
+                           peer_fetch_fn fetch_fn)
+    :_query(query),_lang(lang),_radius(radius),_swf(swf),
+     _hedge_delay(hedge_delay),_fetch_fn(fetch_fn),_refs(1)
+  {
+    mutex_init(&_mutex);
+    cond_init(&_cond);
+  }
+
+  peer_fanout::~peer_fanout()
+  {
+    for (size_t i=0; i<_slots.size(); i++)
+      {
+        for (size_t j=0; j<_slots[i]->_fetches.size(); j++)
+          delete _slots[i]->_fetches[j];
+        delete _slots[i];
+      }
+    mutex_destroy(&_mutex);
+    pthread_cond_destroy(&_cond);
+  }
+
+  void peer_fanout::add(peer *pe)
+  {
+    peer_slot *ps = new peer_slot(pe);
+    gettimeofday(&ps->_start,NULL);
+    mutex_lock(&_mutex);
+    _slots.push_back(ps);
+    start(ps,pe,false);
+    mutex_unlock(&_mutex);
+  }
+
+  void peer_fanout::start(peer_slot *ps, peer *pe, const bool &hedge)
+  {
+    peer_fetch *pf = new peer_fetch(this,pe,hedge);
+    ps->_fetches.push_back(pf);
+    if (hedge)
+      ps->_hedged = true;
+    _refs++;
+    mutex_lock(&peer_fanout::_running_mutex);
+    peer_fanout::_running++;
+    mutex_unlock(&peer_fanout::_running_mutex);
+
+    pthread_t fetch_thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&fetch_thread,&attr,&peer_fanout::run_fetch,pf);
+    pthread_attr_destroy(&attr);
+    if (err != 0)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"Error creating thread for fetching from peer %s: %d",
+                          pe->_key.c_str(),err);
+        _refs--;
+        mutex_lock(&peer_fanout::_running_mutex);
+        if (--peer_fanout::_running == 0)
+          cond_broadcast(&peer_fanout::_running_cond);
+        mutex_unlock(&peer_fanout::_running_mutex);
+        pf->_err = SP_ERR_MEMORY;
+        pf->_done = true;
+      }
+  }
+
+  void* peer_fanout::run_fetch(void *arg)
+  {
+    peer_fetch *pf = static_cast<peer_fetch*>(arg);
+    peer_fanout *pfo = pf->_fanout;
+
+    struct timeval start,end;
+    gettimeofday(&start,NULL);
+    pfo->_fetch_fn(pf);
+    gettimeofday(&end,NULL);
+    pf->_latency = peer_fanout::elapsed(start,end);
+
+    // the latency of late fetches counts too, so that slow peers are skipped.
+    pf->_pe->update_latency(pf->_latency);
+    peer_fanout::update_status(pf);
+
+    // the peer is not used past this point.
+    mutex_lock(&peer_fanout::_running_mutex);
+    if (--peer_fanout::_running == 0)
+      cond_broadcast(&peer_fanout::_running_cond);
+    mutex_unlock(&peer_fanout::_running_mutex);
+
+    mutex_lock(&pfo->_mutex);
+    pf->_done = true;
+    cond_broadcast(&pfo->_cond);
+    mutex_unlock(&pfo->_mutex);
+    pfo->release();
+    return NULL;
+  }
+
+  void peer_fanout::update_status(peer_fetch *pf)
+  {
+    if (pf->_err != SP_ERR_OK && pf->_err != DB_ERR_NO_REC)
+      {
+        // replicas are not in the list of peers, and are not monitored.
+        if (!pf->_hedge
+            && ++pf->_pe->_retries > cf_configuration::_config->_dead_peer_retries)
+          {
+            if (pf->_err == UDBS_ERR_CONNECT)
+              pf->_pe->set_status_no_connect();
+            else pf->_pe->set_status_unknown(); // most likely to be a slow transmission.
+
+            // add peer to monitoring list.
+            dead_peer *dpe = new dead_peer(pf->_pe->_host,
+                                           pf->_pe->_port,
+                                           pf->_pe->_path,
+                                           pf->_pe->_rsc);
+          }
+      }
+    else pf->_pe->set_status_ok();
+  }
+
+  peer_fetch* peer_fanout::next(const struct timeval *deadline)
+  {
+    mutex_lock(&_mutex);
+    while (true)
+      {
+        struct timeval now;
+        gettimeofday(&now,NULL);
+        struct timeval wake;
+        bool timed = false;
+        if (deadline)
+          {
+            wake = *deadline;
+            timed = true;
+          }
+
+        bool open = false;
+        for (size_t i=0; i<_slots.size(); i++)
+          {
+            peer_slot *ps = _slots[i];
+            if (ps->_answered)
+              continue;
+
+            bool running = false;
+            for (size_t j=0; j<ps->_fetches.size(); j++)
+              {
+                peer_fetch *pf = ps->_fetches[j];
+                if (!pf->_done)
+                  {
+                    running = true;
+                    continue;
+                  }
+                if (pf->_taken)
+                  continue;
+                pf->_taken = true;
+                if (pf->_err == SP_ERR_OK)
+                  {
+                    ps->_answered = true;
+                    mutex_unlock(&_mutex);
+                    return pf;
+                  }
+                else if (pf->_err == DB_ERR_NO_REC)
+                  {
+                    ps->_answered = true; // the peer has no data.
+                    break;
+                  }
+              }
+            if (ps->_answered)
+              continue;
+
+            // query the replica of a failing or late peer.
+            if (!ps->_hedged && ps->_pe->_replica)
+              {
+                if (!running)
+                  {
+                    start(ps,ps->_pe->_replica,true);
+                    running = !ps->_fetches.back()->_done;
+                  }
+                else if (_hedge_delay > 0)
+                  {
+                    if (peer_fanout::elapsed(ps->_start,now) >= _hedge_delay)
+                      start(ps,ps->_pe->_replica,true);
+                    else
+                      {
+                        struct timeval hedge_time = ps->_start;
+                        peer_fanout::add_time(hedge_time,_hedge_delay);
+                        if (!timed || peer_fanout::elapsed(hedge_time,wake) > 0)
+                          wake = hedge_time;
+                        timed = true;
+                      }
+                  }
+              }
+
+            if (running)
+              open = true;
+            else ps->_answered = true; // all fetches failed.
+          }
+
+        if (!open
+            || (deadline && peer_fanout::elapsed(*deadline,now) >= 0))
+          {
+            mutex_unlock(&_mutex);
+            return NULL;
+          }
+
+        if (timed)
+          {
+            struct timespec ts;
+            ts.tv_sec = wake.tv_sec;
+            ts.tv_nsec = wake.tv_usec * 1000;
+            pthread_cond_timedwait(&_cond,&_mutex,&ts);
+          }
+        else cond_wait(&_cond,&_mutex);
+      }
+  }
+
+  void peer_fanout::release()
+  {
+    mutex_lock(&_mutex);
+    int refs = --_refs;
+    mutex_unlock(&_mutex);
+    if (refs == 0)
+      delete this;
+  }
+
+  void peer_fanout::fetch_query_data(peer_fetch *pf)
+  {
+    peer_fanout *pfo = pf->_fanout;
+    rank_estimator re(pfo->_swf);
+    try
+      {
+        re.fetch_query_data(pfo->_query,pfo->_lang,pfo->_radius,
+                            pf->_qdata,pf->_inv_qdata,&pf->_target);
+      }
+    catch(sp_exception &e)
+      {
+        pf->_err = e.code();
+      }
+  }
+
+  void peer_fanout::add_time(struct timeval &tv, const int &ms)
+  {
+    tv.tv_sec += ms / 1000;
+    tv.tv_usec += (ms % 1000) * 1000;
+    if (tv.tv_usec >= 1000000)
+      {
+        tv.tv_sec++;
+        tv.tv_usec -= 1000000;
+      }
+  }
+
+  double peer_fanout::elapsed(const struct timeval &t1, const struct timeval &t2)
+  {
+    return (t2.tv_sec - t1.tv_sec) * 1000.0 + (t2.tv_usec - t1.tv_usec) / 1000.0;
+  }
+
+  void peer_fanout::wait_fetches()
+  {
+    mutex_lock(&peer_fanout::_running_mutex);
+    while (peer_fanout::_running > 0)
+      cond_wait(&peer_fanout::_running_cond,&peer_fanout::_running_mutex);
+    mutex_unlock(&peer_fanout::_running_mutex);
+  }
+
+} /* end of namespace. */
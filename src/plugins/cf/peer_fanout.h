@@ -0,0 +1,184 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PEER_FANOUT_H
+#define PEER_FANOUT_H
+
+#include "peer_list.h"
+#include "db_query_record.h"
+#include "sp_err.h"
+
+#include <sys/time.h>
+#include <vector>
+
+namespace seeks_plugins
+{
+
+  class peer_fanout;
+
+  /**
+   * \brief query data fetched from one peer, or from its replica.
+   */
+  class peer_fetch
+  {
+    public:
+      peer_fetch(peer_fanout *pf, peer *pe, const bool &hedge);
+
+      /**
+       * \brief destroys the query data that was not handed over.
+       */
+      ~peer_fetch();
+
+      peer_fanout *_fanout;
+      peer *_pe; /**< peer from the peer list, for status and latency updates, valid until the fetch returns. */
+      peer _target; /**< address the fetch runs against. */
+      bool _hedge; /**< whether this fetch goes to the replica of a late or failing peer. */
+      hash_map<const char*,query_data*,hash<const char*>,eqstr> _qdata;
+      hash_map<const char*,std::vector<query_data*>,hash<const char*>,eqstr> _inv_qdata;
+      sp_err _err;
+      double _latency; /**< response time, in milliseconds. */
+      bool _done; /**< set when the fetch returns. */
+      bool _taken; /**< set when the fetch has been looked at by the caller. */
+  };
+
+  typedef void (*peer_fetch_fn)(peer_fetch *pf);
+
+  /**
+   * \brief fetches to a peer and to its replica, of which the first answer is used.
+   */
+  class peer_slot
+  {
+    public:
+      peer_slot(peer *pe)
+        :_pe(pe),_hedged(false),_answered(false)
+      {};
+
+      ~peer_slot() {};
+
+      peer *_pe;
+      std::vector<peer_fetch*> _fetches;
+      struct timeval _start;
+      bool _hedged; /**< whether the replica has been queried. */
+      bool _answered; /**< whether a fetch was handed over, or no answer is to be expected. */
+  };
+
+  /**
+   * \brief asynchronous queries of query data to a set of peers, each in
+   *        its own detached thread, so that answers can be used as they
+   *        arrive and slow peers abandoned at a deadline.
+   *
+   *        A peer with a replica that has not answered after the hedge delay,
+   *        or that failed, has its replica queried, and the first answer of
+   *        the two is used. Fetches that are still running when the caller
+   *        releases the fan-out finish in the background, and update the
+   *        latency and status of their peer. The list of peers is destroyed
+   *        only once they have returned, see wait_fetches().
+   */
+  class peer_fanout
+  {
+    public:
+      /**
+       * \brief hedge_delay in milliseconds, 0 for querying replicas on failures only.
+       */
+      peer_fanout(const std::string &query,
+                  const std::string &lang,
+                  const int &radius,
+                  const bool &swf,
+                  const int &hedge_delay,
+                  peer_fetch_fn fetch_fn=&peer_fanout::fetch_query_data);
+
+      /**
+       * \brief starts fetching query data from pe.
+       */
+      void add(peer *pe);
+
+      /**
+       * \brief waits for the next successful fetch, and queries replicas as needed.
+       * @param deadline absolute time after which no more fetches are waited for,
+       *        none if NULL.
+       * @return the fetch, NULL when all peers have answered or the deadline passed.
+       *         The fetch belongs to the fan-out.
+       */
+      peer_fetch* next(const struct timeval *deadline);
+
+      /**
+       * \brief drops the caller's reference. The fan-out is destroyed once
+       *        the last running fetch has returned.
+       */
+      void release();
+
+      /**
+       * \brief number of peers queried.
+       */
+      size_t size() const
+      {
+        return _slots.size();
+      };
+
+      /**
+       * \brief fetches query data of pf->_target through the rank estimator.
+       */
+      static void fetch_query_data(peer_fetch *pf);
+
+      /**
+       * \brief adds ms milliseconds to tv.
+       */
+      static void add_time(struct timeval &tv, const int &ms);
+
+      /**
+       * \brief milliseconds from t1 to t2.
+       */
+      static double elapsed(const struct timeval &t1, const struct timeval &t2);
+
+      /**
+       * \brief waits for the fetches of all fan-outs to return, so that the
+       *        peers they update can be destroyed.
+       */
+      static void wait_fetches();
+
+    private:
+      ~peer_fanout();
+
+      void start(peer_slot *ps, peer *pe, const bool &hedge);
+
+      static void* run_fetch(void *arg);
+
+      static void update_status(peer_fetch *pf);
+
+    public:
+      std::string _query;
+      std::string _lang;
+      int _radius;
+      bool _swf;
+
+    private:
+      int _hedge_delay;
+      peer_fetch_fn _fetch_fn;
+      std::vector<peer_slot*> _slots;
+      sp_mutex_t _mutex;
+      sp_cond_t _cond; /**< signaled when a fetch returns. */
+      int _refs; /**< the caller and the running fetches. */
+
+      static int _running; /**< fetches of all fan-outs that use their peer. */
+      static sp_mutex_t _running_mutex;
+      static sp_cond_t _running_cond; /**< signaled when no fetch is running. */
+  };
+
+} /* end of namespace. */
+
+#endif
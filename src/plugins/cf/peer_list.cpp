@@ -19,12 +19,15 @@
 #include "peer_list.h"
 #include "rank_estimators.h"
 #include "cf_configuration.h"
+#include "udb_client.h"
+#include "udb_summary.h"
 #include "db_record.h"
 #include "miscutil.h"
 #include "errlog.h"
 
 #include <time.h>
 #include <sys/time.h>
+#include <pthread.h>
 
 using sp::sweeper;
 using sp::miscutil;
@@ -35,7 +38,8 @@ namespace seeks_plugins
 
   /*- peer -*/
   peer::peer()
-    :_port(-1),_status(PEER_OK),_retries(0)
+    :_port(-1),_status(PEER_OK),_retries(0),_latency(-1.0),_last_probe(0),_replica(NULL),
+     _summary(NULL),_summary_date(0),_calls_avoided(0)
   {
     mutex_init(&_st_mutex);
   }
@@ -44,7 +48,9 @@ namespace seeks_plugins
              const int &port,
              const std::string &path,
              const std::string &rsc)
-    :_host(host),_port(port),_path(path),_status(PEER_OK),_retries(0),_rsc(rsc)
+    :_host(host),_port(port),_path(path),_status(PEER_OK),_retries(0),_rsc(rsc),
+     _latency(-1.0),_last_probe(0),_replica(NULL),
+     _summary(NULL),_summary_date(0),_calls_avoided(0)
   {
     mutex_init(&_st_mutex);
     _key = peer::generate_key(host,port,path);
@@ -52,6 +58,10 @@ namespace seeks_plugins
 
   peer::~peer()
   {
+    if (_replica)
+      delete _replica;
+    if (_summary)
+      delete _summary;
   }
 
   std::string peer::generate_key(const std::string &host,
@@ -92,6 +102,170 @@ namespace seeks_plugins
     return st;
   }
 
+  void peer::update_latency(const double &latency)
+  {
+    static double alpha = 0.3; // weight of the last response time.
+    mutex_lock(&_st_mutex);
+    if (_latency < 0.0)
+      _latency = latency;
+    else _latency = alpha * latency + (1.0 - alpha) * _latency;
+    mutex_unlock(&_st_mutex);
+  }
+
+  double peer::get_latency()
+  {
+    mutex_lock(&_st_mutex);
+    double latency = _latency;
+    mutex_unlock(&_st_mutex);
+    return latency;
+  }
+
+  bool peer::is_slow(const double &max_latency, const int &probe_interval)
+  {
+    mutex_lock(&_st_mutex);
+    bool slow = (max_latency > 0.0 && _latency > max_latency);
+    if (slow)
+      {
+        struct timeval tv_now;
+        gettimeofday(&tv_now,NULL);
+        if (difftime(tv_now.tv_sec,_last_probe) >= probe_interval)
+          {
+            _last_probe = tv_now.tv_sec;
+            slow = false;
+          }
+      }
+    mutex_unlock(&_st_mutex);
+    return slow;
+  }
+
+  void peer::set_summary(udb_summary *us)
+  {
+    mutex_lock(&_st_mutex);
+    if (_summary)
+      delete _summary;
+    _summary = us;
+    _summary_date = time(NULL);
+    mutex_unlock(&_st_mutex);
+  }
+
+  bool peer::has_fresh_summary(const int &max_age)
+  {
+    mutex_lock(&_st_mutex);
+    bool fresh = (_summary && difftime(time(NULL),_summary_date) < max_age);
+    mutex_unlock(&_st_mutex);
+    return fresh;
+  }
+
+  bool peer::may_have(const std::vector<std::string> &qhashes, const int &max_age)
+  {
+    mutex_lock(&_st_mutex);
+    bool may = true;
+    if (_summary && difftime(time(NULL),_summary_date) < max_age)
+      {
+        // a stale summary may miss recent records, and is not used.
+        may = _summary->may_contain_any(qhashes);
+        if (!may)
+          _calls_avoided++;
+      }
+    mutex_unlock(&_st_mutex);
+    return may;
+  }
+
+  /*- peer_summary_refresher -*/
+  peer_summary_refresher::peer_summary_refresher(peer_list *pl)
+    :sweepable(),_pl(pl),_last_refresh(0),_running(false)
+  {
+    mutex_init(&_ref_mutex);
+  }
+
+  peer_summary_refresher::~peer_summary_refresher()
+  {
+  }
+
+  bool peer_summary_refresher::sweep_me()
+  {
+    int refresh = cf_configuration::_config->_peer_summary_refresh;
+    if (refresh <= 0)
+      return false;
+    mutex_lock(&_ref_mutex);
+    time_t now = time(NULL);
+    if (_running || difftime(now,_last_refresh) < refresh)
+      {
+        mutex_unlock(&_ref_mutex);
+        return false;
+      }
+    _running = true;
+    _last_refresh = now;
+    mutex_unlock(&_ref_mutex);
+
+    pthread_t refresh_thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&refresh_thread,&attr,&peer_summary_refresher::run_refresh,this);
+    pthread_attr_destroy(&attr);
+    if (err != 0)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"Error creating thread for refreshing peer summaries: %d",err);
+        mutex_lock(&_ref_mutex);
+        _running = false;
+        mutex_unlock(&_ref_mutex);
+      }
+    return false;
+  }
+
+  void* peer_summary_refresher::run_refresh(void *arg)
+  {
+    peer_summary_refresher *psr = static_cast<peer_summary_refresher*>(arg);
+    psr->refresh();
+    mutex_lock(&psr->_ref_mutex);
+    psr->_running = false;
+    mutex_unlock(&psr->_ref_mutex);
+    return NULL;
+  }
+
+  void peer_summary_refresher::refresh()
+  {
+    int refresh = cf_configuration::_config->_peer_summary_refresh;
+    std::vector<peer*> peers;
+    mutex_lock(&_pl->_pl_mutex);
+    hash_map<const char*,peer*,hash<const char*>,eqstr>::const_iterator hit
+    = _pl->_peers.begin();
+    while(hit!=_pl->_peers.end())
+      {
+        // tokyo tyrant peers serve no summary.
+        peer *pe = (*hit).second;
+        if ((pe->_rsc == "sn" || pe->_rsc == "bsn")
+            && pe->get_status() == PEER_OK
+            && !pe->has_fresh_summary(refresh))
+          peers.push_back(pe);
+        ++hit;
+      }
+    mutex_unlock(&_pl->_pl_mutex);
+
+    udb_client udbc;
+    for (size_t i=0; i<peers.size(); i++)
+      {
+        peer *pe = peers.at(i);
+        try
+          {
+            udb_summary *us = udbc.find_summary(pe->_host,pe->_port,pe->_path);
+            if (us)
+              {
+                errlog::log_error(LOG_LEVEL_DEBUG,"fetched summary of %u keys from %s",
+                                  (uint32_t)us->_nkeys,pe->_key.c_str());
+                pe->set_summary(us);
+              }
+          }
+        catch (sp_exception &e)
+          {
+            // peer keeps its last summary, that is used until stale.
+            errlog::log_error(LOG_LEVEL_DEBUG,"failed fetching summary from %s: %s",
+                              pe->_key.c_str(),e.what().c_str());
+          }
+      }
+  }
+
   /*- dead_peer -*/
   peer_list* dead_peer::_dpl = NULL;
   peer_list* dead_peer::_pl = NULL;
@@ -23,11 +23,16 @@
 #include "sweeper.h"
 #include "mutexes.h"
 
+#include <string>
+#include <vector>
+
 using sp::sweepable;
 
 namespace seeks_plugins
 {
 
+  class udb_summary;
+
   enum PEER_STATUS
   {
     PEER_OK,
@@ -57,6 +62,38 @@ namespace seeks_plugins
       void set_status_unknown();
       enum PEER_STATUS get_status();
 
+      /**
+       * \brief updates the moving average of the response time with a new
+       *        response time, in milliseconds.
+       */
+      void update_latency(const double &latency);
+
+      double get_latency();
+
+      /**
+       * \brief whether the average response time is above max_latency, in
+       *        milliseconds. A slow peer is let through once every
+       *        probe_interval seconds, so that its average gets updated.
+       */
+      bool is_slow(const double &max_latency, const int &probe_interval);
+
+      /**
+       * \brief replaces the summary of the peer's user db, and takes ownership of it.
+       */
+      void set_summary(udb_summary *us);
+
+      /**
+       * \brief whether the summary was fetched less than max_age seconds ago.
+       */
+      bool has_fresh_summary(const int &max_age);
+
+      /**
+       * \brief whether the peer may have records for at least one of the query hashes.
+       *        Peers without a summary younger than max_age seconds may have any.
+       *        Counts the calls that the summary allows to avoid.
+       */
+      bool may_have(const std::vector<std::string> &qhashes, const int &max_age);
+
       std::string _host;
       int _port;
       std::string _path;
@@ -65,6 +102,12 @@ namespace seeks_plugins
       int _retries;
       std::string _rsc; // "tt", "sn" or "bsn", that is tokyo tyrant, seeks node, or 'batch' seeks node.
       std::string _key;
+      double _latency; /**< moving average of the response time, in milliseconds, -1 if unknown. */
+      time_t _last_probe; /**< last time the peer was let through while slow. */
+      peer *_replica; /**< peer with the same data, queried when this one is late or fails, owned. */
+      udb_summary *_summary; /**< summary of the peer's user db, NULL if unknown. */
+      time_t _summary_date; /**< time at which the summary was fetched. */
+      uint64_t _calls_avoided; /**< number of queries for which the summary avoided calling the peer. */
   };
 
   class peer_list;
@@ -93,6 +136,39 @@ namespace seeks_plugins
       static peer_list *_pl; /**< pointer to full list of peers, for status update. */
   };
 
+  /**
+   * \brief recurrent task that refreshes the user db summaries of the
+   *        remote seeks nodes in the list of peers. Summaries are fetched
+   *        in a background thread, so that sweeping does not block.
+   */
+  class peer_summary_refresher : public sweepable
+  {
+    public:
+      peer_summary_refresher(peer_list *pl);
+
+      virtual ~peer_summary_refresher();
+
+      /**
+       * \brief starts a refresh when the summaries are older than the
+       *        refresh interval and no refresh is running. Never asks for
+       *        its own deletion.
+       */
+      virtual bool sweep_me();
+
+      /**
+       * \brief fetches the summaries of the peers whose summary is older than
+       *        the refresh interval.
+       */
+      void refresh();
+
+      static void* run_refresh(void *arg);
+
+      peer_list *_pl;
+      time_t _last_refresh;
+      bool _running;
+      sp_mutex_t _ref_mutex;
+  };
+
   class peer_list
   {
     public:
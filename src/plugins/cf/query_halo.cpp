@@ -0,0 +1,259 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "query_halo.h"
+#include "mrf.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+using lsh::mrf;
+
+namespace seeks_plugins
+{
+
+  query_halo::query_halo(const std::string &query,
+                         const stopwordlist *swl)
+    :_swl(swl)
+  {
+    query_halo::ranked_query(query,swl,_rquery);
+    if (_rquery.size() <= 64)
+      query_halo::pattern_masks(_rquery,_peq);
+  }
+
+  uint32_t query_halo::distance(const std::string &rquery,
+                                const uint32_t &max_distance) const
+  {
+    std::string rrquery;
+    query_halo::ranked_query(rquery,_swl,rrquery);
+    return query_halo::damerau_levenshtein_distance(_rquery,rrquery,max_distance,
+           _rquery.size() <= 64 ? _peq : NULL);
+  }
+
+  float query_halo::weight(const std::string &rquery) const
+  {
+    return 1.0 / (log(distance(rquery)+1.0)+1.0);
+  }
+
+  void query_halo::distances(const std::vector<std::string> &rqueries,
+                             std::vector<uint32_t> &dists,
+                             const uint32_t &max_distance) const
+  {
+    dists.reserve(dists.size()+rqueries.size());
+    for (size_t i=0; i<rqueries.size(); i++)
+      dists.push_back(distance(rqueries.at(i),max_distance));
+  }
+
+  /**
+   * \brief orders tokens of a query, given as offsets into it, as strings.
+   */
+  class token_less
+  {
+    public:
+      token_less(const std::string &query)
+        :_query(query)
+      {};
+
+      bool operator()(const std::pair<size_t,size_t> &t1,
+                      const std::pair<size_t,size_t> &t2) const
+      {
+        return _query.compare(t1.first,t1.second-t1.first,
+                              _query,t2.first,t2.second-t2.first) < 0;
+      }
+
+      const std::string &_query;
+  };
+
+  void query_halo::ranked_query(const std::string &query,
+                                const stopwordlist *swl,
+                                std::string &rquery)
+  {
+    bool delims[256];
+    mrf::delims_table(mrf::_default_delims,delims);
+    std::vector<std::pair<size_t,size_t> > tokens;
+    size_t pos = 0, begin = 0, end = 0;
+    while (mrf::next_token(query,delims,pos,begin,end))
+      tokens.push_back(std::pair<size_t,size_t>(begin,end));
+
+    // prune stop words if any. Beware: the token following a stop word
+    // is not checked, as in simple_re::query_distance.
+    if (swl)
+      {
+        for (size_t i=0; i<tokens.size(); i++)
+          if (swl->has_word(query.substr(tokens.at(i).first,
+                                         tokens.at(i).second-tokens.at(i).first)))
+            tokens.erase(tokens.begin()+i);
+      }
+
+    std::sort(tokens.begin(),tokens.end(),token_less(query));
+    rquery.clear();
+    rquery.reserve(query.size());
+    for (size_t i=0; i<tokens.size(); i++)
+      {
+        if (i > 0)
+          rquery += ' ';
+        rquery.append(query,tokens.at(i).first,tokens.at(i).second-tokens.at(i).first);
+      }
+  }
+
+  uint32_t query_halo::damerau_levenshtein_distance(const std::string &s1,
+      const std::string &s2,
+      const uint32_t &max_distance,
+      const uint64_t *peq)
+  {
+    const uint32_t len1 = s1.size(), len2 = s2.size();
+    uint32_t k = std::min(max_distance,std::max(len1,len2));
+    if ((len1 > len2 ? len1 - len2 : len2 - len1) > k)
+      return k + 1;
+    if (len1 == 0 || len2 == 0)
+      return std::max(len1,len2);
+
+    // the restricted distance bounds the distance from above, and they are
+    // equal up to 2: an edit between transposed characters costs at least 2
+    // on top of the transposition.
+    uint32_t band = k;
+    uint64_t lpeq[256];
+    if (!peq && len1 <= 64)
+      {
+        query_halo::pattern_masks(s1,lpeq);
+        peq = lpeq;
+      }
+    if (peq)
+      {
+        uint32_t osa = query_halo::osa_distance(s1,peq,s2);
+        if (osa <= 2)
+          return osa <= k ? osa : k + 1;
+        band = std::min(osa,k);
+      }
+    return query_halo::banded_distance(s1,s2,band);
+  }
+
+  void query_halo::pattern_masks(const std::string &s, uint64_t *peq)
+  {
+    memset(peq,0,256*sizeof(uint64_t));
+    for (size_t i=0; i<s.size(); i++)
+      peq[(unsigned char)s[i]] |= 1ULL << i;
+  }
+
+  uint32_t query_halo::osa_distance(const std::string &s1,
+                                    const uint64_t *peq,
+                                    const std::string &s2)
+  {
+    const uint32_t m = s1.size();
+    if (m == 0)
+      return s2.size();
+
+    // Hyyro's bit-vector algorithm, with transpositions: bit i of the
+    // vectors holds the vertical (VP/VN) and horizontal (HP/HN) deltas
+    // of the current column at row i.
+    const uint64_t last = 1ULL << (m-1);
+    uint64_t VP = (m == 64) ? ~0ULL : (1ULL << m) - 1;
+    uint64_t VN = 0, D0 = 0, PMprev = 0;
+    uint32_t score = m;
+    for (size_t j=0; j<s2.size(); j++)
+      {
+        uint64_t PM = peq[(unsigned char)s2[j]];
+        uint64_t TR = (((~D0) & PM) << 1) & PMprev;
+        D0 = (((PM & VP) + VP) ^ VP) | PM | VN | TR;
+        uint64_t HP = VN | ~(D0 | VP);
+        uint64_t HN = D0 & VP;
+        if (HP & last)
+          ++score;
+        else if (HN & last)
+          --score;
+        uint64_t X = (HP << 1) | 1;
+        VN = X & D0;
+        VP = (HN << 1) | ~(X | D0);
+        PMprev = PM;
+      }
+    return score;
+  }
+
+#define QUERY_HALO_STACK 4096
+
+  /**
+   * \brief distance capped to band+1, from the cells of the dynamic
+   *        programming within band of the diagonal, as any other exceeds band.
+   *        Stops as soon as a full row exceeds band.
+   */
+  uint32_t query_halo::banded_distance(const std::string &s1,
+                                       const std::string &s2,
+                                       const uint32_t &band)
+  {
+    const uint32_t len1 = s1.size(), len2 = s2.size();
+    const uint32_t cap = band + 1;
+    const uint32_t w = len2 + 2;
+
+    // H[i+1][j+1] is the distance between the first i characters of s1
+    // and the first j of s2. Out of band cells are only written where
+    // the next row reads them.
+    uint32_t sH[QUERY_HALO_STACK];
+    std::vector<uint32_t> vH;
+    uint32_t *H = sH;
+    if ((len1 + 2) * w > QUERY_HALO_STACK)
+      {
+        vH.resize((len1 + 2) * w);
+        H = &vH.at(0);
+      }
+    for (uint32_t j=0; j<=len2; j++)
+      {
+        H[j+1] = cap;
+        H[w+j+1] = std::min(j,cap);
+      }
+    H[0] = H[w] = cap;
+
+    uint32_t DA[256];
+    memset(DA,0,sizeof(DA));
+    for (uint32_t i=1; i<=len1; i++)
+      {
+        uint32_t *row = H + (i+1) * w;
+        const uint32_t *prow = row - w;
+        row[0] = cap;
+        row[1] = std::min(i,cap);
+        uint32_t jlo = (i > band) ? i - band : 1;
+        uint32_t jhi = std::min(len2,i+band);
+        if (jlo > 1)
+          row[jlo] = cap;
+        if (jhi < len2)
+          row[jhi+2] = cap;
+
+        uint32_t DB = 0;
+        uint32_t row_min = row[1];
+        for (uint32_t j=jlo; j<=jhi; j++)
+          {
+            uint32_t i1 = DA[(unsigned char)s2[j-1]];
+            uint32_t j1 = DB;
+            uint32_t d = ((s1[i-1]==s2[j-1])?0:1);
+            if (d==0) DB = j;
+            uint32_t h = std::min(std::min(prow[j]+d,row[j]+1),prow[j+1]+1);
+            if (i1 > 0 && j1 > 0
+                && (i1 > j1 ? i1 - j1 : j1 - i1) <= band)
+              h = std::min(h,H[i1 * w + j1] + (i-i1-1) + 1 + (j-j1-1));
+            h = std::min(h,cap);
+            row[j+1] = h;
+            row_min = std::min(row_min,h);
+          }
+        DA[(unsigned char)s1[i-1]] = i;
+        if (row_min >= cap)
+          return cap;
+      }
+    return H[(len1+1) * w + len2 + 1];
+  }
+
+} /* end of namespace. */
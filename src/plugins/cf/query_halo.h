@@ -0,0 +1,105 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QUERY_HALO_H
+#define QUERY_HALO_H
+
+#include "stopwordlist.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using lsh::stopwordlist;
+
+namespace seeks_plugins
+{
+
+  /**
+   * \brief distances and halo weights of a query to its related queries.
+   *        Queries are compared as their alphabetically ranked words, pruned
+   *        of stop words. The query is ranked once, and its bit masks are
+   *        built once for a bit-parallel comparison to each related query.
+   */
+  class query_halo
+  {
+    public:
+      query_halo(const std::string &query,
+                 const stopwordlist *swl=NULL);
+
+      ~query_halo() {};
+
+      /**
+       * \brief Damerau-Levenshtein distance to a related query, or
+       *        max_distance+1 if it is beyond max_distance.
+       */
+      uint32_t distance(const std::string &rquery,
+                        const uint32_t &max_distance=UINT_MAX) const;
+
+      /**
+       * \brief halo weight of a related query, 1.0 for the query itself.
+       */
+      float weight(const std::string &rquery) const;
+
+      /**
+       * \brief distances to related queries, in order.
+       */
+      void distances(const std::vector<std::string> &rqueries,
+                     std::vector<uint32_t> &dists,
+                     const uint32_t &max_distance=UINT_MAX) const;
+
+      static void ranked_query(const std::string &query,
+                               const stopwordlist *swl,
+                               std::string &rquery);
+
+      /**
+       * \brief (unrestricted) Damerau-Levenshtein distance, or max_distance+1
+       *        if it is beyond max_distance. peq are the bit masks of s1, if
+       *        built.
+       */
+      static uint32_t damerau_levenshtein_distance(const std::string &s1,
+          const std::string &s2,
+          const uint32_t &max_distance=UINT_MAX,
+          const uint64_t *peq=NULL);
+
+      /**
+       * \brief restricted Damerau-Levenshtein distance (no edit between
+       *        transposed characters), bit-parallel. s1 must be no longer than
+       *        a machine word, and peq its bit masks.
+       */
+      static uint32_t osa_distance(const std::string &s1,
+                                   const uint64_t *peq,
+                                   const std::string &s2);
+
+      static void pattern_masks(const std::string &s, uint64_t *peq);
+
+    private:
+      static uint32_t banded_distance(const std::string &s1,
+                                      const std::string &s2,
+                                      const uint32_t &band);
+
+    private:
+      const stopwordlist *_swl;
+      std::string _rquery;
+      uint64_t _peq[256]; /**< bit masks of _rquery's characters. */
+  };
+
+} /* end of namespace. */
+
+#endif
@@ -98,6 +98,7 @@ namespace seeks_plugins
     std::transform(qquery.begin(),qquery.end(),qquery.begin(),tolower);*/
 
     // rank related queries.
+    query_halo qh(query,swl);
     hash_map<const char*,double,hash<const char*>,eqstr> update;
     hash_map<const char*,double,hash<const char*>,eqstr>::iterator uit;
     hash_map<const char*,query_data*,hash<const char*>,eqstr>::iterator hit
@@ -111,9 +112,8 @@ namespace seeks_plugins
         if (query != rquery)
           {
             //std::cerr << "rquery: " << rquery << " -- query: " << query << std::endl;
-            short radius = (*hit).second->_radius;
             double hits = (*hit).second->_hits;
-            double score = 1.0 / simple_re::query_halo_weight(query,rquery,radius,swl) * 1.0 / hits; // max weight is best.
+            double score = 1.0 / qh.weight(rquery) * 1.0 / hits; // max weight is best.
             if ((uit = update.find(rquery.c_str()))!=update.end())
               (*uit).second *= score;
             else update.insert(std::pair<const char*,double>(strdup(rquery.c_str()),score));
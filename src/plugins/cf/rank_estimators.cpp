@@ -17,6 +17,7 @@
  */
 
 #include "rank_estimators.h"
+#include "peer_fanout.h"
 #include "query_recommender.h"
 #include "cf.h"
 #include "cf_configuration.h"
@@ -53,153 +54,128 @@ using sp::errlog;
 namespace seeks_plugins
 {
 
+  /*- dbr_fetcher -*/
+  db_record* dbr_fetcher::fetch() throw (sp_exception)
+  {
+    user_db udb(false,"",_host,_port,_path,_rsc);
+    if (_rsc != "sn") // remote db.
+      {
+        int err = udb.open_db();
+        if (err != SP_ERR_OK)
+          {
+            std::string msg = "cannot open remote db " + _host + ":" + miscutil::to_string(_port);
+            throw sp_exception(err,msg);
+          }
+      }
+    return udb.find_dbr(_key,_plugin_name);
+  }
+
+  /*- bqc_fetcher -*/
+  db_record* bqc_fetcher::fetch() throw (sp_exception)
+  {
+    udb_client udbc;
+    return udbc.find_bqc(_host,_port,_path,_query,_radius+1); // XXX: +1 is for compatibility.
+  }
+
   /*- rank_estimator -*/
   cr_store rank_estimator::_store;
-  sp_mutex_t rank_estimator::_est_mutex;
+  sp_mutex_t rank_estimator::_est_mutex = PTHREAD_MUTEX_INITIALIZER;
 
   rank_estimator::rank_estimator(const bool &swf)
     :_swf(swf)
   {
-    mutex_init(&_est_mutex);
   }
 
-  // threaded call to personalization.
   void rank_estimator::peers_personalize(query_context *qc,
                                          const bool &wait_external_sources,
                                          const std::string &peers,
                                          const int &radius)
   {
-    std::vector<pthread_t> perso_threads;
-    std::vector<perso_thread_arg*> perso_args;
-
-    // thread for local db.
-    threaded_personalize(perso_args,perso_threads,NULL,qc,wait_external_sources,radius);
+    int rad = (radius == -1) ? 0 : radius; // -1 should not happen in normal operations.
+    qc->_npeers = 0;
 
-    // one thread per remote peer, to handle the IO.
+    // remote peers are queried first, they answer while local data is used.
+    peer_fanout *pfo = NULL;
+    struct timeval deadline;
+    const int perso_deadline = cf_configuration::_config->_perso_deadline;
     if (peers == "ring")
       {
+        pfo = new peer_fanout(qc->_lc_query,qc->_auto_lang,rad,_swf,
+                              cf_configuration::_config->_peer_hedge_delay);
+
+        // peers whose summary holds none of the query hashes are not called.
+        std::vector<std::string> qhashes;
+        const int summary_age = 2 * cf_configuration::_config->_peer_summary_refresh;
+        if (summary_age > 0)
+          rank_estimator::query_hashes(qc->_lc_query,qhashes);
+        uint32_t navoided = 0;
+
         hash_map<const char*,peer*,hash<const char*>,eqstr>::const_iterator hit
         = cf_configuration::_config->_pl->_peers.begin();
         while(hit!=cf_configuration::_config->_pl->_peers.end())
           {
-            // connect to living peers only.
-            if ((*hit).second->get_status() == PEER_OK)
-              threaded_personalize(perso_args,perso_threads,
-                                   (*hit).second,qc,wait_external_sources,radius);
-            else
+            // connect to living peers only, and skip those that usually answer too late.
+            peer *pe = (*hit).second;
+            ++hit;
+            if (pe->get_status() != PEER_OK
+                || pe->is_slow(perso_deadline,cf_configuration::_config->_dead_peer_check))
+              continue;
+            if (!qhashes.empty() && !pe->may_have(qhashes,summary_age))
               {
-                perso_args.push_back(NULL);
-                perso_threads.push_back(0);
+                navoided++;
+                continue;
               }
-            ++hit;
+            pfo->add(pe);
           }
+        if (navoided > 0)
+          errlog::log_error(LOG_LEVEL_DEBUG,"avoided calling %u peers with no data for %s",
+                            navoided,qc->_lc_query.c_str());
+        gettimeofday(&deadline,NULL);
+        peer_fanout::add_time(deadline,perso_deadline);
       } // end ring.
 
-    // join.
-    for (size_t i=0; i<perso_threads.size(); i++)
+    // local db.
+    try
       {
-        if (perso_threads.at(i)!=0)
-          pthread_join(perso_threads.at(i),NULL);
+        peer pe;
+        personalize(qc->_lc_query,qc->_auto_lang,rad,
+                    qc->_cached_snippets,qc->_suggestions,
+                    &pe,qc,wait_external_sources);
+        qc->_npeers++;
       }
-
-    // clear.
-    qc->_npeers = 0;
-    for (size_t i=0; i<perso_args.size(); i++)
+    catch(sp_exception &e)
       {
-        if (perso_args.at(i))
-          {
-            if (perso_args.at(i)->_err == SP_ERR_OK)
-              qc->_npeers++;
-            delete perso_args.at(i);
-          }
+        errlog::log_error(LOG_LEVEL_DEBUG,"local personalization failed: %s",e.what().c_str());
       }
-  }
 
-  void rank_estimator::threaded_personalize(std::vector<perso_thread_arg*> &perso_args,
-      std::vector<pthread_t> &perso_threads,
-      peer *pe,
-      query_context *qc,
-      const bool &wait_external_sources,
-      const int &radius)
-  {
-    perso_thread_arg *args  = new perso_thread_arg();
-    args->_query = qc->_lc_query; // lower case query.
-    args->_lang = qc->_auto_lang;
-    args->_snippets = &qc->_cached_snippets;
-    args->_related_queries = &qc->_suggestions;
-    args->_estimator = this;
-    args->_qc = qc;
-    args->_pe = pe;
-    if (radius == -1) // should not happen in normal operations.
-      args->_radius = 0;
-    else args->_radius = radius;
-    args->_wait = wait_external_sources;
-    args->_err = SP_ERR_OK;
-
-    pthread_t p_thread;
-    int err = pthread_create(&p_thread, NULL, // default attribute is PTHREAD_CREATE_JOINABLE
-                             (void * (*)(void*))rank_estimator::personalize_cb,args);
-    if (err!=0)
-      {
-        errlog::log_error(LOG_LEVEL_ERROR,"Error creating personalization thread.");
-        perso_threads.push_back(0);
-        delete args;
-        perso_args.push_back(NULL);
-        return;
-      }
-    perso_args.push_back(args);
-    perso_threads.push_back(p_thread);
-  }
+    if (!pfo)
+      return;
 
-  void rank_estimator::personalize_cb(perso_thread_arg *args)
-  {
-    // call + catch exception here.
-    try
+    // remote answers, as they arrive and until the deadline.
+    peer_fetch *pf = NULL;
+    uint32_t nremote = 0;
+    while ((pf = pfo->next(perso_deadline > 0 ? &deadline : NULL)))
       {
-        if (!args->_pe)
+        try
           {
-            peer pe;
-            pe.set_status_ok();
-            args->_estimator->personalize(args->_query,args->_lang,
-                                          args->_radius,
-                                          *args->_snippets,
-                                          *args->_related_queries,
-                                          &pe,
-                                          args->_qc,
-                                          args->_wait);
+            personalize(qc->_lc_query,qc->_auto_lang,rad,
+                        qc->_cached_snippets,qc->_suggestions,
+                        &pf->_target,qc,wait_external_sources,
+                        pf->_qdata,pf->_inv_qdata);
+            nremote++;
           }
-        else
-          args->_estimator->personalize(args->_query,args->_lang,
-                                        args->_radius,
-                                        *args->_snippets,
-                                        *args->_related_queries,
-                                        args->_pe,
-                                        args->_qc,
-                                        args->_wait);
-      }
-    catch(sp_exception &e)
-      {
-        args->_err = e.code();
-      }
-
-    // set peer status.
-    if (args->_pe && args->_err != SP_ERR_OK && args->_err != DB_ERR_NO_REC)
-      {
-        if (++args->_pe->_retries > cf_configuration::_config->_dead_peer_retries)
+        catch(sp_exception &e)
           {
-            if (args->_err == UDBS_ERR_CONNECT)
-              args->_pe->set_status_no_connect();
-            else args->_pe->set_status_unknown(); // most likely to be a slow transmission.
-
-            // add peer to monitoring list.
-            dead_peer *dpe = new dead_peer(args->_pe->_host,
-                                           args->_pe->_port,
-                                           args->_pe->_path,
-                                           args->_pe->_rsc);
+            errlog::log_error(LOG_LEVEL_DEBUG,"personalization with %s failed: %s",
+                              pf->_target._key.c_str(),e.what().c_str());
           }
       }
-    else if (args->_pe)
-      args->_pe->set_status_ok();
+    qc->_npeers += nremote;
+    errlog::log_error(LOG_LEVEL_DEBUG,"personalized with %u of %u remote peers",
+                      nremote,(uint32_t)pfo->size());
+
+    // fetches still running finish in the background.
+    pfo->release();
   }
 
   void rank_estimator::fetch_query_data(const std::string &query,
@@ -256,10 +232,7 @@ namespace seeks_plugins
           delete udb;
 
         // destroy records.
-        if (udb == seeks_proxy::_user_db
-            || cf_configuration::_config->_record_cache_timeout == 0)
-          rank_estimator::destroy_records(records);
-        else rank_estimator::destroy_records_key(records);
+        rank_estimator::destroy_records(records);
       }
     else // remote batch seeks node operations.
       {
@@ -268,8 +241,7 @@ namespace seeks_plugins
           {
             db_query_record *dbqr = static_cast<db_query_record*>(dbr);
             db_query_record::copy_related_queries(dbqr->_related_queries,qdata);
-            if (cf_configuration::_config->_record_cache_timeout == 0)
-              delete dbqr;
+            delete dbqr;
             rank_estimator::filter_extracted_queries(query,lang,radius,qdata,inv_qdata);
             errlog::log_error(LOG_LEVEL_DEBUG,"%s%s: fetched %d queries",
                               host.c_str(),path.c_str(),qdata.size());
@@ -278,18 +250,13 @@ namespace seeks_plugins
       }
   }
 
-  void rank_estimator::fetch_user_db_record(const std::string &query,
-      user_db *udb,
-      hash_map<const DHTKey*,db_record*,hash<const DHTKey*>,eqdhtkey> &records)
+  void rank_estimator::query_hashes(const std::string &query,
+                                    std::vector<std::string> &qhashes)
   {
-    static std::string qc_str = "query-capture";
-
     // generate query fragments.
     hash_multimap<uint32_t,DHTKey,id_hash_uint> features;
     qprocess::generate_query_hashes(query,0,5,features); //TODO: from configuration (5).
 
-    // fetch records from the user DB.
-    std::vector<std::string> qhashes;
     hash_multimap<uint32_t,DHTKey,id_hash_uint>::const_iterator hit = features.begin();
     while (hit!=features.end())
       {
@@ -297,6 +264,15 @@ namespace seeks_plugins
         qhashes.push_back(key_str);
         ++hit;
       }
+  }
+
+  void rank_estimator::fetch_user_db_record(const std::string &query,
+      user_db *udb,
+      hash_map<const DHTKey*,db_record*,hash<const DHTKey*>,eqdhtkey> &records)
+  {
+    // fetch records from the user DB.
+    std::vector<std::string> qhashes;
+    rank_estimator::query_hashes(query,qhashes);
     fetch_user_db_record(qhashes,udb,records);
   }
 
@@ -351,6 +327,7 @@ namespace seeks_plugins
     while (vit!=records.end())
       {
         db_query_record *dbqr = static_cast<db_query_record*>((*vit).second);
+        std::vector<const char*> moved; // query data moved out of the record.
         hash_map<const char*,query_data*,hash<const char*>,eqstr>::const_iterator qit
         = dbqr->_related_queries.begin();
         while (qit!=dbqr->_related_queries.end())
@@ -379,11 +356,11 @@ namespace seeks_plugins
 
                 if (qd->_radius == 0) // contains the data.
                   {
-                    query_data *nqd = new query_data(qd);
-                    nqd->_radius = nradius;
-                    nqd->_record_key = new DHTKey(*(*vit).first); // mark data with record key.
-                    qdata.insert(std::pair<const char*,query_data*>(nqd->_query.c_str(),nqd));
-                    rank_estimator::fillup_inv_qdata(nqd,inv_qdata);
+                    moved.push_back((*qit).first);
+                    qd->_radius = nradius;
+                    qd->_record_key = new DHTKey(*(*vit).first); // mark data with record key.
+                    qdata.insert(std::pair<const char*,query_data*>(qd->_query.c_str(),qd));
+                    rank_estimator::fillup_inv_qdata(qd,inv_qdata);
                   }
                 else if (query.empty() || nradius <= radius)
                   {
@@ -427,14 +404,15 @@ namespace seeks_plugins
 
                     if (dbqr_data)
                       {
-                        hash_map<const char*,query_data*,hash<const char*>,eqstr>::const_iterator qit2
+                        hash_map<const char*,query_data*,hash<const char*>,eqstr>::iterator qit2
                         = dbqr_data->_related_queries.begin();
                         while (qit2!=dbqr_data->_related_queries.end())
                           {
                             if ((*qit2).second->_radius == 0
                                 && (*qit2).second->_query == qd->_query)
                               {
-                                query_data *dbqrc = new query_data((*qit2).second);
+                                query_data *dbqrc = (*qit2).second;
+                                dbqr_data->_related_queries.erase(qit2);
                                 dbqrc->_radius = nradius;
                                 dbqrc->_record_key = new DHTKey((*features.begin()).second); // mark the data with the record key.
                                 qdata.insert(std::pair<const char*,query_data*>(dbqrc->_query.c_str(),
@@ -446,9 +424,7 @@ namespace seeks_plugins
                               }
                             ++qit2;
                           }
-                        // do not delete if it comes from the store.
-                        if (!in_store)
-                          delete dbqr_data;
+                        delete dbqr_data;
                       }
                   }
                 /*else // radius is below requested radius, keep queries for recommendation.
@@ -468,6 +444,10 @@ namespace seeks_plugins
               }
             ++qit;
           }
+
+        // erased while the keys, that point to the data, are still valid.
+        for (size_t i=0; i<moved.size(); i++)
+          dbqr->_related_queries.erase(moved[i]);
         ++vit;
       }
   }
@@ -577,7 +557,9 @@ namespace seeks_plugins
             if (use_store && cf_configuration::_config->_record_cache_timeout > 0)
               {
                 bool has_key = false;
-                dbr = rank_estimator::_store.find(dorj->_host,dorj->_port,dorj->_path,rkey,has_key);
+                dbr = rank_estimator::_store.find(dorj->_host,dorj->_port,dorj->_path,rkey,has_key,
+                                                  new dbr_fetcher(dorj->_host,dorj->_port,dorj->_path,
+                                                      udb->get_rsc(),key,plugin_name));
                 if (dbr || has_key)
                   {
                     errlog::log_error(LOG_LEVEL_DEBUG,"found in store: record %s from %s%s",
@@ -591,7 +573,7 @@ namespace seeks_plugins
             dbr = udb->find_dbr(key,plugin_name);
             if (use_store && cf_configuration::_config->_record_cache_timeout > 0)
               {
-                rank_estimator::_store.add(dorj->_host,dorj->_port,dorj->_path,rkey,dbr);
+                rank_estimator::_store.add(dorj->_host,dorj->_port,dorj->_path,rkey,dbr,plugin_name);
                 errlog::log_error(LOG_LEVEL_DEBUG,"storing: record %s from %s%s",
                                   key.c_str(),dorj->_host.c_str(),dorj->_path.c_str());
 
@@ -612,7 +594,8 @@ namespace seeks_plugins
     if (use_store && cf_configuration::_config->_record_cache_timeout > 0)
       {
         bool has_key = false;
-        dbr = rank_estimator::_store.find(host,port,path,query,has_key);
+        dbr = rank_estimator::_store.find(host,port,path,query,has_key,
+                                          new bqc_fetcher(host,port,path,query,radius));
         if (dbr || has_key)
           {
             errlog::log_error(LOG_LEVEL_DEBUG,"found in store: bqc record %s from %s%s",
@@ -624,17 +607,8 @@ namespace seeks_plugins
     // otherwise, make a call and store result.
     if (!dbr)
       {
-        udb_client udbc;
-        try
-          {
-            dbr = udbc.find_bqc(host,port,path,query,radius+1); // XXX: +1 is for compatibility.
-          }
-        catch (sp_exception &e)
-          {
-            if (!dbr)
-              delete dbr;
-            throw e;
-          }
+        bqc_fetcher bqcf(host,port,path,query,radius);
+        dbr = bqcf.fetch();
         if (use_store && cf_configuration::_config->_record_cache_timeout > 0)
           {
             rank_estimator::_store.add(host,port,path,query,dbr);
@@ -736,8 +710,22 @@ namespace seeks_plugins
         throw e;
       }
 
-    // build up the filter based on local data.
-    // XXX: we could prioretize the call to the local user db.
+    personalize(query,lang,radius,snippets,related_queries,pe,qc,wait_external_sources,
+                qdata,inv_qdata);
+  }
+
+  void simple_re::personalize(const std::string &query,
+                              const std::string &lang,
+                              const int &radius,
+                              std::vector<search_snippet*> &snippets,
+                              std::multimap<double,std::string,std::less<double> > &related_queries,
+                              peer *pe,
+                              query_context *qc,
+                              const bool &wait_external_sources,
+                              hash_map<const char*,query_data*,hash<const char*>,eqstr> &qdata,
+                              hash_map<const char*,std::vector<query_data*>,hash<const char*>,eqstr> &inv_qdata) throw (sp_exception)
+  {
+    // build up the filter based on local data, which is used before remote data.
     hash_map<uint32_t,bool,id_hash_uint> filter;
     if (pe->_host.empty()) // we're local.
       {
@@ -780,7 +768,8 @@ namespace seeks_plugins
     if (wait_external_sources)
       {
         mutex_lock(&qc->_feeds_ack_mutex);
-        cond_wait(&qc->_feeds_ack_cond,&qc->_feeds_ack_mutex);
+        while (!qc->_feeds_acked)
+          cond_wait(&qc->_feeds_ack_cond,&qc->_feeds_ack_mutex);
         mutex_unlock(&qc->_feeds_ack_mutex);
       }
 
@@ -798,6 +787,7 @@ namespace seeks_plugins
         // destroy query data.
         rank_estimator::destroy_query_data(qdata);
         rank_estimator::destroy_inv_qdata_key(inv_qdata);
+        qdata.clear();
       }
   }
 
@@ -848,18 +838,24 @@ namespace seeks_plugins
     if (_swf)
       swl = seeks_proxy::_lsh_config->get_wordlist(lang);
 
-    // gather normalizing values.
+    // gather normalizing values, and the halo weights of related queries,
+    // computed once against the query.
+    query_halo qh(query,swl);
     float cumul_halo_weights = 0.0;
+    hash_map<const char*,float,hash<const char*>,eqstr> halo_weights;
+    hash_map<const char*,float,hash<const char*>,eqstr>::const_iterator wit;
     hash_map<const char*,query_data*,hash<const char*>,eqstr>::const_iterator hit
     = qdata->begin();
     while (hit!=qdata->end())
       {
         query_data *qd = (*hit).second;
-        cumul_halo_weights += simple_re::query_halo_weight(query,qd->_query,qd->_radius,swl);
+        float weight = qh.weight(qd->_query);
+        halo_weights.insert(std::pair<const char*,float>(qd->_query.c_str(),weight));
+        cumul_halo_weights += weight;
         ++hit;
       }
     if (cumul_halo_weights == 0) // no user data, so we need a reference weight.
-      cumul_halo_weights = simple_re::query_halo_weight(query,query,0,swl);
+      cumul_halo_weights = qh.weight(query);
 
     // reset hits and weights.
     float sum_se_ranks = 0.0;
@@ -904,6 +900,10 @@ namespace seeks_plugins
         if ((*vit)->_engine.has_feed("seeks"))
           host = "";
 
+        // URL and host are looked up by hash in the URL tables of the queries.
+        uint32_t url_hash = query_data::hash_vurl(url);
+        uint32_t host_hash = query_data::hash_vurl(host);
+
         posteriors[j] = 0.0;
 
         float qpost = 0.0;
@@ -931,11 +931,14 @@ namespace seeks_plugins
             while(qit!=vqd.end())
               {
                 query_data *qd = (*qit);
-                qpost = estimate_rank((*vit),filter->empty() ? NULL:filter,ns,qd,
-                                      qd->vurls_total_hits(),url,host,spers);
+                qpost = estimate_rank((*vit),filter->empty() ? NULL:filter,ns,
+                                      qd->find_vurl(url_hash,url),qd->find_vurl(host_hash,host),
+                                      qd->_vurls_total_hits,
+                                      cf_configuration::_config->_domain_name_weight,spers);
                 if (qpost > 0.0)
                   {
-                    float weight = simple_re::query_halo_weight(query,qd->_query,qd->_radius,swl);
+                    float weight = ((wit = halo_weights.find(qd->_query.c_str())) != halo_weights.end())
+                                   ? (*wit).second : qh.weight(qd->_query);
                     float weightq = 1.0;
                     std::vector<query_data*>::const_iterator qit2 = vqd.begin();
                     while(qit2!=vqd.end())
@@ -1408,48 +1411,14 @@ namespace seeks_plugins
   uint32_t simple_re::damerau_levenshtein_distance(const std::string &s1, const std::string &s2,
       const uint32_t &c)
   {
-    const uint32_t len1 = s1.size(), len2 = s2.size();
-    uint32_t inf = len1 + len2;
-    //uint32_t H[len1+2][len2+2];
-    std::vector<std::vector<uint32_t> > He(len1+2,std::vector<uint32_t>(len2+2));
-    He[0][0] = inf;
-    for(uint32_t i = 0; i<=len1; ++i)
-      {
-        He[i+1][1] = i;
-        He[i+1][0] = inf;
-      }
-    for(uint32_t j = 0; j<=len2; ++j)
-      {
-        He[1][j+1] = j;
-        He[0][j+1] = inf;
-      }
-    uint32_t DA[c];
-    for(uint32_t d = 0; d<c; ++d) DA[d]=0;
-    for(uint32_t i = 1; i<=len1; ++i)
-      {
-        uint32_t DB = 0;
-        for(uint32_t j = 1; j<=len2; ++j)
-          {
-            uint32_t i1 = DA[(unsigned char)s2[j-1]];
-            uint32_t j1 = DB;
-            uint32_t d = ((s1[i-1]==s2[j-1])?0:1);
-            if(d==0) DB = j;
-            He[i+1][j+1] = std::min(std::min(He[i][j]+d, He[i+1][j] + 1),
-                                    std::min(He[i][j+1]+1,
-                                             He[i1][j1] + (i-i1-1) + 1 + (j-j1-1)));
-          }
-        DA[(unsigned char)s1[i-1]] = i;
-      }
-    return He[len1+1][len2+1];
+    return query_halo::damerau_levenshtein_distance(s1,s2);
   }
 
   uint32_t simple_re::query_distance(const std::string &s1, const std::string &s2,
                                      const stopwordlist *swl)
   {
-    str_chain sc1(s1,0,true);
-    str_chain sc2(s2,0,true);
-
-    return simple_re::query_distance(sc1,sc2,swl);
+    query_halo qh(s1,swl);
+    return qh.distance(s2);
   }
 
   uint32_t simple_re::query_distance(str_chain &sc1, str_chain &sc2,
@@ -1476,10 +1445,9 @@ namespace seeks_plugins
   float simple_re::query_halo_weight(const std::string &q1, const std::string &q2,
                                      const uint32_t &q2_radius, const stopwordlist *swl)
   {
-    str_chain s1(q1,0,true);
-    str_chain s2(q2,0,true);
     //return log(1.0 + std::max(s1.size(),s2.size()) - q2_radius) / (log(simple_re::query_distance(s1,s2,swl) + 1.0) + 1.0);
-    return 1.0 / (log(simple_re::query_distance(s1,s2,swl)+1.0)+1.0);
+    query_halo qh(q1,swl);
+    return qh.weight(q2);
   }
 
   void simple_re::build_up_filter(hash_map<const char*,query_data*,hash<const char*>,eqstr> *qdata,
@@ -25,6 +25,7 @@
 #include "search_snippet.h"
 #include "db_query_record.h"
 #include "stopwordlist.h"
+#include "query_halo.h"
 #include "mrf.h"
 #include "mutexes.h"
 
@@ -34,27 +35,51 @@ using lsh::str_chain;
 namespace seeks_plugins
 {
 
-  class rank_estimator;
+  /**
+   * \brief fetches a record from a remote user db, for refreshing the store.
+   */
+  class dbr_fetcher : public cr_fetcher
+  {
+    public:
+      dbr_fetcher(const std::string &host, const int &port,
+                  const std::string &path, const std::string &rsc,
+                  const std::string &key, const std::string &plugin_name)
+        :_host(host),_port(port),_path(path),_rsc(rsc),_key(key),_plugin_name(plugin_name)
+      {};
+
+      virtual ~dbr_fetcher() {};
+
+      virtual db_record* fetch() throw (sp_exception);
+
+      std::string _host;
+      int _port;
+      std::string _path;
+      std::string _rsc;
+      std::string _key;
+      std::string _plugin_name;
+  };
 
-  struct perso_thread_arg
+  /**
+   * \brief fetches the batch of query records of a remote node, for refreshing the store.
+   */
+  class bqc_fetcher : public cr_fetcher
   {
-    perso_thread_arg()
-      :_snippets(NULL),_related_queries(NULL),_qc(NULL),_estimator(NULL),_pe(NULL),_radius(0)
-    {};
-
-    ~perso_thread_arg()
-    {}
-
-    std::string _query;
-    std::string _lang;
-    std::vector<search_snippet*> *_snippets;
-    std::multimap<double,std::string,std::less<double> > *_related_queries;
-    query_context *_qc;
-    rank_estimator *_estimator;
-    peer *_pe;
-    int _radius;
-    bool _wait; // whether threads should wait for external data sources.
-    sp_err _err; // error code.
+    public:
+      bqc_fetcher(const std::string &host, const int &port,
+                  const std::string &path, const std::string &query,
+                  const int &radius)
+        :_host(host),_port(port),_path(path),_query(query),_radius(radius)
+      {};
+
+      virtual ~bqc_fetcher() {};
+
+      virtual db_record* fetch() throw (sp_exception);
+
+      std::string _host;
+      int _port;
+      std::string _path;
+      std::string _query;
+      int _radius;
   };
 
   class rank_estimator
@@ -64,20 +89,17 @@ namespace seeks_plugins
 
       virtual ~rank_estimator() {};
 
+      /**
+       * \brief personalizes results with the local user db, and with the
+       *        remote peers that answer before the personalization deadline.
+       *        Remote peers are queried in the background while the local
+       *        data is used.
+       */
       void peers_personalize(query_context *qc,
                              const bool &wait_external_sources,
                              const std::string &peers,
                              const int &radius);
 
-      void threaded_personalize(std::vector<perso_thread_arg*> &perso_args,
-                                std::vector<pthread_t> &perso_threads,
-                                peer *pe = NULL,
-                                query_context *qc = NULL,
-                                const bool &wait_external_sources=true,
-                                const int &radius=-1);
-
-      static void personalize_cb(perso_thread_arg *args);
-
       virtual void personalize(const std::string &query,
                                const std::string &lang,
                                const int &radius,
@@ -87,6 +109,21 @@ namespace seeks_plugins
                                query_context *qc = NULL,
                                const bool &wait_external_sources=true) throw (sp_exception) {};
 
+      /**
+       * \brief personalizes results with query data already fetched from pe.
+       *        Query data is destroyed and removed from qdata and inv_qdata.
+       */
+      virtual void personalize(const std::string &query,
+                               const std::string &lang,
+                               const int &radius,
+                               std::vector<search_snippet*> &snippets,
+                               std::multimap<double,std::string,std::less<double> > &related_queries,
+                               peer *pe,
+                               query_context *qc,
+                               const bool &wait_external_sources,
+                               hash_map<const char*,query_data*,hash<const char*>,eqstr> &qdata,
+                               hash_map<const char*,std::vector<query_data*>,hash<const char*>,eqstr> &inv_qdata) throw (sp_exception) {};
+
       virtual void estimate_ranks(const std::string &query,
                                   const std::string &lang,
                                   const int &radius,
@@ -114,6 +151,12 @@ namespace seeks_plugins
                             hash_map<const char*,std::vector<query_data*>,hash<const char*>,eqstr> &inv_qdata,
                             peer *pe) throw (sp_exception);
 
+      /**
+       * \brief keys of the query-capture records that hold data on query.
+       */
+      static void query_hashes(const std::string &query,
+                               std::vector<std::string> &qhashes);
+
       void fetch_user_db_record(const std::string &query,
                                 user_db *udb,
                                 hash_map<const DHTKey*,db_record*,hash<const DHTKey*>,eqdhtkey> &records);
@@ -122,6 +165,11 @@ namespace seeks_plugins
                                        user_db *udb,
                                        hash_map<const DHTKey*,db_record*,hash<const DHTKey*>,eqdhtkey> &records);
 
+      /**
+       * \brief gathers the data of the queries related to query from the records.
+       *        Query data are moved out of the records instead of being copied,
+       *        so the records are only good for destruction afterwards.
+       */
       void extract_queries(const std::string &query,
                            const std::string &lang,
                            const int &radius,
@@ -141,6 +189,11 @@ namespace seeks_plugins
 
       static void destroy_query_data(hash_map<const char*,query_data*,hash<const char*>,eqstr> &qdata);
 
+      /**
+       * \brief fetches a record from a user db, through the store for remote dbs.
+       * @param in_store set when the record comes from the store.
+       * @return the record, that belongs to the caller, NULL if there is none.
+       */
       static db_record* find_dbr(user_db *udb, const std::string &key,
                                  const std::string &plugin_name,
                                  bool &in_store, const bool &use_store=true);
@@ -181,6 +234,17 @@ namespace seeks_plugins
                                query_context *qc = NULL,
                                const bool &wait_external_sources=true) throw (sp_exception);
 
+      virtual void personalize(const std::string &query,
+                               const std::string &lang,
+                               const int &radius,
+                               std::vector<search_snippet*> &snippets,
+                               std::multimap<double,std::string,std::less<double> > &related_queries,
+                               peer *pe,
+                               query_context *qc,
+                               const bool &wait_external_sources,
+                               hash_map<const char*,query_data*,hash<const char*>,eqstr> &qdata,
+                               hash_map<const char*,std::vector<query_data*>,hash<const char*>,eqstr> &inv_qdata) throw (sp_exception);
+
       virtual void estimate_ranks(const std::string &query,
                                   const std::string &lang,
                                   const int &radius,
@@ -242,6 +306,9 @@ namespace seeks_plugins
                            const std::string &host,
                            const uint64_t &nuri);
 
+      /**
+       * \brief see query_halo::damerau_levenshtein_distance, c is unused.
+       */
       static uint32_t damerau_levenshtein_distance(const std::string &s1, const std::string &s2,
           const uint32_t &c=256);
 
@@ -0,0 +1,134 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Memory allocations and time to fetch the query data for personalizing
+ * the results to a query, from the local user db.
+ */
+
+#include "rank_estimators.h"
+#include "seeks_proxy.h"
+#include "plugin_manager.h"
+#include "proxy_configuration.h"
+#include "errlog.h"
+
+#include <iostream>
+#include <new>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace seeks_plugins;
+using namespace sp;
+
+static uint64_t nallocs = 0;
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+  nallocs++;
+  void *p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) throw()
+{
+  free(p);
+}
+
+void* operator new[](size_t size) throw(std::bad_alloc)
+{
+  return operator new(size);
+}
+
+void operator delete[](void *p) throw()
+{
+  operator delete(p);
+}
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 5)
+    {
+      std::cout << "Usage: <query> <db_file> <seeks base dir> <iterations>\n";
+      exit(0);
+    }
+
+  std::string query = argv[1];
+  std::string dbfile = argv[2];
+  std::string basedir = argv[3];
+  int iterations = atoi(argv[4]);
+
+  seeks_proxy::_configfile = basedir + "/config";
+  seeks_proxy::_lshconfigfile = basedir + "/lsh/lsh-config";
+
+  seeks_proxy::initialize_mutexes();
+  errlog::init_log_module();
+  errlog::set_debug_level(LOG_LEVEL_FATAL | LOG_LEVEL_ERROR | LOG_LEVEL_INFO);
+
+  seeks_proxy::_basedir = basedir.c_str();
+  plugin_manager::_plugin_repository = basedir + "/plugins/";
+  seeks_proxy::_config = new proxy_configuration(seeks_proxy::_configfile);
+  seeks_proxy::_config->_user_db_startup_check = false;
+  seeks_proxy::_config->_user_db_optimize = false;
+  seeks_proxy::_lsh_config = new lsh_configuration(seeks_proxy::_lshconfigfile);
+
+  seeks_proxy::_user_db = new user_db(dbfile);
+  seeks_proxy::_user_db->open_db_readonly();
+
+  plugin_manager::load_all_plugins();
+  plugin_manager::start_plugins();
+
+  peer pe; // local user db.
+  rank_estimator re;
+  size_t nqueries = 0;
+  uint64_t allocs = nallocs;
+  struct timeval tv_start;
+  gettimeofday(&tv_start,NULL);
+  for (int i=0; i<iterations; i++)
+    {
+      hash_map<const char*,query_data*,hash<const char*>,eqstr> qdata;
+      hash_map<const char*,std::vector<query_data*>,hash<const char*>,eqstr> inv_qdata;
+      try
+        {
+          re.fetch_query_data(query,"",5,qdata,inv_qdata,&pe);
+        }
+      catch (sp_exception &e)
+        {
+          std::cout << e.what() << std::endl;
+        }
+      nqueries = qdata.size();
+      rank_estimator::destroy_query_data(qdata);
+      rank_estimator::destroy_inv_qdata_key(inv_qdata);
+    }
+  double ms = elapsed_ms(tv_start);
+  allocs = nallocs - allocs;
+
+  std::cout << "related queries: " << nqueries << std::endl;
+  std::cout << "allocations per fetch: " << allocs / std::max(iterations,1) << std::endl;
+  std::cout << "time per fetch: " << ms / std::max(iterations,1) << " ms" << std::endl;
+
+  seeks_proxy::_user_db->close_db();
+}
@@ -0,0 +1,171 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Time to weight a query against its related queries, as in
+ * personalization and query suggestion: with the former full matrix
+ * Damerau-Levenshtein distance over str_chain ranked queries, pair by
+ * pair with query_halo, in batch with one query_halo, and bounded.
+ */
+
+#include "query_halo.h"
+#include "mrf.h"
+
+#include <iostream>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace seeks_plugins;
+using lsh::str_chain;
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+static uint32_t full_matrix_distance(const std::string &s1, const std::string &s2,
+                                     const uint32_t &c=256)
+{
+  const uint32_t len1 = s1.size(), len2 = s2.size();
+  uint32_t inf = len1 + len2;
+  std::vector<std::vector<uint32_t> > He(len1+2,std::vector<uint32_t>(len2+2));
+  He[0][0] = inf;
+  for (uint32_t i=0; i<=len1; ++i)
+    {
+      He[i+1][1] = i;
+      He[i+1][0] = inf;
+    }
+  for (uint32_t j=0; j<=len2; ++j)
+    {
+      He[1][j+1] = j;
+      He[0][j+1] = inf;
+    }
+  uint32_t DA[c];
+  for (uint32_t d=0; d<c; ++d) DA[d]=0;
+  for (uint32_t i=1; i<=len1; ++i)
+    {
+      uint32_t DB = 0;
+      for (uint32_t j=1; j<=len2; ++j)
+        {
+          uint32_t i1 = DA[(unsigned char)s2[j-1]];
+          uint32_t j1 = DB;
+          uint32_t d = ((s1[i-1]==s2[j-1])?0:1);
+          if (d==0) DB = j;
+          He[i+1][j+1] = std::min(std::min(He[i][j]+d, He[i+1][j] + 1),
+                                  std::min(He[i][j+1]+1,
+                                           He[i1][j1] + (i-i1-1) + 1 + (j-j1-1)));
+        }
+      DA[(unsigned char)s1[i-1]] = i;
+    }
+  return He[len1+1][len2+1];
+}
+
+// the former halo weight.
+static float str_chain_weight(const std::string &q1, const std::string &q2)
+{
+  str_chain sc1(q1,0,true);
+  str_chain sc2(q2,0,true);
+  sc1 = sc1.rank_alpha();
+  sc2 = sc2.rank_alpha();
+  std::string rs1 = sc1.print_str();
+  std::string rs2 = sc2.print_str();
+  return 1.0 / (log(full_matrix_distance(rs1,rs2)+1.0)+1.0);
+}
+
+// related queries share words with the query, from a skewed vocabulary.
+static void generate(const int &n, std::vector<std::string> &queries)
+{
+  for (int q=0; q<n; q++)
+    {
+      std::string query;
+      int nwords = 1 + random() % 5;
+      for (int i=0; i<nwords; i++)
+        {
+          char w[16];
+          long r = random() % 300;
+          snprintf(w,sizeof(w),"%sw%ld",i > 0 ? " " : "",r * r / 300);
+          query += w;
+        }
+      queries.push_back(query);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+    {
+      std::cout << "Usage: <related queries>\n";
+      exit(0);
+    }
+
+  int n = atoi(argv[1]);
+  srandom(1);
+  std::vector<std::string> rqueries;
+  generate(n,rqueries);
+  std::string query = "w12 w108 w3";
+
+  struct timeval tv_start;
+  gettimeofday(&tv_start,NULL);
+  std::vector<float> ref(n);
+  for (int i=0; i<n; i++)
+    ref[i] = str_chain_weight(query,rqueries[i]);
+  double ref_ms = elapsed_ms(tv_start);
+
+  gettimeofday(&tv_start,NULL);
+  std::vector<float> pairs(n);
+  for (int i=0; i<n; i++)
+    {
+      query_halo qh(query);
+      pairs[i] = qh.weight(rqueries[i]);
+    }
+  double pairs_ms = elapsed_ms(tv_start);
+
+  gettimeofday(&tv_start,NULL);
+  std::vector<float> batch(n);
+  query_halo qh(query);
+  for (int i=0; i<n; i++)
+    batch[i] = qh.weight(rqueries[i]);
+  double batch_ms = elapsed_ms(tv_start);
+
+  uint32_t radius = 3;
+  gettimeofday(&tv_start,NULL);
+  std::vector<uint32_t> dists;
+  qh.distances(rqueries,dists,radius);
+  double bounded_ms = elapsed_ms(tv_start);
+
+  int same = 0, within = 0;
+  for (int i=0; i<n; i++)
+    {
+      if (ref[i] == pairs[i] && ref[i] == batch[i])
+        ++same;
+      if (dists[i] <= radius)
+        ++within;
+    }
+
+  std::cout << "related queries: " << n << std::endl;
+  std::cout << "full matrix (ms): " << ref_ms << std::endl;
+  std::cout << "pair by pair (ms): " << pairs_ms << " (" << ref_ms / pairs_ms << "x)" << std::endl;
+  std::cout << "batch (ms): " << batch_ms << " (" << ref_ms / batch_ms << "x)" << std::endl;
+  std::cout << "bounded at " << radius << " (ms): " << bounded_ms << " (" << ref_ms / bounded_ms
+            << "x), " << within << " within" << std::endl;
+  std::cout << "identical weights: " << same << " / " << n << std::endl;
+}
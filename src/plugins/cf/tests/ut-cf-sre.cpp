@@ -201,6 +201,53 @@ TEST_F(SRETest,extract_queries)
   rank_estimator::destroy_inv_qdata_key(inv_qdata);
 }
 
+TEST_F(SRETest,url_tables)
+{
+  hash_map<const DHTKey*,db_record*,hash<const DHTKey*>,eqdhtkey> records;
+  simple_re sre(false);
+  sre.fetch_user_db_record(queries[2],seeks_proxy::_user_db,records);
+  hash_map<const char*,query_data*,hash<const char*>,eqstr> qdata;
+  hash_map<const char*,std::vector<query_data*>,hash<const char*>,eqstr> inv_qdata;
+  sre.extract_queries(queries[2],"en",1,seeks_proxy::_user_db,records,qdata,inv_qdata);
+  ASSERT_FALSE(qdata.empty());
+
+  // table lookups give the same ranks as lookups in the visited URLs.
+  hash_map<uint32_t,bool,id_hash_uint> filter;
+  hash_map<const char*,query_data*,hash<const char*>,eqstr>::const_iterator hit
+  = qdata.begin();
+  while (hit!=qdata.end())
+    {
+      query_data *qd = (*hit).second;
+      ASSERT_EQ(qd->_visited_urls->size(),qd->_vurl_table.size());
+      ASSERT_EQ(qd->vurls_total_hits(),qd->_vurls_total_hits);
+      for (int i=0; i<3; i++)
+        {
+          search_snippet s;
+          s.set_url(uris[i]);
+          std::string url = uris[i];
+          std::string host,path;
+          query_capture::process_url(url,host,path);
+          bool pers = false, tpers = false;
+          float post = sre.estimate_rank(&s,&filter,3,qd,qd->vurls_total_hits(),url,host,pers);
+          search_snippet ts;
+          ts.set_url(uris[i]);
+          float tpost = sre.estimate_rank(&ts,&filter,3,
+                                          qd->find_vurl(query_data::hash_vurl(url),url),
+                                          qd->find_vurl(query_data::hash_vurl(host),host),
+                                          qd->_vurls_total_hits,
+                                          cf_configuration::_config->_domain_name_weight,tpers);
+          ASSERT_EQ(post,tpost);
+          ASSERT_EQ(pers,tpers);
+          ASSERT_EQ(s._hits,ts._hits);
+        }
+      ++hit;
+    }
+
+  rank_estimator::destroy_records(records);
+  rank_estimator::destroy_query_data(qdata);
+  rank_estimator::destroy_inv_qdata_key(inv_qdata);
+}
+
 TEST(SREAPITest,damerau_levenshtein_distance)
 {
   std::string s1 = "ca";
@@ -19,6 +19,8 @@
 #define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
 #include <gtest/gtest.h>
 
+#include <unistd.h>
+
 #include "cr_store.h"
 #include "seeks_proxy.h"
 #include "rank_estimators.h"
@@ -43,39 +45,183 @@ int ports[2] =
   8251
 };
 
-TEST(CRTest,cr_cache)
+class test_fetcher : public cr_fetcher
+{
+  public:
+    test_fetcher(const bool &fail, const size_t &size=0)
+      :_fail(fail),_size(size)
+    {};
+
+    virtual ~test_fetcher() {};
+
+    virtual db_record* fetch() throw (sp_exception)
+    {
+      if (_fail)
+        throw sp_exception(SP_ERR_NOT_FOUND,"test fetch failure");
+      if (_size > 0)
+        return new db_record(std::string(_size,'r')); // plugin name sets the size.
+      return new db_record("refreshed");
+    };
+
+    bool _fail;
+    size_t _size;
+};
+
+TEST(CRTest,cr_record)
 {
   cr_store crs;
-  cr_cache *crc = new cr_cache(cr_store::generate_peer(hosts[0],ports[0]),&crs);
+  std::string peer = cr_store::generate_peer(hosts[0],ports[0]);
   std::string key = "1645a6897e62417931f26bcbdf4687c9c026b626";
-  db_record *rec = new db_record();
-  crc->add(key,rec);
-  ASSERT_EQ(1,crc->_records.size());
-  ASSERT_EQ(1,seeks_proxy::_memory_dust.size()); // automatically registered through sweeper.
-  time_t lu = (*crc->_records.begin()).second->_last_use;
-  cached_record *cr = crc->find(key);
-  ASSERT_TRUE(NULL != cr);
-  ASSERT_EQ(rec,cr->_rec);
-  ASSERT_TRUE(cr->_last_use >= lu);
-  sweeper::sweep_all(); // delete cr and unregister from dust.
-  ASSERT_TRUE(seeks_proxy::_memory_dust.empty());
-  ASSERT_TRUE(crc->_records.empty());
+  db_record rec("cf");
+  crs.add(peer,key,&rec,"");
+  bool has_key = false;
+  db_record *rec_f = crs.find(peer,key,has_key);
+  ASSERT_TRUE(has_key);
+  ASSERT_TRUE(NULL != rec_f);
+  ASSERT_TRUE(&rec != rec_f); // a copy that belongs to the caller.
+  ASSERT_EQ("cf",rec_f->_plugin_name);
+  delete rec_f;
+  rec_f = crs.find(cr_store::generate_peer(hosts[1],ports[1]),key,has_key);
+  ASSERT_FALSE(has_key);
+  ASSERT_TRUE(NULL == rec_f);
+  cr_store_stats stats;
+  crs.get_stats(stats);
+  ASSERT_EQ(1,stats._hits);
+  ASSERT_EQ(1,stats._misses);
+  ASSERT_EQ(1,stats._entries);
+  ASSERT_TRUE(stats._bytes > 0);
+  crs.remove(peer,key);
+  crs.get_stats(stats);
+  ASSERT_EQ(0,stats._entries);
+  ASSERT_EQ(0,stats._bytes);
 }
 
-TEST(CRTest,cr_record)
+TEST(CRTest,cr_negative)
 {
   cr_store crs;
+  std::string peer = cr_store::generate_peer(hosts[0],ports[0]);
   std::string key = "1645a6897e62417931f26bcbdf4687c9c026b626";
-  db_record *rec = new db_record();
-  crs.add(cr_store::generate_peer(hosts[0],ports[0]),key,rec);
-  ASSERT_EQ(1,crs._store.size());
-  ASSERT_EQ(1,seeks_proxy::_memory_dust.size());
+  crs.add(peer,key,NULL,"");
+  bool has_key = false;
+  db_record *rec_f = crs.find(peer,key,has_key);
+  ASSERT_TRUE(has_key);
+  ASSERT_TRUE(NULL == rec_f);
+  crs._negative_timeout = 0; // expired.
+  rec_f = crs.find(peer,key,has_key);
+  ASSERT_FALSE(has_key);
+  ASSERT_TRUE(NULL == rec_f);
+  cr_store_stats stats;
+  crs.get_stats(stats);
+  ASSERT_EQ(1,stats._negative_hits);
+  ASSERT_EQ(1,stats._misses);
+  ASSERT_EQ(0,stats._entries);
+}
+
+TEST(CRTest,cr_eviction)
+{
+  cr_store crs(1);
+  std::string peer = cr_store::generate_peer(hosts[0],ports[0]);
+  db_record rec("cf");
+  crs.add(peer,"key0",&rec,"");
+  cr_store_stats stats;
+  crs.get_stats(stats);
+  size_t rsize = stats._bytes;
+  crs.set_limits(3*rsize,600,60,300);
+  crs.add(peer,"key1",&rec,"");
+  crs.add(peer,"key2",&rec,"");
   bool has_key = false;
-  db_record *rec_f = crs.find(cr_store::generate_peer(hosts[0],ports[0]),key,has_key);
+  db_record *rec_f = crs.find(peer,"key0",has_key); // key1 is now the least recently used.
+  ASSERT_TRUE(NULL != rec_f);
+  delete rec_f;
+  crs.add(peer,"key3",&rec,"");
+  crs.get_stats(stats);
+  ASSERT_EQ(1,stats._evictions);
+  ASSERT_EQ(3,stats._entries);
+  ASSERT_TRUE(stats._bytes <= 3*rsize);
+  rec_f = crs.find(peer,"key1",has_key);
+  ASSERT_FALSE(has_key);
+  rec_f = crs.find(peer,"key0",has_key);
   ASSERT_TRUE(has_key);
-  ASSERT_TRUE(rec == rec_f);
-  sweeper::sweep_all(); // delete cr and unregister from dust.
-  ASSERT_TRUE(crs._store.empty());
+  delete rec_f;
+}
+
+TEST(CRTest,cr_stale)
+{
+  cr_store crs;
+  std::string peer = cr_store::generate_peer(hosts[0],ports[0]);
+  std::string key = "1645a6897e62417931f26bcbdf4687c9c026b626";
+  db_record rec("cf");
+  crs.add(peer,key,&rec,"");
+  crs.set_limits(1024*1024,0,60,300); // timed out, but within the stale window.
+
+  // failed refresh, the stale record is kept.
+  bool has_key = false;
+  db_record *rec_f = crs.find(peer,key,has_key,new test_fetcher(true));
+  ASSERT_TRUE(has_key);
+  ASSERT_TRUE(NULL != rec_f);
+  ASSERT_EQ("cf",rec_f->_plugin_name);
+  delete rec_f;
+  cr_store_stats stats;
+  for (int i=0; i<100 && stats._refresh_errors == 0; i++)
+    {
+      usleep(10000);
+      crs.get_stats(stats);
+    }
+  ASSERT_EQ(1,stats._refresh_errors);
+
+  // successful refresh.
+  rec_f = crs.find(peer,key,has_key,new test_fetcher(false));
+  ASSERT_TRUE(NULL != rec_f);
+  ASSERT_EQ("cf",rec_f->_plugin_name);
+  delete rec_f;
+  for (int i=0; i<100 && stats._refreshes == 0; i++)
+    {
+      usleep(10000);
+      crs.get_stats(stats);
+    }
+  ASSERT_EQ(1,stats._refreshes);
+  ASSERT_EQ(2,stats._stale_hits);
+  crs.set_limits(1024*1024,600,60,300);
+  rec_f = crs.find(peer,key,has_key,new test_fetcher(false));
+  ASSERT_TRUE(NULL != rec_f);
+  ASSERT_EQ("refreshed",rec_f->_plugin_name);
+  delete rec_f;
+
+  // past the stale window.
+  crs.set_limits(1024*1024,0,60,0);
+  rec_f = crs.find(peer,key,has_key,new test_fetcher(false));
+  ASSERT_FALSE(has_key);
+  ASSERT_TRUE(NULL == rec_f);
+}
+
+TEST(CRTest,cr_stale_oversized)
+{
+  cr_store crs(1);
+  std::string peer = cr_store::generate_peer(hosts[0],ports[0]);
+  std::string key = "1645a6897e62417931f26bcbdf4687c9c026b626";
+  db_record rec("cf");
+  crs.add(peer,key,&rec,"");
+  cr_store_stats stats;
+  crs.get_stats(stats);
+  crs.set_limits(2*stats._bytes,0,60,300);
+
+  // the refreshed record is too large to be stored, the stale one is kept
+  // and may be refreshed again.
+  bool has_key = false;
+  for (int r=1; r<=2; r++)
+    {
+      db_record *rec_f = crs.find(peer,key,has_key,new test_fetcher(false,4096));
+      ASSERT_TRUE(NULL != rec_f);
+      ASSERT_EQ("cf",rec_f->_plugin_name);
+      delete rec_f;
+      for (int i=0; i<100 && (int)stats._refreshes < r; i++)
+        {
+          usleep(10000);
+          crs.get_stats(stats);
+        }
+      ASSERT_EQ(r,stats._refreshes);
+    }
+  ASSERT_EQ(1,stats._entries);
 }
 
 TEST(CRTest,find_dbr)
@@ -138,11 +284,18 @@ TEST(CRTest,find_dbr)
   rank_estimator::_store.add(host,-1,"",rkey,dbr);
   user_db udbr(false,"",host,-1,"","sn");
   db_record *dbr2 = rank_estimator::find_dbr(&udbr,key,"query-capture",in_store);
-  ASSERT_EQ(dbr,dbr2);
-  ASSERT_EQ(1,rank_estimator::_store._store.size());
+  ASSERT_TRUE(in_store);
+  ASSERT_TRUE(NULL!=dbr2);
+  ASSERT_TRUE(dbr!=dbr2);
+  db_query_record *dqr2 = dynamic_cast<db_query_record*>(dbr2);
+  ASSERT_TRUE(NULL!=dqr2);
+  ASSERT_EQ(1,dqr2->_related_queries.size());
+  ASSERT_EQ("seeks",(*dqr2->_related_queries.begin()).second->_query);
+  delete dbr;
+  delete dbr2;
 
   // clear all.
-  sweeper::sweep_all();
+  rank_estimator::_store.clear();
 
   udb.close_db();
   plugin_manager::close_all_plugins();
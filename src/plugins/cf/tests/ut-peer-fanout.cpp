@@ -0,0 +1,217 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "peer_fanout.h"
+#include "cf_configuration.h"
+#include "db_err.h"
+#include "errlog.h"
+
+#include <unistd.h>
+
+using namespace seeks_plugins;
+using sp::errlog;
+
+/*
+ * stub peers: the fetch waits for the latency injected for the peer's port,
+ * and returns the injected error code.
+ */
+static int latencies[8];
+static sp_err errors[8];
+static sp_mutex_t running_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void stub_fetch(peer_fetch *pf)
+{
+  mutex_lock(&running_mutex);
+  int latency = latencies[pf->_target._port];
+  sp_err err = errors[pf->_target._port];
+  mutex_unlock(&running_mutex);
+  usleep(latency * 1000);
+  pf->_err = err;
+}
+
+class PFTest : public testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+      errlog::init_log_module();
+      errlog::set_debug_level(LOG_LEVEL_FATAL);
+      if (!cf_configuration::_config)
+        cf_configuration::_config = new cf_configuration("");
+      mutex_lock(&running_mutex);
+      for (int i=0; i<8; i++)
+        {
+          latencies[i] = 0;
+          errors[i] = SP_ERR_OK;
+          _peers[i] = new peer("stub",i,"","sn");
+        }
+      mutex_unlock(&running_mutex);
+      gettimeofday(&_start,NULL);
+    }
+
+    virtual void TearDown()
+    {
+      // the fetches that were abandoned end before their peers are deleted.
+      peer_fanout::wait_fetches();
+      for (int i=0; i<8; i++)
+        delete _peers[i];
+    }
+
+    double elapsed()
+    {
+      struct timeval now;
+      gettimeofday(&now,NULL);
+      return peer_fanout::elapsed(_start,now);
+    }
+
+    peer *_peers[8];
+    struct timeval _start;
+};
+
+TEST_F(PFTest,all_peers)
+{
+  latencies[0] = 30;
+  latencies[1] = 10;
+  latencies[2] = 20;
+  peer_fanout *pfo = new peer_fanout("seeks","en",0,false,0,&stub_fetch);
+  for (int i=0; i<3; i++)
+    pfo->add(_peers[i]);
+  ASSERT_EQ(3,pfo->size());
+
+  // answers come in order of latency.
+  int expected[3] = { 1, 2, 0 };
+  peer_fetch *pf = NULL;
+  for (int i=0; i<3; i++)
+    {
+      pf = pfo->next(NULL);
+      ASSERT_TRUE(NULL!=pf);
+      EXPECT_EQ(expected[i],pf->_target._port);
+      EXPECT_FALSE(pf->_hedge);
+      EXPECT_GE(pf->_latency,latencies[expected[i]]);
+    }
+  EXPECT_TRUE(NULL==pfo->next(NULL));
+  pfo->release();
+  EXPECT_LT(elapsed(),200.0);
+  EXPECT_EQ(PEER_OK,_peers[0]->get_status());
+  EXPECT_GE(_peers[0]->get_latency(),30.0);
+}
+
+TEST_F(PFTest,deadline)
+{
+  latencies[0] = 10;
+  latencies[1] = 20;
+  latencies[2] = 300;
+  peer_fanout *pfo = new peer_fanout("seeks","en",0,false,0,&stub_fetch);
+  for (int i=0; i<3; i++)
+    pfo->add(_peers[i]);
+  struct timeval deadline = _start;
+  peer_fanout::add_time(deadline,100);
+  int n = 0;
+  while (pfo->next(&deadline))
+    n++;
+  EXPECT_EQ(2,n);
+  double t = elapsed();
+  EXPECT_GE(t,100.0);
+  EXPECT_LT(t,250.0);
+
+  // the late fetch ends in the background and updates the peer latency.
+  pfo->release();
+  EXPECT_LT(_peers[2]->get_latency(),0.0);
+  peer_fanout::wait_fetches();
+  EXPECT_GE(_peers[2]->get_latency(),300.0);
+}
+
+TEST_F(PFTest,hedge_late_peer)
+{
+  latencies[0] = 400;
+  latencies[1] = 10;
+  _peers[0]->_replica = _peers[1];
+  peer_fanout *pfo = new peer_fanout("seeks","en",0,false,50,&stub_fetch);
+  pfo->add(_peers[0]);
+  peer_fetch *pf = pfo->next(NULL);
+  ASSERT_TRUE(NULL!=pf);
+  EXPECT_TRUE(pf->_hedge);
+  EXPECT_EQ(1,pf->_target._port);
+  double t = elapsed();
+  EXPECT_GE(t,60.0);
+  EXPECT_LT(t,200.0);
+
+  // only one answer per peer.
+  EXPECT_TRUE(NULL==pfo->next(NULL));
+  EXPECT_LT(elapsed(),200.0);
+  pfo->release();
+  _peers[0]->_replica = NULL;
+}
+
+TEST_F(PFTest,hedge_failing_peer)
+{
+  latencies[0] = 10;
+  errors[0] = SP_ERR_NOT_FOUND;
+  latencies[1] = 10;
+  _peers[0]->_replica = _peers[1];
+  peer_fanout *pfo = new peer_fanout("seeks","en",0,false,0,&stub_fetch);
+  pfo->add(_peers[0]);
+  peer_fetch *pf = pfo->next(NULL);
+  ASSERT_TRUE(NULL!=pf);
+  EXPECT_TRUE(pf->_hedge);
+  EXPECT_EQ(SP_ERR_OK,pf->_err);
+  EXPECT_TRUE(NULL==pfo->next(NULL));
+  pfo->release();
+  _peers[0]->_replica = NULL;
+  EXPECT_EQ(1,_peers[0]->_retries);
+}
+
+TEST_F(PFTest,no_answer)
+{
+  errors[0] = DB_ERR_NO_REC;
+  errors[1] = SP_ERR_NOT_FOUND;
+  _peers[0]->_replica = _peers[2];
+  peer_fanout *pfo = new peer_fanout("seeks","en",0,false,0,&stub_fetch);
+  pfo->add(_peers[0]);
+  pfo->add(_peers[1]);
+  EXPECT_TRUE(NULL==pfo->next(NULL));
+  pfo->release();
+  _peers[0]->_replica = NULL;
+  EXPECT_EQ(0,_peers[0]->_retries); // no record is not a failure.
+  EXPECT_EQ(1,_peers[1]->_retries);
+}
+
+TEST_F(PFTest,slow_peer)
+{
+  EXPECT_FALSE(_peers[0]->is_slow(100.0,300));
+  _peers[0]->update_latency(1000.0);
+  EXPECT_DOUBLE_EQ(1000.0,_peers[0]->get_latency());
+  _peers[0]->update_latency(0.0);
+  EXPECT_DOUBLE_EQ(700.0,_peers[0]->get_latency());
+  EXPECT_FALSE(_peers[0]->is_slow(0.0,300)); // no deadline.
+  EXPECT_FALSE(_peers[0]->is_slow(800.0,300));
+
+  // slow peers are probed once per interval.
+  EXPECT_FALSE(_peers[0]->is_slow(100.0,300));
+  EXPECT_TRUE(_peers[0]->is_slow(100.0,300));
+  EXPECT_FALSE(_peers[0]->is_slow(100.0,0));
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,193 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "peer_list.h"
+#include "rank_estimators.h"
+#include "udb_summary.h"
+#include "udbs_err.h"
+#include "db_query_record.h"
+#include "user_db.h"
+#include "miscutil.h"
+#include "errlog.h"
+
+#include <unistd.h>
+
+using namespace seeks_plugins;
+using namespace sp;
+
+static std::string dbfiles[2] =
+{
+  "seeks_test_a.db",
+  "seeks_test_b.db"
+};
+
+static std::string queries[2] =
+{
+  "seeks project",
+  "private search engine"
+};
+
+/**
+ * Two nodes, each with the records of one query, whose summaries are
+ * exchanged as they would be through the udb service.
+ */
+class PeerSummaryTest : public testing::Test
+{
+  protected:
+    PeerSummaryTest()
+    {
+    }
+
+    virtual ~PeerSummaryTest()
+    {
+    }
+
+    virtual void SetUp()
+    {
+      errlog::init_log_module();
+      errlog::set_debug_level(LOG_LEVEL_FATAL | LOG_LEVEL_ERROR);
+      for (int i=0; i<2; i++)
+        {
+          unlink(dbfiles[i].c_str());
+          _udb[i] = new user_db(dbfiles[i]);
+          ASSERT_EQ(SP_ERR_OK,_udb[i]->open_db());
+          std::vector<std::string> qhashes;
+          rank_estimator::query_hashes(queries[i],qhashes);
+          for (size_t j=0; j<qhashes.size(); j++)
+            {
+              db_query_record dbqr("query-capture",queries[i],0);
+              ASSERT_EQ(SP_ERR_OK,_udb[i]->add_dbr(qhashes.at(j),dbqr));
+            }
+
+          // summaries go over the wire.
+          udb_summary *us = udb_summary::build(_udb[i],"query-capture",0.01);
+          ASSERT_TRUE(NULL!=us);
+          ASSERT_EQ(qhashes.size(),us->_nkeys);
+          std::string msg;
+          us->serialize(msg);
+          delete us;
+          us = new udb_summary();
+          us->deserialize(msg);
+          _pe[i] = new peer("localhost",8250+i,"/node","sn");
+          _pe[i]->set_summary(us);
+        }
+    }
+
+    virtual void TearDown()
+    {
+      for (int i=0; i<2; i++)
+        {
+          delete _pe[i];
+          _udb[i]->close_db();
+          delete _udb[i];
+          unlink(dbfiles[i].c_str());
+        }
+    }
+
+    user_db *_udb[2];
+    peer *_pe[2];
+};
+
+TEST_F(PeerSummaryTest, skip_peers_with_no_data)
+{
+  for (int i=0; i<2; i++)
+    {
+      std::vector<std::string> qhashes;
+      rank_estimator::query_hashes(queries[i],qhashes);
+      ASSERT_TRUE(_pe[i]->may_have(qhashes,600));
+      ASSERT_FALSE(_pe[1-i]->may_have(qhashes,600));
+    }
+  ASSERT_EQ(1u,_pe[0]->_calls_avoided);
+  ASSERT_EQ(1u,_pe[1]->_calls_avoided);
+
+  // a query that shares a word with a node's query may have data there.
+  std::vector<std::string> qhashes;
+  rank_estimator::query_hashes("seeks",qhashes);
+  ASSERT_TRUE(_pe[0]->may_have(qhashes,600));
+  ASSERT_EQ(1u,_pe[0]->_calls_avoided);
+}
+
+TEST_F(PeerSummaryTest, stale_summary_is_not_used)
+{
+  std::vector<std::string> qhashes;
+  rank_estimator::query_hashes(queries[1],qhashes);
+  _pe[0]->_summary_date -= 1200;
+  ASSERT_FALSE(_pe[0]->has_fresh_summary(600));
+  ASSERT_TRUE(_pe[0]->may_have(qhashes,600));
+  ASSERT_EQ(0u,_pe[0]->_calls_avoided);
+}
+
+TEST_F(PeerSummaryTest, no_summary)
+{
+  std::vector<std::string> qhashes;
+  rank_estimator::query_hashes(queries[1],qhashes);
+  peer pe("localhost",8252,"/node","sn");
+  ASSERT_FALSE(pe.has_fresh_summary(600));
+  ASSERT_TRUE(pe.may_have(qhashes,600));
+}
+
+TEST(UdbSummaryTest, no_false_negative)
+{
+  udb_summary us(1000,0.01);
+  for (int i=0; i<1000; i++)
+    us.add("key" + miscutil::to_string(i));
+  ASSERT_EQ(1000u,us._nkeys);
+  for (int i=0; i<1000; i++)
+    ASSERT_TRUE(us.may_contain("key" + miscutil::to_string(i)));
+
+  // false positives stay around the rate the summary was sized for.
+  int fp = 0;
+  for (int i=1000; i<11000; i++)
+    if (us.may_contain("key" + miscutil::to_string(i)))
+      fp++;
+  ASSERT_GT(300,fp);
+}
+
+TEST(UdbSummaryTest, serialize)
+{
+  udb_summary us(10,0.01);
+  us.add("seeks");
+  std::string msg;
+  us.serialize(msg);
+  udb_summary us2;
+  us2.deserialize(msg);
+  ASSERT_EQ(us._nbits,us2._nbits);
+  ASSERT_EQ(us._nhashes,us2._nhashes);
+  ASSERT_EQ(1u,us2._nkeys);
+  ASSERT_TRUE(us2.may_contain("seeks"));
+
+  udb_summary us3;
+  try
+    {
+      us3.deserialize("garbage");
+      FAIL();
+    }
+  catch (sp_exception &e)
+    {
+      ASSERT_EQ(UDBS_ERR_DESERIALIZE,e.code());
+    }
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,129 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "query_halo.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+using namespace seeks_plugins;
+
+// full matrix computation.
+static uint32_t dl_distance(const std::string &s1, const std::string &s2)
+{
+  const uint32_t len1 = s1.size(), len2 = s2.size();
+  uint32_t inf = len1 + len2;
+  std::vector<std::vector<uint32_t> > He(len1+2,std::vector<uint32_t>(len2+2));
+  He[0][0] = inf;
+  for (uint32_t i=0; i<=len1; ++i)
+    {
+      He[i+1][1] = i;
+      He[i+1][0] = inf;
+    }
+  for (uint32_t j=0; j<=len2; ++j)
+    {
+      He[1][j+1] = j;
+      He[0][j+1] = inf;
+    }
+  uint32_t DA[256];
+  for (uint32_t d=0; d<256; ++d) DA[d]=0;
+  for (uint32_t i=1; i<=len1; ++i)
+    {
+      uint32_t DB = 0;
+      for (uint32_t j=1; j<=len2; ++j)
+        {
+          uint32_t i1 = DA[(unsigned char)s2[j-1]];
+          uint32_t j1 = DB;
+          uint32_t d = ((s1[i-1]==s2[j-1])?0:1);
+          if (d==0) DB = j;
+          He[i+1][j+1] = std::min(std::min(He[i][j]+d, He[i+1][j] + 1),
+                                  std::min(He[i][j+1]+1,
+                                           He[i1][j1] + (i-i1-1) + 1 + (j-j1-1)));
+        }
+      DA[(unsigned char)s1[i-1]] = i;
+    }
+  return He[len1+1][len2+1];
+}
+
+static std::string random_string(const int &max_len, const int &alphabet)
+{
+  std::string s;
+  int len = random() % (max_len + 1);
+  for (int i=0; i<len; i++)
+    s += (char)('a' + random() % alphabet);
+  return s;
+}
+
+TEST(QueryHaloTest, damerau_levenshtein_distance)
+{
+  EXPECT_EQ(0,query_halo::damerau_levenshtein_distance("",""));
+  EXPECT_EQ(5,query_halo::damerau_levenshtein_distance("seeks",""));
+  EXPECT_EQ(1,query_halo::damerau_levenshtein_distance("seeks","sekes"));
+  EXPECT_EQ(2,query_halo::damerau_levenshtein_distance("ca","abc")); // restricted distance is 3.
+  EXPECT_EQ(3,query_halo::damerau_levenshtein_distance("kitten","sitting"));
+
+  uint64_t peq[256];
+  query_halo::pattern_masks("ca",peq);
+  EXPECT_EQ(3,query_halo::osa_distance("ca",peq,"abc"));
+}
+
+TEST(QueryHaloTest, as_full_matrix)
+{
+  srandom(3);
+  for (int t=0; t<20000; t++)
+    {
+      int max_len = (t % 10 == 0) ? 90 : 12; // beyond a machine word, sometimes.
+      int alphabet = 2 + random() % 5;
+      std::string s1 = random_string(max_len,alphabet);
+      std::string s2 = random_string(max_len,alphabet);
+      uint32_t d = dl_distance(s1,s2);
+      ASSERT_EQ(d,query_halo::damerau_levenshtein_distance(s1,s2)) << s1 << " / " << s2;
+
+      uint32_t k = random() % 8;
+      ASSERT_EQ(d <= k ? d : k+1,query_halo::damerau_levenshtein_distance(s1,s2,k))
+          << s1 << " / " << s2 << " / " << k;
+    }
+}
+
+TEST(QueryHaloTest, halo)
+{
+  query_halo qh("seeks search engine");
+  EXPECT_EQ(0,qh.distance("search, engine seeks"));
+  EXPECT_EQ(1.0,qh.weight("engine seeks search"));
+  EXPECT_EQ(1,qh.distance("search engine seek"));
+  EXPECT_FLOAT_EQ(1.0 / (log(2.0)+1.0),qh.weight("search engine seek"));
+  EXPECT_EQ(4,qh.distance("seeks engine",3));
+
+  std::vector<std::string> rqueries;
+  rqueries.push_back("engine seeks search");
+  rqueries.push_back("seeks project");
+  std::vector<uint32_t> dists;
+  qh.distances(rqueries,dists);
+  ASSERT_EQ(2,dists.size());
+  EXPECT_EQ(0,dists[0]);
+  EXPECT_EQ(dl_distance("engine search seeks","project seeks"),dists[1]);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -48,6 +48,7 @@ namespace seeks_plugins
 
     std::vector<search_snippet*>::iterator it = snippets.begin();
     img_search_snippet *c_sp = NULL;
+    bool changed = false; // whether snippets were merged or added.
     while (it != snippets.end())
       {
         if ((*it)->_doc_type != seeks_img_doc_type::IMAGE)
@@ -59,6 +60,7 @@ namespace seeks_plugins
         img_search_snippet *sp = static_cast<img_search_snippet*>((*it));
         if (sp->_new)
           {
+            changed = true;
             if ((c_sp = static_cast<img_search_snippet*>(qc->get_cached_snippet(sp->_id)))!=NULL)
               {
                 // merge image snippets.
@@ -136,9 +138,9 @@ namespace seeks_plugins
         ++it;
       }
 
-    // sort by rank.
-    std::stable_sort(snippets.begin(),snippets.end(),
-                     img_search_snippet::max_seeks_rank);
+    // sort by rank, and drop the rendering views if the ranked snippets have changed.
+    if (snippet_index::sort(snippets,img_search_snippet::max_seeks_rank) || changed)
+      qc->_snippets_index.invalidate();
   }
 
 #ifdef FEATURE_OPENCV2
@@ -171,6 +173,7 @@ namespace seeks_plugins
 
     // sort snippets according to computed scores.
     std::stable_sort(sorted_snippets.begin(),sorted_snippets.end(),search_snippet::max_seeks_ir);
+    qc->_snippets_index.invalidate();
 
     //debug
     /* for (size_t i=0;i<sorted_snippets.size();i++)
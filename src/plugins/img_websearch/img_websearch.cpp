@@ -21,6 +21,7 @@
 #include "websearch.h" // websearch plugin.
 #include "sort_rank.h"
 #include "errlog.h"
+#include "thread_pool.h"
 #include "cgi.h"
 #include "cgisimple.h"
 #include "urlmatch.h"
@@ -482,7 +483,7 @@ namespace seeks_plugins
     if (!pers)
       pers = websearch::_wconfig->_personalization ? "on" : "off";
     bool persf = (strcasecmp(pers,"on")==0);
-    pthread_t pers_thread = 0;
+    task_group pers_tasks(thread_pool::shared()); // joined on return.
     ws_thread_arg *pers_thread_arg = NULL;
 
     // expansion: we fetch more pages from every search engine.
@@ -493,23 +494,15 @@ namespace seeks_plugins
         expanded = true;
         mutex_lock(&qc->_qc_mutex);
         mutex_lock(&qc->_feeds_ack_mutex);
+        qc->_feeds_acked = false;
         try
           {
 #if defined(PROTOBUF) && defined(TC)
             if (persf)
               {
                 pers_thread_arg = new ws_thread_arg(new pers_arg(qc,parameters));
-                int perr = pthread_create(&pers_thread,NULL,
-                                          (void *(*)(void *))&websearch::perform_websearch_threaded,
-                                          pers_thread_arg);
-                if (perr != 0)
-                  {
-                    errlog::log_error(LOG_LEVEL_ERROR,"Error creating main personalization thread.");
-                    mutex_unlock(&qc->_qc_mutex);
-                    mutex_unlock(&qc->_feeds_ack_mutex);
-                    delete pers_thread_arg;
-                    return WB_ERR_THREAD;
-                  }
+                pers_tasks.run((void *(*)(void *))&websearch::perform_websearch_threaded,
+                               pers_thread_arg);
               }
 #endif
             qc->generate(csp,rsp,parameters,expanded);
@@ -535,6 +528,8 @@ namespace seeks_plugins
         // do not return if perso + err != no engine
         // instead signal all personalization threads that results may have
         // arrived.
+        qc->_feeds_acked = true;
+        cond_broadcast(&qc->_feeds_ack_cond);
         mutex_unlock(&qc->_feeds_ack_mutex);
         if (persf && err != SP_ERR_CGI_PARAMS)
           {
@@ -545,12 +540,8 @@ namespace seeks_plugins
 #if defined(PROTOBUF) && defined(TC)
             if (persf)
               {
-                while(!pers_thread_arg->_done)
-                  {
-                    cond_broadcast(&qc->_feeds_ack_cond);
-                  }
+                pers_tasks.wait();
                 delete pers_thread_arg;
-                pthread_join(pers_thread,NULL);
               }
 #endif
             return err;
@@ -569,6 +560,7 @@ namespace seeks_plugins
         expanded = true;
         mutex_lock(&qc->_qc_mutex);
         mutex_lock(&qc->_feeds_ack_mutex);
+        qc->_feeds_acked = false;
         try
           {
 #if defined(PROTOBUF) && defined(TC)
@@ -576,17 +568,8 @@ namespace seeks_plugins
             if (persf)
               {
                 pers_thread_arg = new ws_thread_arg(new pers_arg(qc,parameters));
-                int perr = pthread_create(&pers_thread,NULL,
-                                          (void *(*)(void *))&websearch::perform_websearch_threaded,
-                                          pers_thread_arg);
-                if (perr != 0)
-                  {
-                    errlog::log_error(LOG_LEVEL_ERROR,"Error creating main personalization thread.");
-                    mutex_unlock(&qc->_qc_mutex);
-                    mutex_unlock(&qc->_feeds_ack_mutex);
-                    delete pers_thread_arg;
-                    return WB_ERR_THREAD;
-                  }
+                pers_tasks.run((void *(*)(void *))&websearch::perform_websearch_threaded,
+                               pers_thread_arg);
               }
 #endif
             qc->generate(csp,rsp,parameters,expanded);
@@ -612,6 +595,8 @@ namespace seeks_plugins
         // do not return if personalization on.
         // instead signal all personalization threads that results may have
         // arrived.
+        qc->_feeds_acked = true;
+        cond_broadcast(&qc->_feeds_ack_cond);
         mutex_unlock(&qc->_feeds_ack_mutex);
         if (persf && err != SP_ERR_CGI_PARAMS)
           {
@@ -622,12 +607,8 @@ namespace seeks_plugins
 #if defined(PROTOBUF) && defined(TC)
             if (persf)
               {
-                while(!pers_thread_arg->_done)
-                  {
-                    cond_broadcast(&qc->_feeds_ack_cond);
-                  }
+                pers_tasks.wait();
                 delete pers_thread_arg;
-                pthread_join(pers_thread,NULL);
               }
 #endif
             return err;
@@ -655,15 +636,11 @@ namespace seeks_plugins
       }
 
 #if defined(PROTOBUF) && defined(TC)
-    // signal personalization thread that we're done with external data sources.
-    if (persf && pers_thread && pers_thread_arg)
+    // wait for personalization, external data sources have been fetched.
+    if (persf && pers_thread_arg)
       {
-        while(!pers_thread_arg->_done)
-          {
-            cond_broadcast(&qc->_feeds_ack_cond);
-          }
+        pers_tasks.wait();
         delete pers_thread_arg;
-        pthread_join(pers_thread,NULL);
       }
 #endif
 
@@ -23,6 +23,7 @@
 #include "miscutil.h"
 #include "encode.h"
 #include "errlog.h"
+#include "thread_pool.h"
 
 #include "se_parser_bing_img.h"
 #include "se_parser_ggle_img.h"
@@ -416,10 +417,10 @@ namespace seeks_plugins
                                           const feeds &se_enabled)
   {
     int j = 0;
-    std::vector<pthread_t> parser_threads;
+    task_group parser_tasks(thread_pool::shared());
     std::vector<ps_thread_arg*> parser_args;
 
-    // threads, one per parser.
+    // tasks, one per parser.
     std::set<feed_parser,feed_parser::lxn>::iterator it
     = se_enabled._feedset.begin();
     while(it!=se_enabled._feedset.end())
@@ -436,31 +437,14 @@ namespace seeks_plugins
                 args->_offset = count_offset;
                 args->_qr = qr;
                 parser_args.push_back(args);
-
-                pthread_t ps_thread;
-                int err = pthread_create(&ps_thread, NULL,  // default attribute is PTHREAD_CREATE_JOINABLE
-                                         (void * (*)(void *))se_handler_img::parse_output, args);
-                if (err != 0)
-                  {
-                    errlog::log_error(LOG_LEVEL_ERROR, "Error creating parser thread.");
-                    parser_threads.push_back(0);
-                    delete args;
-                    parser_args.push_back(NULL);
-                    continue;
-                  }
-                parser_threads.push_back(ps_thread);
+                parser_tasks.run((void * (*)(void *))se_handler_img::parse_output, args);
               }
-            else parser_threads.push_back(0);
             j++;
           }
         ++it;
       }
     // join and merge results.
-    for (size_t i=0; i<parser_threads.size(); i++)
-      {
-        if (parser_threads.at(i)!=0)
-          pthread_join(parser_threads.at(i),NULL);
-      }
+    parser_tasks.wait();
 
     for (size_t i=0; i<parser_args.size(); i++)
       {
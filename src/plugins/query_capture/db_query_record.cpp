@@ -25,10 +25,13 @@
 
 #include "DHTKey.h" // for fixing issue 169.
 #include "qprocess.h" // idem.
+#include "mrf.h"
 #include "query_capture_configuration.h" // idem.
 using lsh::qprocess;
+using lsh::mrf;
 
 #include "uri_capture.h"
+#include "title_resolver.h"
 
 #include <algorithm>
 #include <iterator>
@@ -51,7 +54,7 @@ namespace seeks_plugins
   query_data::query_data(const std::string &query,
                          const short &radius)
     :_query(query),_radius(radius),_hits(1),_visited_urls(NULL),
-     _record_key(NULL)
+     _record_key(NULL),_vurls_total_hits(0.0)
   {
   }
 
@@ -65,7 +68,7 @@ namespace seeks_plugins
                          const uint32_t &url_date,
                          const uint32_t &rec_date,
                          const std::string &url_lang)
-    :_query(query),_radius(radius),_hits(hits),_record_key(NULL)
+    :_query(query),_radius(radius),_hits(hits),_record_key(NULL),_vurls_total_hits(0.0)
   {
     _visited_urls = new hash_map<const char*,vurl_data*,hash<const char*>,eqstr>(1);
     vurl_data *vd = new vurl_data(url,url_hits,title,summary,url_date,rec_date,url_lang);
@@ -74,7 +77,7 @@ namespace seeks_plugins
 
   query_data::query_data(const query_data *qd)
     :_query(qd->_query),_radius(qd->_radius),_hits(qd->_hits),_visited_urls(NULL),
-     _record_key(NULL)
+     _record_key(NULL),_vurls_total_hits(0.0)
   {
     if (qd->_visited_urls)
       {
@@ -84,9 +87,10 @@ namespace seeks_plugins
         while (hit!=qd->_visited_urls->end())
           {
             vurl_data *vd = new vurl_data((*hit).second);
-            add_vurl(vd);
+            _visited_urls->insert(std::pair<const char*,vurl_data*>(vd->_url.c_str(),vd));
             ++hit;
           }
+        update_vurl_table();
       }
   }
 
@@ -158,17 +162,22 @@ namespace seeks_plugins
         else
           {
             vurl_data *vd = new vurl_data((*hit).second);
-            add_vurl(vd);
+            _visited_urls->insert(std::pair<const char*,vurl_data*>(vd->_url.c_str(),vd));
           }
         ++hit;
       }
+    update_vurl_table();
   }
 
   void query_data::add_vurl(vurl_data *vd)
   {
     if (!_visited_urls)
       return; // safe.
-    _visited_urls->insert(std::pair<const char*,vurl_data*>(vd->_url.c_str(),vd));
+    if (!_visited_urls->insert(std::pair<const char*,vurl_data*>(vd->_url.c_str(),vd)).second)
+      return; // already in, table is unchanged.
+    vurl_entry ve(query_data::hash_vurl(vd->_url),vd);
+    _vurl_table.insert(std::upper_bound(_vurl_table.begin(),_vurl_table.end(),ve),ve);
+    _vurls_total_hits += vd->_hits;
   }
 
   vurl_data* query_data::find_vurl(const std::string &url) const
@@ -181,6 +190,19 @@ namespace seeks_plugins
     return NULL;
   }
 
+  vurl_data* query_data::find_vurl(const uint32_t &hash, const std::string &url) const
+  {
+    std::vector<vurl_entry>::const_iterator vit
+    = std::lower_bound(_vurl_table.begin(),_vurl_table.end(),vurl_entry(hash,NULL));
+    while (vit!=_vurl_table.end() && (*vit)._hash == hash)
+      {
+        if ((*vit)._vd->_url == url)
+          return (*vit)._vd;
+        ++vit;
+      }
+    return NULL;
+  }
+
   float query_data::vurls_total_hits() const
   {
     if (!_visited_urls)
@@ -196,6 +218,30 @@ namespace seeks_plugins
     return res;
   }
 
+  void query_data::update_vurl_table()
+  {
+    _vurl_table.clear();
+    _vurls_total_hits = 0.0;
+    if (!_visited_urls)
+      return;
+    _vurl_table.reserve(_visited_urls->size());
+    hash_map<const char*,vurl_data*,hash<const char*>,eqstr>::const_iterator hit
+    = _visited_urls->begin();
+    while (hit!=_visited_urls->end())
+      {
+        vurl_data *vd = (*hit).second;
+        _vurl_table.push_back(vurl_entry(query_data::hash_vurl(vd->_url),vd));
+        _vurls_total_hits += vd->_hits;
+        ++hit;
+      }
+    std::stable_sort(_vurl_table.begin(),_vurl_table.end());
+  }
+
+  uint32_t query_data::hash_vurl(const std::string &url)
+  {
+    return mrf::mrf_single_feature(url);
+  }
+
   /*- db_query_record -*/
   db_query_record::db_query_record(const time_t &creation_time,
                                    const std::string &plugin_name)
@@ -271,7 +317,9 @@ namespace seeks_plugins
   int db_query_record::serialize(std::string &msg) const
   {
     sp::db::record r;
-    create_query_record(r);
+    if (db_query_record::compact_records())
+      create_compact_query_record(r);
+    else create_query_record(r);
     if (!r.SerializeToString(&msg))
       {
         errlog::log_error(LOG_LEVEL_ERROR,"Failed serializing db_query_record");
@@ -295,7 +343,9 @@ namespace seeks_plugins
   int db_query_record::serialize_compressed(std::string &msg) const
   {
     sp::db::record r;
-    create_query_record(r);
+    if (db_query_record::compact_records())
+      create_compact_query_record(r);
+    else create_query_record(r);
     std::string tmp;
     if (!r.SerializeToString(&tmp))
       {
@@ -396,17 +446,176 @@ namespace seeks_plugins
       }
   }
 
+  /**
+   * \brief dates are stored relative to the record creation time, so that they
+   *        pack in few bytes, with 0 kept for unset dates.
+   */
+  static int32_t compact_date(const uint32_t &creation_time, const uint32_t &date)
+  {
+    if (date == 0)
+      return 0;
+    int32_t d = static_cast<int32_t>(creation_time - date);
+    return d >= 0 ? d + 1 : d;
+  }
+
+  static uint32_t uncompact_date(const uint32_t &creation_time, const int32_t &d)
+  {
+    if (d == 0)
+      return 0;
+    return creation_time - static_cast<uint32_t>(d > 0 ? d - 1 : d);
+  }
+
+  /**
+   * \brief returns the reference to str in the compact record, and adds it
+   *        the first time it is seen.
+   */
+  static uint32_t compact_str(const std::string &str,
+                              hash_map<const char*,uint32_t,hash<const char*>,eqstr> &ids,
+                              sp::db::compact_queries *cq)
+  {
+    if (str.empty())
+      return 0;
+    hash_map<const char*,uint32_t,hash<const char*>,eqstr>::const_iterator hit;
+    if ((hit = ids.find(str.c_str()))!=ids.end())
+      return (*hit).second;
+    cq->add_str(str);
+    uint32_t id = cq->str_size();
+    ids.insert(std::pair<const char*,uint32_t>(str.c_str(),id));
+    return id;
+  }
+
+  static const std::string& uncompact_str(const sp::db::compact_queries &cq, const uint32_t &id)
+  {
+    static const std::string empty;
+    if (id == 0 || id > static_cast<uint32_t>(cq.str_size()))
+      return empty;
+    return cq.str(id-1);
+  }
+
+  void db_query_record::create_compact_query_record(sp::db::record &r) const
+  {
+    create_base_record(r);
+    sp::db::compact_queries *cq = r.MutableExtension(sp::db::cqueries);
+    hash_map<const char*,uint32_t,hash<const char*>,eqstr> ids;
+    uint32_t creation_time = r.creation_time();
+    hash_map<const char*,query_data*,hash<const char*>,eqstr>::const_iterator hit
+    = _related_queries.begin();
+    while (hit!=_related_queries.end())
+      {
+        query_data *rd = (*hit).second;
+        cq->add_radius(rd->_radius);
+        cq->add_query(compact_str(rd->_query,ids,cq));
+        cq->add_query_hits(rd->_hits);
+        uint32_t nvurls = 0;
+        if (rd->_visited_urls)
+          {
+            hash_map<const char*,vurl_data*,hash<const char*>,eqstr>::const_iterator vhit
+            = rd->_visited_urls->begin();
+            while (vhit!=rd->_visited_urls->end())
+              {
+                vurl_data *vd = (*vhit).second;
+                if (vd) // XXX: should not happen.
+                  {
+                    cq->add_url(compact_str(vd->_url,ids,cq));
+                    cq->add_hits(vd->_hits);
+                    cq->add_title(compact_str(vd->_title,ids,cq));
+                    if (!vd->_title.empty())
+                      {
+                        cq->add_summary(compact_str(vd->_summary,ids,cq));
+                        cq->add_url_lang(compact_str(vd->_url_lang,ids,cq));
+                        cq->add_url_date(compact_date(creation_time,vd->_url_date));
+                        cq->add_rec_date(compact_date(creation_time,vd->_rec_date));
+                      }
+                    nvurls++;
+                  }
+                else errlog::log_error(LOG_LEVEL_ERROR,"null vurl_data element in visited_urls when creating db_query_record");
+                ++vhit;
+              }
+          }
+        cq->add_nvurls(nvurls);
+        ++hit;
+      }
+  }
+
+  /**
+   * \brief reads the related queries of a compact record.
+   * @return false if the record is malformed.
+   */
+  static bool read_compact_queries(const sp::db::compact_queries &cq,
+                                   const uint32_t &creation_time,
+                                   hash_map<const char*,query_data*,hash<const char*>,eqstr> &related_queries)
+  {
+    int nrq = cq.query_size();
+    int nv = cq.url_size();
+    if (cq.radius_size() != nrq || cq.query_hits_size() != nrq
+        || cq.nvurls_size() != nrq || cq.hits_size() != nv || cq.title_size() != nv)
+      return false;
+    int nt = 0;
+    for (int v=0; v<nv; v++)
+      if (cq.title(v) != 0)
+        nt++;
+    if (cq.summary_size() != nt || cq.url_lang_size() != nt
+        || cq.url_date_size() != nt || cq.rec_date_size() != nt)
+      return false;
+
+    int v = 0; // visited url.
+    int t = 0; // visited url with a title.
+    for (int i=0; i<nrq; i++)
+      {
+        int nvurls = cq.nvurls(i);
+        if (nvurls > nv - v)
+          return false;
+        query_data *rd = new query_data(uncompact_str(cq,cq.query(i)),cq.radius(i));
+        rd->_hits = cq.query_hits(i);
+        if (nvurls > 0)
+          rd->create_visited_urls();
+        for (int j=0; j<nvurls; j++,v++)
+          {
+            vurl_data *vd = NULL;
+            if (cq.title(v) == 0)
+              vd = new vurl_data(uncompact_str(cq,cq.url(v)),cq.hits(v));
+            else
+              {
+                vd = new vurl_data(uncompact_str(cq,cq.url(v)),cq.hits(v),
+                                   uncompact_str(cq,cq.title(v)),
+                                   uncompact_str(cq,cq.summary(t)),
+                                   uncompact_date(creation_time,cq.url_date(t)),
+                                   uncompact_date(creation_time,cq.rec_date(t)),
+                                   uncompact_str(cq,cq.url_lang(t)));
+                t++;
+              }
+            rd->_visited_urls->insert(std::pair<const char*,vurl_data*>(vd->_url.c_str(),vd));
+          }
+        rd->update_vurl_table();
+        related_queries.insert(std::pair<const char*,query_data*>(rd->_query.c_str(),rd));
+      }
+    return true;
+  }
+
+  bool db_query_record::compact_records()
+  {
+    return (query_capture_configuration::_config
+            && query_capture_configuration::_config->_compact_records);
+  }
+
   void db_query_record::read_query_record(sp::db::record &r)
   {
     read_base_record(r);
+    if (r.HasExtension(sp::db::cqueries))
+      {
+        if (!read_compact_queries(r.GetExtension(sp::db::cqueries),r.creation_time(),
+                                  _related_queries))
+          errlog::log_error(LOG_LEVEL_ERROR,"Malformed compact db_query_record");
+        return;
+      }
     sp::db::related_queries *rqueries = r.MutableExtension(sp::db::queries);
     int nrq = rqueries->rquery_size();
     for (int i=0; i<nrq; i++)
       {
         sp::db::related_query *rq = rqueries->mutable_rquery(i);
         short radius = rq->radius();
-        std::string query = rq->query();
-        query_data *rd = new query_data(query,radius);
+        query_data *rd = new query_data("",radius);
+        rd->_query.swap(*rq->mutable_query()); // strings are moved out of the message.
         rd->_hits = rq->query_hits();
         sp::db::visited_urls *rq_vurls = rq->mutable_vurls();
         int nvurls = rq_vurls->vurl_size();
@@ -415,16 +624,18 @@ namespace seeks_plugins
         for (int j=0; j<nvurls; j++)
           {
             sp::db::visited_url *rq_vurl = rq_vurls->mutable_vurl(j);
-            std::string url = rq_vurl->url();
-            short uhits = rq_vurl->hits();
-            std::string title = rq_vurl->title();
-            std::string summary = rq_vurl->summary();
-            uint32_t url_date = rq_vurl->url_date();
-            uint32_t rec_date = rq_vurl->rec_date();
-            std::string lang = rq_vurl->url_lang();
-            vurl_data *vd = new vurl_data(url,uhits,title,summary,url_date,rec_date,lang);
+            vurl_data *vd = new vurl_data("",rq_vurl->hits(),"","",
+                                          rq_vurl->url_date(),rq_vurl->rec_date());
+            vd->_url.swap(*rq_vurl->mutable_url());
+            if (rq_vurl->has_title())
+              vd->_title.swap(*rq_vurl->mutable_title());
+            if (rq_vurl->has_summary())
+              vd->_summary.swap(*rq_vurl->mutable_summary());
+            if (rq_vurl->has_url_lang())
+              vd->_url_lang.swap(*rq_vurl->mutable_url_lang());
             rd->_visited_urls->insert(std::pair<const char*,vurl_data*>(vd->_url.c_str(),vd));
           }
+        rd->update_vurl_table();
         _related_queries.insert(std::pair<const char*,query_data*>(rd->_query.c_str(),rd));
       }
   }
@@ -567,6 +778,7 @@ namespace seeks_plugins
             for (size_t i=0; i<tis; i++)
               qd->_visited_urls->insert(std::pair<const char*,vurl_data*>(to_insert.at(i)->_url.c_str(),
                                         to_insert.at(i)));
+            qd->update_vurl_table();
             fixed_queries++;
             to_insert.clear();
           }
@@ -675,6 +887,7 @@ namespace seeks_plugins
                 qd->_visited_urls->insert(std::pair<const char*,vurl_data*>(to_insert_u.at(i)->_url.c_str(),
                                           to_insert_u.at(i)));
               }
+            qd->update_vurl_table();
           }
 
         if (!dumped_q)
@@ -728,10 +941,11 @@ namespace seeks_plugins
   }
 
   void db_query_record::fetch_url_titles(uint32_t &fetched_urls,
-                                         const long &timeout,
-                                         const std::vector<std::list<const char*>*> *headers)
+                                         title_resolver &tr,
+                                         const std::list<const char*> *headers)
   {
-    std::vector<vurl_data*> to_insert;
+    std::vector<vurl_data*> vds;
+    std::vector<std::string> uris;
     hash_map<const char*,query_data*,hash<const char*>,eqstr>::iterator hit
     = _related_queries.begin();
     while (hit!=_related_queries.end())
@@ -751,22 +965,26 @@ namespace seeks_plugins
             vurl_data *vd = (*vit).second;
             if (vd->_title.empty())
               {
-                std::vector<std::string> titles;
-                std::vector<std::string> uris;
+                vds.push_back(vd);
                 uris.push_back(vd->_url);
-                errlog::log_error(LOG_LEVEL_DEBUG,"fetching uri: %s",vd->_url.c_str());
-                uc_err ferr = uri_capture::fetch_uri_html_title(uris,titles,timeout,headers);
-                if (ferr == SP_ERR_OK)
-                  {
-                    fetched_urls++;
-                    if (titles.at(0) != "404")
-                      vd->_title = titles.at(0);
-                  }
               }
             ++vit;
           }
         ++hit;
       }
+    if (uris.empty())
+      return;
+
+    std::vector<std::string> titles;
+    tr.resolve(uris,titles,headers);
+    for (size_t i=0; i<vds.size(); i++)
+      {
+        if (titles.at(i).empty())
+          continue;
+        fetched_urls++;
+        if (titles.at(i) != "404")
+          vds.at(i)->_title = titles.at(i);
+      }
   }
 
 
@@ -35,6 +35,8 @@ using dht::DHTKey;
 namespace seeks_plugins
 {
 
+  class title_resolver;
+
   class vurl_data
   {
     public:
@@ -97,6 +99,25 @@ namespace seeks_plugins
       std::string _url_lang;
   };
 
+  /**
+   * \brief entry of the table of visited URLs of a query, sorted by URL hash.
+   */
+  class vurl_entry
+  {
+    public:
+      vurl_entry(const uint32_t &hash, vurl_data *vd)
+        :_hash(hash),_vd(vd)
+      {};
+
+      bool operator<(const vurl_entry &e) const
+      {
+        return _hash < e._hash;
+      };
+
+      uint32_t _hash;
+      vurl_data *_vd;
+  };
+
   class query_data
   {
     public:
@@ -126,13 +147,28 @@ namespace seeks_plugins
 
       vurl_data* find_vurl(const std::string &url) const;
 
+      /**
+       * \brief finds a visited URL by its hash, as returned by hash_vurl, in the table.
+       */
+      vurl_data* find_vurl(const uint32_t &hash, const std::string &url) const;
+
       float vurls_total_hits() const;
 
+      /**
+       * \brief rebuilds the table of visited URLs and their total hits. To be called
+       *        after changes to the visited URLs made outside of add_vurl and merge.
+       */
+      void update_vurl_table();
+
+      static uint32_t hash_vurl(const std::string &url);
+
       std::string _query;
       short _radius;
       short _hits;
       hash_map<const char*,vurl_data*,hash<const char*>,eqstr> *_visited_urls;
       DHTKey *_record_key; /**< optional record key, not stored on db. */
+      std::vector<vurl_entry> _vurl_table; /**< visited URLs sorted by hash, not stored on db. */
+      float _vurls_total_hits; /**< sum of the hits of the visited URLs. */
   };
 
   class db_query_record : public db_record
@@ -178,8 +214,23 @@ namespace seeks_plugins
 
       void create_query_record(sp::db::record &r) const;
 
+      /**
+       * \brief fills up r with the related queries in compact form, in which
+       *        every string is stored once and numbers are packed.
+       */
+      void create_compact_query_record(sp::db::record &r) const;
+
+      /**
+       * \brief reads the related queries from r, in either form. Strings are
+       *        moved out of r rather than copied.
+       */
       void read_query_record(sp::db::record &r);
 
+      /**
+       * \brief whether records are serialized in compact form, as configured.
+       */
+      static bool compact_records();
+
       int fix_issue_169(user_db &cudb);
 
       int fix_issue_263();
@@ -190,9 +241,15 @@ namespace seeks_plugins
 
       std::string fix_issue_575(uint32_t &fixed_queries);
 
+      /**
+       * \brief fetches the missing titles of the visited URLs, all at once.
+       * @param fetched_urls incremented by the number of visited URLs that
+       *        got an answer.
+       * @param headers HTTP headers sent along every request, if not NULL.
+       */
       void fetch_url_titles(uint32_t &fetched_urls,
-                            const long &timeout,
-                            const std::vector<std::list<const char*>*> *headers);
+                            title_resolver &tr,
+                            const std::list<const char*> *headers=NULL);
 
       static void copy_related_queries(const hash_map<const char*,query_data*,hash<const char*>,eqstr> &rq,
                                        hash_map<const char*,query_data*,hash<const char*>,eqstr> &nrq);
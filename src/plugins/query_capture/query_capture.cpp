@@ -62,7 +62,7 @@ namespace seeks_plugins
 
   /*- query_db_sweepable -*/
   query_db_sweepable::query_db_sweepable()
-    :user_db_sweepable()
+    :user_db_sweepable(),_job(NULL)
   {
     // set last sweep to now.
     // sweeping is onde when plugin starts.
@@ -73,6 +73,7 @@ namespace seeks_plugins
 
   query_db_sweepable::~query_db_sweepable()
   {
+    delete _job; // cancels a running job.
   }
 
   bool query_db_sweepable::sweep_me()
@@ -89,14 +90,39 @@ namespace seeks_plugins
   }
 
   int query_db_sweepable::sweep_records()
+  {
+    if (query_capture_configuration::_config->_retention <= 0)
+      return SP_ERR_OK;
+    if (_job)
+      {
+        if (!_job->done())
+          return SP_ERR_OK; // previous sweep is still running.
+        delete _job;
+      }
+    struct timeval tv_now;
+    gettimeofday(&tv_now,NULL);
+    time_t sweep_date = tv_now.tv_sec - query_capture_configuration::_config->_retention;
+    _job = new user_db_maintenance(seeks_proxy::_user_db,"query-capture",sweep_date);
+    _job->set_limits_from_config();
+    sp_err err = _job->start();
+    if (err != SP_ERR_OK)
+      {
+        delete _job;
+        _job = NULL;
+      }
+    return err;
+  }
+
+  int query_db_sweepable::prune_records()
   {
     struct timeval tv_now;
     gettimeofday(&tv_now,NULL);
     if (query_capture_configuration::_config->_retention > 0)
       {
         time_t sweep_date = tv_now.tv_sec - query_capture_configuration::_config->_retention;
-        int err = seeks_proxy::_user_db->prune_db("query-capture",sweep_date);
-        return err;
+        user_db_maintenance udm(seeks_proxy::_user_db,"query-capture",sweep_date);
+        udm.set_limits_from_config();
+        return udm.run();
       }
     else return SP_ERR_OK;
   }
@@ -145,7 +171,7 @@ namespace seeks_plugins
     else if (seeks_proxy::_config->_user_db_startup_check)
       {
         // preventive sweep of records.
-        _qelt->_qds.sweep_records();
+        _qelt->_qds.prune_records();
       }
 
     // get number of captured queries already in user_db.
@@ -28,6 +28,7 @@
 #include "DHTKey.h"
 #include "search_snippet.h"
 #include "user_db.h"
+#include "user_db_maintenance.h"
 
 using namespace sp;
 using dht::DHTKey;
@@ -44,9 +45,19 @@ namespace seeks_plugins
 
       virtual bool sweep_me();
 
+      /**
+       * \brief prunes old records in a background job, unless the previous
+       *        one is still running.
+       */
       virtual int sweep_records();
 
+      /**
+       * \brief prunes old records before returning.
+       */
+      int prune_records();
+
       time_t _last_sweep;
+      user_db_maintenance *_job; /**< background pruning job. */
   };
 
   class query_capture_element;
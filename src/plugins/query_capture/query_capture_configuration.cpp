@@ -30,6 +30,7 @@ namespace seeks_plugins
 #define hash_query_protect_redir            645686780ul  /* "protected-redirection" */
 #define hash_save_url_data                 3465855637ul  /* "save-url-data" */
 #define hash_cross_post_url                4153795065ul  /* "cross-post-url" */
+#define hash_compact_records               3099210581ul  /* "compact-records" */
 
   query_capture_configuration* query_capture_configuration::_config = NULL;
 
@@ -54,6 +55,7 @@ namespace seeks_plugins
     _protected_redirection = false; // should be activated on public nodes.
     _save_url_data = true;
     _cross_post_url = ""; // no cross-posting is default.
+    _compact_records = false; // peers with older versions cannot read compact records.
   }
 
   void query_capture_configuration::handle_config_cmd(char *cmd, const uint32_t &cmd_hash, char *arg,
@@ -97,6 +99,12 @@ namespace seeks_plugins
                                            "URL to which to cross-post recommendations.");
         break;
 
+      case hash_compact_records:
+        _compact_records = static_cast<bool>(atoi(arg));
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "Whether query records are written in compact form.");
+        break;
+
       default:
         break;
       }
@@ -48,6 +48,7 @@ namespace seeks_plugins
       bool _protected_redirection; /**< whether URL redirection is protected against abuses. */
       bool _save_url_data; /**< whether to save URL title & summary for reuse. */
       std::string _cross_post_url; /**< default URL to which to cross-post recommendations. */
+      bool _compact_records; /**< whether query records are written in compact form. */
 
       static query_capture_configuration *_config;
   };
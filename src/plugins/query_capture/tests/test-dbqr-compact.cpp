@@ -0,0 +1,146 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "db_query_record.h"
+#include "db_query_record_msg.pb.h"
+#include "seeks_proxy.h"
+#include "plugin_manager.h"
+#include "proxy_configuration.h"
+#include "errlog.h"
+
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace seeks_plugins;
+using namespace sp;
+
+/**
+ * \brief measures the size and deserialization time of the query records
+ *        of a user db, in the original and compact forms.
+ */
+
+static double elapsed(const struct timeval &t1, const struct timeval &t2)
+{
+  return (t2.tv_sec - t1.tv_sec) * 1000.0 + (t2.tv_usec - t1.tv_usec) / 1000.0;
+}
+
+static double time_deserialize(const std::vector<std::string> &msgs)
+{
+  struct timeval start,stop;
+  gettimeofday(&start,NULL);
+  for (size_t i=0; i<msgs.size(); i++)
+    {
+      db_query_record dbr;
+      dbr.deserialize(msgs[i]);
+    }
+  gettimeofday(&stop,NULL);
+  return elapsed(start,stop);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+    {
+      std::cout << "Usage: <db_file> <seeks base dir>\n";
+      exit(0);
+    }
+
+  std::string dbfile = argv[1];
+  std::string basedir = argv[2];
+
+  seeks_proxy::_configfile = basedir + "/config";
+  seeks_proxy::_lshconfigfile = basedir + "/lsh/lsh-config";
+
+  seeks_proxy::initialize_mutexes();
+  errlog::init_log_module();
+  errlog::set_debug_level(LOG_LEVEL_FATAL | LOG_LEVEL_ERROR | LOG_LEVEL_INFO);
+
+  seeks_proxy::_basedir = basedir.c_str();
+  plugin_manager::_plugin_repository = basedir + "/plugins/";
+  seeks_proxy::_config = new proxy_configuration(seeks_proxy::_configfile);
+  seeks_proxy::_config->_user_db_startup_check = false;
+  seeks_proxy::_config->_user_db_optimize = false;
+  seeks_proxy::_lsh_config = new lsh_configuration(seeks_proxy::_lshconfigfile);
+
+  seeks_proxy::_user_db = new user_db(dbfile);
+  seeks_proxy::_user_db->open_db_readonly();
+
+  plugin_manager::load_all_plugins();
+  plugin_manager::start_plugins();
+
+  // re-encode every query record in both forms.
+  std::vector<std::string> msgs,cmsgs;
+  uint64_t stored = 0, bytes = 0, cbytes = 0;
+  void *rkey = NULL;
+  int rkey_size;
+  db_obj *hdb = seeks_proxy::_user_db->_hdb;
+  hdb->dbiterinit();
+  while ((rkey = hdb->dbiternext(&rkey_size)) != NULL)
+    {
+      std::string rkey_str = std::string((char*)rkey,rkey_size);
+      int value_size;
+      void *value = hdb->dbget(rkey,rkey_size,&value_size);
+      free(rkey);
+      std::string rec_pn,rec_key;
+      if (!value)
+        continue;
+      std::string str = std::string((char*)value,value_size);
+      free(value);
+      if (rkey_str == user_db::_db_version_key
+          || user_db::extract_plugin_and_key(rkey_str,rec_pn,rec_key) != 0
+          || rec_pn != "query-capture")
+        continue;
+
+      db_query_record dbr;
+      if (dbr.deserialize(str) != 0)
+        continue;
+      stored += str.size();
+
+      std::string msg,cmsg;
+      sp::db::record r,cr;
+      dbr.create_query_record(r);
+      dbr.create_compact_query_record(cr);
+      r.SerializeToString(&msg);
+      cr.SerializeToString(&cmsg);
+      bytes += msg.size();
+      cbytes += cmsg.size();
+      msgs.push_back(msg);
+      cmsgs.push_back(cmsg);
+    }
+
+  if (msgs.empty())
+    {
+      std::cout << "no query record found!\n";
+      exit(1);
+    }
+
+  double t = time_deserialize(msgs);
+  double ct = time_deserialize(cmsgs);
+
+  std::cout << "query records: " << msgs.size() << std::endl;
+  std::cout << "stored size (bytes): " << stored << std::endl;
+  std::cout << "original form (bytes): " << bytes << std::endl;
+  std::cout << "compact form (bytes): " << cbytes
+            << " (" << (100.0 * cbytes) / bytes << "%)" << std::endl;
+  std::cout << "original form deserialization: " << t << " ms" << std::endl;
+  std::cout << "compact form deserialization: " << ct << " ms" << std::endl;
+
+  seeks_proxy::_user_db->close_db();
+}
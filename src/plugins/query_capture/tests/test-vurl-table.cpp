@@ -0,0 +1,138 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Time to look up the visited URLs of snippets in the related queries, as
+ * in rank estimation: by URL string in the visited URLs with their hits
+ * summed for every pair, and by hash in the URL tables with their hits
+ * summed once.
+ */
+
+#include "db_query_record.h"
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace seeks_plugins;
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+static std::string url(const long &r)
+{
+  char u[64];
+  snprintf(u,sizeof(u),"http://www.site%ld.com/page%ld",r % 97,r);
+  return std::string(u);
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 4)
+    {
+      std::cout << "Usage: <related queries> <urls per query> <snippets>\n";
+      exit(0);
+    }
+
+  int nq = atoi(argv[1]);
+  int nu = atoi(argv[2]);
+  int ns = atoi(argv[3]);
+  srandom(1);
+
+  // related queries with URLs and hosts drawn from a common pool.
+  std::vector<query_data*> qdata;
+  for (int q=0; q<nq; q++)
+    {
+      char qs[16];
+      snprintf(qs,sizeof(qs),"q%d",q);
+      query_data *qd = new query_data(qs,0);
+      qd->create_visited_urls();
+      for (int u=0; u<nu; u++)
+        {
+          long r = random() % (4 * ns);
+          if (!qd->find_vurl(url(r)))
+            qd->add_vurl(new vurl_data(url(r),1 + random() % 10));
+          char h[32];
+          snprintf(h,sizeof(h),"www.site%ld.com",r % 97);
+          if (!qd->find_vurl(h))
+            qd->add_vurl(new vurl_data(h,1));
+        }
+      qdata.push_back(qd);
+    }
+  std::vector<std::string> urls, hosts;
+  for (int s=0; s<ns; s++)
+    {
+      long r = random() % (4 * ns);
+      urls.push_back(url(r));
+      char h[32];
+      snprintf(h,sizeof(h),"www.site%ld.com",r % 97);
+      hosts.push_back(h);
+    }
+
+  struct timeval tv_start;
+  gettimeofday(&tv_start,NULL);
+  double ref = 0.0;
+  std::vector<vurl_data*> ref_found;
+  for (int s=0; s<ns; s++)
+    for (int q=0; q<nq; q++)
+      {
+        vurl_data *vd_url = qdata[q]->find_vurl(urls[s]);
+        vurl_data *vd_host = qdata[q]->find_vurl(hosts[s]);
+        ref += qdata[q]->vurls_total_hits();
+        ref_found.push_back(vd_url);
+        ref_found.push_back(vd_host);
+      }
+  double ref_ms = elapsed_ms(tv_start);
+
+  gettimeofday(&tv_start,NULL);
+  double tab = 0.0;
+  std::vector<vurl_data*> tab_found;
+  for (int s=0; s<ns; s++)
+    {
+      uint32_t url_hash = query_data::hash_vurl(urls[s]);
+      uint32_t host_hash = query_data::hash_vurl(hosts[s]);
+      for (int q=0; q<nq; q++)
+        {
+          vurl_data *vd_url = qdata[q]->find_vurl(url_hash,urls[s]);
+          vurl_data *vd_host = qdata[q]->find_vurl(host_hash,hosts[s]);
+          tab += qdata[q]->_vurls_total_hits;
+          tab_found.push_back(vd_url);
+          tab_found.push_back(vd_host);
+        }
+    }
+  double tab_ms = elapsed_ms(tv_start);
+
+  size_t found = 0;
+  for (size_t i=0; i<ref_found.size(); i++)
+    if (ref_found[i])
+      ++found;
+
+  std::cout << "queries: " << nq << ", urls per query: " << nu << ", snippets: " << ns << std::endl;
+  std::cout << "visited urls (ms): " << ref_ms << std::endl;
+  std::cout << "url tables (ms): " << tab_ms << " (" << ref_ms / tab_ms << "x)" << std::endl;
+  std::cout << "found: " << found << " / " << ref_found.size()
+            << ", identical: " << (ref_found == tab_found && ref == tab ? "yes" : "no") << std::endl;
+
+  for (int q=0; q<nq; q++)
+    delete qdata[q];
+}
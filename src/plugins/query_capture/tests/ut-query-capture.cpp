@@ -21,6 +21,7 @@
 
 #include "query_capture.h"
 #include "db_query_record.h"
+#include "db_query_record_msg.pb.h"
 #include "qprocess.h"
 #include "user_db.h"
 #include "query_context.h"
@@ -432,6 +433,99 @@ TEST(DBRTest,serialize_deserialize_compressed_mix)
   delete dbr;
 }
 
+TEST(DBRTest,vurl_table)
+{
+  db_query_record dbr("query-capture",queries[0],0,uris[1],1,2);
+  db_query_record dbr2("query-capture",queries[0],0,uris[2],1,3);
+  ASSERT_EQ(SP_ERR_OK,dbr.merge_with(dbr2));
+  query_data *qd = (*dbr._related_queries.begin()).second;
+  ASSERT_EQ(2,qd->_vurl_table.size());
+  ASSERT_EQ(5.0,qd->_vurls_total_hits);
+  ASSERT_EQ(qd->find_vurl(uris[1]),qd->find_vurl(query_data::hash_vurl(uris[1]),uris[1]));
+  ASSERT_TRUE(NULL==qd->find_vurl(query_data::hash_vurl(uris[0]),uris[0]));
+
+  // hits that cancel out remove the URL from the table.
+  db_query_record dbr3("query-capture",queries[0],0,uris[2],1,-3);
+  ASSERT_EQ(SP_ERR_OK,dbr.merge_with(dbr3));
+  ASSERT_EQ(1,qd->_vurl_table.size());
+  ASSERT_EQ(2.0,qd->_vurls_total_hits);
+  ASSERT_TRUE(NULL==qd->find_vurl(query_data::hash_vurl(uris[2]),uris[2]));
+
+  // tables are rebuilt from stored records.
+  std::string msg;
+  ASSERT_EQ(0,dbr.serialize(msg));
+  db_query_record dbr4;
+  ASSERT_EQ(0,dbr4.deserialize(msg));
+  query_data *qd4 = (*dbr4._related_queries.begin()).second;
+  ASSERT_EQ(1,qd4->_vurl_table.size());
+  ASSERT_EQ(2.0,qd4->_vurls_total_hits);
+  ASSERT_TRUE(NULL!=qd4->find_vurl(query_data::hash_vurl(uris[1]),uris[1]));
+
+  query_data qd5(qd4);
+  ASSERT_EQ(1,qd5._vurl_table.size());
+  ASSERT_EQ(2.0,qd5._vurls_total_hits);
+}
+
+TEST(DBRTest,compact_record)
+{
+  db_query_record dbr("query-capture",queries[0],0,uris[1],1,2,
+                      "Seeks Project Documentation","Seeks project documentation",
+                      1300000000,1300000100,"en");
+  db_query_record dbr2("query-capture",queries[1],1,uris[1],1,3,
+                       "Seeks Project Documentation","Seeks project documentation",
+                       0,1300000100,"en");
+  db_query_record dbr3("query-capture",queries[1],1,uris[2],2,-1);
+  ASSERT_EQ(SP_ERR_OK,dbr.merge_with(dbr2));
+  ASSERT_EQ(SP_ERR_OK,dbr.merge_with(dbr3));
+
+  sp::db::record r,cr;
+  dbr.create_query_record(r);
+  dbr.create_compact_query_record(cr);
+  std::string msg,cmsg;
+  ASSERT_TRUE(r.SerializeToString(&msg));
+  ASSERT_TRUE(cr.SerializeToString(&cmsg));
+  ASSERT_LT(cmsg.size(),msg.size());
+
+  // both forms read the same.
+  db_query_record dbr4,dbr5;
+  ASSERT_EQ(0,dbr4.deserialize(msg));
+  ASSERT_EQ(0,dbr5.deserialize(cmsg));
+  ASSERT_EQ(dbr._creation_time,dbr5._creation_time);
+  ASSERT_EQ(2,dbr5._related_queries.size());
+  for (int i=0; i<2; i++)
+    {
+      query_data *qd = dbr4._related_queries[queries[i].c_str()];
+      query_data *cqd = dbr5._related_queries[queries[i].c_str()];
+      ASSERT_TRUE(NULL!=cqd);
+      ASSERT_EQ(qd->_radius,cqd->_radius);
+      ASSERT_EQ(qd->_hits,cqd->_hits);
+      ASSERT_EQ(qd->_visited_urls->size(),cqd->_visited_urls->size());
+      ASSERT_EQ(qd->_vurls_total_hits,cqd->_vurls_total_hits);
+      hash_map<const char*,vurl_data*,hash<const char*>,eqstr>::const_iterator vhit
+      = qd->_visited_urls->begin();
+      while (vhit!=qd->_visited_urls->end())
+        {
+          vurl_data *vd = (*vhit).second;
+          vurl_data *cvd = cqd->find_vurl(vd->_url);
+          ASSERT_TRUE(NULL!=cvd);
+          ASSERT_EQ(vd->_hits,cvd->_hits);
+          ASSERT_EQ(vd->_title,cvd->_title);
+          ASSERT_EQ(vd->_summary,cvd->_summary);
+          ASSERT_EQ(vd->_url_date,cvd->_url_date);
+          ASSERT_EQ(vd->_rec_date,cvd->_rec_date);
+          ASSERT_EQ(vd->_url_lang,cvd->_url_lang);
+          ++vhit;
+        }
+    }
+
+  // malformed compact records are not read.
+  cr.MutableExtension(sp::db::cqueries)->add_nvurls(1);
+  ASSERT_TRUE(cr.SerializeToString(&cmsg));
+  db_query_record dbr6;
+  ASSERT_EQ(0,dbr6.deserialize(cmsg));
+  ASSERT_TRUE(dbr6._related_queries.empty());
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
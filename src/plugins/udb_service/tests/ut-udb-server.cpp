@@ -20,6 +20,7 @@
 #include <gtest/gtest.h>
 
 #include "udb_server.h"
+#include "udb_summary.h"
 #include "halo_msg_wrapper.h"
 #include "query_capture.h"
 #include "query_context.h"
@@ -197,6 +198,25 @@ TEST_F(UDBSTest,find_bqc_cb)
   delete dbqr;
 }
 
+TEST_F(UDBSTest,find_summary_cb)
+{
+  // the first request starts building the summary, and is not kept waiting.
+  http_response rsp;
+  db_err err = udb_server::find_summary_cb(&rsp);
+  ASSERT_TRUE(err == SP_ERR_OK || err == DB_ERR_NO_REC);
+  udb_server::stop_summary();
+
+  // the summary is served once built.
+  http_response rsp2;
+  err = udb_server::find_summary_cb(&rsp2);
+  ASSERT_EQ(SP_ERR_OK,err);
+  std::string str(rsp2._body,rsp2._content_length);
+  udb_summary us;
+  us.deserialize(str);
+  ASSERT_EQ(1,us._nkeys);
+  ASSERT_TRUE(us.may_contain("1645a6897e62417931f26bcbdf4687c9c026b626")); // key for 'seeks'.
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -18,6 +18,7 @@
 
 #include "udb_client.h"
 #include "udbs_err.h"
+#include "udb_summary.h"
 #include "udb_service_configuration.h"
 #include "DHTKey.h"
 #include "qprocess.h"
@@ -179,6 +180,62 @@ namespace seeks_plugins
     return dbr;
   }
 
+  udb_summary* udb_client::find_summary(const std::string &host,
+                                        const int &port,
+                                        const std::string &path) throw (sp_exception)
+  {
+    std::string url = host;
+    if (port != -1)
+      url += ":" + miscutil::to_string(port);
+    url += path + "/find_summary";
+    curl_mget cmg(1,udb_service_configuration::_config->_call_timeout,0,
+                  udb_service_configuration::_config->_call_timeout,0);
+    std::vector<std::string> urls;
+    urls.reserve(1);
+    urls.push_back(url);
+    std::vector<int> status;
+    if (udb_service_configuration::_config->_p2p_proxy_addr.empty())
+      cmg.www_mget(urls,1,NULL,"",0,status); // not going through a proxy.
+    else cmg.www_mget(urls,1,NULL,
+                        udb_service_configuration::_config->_p2p_proxy_addr,
+                        udb_service_configuration::_config->_p2p_proxy_port,
+                        status); // through a proxy.
+    std::string port_str = (port != -1) ? ":" + miscutil::to_string(port) : "";
+    if (status[0] != 0)
+      {
+        // failed connection.
+        delete[] cmg._outputs;
+        std::string msg = "failed connection or transmission error fetching summary from "
+                          + host + port_str + path;
+        errlog::log_error(LOG_LEVEL_ERROR,msg.c_str());
+        throw sp_exception(UDBS_ERR_CONNECT,msg);
+      }
+    else if (!cmg._outputs[0])
+      {
+        // no user db.
+        delete[] cmg._outputs;
+        return NULL;
+      }
+    udb_summary *us = new udb_summary();
+    try
+      {
+        us->deserialize(*cmg._outputs[0]);
+      }
+    catch (sp_exception &e)
+      {
+        delete us;
+        delete cmg._outputs[0];
+        delete[] cmg._outputs;
+        std::string msg = "deserialization error fetching summary from "
+                          + host + port_str + path;
+        errlog::log_error(LOG_LEVEL_ERROR,msg.c_str());
+        throw sp_exception(UDBS_ERR_DESERIALIZE,msg);
+      }
+    delete cmg._outputs[0];
+    delete[] cmg._outputs;
+    return us;
+  }
+
   db_record* udb_client::deserialize_found_record(const std::string &str, const std::string &pn)
   {
     plugin *pl = plugin_manager::get_plugin(pn);
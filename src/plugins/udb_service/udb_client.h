@@ -27,6 +27,8 @@ using sp::db_record;
 namespace seeks_plugins
 {
 
+  class udb_summary;
+
   class udb_client
   {
     public:
@@ -46,6 +48,14 @@ namespace seeks_plugins
                           const std::string &query,
                           const uint32_t &expansion) throw (sp_exception);
 
+      /**
+       * \brief fetches the summary of the query-capture keys of a remote user db.
+       * @return the summary, NULL if the remote node has no user db.
+       */
+      udb_summary* find_summary(const std::string &host,
+                                const int &port,
+                                const std::string &path) throw (sp_exception);
+
       static db_record* deserialize_found_record(const std::string &str,
           const std::string &pn);
   };
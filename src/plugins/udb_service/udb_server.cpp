@@ -18,6 +18,8 @@
 
 #include "udb_server.h"
 #include "halo_msg_wrapper.h"
+#include "udb_summary.h"
+#include "udb_service_configuration.h"
 #include "db_query_record.h"
 #include "cf.h"
 #include "seeks_proxy.h"
@@ -31,6 +33,13 @@ using namespace sp;
 namespace seeks_plugins
 {
 
+  std::string udb_server::_summary;
+  time_t udb_server::_summary_date = 0;
+  sp_mutex_t udb_server::_summary_mutex = PTHREAD_MUTEX_INITIALIZER;
+  bool udb_server::_summary_building = false;
+  bool udb_server::_summary_thread_started = false;
+  pthread_t udb_server::_summary_thread;
+
   db_err udb_server::find_dbr_cb(const char *key_str, const char *pn_str,
                                  http_response *rsp)
   {
@@ -104,4 +113,97 @@ namespace seeks_plugins
     return SP_ERR_OK;
   }
 
+  db_err udb_server::find_summary_cb(http_response *rsp)
+  {
+    if (!seeks_proxy::_user_db)
+      return DB_ERR_NO_DB;
+
+    // requests are served the last summary while a new one is built.
+    udb_server::refresh_summary();
+    mutex_lock(&udb_server::_summary_mutex);
+    std::string str = udb_server::_summary;
+    mutex_unlock(&udb_server::_summary_mutex);
+    if (str.empty())
+      return DB_ERR_NO_REC;
+
+    // fill up response.
+    size_t body_size = str.length() * sizeof(char);
+    if (!rsp->_body)
+      rsp->_body = (char*)std::malloc(body_size);
+    rsp->_content_length = body_size;
+    for (size_t i=0; i<str.length(); i++)
+      rsp->_body[i] = str[i];
+    return SP_ERR_OK;
+  }
+
+  void udb_server::refresh_summary()
+  {
+    mutex_lock(&udb_server::_summary_mutex);
+    time_t now = time(NULL);
+    if (udb_server::_summary_building
+        || (!udb_server::_summary.empty()
+            && difftime(now,udb_server::_summary_date) < udb_service_configuration::_config->_summary_refresh))
+      {
+        mutex_unlock(&udb_server::_summary_mutex);
+        return;
+      }
+    if (udb_server::_summary_thread_started)
+      pthread_join(udb_server::_summary_thread,NULL); // previous rebuild has returned.
+    udb_server::_summary_thread_started = false;
+    int err = pthread_create(&udb_server::_summary_thread,NULL,&udb_server::build_summary,NULL);
+    if (err != 0)
+      errlog::log_error(LOG_LEVEL_ERROR,"Error creating thread for building the user db summary: %d",err);
+    else
+      {
+        udb_server::_summary_building = true;
+        udb_server::_summary_thread_started = true;
+      }
+    mutex_unlock(&udb_server::_summary_mutex);
+  }
+
+  void udb_server::stop_summary()
+  {
+    mutex_lock(&udb_server::_summary_mutex);
+    bool started = udb_server::_summary_thread_started;
+    udb_server::_summary_thread_started = false;
+    mutex_unlock(&udb_server::_summary_mutex);
+    if (started)
+      pthread_join(udb_server::_summary_thread,NULL);
+  }
+
+  void* udb_server::build_summary(void *arg)
+  {
+    time_t date = time(NULL);
+    std::string str;
+    udb_summary *us = udb_summary::build(seeks_proxy::_user_db,"query-capture",
+                                         udb_service_configuration::_config->_summary_fp_rate);
+    if (us)
+      {
+        try
+          {
+            us->serialize(str);
+            errlog::log_error(LOG_LEVEL_DEBUG,"built user db summary of %u keys in %u bytes",
+                              (uint32_t)us->_nkeys,(uint32_t)str.length());
+          }
+        catch (sp_exception &e)
+          {
+            errlog::log_error(LOG_LEVEL_ERROR,e.what().c_str());
+            str.clear();
+          }
+        delete us;
+      }
+
+    // on failure, the last summary is kept and the rebuild is tried again
+    // on the next request.
+    mutex_lock(&udb_server::_summary_mutex);
+    if (!str.empty())
+      {
+        udb_server::_summary.swap(str);
+        udb_server::_summary_date = date;
+      }
+    udb_server::_summary_building = false;
+    mutex_unlock(&udb_server::_summary_mutex);
+    return NULL;
+  }
+
 } /* end of namespace. */
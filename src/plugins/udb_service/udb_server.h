@@ -21,6 +21,9 @@
 
 #include "db_err.h"
 #include "proxy_dts.h"
+#include "mutexes.h"
+
+#include <time.h>
 
 using namespace sp;
 
@@ -36,7 +39,37 @@ namespace seeks_plugins
       static db_err find_bqc_cb(const std::string &content,
                                 http_response *rsp);
 
+      /**
+       * \brief serves the last summary of the query-capture keys of the user
+       *        db, and starts rebuilding it in the background when it is older
+       *        than the summary refresh interval.
+       * @return DB_ERR_NO_REC while no summary has been built yet.
+       */
+      static db_err find_summary_cb(http_response *rsp);
+
       // other cb come here.
+
+      /**
+       * \brief starts rebuilding the summary in a background thread, unless
+       *        it is recent enough or already being rebuilt.
+       */
+      static void refresh_summary();
+
+      /**
+       * \brief waits for a summary that is being rebuilt.
+       */
+      static void stop_summary();
+
+      static std::string _summary; /**< serialized summary of the user db. */
+      static time_t _summary_date; /**< time at which the summary was last rebuilt. */
+      static sp_mutex_t _summary_mutex;
+
+    private:
+      static void* build_summary(void *arg);
+
+      static bool _summary_building; /**< whether a rebuild is running. */
+      static bool _summary_thread_started; /**< whether there is a rebuild thread to be joined. */
+      static pthread_t _summary_thread;
   };
 
 } /* end of namespace. */
@@ -57,7 +57,7 @@ namespace seeks_plugins
     _configuration = udb_service_configuration::_config;
 
     // cgi dispatchers.
-    _cgi_dispatchers.reserve(2);
+    _cgi_dispatchers.reserve(3);
     cgi_dispatcher *cgid_find_dbr
     = new cgi_dispatcher("find_dbr",&udb_service::cgi_find_dbr,NULL,TRUE);
     _cgi_dispatchers.push_back(cgid_find_dbr);
@@ -65,6 +65,10 @@ namespace seeks_plugins
     cgi_dispatcher *cgid_find_bqc
     = new cgi_dispatcher("find_bqc",&udb_service::cgi_find_bqc,NULL,TRUE);
     _cgi_dispatchers.push_back(cgid_find_bqc);
+
+    cgi_dispatcher *cgid_find_summary
+    = new cgi_dispatcher("find_summary",&udb_service::cgi_find_summary,NULL,TRUE);
+    _cgi_dispatchers.push_back(cgid_find_summary);
   }
 
   udb_service::~udb_service()
@@ -72,6 +76,11 @@ namespace seeks_plugins
     udb_service_configuration::_config = NULL;
   }
 
+  void udb_service::stop()
+  {
+    udb_server::stop_summary();
+  }
+
   db_err udb_service::cgi_find_dbr(client_state *csp,
                                    http_response *rsp,
                                    const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters)
@@ -105,6 +114,17 @@ namespace seeks_plugins
     return udb_server::find_bqc_cb(content,rsp);
   }
 
+  db_err udb_service::cgi_find_summary(client_state *csp,
+                                       http_response *rsp,
+                                       const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters)
+  {
+    if (!seeks_proxy::_user_db)
+      {
+        return SP_ERR_FILE; // no user db.
+      }
+    return udb_server::find_summary_cb(rsp);
+  }
+
   db_record* udb_service::find_dbr_client(const std::string &host,
                                           const int &port,
                                           const std::string &path,
@@ -36,7 +36,7 @@ namespace seeks_plugins
 
       virtual void start() {};
 
-      virtual void stop() {};
+      virtual void stop();
 
       static db_err cgi_find_dbr(client_state *csp,
                                  http_response *rsp,
@@ -46,6 +46,10 @@ namespace seeks_plugins
                                  http_response *rsp,
                                  const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters);
 
+      static db_err cgi_find_summary(client_state *csp,
+                                     http_response *rsp,
+                                     const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters);
+
       static db_record* find_dbr_client(const std::string &host,
                                         const int &port,
                                         const std::string &path,
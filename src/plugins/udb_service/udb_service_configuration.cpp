@@ -27,6 +27,8 @@ namespace seeks_plugins
 {
 #define hash_call_timeout                         3944957977ul  /* "call-timeout" */
 #define hash_p2p_proxy                            3750534420ul  /* "p2p-proxy-addr" */
+#define hash_summary_refresh                      3690433437ul  /* "summary-refresh" */
+#define hash_summary_fp_rate                      2618256511ul  /* "summary-fp-rate" */
 
   udb_service_configuration* udb_service_configuration::_config = NULL;
 
@@ -44,6 +46,8 @@ namespace seeks_plugins
   {
     _call_timeout = 3; // 3 seconds.
     _p2p_proxy_port = -1; // unset.
+    _summary_refresh = 300; // 5 mins.
+    _summary_fp_rate = 0.01;
   }
 
   void udb_service_configuration::handle_config_cmd(char *cmd, const uint32_t &cmd_hash, char *arg,
@@ -75,6 +79,18 @@ namespace seeks_plugins
                                            "Proxy through which to issue the P2P calls");
         break;
 
+      case hash_summary_refresh:
+        _summary_refresh = atoi(arg);
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "Interval between two rebuilds of the user db summary served to peers, in seconds");
+        break;
+
+      case hash_summary_fp_rate:
+        _summary_fp_rate = atof(arg);
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "False positive rate of the user db summary served to peers");
+        break;
+
       default:
         break;
       }
@@ -45,6 +45,8 @@ namespace seeks_plugins
       long _call_timeout; /**< timeout on connection and on data transfer for P2P calls. */
       std::string _p2p_proxy_addr; /**< address of a proxy through which to issue the P2P calls. */
       int _p2p_proxy_port; /**< port of a proxy through which to issue the P2P calls. */
+      int _summary_refresh; /**< interval between two rebuilds of the served user db summary, in seconds. */
+      double _summary_fp_rate; /**< false positive rate of the served user db summary. */
 
       static udb_service_configuration *_config;
   };
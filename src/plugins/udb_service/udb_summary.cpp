@@ -0,0 +1,154 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2011 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "udb_summary.h"
+#include "halo_msg.pb.h"
+#include "udbs_err.h"
+#include "errlog.h"
+
+#include <math.h>
+
+using sp::errlog;
+
+namespace seeks_plugins
+{
+
+  udb_summary::udb_summary(const uint64_t &nkeys, const double &fp_rate)
+    :_nkeys(0)
+  {
+    // optimal size and number of hashes for nkeys keys.
+    static double ln2 = log(2.0);
+    double p = (fp_rate > 0.0 && fp_rate < 1.0) ? fp_rate : 0.01;
+    uint64_t n = nkeys > 0 ? nkeys : 1;
+    _nbits = static_cast<uint64_t>(ceil(-(double)n * log(p) / (ln2 * ln2)));
+    if (_nbits < 64)
+      _nbits = 64;
+    _nhashes = static_cast<uint32_t>(round((double)_nbits / n * ln2));
+    if (_nhashes < 1)
+      _nhashes = 1;
+    else if (_nhashes > 16)
+      _nhashes = 16;
+    _bits = std::string((_nbits + 7) / 8,'\0');
+  }
+
+  udb_summary::udb_summary()
+    :_nhashes(0),_nbits(0),_nkeys(0)
+  {
+  }
+
+  udb_summary::~udb_summary()
+  {
+  }
+
+  void udb_summary::hash_key(const std::string &key, uint64_t &h1, uint64_t &h2) const
+  {
+    // 64-bit FNV-1a, whose halves seed the bit positions of the key.
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i=0; i<key.size(); i++)
+      {
+        h ^= static_cast<unsigned char>(key[i]);
+        h *= 1099511628211ULL;
+      }
+    h1 = h & 0xffffffffULL;
+    h2 = (h >> 32) | 1;
+  }
+
+  void udb_summary::add(const std::string &key)
+  {
+    uint64_t h1,h2;
+    hash_key(key,h1,h2);
+    for (uint32_t i=0; i<_nhashes; i++)
+      {
+        uint64_t b = (h1 + i * h2) % _nbits;
+        _bits[b >> 3] |= static_cast<char>(1 << (b & 7));
+      }
+    _nkeys++;
+  }
+
+  bool udb_summary::may_contain(const std::string &key) const
+  {
+    if (_nbits == 0)
+      return true; // no summary.
+    uint64_t h1,h2;
+    hash_key(key,h1,h2);
+    for (uint32_t i=0; i<_nhashes; i++)
+      {
+        uint64_t b = (h1 + i * h2) % _nbits;
+        if (!(_bits[b >> 3] & (1 << (b & 7))))
+          return false;
+      }
+    return true;
+  }
+
+  bool udb_summary::may_contain_any(const std::vector<std::string> &keys) const
+  {
+    for (size_t i=0; i<keys.size(); i++)
+      if (may_contain(keys.at(i)))
+        return true;
+    return false;
+  }
+
+  void udb_summary::serialize(std::string &msg) const throw (sp_exception)
+  {
+    bloom_summary bs;
+    bs.set_nhashes(_nhashes);
+    bs.set_nbits(_nbits);
+    bs.set_bits(_bits);
+    bs.set_nkeys(_nkeys);
+    if (!bs.SerializeToString(&msg))
+      {
+        std::string msg = "failed to serialize user db summary";
+        errlog::log_error(LOG_LEVEL_ERROR,msg.c_str());
+        throw sp_exception(UDBS_ERR_SERIALIZE,msg);
+      }
+  }
+
+  void udb_summary::deserialize(const std::string &msg) throw (sp_exception)
+  {
+    bloom_summary bs;
+    if (!bs.ParseFromString(msg)
+        || bs.nhashes() == 0 || bs.nbits() == 0
+        || bs.bits().size() != (bs.nbits() + 7) / 8)
+      {
+        std::string msg = "failed deserializing user db summary";
+        errlog::log_error(LOG_LEVEL_ERROR,msg.c_str());
+        throw sp_exception(UDBS_ERR_DESERIALIZE,msg);
+      }
+    _nhashes = bs.nhashes();
+    _nbits = bs.nbits();
+    _bits = bs.bits();
+    _nkeys = bs.nkeys();
+  }
+
+  udb_summary* udb_summary::build(user_db *udb, const std::string &plugin_name,
+                                  const double &fp_rate)
+  {
+    // keys only, in a walk that is serialized with the others on the db.
+    std::vector<std::string> rkeys;
+    if (udb->find_keys(plugin_name,rkeys) != SP_ERR_OK)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"failed iterating user db for building its summary");
+        return NULL;
+      }
+    udb_summary *us = new udb_summary(rkeys.size(),fp_rate);
+    for (size_t i=0; i<rkeys.size(); i++)
+      us->add(user_db::extract_key(rkeys.at(i)));
+    return us;
+  }
+
+} /* end of namespace. */
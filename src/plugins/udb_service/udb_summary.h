@@ -0,0 +1,82 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2011 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UDB_SUMMARY_H
+#define UDB_SUMMARY_H
+
+#include "sp_exception.h"
+#include "user_db.h"
+
+#include <string>
+#include <vector>
+
+using sp::user_db;
+
+namespace seeks_plugins
+{
+
+  /**
+   * \brief Bloom filter over the keys of the records of a user db, so that
+   *        peers can tell beforehand whether a node may have records for
+   *        a set of keys. A key that was added is always found, a key that
+   *        was not is found with a probability close to the false positive
+   *        rate the summary was sized for.
+   */
+  class udb_summary
+  {
+    public:
+      /**
+       * \brief empty summary, sized for nkeys keys with false positive rate fp_rate.
+       */
+      udb_summary(const uint64_t &nkeys, const double &fp_rate);
+
+      udb_summary();
+
+      ~udb_summary();
+
+      void add(const std::string &key);
+
+      bool may_contain(const std::string &key) const;
+
+      /**
+       * \brief whether at least one of the keys may be in the summary.
+       */
+      bool may_contain_any(const std::vector<std::string> &keys) const;
+
+      void serialize(std::string &msg) const throw (sp_exception);
+
+      void deserialize(const std::string &msg) throw (sp_exception);
+
+      /**
+       * \brief summary of the keys of the records of plugin plugin_name in udb.
+       */
+      static udb_summary* build(user_db *udb, const std::string &plugin_name,
+                                const double &fp_rate);
+
+      uint32_t _nhashes; /**< number of bits per key. */
+      uint64_t _nbits; /**< size of the filter. */
+      uint64_t _nkeys; /**< number of keys added. */
+      std::string _bits;
+
+    private:
+      void hash_key(const std::string &key, uint64_t &h1, uint64_t &h2) const;
+  };
+
+} /* end of namespace. */
+
+#endif
@@ -20,12 +20,20 @@
 #include <gtest/gtest.h>
 
 #include "uri_capture.h"
+#include "title_resolver.h"
 #include "db_uri_record.h"
 #include "user_db.h"
 #include "seeks_proxy.h"
 #include "plugin_manager.h"
 #include "proxy_configuration.h"
 #include "errlog.h"
+#include "mutexes.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
 
 using namespace seeks_plugins;
 using namespace sp;
@@ -205,6 +213,164 @@ TEST(URIAPITest,parse_uri_html_title)
   delete[] outputs;
 }
 
+/*
+ * local HTTP server that serves:
+ * - /slow: a title, then the rest of the page after 3 seconds,
+ * - /missing: a 404 page,
+ * - /big: a page with no title,
+ * - /p<n>: a title, after 100 milliseconds.
+ */
+class http_stub
+{
+  public:
+    http_stub()
+      :_port(0),_requests(0),_active(0),_max_active(0)
+    {
+      mutex_init(&_mutex);
+      _sfd = socket(AF_INET,SOCK_STREAM,0);
+      int on = 1;
+      setsockopt(_sfd,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+      struct sockaddr_in addr;
+      memset(&addr,0,sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+      addr.sin_port = 0;
+      bind(_sfd,(struct sockaddr*)&addr,sizeof(addr));
+      socklen_t len = sizeof(addr);
+      getsockname(_sfd,(struct sockaddr*)&addr,&len);
+      _port = ntohs(addr.sin_port);
+      listen(_sfd,32);
+      pthread_create(&_thread,NULL,&http_stub::run,this);
+    }
+
+    ~http_stub()
+    {
+      shutdown(_sfd,SHUT_RDWR);
+      close(_sfd);
+      pthread_join(_thread,NULL);
+    }
+
+    std::string url(const std::string &path) const
+    {
+      return "http://127.0.0.1:" + miscutil::to_string(_port) + path;
+    }
+
+    static void* run(void *arg)
+    {
+      http_stub *hs = static_cast<http_stub*>(arg);
+      while (true)
+        {
+          int cfd = accept(hs->_sfd,NULL,NULL);
+          if (cfd < 0)
+            break;
+          std::pair<http_stub*,int> *conn = new std::pair<http_stub*,int>(hs,cfd);
+          pthread_t t;
+          pthread_create(&t,NULL,&http_stub::serve,conn);
+          pthread_detach(t);
+        }
+      return NULL;
+    }
+
+    static void* serve(void *arg)
+    {
+      std::pair<http_stub*,int> *conn = static_cast<std::pair<http_stub*,int>*>(arg);
+      http_stub *hs = conn->first;
+      int cfd = conn->second;
+      delete conn;
+
+      std::string req;
+      char buf[1024];
+      ssize_t n = 0;
+      while (req.find("\r\n\r\n") == std::string::npos
+             && (n = recv(cfd,buf,sizeof(buf),0)) > 0)
+        req.append(buf,n);
+      std::string path = req.substr(4,req.find(' ',4)-4);
+
+      mutex_lock(&hs->_mutex);
+      hs->_requests++;
+      mutex_unlock(&hs->_mutex);
+
+      std::string ok = "HTTP/1.0 200 OK\r\nContent-Type: text/html\r\n\r\n";
+      if (path == "/slow")
+        {
+          http_stub::write_str(cfd,ok + "<html><head><title>Slow Page</title></head>");
+          sleep(3);
+          http_stub::write_str(cfd,"<body></body></html>");
+        }
+      else if (path == "/missing")
+        http_stub::write_str(cfd,"HTTP/1.0 404 Not Found\r\n\r\n<html><head><title>404 Not Found</title></head></html>");
+      else if (path == "/big")
+        http_stub::write_str(cfd,ok + "<html><body>" + std::string(200000,'a') + "</body></html>");
+      else
+        {
+          mutex_lock(&hs->_mutex);
+          hs->_active++;
+          if (hs->_active > hs->_max_active)
+            hs->_max_active = hs->_active;
+          mutex_unlock(&hs->_mutex);
+          usleep(100000);
+          mutex_lock(&hs->_mutex);
+          hs->_active--;
+          mutex_unlock(&hs->_mutex);
+          http_stub::write_str(cfd,ok + "<html><head><title>Page " + path.substr(2) + "</title></head></html>");
+        }
+      close(cfd);
+      return NULL;
+    }
+
+    static void write_str(int cfd, const std::string &str)
+    {
+      send(cfd,str.c_str(),str.size(),MSG_NOSIGNAL);
+    }
+
+    int _sfd;
+    int _port;
+    pthread_t _thread;
+    sp_mutex_t _mutex;
+    int _requests;
+    int _active;
+    int _max_active;
+};
+
+TEST(URIAPITest,title_resolver)
+{
+  http_stub hs;
+  title_resolver tr(10,16,2,4096);
+  std::vector<std::string> turis;
+  turis.push_back(hs.url("/slow"));
+  turis.push_back(hs.url("/missing"));
+  turis.push_back(hs.url("/big"));
+  for (int i=1; i<=4; i++)
+    turis.push_back(hs.url("/p" + miscutil::to_string(i)));
+  turis.push_back(hs.url("/p1"));
+  std::vector<std::string> titles;
+  time_t start = time(NULL);
+  size_t fetched = tr.resolve(turis,titles);
+  ASSERT_TRUE(time(NULL) - start < 3); // transfers stop after the title.
+  ASSERT_EQ(7,fetched);
+  ASSERT_EQ(turis.size(),titles.size());
+  ASSERT_EQ("Slow Page",titles.at(0));
+  ASSERT_EQ("404",titles.at(1));
+  ASSERT_TRUE(titles.at(2).empty());
+  ASSERT_EQ("Page 1",titles.at(3));
+  ASSERT_EQ("Page 4",titles.at(6));
+  ASSERT_EQ("Page 1",titles.at(7));
+  ASSERT_EQ(7,hs._requests);
+  ASSERT_TRUE(hs._max_active <= 2); // per host limit.
+
+  // from the cache.
+  std::vector<std::string> curis;
+  curis.push_back(hs.url("/p2"));
+  curis.push_back(hs.url("/missing"));
+  titles.clear();
+  fetched = tr.resolve(curis,titles);
+  ASSERT_EQ(0,fetched);
+  ASSERT_EQ("Page 2",titles.at(0));
+  ASSERT_EQ("404",titles.at(1));
+  ASSERT_EQ(7,hs._requests);
+  ASSERT_EQ(2,tr._hits);
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
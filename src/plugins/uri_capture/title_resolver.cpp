@@ -0,0 +1,165 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "title_resolver.h"
+#include "uri_capture.h"
+#include "curl_mget.h"
+#include "mem_utils.h"
+#include "errlog.h"
+
+#include <string.h>
+
+using sp::curl_mget;
+using sp::errlog;
+
+namespace seeks_plugins
+{
+
+  title_resolver::title_resolver(const long &timeout,
+                                 const int &max_parallel,
+                                 const int &max_per_host,
+                                 const size_t &max_bytes,
+                                 const size_t &max_cached)
+    :_timeout(timeout),_max_parallel(max_parallel),_max_per_host(max_per_host),
+     _max_bytes(max_bytes),_max_cached(max_cached),_hits(0),_fetched(0)
+  {
+    mutex_init(&_mutex);
+  }
+
+  title_resolver::~title_resolver()
+  {
+    clear();
+    mutex_destroy(&_mutex);
+  }
+
+  size_t title_resolver::resolve(const std::vector<std::string> &uris,
+                                 std::vector<std::string> &titles,
+                                 const std::list<const char*> *headers)
+  {
+    titles.clear();
+    titles.resize(uris.size());
+
+    // uris that are neither cached nor already asked for.
+    std::vector<std::string> to_fetch;
+    std::vector<std::vector<size_t> > positions;
+    hash_map<const char*,size_t,hash<const char*>,eqstr> pending;
+    for (size_t i=0; i<uris.size(); i++)
+      {
+        if (find(uris.at(i),titles.at(i)))
+          continue;
+        hash_map<const char*,size_t,hash<const char*>,eqstr>::const_iterator hit;
+        if ((hit=pending.find(uris.at(i).c_str()))!=pending.end())
+          positions.at((*hit).second).push_back(i);
+        else
+          {
+            pending.insert(std::pair<const char*,size_t>(uris.at(i).c_str(),to_fetch.size()));
+            to_fetch.push_back(uris.at(i));
+            positions.push_back(std::vector<size_t>(1,i));
+          }
+      }
+    if (to_fetch.empty())
+      return 0;
+
+    curl_mget cmg(to_fetch.size(),_timeout,0,_timeout,0);
+    cmg._max_parallel = _max_parallel;
+    cmg._max_per_host = _max_per_host;
+    cmg._max_bytes = _max_bytes;
+    cmg._stop_pattern = "</title>";
+    std::vector<std::list<const char*>*> vheaders;
+    if (headers)
+      vheaders.resize(to_fetch.size(),const_cast<std::list<const char*>*>(headers));
+    std::vector<int> status;
+    cmg.www_mget(to_fetch,to_fetch.size(),headers ? &vheaders : NULL,"",0,status);
+
+    std::vector<std::string> ftitles;
+    uri_capture::parse_uri_html_title(to_fetch,ftitles,cmg._outputs);
+    delete[] cmg._outputs;
+
+    for (size_t i=0; i<to_fetch.size(); i++)
+      {
+        add(to_fetch.at(i),ftitles.at(i));
+        for (size_t j=0; j<positions.at(i).size(); j++)
+          titles.at(positions.at(i).at(j)) = ftitles.at(i);
+      }
+    mutex_lock(&_mutex);
+    _fetched += to_fetch.size();
+    mutex_unlock(&_mutex);
+    return to_fetch.size();
+  }
+
+  bool title_resolver::find(const std::string &uri, std::string &title)
+  {
+    mutex_lock(&_mutex);
+    hash_map<const char*,std::string,hash<const char*>,eqstr>::const_iterator hit;
+    if ((hit=_titles.find(uri.c_str()))!=_titles.end())
+      {
+        title = (*hit).second;
+        _hits++;
+        mutex_unlock(&_mutex);
+        return true;
+      }
+    mutex_unlock(&_mutex);
+    return false;
+  }
+
+  void title_resolver::add(const std::string &uri, const std::string &title)
+  {
+    mutex_lock(&_mutex);
+    hash_map<const char*,std::string,hash<const char*>,eqstr>::iterator hit;
+    if ((hit=_titles.find(uri.c_str()))!=_titles.end())
+      (*hit).second = title;
+    else
+      {
+        // a full cache is started over, titles are cheap to fetch again.
+        if (_titles.size() >= _max_cached)
+          clear_locked();
+        _titles.insert(std::pair<const char*,std::string>(strdup(uri.c_str()),title));
+      }
+    mutex_unlock(&_mutex);
+  }
+
+  size_t title_resolver::size()
+  {
+    mutex_lock(&_mutex);
+    size_t s = _titles.size();
+    mutex_unlock(&_mutex);
+    return s;
+  }
+
+  void title_resolver::clear()
+  {
+    mutex_lock(&_mutex);
+    clear_locked();
+    mutex_unlock(&_mutex);
+  }
+
+  void title_resolver::clear_locked()
+  {
+    hash_map<const char*,std::string,hash<const char*>,eqstr>::iterator hit,hit2;
+    hit = _titles.begin();
+    while (hit!=_titles.end())
+      {
+        hit2 = hit;
+        ++hit;
+        const char *key = (*hit2).first;
+        _titles.erase(hit2);
+        free_const(key);
+      }
+  }
+
+} /* end of namespace. */
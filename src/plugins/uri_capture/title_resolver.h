@@ -0,0 +1,104 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TITLE_RESOLVER_H
+#define TITLE_RESOLVER_H
+
+#include "stl_hash.h"
+#include "mutexes.h"
+
+#include <string>
+#include <vector>
+#include <list>
+
+#define TITLE_RESOLVER_PARALLEL 16 /**< transfers at once. */
+#define TITLE_RESOLVER_PER_HOST 2 /**< transfers at once to the same host. */
+#define TITLE_RESOLVER_MAX_BYTES 65536 /**< bytes read from a page before giving up on its title. */
+#define TITLE_RESOLVER_MAX_CACHED 100000 /**< titles kept in cache. */
+
+namespace seeks_plugins
+{
+
+  /**
+   * \brief resolves the HTML titles of many URIs at once.
+   *
+   *        Pages are fetched concurrently, with a bound on the number of
+   *        transfers overall and to the same host, and every transfer is
+   *        stopped as soon as the end of the title, or a byte limit, is
+   *        reached. Titles are cached, so that a URI shared by several
+   *        records is fetched only once.
+   */
+  class title_resolver
+  {
+    public:
+      /**
+       * @param timeout connection and transfer timeout, in seconds.
+       */
+      title_resolver(const long &timeout,
+                     const int &max_parallel=TITLE_RESOLVER_PARALLEL,
+                     const int &max_per_host=TITLE_RESOLVER_PER_HOST,
+                     const size_t &max_bytes=TITLE_RESOLVER_MAX_BYTES,
+                     const size_t &max_cached=TITLE_RESOLVER_MAX_CACHED);
+
+      ~title_resolver();
+
+      /**
+       * \brief fills up titles, in the order of uris, from the cache or by
+       *        fetching the pages. Titles are empty on failure, and "404"
+       *        for pages that were not found.
+       * @param headers HTTP headers sent along every request, if not NULL.
+       * @return the number of pages that were fetched.
+       */
+      size_t resolve(const std::vector<std::string> &uris,
+                     std::vector<std::string> &titles,
+                     const std::list<const char*> *headers=NULL);
+
+      /**
+       * \brief looks up the title of a uri in the cache.
+       */
+      bool find(const std::string &uri, std::string &title);
+
+      void add(const std::string &uri, const std::string &title);
+
+      size_t size();
+
+    private:
+      void clear();
+
+      /**
+       * \brief empties the cache, with _mutex held.
+       */
+      void clear_locked();
+
+    public:
+      long _timeout;
+      int _max_parallel;
+      int _max_per_host;
+      size_t _max_bytes;
+      size_t _max_cached;
+      unsigned long _hits; /**< titles found in the cache. */
+      unsigned long _fetched; /**< pages fetched. */
+
+    private:
+      hash_map<const char*,std::string,hash<const char*>,eqstr> _titles;
+      sp_mutex_t _mutex;
+  };
+
+} /* end of namespace. */
+
+#endif
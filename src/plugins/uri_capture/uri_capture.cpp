@@ -18,6 +18,7 @@
 
 #include "uri_capture.h"
 #include "uc_configuration.h"
+#include "title_resolver.h"
 #include "db_uri_record.h"
 #include "seeks_proxy.h" // for user_db.
 #include "proxy_configuration.h"
@@ -51,7 +52,7 @@ namespace seeks_plugins
 
   /*- uri_db_sweepable -*/
   uri_db_sweepable::uri_db_sweepable()
-    :user_db_sweepable()
+    :user_db_sweepable(),_job(NULL)
   {
     // set last sweep to now.
     // sweeping is done when plugin starts.
@@ -62,6 +63,7 @@ namespace seeks_plugins
 
   uri_db_sweepable::~uri_db_sweepable()
   {
+    delete _job; // cancels a running job.
   }
 
   bool uri_db_sweepable::sweep_me()
@@ -78,13 +80,39 @@ namespace seeks_plugins
   }
 
   int uri_db_sweepable::sweep_records()
+  {
+    if (uc_configuration::_config->_retention <= 0)
+      return SP_ERR_OK;
+    if (_job)
+      {
+        if (!_job->done())
+          return SP_ERR_OK; // previous sweep is still running.
+        delete _job;
+      }
+    struct timeval tv_now;
+    gettimeofday(&tv_now,NULL);
+    time_t sweep_date = tv_now.tv_sec - uc_configuration::_config->_retention;
+    _job = new user_db_maintenance(seeks_proxy::_user_db,"uri-capture",sweep_date);
+    _job->set_limits_from_config();
+    sp_err err = _job->start();
+    if (err != SP_ERR_OK)
+      {
+        delete _job;
+        _job = NULL;
+      }
+    return err;
+  }
+
+  int uri_db_sweepable::prune_records()
   {
     struct timeval tv_now;
     gettimeofday(&tv_now,NULL);
     if (uc_configuration::_config->_retention > 0)
       {
         time_t sweep_date = tv_now.tv_sec - uc_configuration::_config->_retention;
-        return seeks_proxy::_user_db->prune_db("uri-capture",sweep_date);
+        user_db_maintenance udm(seeks_proxy::_user_db,"uri-capture",sweep_date);
+        udm.set_limits_from_config();
+        return udm.run();
       }
     return SP_ERR_OK;
   }
@@ -134,7 +162,7 @@ namespace seeks_plugins
     else if (seeks_proxy::_config->_user_db_startup_check)
       {
         // preventive sweep of records.
-        static_cast<uri_capture_element*>(_interceptor_plugin)->_uds.sweep_records();
+        static_cast<uri_capture_element*>(_interceptor_plugin)->_uds.prune_records();
       }
 
     // get number of captured URI already in user_db.
@@ -163,6 +191,8 @@ namespace seeks_plugins
       const std::vector<std::list<const char*>*> *headers)
   {
     curl_mget cmg(uris.size(),timeout,0,timeout,0);
+    cmg._max_bytes = TITLE_RESOLVER_MAX_BYTES;
+    cmg._stop_pattern = "</title>"; // the rest of the page is not needed.
     std::vector<int> status;
     cmg.www_mget(uris,uris.size(),headers,"",0,status);
 
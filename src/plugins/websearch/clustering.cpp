@@ -43,20 +43,20 @@ namespace seeks_plugins
   }
 
   void cluster::add_point(const uint32_t &id,
-                          hash_map<uint32_t,float,id_hash_uint> *p)
+                          sparse_vector *p)
   {
-    hash_map<uint32_t,hash_map<uint32_t,float,id_hash_uint>*,id_hash_uint>::iterator hit;
+    hash_map<uint32_t,sparse_vector*,id_hash_uint>::iterator hit;
     if ((hit=_cpoints.find(id))!=_cpoints.end())
       {
         errlog::log_error(LOG_LEVEL_ERROR, "Trying to add a snippet multiple times to the same cluster");
       }
-    else _cpoints.insert(std::pair<uint32_t,hash_map<uint32_t,float,id_hash_uint>*>(id,p));
+    else _cpoints.insert(std::pair<uint32_t,sparse_vector*>(id,p));
   }
 
   void cluster::compute_rank(const query_context *qc)
   {
     _rank = 0.0;
-    hash_map<uint32_t,hash_map<uint32_t,float,id_hash_uint>*,id_hash_uint>::const_iterator hit
+    hash_map<uint32_t,sparse_vector*,id_hash_uint>::const_iterator hit
     = _cpoints.begin();
     while (hit!=_cpoints.end())
       {
@@ -69,33 +69,19 @@ namespace seeks_plugins
   void cluster::compute_label(const query_context *qc)
   {
     // compute total tf-idf weight for features of docs belonging to this cluster.
-    hash_map<uint32_t,float,id_hash_uint> f_totals;
-    hash_map<uint32_t,float,id_hash_uint>::iterator fhit,hit2;
-    hash_map<uint32_t,hash_map<uint32_t,float,id_hash_uint>*,id_hash_uint>::const_iterator hit
+    sparse_vector f_totals;
+    hash_map<uint32_t,sparse_vector*,id_hash_uint>::const_iterator hit
     = _cpoints.begin();
     while (hit!=_cpoints.end())
       {
-        hit2 = (*hit).second->begin();
-        while (hit2!=(*hit).second->end())
-          {
-            if ((fhit=f_totals.find((*hit2).first))!=f_totals.end())
-              {
-                (*fhit).second += (*hit2).second;
-              }
-            else f_totals.insert(std::pair<uint32_t,float>((*hit2).first,(*hit2).second));
-            ++hit2;
-          }
+        f_totals.add(*(*hit).second);
         ++hit;
       }
 
     // grab features with the highest tf-idf weight.
     std::map<float,uint32_t,std::greater<float> > f_mtotals;
-    fhit = f_totals.begin();
-    while (fhit!=f_totals.end())
-      {
-        f_mtotals.insert(std::pair<float,uint32_t>((*fhit).second,(*fhit).first));
-        ++fhit;
-      }
+    for (size_t f=0; f<f_totals.size(); f++)
+      f_mtotals.insert(std::pair<float,uint32_t>(f_totals._weights[f],f_totals._ids[f]));
     f_totals.clear();
 
     // we need query words and a stopword list for rejecting labels.
@@ -186,7 +172,7 @@ namespace seeks_plugins
       {
         search_snippet *sp = _snippets.at(s);
         if (sp->_features_tfidf)
-          _points.insert(std::pair<uint32_t,hash_map<uint32_t,float,id_hash_uint>*>(sp->_id,sp->_features_tfidf));
+          _points.insert(std::pair<uint32_t,sparse_vector*>(sp->_id,sp->_features_tfidf));
       }
   }
 
@@ -216,7 +202,7 @@ namespace seeks_plugins
   // default ranking is as computed by seeks on the main list of results.
   void clustering::rank_elements(cluster &cl)
   {
-    hash_map<uint32_t,hash_map<uint32_t,float,id_hash_uint>*,id_hash_uint>::iterator hit
+    hash_map<uint32_t,sparse_vector*,id_hash_uint>::iterator hit
     = cl._cpoints.begin();
     while (hit!=cl._cpoints.end())
       {
@@ -244,10 +230,10 @@ namespace seeks_plugins
       _clusters[c].compute_label(_qc);
   }
 
-  hash_map<uint32_t,float,id_hash_uint>* clustering::get_point_features(const short &np)
+  sparse_vector* clustering::get_point_features(const short &np)
   {
     short p = 0;
-    hash_map<uint32_t,hash_map<uint32_t,float,id_hash_uint>*,id_hash_uint>::const_iterator hit
+    hash_map<uint32_t,sparse_vector*,id_hash_uint>::const_iterator hit
     = _points.begin();
     while (hit!=_points.end())
       {
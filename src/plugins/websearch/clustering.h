@@ -22,6 +22,9 @@
 #include "stl_hash.h"
 #include "search_snippet.h"
 #include "query_context.h"
+#include "sparse_vector.h"
+
+using lsh::sparse_vector;
 
 namespace seeks_plugins
 {
@@ -38,7 +41,7 @@ namespace seeks_plugins
         _features.clear();
       };
 
-      hash_map<uint32_t,float,id_hash_uint> _features;
+      sparse_vector _features;
   };
 
   class cluster
@@ -70,14 +73,14 @@ namespace seeks_plugins
       }
 
       void add_point(const uint32_t &id,
-                     hash_map<uint32_t,float,id_hash_uint> *p);
+                     sparse_vector *p);
 
       void compute_rank(const query_context *qc);
 
       void compute_label(const query_context *qc);
 
       centroid _c; /**< cluster's centroid. */
-      hash_map<uint32_t,hash_map<uint32_t,float,id_hash_uint>*,id_hash_uint> _cpoints; /**< points associated to this cluster. */
+      hash_map<uint32_t,sparse_vector*,id_hash_uint> _cpoints; /**< points associated to this cluster. */
       double _rank; /**< cluster's rank among clusters. */
       std::string _label; /**< cluster's label. */
   };
@@ -108,12 +111,12 @@ namespace seeks_plugins
       void compute_cluster_labels();
 
     protected:
-      hash_map<uint32_t,float,id_hash_uint>* get_point_features(const short &np);
+      sparse_vector* get_point_features(const short &np);
 
     public:
       query_context *_qc;
 
-      hash_map<uint32_t,hash_map<uint32_t,float,id_hash_uint>*,id_hash_uint> _points; /**< key is the snippet's id. */
+      hash_map<uint32_t,sparse_vector*,id_hash_uint> _points; /**< key is the snippet's id. */
 
       short _K; /**< number of clusters. */
 
@@ -28,6 +28,7 @@
 #include "encode.h"
 #include "miscutil.h"
 #include "errlog.h"
+#include "thread_pool.h"
 
 #include <pthread.h>
 #include <iostream>
@@ -41,6 +42,11 @@ using sp::seeks_proxy;
 using sp::proxy_configuration;
 using sp::encode;
 using sp::errlog;
+using sp::thread_pool;
+using sp::task_group;
+using lsh::minhash;
+using lsh::minhash_signature;
+using lsh::sparse_vector;
 
 namespace seeks_plugins
 {
@@ -124,7 +130,8 @@ namespace seeks_plugins
         std::string *str = new std::string(dec_sum);
         txt_contents.push_back(str);
       }
-    content_handler::extract_tfidf_features_from_snippets(qc,txt_contents,qc->_cached_snippets);
+    content_handler::extract_tfidf_features_from_snippets(qc,qc->_summary_features,
+        txt_contents,qc->_cached_snippets);
     for (size_t i=0; i<nsnippets; i++)
       if (txt_contents.at(i))
         delete txt_contents.at(i);
@@ -178,7 +185,8 @@ namespace seeks_plugins
           valid_contents.push_back(&txt_contents[i]);
           sps.push_back(snippets.at(i));
         }
-    content_handler::extract_tfidf_features_from_snippets(qc,valid_contents,sps);
+    content_handler::extract_tfidf_features_from_snippets(qc,qc->_content_features,
+        valid_contents,sps);
     delete[] txt_contents;
   }
 
@@ -187,12 +195,13 @@ namespace seeks_plugins
   {
     std::string *txt_outputs = new std::string[ncontents];
 
-    pthread_t parser_threads[ncontents];
+    task_group parser_tasks(thread_pool::shared());
     html_txt_thread_arg* parser_args[ncontents];
 
-    // threads, one per parser.
+    // tasks, one per parser.
     for (size_t i=0; i<ncontents; i++)
       {
+        parser_args[i] = NULL;
         if (outputs[i])
           {
             html_txt_thread_arg *args = new html_txt_thread_arg();
@@ -200,44 +209,20 @@ namespace seeks_plugins
             if (!args->_output) // security check.
               {
                 delete args;
-                parser_threads[i] = 0;
-                parser_args[i] = NULL;
                 continue;
               }
 
             parser_args[i] = args;
-
-            pthread_t ps_thread;
-            int err = pthread_create(&ps_thread,NULL, // default attribute is PTHREAD_CREATE_JOINABLE
-                                     (void * (*)(void *))content_handler::parse_output, args);
-            if (err != 0)
-              {
-                errlog::log_error(LOG_LEVEL_ERROR, "Error creating parser thread.");
-                parser_threads[i] = 0;
-                delete args;
-                parser_args[i] = NULL;
-                continue;
-              }
-
-            parser_threads[i] = ps_thread;
-          }
-        else
-          {
-            parser_threads[i] = 0;
-            parser_args[i] = NULL;
+            parser_tasks.run((void * (*)(void *))content_handler::parse_output, args);
           }
       }
 
-    // join threads.
-    for (size_t i=0; i<ncontents; i++)
-      {
-        if (parser_threads[i] != 0)
-          pthread_join(parser_threads[i],NULL);
-      }
+    // join tasks.
+    parser_tasks.wait();
 
     for (size_t i=0; i<ncontents; i++)
       {
-        if (parser_threads[i] != 0)
+        if (parser_args[i])
           {
             // debug: should go elsewhere, and be done more efficiently.
             miscutil::replace_in_string(parser_args[i]->_txt_content,"\t"," ");
@@ -266,96 +251,64 @@ namespace seeks_plugins
   }
 
   void content_handler::extract_tfidf_features_from_snippets(query_context *qc,
+      lsh::tfidf_index &features,
       const std::vector<std::string*> &txt_contents,
       const std::vector<search_snippet*> &sps)
   {
     size_t ncontents = txt_contents.size();
-    pthread_t feature_threads[ncontents];
+    task_group feature_tasks(thread_pool::shared());
     feature_tfidf_thread_arg* feature_args[ncontents];
+    uint32_t stamps[ncontents];
 
-    // XXX: limit to the number of threads.
     for  (size_t i=0; i<ncontents; i++)
       {
-        hash_map<uint32_t,float,id_hash_uint> *vf = NULL;
-        hash_map<uint32_t,std::string,id_hash_uint> *bow = NULL;
-        try
-          {
-            vf = sps[i]->_features_tfidf;
-            bow = sps[i]->_bag_of_words;
-          }
-        catch (std::out_of_range &oor)
-          {
-            break;
-          }
-
-        if (vf)
-          {
-            delete sps[i]->_features_tfidf;
-            sps[i]->_features_tfidf = NULL;
-            if (sps[i]->_bag_of_words)
-              {
-                delete sps[i]->_bag_of_words;
-                sps[i]->_bag_of_words = NULL;
-              }
-            vf = NULL;
-          }
-
-        if (!vf)
-          {
-            vf = new hash_map<uint32_t,float,id_hash_uint>();
-            bow = new hash_map<uint32_t,std::string,id_hash_uint>();
-            feature_tfidf_thread_arg *args = new feature_tfidf_thread_arg(txt_contents[i],vf,
-                bow,qc->_auto_lang);
-            feature_args[i] = args;
-
-            pthread_t f_thread;
-            int err = pthread_create(&f_thread,NULL, // default attribute is PTHREAD_CREATE_JOINABLE
-                                     (void*(*)(void*))content_handler::generate_features_tfidf,args);
-            if (err != 0)
-              {
-                errlog::log_error(LOG_LEVEL_ERROR, "Error creating feature generator thread.");
-                feature_threads[i] = 0;
-                delete vf;
-                delete bow;
-                delete args;
-                feature_args[i] = NULL;
-                continue;
-              }
-            feature_threads[i] = f_thread;
-          }
-        else
-          {
-            feature_threads[i] = 0;
-            feature_args[i] = NULL;
-          }
+        feature_args[i] = NULL;
+
+        // only snippets whose text is not yet indexed are tokenized, and those
+        // whose bag of words comes from the other index.
+        stamps[i] = mrf::mrf_hash(*txt_contents[i]);
+        if (features.has(sps[i]->_id,stamps[i])
+            && sps[i]->_features_tfidf_index == &features)
+          continue;
+        features.remove(sps[i]->_id); // text has changed, if indexed.
+
+        hash_map<uint32_t,float,id_hash_uint> *vf = new hash_map<uint32_t,float,id_hash_uint>();
+        hash_map<uint32_t,std::string,id_hash_uint> *bow = new hash_map<uint32_t,std::string,id_hash_uint>();
+        feature_tfidf_thread_arg *args = new feature_tfidf_thread_arg(txt_contents[i],vf,
+            bow,qc->_auto_lang);
+        feature_args[i] = args;
+        feature_tasks.run((void*(*)(void*))content_handler::generate_features_tfidf,args);
       }
 
-    // join threads.
-    std::vector<hash_map<uint32_t,float,id_hash_uint>*> bags;
-    bags.reserve(ncontents);
+    // join tasks, and add the new snippets to the document frequencies.
+    feature_tasks.wait();
     for (size_t i=0; i<ncontents; i++)
       {
-        if (feature_threads[i] != 0)
+        if (feature_args[i])
           {
-            pthread_join(feature_threads[i],NULL);
-            bags.push_back(feature_args[i]->_vf);
+            features.add(sps[i]->_id,*feature_args[i]->_vf,stamps[i]);
+            delete feature_args[i]->_vf;
+            if (sps[i]->_bag_of_words)
+              delete sps[i]->_bag_of_words;
+            sps[i]->_bag_of_words = feature_args[i]->_bow; // cache words.
+            sps[i]->_features_tfidf_index = &features;
+            delete feature_args[i];
           }
       }
 
-    mrf::compute_tf_idf(bags);
-
-    for (size_t i=0; i<ncontents; i++)
+    // idf depends on the number of snippets, weights of the snippets whose
+    // features come from this index are refreshed from their cached frequencies.
+    // Snippets with features from the other index are left alone.
+    size_t nsnippets = qc->_cached_snippets.size();
+    for (size_t i=0; i<nsnippets; i++)
       {
-        if (feature_threads[i] != 0)
-          {
-            sps[i]->_features_tfidf = feature_args[i]->_vf; // cache features.
-            sps[i]->_bag_of_words = feature_args[i]->_bow; // cache words.
-            //std::cerr << "[Debug]: url: " << sps[i]->_url << " --> " << sps[i]->_features_tfidf->size() << " features.\n";
-            delete feature_args[i];
-          }
-        else
-          {
-          }
+        search_snippet *sp = qc->_cached_snippets.at(i);
+        if (sp->_features_tfidf_index != &features
+            || !features.has(sp->_id))
+          continue;
+        if (!sp->_features_tfidf)
+          sp->_features_tfidf = new sparse_vector();
+        features.weights(sp->_id,*sp->_features_tfidf); // cache features, as a sorted vector.
       }
     qc->_compute_tfidf_features = false;
   }
@@ -365,10 +318,11 @@ namespace seeks_plugins
       const std::vector<search_snippet*> &sps)
   {
     size_t ncontents = txt_contents.size();
-    pthread_t feature_threads[ncontents];
+    task_group feature_tasks(thread_pool::shared());
     feature_thread_arg* feature_args[ncontents];
+    for (size_t i=0; i<ncontents; i++)
+      feature_args[i] = NULL;
 
-    // XXX: limits the number of threads.
     for  (size_t i=0; i<ncontents; i++)
       {
         std::vector<uint32_t> *vf = NULL;
@@ -386,37 +340,16 @@ namespace seeks_plugins
             vf = new std::vector<uint32_t>();
             feature_thread_arg *args = new feature_thread_arg(txt_contents[i],vf);
             feature_args[i] = args;
-
-            pthread_t f_thread;
-            int err = pthread_create(&f_thread,NULL, // default attribute is PTHREAD_CREATE_JOINABLE
-                                     (void*(*)(void*))content_handler::generate_features,args);
-            if (err != 0)
-              {
-                errlog::log_error(LOG_LEVEL_ERROR, "Error creating feature generator thread.");
-                feature_threads[i] = 0;
-                delete args;
-                feature_args[i] = NULL;
-                continue;
-              }
-            feature_threads[i] = f_thread;
-          }
-        else
-          {
-            feature_threads[i] = 0;
-            feature_args[i] = NULL;
+            feature_tasks.run((void*(*)(void*))content_handler::generate_features,args);
           }
       }
 
-    // join threads.
-    for (size_t i=0; i<ncontents; i++)
-      {
-        if (feature_threads[i] != 0)
-          pthread_join(feature_threads[i],NULL);
-      }
+    // join tasks.
+    feature_tasks.wait();
 
     for (size_t i=0; i<ncontents; i++)
       {
-        if (feature_threads[i] != 0)
+        if (feature_args[i])
           {
             sps[i]->_features = feature_args[i]->_vf; // cache features.
             //std::cerr << "[Debug]: url: " << sps[i]->_url << " --> " << sps[i]->_features->size() << " features.\n";
@@ -462,7 +395,7 @@ namespace seeks_plugins
         throw sp_exception(WB_ERR_NO_REF_SIM,msg);
       }
     // reference features.
-    hash_map<uint32_t,float,id_hash_uint> *ref_features = ref_sp->_features_tfidf;
+    sparse_vector *ref_features = ref_sp->_features_tfidf;
     if (!ref_features) // sometimes the content wasn't fetched, and features are not there.
       {
         std::string msg = "No reference snippet features to compute similarity from";
@@ -482,150 +415,28 @@ namespace seeks_plugins
       }
   }
 
-  bool content_handler::has_same_content(query_context *qc,
-                                         search_snippet *sp1, search_snippet *sp2,
-                                         const double &similarity_threshold)
+  const minhash_signature& content_handler::snippet_fingerprint(search_snippet *sp)
   {
-    static std::string token_delims = " \t\n";
-
-    //TODO: referer.
-
-    // we may already have some content in cache, let's check to not fetch it more than once.
-    std::string url1 = sp1->_url;
-    std::string url2 = sp2->_url;
-    std::vector<std::string> urls;
-    urls.reserve(2);
-
-    bool parsing = true;
-    if (sp1->_doc_type == seeks_doc_type::TWEET && sp2->_doc_type == seeks_doc_type::TWEET)
-      parsing = false;
-    std::string *content1 = (sp1->_doc_type == seeks_doc_type::TWEET) ? &sp1->_title : sp1->_cached_content;
-    std::string *content2 = (sp2->_doc_type == seeks_doc_type::TWEET) ? &sp2->_title : sp2->_cached_content;
-
-    std::string **outputs = NULL;
-    if (!content1 && !content2)
-      {
-        urls.push_back(url1);
-        urls.push_back(url2);
-        outputs = content_handler::fetch_snippets_content(urls,false,qc); // no proxy.
-        if (outputs)
-          {
-            sp1->_cached_content = outputs[0];
-            sp2->_cached_content = outputs[1];
-          }
-      }
-    else if (!content1)
-      {
-        outputs = new std::string*[2];
-        urls.push_back(url1);
-        std::string **output1 = content_handler::fetch_snippets_content(urls,false,qc); // no proxy.
-
-        if (output1)
-          {
-            outputs[0] = *output1;
-            delete output1;
-            outputs[1] = content2;
-            urls.push_back(url2);
-            sp1->_cached_content = outputs[0];
-          }
-        else outputs[0] = NULL;
-      }
-    else if (!content2)
+    if (!sp->_fingerprint)
       {
-        outputs = new std::string*[2];
-        urls.push_back(url2);
-        std::string **output2 = content_handler::fetch_snippets_content(urls,false,qc); // no proxy.
-        outputs[0] = content1;
-        if (output2)
-          {
-            outputs[1] = *output2;
-            delete[] output2;
-            urls.push_back(url1);
-            sp2->_cached_content = outputs[1];
-          }
-        else outputs[1] = NULL;
-      }
-    else
-      {
-        outputs = new std::string*[2];
-        outputs[0] = content1;
-        outputs[1] = content2;
-      }
-
-    if (outputs == NULL
-        || outputs[0] == NULL || outputs[1] == NULL)  // error handling.
-      {
-        // cleanup the shell, existing content remains in cache in the snippets.
-        if (outputs)
-          delete[] outputs;
-        return false;
-      }
-
-    // parse content and keep text only.
-    std::string *txt_contents = NULL;
-    if (parsing)
-      {
-        txt_contents = content_handler::parse_snippets_txt_content(2,outputs);
-      }
-    else
-      {
-        txt_contents = new std::string[2];
-        txt_contents[0] = *outputs[0];
-        txt_contents[1] = *outputs[1];
-      }
-    delete[] outputs;
-    outputs = NULL;
-
-    if (txt_contents[0].empty() || txt_contents[1].empty())
-      {
-        delete[] txt_contents;
-        return false;
+        // tweets are their title.
+        std::string txt = sp->_title;
+        if (sp->_doc_type != seeks_doc_type::TWEET)
+          txt += " " + sp->_summary;
+        sp->_fingerprint = new minhash_signature();
+        minhash::signature(txt,mrf::_default_delims,*sp->_fingerprint,
+                           CONTENT_FINGERPRINT_MIN_WORDS);
       }
+    return *sp->_fingerprint;
+  }
 
-    // quick check for similarity.
-    double rad = static_cast<double>(std::min(txt_contents[0].size(),txt_contents[1].size()))
-                 / static_cast<double>(std::max(txt_contents[0].size(),txt_contents[1].size()));
-    if (rad < similarity_threshold)
-      {
-        delete[] txt_contents;
-        return false;
-      }
-
-    std::vector<search_snippet*> sps;
-    sps.reserve(2);
-    sps.push_back(sp1);
-    sps.push_back(sp2);
-    std::vector<std::string*> valid_content;
-    valid_content.reserve(2);
-    valid_content.push_back(&txt_contents[0]);
-    valid_content.push_back(&txt_contents[1]);
-    content_handler::extract_features_from_snippets(qc,valid_content,sps);
-    delete[] txt_contents;
-
-    // check for similarity.
-    uint32_t common_features = 0;
-    std::vector<uint32_t> *f1 = sp1->_features;
-    std::vector<uint32_t> *f2 = sp2->_features;
-    assert(f1!=NULL);
-    assert(f2!=NULL);
-
-    rad = mrf::radiance(*f1,*f2,common_features);
-    double threshold = (common_features*common_features)
-                       / ((1.0+similarity_threshold)*static_cast<double>(f1->size()+f2->size()-2*common_features)+mrf::_epsilon);
-    bool result = false;
-    if (rad >= threshold)
-      result = true;
-
-    // we don't need simple features anymore.
-    delete sp1->_features;
-    sp1->_features = NULL;
-    delete sp2->_features;
-    sp2->_features = NULL;
-
-    /* std::cerr << "Radiance: " << rad << " -- threshold: " << threshold << " -- result: " << result << std::endl;
-     std::cerr << "[Debug]: comparison result: " << result << std::endl; */
-
-    return result;
+  bool content_handler::has_same_content(query_context *qc,
+                                         search_snippet *sp1, search_snippet *sp2,
+                                         const double &similarity_threshold)
+  {
+    // empty signatures, i.e. short texts, have no similarity.
+    return content_handler::snippet_fingerprint(sp1).similarity(content_handler::snippet_fingerprint(sp2))
+           >= similarity_threshold;
   }
 
 } /* end of namespace. */
@@ -22,10 +22,22 @@
 #include "query_context.h"
 #include "search_snippet.h"
 #include "mrf.h"
+#include "minhash.h"
 
 #include <string>
 #include <stdint.h>
 
+/**
+ * Number of words below which snippets are too short to be
+ * compared by fingerprint.
+ */
+#define CONTENT_FINGERPRINT_MIN_WORDS 8
+
+/**
+ * Estimated similarity above which snippets are duplicates.
+ */
+#define CONTENT_FINGERPRINT_MIN_SIMILARITY 0.7
+
 using lsh::mrf;
 
 namespace seeks_plugins
@@ -120,7 +132,14 @@ namespace seeks_plugins
           const std::vector<std::string*> &txt_contents,
           const std::vector<search_snippet*> &sps);
 
+      /**
+       * \brief computes the tf-idf features of the snippets in the context.
+       *        Only the snippets whose text is not yet in the index of features
+       *        are tokenized, the weights of the others are recomputed from the
+       *        frequencies in the index.
+       */
       static void extract_tfidf_features_from_snippets(query_context *qc,
+          lsh::tfidf_index &features,
           const std::vector<std::string*> &txt_contents,
           const std::vector<search_snippet*> &sps);
 
@@ -129,6 +148,18 @@ namespace seeks_plugins
           search_snippet **sps,
           search_snippet *ref_sp) throw (sp_exception);
 
+      /**
+       * \brief MinHash signature of a snippet title and summary, computed
+       *        once and cached in the snippet. It is empty for snippets with
+       *        less than CONTENT_FINGERPRINT_MIN_WORDS words.
+       */
+      static const lsh::minhash_signature& snippet_fingerprint(search_snippet *sp);
+
+      /**
+       * \brief whether two snippets have near-identical text, i.e. signatures
+       *        whose estimated similarity is at least similarity_threshold.
+       *        No content is fetched.
+       */
       static bool has_same_content(query_context *qc,
                                    search_snippet *sp1, search_snippet *sp2,
                                    const double &similarity_threshold);
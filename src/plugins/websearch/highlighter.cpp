@@ -0,0 +1,194 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "highlighter.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <queue>
+#include <algorithm>
+
+namespace seeks_plugins
+{
+
+  highlighter::highlighter()
+    :_nclasses(1)
+  {
+    memset(_classes,0,sizeof(_classes));
+    compile();
+  }
+
+  highlighter::~highlighter()
+  {
+  }
+
+  bool highlighter::is_word_char(const unsigned char &c)
+  {
+    return c >= 0x80 || isalnum(c); // bytes of multibyte characters are parts of words.
+  }
+
+  void highlighter::add_term(const std::string &term,
+                             const std::string &prefix,
+                             const std::string &suffix)
+  {
+    if (term.empty())
+      return;
+    std::string lterm = term;
+    for (size_t i=0; i<lterm.length(); i++)
+      lterm[i] = tolower((unsigned char)lterm[i]);
+    for (size_t i=0; i<_terms.size(); i++)
+      if (_terms[i] == lterm)
+        return;
+    _terms.push_back(lterm);
+    _prefixes.push_back(prefix);
+    _suffixes.push_back(suffix);
+  }
+
+  void highlighter::compile()
+  {
+    // characters that appear in terms get a class each, both cases share it.
+    memset(_classes,0,sizeof(_classes));
+    _nclasses = 1;
+    for (size_t t=0; t<_terms.size(); t++)
+      for (size_t i=0; i<_terms[t].length(); i++)
+        {
+          unsigned char c = _terms[t][i];
+          if (_classes[c] == 0)
+            {
+              _classes[c] = _nclasses;
+              _classes[toupper(c)] = _nclasses;
+              _nclasses++;
+            }
+        }
+
+    // trie of the terms.
+    _delta.assign(_nclasses,-1);
+    _out.assign(1,-1);
+    _depth.assign(1,0);
+    for (size_t t=0; t<_terms.size(); t++)
+      {
+        int s = 0;
+        for (size_t i=0; i<_terms[t].length(); i++)
+          {
+            int a = _classes[(unsigned char)_terms[t][i]];
+            if (_delta[s*_nclasses+a] < 0)
+              {
+                _delta[s*_nclasses+a] = _out.size();
+                _delta.resize(_delta.size()+_nclasses,-1);
+                _out.push_back(-1);
+                _depth.push_back(_depth[s]+1);
+              }
+            s = _delta[s*_nclasses+a];
+          }
+        _out[s] = t;
+      }
+
+    // failure and dictionary links, in breadth-first order, folded into the
+    // transitions so that scanning takes a single lookup per character.
+    size_t nstates = _out.size();
+    std::vector<int> fail(nstates,0);
+    _dict.assign(nstates,-1);
+    std::queue<int> q;
+    for (int a=0; a<_nclasses; a++)
+      {
+        int v = _delta[a];
+        if (v < 0)
+          _delta[a] = 0;
+        else q.push(v);
+      }
+    while (!q.empty())
+      {
+        int u = q.front();
+        q.pop();
+        for (int a=0; a<_nclasses; a++)
+          {
+            int v = _delta[u*_nclasses+a];
+            if (v < 0)
+              {
+                _delta[u*_nclasses+a] = _delta[fail[u]*_nclasses+a];
+                continue;
+              }
+            int f = _delta[fail[u]*_nclasses+a];
+            fail[v] = f;
+            _dict[v] = _out[f] >= 0 ? f : _dict[f];
+            q.push(v);
+          }
+      }
+  }
+
+  /**
+   * \brief a term matched in text.
+   */
+  struct highlight_match
+  {
+    highlight_match(const size_t &start, const size_t &len, const int &term)
+      :_start(start),_len(len),_term(term)
+    {}
+
+    // leftmost, then longest first.
+    bool operator<(const highlight_match &m) const
+    {
+      return _start < m._start || (_start == m._start && _len > m._len);
+    }
+
+    size_t _start;
+    size_t _len;
+    int _term;
+  };
+
+  void highlighter::highlight(const char *str, const size_t &len,
+                              std::string &out) const
+  {
+    // scan: terms that appear as words.
+    std::vector<highlight_match> matches;
+    int s = 0;
+    for (size_t i=0; i<len; i++)
+      {
+        s = _delta[s*_nclasses+_classes[(unsigned char)str[i]]];
+        for (int m = _out[s] >= 0 ? s : _dict[s]; m >= 0; m = _dict[m])
+          {
+            size_t tlen = _depth[m];
+            size_t start = i + 1 - tlen;
+            const std::string &term = _terms[_out[m]];
+            if (start > 0 && is_word_char(term[0])
+                && (is_word_char(str[start-1]) || str[start-1] == '&'))
+              continue;
+            if (i+1 < len && is_word_char(term[tlen-1]) && is_word_char(str[i+1]))
+              continue;
+            matches.push_back(highlight_match(start,tlen,_out[m]));
+          }
+      }
+
+    // decorate the leftmost longest matches.
+    std::sort(matches.begin(),matches.end());
+    size_t emitted = 0;
+    for (size_t m=0; m<matches.size(); m++)
+      {
+        const highlight_match &hm = matches[m];
+        if (hm._start < emitted)
+          continue;
+        out.append(str+emitted,hm._start-emitted);
+        out += _prefixes[hm._term];
+        out.append(str+hm._start,hm._len);
+        out += _suffixes[hm._term];
+        emitted = hm._start + hm._len;
+      }
+    out.append(str+emitted,len-emitted);
+  }
+
+} /* end of namespace. */
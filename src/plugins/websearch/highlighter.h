@@ -0,0 +1,98 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HIGHLIGHTER_H
+#define HIGHLIGHTER_H
+
+#include <string>
+#include <vector>
+
+namespace seeks_plugins
+{
+
+  /**
+   * \brief highlighter of terms in text, for rendering.
+   *
+   * Terms are compiled into a case-insensitive Aho-Corasick automaton, and
+   * all of them are marked in a single pass over the text. A term is matched
+   * as a word: not within another word nor within an html entity. Among
+   * overlapping matches, the leftmost, then longest, is retained.
+   *
+   * The query context builds the highlighter of its query terms once, and the
+   * renderers decorate every snippet summary with it.
+   */
+  class highlighter
+  {
+    public:
+      highlighter();
+
+      ~highlighter();
+
+      /**
+       * \brief adds a term, to be surrounded with prefix and suffix wherever
+       *        it appears. The first decoration of a term added twice is kept.
+       *        The highlighter must be compiled before use.
+       */
+      void add_term(const std::string &term,
+                    const std::string &prefix,
+                    const std::string &suffix);
+
+      /**
+       * \brief builds the automaton from the added terms.
+       */
+      void compile();
+
+      /**
+       * \brief appends str to out, with all terms decorated.
+       */
+      void highlight(const char *str, const size_t &len,
+                     std::string &out) const;
+
+      void highlight(const std::string &str, std::string &out) const
+      {
+        highlight(str.c_str(),str.length(),out);
+      }
+
+      /**
+       * \brief number of terms.
+       */
+      size_t size() const
+      {
+        return _terms.size();
+      }
+
+      static bool is_word_char(const unsigned char &c);
+
+    private:
+      // terms and their decorations.
+      std::vector<std::string> _terms; /**< lower case terms. */
+      std::vector<std::string> _prefixes;
+      std::vector<std::string> _suffixes;
+
+      // automaton.
+      unsigned char _classes[256]; /**< character to (case-insensitive) class, 0 for characters not in terms. */
+      int _nclasses;
+      std::vector<int> _delta; /**< transitions, _nclasses per state. */
+      std::vector<int> _out; /**< term ending at state, -1 if none. */
+      std::vector<int> _dict; /**< next state with a term along the failure links, -1 if none. */
+      std::vector<int> _depth; /**< length of the prefix at state. */
+  };
+
+} /* end of namespace. */
+
+#endif
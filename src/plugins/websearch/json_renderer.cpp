@@ -22,6 +22,7 @@
 #include "miscutil.h"
 #include "cgi.h"
 #include "json_renderer_private.h"
+#include "snippet_index.h"
 #ifdef FEATURE_IMG_WEBSEARCH_PLUGIN
 #include "img_websearch.h"
 #include "img_query_context.h"
@@ -326,48 +327,28 @@ namespace seeks_plugins
         if (snippets.at(0)->_seeks_ir > 0)
           similarity = true;
 
-        // checks for safe snippets (for now, only used for images).
-        const char* safesearch_p = miscutil::lookup(parameters,"safesearch");
-        bool safesearch_off = false;
-        if (safesearch_p)
-          safesearch_off = strcasecmp(safesearch_p,"on") == 0 ? false : true;
+        // filtered snippets, in order (safe search, engines, similarity).
+        std::vector<search_snippet*> buffer;
+        const std::vector<search_snippet*> &ranked
+        = snippet_index::ranked(snippets,parameters,similarity,false,buffer);
 
         // proceed with rendering.
         const char *rpp_str = miscutil::lookup(parameters,"rpp"); // results per page.
         int rpp = websearch::_wconfig->_Nr;
         if (rpp_str)
           rpp = atoi(rpp_str);
-        size_t ssize = snippets.size();
         int ccpage = current_page;
         if (ccpage <= 0)
           ccpage = 1;
-        size_t snisize = std::min(ccpage*rpp,(int)snippets.size());
+        size_t snisize = std::min(ccpage*rpp,(int)ranked.size());
         size_t snistart = (ccpage-1)*rpp;
-        size_t count = 0;
 
-        for (size_t i=0; i<ssize; i++)
+        for (size_t i=snistart; i<snisize; i++)
           {
-            if (snippets.at(i)->_doc_type == doc_type::REJECTED)
-              continue;
-            if (!snippets.at(i)->is_se_enabled(parameters))
-              continue;
-            if (!safesearch_off && !snippets.at(i)->_safe)
-              continue;
-            if (!similarity || snippets.at(i)->_seeks_ir > 0)
-              {
-                if (count >= snistart)
-                  {
-                    if (count > snistart && count<snisize)
-                      json_str += ",";
-                    json_str += snippets.at(i)->to_json(has_thumbs,
-                                                        snippets.at(i)->_qc->_query_words);
-                  }
-                count++;
-              }
-            if (count == snisize)
-              {
-                break; // end here.
-              }
+            if (i > snistart)
+              json_str += ",";
+            json_str += ranked.at(i)->to_json(has_thumbs,
+                                              ranked.at(i)->_qc->_query_words);
           }
       }
     json_str += "]";
@@ -401,7 +382,7 @@ namespace seeks_plugins
 
         std::vector<search_snippet*> snippets;
         snippets.reserve(cl->_cpoints.size());
-        hash_map<uint32_t,hash_map<uint32_t,float,id_hash_uint>*,id_hash_uint>::const_iterator hit
+        hash_map<uint32_t,sparse_vector*,id_hash_uint>::const_iterator hit
         = cl->_cpoints.begin();
         while (hit!=cl->_cpoints.end())
           {
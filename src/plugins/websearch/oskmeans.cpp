@@ -20,6 +20,7 @@
 #include "mrf.h"
 #include "Random.h"
 #include "errlog.h"
+#include "thread_pool.h"
 
 #include <algorithm>
 #include <iterator>
@@ -30,6 +31,8 @@
 using lsh::mrf;
 using lsh::Random;
 using sp::errlog;
+using sp::thread_pool;
+using sp::task_group;
 
 //#define DEBUG
 
@@ -40,7 +43,8 @@ namespace seeks_plugins
   float oskmeans::_nuf = 0.01;
 
   oskmeans::oskmeans()
-    :clustering(),_iterations(0),_lambda(0.0),_rss(0.0),_t(0)
+    :clustering(),_pruning(true),_computed(0),_pruned(0),_exact(false),
+     _iterations(0),_lambda(0.0),_rss(0.0),_t(0)
   {
 #ifdef DEBUG
     std::cerr << "[Debug]: oskmeans created: " << _points.size() << " points\n";
@@ -50,7 +54,8 @@ namespace seeks_plugins
   oskmeans::oskmeans(query_context *qc,
                      const std::vector<search_snippet*> &snippets,
                      const short &K)
-    :clustering(qc,snippets,K),_iterations(0),_lambda(0.0),_rss(0.0),_t(0)
+    :clustering(qc,snippets,K),_pruning(true),_computed(0),_pruned(0),_exact(false),
+     _iterations(0),_lambda(0.0),_rss(0.0),_t(0)
   {
 #ifdef DEBUG
     std::cerr << "[Debug]: oskmeans created: " << _points.size() << " points -- "
@@ -67,10 +72,32 @@ namespace seeks_plugins
   void oskmeans::initialize()
   {
     _iterations = 0;
+    setup_points();
     kmeans_pp(); // oskmeans++ initialization.
     //uniform_random_selection();
   }
 
+  void oskmeans::setup_points()
+  {
+    _ids.clear();
+    _features.clear();
+    _norms.clear();
+    hash_map<uint32_t,sparse_vector*,id_hash_uint>::const_iterator hit
+    = _points.begin();
+    while (hit!=_points.end())
+      {
+        _ids.push_back((*hit).first);
+        _features.push_back((*hit).second);
+        _norms.push_back(oskmeans::enorm(*(*hit).second));
+        ++hit;
+      }
+    _assignments.assign(_ids.size(),-1);
+    _lower.assign(_ids.size(),0.0);
+    _upper.assign(_ids.size()*_K,0.0);
+    _moves.assign(_K,0.0);
+    _exact = false;
+  }
+
   void oskmeans::uniform_random_selection()
   {
     // debug, randomly select K points among all points...
@@ -80,7 +107,7 @@ namespace seeks_plugins
         short gen_point_pos = (short)Random::genUniformUnsInt32(0,(unsigned long int)npoints-1);
 
         // set cluster's centroid.
-        hash_map<uint32_t,float,id_hash_uint> *point_features = get_point_features(gen_point_pos);
+        sparse_vector *point_features = get_point_features(gen_point_pos);
         if (point_features != NULL)
           _clusters[c]._c._features = *point_features;
         else
@@ -90,109 +117,64 @@ namespace seeks_plugins
 
   void oskmeans::kmeans_pp()
   {
-    if (_snippets.empty())
+    size_t npts = _ids.size();
+    if (npts == 0 || _K <= 0)
       return;
 
-    size_t npts = _points.size();
-
-    bool centroids[npts];
-    for (size_t i=0; i<npts; i++)
-      centroids[i] = false;
+    std::vector<bool> centroids(npts,false);
 
     // grab the first best ranked snippet as the first centroid.
     std::stable_sort(_snippets.begin(),_snippets.end(),
                      search_snippet::max_meta_rank);
-    int sk = 0;
-    while (!_snippets.at(sk++)->_features_tfidf)
+    hash_map<uint32_t,search_snippet*,id_hash_uint> snippets;
+    search_snippet *first = NULL;
+    for (size_t s=0; s<_snippets.size(); s++)
       {
+        search_snippet *sp = _snippets.at(s);
+        if (!sp->_features_tfidf)
+          continue;
+        if (!first)
+          first = sp;
+        snippets.insert(std::pair<uint32_t,search_snippet*>(sp->_id,sp));
       }
-    _clusters[0]._c._features = *_snippets.at(sk-1)->_features_tfidf;
-    uint32_t idc1 = _snippets.at(sk-1)->_id;
-
-    sk = 0;
-    hash_map<uint32_t,hash_map<uint32_t,float,id_hash_uint>*,id_hash_uint>::const_iterator hit
-    = _points.begin();
-    while (hit!=_points.end())
+    if (!first)
+      return;
+    for (size_t k=0; k<npts; k++)
       {
-        if ((*hit).first == idc1)
+        if (_ids[k] == first->_id)
           {
-            centroids[sk] = true;
+            centroids[k] = true;
             break;
           }
-        ++sk;
-        ++hit;
+      }
+    _clusters[0]._c._features = *first->_features_tfidf;
+    float norm = oskmeans::enorm(_clusters[0]._c._features);
+    if (norm > 0.0)
+      normalize_centroid(&_clusters[0]._c,norm);
+    compute_similarities(0);
+
+    std::vector<double> meta_ranks(npts,0.0);
+    for (size_t k=0; k<npts; k++)
+      {
+        hash_map<uint32_t,search_snippet*,id_hash_uint>::const_iterator hit;
+        if ((hit = snippets.find(_ids[k]))!=snippets.end())
+          meta_ranks[k] = (*hit).second->_meta_rank;
       }
 
     // use kmeans++ to sample the other centroids.
+    std::vector<double> max_sims(npts,0.0); // cosine to the closest centroid, if positive.
+    std::vector<double> probs(npts,0.0);
     for (short c=1; c<_K; c++)
       {
-        // compute sampling probabilities.
-        double probs[npts];
-        double tmax_sim = 0.0;
-        hit = _points.begin();
-        int k = 0;
-
-#ifdef DEBUG
-        //debug
-        std::string urls[npts];
-        //debug
-#endif
-
-        while (hit!=_points.end())
+        // compute sampling probabilities, from the similarities to the last centroid.
+        for (size_t k=0; k<npts; k++)
           {
+            if (_norms[k] > 0.0)
+              max_sims[k] = std::max(max_sims[k],_upper[k*_K+c-1] / _norms[k]);
             if (centroids[k])
-              {
-                ++hit;
-                probs[k++] = 0.0;
-                continue;
-              }
-
-            double max_sim = 0.0; // max distance.
-            get_closest_cluster((*hit).second,max_sim);
-
-            search_snippet *sp = _qc->get_cached_snippet((*hit).first);
-            max_sim = (1.0-max_sim)*(1.0-max_sim)*sp->_meta_rank;
-
-            probs[k] = max_sim;
-            tmax_sim += max_sim;
-
-#ifdef DEBUG
-            //debug
-            urls[k] = sp->_url;
-            std::cout << "url: " << urls[k] << " -- max_sim: " << max_sim << " -- meta_rank: " << sp->_meta_rank << std::endl;
-            //debug
-#endif
-
-            k++;
-            ++hit;
+              probs[k] = 0.0;
+            else probs[k] = (1.0-max_sims[k])*(1.0-max_sims[k])*meta_ranks[k];
           }
-        for (size_t j=0; j<npts; j++)  // normalization.
-          probs[j] /= tmax_sim;
-
-#ifdef DEBUG
-        std::cerr << "[Debug]: probs: ";
-        for (size_t j=0; j<npts; j++)
-          std::cerr << urls[j] << ": " << probs[j] << std::endl;
-#endif
-
-        // sample point.
-        //double smpl_prob = Random::genUniformDbl32(0,1);
-
-#ifdef DEBUG
-        std::cerr << "[Debug]: smpl_prob: " << smpl_prob << std::endl;
-#endif
-
-        /*double cprob = 0.0;
-        size_t l = 0;
-        for (l=0;l<npts;l++)
-          {
-        if (!centroids[l])
-         {
-            cprob += probs[l];
-            if (cprob >= smpl_prob)
-        break;
-         }
-          } */
 
         // select the point with max value to existing clusters.
         double max_score = -1.0;
@@ -206,17 +188,18 @@ namespace seeks_plugins
         centroids[cl] = true;
 
 #ifdef DEBUG
-        std::cerr << "[Debug]: cluster's centroid #" << c << ": point #" << cl << " -- url: " << urls[cl] << std::endl;
+        std::cerr << "[Debug]: cluster's centroid #" << c << ": point #" << cl << std::endl;
 #endif
 
         // set cluster's centroid.
-        hash_map<uint32_t,float,id_hash_uint> *point_features = get_point_features(cl);
-
-        if (point_features != NULL)
-          _clusters[c]._c._features = *point_features;
-        else
-          _clusters[c]._c._features.clear();
+        _clusters[c]._c._features = *_features[cl];
+        if (_norms[cl] > 0.0)
+          normalize_centroid(&_clusters[c]._c,_norms[cl]);
+        compute_similarities(c);
       }
+
+    // bounds are the similarities to the seeds.
+    _exact = true;
   }
 
   void oskmeans::clusterize()
@@ -224,54 +207,227 @@ namespace seeks_plugins
     // initialize.
     initialize();
 
-    if (_snippets.empty())
+    size_t npts = _ids.size();
+    if (npts == 0 || _K <= 0)
       return;
 
-    // clustering.
+    // clustering, until no point changes cluster.
     while (!stopping_criterion())
       {
 #ifdef DEBUG
         std::cerr << "[Debug]:clusterize, iteration #" << _iterations << std::endl;
 #endif
 
-        for (short c=0; c<_K; c++)
-          {
-            // clear the cluster.
-            _clusters[c].clear();
-          }
+        size_t reassigned = assign_points();
 
-        // clear the garbage cluster.
-        _garbage_cluster.clear();
+        // count iteration.
+        _iterations++;
 
-        // iterates points and associate each of them with a cluster.
-        hash_map<uint32_t,hash_map<uint32_t,float,id_hash_uint>*,id_hash_uint>::const_iterator hit
-        = _points.begin();
-        while (hit!=_points.end())
-          {
-            float learning_rate = oskmeans::_nu0*pow((oskmeans::_nuf/oskmeans::_nu0),_t/static_cast<float>(_points.size()*oskmeans::_niterations));
+        if (reassigned == 0)
+          break;
 
-#ifdef DEBUG
-            std::cerr << "learning rate: " << learning_rate << std::endl;
-#endif
+        // recomputation of centroids.
+        update_centroids();
+      }
+
+    for (short c=0; c<_K; c++)
+      {
+        // clear the cluster.
+        _clusters[c].clear();
+      }
+
+    // clear the garbage cluster.
+    _garbage_cluster.clear();
+
+    // associate each point with its cluster.
+    for (size_t i=0; i<npts; i++)
+      {
+        if (_assignments[i] == -1)
+          _garbage_cluster.add_point(_ids[i],_features[i]);
+        else _clusters[_assignments[i]].add_point(_ids[i],_features[i]);
+      }
+  }
+
+  size_t oskmeans::run_tasks(void* (*cb)(void*), const bool &by_centroid,
+                             const short &c)
+  {
+    size_t npts = _ids.size();
+    std::vector<oskmeans_task> tasks;
+    if (by_centroid)
+      {
+        for (short k=0; k<_K; k++)
+          tasks.push_back(oskmeans_task(this,k,0,npts));
+      }
+    else
+      {
+        for (size_t b=0; b<npts; b+=OSKMEANS_TASK_POINTS)
+          tasks.push_back(oskmeans_task(this,c,b,std::min(b+OSKMEANS_TASK_POINTS,npts)));
+      }
+
+    task_group tg(thread_pool::shared());
+    for (size_t t=0; t<tasks.size(); t++)
+      tg.run(cb,&tasks[t]);
+    tg.wait();
+
+    size_t reassigned = 0;
+    for (size_t t=0; t<tasks.size(); t++)
+      {
+        _computed += tasks[t]._computed;
+        _pruned += tasks[t]._pruned;
+        reassigned += tasks[t]._reassigned;
+      }
+    return reassigned;
+  }
+
+  void* oskmeans::similarities_cb(void *arg)
+  {
+    oskmeans_task *task = static_cast<oskmeans_task*>(arg);
+    oskmeans *km = task->_km;
+    for (size_t i=task->_begin; i<task->_end; i++)
+      {
+        km->_upper[i*km->_K+task->_c]
+        = oskmeans::distance_normed_points(*km->_features[i],km->_clusters[task->_c]._c._features);
+        task->_computed++;
+      }
+    return NULL;
+  }
 
-            // find closest cluster to this point.
-            short cl = assign_cluster((*hit).first,(*hit).second);
+  void oskmeans::compute_similarities(const short &c)
+  {
+    run_tasks(&oskmeans::similarities_cb,false,c);
+  }
 
-            // recomputation of centroids/medoids.
-            if (cl != -1)
+  void* oskmeans::assign_cb(void *arg)
+  {
+    oskmeans_task *task = static_cast<oskmeans_task*>(arg);
+    for (size_t i=task->_begin; i<task->_end; i++)
+      task->_km->assign_point(i,task);
+    return NULL;
+  }
+
+  size_t oskmeans::assign_points()
+  {
+    size_t reassigned = run_tasks(&oskmeans::assign_cb,false);
+    _exact = false;
+    return reassigned;
+  }
+
+  void oskmeans::assign_point(const size_t &i, oskmeans_task *task)
+  {
+    double *upper = &_upper[i*_K];
+    short a = _assignments[i];
+    std::vector<char> &exact = task->_exact_bounds;
+    exact.assign(_K,_exact);
+
+    if (!_exact)
+      {
+        // the similarity to a centroid moves at most by the norm of the point
+        // times the distance the centroid moved.
+        double slack = _norms[i] * OSKMEANS_ROUNDING;
+        for (short c=0; c<_K; c++)
+          upper[c] += _norms[i] * _moves[c] + slack;
+        if (a != -1)
+          _lower[i] -= _norms[i] * _moves[a] + slack;
+
+        // the point stays in its cluster when no other centroid can be closer.
+        bool stays = _pruning && a != -1 && _lower[i] > 0.0;
+        for (short c=0; c<_K && stays; c++)
+          if (c != a && upper[c] >= _lower[i])
+            stays = false;
+        if (stays)
+          {
+            task->_pruned += _K;
+            return;
+          }
+
+        // similarity to the current centroid first, to rule out the others.
+        double max_lower = 0.0; // similarity must be positive.
+        if (a != -1)
+          {
+            upper[a] = oskmeans::distance_normed_points(*_features[i],_clusters[a]._c._features);
+            exact[a] = true;
+            task->_computed++;
+            max_lower = std::max(max_lower,upper[a]);
+          }
+        for (short c=0; c<_K; c++)
+          {
+            if (exact[c])
+              continue;
+            if (_pruning && (upper[c] <= 0.0 || upper[c] < max_lower))
               {
-                float cl_norm = 0.0;
-                recompute_centroid(learning_rate,&_clusters[cl]._c,(*hit).second,cl_norm);
-                normalize_centroid(&_clusters[cl]._c,cl_norm);
+                task->_pruned++;
+                continue;
               }
+            upper[c] = oskmeans::distance_normed_points(*_features[i],_clusters[c]._c._features);
+            exact[c] = true;
+            task->_computed++;
+            max_lower = std::max(max_lower,upper[c]);
+          }
+      }
 
-            ++hit;
-            _t++;
+    // closest centroid, first one on ties, as with get_closest_cluster.
+    double max_dist = 0.0;
+    short close_c = -1;
+    for (short c=0; c<_K; c++)
+      {
+        if (exact[c] && upper[c] > max_dist)
+          {
+            close_c = c;
+            max_dist = upper[c];
           }
+      }
+    _lower[i] = max_dist;
+    if (close_c != a)
+      {
+        _assignments[i] = close_c;
+        task->_reassigned++;
+      }
+  }
 
-        // count iteration.
-        _iterations++;
+  void* oskmeans::centroid_cb(void *arg)
+  {
+    oskmeans_task *task = static_cast<oskmeans_task*>(arg);
+    task->_km->compute_centroid(task->_c);
+    return NULL;
+  }
+
+  void oskmeans::update_centroids()
+  {
+    run_tasks(&oskmeans::centroid_cb,true);
+  }
+
+  void oskmeans::compute_centroid(const short &c)
+  {
+    // sum of the normalized points of the cluster, in a fixed order.
+    hash_map<uint32_t,float,id_hash_uint> sum;
+    bool empty = true;
+    for (size_t i=0; i<_ids.size(); i++)
+      {
+        if (_assignments[i] != c || _norms[i] == 0.0)
+          continue;
+        empty = false;
+        const sparse_vector *p = _features[i];
+        for (size_t f=0; f<p->size(); f++)
+          sum[p->_ids[f]] += p->_weights[f] / _norms[i];
       }
+
+    // a cluster that lost its points keeps its centroid.
+    if (empty)
+      {
+        _moves[c] = 0.0;
+        return;
+      }
+
+    centroid cn;
+    cn._features = sparse_vector(sum);
+    float norm = oskmeans::enorm(cn._features);
+    if (norm > 0.0)
+      normalize_centroid(&cn,norm);
+
+    sparse_vector move = cn._features;
+    move.add(_clusters[c]._c._features,-1.0);
+    _moves[c] = oskmeans::enorm(move);
+    _clusters[c]._c._features = cn._features;
   }
 
   bool oskmeans::stopping_criterion()
@@ -282,7 +438,7 @@ namespace seeks_plugins
     else return false;
   }
 
-  short oskmeans::get_closest_cluster(hash_map<uint32_t,float,id_hash_uint> *p,
+  short oskmeans::get_closest_cluster(sparse_vector *p,
                                       double &max_dist)
   {
     max_dist = 0;
@@ -304,7 +460,7 @@ namespace seeks_plugins
   }
 
   short oskmeans::assign_cluster(const uint32_t &id,
-                                 hash_map<uint32_t,float,id_hash_uint> *p)
+                                 sparse_vector *p)
   {
     // find closest cluster to p.
     double max_dist = 0.0;
@@ -322,7 +478,7 @@ namespace seeks_plugins
   }
 
   // static.
-  float oskmeans::distance(const hash_map<uint32_t,float,id_hash_uint> &p1, const hash_map<uint32_t,float,id_hash_uint> &p2)
+  float oskmeans::distance(const sparse_vector &p1, const sparse_vector &p2)
   {
     double dist = oskmeans::distance_normed_points(p1,p2);
 
@@ -332,76 +488,36 @@ namespace seeks_plugins
     return dist / (oskmeans::enorm(p1)*oskmeans::enorm(p2));
   }
 
-  float oskmeans::distance_normed_points(const hash_map<uint32_t,float,id_hash_uint> &p1,
-                                         const hash_map<uint32_t,float,id_hash_uint> &p2)
+  float oskmeans::distance_normed_points(const sparse_vector &p1,
+                                         const sparse_vector &p2)
   {
-    float dist = 0.0;
-    hash_map<uint32_t,float,id_hash_uint>::const_iterator hit = p1.begin();
-    hash_map<uint32_t,float,id_hash_uint>::const_iterator hit2;
-    while (hit!=p1.end())
-      {
-        if ((hit2=p2.find((*hit).first))!=p2.end())
-          {
-            dist += (*hit).second * (*hit2).second;
-          }
-        ++hit;
-      }
-
-    return dist;
+    return p1.dot(p2);
   }
 
   // static.
-  float oskmeans::enorm(const hash_map<uint32_t,float,id_hash_uint> &p)
+  float oskmeans::enorm(const sparse_vector &p)
   {
-    float enorm = 0.0;
-    hash_map<uint32_t,float,id_hash_uint>::const_iterator hit = p.begin();
-    while (hit!=p.end())
-      {
-        enorm += (*hit).second*(*hit).second;
-        ++hit;
-      }
-    return sqrt(enorm);
+    return p.norm();
   }
 
   void oskmeans::recompute_centroid(const float &learning_rate,
                                     centroid *c,
-                                    hash_map<uint32_t,float,id_hash_uint> *p,
+                                    sparse_vector *p,
                                     float &cl_norm)
   {
-    hash_map<uint32_t,float,id_hash_uint>::const_iterator phit = p->begin();
-    hash_map<uint32_t,float,id_hash_uint>::iterator chit;
-    while (phit!=p->end())
-      {
-        float update = learning_rate * (*phit).second;
-        if ((chit=c->_features.find((*phit).first))!=c->_features.end())
-          {
-            (*chit).second += update;
-            cl_norm += (*chit).second;
-          }
-        else
-          {
-            c->_features.insert(std::pair<uint32_t,float>((*phit).first,update));
-            cl_norm += update;
-          }
-        ++phit;
-      }
+    cl_norm += c->_features.add(*p,learning_rate);
   }
 
   void oskmeans::normalize_centroid(centroid *c,
                                     const float &cl_norm)
   {
     // normalize.
-    hash_map<uint32_t,float,id_hash_uint>::iterator chit = c->_features.begin();
-    while (chit!=c->_features.end())
-      {
-        (*chit).second /= cl_norm;
-        ++chit;
-      }
+    c->_features.scale(1.0 / cl_norm);
   }
 
   void oskmeans::rank_elements(cluster &cl)
   {
-    hash_map<uint32_t,hash_map<uint32_t,float,id_hash_uint>*,id_hash_uint>::iterator hit
+    hash_map<uint32_t,sparse_vector*,id_hash_uint>::iterator hit
     = cl._cpoints.begin();
     while (hit!=cl._cpoints.end())
       {
@@ -21,8 +21,60 @@
 
 #include "clustering.h"
 
+#include <vector>
+
+/**
+ * Number of points handled by a clustering task.
+ */
+#define OSKMEANS_TASK_POINTS 64
+
+/**
+ * Error on a similarity bound, per iteration and relative to the norm of the
+ * point, that accounts for the rounding of the centroids and dot products.
+ */
+#define OSKMEANS_ROUNDING 1e-6
+
 namespace seeks_plugins
 {
+  class oskmeans;
+
+  /**
+   * \brief points, or centroid, of the clustering handled by a task, and
+   *        the counters of the task.
+   */
+  class oskmeans_task
+  {
+    public:
+      oskmeans_task(oskmeans *km, const short &c,
+                    const size_t &begin, const size_t &end)
+        :_km(km),_c(c),_begin(begin),_end(end),
+         _computed(0),_pruned(0),_reassigned(0)
+      {};
+
+      ~oskmeans_task() {};
+
+      oskmeans *_km;
+      short _c;
+      size_t _begin;
+      size_t _end;
+      unsigned long _computed;
+      unsigned long _pruned;
+      unsigned long _reassigned;
+      std::vector<char> _exact_bounds; /**< per centroid, whether the bound of the current point is exact. */
+  };
+
+  /**
+   * \brief spherical k-means over the tf-idf features of snippets, seeded
+   *        with k-means++.
+   *
+   *        Iterations alternate the assignment of every point to its most
+   *        similar centroid and the recomputation of the centroids, until
+   *        no point changes cluster. Similarities are bounded from their last
+   *        computed value and from how far centroids moved since, so that
+   *        an assignment only computes the similarities to the centroids that
+   *        may still be the closest. Points are assigned, and centroids
+   *        recomputed, in parallel over the thread pool.
+   */
   class oskmeans : public clustering
   {
     public:
@@ -49,29 +101,80 @@ namespace seeks_plugins
       /* double rss();
        double rad_c(const short &c); */
 
-      short get_closest_cluster(hash_map<uint32_t,float,id_hash_uint> *p,
+      short get_closest_cluster(sparse_vector *p,
                                 double &min_dist);
 
       short assign_cluster(const uint32_t &id,
-                           hash_map<uint32_t,float,id_hash_uint> *p);
+                           sparse_vector *p);
 
-      static float distance(const hash_map<uint32_t,float,id_hash_uint> &p1,
-                            const hash_map<uint32_t,float,id_hash_uint> &p2);
+      static float distance(const sparse_vector &p1,
+                            const sparse_vector &p2);
 
-      static float distance_normed_points(const hash_map<uint32_t,float,id_hash_uint> &p1,
-                                          const hash_map<uint32_t,float,id_hash_uint> &p2);
+      static float distance_normed_points(const sparse_vector &p1,
+                                          const sparse_vector &p2);
 
-      static float enorm(const hash_map<uint32_t,float,id_hash_uint> &p);
+      static float enorm(const sparse_vector &p);
 
       void recompute_centroid(const float &learning_rate,
                               centroid *c,
-                              hash_map<uint32_t,float,id_hash_uint> *p,
+                              sparse_vector *p,
                               float &cl_norm);
 
       void normalize_centroid(centroid *c,
                               const float &cl_norm);
 
+      /**
+       * \brief assigns every point to its closest cluster.
+       * @return the number of points that changed cluster.
+       */
+      size_t assign_points();
+
+      /**
+       * \brief sets the centroids to the normalized sums of their points,
+       *        and records how far they moved.
+       */
+      void update_centroids();
+
+      short iterations() const
+      {
+        return _iterations;
+      };
+
+      static void* similarities_cb(void *arg);
+
+      static void* assign_cb(void *arg);
+
+      static void* centroid_cb(void *arg);
+
+    private:
+      void setup_points();
+
+      size_t run_tasks(void* (*cb)(void*), const bool &by_centroid,
+                       const short &c=-1);
+
+      void compute_similarities(const short &c);
+
+      void assign_point(const size_t &i, oskmeans_task *task);
+
+      void compute_centroid(const short &c);
+
+    public:
+      bool _pruning; /**< whether similarities are bounded, for control. */
+      unsigned long _computed; /**< similarities computed. */
+      unsigned long _pruned; /**< similarities ruled out by their bounds. */
+
     private:
+      /* points, in the order of the iterations over _points. */
+      std::vector<uint32_t> _ids;
+      std::vector<sparse_vector*> _features;
+      std::vector<float> _norms;
+      std::vector<short> _assignments; /**< -1 for the garbage cluster. */
+
+      std::vector<double> _lower; /**< bound under the similarity of each point to its centroid. */
+      std::vector<double> _upper; /**< bounds over the similarities of each point to each centroid. */
+      std::vector<double> _moves; /**< distance moved by each centroid at the last iteration. */
+      bool _exact; /**< whether the bounds are the similarities. */
+
       short _iterations; /**< number of clustering iterations, for control. */
       double _lambda; /**< weight control on cluster numbers. */
       double _rss; /**< error control. */
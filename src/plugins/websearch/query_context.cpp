@@ -49,7 +49,7 @@ namespace seeks_plugins
 
   query_context::query_context()
     :sweepable(),_page_expansion(0),_lsh_ham(NULL),_ulsh_ham(NULL),_compute_tfidf_features(true),
-     _registered(false),_npeers(0),_lfilter(NULL)
+     _registered(false),_npeers(0),_lfilter(NULL),_feeds_acked(false)
   {
     mutex_init(&_qc_mutex);
     mutex_init(&_feeds_ack_mutex);
@@ -59,7 +59,7 @@ namespace seeks_plugins
   query_context::query_context(const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters,
                                const std::list<const char*> &http_headers)
     :sweepable(),_page_expansion(0),_blekko(false),_lsh_ham(NULL),_ulsh_ham(NULL),_compute_tfidf_features(true),
-     _registered(false),_npeers(0),_lfilter(NULL)
+     _registered(false),_npeers(0),_lfilter(NULL),_feeds_acked(false)
   {
     mutex_init(&_qc_mutex);
     mutex_init(&_feeds_ack_mutex);
@@ -105,6 +105,10 @@ namespace seeks_plugins
 
     // tokenize query.
     miscutil::tokenize(_query,_query_words," ");
+    for (size_t i=0; i<_query_words.size(); i++)
+      if (_query_words.at(i).length() > 2)
+        _highlighter.add_term(_query_words.at(i),"<b>","</b>");
+    _highlighter.compile();
 
     // encoded query.
     char *url_enc_query_str = encode::url_encode(_query.c_str());
@@ -141,8 +145,6 @@ namespace seeks_plugins
     // clears the LSH hashtable.
     if (_ulsh_ham)
       delete _ulsh_ham;
-    if (_lsh_ham)
-      delete _lsh_ham;
 
     for (std::list<const char*>::iterator lit=_useful_http_headers.begin();
          lit!=_useful_http_headers.end(); lit++)
@@ -189,6 +191,8 @@ namespace seeks_plugins
           {
             remove_from_unordered_cache(sp->_id);
             remove_from_unordered_cache_title(sp);
+            _summary_features.remove(sp->_id);
+            _content_features.remove(sp->_id);
             delete sp;
             vit = _cached_snippets.erase(vit);
             continue;
@@ -196,6 +200,7 @@ namespace seeks_plugins
         ++vit;
       }
     _suggestions.clear();
+    _snippets_index.invalidate();
   }
 
   bool query_context::sweep_me()
@@ -395,6 +400,7 @@ namespace seeks_plugins
   void query_context::add_to_cache(search_snippet *sr)
   {
     _cached_snippets.push_back(sr);
+    _snippets_index.invalidate();
   }
 
   void query_context::remove_from_cache(search_snippet *sr)
@@ -407,6 +413,9 @@ namespace seeks_plugins
           vit = _cached_snippets.erase(vit);
         else ++vit;
       }
+    _summary_features.remove(sr->_id);
+    _content_features.remove(sr->_id);
+    _snippets_index.invalidate();
   }
 
   void query_context::add_to_unordered_cache(search_snippet *sr)
@@ -24,7 +24,11 @@
 #include "sweeper.h"
 #include "proxy_dts.h"
 #include "search_snippet.h"
+#include "snippet_index.h" // for the ranked snippets and their rendering views.
+#include "highlighter.h" // for highlighting query terms in rendered snippets.
 #include "LSHUniformHashTableHamming.h" // for regrouping urls, titles and other text snippets.
+#include "minhash.h" // for detecting near-duplicate snippets.
+#include "tfidf_index.h" // for snippet tf-idf features.
 #include "seeks_proxy.h"
 #include "stl_hash.h"
 #include "mutexes.h"
@@ -246,6 +250,7 @@ namespace seeks_plugins
       std::string _lc_query; /**< lower case query, for storage and similarity operations. */
       uint32_t _query_hash; /**< hashed query_key. */
       std::vector<std::string> _query_words; /* tokenized query words. */
+      highlighter _highlighter; /* query words highlighter, for rendering. */
 
       /* expansion. */
       uint32_t _page_expansion; /**< expansion as fetched pages from the search engines. */
@@ -256,6 +261,9 @@ namespace seeks_plugins
       hash_map<const char*,search_snippet*,hash<const char*>,eqstr> _unordered_snippets_title; // cached snippets ptr, title is the key.
       hash_map<const char*,const char*,hash<const char*>,eqstr> _cached_urls; // cached content, url is the key.
 
+      /* rank ordered index and rendering views of the cached snippets. */
+      snippet_index _snippets_index;
+
       /* timer. */
       time_t _creation_time;
       time_t _last_time_of_use;
@@ -266,13 +274,21 @@ namespace seeks_plugins
       /* suggested queries. */
       std::multimap<double,std::string,std::less<double> > _suggestions;
 
-      /* LSH subsystem for regrouping textual elements. */
-      LSHSystemHamming *_lsh_ham;
+      /* LSH subsystem for regrouping textual elements, shared, not owned. */
+      const LSHSystemHamming *_lsh_ham;
       LSHUniformHashTableHamming *_ulsh_ham;
 
+      /* fingerprints of the cached snippets, by snippet id. */
+      lsh::minhash_index _fingerprints;
+
       /* tfidf feature computation flag. */
       bool _compute_tfidf_features;
 
+      /* document frequencies of the features of the snippets summaries and
+         contents, updated as snippets are added to and removed from the cache. */
+      lsh::tfidf_index _summary_features;
+      lsh::tfidf_index _content_features;
+
       /* automatic language detection. */
       std::string _auto_lang; // lang, e.g. en.
       std::string _auto_lang_reg; // lang-region, e.g. en-US.
@@ -306,6 +322,9 @@ namespace seeks_plugins
 
       /* feeds acquisition condition variable for signaling. */
       sp_cond_t _feeds_ack_cond;
+
+      /* whether feeds were acquired, guarded by the feeds acquisition mutex. */
+      bool _feeds_acked;
   };
 
 } /* end of namespace. */
@@ -22,6 +22,7 @@
 #include "curl_mget.h"
 #include "encode.h"
 #include "errlog.h"
+#include "thread_pool.h"
 #include "seeks_proxy.h" // for configuration and mutexes.
 #include "proxy_configuration.h"
 #include "query_context.h"
@@ -858,10 +859,10 @@ namespace seeks_plugins
     int j = 0;
     if (seeks_proxy::_config->_multi_threaded)
       {
-        std::vector<pthread_t> parser_threads;
+        task_group parser_tasks(thread_pool::shared());
         std::vector<ps_thread_arg*> parser_args;
 
-        // threads, one per parser.
+        // tasks, one per parser.
         std::set<feed_parser,feed_parser::lxn>::iterator it
         = se_enabled._feedset.begin();
         while(it!=se_enabled._feedset.end())
@@ -883,32 +884,16 @@ namespace seeks_plugins
                     args->_offset = count_offset;
                     args->_qr = qr;
 
-                    pthread_t ps_thread;
-                    int err = pthread_create(&ps_thread, NULL,  // default attribute is PTHREAD_CREATE_JOINABLE
-                                             (void * (*)(void *))se_handler::parse_output, args);
-                    if (err != 0)
-                      {
-                        errlog::log_error(LOG_LEVEL_ERROR, "Error creating parser thread.");
-                        parser_threads.push_back(0);
-                        delete args;
-                        parser_args.push_back(NULL);
-                        continue;
-                      }
                     parser_args.push_back(args);
-                    parser_threads.push_back(ps_thread);
+                    parser_tasks.run((void * (*)(void *))se_handler::parse_output, args);
                   }
-                else parser_threads.push_back(0);
                 j++;
               }
             ++it;
           }
 
         // join and merge results.
-        for (size_t i=0; i<parser_threads.size(); i++)
-          {
-            if (parser_threads.at(i)!=0)
-              pthread_join(parser_threads.at(i),NULL);
-          }
+        parser_tasks.wait();
 
         for (size_t i=0; i<parser_args.size(); i++)
           {
@@ -31,6 +31,8 @@
 #endif
 
 #include "mrf.h"
+#include "minhash.h"
+#include "sparse_vector.h"
 #if defined(PROTOBUF) && defined(TC)
 #include "query_capture_configuration.h"
 #endif
@@ -55,20 +57,22 @@ using sp::plugin_manager;
 using sp::seeks_proxy;
 using sp::http_request;
 using lsh::mrf;
+using lsh::minhash_signature;
+using lsh::sparse_vector;
 
 namespace seeks_plugins
 {
   search_snippet::search_snippet()
     :_qc(NULL),_new(true),_id(0),_doc_type(doc_type::UNKNOWN),_sim_back(false),_rank(0),_seeks_ir(0.0),_meta_rank(0),_seeks_rank(0),
      _content_date(0),_record_date(0),_cached_content(NULL),
-     _features(NULL),_features_tfidf(NULL),_bag_of_words(NULL),_personalized(false),_npeers(0),_hits(0),_radius(0),_safe(true)
+     _features(NULL),_features_tfidf(NULL),_features_tfidf_index(NULL),_bag_of_words(NULL),_fingerprint(NULL),_personalized(false),_npeers(0),_hits(0),_radius(0),_safe(true)
   {
   }
 
   search_snippet::search_snippet(const double &rank)
     :_qc(NULL),_new(true),_id(0),_doc_type(doc_type::UNKNOWN),_sim_back(false),_rank(rank),_seeks_ir(0.0),_meta_rank(0),_seeks_rank(0),
      _content_date(0),_record_date(0),_cached_content(NULL),
-     _features(NULL),_features_tfidf(NULL),_bag_of_words(NULL),_personalized(false),_npeers(0),_hits(0),_radius(0),_safe(true)
+     _features(NULL),_features_tfidf(NULL),_features_tfidf_index(NULL),_bag_of_words(NULL),_fingerprint(NULL),_personalized(false),_npeers(0),_hits(0),_radius(0),_safe(true)
   {
   }
 
@@ -80,7 +84,7 @@ namespace seeks_plugins
      _content_date(s->_content_date),_record_date(s->_record_date),
      _engine(s->_engine),
      _cached_content(NULL),
-     _features(NULL),_features_tfidf(NULL),_bag_of_words(NULL),_personalized(s->_personalized),
+     _features(NULL),_features_tfidf(NULL),_features_tfidf_index(s->_features_tfidf_index),_bag_of_words(NULL),_fingerprint(NULL),_personalized(s->_personalized),
      _npeers(s->_npeers),_hits(s->_hits),_radius(s->_radius),_safe(s->_safe)
   {
     if (s->_cached_content)
@@ -88,9 +92,11 @@ namespace seeks_plugins
     if (s->_features)
       _features = new std::vector<uint32_t>(*s->_features);
     if (s->_features_tfidf)
-      _features_tfidf = new hash_map<uint32_t,float,id_hash_uint>(*s->_features_tfidf);
+      _features_tfidf = new sparse_vector(*s->_features_tfidf);
     if (s->_bag_of_words)
       _bag_of_words = new hash_map<uint32_t,std::string,id_hash_uint>(*s->_bag_of_words);
+    if (s->_fingerprint)
+      _fingerprint = new minhash_signature(*s->_fingerprint);
   }
 
   search_snippet::~search_snippet()
@@ -103,28 +109,8 @@ namespace seeks_plugins
       delete _features_tfidf;
     if (_bag_of_words)
       delete _bag_of_words;
-  }
-
-  void search_snippet::highlight_query(std::vector<std::string> &words,
-                                       std::string &str)
-  {
-    if (words.empty())
-      return;
-
-    // sort words by size.
-    std::sort(words.begin(),words.end(),std::greater<std::string>());
-
-    // surround every of those words appearing within the
-    // argument string with <b> </b> for html
-    // bold format. TODO: green ?
-    for (size_t i=0; i<words.size(); i++)
-      {
-        if (words.at(i).length() > 2)
-          {
-            std::string bold_str = "<b>" + words.at(i) + "</b>";
-            miscutil::ci_replace_in_string(str,words.at(i),bold_str);
-          }
-      }
+    if (_fingerprint)
+      delete _fingerprint;
   }
 
   void search_snippet::discr_words(const std::vector<std::string> &query_words,
@@ -138,13 +124,8 @@ namespace seeks_plugins
     std::map<float,uint32_t,std::greater<float> > f_tfidf;
 
     // sort features in decreasing tf-idf order.
-    hash_map<uint32_t,float,id_hash_uint>::const_iterator fit
-    = _features_tfidf->begin();
-    while (fit!=_features_tfidf->end())
-      {
-        f_tfidf.insert(std::pair<float,uint32_t>((*fit).second,(*fit).first));
-        ++fit;
-      }
+    for (size_t f=0; f<_features_tfidf->size(); f++)
+      f_tfidf.insert(std::pair<float,uint32_t>(_features_tfidf->_weights[f],_features_tfidf->_ids[f]));
 
     size_t nqw = query_words.size();
     int i = 0;
@@ -256,12 +237,8 @@ namespace seeks_plugins
       {
         html_content += "<div>";
         char *enc_summary = encode::html_encode(_summary.c_str());
-        std::string summary = enc_summary;
+        static_renderer::highlight(this,enc_summary,base_url_str,html_content);
         free(enc_summary);
-        search_snippet::highlight_query(words,summary);
-        if (websearch::_wconfig->_extended_highlight)
-          static_renderer::highlight_discr(this,summary,base_url_str,words);
-        html_content += summary;
       }
     else html_content += "<div>";
     char *cite_enc =  encode::html_encode(_url.c_str());
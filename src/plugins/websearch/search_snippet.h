@@ -35,6 +35,13 @@
 
 using sp::url_spec;
 
+namespace lsh
+{
+  class minhash_signature;
+  class sparse_vector;
+  class tfidf_index;
+}
+
 namespace seeks_plugins
 {
   class doc_type
@@ -161,12 +168,6 @@ namespace seeks_plugins
       // used in result page rendering.
       virtual bool is_se_enabled(const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters);
 
-      // static functions.
-      // highlights terms within the argument string.
-      // TODO: move to renderer ?
-      static void highlight_query(std::vector<std::string> &words,
-                                  std::string &str);
-
       // selects most discriminative terms in the snippet's vocabulary.
       void discr_words(const std::vector<std::string> &query_words,
                        std::set<std::string> &words) const;
@@ -233,8 +234,10 @@ namespace seeks_plugins
       // cache.
       std::string *_cached_content;
       std::vector<uint32_t> *_features; // temporary set of features, used for fast similarity check between snippets.
-      hash_map<uint32_t,float,id_hash_uint> *_features_tfidf; // tf-idf feature set for this snippet.
+      lsh::sparse_vector *_features_tfidf; // tf-idf feature set for this snippet.
+      const lsh::tfidf_index *_features_tfidf_index; // index the tf-idf features and bag of words come from.
       hash_map<uint32_t,std::string,id_hash_uint> *_bag_of_words;
+      lsh::minhash_signature *_fingerprint; // signature of the title and summary, for near-duplicate detection.
 
       // temporary flag used for marking snippets for which the
       // personalization system has found ranking information in local dataset.
@@ -378,12 +378,8 @@ namespace seeks_plugins
       {
         html_content += "<div>";
         char *enc_summary = encode::html_encode(_summary.c_str());
-        std::string summary = enc_summary;
+        static_renderer::highlight(this,enc_summary,base_url_str,html_content);
         free(enc_summary);
-        search_snippet::highlight_query(words,summary);
-        if (websearch::_wconfig->_extended_highlight)
-          static_renderer::highlight_discr(this,summary,base_url_str,words);
-        html_content += summary;
       }
     else html_content += "<div>";
 
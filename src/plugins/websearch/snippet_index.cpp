@@ -0,0 +1,140 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "snippet_index.h"
+#include "search_snippet.h"
+#include "query_context.h"
+#include "miscutil.h"
+#include "mem_utils.h"
+#ifdef FEATURE_IMG_WEBSEARCH_PLUGIN
+#include "img_search_snippet.h"
+#endif
+
+#include <string.h>
+#include <strings.h>
+
+using sp::miscutil;
+
+namespace seeks_plugins
+{
+
+  snippet_index::snippet_index()
+    :_nsnippets(0)
+  {
+  }
+
+  snippet_index::~snippet_index()
+  {
+    invalidate();
+  }
+
+  void snippet_index::invalidate()
+  {
+    hash_map<const char*,std::vector<search_snippet*>*,hash<const char*>,eqstr>::iterator chit;
+    hash_map<const char*,std::vector<search_snippet*>*,hash<const char*>,eqstr>::iterator hit
+    = _views.begin();
+    while (hit!=_views.end())
+      {
+        chit = hit;
+        ++hit;
+        const char *k = (*chit).first;
+        delete (*chit).second;
+        _views.erase(chit);
+        free_const(k);
+      }
+    _nsnippets = 0;
+  }
+
+  const std::vector<search_snippet*>& snippet_index::view(const std::vector<search_snippet*> &snippets,
+      const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters,
+      const bool &similarity,
+      const bool &img)
+  {
+    // views are dropped by the context on every change to the snippets,
+    // checking on their number guards against a missed notification.
+    if (_nsnippets != snippets.size())
+      {
+        invalidate();
+        _nsnippets = snippets.size();
+      }
+
+    // the engines selection is the only parameter the engine filter depends on.
+    const char *engines = miscutil::lookup(parameters,"engines");
+    const char *safesearch_p = miscutil::lookup(parameters,"safesearch");
+    bool safesearch_off = safesearch_p && strcasecmp(safesearch_p,"on") != 0;
+    std::string key = std::string(engines ? engines : "")
+                      + (safesearch_off ? "|s0" : "|s1")
+                      + (similarity ? "|m1" : "|m0")
+                      + (img ? "|i1" : "|i0");
+
+    hash_map<const char*,std::vector<search_snippet*>*,hash<const char*>,eqstr>::const_iterator hit;
+    if ((hit=_views.find(key.c_str()))!=_views.end())
+      return *(*hit).second;
+
+    std::vector<search_snippet*> *v = new std::vector<search_snippet*>();
+    snippet_index::filter(snippets,parameters,similarity,img,*v);
+    _views.insert(std::pair<const char*,std::vector<search_snippet*>*>(strdup(key.c_str()),v));
+    return *v;
+  }
+
+  void snippet_index::filter(const std::vector<search_snippet*> &snippets,
+                             const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters,
+                             const bool &similarity,
+                             const bool &img,
+                             std::vector<search_snippet*> &filtered)
+  {
+    // checks for safe snippets (for now, only used for images).
+    const char* safesearch_p = miscutil::lookup(parameters,"safesearch");
+    bool safesearch_off = false;
+    if (safesearch_p)
+      safesearch_off = strcasecmp(safesearch_p,"on") == 0 ? false : true;
+
+    size_t ssize = snippets.size();
+    for (size_t i=0; i<ssize; i++)
+      {
+        search_snippet *sp = snippets[i];
+        if (sp->_doc_type == doc_type::REJECTED)
+          continue;
+#ifdef FEATURE_IMG_WEBSEARCH_PLUGIN
+        if (img && sp->_doc_type != seeks_img_doc_type::IMAGE)
+          continue;
+#endif
+        if (!sp->is_se_enabled(parameters))
+          continue;
+        if (!safesearch_off && !sp->_safe)
+          continue;
+        if (similarity && sp->_seeks_ir <= 0)
+          continue;
+        filtered.push_back(sp);
+      }
+  }
+
+  const std::vector<search_snippet*>& snippet_index::ranked(const std::vector<search_snippet*> &snippets,
+      const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters,
+      const bool &similarity,
+      const bool &img,
+      std::vector<search_snippet*> &buffer)
+  {
+    query_context *qc = snippets.empty() ? NULL : snippets.at(0)->_qc;
+    if (qc && &snippets == &qc->_cached_snippets)
+      return qc->_snippets_index.view(snippets,parameters,similarity,img);
+    snippet_index::filter(snippets,parameters,similarity,img,buffer);
+    return buffer;
+  }
+
+} /* end of namespace. */
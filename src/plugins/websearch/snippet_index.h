@@ -0,0 +1,117 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SNIPPET_INDEX_H
+#define SNIPPET_INDEX_H
+
+#include "stl_hash.h"
+
+#include <vector>
+#include <algorithm>
+
+namespace seeks_plugins
+{
+  class search_snippet;
+
+  /**
+   * \brief rank ordered index over the cached snippets of a query context.
+   *
+   * Snippets are sorted incrementally: the leading snippets that are still
+   * in order are left in place, and only the remaining ones are sorted and
+   * merged in, so that an expansion that brings in a few results does not
+   * re-sort the whole cache.
+   *
+   * On top of the ranked snippets, the index keeps views of the snippets that
+   * pass the rendering filters (selected engines, safe search, similarity),
+   * one per combination of filters. A page of results is a slice of a view.
+   * Views are built on first use, and are dropped whenever snippets are added,
+   * removed, reordered or have their filtered attributes changed.
+   */
+  class snippet_index
+  {
+    public:
+      snippet_index();
+
+      ~snippet_index();
+
+      /**
+       * \brief sorts snippets with the same result as std::stable_sort.
+       * The longest prefix of snippets that is in order is kept, the snippets
+       * that follow are sorted and merged into it.
+       * \return true if the snippets were not already in order.
+       */
+      template<class Compare>
+      static bool sort(std::vector<search_snippet*> &snippets, Compare cmp)
+      {
+        size_t p = 1;
+        while (p < snippets.size() && !cmp(snippets[p],snippets[p-1]))
+          ++p;
+        if (p >= snippets.size())
+          return false;
+        std::vector<search_snippet*>::iterator mid = snippets.begin() + p;
+        std::stable_sort(mid,snippets.end(),cmp);
+        std::inplace_merge(snippets.begin(),mid,snippets.end(),cmp);
+        return true;
+      }
+
+      /**
+       * \brief drops the views.
+       */
+      void invalidate();
+
+      /**
+       * \brief the snippets that pass the rendering filters set by parameters,
+       *        in the order of snippets. The view is built if needed.
+       * \param snippets the indexed snippets, i.e. the context's cached snippets.
+       * \param similarity whether only snippets with a similarity score are retained.
+       * \param img whether only image snippets are retained.
+       */
+      const std::vector<search_snippet*>& view(const std::vector<search_snippet*> &snippets,
+          const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters,
+          const bool &similarity,
+          const bool &img=false);
+
+      /**
+       * \brief fills up filtered with the snippets that pass the rendering filters
+       *        set by parameters, in order.
+       */
+      static void filter(const std::vector<search_snippet*> &snippets,
+                         const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters,
+                         const bool &similarity,
+                         const bool &img,
+                         std::vector<search_snippet*> &filtered);
+
+      /**
+       * \brief the filtered snippets for rendering: the view from the context's
+       *        index if snippets are the context's cached snippets, snippets
+       *        filtered into buffer otherwise.
+       */
+      static const std::vector<search_snippet*>& ranked(const std::vector<search_snippet*> &snippets,
+          const hash_map<const char*,const char*,hash<const char*>,eqstr> *parameters,
+          const bool &similarity,
+          const bool &img,
+          std::vector<search_snippet*> &buffer);
+
+    private:
+      hash_map<const char*,std::vector<search_snippet*>*,hash<const char*>,eqstr> _views; /**< views, by filters. */
+      size_t _nsnippets; /**< number of snippets the views were built from. */
+  };
+
+} /* end of namespace. */
+
+#endif
@@ -17,6 +17,7 @@
  */
 
 #include "sort_rank.h"
+#include "snippet_index.h"
 #include "seeks_snippet.h"
 #include "websearch.h"
 #include "content_handler.h"
@@ -58,7 +59,7 @@ namespace seeks_plugins
   void sort_rank::sort_merge_and_rank_snippets(query_context *qc, std::vector<search_snippet*> &snippets,
       const hash_map<const char*, const char*, hash<const char*>, eqstr> *parameters)
   {
-    static double st = 0.9; // similarity threshold.
+    static double st = CONTENT_FINGERPRINT_MIN_SIMILARITY; // similarity threshold.
 
     bool content_analysis = websearch::_wconfig->_content_analysis;
     const char *ca = miscutil::lookup(parameters,"content_analysis");
@@ -79,14 +80,16 @@ namespace seeks_plugins
          * for strings, it is set to 100. Therefore, k should be set accordingly,
          * that is below 100 and in proportion to the 'fuzziness' necessary for
          * k-nearest neighbors computation.
+         * The system does not depend on the query, and is shared by all queries.
          */
-        qc->_lsh_ham = new LSHSystemHamming(55,5);
+        qc->_lsh_ham = LSHSystemHamming::getShared(55,5);
         qc->_ulsh_ham = new LSHUniformHashTableHamming(qc->_lsh_ham,
             websearch::_wconfig->_Nr*3*websearch::_wconfig->_se_enabled.size());
       }
 
     std::vector<search_snippet*>::iterator it = snippets.begin();
     search_snippet *c_sp = NULL;
+    bool changed = false; // whether snippets were merged, added or removed.
     while (it != snippets.end())
       {
         search_snippet *sp = (*it);
@@ -96,6 +99,7 @@ namespace seeks_plugins
 
         if (sp->_new)
           {
+            changed = true;
             if ((c_sp = qc->get_cached_snippet(sp->_id))!=NULL)
               {
                 // merging snippets.
@@ -140,6 +144,7 @@ namespace seeks_plugins
                           }
 
                         // Beware: second url (from sp) is the one to be possibly deleted!
+                        // Texts are compared by fingerprint, no content is fetched.
                         bool same = content_handler::has_same_content(qc,comp_sp,sp,st);
 
                         if (same)
@@ -156,6 +161,24 @@ namespace seeks_plugins
                   } // end if mres empty.
                 if (!sp)
                   continue;
+
+                // near-identical text under unrelated urls and titles.
+                std::vector<uint32_t> dup_ids;
+                qc->_fingerprints.find(content_handler::snippet_fingerprint(sp),st,dup_ids);
+                for (size_t d=0; d<dup_ids.size(); d++)
+                  {
+                    search_snippet *comp_sp = qc->get_cached_snippet(dup_ids[d]);
+                    if (comp_sp) // snippets may have left the cache.
+                      {
+                        comp_sp->merge_snippets(sp);
+                        it = snippets.erase(it);
+                        delete sp;
+                        sp = NULL;
+                        break;
+                      }
+                  }
+                if (!sp)
+                  continue;
               }
             // if we do not accept cross query insertion, just discard those results.
             if (!websearch::_wconfig->_cross_query_ri
@@ -185,6 +208,7 @@ namespace seeks_plugins
                 std::string lctitle = sp->_title;
                 miscutil::to_lower(lctitle);
                 qc->_ulsh_ham->add(lctitle,qc->_lsh_ham->_Ld);
+                qc->_fingerprints.add(content_handler::snippet_fingerprint(sp),sp->_id);
               }
 
           } // end if new.
@@ -192,8 +216,10 @@ namespace seeks_plugins
         ++it;
       } // end while.
 
-    // sort by rank, date or activiy.
-    sort_rank::sort_snippets(snippets,parameters);
+    // sort by rank, date or activiy, and drop the rendering views
+    // if the ranked snippets have changed.
+    if (sort_rank::sort_snippets(snippets,parameters) || changed)
+      qc->_snippets_index.invalidate();
 
     //debug
     /* std::cerr << "[Debug]: sorted result snippets:\n";
@@ -207,41 +233,37 @@ namespace seeks_plugins
     //debug
   }
 
-  void sort_rank::sort_snippets(std::vector<search_snippet*> &snippets,
+  bool sort_rank::sort_snippets(std::vector<search_snippet*> &snippets,
                                 const hash_map<const char*, const char*, hash<const char*>, eqstr> *parameters)
   {
     // sort by rank, date or activiy.
+    // snippets that are already in order, e.g. from a previous page, are only
+    // merged with the others.
     const char *order = miscutil::lookup(parameters,"order");
     if (!order || strcmpic(order,"rank")==0)
-      std::stable_sort(snippets.begin(),snippets.end(),
-                       search_snippet::max_seeks_rank);
+      return snippet_index::sort(snippets,search_snippet::max_seeks_rank);
     else if (strcmpic(order,"new-date")==0)
       {
-        std::stable_sort(snippets.begin(),snippets.end(),
-                         search_snippet::new_date);
+        return snippet_index::sort(snippets,search_snippet::new_date);
       }
     else if (strcmpic(order,"old-date")==0)
       {
-        std::stable_sort(snippets.begin(),snippets.end(),
-                         search_snippet::old_date);
+        return snippet_index::sort(snippets,search_snippet::old_date);
       }
     else if (strcmpic(order,"new-activity")==0)
       {
-        std::stable_sort(snippets.begin(),snippets.end(),
-                         search_snippet::new_activity);
+        return snippet_index::sort(snippets,search_snippet::new_activity);
       }
     else if (strcmpic(order,"old-activity")==0)
       {
-        std::stable_sort(snippets.begin(),snippets.end(),
-                         search_snippet::old_activity);
+        return snippet_index::sort(snippets,search_snippet::old_activity);
       }
     else
       {
         // log error, and default to max seeks rank ordering.
         errlog::log_error(LOG_LEVEL_ERROR,"wrong search result order parameter %s, ordering by seeks rank as default",
                           order);
-        std::stable_sort(snippets.begin(),snippets.end(),
-                         search_snippet::max_seeks_rank);
+        return snippet_index::sort(snippets,search_snippet::max_seeks_rank);
       }
   }
 
@@ -281,6 +303,7 @@ namespace seeks_plugins
 
     // sort snippets according to computed scores.
     std::stable_sort(sorted_snippets.begin(),sorted_snippets.end(),search_snippet::max_seeks_ir);
+    qc->_snippets_index.invalidate();
   }
 
   void sort_rank::group_by_types(query_context *qc,
@@ -333,8 +356,8 @@ namespace seeks_plugins
           swf = false;
       }
     cfp->personalize(qc,true,cf::select_p2p_or_local(parameters),expansion-1,swf);
-    std::stable_sort(qc->_cached_snippets.begin(),qc->_cached_snippets.end(),
-                     search_snippet::max_seeks_rank);
+    snippet_index::sort(qc->_cached_snippets,search_snippet::max_seeks_rank);
+    qc->_snippets_index.invalidate(); // personalized ranks and flags.
   }
 #endif
 
@@ -51,7 +51,8 @@ namespace seeks_plugins
       static void sort_merge_and_rank_snippets(query_context *qc, std::vector<search_snippet*> &snippets,
           const hash_map<const char*, const char*, hash<const char*>, eqstr> *parameters);
 
-      static void sort_snippets(std::vector<search_snippet*> &snippets,
+      // sort snippets by the order parameter, returns true if their order has changed.
+      static bool sort_snippets(std::vector<search_snippet*> &snippets,
                                 const hash_map<const char*, const char*, hash<const char*>, eqstr> *parameters);
 
       static void score_and_sort_by_similarity(query_context *qc, const char *id_str,
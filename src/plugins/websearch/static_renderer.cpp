@@ -18,6 +18,7 @@
 
 #include "static_renderer.h"
 #include "seeks_snippet.h"
+#include "snippet_index.h"
 #include "mem_utils.h"
 #include "plugin_manager.h"
 #include "cgi.h"
@@ -55,29 +56,35 @@ using lsh::Bucket;
 
 namespace seeks_plugins
 {
-  void static_renderer::highlight_discr(const search_snippet *sp,
-                                        std::string &str, const std::string &base_url_str,
-                                        const std::vector<std::string> &query_words)
+  void static_renderer::highlight(const search_snippet *sp,
+                                  const char *str, const std::string &base_url_str,
+                                  std::string &out)
   {
-    // select discriminant words.
-    std::set<std::string> words;
-    sp->discr_words(query_words,words);
+    if (!websearch::_wconfig->_extended_highlight)
+      {
+        sp->_qc->_highlighter.highlight(str,strlen(str),out);
+        return;
+      }
 
-    // highlighting.
+    // select discriminant words, and add them to the query terms.
+    std::set<std::string> words;
+    sp->discr_words(sp->_qc->_query_words,words);
+    highlighter hl(sp->_qc->_highlighter);
     std::set<std::string>::const_iterator sit = words.begin();
     while(sit!=words.end())
       {
         if ((*sit).length() > 2)
           {
             char *wenc = encode::url_encode((*sit).c_str());
-            std::string rword = " " + (*sit) + " ";
-            std::string bold_str = "<span class=\"highlight\"><a href=\"" + base_url_str + "/search?q=" + sp->_qc->_url_enc_query
-                                   + "+" + std::string(wenc) + "&amp;page=1&amp;expansion=1&amp;lang=" + sp->_qc->_auto_lang + "&amp;ui=stat\">" + rword + "</a></span>";
+            hl.add_term((*sit),"<span class=\"highlight\"><a href=\"" + base_url_str + "/search?q=" + sp->_qc->_url_enc_query
+                        + "+" + std::string(wenc) + "&amp;page=1&amp;expansion=1&amp;lang=" + sp->_qc->_auto_lang + "&amp;ui=stat\">",
+                        "</a></span>");
             free(wenc);
-            miscutil::ci_replace_in_string(str,rword,bold_str);
           }
         ++sit;
       }
+    hl.compile();
+    hl.highlight(str,strlen(str),out);
   }
 
   void static_renderer::render_query(const hash_map<const char*, const char*, hash<const char*>, eqstr> *parameters,
@@ -237,12 +244,6 @@ namespace seeks_plugins
     if (rpp_str)
       rpp = atoi(rpp_str);
 
-    // checks for safe snippets (for now, only used for images).
-    const char* safesearch_p = miscutil::lookup(parameters,"safesearch");
-    bool safesearch_off = false;
-    if (safesearch_p)
-      safesearch_off = strcasecmp(safesearch_p,"on") == 0 ? false : true;
-
     not_end = false;
     bool only_tweets = true; // required for rendering the correct 'content_analysi' value.
     std::string snippets_str;
@@ -253,41 +254,26 @@ namespace seeks_plugins
         if (snippets.at(0)->_seeks_ir > 0)
           similarity = true;
 
+        // filtered snippets, in order (safe search, engines, images, similarity).
+        std::vector<search_snippet*> buffer;
+        const std::vector<search_snippet*> &ranked
+        = snippet_index::ranked(snippets,parameters,similarity,img,buffer);
+
         // proceed with rendering.
-        int ssize = snippets.size();
+        size_t ssize = ranked.size();
         size_t snisize = std::min(current_page*rpp,(int)ssize);
         size_t snistart = (current_page-1) * rpp;
-        size_t count = 0;
 
-        for (int i=0; i<ssize; i++)
+        for (size_t i=0; i<snisize; i++)
           {
-            if (snippets.at(i)->_doc_type == doc_type::REJECTED)
-              continue;
-#ifdef FEATURE_IMG_WEBSEARCH_PLUGIN
-            if (img && snippets.at(i)->_doc_type != seeks_img_doc_type::IMAGE)
-              continue;
-#endif
-            if (!snippets.at(i)->is_se_enabled(parameters))
-              continue;
-            if (!safesearch_off && !snippets.at(i)->_safe)
-              continue;
-            if (only_tweets && snippets.at(i)->_doc_type != seeks_doc_type::TWEET)
+            if (only_tweets && ranked.at(i)->_doc_type != seeks_doc_type::TWEET)
               only_tweets = false;
-
-            if (!similarity || snippets.at(i)->_seeks_ir > 0)
-              {
-                if (count >= snistart)
-                  snippets_str += snippets.at(i)->to_html(snippets.at(i)->_qc->_query_words,base_url_str,
-                                                          parameters);
-                count++;
-              }
-            if (count == snisize)
-              {
-                if (i < ssize-1)
-                  not_end = true;
-                break; // end list here.
-              }
+            if (i >= snistart)
+              snippets_str += ranked.at(i)->to_html(ranked.at(i)->_qc->_query_words,base_url_str,
+                                                    parameters);
           }
+        if (snisize < ssize)
+          not_end = true;
       }
 
     miscutil::add_map_entry(exports,"search_snippets",1,snippets_str.c_str(),1);
@@ -356,7 +342,7 @@ namespace seeks_plugins
         if (!(*chit).second->_cpoints.empty())
           {
             cluster *cl = (*chit).second;
-            hash_map<uint32_t,hash_map<uint32_t,float,id_hash_uint>*,id_hash_uint>::const_iterator hit
+            hash_map<uint32_t,sparse_vector*,id_hash_uint>::const_iterator hit
             = cl->_cpoints.begin();
             while (hit!=cl->_cpoints.end())
               {
@@ -411,7 +397,7 @@ namespace seeks_plugins
         cluster *cl = (*chit).second;
         std::vector<search_snippet*> snippets;
         snippets.reserve(cl->_cpoints.size());
-        hash_map<uint32_t,hash_map<uint32_t,float,id_hash_uint>*,id_hash_uint>::const_iterator hit
+        hash_map<uint32_t,sparse_vector*,id_hash_uint>::const_iterator hit
         = cl->_cpoints.begin();
         while (hit!=cl->_cpoints.end())
           {
@@ -912,14 +898,25 @@ namespace seeks_plugins
     if (mode > 1)
       return SP_ERR_OK; // wrong mode, do nothing.
 
+    std::vector<search_snippet*> snippets;
+    static_renderer::order_neighbors(qc,mode,snippets);
+
+    // static rendering.
+    return static_renderer::render_result_page_static(snippets,csp,rsp,parameters,qc);
+  }
+
+  void static_renderer::order_neighbors(query_context *qc, const int &mode,
+                                        std::vector<search_snippet*> &snippets)
+  {
     hash_map<uint32_t,search_snippet*,id_hash_uint> hsnippets;
     hash_map<uint32_t,search_snippet*,id_hash_uint>::iterator hit;
     size_t nsnippets = qc->_cached_snippets.size();
 
     /**
      * Instanciate an LSH uniform hashtable. Parameters are adhoc, based on experience.
+     * The LSH system is shared by all queries and is not to be deleted.
      */
-    LSHSystemHamming *lsh_ham = new LSHSystemHamming(7,30);
+    const LSHSystemHamming *lsh_ham = LSHSystemHamming::getShared(7,30);
     LSHUniformHashTableHamming ulsh_ham(lsh_ham,nsnippets);
 
     for (size_t i=0; i<nsnippets; i++)
@@ -986,7 +983,6 @@ namespace seeks_plugins
             ++mit;
           }
       }
-    std::vector<search_snippet*> snippets;
     snippets.reserve(hsnippets.size());
     hit = hsnippets.begin();
     while (hit!=hsnippets.end())
@@ -995,12 +991,6 @@ namespace seeks_plugins
         ++hit;
       }
     std::sort(snippets.begin(),snippets.end(),search_snippet::max_seeks_ir);
-
-    // destroy lsh db.
-    delete lsh_ham;
-
-    // static rendering.
-    return static_renderer::render_result_page_static(snippets,csp,rsp,parameters,qc);
   }
 
 } /* end of namespace. */
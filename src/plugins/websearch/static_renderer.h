@@ -28,9 +28,9 @@ namespace seeks_plugins
   {
     public:
       /*- rendering functions. -*/
-      static void highlight_discr(const search_snippet *sp,
-                                  std::string &str, const std::string &base_url_str,
-                                  const std::vector<std::string> &query_words);
+      static void highlight(const search_snippet *sp,
+                            const char *str, const std::string &base_url_str,
+                            std::string &out);
 
       static void render_query(const hash_map<const char*, const char*, hash<const char*>, eqstr> *parameters,
                                hash_map<const char*,const char*,hash<const char*>,eqstr> *exports,
@@ -142,6 +142,13 @@ namespace seeks_plugins
           const hash_map<const char*, const char*, hash<const char*>, eqstr> *parameters,
           query_context *qc, const int &mode);
 
+      /**
+       * \brief orders the cached snippets of qc so that each one is followed by
+       *        its neighbors, by URL (mode 0) or by title (mode 1).
+       */
+      static void order_neighbors(query_context *qc, const int &mode,
+                                  std::vector<search_snippet*> &snippets);
+
       /* static sp_err render_clustered_types_page(client_state *csp, http_response *rsp,
       					  const hash_map<const char*, const char*, hash<const char*>, eqstr> *parameters); */
   };
@@ -0,0 +1,114 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ **/
+
+/**
+ * Benchmark of the highlighting of query terms in snippet summaries, with one
+ * case-insensitive replacement pass per term, or with the highlighter built
+ * once per query, for queries of 1 to 8 terms.
+ */
+
+#include "highlighter.h"
+#include "miscutil.h"
+
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace seeks_plugins;
+using sp::miscutil;
+
+static const char *vocabulary[] =
+{
+  "search", "engine", "query", "results", "private", "peer", "network", "proxy",
+  "the", "and", "with", "for", "collaborative", "filtering", "distributed", "web",
+  "open", "source", "project", "users", "data", "page", "ranking", "personalized"
+};
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+  int nsnippets = argc > 1 ? atoi(argv[1]) : 1000;
+  size_t nvoc = sizeof(vocabulary) / sizeof(vocabulary[0]);
+
+  srand(1);
+  std::vector<std::string> summaries;
+  for (int s=0; s<nsnippets; s++)
+    {
+      std::string summary;
+      while (summary.length() < 240)
+        {
+          std::string word = vocabulary[rand() % nvoc];
+          if (rand() % 4 == 0)
+            word[0] = toupper(word[0]);
+          summary += word + (rand() % 8 == 0 ? ", " : " ");
+        }
+      summaries.push_back(summary);
+    }
+
+  printf("%6s %14s %14s %8s\n","terms","replace (ms)","automaton (ms)","speedup");
+  for (size_t nterms=1; nterms<=8; nterms*=2)
+    {
+      std::vector<std::string> words;
+      for (size_t w=0; w<nterms; w++)
+        words.push_back(vocabulary[(w * 7) % nvoc]);
+
+      // one replacement pass per term and per summary.
+      struct timeval tv_start;
+      gettimeofday(&tv_start,NULL);
+      size_t rlength = 0;
+      for (int s=0; s<nsnippets; s++)
+        {
+          std::string summary = summaries[s];
+          std::sort(words.begin(),words.end(),std::greater<std::string>());
+          for (size_t w=0; w<words.size(); w++)
+            miscutil::ci_replace_in_string(summary,words[w],"<b>" + words[w] + "</b>");
+          rlength += summary.length();
+        }
+      double replace_ms = elapsed_ms(tv_start);
+
+      // the highlighter, built once for the query.
+      gettimeofday(&tv_start,NULL);
+      highlighter hl;
+      for (size_t w=0; w<words.size(); w++)
+        hl.add_term(words[w],"<b>","</b>");
+      hl.compile();
+      std::string out;
+      size_t hlength = 0;
+      for (int s=0; s<nsnippets; s++)
+        {
+          out.clear();
+          hl.highlight(summaries[s],out);
+          hlength += out.length();
+        }
+      double hl_ms = elapsed_ms(tv_start);
+      if (rlength != hlength)
+        std::cerr << "output lengths differ: " << rlength << " / " << hlength << std::endl;
+      printf("%6d %14.3f %14.3f %7.2fx\n",(int)nterms,replace_ms,hl_ms,replace_ms / hl_ms);
+    }
+  return 0;
+}
@@ -0,0 +1,125 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ **/
+
+/**
+ * Benchmark of the clustering of snippets, with similarities bounded or
+ * all computed, for 2 to 10 clusters over 100 to 1000 snippets drawn from
+ * a set of topics. The size of the shared thread pool is given on the
+ * command line.
+ */
+
+#include "oskmeans.h"
+#include "thread_pool.h"
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace seeks_plugins;
+using sp::thread_pool;
+
+static void generate(std::vector<search_snippet*> &snippets, const int &nsnippets,
+                     const int &ntopics, const unsigned int &seed)
+{
+  srand(seed);
+  for (int s=0; s<nsnippets; s++)
+    {
+      search_snippet *sp = new search_snippet();
+      sp->_id = s + 1;
+      sp->_meta_rank = rand() % 5;
+      sp->_rank = s;
+      int topic = rand() % ntopics;
+      hash_map<uint32_t,float,id_hash_uint> features;
+      for (int w=0; w<30; w++)
+        {
+          uint32_t word = (rand() % 10 < 6) ? 10000 * (topic + 1) + rand() % 100 : rand() % 5000;
+          features[word] += 0.5 + rand() / (float)RAND_MAX;
+        }
+
+      // tf-idf weights sum up to one.
+      sparse_vector *f = new sparse_vector(features);
+      float total = 0.0;
+      for (size_t i=0; i<f->size(); i++)
+        total += f->_weights[i];
+      f->scale(1.0 / total);
+      sp->_features_tfidf = f;
+      snippets.push_back(sp);
+    }
+}
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+static double run(const std::vector<search_snippet*> &snippets, const short &K,
+                  const bool &pruning, const int &nruns,
+                  unsigned long &computed, short &iterations)
+{
+  struct timeval tv_start;
+  gettimeofday(&tv_start,NULL);
+  for (int r=0; r<nruns; r++)
+    {
+      oskmeans km(NULL,snippets,K);
+      km._pruning = pruning;
+      km.clusterize();
+      computed = km._computed;
+      iterations = km.iterations();
+    }
+  return elapsed_ms(tv_start) / nruns;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+    {
+      std::cout << "Usage: <number of threads, 0 for one per processor> [runs] [topics]\n";
+      exit(0);
+    }
+
+  thread_pool::set_shared_size(atoi(argv[1]));
+  int nruns = argc > 2 ? atoi(argv[2]) : 10;
+  int ntopics = argc > 3 ? atoi(argv[3]) : 8;
+
+  std::cout << thread_pool::shared()->size() << " threads, " << ntopics << " topics\n";
+  printf("%9s %3s %5s %14s %10s %14s %10s %8s\n","snippets","K","iter",
+         "all (ms)","sims","bounded (ms)","sims","speedup");
+
+  int sizes[] = { 100, 300, 1000 };
+  for (int n=0; n<3; n++)
+    {
+      std::vector<search_snippet*> snippets;
+      generate(snippets,sizes[n],ntopics,n+1);
+      for (short K=2; K<=10; K+=2)
+        {
+          unsigned long all_computed = 0, computed = 0;
+          short all_iterations = 0, iterations = 0;
+          double all_ms = run(snippets,K,false,nruns,all_computed,all_iterations);
+          double ms = run(snippets,K,true,nruns,computed,iterations);
+          printf("%9d %3d %5d %14.3f %10lu %14.3f %10lu %7.2fx\n",sizes[n],K,iterations,
+                 all_ms,all_computed,ms,computed,all_ms / ms);
+        }
+      for (size_t s=0; s<snippets.size(); s++)
+        delete snippets[s];
+    }
+  return 0;
+}
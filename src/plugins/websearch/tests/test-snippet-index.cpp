@@ -0,0 +1,107 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ **/
+
+/**
+ * Benchmark of the rendering of a page of results from a context's cached
+ * snippets, by sorting and scanning all snippets on every request, or from
+ * the ranked snippet index and its views.
+ */
+
+#include "snippet_index.h"
+#include "json_renderer.h"
+#include "query_context.h"
+#include "seeks_snippet.h"
+#include "websearch.h"
+#include "miscutil.h"
+
+#include <iostream>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace seeks_plugins;
+using sp::miscutil;
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+  int nruns = argc > 1 ? atoi(argv[1]) : 100;
+
+  websearch::_wconfig = new websearch_configuration("not a real filename");
+  websearch::_wconfig->_se_enabled = feeds("dummy","URL1");
+  websearch::_wconfig->_se_default = feeds("dummy","URL1");
+  websearch::_wconfig->_se_enabled.add_feed("dummy","URL2");
+  websearch::_wconfig->_se_default.add_feed("dummy","URL2");
+
+  hash_map<const char*,const char*,hash<const char*>,eqstr> parameters;
+  parameters.insert(std::pair<const char*,const char*>("engines","dummy"));
+
+  printf("%9s %14s %14s %8s\n","snippets","scan (ms)","index (ms)","speedup");
+  srand(1);
+  query_context qc;
+  int sizes[] = { 100, 500, 1000, 2000 };
+  for (int n=0; n<4; n++)
+    {
+      // the context grows by expansions.
+      while (qc._cached_snippets.size() < (size_t)sizes[n])
+        {
+          int s = qc._cached_snippets.size();
+          seeks_snippet *sp = new seeks_snippet();
+          sp->set_url("http://www.example.com/" + miscutil::to_string(s));
+          sp->_engine = feeds("dummy",s % 2 ? "URL1" : "URL2");
+          sp->_seeks_rank = rand() % 100;
+          sp->_qc = &qc;
+          qc.add_to_cache(sp);
+        }
+      snippet_index::sort(qc._cached_snippets,search_snippet::max_seeks_rank);
+
+      // every request sorts the snippets and renders a page.
+      std::string json_str;
+      struct timeval tv_start;
+      gettimeofday(&tv_start,NULL);
+      for (int r=0; r<nruns; r++)
+        {
+          std::vector<search_snippet*> snippets = qc._cached_snippets;
+          std::stable_sort(snippets.begin(),snippets.end(),search_snippet::max_seeks_rank);
+          json_str.clear();
+          json_renderer::render_snippets("",5,snippets,json_str,&parameters);
+        }
+      double scan_ms = elapsed_ms(tv_start) / nruns;
+
+      gettimeofday(&tv_start,NULL);
+      for (int r=0; r<nruns; r++)
+        {
+          snippet_index::sort(qc._cached_snippets,search_snippet::max_seeks_rank);
+          json_str.clear();
+          json_renderer::render_snippets("",5,qc._cached_snippets,json_str,&parameters);
+        }
+      double index_ms = elapsed_ms(tv_start) / nruns;
+      printf("%9d %14.3f %14.3f %7.2fx\n",sizes[n],scan_ms,index_ms,scan_ms / index_ms);
+    }
+
+  delete websearch::_wconfig;
+  return 0;
+}
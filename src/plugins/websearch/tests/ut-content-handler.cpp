@@ -62,6 +62,23 @@ TEST(CTTest,feature_based_similarity_scoring_fail_feat)
   ASSERT_EQ(WB_ERR_NO_REF_SIM,code);
 }
 
+TEST(CTTest,has_same_content)
+{
+  search_snippet sp1, sp2, sp3, sp4;
+  sp1._title = "Seeks project";
+  sp1._summary = "Seeks is a free and open source search platform that captures, ranks and shares the results of your queries.";
+  sp2._title = "seeks project";
+  sp2._summary = "Seeks is a free and open source search platform that captures, ranks and shares the results of your queries...";
+  sp3._title = "Weather";
+  sp3._summary = "The weather in Paris will be sunny with a light breeze from the west, temperatures will rise slowly.";
+  sp4._title = "Seeks project";
+  EXPECT_TRUE(content_handler::has_same_content(NULL,&sp1,&sp2,CONTENT_FINGERPRINT_MIN_SIMILARITY));
+  EXPECT_FALSE(content_handler::has_same_content(NULL,&sp1,&sp3,CONTENT_FINGERPRINT_MIN_SIMILARITY));
+  EXPECT_FALSE(content_handler::has_same_content(NULL,&sp4,&sp4,CONTENT_FINGERPRINT_MIN_SIMILARITY)); // too short.
+  ASSERT_TRUE(sp1._fingerprint != NULL);
+  EXPECT_FALSE(sp1._fingerprint->empty());
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
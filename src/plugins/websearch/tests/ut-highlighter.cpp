@@ -0,0 +1,90 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ **/
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "highlighter.h"
+
+using namespace seeks_plugins;
+
+TEST(HighlighterTest, empty)
+{
+  highlighter hl;
+  std::string out;
+  hl.highlight("nothing to highlight",out);
+  EXPECT_EQ("nothing to highlight",out);
+}
+
+TEST(HighlighterTest, case_insensitive)
+{
+  highlighter hl;
+  hl.add_term("seeks","<b>","</b>");
+  hl.compile();
+  std::string out;
+  hl.highlight("Seeks is a search overlay, SEEKS and seeks.",out);
+  EXPECT_EQ("<b>Seeks</b> is a search overlay, <b>SEEKS</b> and <b>seeks</b>.",out);
+}
+
+TEST(HighlighterTest, words)
+{
+  highlighter hl;
+  hl.add_term("search","<b>","</b>");
+  hl.add_term("amp","<b>","</b>");
+  hl.compile();
+  std::string out;
+  hl.highlight("research &amp; searching, search.",out);
+  EXPECT_EQ("research &amp; searching, <b>search</b>.",out);
+
+  // multibyte characters are parts of words.
+  out.clear();
+  hl.highlight("search\xc3\xa9 search",out);
+  EXPECT_EQ("search\xc3\xa9 <b>search</b>",out);
+}
+
+TEST(HighlighterTest, leftmost_longest)
+{
+  highlighter hl;
+  hl.add_term("new","<b>","</b>");
+  hl.add_term("new-york","<i>","</i>");
+  hl.add_term("york","<b>","</b>");
+  hl.add_term("c++","<u>","</u>");
+  hl.compile();
+  std::string out;
+  hl.highlight("new-york, new york, c++ and c",out);
+  EXPECT_EQ("<i>new-york</i>, <b>new</b> <b>york</b>, <u>c++</u> and c",out);
+}
+
+TEST(HighlighterTest, duplicates)
+{
+  highlighter hl;
+  hl.add_term("Query","<b>","</b>");
+  hl.add_term("query","<i>","</i>");
+  hl.compile();
+  EXPECT_EQ(1u,hl.size());
+  std::string out = "<div>";
+  hl.highlight("a query",out);
+  EXPECT_EQ("<div>a <b>query</b>",out);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
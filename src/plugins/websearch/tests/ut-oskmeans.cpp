@@ -0,0 +1,172 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ **/
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "oskmeans.h"
+
+#include <stdlib.h>
+
+using namespace seeks_plugins;
+
+class OSKMeansTest : public testing::Test
+{
+  protected:
+    OSKMeansTest()
+    {
+    }
+
+    virtual ~OSKMeansTest()
+    {
+    }
+
+    /**
+     * snippets drawn from ntopics topics of 50 words, with a share of words
+     * taken from a common vocabulary, weighted as tf-idf features.
+     */
+    void generate(const int &nsnippets, const int &ntopics, const unsigned int &seed)
+    {
+      srand(seed);
+      for (int s=0; s<nsnippets; s++)
+        {
+          search_snippet *sp = new search_snippet();
+          sp->_id = s + 1;
+          sp->_meta_rank = rand() % 5;
+          sp->_rank = s;
+          int topic = s % ntopics;
+          hash_map<uint32_t,float,id_hash_uint> features;
+          for (int w=0; w<20; w++)
+            {
+              uint32_t word = (rand() % 10 < 7) ? 1000 * (topic + 1) + rand() % 50 : rand() % 1000;
+              features[word] += 0.5 + rand() / (float)RAND_MAX;
+            }
+          sp->_features_tfidf = new sparse_vector(features);
+          sp->_features_tfidf->scale(1.0 / sp->_features_tfidf->norm());
+          _snippets.push_back(sp);
+          _topics.push_back(topic);
+        }
+    }
+
+    virtual void TearDown()
+    {
+      for (size_t s=0; s<_snippets.size(); s++)
+        {
+          delete _snippets[s]->_features_tfidf;
+          _snippets[s]->_features_tfidf = NULL;
+          delete _snippets[s];
+        }
+    }
+
+    // cluster of every snippet, -1 when in the garbage cluster.
+    std::map<uint32_t,short> assignments(const oskmeans &km)
+    {
+      std::map<uint32_t,short> clusters;
+      for (short c=0; c<km._K; c++)
+        {
+          hash_map<uint32_t,sparse_vector*,id_hash_uint>::const_iterator hit
+          = km._clusters[c]._cpoints.begin();
+          while (hit!=km._clusters[c]._cpoints.end())
+            {
+              clusters.insert(std::pair<uint32_t,short>((*hit).first,c));
+              ++hit;
+            }
+        }
+      hash_map<uint32_t,sparse_vector*,id_hash_uint>::const_iterator hit
+      = km._garbage_cluster._cpoints.begin();
+      while (hit!=km._garbage_cluster._cpoints.end())
+        {
+          clusters.insert(std::pair<uint32_t,short>((*hit).first,-1));
+          ++hit;
+        }
+      return clusters;
+    }
+
+    std::vector<search_snippet*> _snippets;
+    std::vector<int> _topics;
+};
+
+TEST_F(OSKMeansTest, empty)
+{
+  oskmeans km(NULL,_snippets,4);
+  km.clusterize();
+  EXPECT_EQ(0,km.iterations());
+}
+
+TEST_F(OSKMeansTest, topics)
+{
+  generate(300,4,1);
+  oskmeans km(NULL,_snippets,4);
+  km.clusterize();
+  std::map<uint32_t,short> clusters = assignments(km);
+  ASSERT_EQ(300u,clusters.size());
+
+  // every topic falls into a single cluster.
+  std::map<int,short> topic_clusters;
+  for (size_t s=0; s<_snippets.size(); s++)
+    {
+      short c = clusters[_snippets[s]->_id];
+      std::map<int,short>::const_iterator mit = topic_clusters.find(_topics[s]);
+      if (mit == topic_clusters.end())
+        topic_clusters.insert(std::pair<int,short>(_topics[s],c));
+      else EXPECT_EQ((*mit).second,c);
+    }
+  EXPECT_LT(km.iterations(),20);
+}
+
+TEST_F(OSKMeansTest, pruning_is_exact)
+{
+  generate(500,6,2);
+  for (short K=2; K<=10; K+=4)
+    {
+      oskmeans full(NULL,_snippets,K);
+      full._pruning = false;
+      full.clusterize();
+
+      oskmeans km(NULL,_snippets,K);
+      km.clusterize();
+
+      EXPECT_EQ(full.iterations(),km.iterations());
+      EXPECT_TRUE(assignments(full) == assignments(km));
+      for (short c=0; c<K; c++)
+        {
+          EXPECT_TRUE(full._clusters[c]._c._features._ids == km._clusters[c]._c._features._ids);
+          EXPECT_TRUE(full._clusters[c]._c._features._weights == km._clusters[c]._c._features._weights);
+        }
+      EXPECT_LT(km._computed,full._computed);
+      EXPECT_GT(km._pruned,0u);
+    }
+}
+
+TEST_F(OSKMeansTest, deterministic)
+{
+  generate(200,3,3);
+  oskmeans km1(NULL,_snippets,5);
+  km1.clusterize();
+  oskmeans km2(NULL,_snippets,5);
+  km2.clusterize();
+  EXPECT_TRUE(assignments(km1) == assignments(km2));
+  EXPECT_EQ(km1._computed,km2._computed);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,161 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ **/
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "snippet_index.h"
+#include "json_renderer.h"
+#include "query_context.h"
+#include "seeks_snippet.h"
+#include "websearch.h"
+#include "miscutil.h"
+
+#include <stdlib.h>
+#include <algorithm>
+
+using namespace seeks_plugins;
+using sp::miscutil;
+
+class SnippetIndexTest : public testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+      websearch::_wconfig = new websearch_configuration("not a real filename");
+      websearch::_wconfig->_se_enabled = feeds("dummy","URL1");
+      websearch::_wconfig->_se_default = feeds("dummy","URL1");
+      websearch::_wconfig->_se_enabled.add_feed("dummy","URL2");
+      websearch::_wconfig->_se_default.add_feed("dummy","URL2");
+    }
+
+    virtual void TearDown()
+    {
+      delete websearch::_wconfig;
+    }
+
+    seeks_snippet* add_snippet(query_context &qc, const std::string &url,
+                               const std::string &engine_url, const double &seeks_rank)
+    {
+      seeks_snippet *sp = new seeks_snippet();
+      sp->set_url(url);
+      sp->_engine = feeds("dummy",engine_url);
+      sp->_seeks_rank = seeks_rank;
+      sp->_qc = &qc;
+      qc.add_to_cache(sp);
+      return sp;
+    }
+};
+
+TEST_F(SnippetIndexTest, sort_as_stable_sort)
+{
+  std::vector<search_snippet*> snippets;
+  for (size_t i=0; i<200; i++)
+    {
+      seeks_snippet *sp = new seeks_snippet();
+      sp->_seeks_rank = rand() % 10;
+      snippets.push_back(sp);
+    }
+
+  // snippets come in by batches, as with query expansions.
+  std::vector<search_snippet*> ranked;
+  for (size_t n=0; n<snippets.size(); n+=50)
+    {
+      ranked.insert(ranked.end(),snippets.begin()+n,snippets.begin()+n+50);
+      std::vector<search_snippet*> expected = ranked;
+      std::stable_sort(expected.begin(),expected.end(),search_snippet::max_seeks_rank);
+      EXPECT_TRUE(snippet_index::sort(ranked,search_snippet::max_seeks_rank));
+      EXPECT_TRUE(expected == ranked);
+      EXPECT_FALSE(snippet_index::sort(ranked,search_snippet::max_seeks_rank));
+    }
+
+  // a rank change.
+  ranked.at(100)->_seeks_rank = 100;
+  std::vector<search_snippet*> expected = ranked;
+  std::stable_sort(expected.begin(),expected.end(),search_snippet::max_seeks_rank);
+  EXPECT_TRUE(snippet_index::sort(ranked,search_snippet::max_seeks_rank));
+  EXPECT_TRUE(expected == ranked);
+
+  for (size_t i=0; i<snippets.size(); i++)
+    delete snippets.at(i);
+}
+
+TEST_F(SnippetIndexTest, view)
+{
+  query_context qc;
+  seeks_snippet *s1 = add_snippet(qc,"URL1","URL1",3);
+  seeks_snippet *s2 = add_snippet(qc,"URL2","URL2",2);
+  seeks_snippet *s3 = add_snippet(qc,"URL3","URL1",1);
+  s2->_doc_type = seeks_doc_type::REJECTED;
+
+  hash_map<const char*,const char*,hash<const char*>,eqstr> parameters;
+  const std::vector<search_snippet*> &v = qc._snippets_index.view(qc._cached_snippets,&parameters,false);
+  ASSERT_EQ(2u,v.size());
+  EXPECT_EQ(s1,v.at(0));
+  EXPECT_EQ(s3,v.at(1));
+
+  // views are kept until the snippets change.
+  EXPECT_EQ(&v,&qc._snippets_index.view(qc._cached_snippets,&parameters,false));
+
+  // selected engines.
+  parameters.insert(std::pair<const char*,const char*>("engines","dummy"));
+  const std::vector<search_snippet*> &ve = qc._snippets_index.view(qc._cached_snippets,&parameters,false);
+  EXPECT_EQ(2u,ve.size());
+
+  // new snippets drop the views.
+  seeks_snippet *s4 = add_snippet(qc,"URL4","URL2",4);
+  EXPECT_TRUE(snippet_index::sort(qc._cached_snippets,search_snippet::max_seeks_rank));
+  const std::vector<search_snippet*> &vn = qc._snippets_index.view(qc._cached_snippets,&parameters,false);
+  ASSERT_EQ(3u,vn.size());
+  EXPECT_EQ(s4,vn.at(0));
+  EXPECT_EQ(s1,vn.at(1));
+  EXPECT_EQ(s3,vn.at(2));
+
+  // similarity.
+  s1->_seeks_ir = 0.5;
+  const std::vector<search_snippet*> &vs = qc._snippets_index.view(qc._cached_snippets,&parameters,true);
+  ASSERT_EQ(1u,vs.size());
+  EXPECT_EQ(s1,vs.at(0));
+}
+
+TEST_F(SnippetIndexTest, render_page)
+{
+  query_context qc;
+  for (int i=0; i<25; i++)
+    add_snippet(qc,"URL" + miscutil::to_string(i),i%2 ? "URL1" : "URL2",25-i);
+  snippet_index::sort(qc._cached_snippets,search_snippet::max_seeks_rank);
+
+  hash_map<const char*,const char*,hash<const char*>,eqstr> parameters;
+  parameters.insert(std::pair<const char*,const char*>("rpp","10"));
+  std::string json_str;
+  EXPECT_EQ(SP_ERR_OK,json_renderer::render_snippets("",3,qc._cached_snippets,json_str,&parameters));
+  for (int i=0; i<25; i++)
+    {
+      std::string url = "\"URL" + miscutil::to_string(i) + "\"";
+      if (i < 20)
+        EXPECT_EQ(std::string::npos,json_str.find(url));
+      else EXPECT_NE(std::string::npos,json_str.find(url));
+    }
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
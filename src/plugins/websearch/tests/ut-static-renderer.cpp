@@ -0,0 +1,93 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ **/
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "static_renderer.h"
+#include "query_context.h"
+#include "search_snippet.h"
+#include "websearch.h"
+#include "websearch_configuration.h"
+#include "LSHSystemHamming.h"
+#include "errlog.h"
+
+using namespace seeks_plugins;
+using lsh::LSHSystemHamming;
+using sp::errlog;
+
+static std::string urls[4] =
+{
+  "http://www.seeks-project.info/wiki/index.php/Documentation",
+  "http://www.seeks-project.info/wiki/index.php/Download",
+  "http://sourceforge.net/projects/seeks",
+  "http://en.wikipedia.org/wiki/Seeks"
+};
+
+class StaticRendererTest : public testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+      errlog::init_log_module();
+      errlog::set_debug_level(LOG_LEVEL_FATAL | LOG_LEVEL_ERROR);
+      websearch::_wconfig = new websearch_configuration("");
+      for (int i=0; i<4; i++)
+        {
+          search_snippet *sp = new search_snippet();
+          sp->set_url(urls[i]);
+          sp->set_title("Seeks " + urls[i].substr(urls[i].find_last_of("/")+1));
+          _qc.add_to_cache(sp);
+          _qc.add_to_unordered_cache(sp);
+          _qc.add_to_unordered_cache_title(sp);
+        }
+    }
+
+    virtual void TearDown()
+    {
+      delete websearch::_wconfig;
+    }
+
+    query_context _qc;
+};
+
+// the LSH system is shared by all renderings, and outlives them.
+TEST_F(StaticRendererTest, neighbors_twice_shared_lsh)
+{
+  const LSHSystemHamming *lsh_ham = LSHSystemHamming::getShared(7,30);
+  for (int mode=0; mode<2; mode++)
+    {
+      std::vector<search_snippet*> snippets1,snippets2;
+      static_renderer::order_neighbors(&_qc,mode,snippets1);
+      ASSERT_EQ(lsh_ham,LSHSystemHamming::getShared(7,30));
+      static_renderer::order_neighbors(&_qc,mode,snippets2);
+      ASSERT_EQ(4,snippets1.size());
+      ASSERT_EQ(snippets1.size(),snippets2.size());
+      for (size_t i=0; i<snippets1.size(); i++)
+        EXPECT_EQ(snippets1.at(i),snippets2.at(i));
+    }
+  ASSERT_EQ(lsh_ham,LSHSystemHamming::getShared(7,30));
+  EXPECT_EQ(7u,lsh_ham->_k);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
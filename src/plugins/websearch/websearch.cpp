@@ -23,6 +23,7 @@
 #include "encode.h"
 #include "urlmatch.h"
 #include "errlog.h"
+#include "thread_pool.h"
 #include "query_interceptor.h"
 #include "proxy_configuration.h"
 #include "se_parser.h"
@@ -34,6 +35,7 @@
 #include "content_handler.h"
 #include "oskmeans.h"
 #include "mrf.h"
+#include "LSHSystemHamming.h"
 #include "charset_conv.h"
 
 #if defined(PROTOBUF) && defined(TC)
@@ -183,6 +185,10 @@ namespace seeks_plugins
 #endif
     _readable_plugin = plugin_manager::get_plugin("readable");
     _readable_plugin_activated= seeks_proxy::_config->is_plugin_activated("readable");
+
+    // builds the LSH systems used for regrouping results, off the query path.
+    lsh::LSHSystemHamming::getShared(55,5);
+    lsh::LSHSystemHamming::getShared(7,30);
   }
 
   void websearch::stop()
@@ -1131,7 +1137,7 @@ namespace seeks_plugins
     if (!pers)
       pers = websearch::_wconfig->_personalization ? "on" : "off";
     bool persf = (strcasecmp(pers,"on")==0);
-    pthread_t pers_thread = 0;
+    task_group pers_tasks(thread_pool::shared()); // joined on return.
     ws_thread_arg *pers_thread_arg = NULL;
 
     // expansion: we fetch more pages from every search engine.
@@ -1142,23 +1148,15 @@ namespace seeks_plugins
         expanded = true;
         mutex_lock(&qc->_qc_mutex);
         mutex_lock(&qc->_feeds_ack_mutex);
+        qc->_feeds_acked = false;
         try
           {
 #if defined(PROTOBUF) && defined(TC)
             if (persf)
               {
                 pers_thread_arg = new ws_thread_arg(new pers_arg(qc,parameters));
-                int perr = pthread_create(&pers_thread,NULL,
-                                          (void *(*)(void *))&websearch::perform_websearch_threaded,
-                                          pers_thread_arg);
-                if (perr != 0)
-                  {
-                    errlog::log_error(LOG_LEVEL_ERROR,"Error creating main personalization thread.");
-                    mutex_unlock(&qc->_qc_mutex);
-                    mutex_unlock(&qc->_feeds_ack_mutex);
-                    delete pers_thread_arg;
-                    return WB_ERR_THREAD;
-                  }
+                pers_tasks.run((void *(*)(void *))&websearch::perform_websearch_threaded,
+                               pers_thread_arg);
               }
 #endif
             qc->generate(csp,rsp,parameters,expanded);
@@ -1184,6 +1182,8 @@ namespace seeks_plugins
         // do not return if perso + err != no engine
         // instead signal all personalization threads that results may have
         // arrived.
+        qc->_feeds_acked = true;
+        cond_broadcast(&qc->_feeds_ack_cond);
         mutex_unlock(&qc->_feeds_ack_mutex);
         if (persf && err != SP_ERR_CGI_PARAMS)
           {
@@ -1194,12 +1194,8 @@ namespace seeks_plugins
 #if defined(PROTOBUF) && defined(TC)
             if (persf)
               {
-                while(!pers_thread_arg->_done)
-                  {
-                    cond_broadcast(&qc->_feeds_ack_cond);
-                  }
+                pers_tasks.wait();
                 delete pers_thread_arg;
-                pthread_join(pers_thread,NULL);
               }
 #endif
             return err;
@@ -1218,6 +1214,7 @@ namespace seeks_plugins
         expanded = true;
         mutex_lock(&qc->_qc_mutex);
         mutex_lock(&qc->_feeds_ack_mutex);
+        qc->_feeds_acked = false;
         try
           {
 #if defined(PROTOBUF) && defined(TC)
@@ -1225,17 +1222,8 @@ namespace seeks_plugins
             if (persf)
               {
                 pers_thread_arg = new ws_thread_arg(new pers_arg(qc,parameters));
-                int perr = pthread_create(&pers_thread,NULL,
-                                          (void *(*)(void *))&websearch::perform_websearch_threaded,
-                                          pers_thread_arg);
-                if (perr != 0)
-                  {
-                    errlog::log_error(LOG_LEVEL_ERROR,"Error creating main personalization thread.");
-                    mutex_unlock(&qc->_qc_mutex);
-                    mutex_unlock(&qc->_feeds_ack_mutex);
-                    delete pers_thread_arg;
-                    return WB_ERR_THREAD;
-                  }
+                pers_tasks.run((void *(*)(void *))&websearch::perform_websearch_threaded,
+                               pers_thread_arg);
               }
 #endif
             qc->generate(csp,rsp,parameters,expanded);
@@ -1261,6 +1249,8 @@ namespace seeks_plugins
         // do not return if personalization on.
         // instead signal all personalization threads that results may have
         // arrived.
+        qc->_feeds_acked = true;
+        cond_broadcast(&qc->_feeds_ack_cond);
         mutex_unlock(&qc->_feeds_ack_mutex);
         if (persf && err != SP_ERR_CGI_PARAMS)
           {
@@ -1271,12 +1261,8 @@ namespace seeks_plugins
 #if defined(PROTOBUF) && defined(TC)
             if (persf)
               {
-                while(!pers_thread_arg->_done)
-                  {
-                    cond_broadcast(&qc->_feeds_ack_cond);
-                  }
+                pers_tasks.wait();
                 delete pers_thread_arg;
-                pthread_join(pers_thread,NULL);
               }
 #endif
             return err;
@@ -1306,15 +1292,11 @@ namespace seeks_plugins
 #endif
 
 #if defined(PROTOBUF) && defined(TC)
-    // signal personalization thread that we're done with external data sources.
-    if (persf && pers_thread && pers_thread_arg)
+    // wait for personalization, external data sources have been fetched.
+    if (persf && pers_thread_arg)
       {
-        while(!pers_thread_arg->_done)
-          {
-            cond_broadcast(&qc->_feeds_ack_cond);
-          }
+        pers_tasks.wait();
         delete pers_thread_arg;
-        pthread_join(pers_thread,NULL);
       }
 #endif
 
@@ -0,0 +1,164 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stylesheet_cache.h"
+#include "mem_utils.h"
+#include "errlog.h"
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include <string.h>
+#include <sys/stat.h>
+
+using sp::errlog;
+
+namespace seeks_plugins
+{
+
+  /*- xsl_stylesheet -*/
+  xsl_stylesheet::xsl_stylesheet(xsltStylesheetPtr style,
+                                 const std::string &content_type,
+                                 const time_t &mtime)
+    :_style(style),_content_type(content_type),_mtime(mtime),_refs(0),_cached(true)
+  {
+  }
+
+  xsl_stylesheet::~xsl_stylesheet()
+  {
+    xsltFreeStylesheet(_style); // frees the stylesheet document as well.
+  }
+
+  /*- stylesheet_cache -*/
+  stylesheet_cache::stylesheet_cache()
+  {
+    mutex_init(&_cache_mutex);
+  }
+
+  stylesheet_cache::~stylesheet_cache()
+  {
+    hash_map<const char*,xsl_stylesheet*,hash<const char*>,eqstr>::iterator chit;
+    hash_map<const char*,xsl_stylesheet*,hash<const char*>,eqstr>::iterator hit
+    = _stylesheets.begin();
+    while (hit!=_stylesheets.end())
+      {
+        chit = hit;
+        ++hit;
+        const char *k = (*chit).first;
+        delete (*chit).second;
+        _stylesheets.erase(chit);
+        free_const(k);
+      }
+    mutex_destroy(&_cache_mutex);
+  }
+
+  xsl_stylesheet* stylesheet_cache::acquire(const std::string &path)
+  {
+    struct stat st;
+    if (stat(path.c_str(),&st) != 0)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"cannot find stylesheet %s",path.c_str());
+        return NULL;
+      }
+
+    hash_map<const char*,xsl_stylesheet*,hash<const char*>,eqstr>::iterator hit;
+    mutex_lock(&_cache_mutex);
+    if ((hit=_stylesheets.find(path.c_str()))!=_stylesheets.end()
+        && (*hit).second->_mtime == st.st_mtime)
+      {
+        xsl_stylesheet *xs = (*hit).second;
+        xs->_refs++;
+        mutex_unlock(&_cache_mutex);
+        return xs;
+      }
+    mutex_unlock(&_cache_mutex);
+
+    // load outside the lock, so that other stylesheets remain available.
+    xsl_stylesheet *nxs = stylesheet_cache::load(path,st.st_mtime);
+    if (!nxs)
+      return NULL;
+
+    mutex_lock(&_cache_mutex);
+    if ((hit=_stylesheets.find(path.c_str()))!=_stylesheets.end())
+      {
+        xsl_stylesheet *xs = (*hit).second;
+        if (xs->_mtime == st.st_mtime)
+          {
+            // loaded concurrently.
+            xs->_refs++;
+            mutex_unlock(&_cache_mutex);
+            delete nxs;
+            return xs;
+          }
+        xs->_cached = false;
+        if (xs->_refs == 0)
+          delete xs;
+        (*hit).second = nxs;
+        errlog::log_error(LOG_LEVEL_INFO,"reloaded modified stylesheet %s",path.c_str());
+      }
+    else _stylesheets.insert(std::pair<const char*,xsl_stylesheet*>(strdup(path.c_str()),nxs));
+    nxs->_refs++;
+    mutex_unlock(&_cache_mutex);
+    return nxs;
+  }
+
+  void stylesheet_cache::release(xsl_stylesheet *xs)
+  {
+    mutex_lock(&_cache_mutex);
+    xs->_refs--;
+    bool del = !xs->_cached && xs->_refs == 0;
+    mutex_unlock(&_cache_mutex);
+    if (del)
+      delete xs;
+  }
+
+  xsl_stylesheet* stylesheet_cache::load(const std::string &path, const time_t &mtime)
+  {
+    xmlDocPtr stylesheet_doc = xmlParseFile(path.c_str());
+    if (!stylesheet_doc)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"cannot parse stylesheet %s",path.c_str());
+        return NULL;
+      }
+
+    // get the content type from the processing instruction.
+    std::string content_type = "Content-Type: text/xml";
+    xmlNodePtr root_element = xmlDocGetRootElement(stylesheet_doc);
+    for (xmlNodePtr cur_node = root_element ? root_element->children : NULL;
+         cur_node; cur_node = cur_node->next)
+      {
+        if (cur_node->type == XML_PI_NODE && !strcmp((char *)(cur_node->name), "Content-Type:"))
+          {
+            content_type = std::string((char*)cur_node->name);
+            if (cur_node->content)
+              content_type += std::string((char*)cur_node->content);
+          }
+      }
+
+    // compile the stylesheet, which takes ownership of the document.
+    xsltStylesheetPtr style = xsltParseStylesheetDoc(stylesheet_doc);
+    if (!style)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"cannot compile stylesheet %s",path.c_str());
+        xmlFreeDoc(stylesheet_doc);
+        return NULL;
+      }
+    return new xsl_stylesheet(style,content_type,mtime);
+  }
+
+} /* end of namespace. */
@@ -0,0 +1,92 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STYLESHEET_CACHE_H
+#define STYLESHEET_CACHE_H
+
+#include "stl_hash.h"
+#include "mutexes.h"
+
+#include <string>
+#include <time.h>
+
+#include <libxslt/xslt.h>
+#include <libxslt/xsltInternals.h>
+
+namespace seeks_plugins
+{
+
+  /**
+   * \brief a compiled stylesheet, shared by the transformations that use it.
+   */
+  class xsl_stylesheet
+  {
+    public:
+      xsl_stylesheet(xsltStylesheetPtr style,
+                     const std::string &content_type,
+                     const time_t &mtime);
+
+      ~xsl_stylesheet();
+
+    public:
+      xsltStylesheetPtr _style; /**< compiled stylesheet, read-only once compiled. */
+      std::string _content_type; /**< Content-Type header, from the stylesheet's processing instruction. */
+      time_t _mtime; /**< modification time of the stylesheet file when loaded. */
+      int _refs; /**< number of transformations using the stylesheet. */
+      bool _cached; /**< false once replaced in the cache by a newer version. */
+  };
+
+  /**
+   * \brief cache of compiled stylesheets, by file path.
+   *
+   * A stylesheet is loaded and compiled on first use, and reloaded when its
+   * file is modified. Compiled stylesheets are not modified by transformations,
+   * so that concurrent requests share them. A stylesheet that is reloaded
+   * while in use is freed when the last transformation releases it.
+   */
+  class stylesheet_cache
+  {
+    public:
+      stylesheet_cache();
+
+      ~stylesheet_cache();
+
+      /**
+       * \brief compiled stylesheet from file path, NULL if it cannot be read
+       *        or compiled. The stylesheet must be released after use.
+       */
+      xsl_stylesheet* acquire(const std::string &path);
+
+      /**
+       * \brief releases a stylesheet acquired from the cache.
+       */
+      void release(xsl_stylesheet *xs);
+
+      /**
+       * \brief loads and compiles a stylesheet, NULL on error.
+       */
+      static xsl_stylesheet* load(const std::string &path, const time_t &mtime);
+
+    private:
+      hash_map<const char*,xsl_stylesheet*,hash<const char*>,eqstr> _stylesheets;
+      sp_mutex_t _cache_mutex;
+  };
+
+} /* end of namespace. */
+
+#endif
@@ -0,0 +1,175 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ **/
+
+/**
+ * Benchmark of XSLT responses per second, with the stylesheet parsed and
+ * compiled for every response, or taken from the stylesheet cache, over
+ * result documents of 10 to 100 snippets. The cached stylesheet is also
+ * shared by the number of threads given on the command line.
+ */
+
+#include "stylesheet_cache.h"
+
+#include <libxslt/transform.h>
+#include <libxslt/xsltutils.h>
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+using namespace seeks_plugins;
+
+static const std::string stylesheet_file = "test-stylesheet-cache.xsl";
+
+static const char *stylesheet =
+  "<?xml version=\"1.0\"?>\n"
+  "<xsl:stylesheet version=\"1.0\" xmlns:xsl=\"http://www.w3.org/1999/XSL/Transform\">\n"
+  "<?Content-Type: text/html?>\n"
+  "<xsl:output method=\"html\"/>\n"
+  "<xsl:template match=\"/\"><html><body><ol><xsl:apply-templates select=\"//snippet\"/></ol></body></html></xsl:template>\n"
+  "<xsl:template match=\"snippet\"><li><a href=\"{@url}\"><xsl:value-of select=\"@title\"/></a>"
+  "<p><xsl:value-of select=\"@summary\"/></p>"
+  "<xsl:if test=\"@personalized='yes'\"><span class=\"pers\">*</span></xsl:if></li></xsl:template>\n"
+  "</xsl:stylesheet>\n";
+
+static xmlDocPtr results(const int &nsnippets)
+{
+  xmlDocPtr doc = xmlNewDoc(BAD_CAST "1.0");
+  xmlNodePtr root = xmlNewNode(NULL,BAD_CAST "result");
+  xmlDocSetRootElement(doc,root);
+  xmlNodePtr snippets = xmlNewChild(root,NULL,BAD_CAST "snippets",NULL);
+  for (int s=0; s<nsnippets; s++)
+    {
+      char url[64];
+      snprintf(url,sizeof(url),"http://www.example.com/%d",s);
+      xmlNodePtr sp = xmlNewChild(snippets,NULL,BAD_CAST "snippet",NULL);
+      xmlSetProp(sp,BAD_CAST "url",BAD_CAST url);
+      xmlSetProp(sp,BAD_CAST "title",BAD_CAST "Seeks, an open decentralized platform for collaborative search");
+      xmlSetProp(sp,BAD_CAST "summary",BAD_CAST "Seeks is a free and open technology for building decentralized "
+                 "social search, filtering and sharing of web contents.");
+      xmlSetProp(sp,BAD_CAST "personalized",BAD_CAST (s % 3 ? "no" : "yes"));
+    }
+  return doc;
+}
+
+static size_t respond(xsltStylesheetPtr style, xmlDocPtr doc)
+{
+  xmlDocPtr res_doc = xsltApplyStylesheet(style,doc,NULL);
+  xmlChar *buffer = NULL;
+  int length = 0;
+  xsltSaveResultToString(&buffer,&length,res_doc,style);
+  char *body = strdup((char*)buffer);
+  free(body);
+  xmlFree(buffer);
+  xmlFreeDoc(res_doc);
+  return length;
+}
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+static void quiet(void *ctx, const char *msg, ...)
+{
+}
+
+struct worker_arg
+{
+  stylesheet_cache *_cache;
+  xmlDocPtr _doc;
+  int _nresponses;
+};
+
+static void* worker(void *a)
+{
+  worker_arg *arg = static_cast<worker_arg*>(a);
+  for (int r=0; r<arg->_nresponses; r++)
+    {
+      xsl_stylesheet *xs = arg->_cache->acquire(stylesheet_file);
+      respond(xs->_style,arg->_doc);
+      arg->_cache->release(xs);
+    }
+  return NULL;
+}
+
+int main(int argc, char **argv)
+{
+  int nthreads = argc > 1 ? atoi(argv[1]) : 4;
+  int nresponses = argc > 2 ? atoi(argv[2]) : 500;
+
+  FILE *f = fopen(stylesheet_file.c_str(),"w");
+  fputs(stylesheet,f);
+  fclose(f);
+  xmlSetGenericErrorFunc(NULL,quiet); // PI names with a colon are reported by the parser.
+
+  printf("%9s %16s %16s %8s %18s\n","snippets","parsed (resp/s)","cached (resp/s)",
+         "speedup","threaded (resp/s)");
+  int sizes[] = { 10, 30, 100 };
+  for (int n=0; n<3; n++)
+    {
+      xmlDocPtr doc = results(sizes[n]);
+
+      // stylesheet parsed and compiled for every response.
+      struct timeval tv_start;
+      gettimeofday(&tv_start,NULL);
+      for (int r=0; r<nresponses; r++)
+        {
+          xsl_stylesheet *xs = stylesheet_cache::load(stylesheet_file,0);
+          respond(xs->_style,doc);
+          delete xs;
+        }
+      double parsed = nresponses * 1000.0 / elapsed_ms(tv_start);
+
+      // stylesheet from the cache.
+      stylesheet_cache cache;
+      gettimeofday(&tv_start,NULL);
+      for (int r=0; r<nresponses; r++)
+        {
+          xsl_stylesheet *xs = cache.acquire(stylesheet_file);
+          respond(xs->_style,doc);
+          cache.release(xs);
+        }
+      double cached = nresponses * 1000.0 / elapsed_ms(tv_start);
+
+      // cached stylesheet shared by concurrent responses.
+      std::vector<pthread_t> threads(nthreads);
+      worker_arg arg;
+      arg._cache = &cache;
+      arg._doc = doc;
+      arg._nresponses = nresponses;
+      gettimeofday(&tv_start,NULL);
+      for (int t=0; t<nthreads; t++)
+        pthread_create(&threads[t],NULL,worker,&arg);
+      for (int t=0; t<nthreads; t++)
+        pthread_join(threads[t],NULL);
+      double threaded = nthreads * nresponses * 1000.0 / elapsed_ms(tv_start);
+
+      printf("%9d %16.0f %16.0f %7.2fx %18.0f\n",sizes[n],parsed,cached,cached / parsed,threaded);
+      xmlFreeDoc(doc);
+    }
+  unlink(stylesheet_file.c_str());
+  return 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ **/
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "stylesheet_cache.h"
+
+#include <libxslt/transform.h>
+#include <libxslt/xsltutils.h>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <utime.h>
+
+using namespace seeks_plugins;
+
+static const std::string stylesheet_file = "ut-stylesheet-cache.xsl";
+
+static void write_stylesheet(const std::string &content_type, const std::string &text)
+{
+  FILE *f = fopen(stylesheet_file.c_str(),"w");
+  fprintf(f,"<?xml version=\"1.0\"?>\n"
+          "<xsl:stylesheet version=\"1.0\" xmlns:xsl=\"http://www.w3.org/1999/XSL/Transform\">\n");
+  if (!content_type.empty())
+    fprintf(f,"<?Content-Type: %s?>\n",content_type.c_str());
+  fprintf(f,"<xsl:output method=\"text\"/>\n"
+          "<xsl:template match=\"/\">%s<xsl:value-of select=\"/r\"/></xsl:template>\n"
+          "</xsl:stylesheet>\n",text.c_str());
+  fclose(f);
+}
+
+static std::string apply(xsl_stylesheet *xs)
+{
+  xmlDocPtr doc = xmlParseMemory("<r>seeks</r>",12);
+  xmlDocPtr res_doc = xsltApplyStylesheet(xs->_style,doc,NULL);
+  xmlChar *buffer = NULL;
+  int length = 0;
+  xsltSaveResultToString(&buffer,&length,res_doc,xs->_style);
+  std::string res((char*)buffer,length);
+  xmlFree(buffer);
+  xmlFreeDoc(res_doc);
+  xmlFreeDoc(doc);
+  return res;
+}
+
+class StylesheetCacheTest : public testing::Test
+{
+  protected:
+    virtual void TearDown()
+    {
+      unlink(stylesheet_file.c_str());
+    }
+};
+
+TEST_F(StylesheetCacheTest, acquire)
+{
+  write_stylesheet("text/plain","hello ");
+  stylesheet_cache cache;
+  xsl_stylesheet *xs = cache.acquire(stylesheet_file);
+  ASSERT_TRUE(xs != NULL);
+  EXPECT_EQ("Content-Type:text/plain",xs->_content_type);
+  EXPECT_EQ("hello seeks",apply(xs));
+  EXPECT_EQ(1,xs->_refs);
+
+  // compiled once.
+  EXPECT_EQ(xs,cache.acquire(stylesheet_file));
+  EXPECT_EQ(2,xs->_refs);
+  cache.release(xs);
+  cache.release(xs);
+  EXPECT_EQ(0,xs->_refs);
+}
+
+TEST_F(StylesheetCacheTest, default_content_type)
+{
+  write_stylesheet("","");
+  stylesheet_cache cache;
+  xsl_stylesheet *xs = cache.acquire(stylesheet_file);
+  ASSERT_TRUE(xs != NULL);
+  EXPECT_EQ("Content-Type: text/xml",xs->_content_type);
+  cache.release(xs);
+}
+
+TEST_F(StylesheetCacheTest, reload)
+{
+  write_stylesheet("text/plain","hello ");
+  stylesheet_cache cache;
+  xsl_stylesheet *xs = cache.acquire(stylesheet_file);
+  ASSERT_TRUE(xs != NULL);
+
+  // modified while in use.
+  write_stylesheet("text/plain","bye ");
+  struct utimbuf times;
+  times.actime = times.modtime = xs->_mtime + 1;
+  utime(stylesheet_file.c_str(),&times);
+  xsl_stylesheet *nxs = cache.acquire(stylesheet_file);
+  ASSERT_TRUE(nxs != NULL);
+  EXPECT_NE(xs,nxs);
+  EXPECT_EQ("bye seeks",apply(nxs));
+  EXPECT_FALSE(xs->_cached);
+  EXPECT_EQ("hello seeks",apply(xs)); // still usable until released.
+  cache.release(xs);
+  cache.release(nxs);
+}
+
+TEST_F(StylesheetCacheTest, errors)
+{
+  stylesheet_cache cache;
+  EXPECT_TRUE(cache.acquire("no-such-stylesheet.xsl") == NULL);
+  FILE *f = fopen(stylesheet_file.c_str(),"w");
+  fprintf(f,"<not a stylesheet");
+  fclose(f);
+  EXPECT_TRUE(cache.acquire(stylesheet_file) == NULL);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
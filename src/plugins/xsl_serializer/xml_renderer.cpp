@@ -23,6 +23,7 @@
 #include "cgi.h"
 #include "websearch.h"
 #include "query_context.h"
+#include "snippet_index.h"
 #include "xml_renderer_private.h"
 
 #ifdef FEATURE_IMG_WEBSEARCH_PLUGIN
@@ -378,47 +379,27 @@ namespace seeks_plugins
         if (snippets.at(0)->_seeks_ir > 0)
           similarity = true;
 
-        // checks for safe snippets (for now, only used for images).
-        const char* safesearch_p = miscutil::lookup(parameters,"safesearch");
-        bool safesearch_off = false;
-        if (safesearch_p)
-          safesearch_off = strcasecmp(safesearch_p,"on") == 0 ? false : true;
+        // filtered snippets, in order (safe search, engines, similarity).
+        std::vector<search_snippet*> buffer;
+        const std::vector<search_snippet*> &ranked
+        = snippet_index::ranked(snippets,parameters,similarity,false,buffer);
 
         // proceed with rendering.
         const char *rpp_str = miscutil::lookup(parameters,"rpp"); // results per page.
         int rpp = websearch::_wconfig->_Nr;
         if (rpp_str)
           rpp = atoi(rpp_str);
-        size_t ssize = snippets.size();
         int ccpage = current_page;
         if (ccpage <= 0)
           ccpage = 1;
-        size_t snisize = std::min(ccpage*rpp,(int)snippets.size());
+        size_t snisize = std::min(ccpage*rpp,(int)ranked.size());
         size_t snistart = (ccpage-1)*rpp;
-        size_t count = 0;
 
-        for (size_t i=0; i<ssize && !err; i++)
+        for (size_t i=snistart; i<snisize && !err; i++)
           {
-            if (snippets.at(i)->_doc_type == doc_type::REJECTED)
-              continue;
-            if (!snippets.at(i)->is_se_enabled(parameters))
-              continue;
-            if (!safesearch_off && !snippets.at(i)->_safe)
-              continue;
-            if (!similarity || snippets.at(i)->_seeks_ir > 0)
-              {
-                if (count >= snistart)
-                  {
-                    snippet_node=xmlNewNode(NULL,BAD_CAST "snippet");
-                    xmlAddChild(parent, snippet_node);
-                    err = snippets.at(i)->to_xml(has_thumbs,snippets.at(i)->_qc->_query_words, snippet_node);
-                  }
-                count++;
-              }
-            if (count == snisize)
-              {
-                break; // end here.
-              }
+            snippet_node=xmlNewNode(NULL,BAD_CAST "snippet");
+            xmlAddChild(parent, snippet_node);
+            err = ranked.at(i)->to_xml(has_thumbs,ranked.at(i)->_qc->_query_words, snippet_node);
           }
       }
     return err;
@@ -447,7 +428,7 @@ namespace seeks_plugins
         cluster *cl = (*chit).second;
         std::vector<search_snippet*> snippets;
         snippets.reserve(cl->_cpoints.size());
-        hash_map<uint32_t,hash_map<uint32_t,float,id_hash_uint>*,id_hash_uint>::const_iterator hit
+        hash_map<uint32_t,sparse_vector*,id_hash_uint>::const_iterator hit
         = cl->_cpoints.begin();
         while (hit!=cl->_cpoints.end())
           {
@@ -29,6 +29,7 @@ using namespace sp;
 
 namespace seeks_plugins
 {
+  stylesheet_cache* xsl_serializer::_stylesheets = NULL;
 
   xsl_serializer::xsl_serializer()
     :plugin()
@@ -38,10 +39,14 @@ namespace seeks_plugins
     _version_minor = "1";
     xmlSubstituteEntitiesDefault(1);
     xmlLoadExtDtdDefaultValue = 1;
+    if (!xsl_serializer::_stylesheets)
+      xsl_serializer::_stylesheets = new stylesheet_cache();
   }
 
   xsl_serializer::~xsl_serializer()
   {
+    delete xsl_serializer::_stylesheets;
+    xsl_serializer::_stylesheets = NULL;
     xsltCleanupGlobals();
     xmlCleanupParser();
   }
@@ -248,62 +253,39 @@ namespace seeks_plugins
                                  xmlDocPtr doc,
                                  const std::string stylesheet)
   {
-    xsltStylesheetPtr cur;
-    xmlDocPtr stylesheet_doc,res_doc;
-    xmlNodePtr root_element, cur_node;
-    char *ct=NULL;
-    xmlChar *buffer;
-    int length;
-
-    // parse the stylesheet as libxml2 Document
-    stylesheet_doc=xsl_serializer::get_stylesheet(stylesheet);
-    if (!stylesheet_doc)
+    xmlDocPtr res_doc;
+    xmlChar *buffer = NULL;
+    int length = 0;
+
+    // get the compiled stylesheet and its content type.
+    xsl_stylesheet *xs = xsl_serializer::_stylesheets->acquire(xsl_serializer::get_stylesheet_path(stylesheet));
+    if (!xs)
       return;
-    // get the content type
-    // Get the root element node
-    root_element = xmlDocGetRootElement(stylesheet_doc);
-    for (cur_node = root_element->children; cur_node; cur_node = cur_node->next)
+    miscutil::enlist(&rsp->_headers, xs->_content_type.c_str());
+
+    // apply the stylesheet
+    const char **params=NULL;
+    res_doc = xsltApplyStylesheet(xs->_style, doc, params);
+    if (res_doc)
       {
-        if (cur_node->type == XML_PI_NODE && !strcmp((char *)(cur_node->name), "Content-Type:"))
-          {
-            ct=strdup( (char *)cur_node->name);
-            strcat(ct, (char *)cur_node->content);
-            miscutil::enlist(&rsp->_headers, ct);
-          }
+        xsltSaveResultToString(&buffer, &length, res_doc, xs->_style);
+        xmlFreeDoc(res_doc);
       }
-
-    if (!ct)
+    xsl_serializer::_stylesheets->release(xs);
+    if (buffer)
       {
-        miscutil::enlist(&rsp->_headers, "Content-Type: text/xml");
+        rsp->_content_length = length;
+        rsp->_body = strdup((char *)buffer);
+        xmlFree(buffer);
       }
-
-    // prepare the xslt
-    cur = xsltParseStylesheetDoc(stylesheet_doc);
-
-    // apply the stylesheet
-    const char **params=NULL;
-    res_doc = xsltApplyStylesheet(cur, doc, params);
-    xsltSaveResultToString(&buffer, &length, res_doc, cur);
-    rsp->_content_length = length;
-    rsp->_body = strdup((char *)buffer);
-    free(buffer);
-    xsltFreeStylesheet(cur);
-    xmlFreeDoc(res_doc);
-    //xmlFreeDoc(stylesheet_doc);
   }
 
-
-  xmlDocPtr xsl_serializer::get_stylesheet(const std::string stylesheet)
+  std::string xsl_serializer::get_stylesheet_path(const std::string stylesheet)
   {
-    std::string stylesheet_path;
-    xmlDocPtr xslt;
-    // TODO : manage a cache of stylesheets
     if (seeks_proxy::_datadir.empty())
-      stylesheet_path = plugin_manager::_plugin_repository + "xsl_serializer/stylesheets/" + stylesheet + ".xsl";
+      return plugin_manager::_plugin_repository + "xsl_serializer/stylesheets/" + stylesheet + ".xsl";
     else
-      stylesheet_path = seeks_proxy::_datadir + "/plugins/xsl_serializer/stylesheets/" + stylesheet + ".xsl";
-    xslt=xmlParseFile(stylesheet_path.c_str());
-    return xslt;
+      return seeks_proxy::_datadir + "/plugins/xsl_serializer/stylesheets/" + stylesheet + ".xsl";
   }
 
   /* plugin registration. */
@@ -27,6 +27,7 @@
 #include "search_snippet.h"
 #include "query_context.h"
 #include "xsl_serializer_configuration.h"
+#include "stylesheet_cache.h"
 #include "miscutil.h"
 #include "mutexes.h"
 #include "clustering.h"
@@ -128,13 +129,14 @@ namespace seeks_plugins
                             xmlDocPtr doc,
                             const std::string stylesheet);
 
-      static xmlDocPtr get_stylesheet(const std::string stylesheet);
+      static std::string get_stylesheet_path(const std::string stylesheet);
 
 
     public:
       static xsl_serializer_configuration *_xslconfig;
       static hash_map<uint32_t,query_context*,id_hash_uint> _active_qcontexts;
       static double _cl_sec; // clock ticks per second.
+      static stylesheet_cache *_stylesheets; /**< compiled stylesheets. */
 
       /* dependent plugins. */
     public:
@@ -0,0 +1,513 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "connection_pool.h"
+#include "spsockets.h"
+#include "mem_utils.h"
+#include "errlog.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <assert.h>
+
+namespace sp
+{
+  /*- connection_stripe -*/
+  connection_stripe::connection_stripe()
+    :_lookups(0),_hits(0)
+  {
+    mutex_init(&_mutex);
+  }
+
+  connection_stripe::~connection_stripe()
+  {
+    hash_map<const char*,std::vector<reusable_connection*>*,hash<const char*>,eqstr>::iterator hit,hit2;
+    hit = _idle.begin();
+    while (hit!=_idle.end())
+      {
+        hit2 = hit;
+        ++hit;
+        const char *key = (*hit2).first;
+        delete (*hit2).second;
+        _idle.erase(hit2);
+        free_const(key);
+      }
+    mutex_destroy(&_mutex);
+  }
+
+  /*- connection_pool -*/
+  connection_pool::connection_pool(const size_t &capacity, const size_t &nstripes)
+    :_capacity(capacity),_size(0),_remembered(0),_rejected(0),_reaped(0),
+     _reaper_running(false),_reaper_stop(false),_reaper_interval(CONNECTION_POOL_REAP_INTERVAL)
+  {
+    size_t n = nstripes > 0 ? nstripes : 1;
+    _stripes.reserve(n);
+    for (size_t i=0; i<n; i++)
+      _stripes.push_back(new connection_stripe());
+    mutex_init(&_size_mutex);
+    mutex_init(&_reaper_mutex);
+    cond_init(&_reaper_cond);
+  }
+
+  connection_pool::~connection_pool()
+  {
+    stop_reaper();
+
+    for (size_t i=0; i<_stripes.size(); i++)
+      {
+        connection_stripe *cs = _stripes[i];
+
+        // idle connections belong to the pool, the others to their threads.
+        hash_map<uint32_t,reusable_connection*,id_hash_uint>::iterator sit,sit2;
+        sit = cs->_sockets.begin();
+        while (sit!=cs->_sockets.end())
+          {
+            sit2 = sit;
+            ++sit;
+            reusable_connection *connection = (*sit2).second;
+            if (connection->_in_use)
+              drop_connection(cs,connection);
+            else close_connection(cs,connection,false);
+          }
+        delete cs;
+      }
+
+    mutex_destroy(&_size_mutex);
+    mutex_destroy(&_reaper_mutex);
+    pthread_cond_destroy(&_reaper_cond);
+  }
+
+  void connection_pool::set_capacity(const size_t &capacity)
+  {
+    mutex_lock(&_size_mutex);
+    _capacity = capacity;
+    mutex_unlock(&_size_mutex);
+  }
+
+  static void append_lower(std::string &key, const char *str)
+  {
+    if (str == NULL)
+      return;
+    for (const char *c=str; *c; c++)
+      key.push_back(tolower((unsigned char)*c));
+  }
+
+  std::string connection_pool::destination_key(const char *host, const int &port,
+      const int &forwarder_type,
+      const char *gateway_host, const int &gateway_port,
+      const char *forward_host, const int &forward_port)
+  {
+    char numbers[64];
+    std::string key;
+    key.reserve(64);
+
+    append_lower(key,host);
+    snprintf(numbers,sizeof(numbers),":%d/%d/",port,forwarder_type);
+    key += numbers;
+    append_lower(key,gateway_host);
+    snprintf(numbers,sizeof(numbers),":%d/",gateway_port);
+    key += numbers;
+    append_lower(key,forward_host);
+    snprintf(numbers,sizeof(numbers),":%d",forward_port);
+    key += numbers;
+    return key;
+  }
+
+  std::string connection_pool::destination_key(const http_request *http, const forward_spec *fwd)
+  {
+    return connection_pool::destination_key(http->_host,http->_port,fwd->_type,
+           fwd->_gateway_host,fwd->_gateway_port,
+           fwd->_forward_host,fwd->_forward_port);
+  }
+
+  connection_stripe* connection_pool::stripe(const std::string &key) const
+  {
+    size_t h = hash<const char*>()(key.c_str());
+    return _stripes[h % _stripes.size()];
+  }
+
+  bool connection_pool::is_expired(const reusable_connection *connection, const time_t &now)
+  {
+    time_t time_open = now - connection->_timestamp;
+    time_t latency = connection->_response_received - connection->_request_sent;
+    return (connection->_keep_alive_timeout < time_open + latency);
+  }
+
+  void connection_pool::drop_connection(connection_stripe *cs, reusable_connection *connection)
+  {
+    cs->_sockets.erase(connection->_sfd);
+    freez(connection->_host);
+    freez(connection->_gateway_host);
+    freez(connection->_forward_host);
+    delete connection;
+
+    mutex_lock(&_size_mutex);
+    _size--;
+    mutex_unlock(&_size_mutex);
+  }
+
+  void connection_pool::close_connection(connection_stripe *cs, reusable_connection *connection,
+                                         const bool &reaped)
+  {
+    spsockets::close_socket(connection->_sfd);
+    drop_connection(cs,connection);
+
+    if (reaped)
+      {
+        mutex_lock(&_size_mutex);
+        _reaped++;
+        mutex_unlock(&_size_mutex);
+      }
+  }
+
+  void connection_pool::push_idle(connection_stripe *cs, const std::string &key,
+                                  reusable_connection *connection)
+  {
+    hash_map<const char*,std::vector<reusable_connection*>*,hash<const char*>,eqstr>::iterator hit;
+    if ((hit = cs->_idle.find(key.c_str())) == cs->_idle.end())
+      {
+        std::vector<reusable_connection*> *idle = new std::vector<reusable_connection*>();
+        hit = cs->_idle.insert(std::pair<const char*,std::vector<reusable_connection*>*>(strdup(key.c_str()),idle)).first;
+      }
+    (*hit).second->push_back(connection);
+  }
+
+  reusable_connection* connection_pool::pop_idle(connection_stripe *cs, const std::string &key)
+  {
+    hash_map<const char*,std::vector<reusable_connection*>*,hash<const char*>,eqstr>::iterator hit;
+    if ((hit = cs->_idle.find(key.c_str())) == cs->_idle.end()
+        || (*hit).second->empty())
+      return NULL;
+
+    // the most recently used connection is the most likely to be alive.
+    // Empty lists are left to the reaper, they are likely to be refilled.
+    reusable_connection *connection = (*hit).second->back();
+    (*hit).second->pop_back();
+    return connection;
+  }
+
+  sp_socket connection_pool::get(const http_request *http, const forward_spec *fwd)
+  {
+    sp_socket sfd = SP_INVALID_SOCKET;
+    std::string key = connection_pool::destination_key(http,fwd);
+    connection_stripe *cs = stripe(key);
+    time_t now = time(NULL);
+
+    mutex_lock(&cs->_mutex);
+    cs->_lookups++;
+
+    reusable_connection *connection = NULL;
+    while ((connection = pop_idle(cs,key)) != NULL)
+      {
+        /*
+         * The connection is checked without the lock, no other
+         * thread can take it or close it as it is marked in use.
+         */
+        connection->_in_use = TRUE;
+        mutex_unlock(&cs->_mutex);
+        bool usable = !connection_pool::is_expired(connection,now)
+                      && spsockets::socket_is_still_usable(connection->_sfd);
+        mutex_lock(&cs->_mutex);
+
+        if (!usable)
+          {
+            errlog::log_error(LOG_LEVEL_CONNECT,
+                              "The connection to %s:%d is no longer usable. "
+                              "Closing socket %d.", connection->_host,
+                              connection->_port, connection->_sfd);
+            close_connection(cs,connection,true);
+            continue;
+          }
+
+        sfd = connection->_sfd;
+        cs->_hits++;
+        errlog::log_error(LOG_LEVEL_CONNECT,
+                          "Found reusable socket %d for %s:%d.",
+                          sfd, connection->_host, connection->_port);
+        break;
+      }
+
+    mutex_unlock(&cs->_mutex);
+    return sfd;
+  }
+
+  bool connection_pool::remember(const reusable_connection *connection,
+                                 const http_request *http, const forward_spec *fwd)
+  {
+    assert(connection->_sfd != SP_INVALID_SOCKET);
+
+    std::string key = connection_pool::destination_key(http,fwd);
+    connection_stripe *cs = stripe(key);
+
+    mutex_lock(&cs->_mutex);
+
+    hash_map<uint32_t,reusable_connection*,id_hash_uint>::iterator sit;
+    if ((sit = cs->_sockets.find(connection->_sfd)) != cs->_sockets.end())
+      {
+        // a connection handed out by the pool comes back.
+        reusable_connection *pooled = (*sit).second;
+        assert(pooled->_in_use);
+        pooled->_in_use = FALSE;
+        pooled->_timestamp = connection->_timestamp;
+        pooled->_request_sent = connection->_request_sent;
+        pooled->_response_received = connection->_response_received;
+
+        // the capacity is not enforced exactly here, the read need not be locked.
+        if (_size > _capacity)
+          {
+            errlog::log_error(LOG_LEVEL_CONNECT,
+                              "Connection pool over capacity, closing socket %d for %s:%d.",
+                              pooled->_sfd, pooled->_host, pooled->_port);
+            close_connection(cs,pooled,false);
+          }
+        else
+          {
+            errlog::log_error(LOG_LEVEL_CONNECT,
+                              "Marking open socket %d for %s:%d as unused.",
+                              pooled->_sfd, pooled->_host, pooled->_port);
+            push_idle(cs,key,pooled);
+          }
+        mutex_unlock(&cs->_mutex);
+        return true;
+      }
+
+    mutex_lock(&_size_mutex);
+    if (_size >= _capacity)
+      {
+        _rejected++;
+        mutex_unlock(&_size_mutex);
+        mutex_unlock(&cs->_mutex);
+        return false;
+      }
+    _size++;
+    _remembered++;
+    mutex_unlock(&_size_mutex);
+
+    reusable_connection *pooled = new reusable_connection();
+    pooled->_sfd = connection->_sfd;
+    pooled->_in_use = FALSE;
+    pooled->_timestamp = connection->_timestamp;
+    pooled->_request_sent = connection->_request_sent;
+    pooled->_response_received = connection->_response_received;
+    pooled->_keep_alive_timeout = connection->_keep_alive_timeout;
+    pooled->_host = strdup(http->_host);
+    pooled->_port = http->_port;
+    pooled->_forwarder_type = fwd->_type;
+    pooled->_gateway_host = fwd->_gateway_host ? strdup(fwd->_gateway_host) : NULL;
+    pooled->_gateway_port = fwd->_gateway_port;
+    pooled->_forward_host = fwd->_forward_host ? strdup(fwd->_forward_host) : NULL;
+    pooled->_forward_port = fwd->_forward_port;
+
+    errlog::log_error(LOG_LEVEL_CONNECT,
+                      "Remembering socket %d for %s:%d.",
+                      pooled->_sfd, pooled->_host, pooled->_port);
+
+    cs->_sockets.insert(std::pair<uint32_t,reusable_connection*>(pooled->_sfd,pooled));
+    push_idle(cs,key,pooled);
+
+    mutex_unlock(&cs->_mutex);
+    return true;
+  }
+
+  bool connection_pool::forget(const sp_socket &sfd)
+  {
+    for (size_t i=0; i<_stripes.size(); i++)
+      {
+        connection_stripe *cs = _stripes[i];
+        mutex_lock(&cs->_mutex);
+
+        hash_map<uint32_t,reusable_connection*,id_hash_uint>::iterator sit;
+        if ((sit = cs->_sockets.find(sfd)) != cs->_sockets.end())
+          {
+            reusable_connection *connection = (*sit).second;
+            assert(connection->_in_use);
+            errlog::log_error(LOG_LEVEL_CONNECT,
+                              "Forgetting socket %d for %s:%d.",
+                              sfd, connection->_host, connection->_port);
+            drop_connection(cs,connection);
+            mutex_unlock(&cs->_mutex);
+            return true;
+          }
+
+        mutex_unlock(&cs->_mutex);
+      }
+
+    errlog::log_error(LOG_LEVEL_CONNECT,
+                      "Socket %d already forgotten or never remembered.", sfd);
+    return false;
+  }
+
+  int connection_pool::reap()
+  {
+    int connections_alive = 0;
+
+    for (size_t i=0; i<_stripes.size(); i++)
+      {
+        connection_stripe *cs = _stripes[i];
+        mutex_lock(&cs->_mutex);
+        time_t now = time(NULL);
+
+        hash_map<const char*,std::vector<reusable_connection*>*,hash<const char*>,eqstr>::iterator hit,hit2;
+        hit = cs->_idle.begin();
+        while (hit!=cs->_idle.end())
+          {
+            hit2 = hit;
+            ++hit;
+            std::vector<reusable_connection*> *idle = (*hit2).second;
+
+            size_t kept = 0;
+            for (size_t j=0; j<idle->size(); j++)
+              {
+                reusable_connection *connection = (*idle)[j];
+                if (connection_pool::is_expired(connection,now))
+                  {
+                    errlog::log_error(LOG_LEVEL_CONNECT,
+                                      "The connection to %s:%d timed out. "
+                                      "Closing socket %d. Timeout is: %u.",
+                                      connection->_host, connection->_port,
+                                      connection->_sfd, connection->_keep_alive_timeout);
+                    close_connection(cs,connection,true);
+                  }
+                else if (!spsockets::socket_is_still_usable(connection->_sfd))
+                  {
+                    errlog::log_error(LOG_LEVEL_CONNECT,
+                                      "The connection to %s:%d is no longer usable. "
+                                      "Closing socket %d.", connection->_host,
+                                      connection->_port, connection->_sfd);
+                    close_connection(cs,connection,true);
+                  }
+                else (*idle)[kept++] = connection;
+              }
+            idle->resize(kept);
+            connections_alive += kept;
+
+            if (idle->empty())
+              {
+                const char *key = (*hit2).first;
+                cs->_idle.erase(hit2);
+                free_const(key);
+                delete idle;
+              }
+          }
+
+        mutex_unlock(&cs->_mutex);
+      }
+
+    return connections_alive;
+  }
+
+  void* connection_pool::reaper_loop(void *arg)
+  {
+    connection_pool *cp = static_cast<connection_pool*>(arg);
+
+    mutex_lock(&cp->_reaper_mutex);
+    while (!cp->_reaper_stop)
+      {
+        struct timeval now;
+        gettimeofday(&now,NULL);
+        struct timespec deadline;
+        deadline.tv_sec = now.tv_sec + cp->_reaper_interval;
+        deadline.tv_nsec = now.tv_usec * 1000;
+        pthread_cond_timedwait(&cp->_reaper_cond,&cp->_reaper_mutex,&deadline);
+        if (cp->_reaper_stop)
+          break;
+
+        mutex_unlock(&cp->_reaper_mutex);
+        int connections_alive = cp->reap();
+
+        connection_pool_stats stats;
+        cp->get_stats(stats);
+        errlog::log_error(LOG_LEVEL_CONNECT,
+                          "Connection pool: %d idle, %lu in use, %lu reaped, reuse rate %g%%.",
+                          connections_alive, (unsigned long)stats._in_use, stats._reaped,
+                          100.0 * stats.reuse_rate());
+        mutex_lock(&cp->_reaper_mutex);
+      }
+    mutex_unlock(&cp->_reaper_mutex);
+    return NULL;
+  }
+
+  sp_err connection_pool::start_reaper(const unsigned int &interval)
+  {
+    mutex_lock(&_reaper_mutex);
+    if (_reaper_running)
+      {
+        _reaper_interval = interval;
+        mutex_unlock(&_reaper_mutex);
+        return SP_ERR_OK;
+      }
+    _reaper_interval = interval;
+    _reaper_stop = false;
+
+    int err = pthread_create(&_reaper,NULL,&connection_pool::reaper_loop,this);
+    if (err != 0)
+      {
+        mutex_unlock(&_reaper_mutex);
+        errlog::log_error(LOG_LEVEL_ERROR,"Error creating the connection reaper thread: %d",err);
+        return SP_ERR_MEMORY;
+      }
+    _reaper_running = true;
+    mutex_unlock(&_reaper_mutex);
+    return SP_ERR_OK;
+  }
+
+  void connection_pool::stop_reaper()
+  {
+    mutex_lock(&_reaper_mutex);
+    if (!_reaper_running)
+      {
+        mutex_unlock(&_reaper_mutex);
+        return;
+      }
+    _reaper_stop = true;
+    cond_signal(&_reaper_cond);
+    mutex_unlock(&_reaper_mutex);
+
+    pthread_join(_reaper,NULL);
+    _reaper_running = false;
+  }
+
+  void connection_pool::get_stats(connection_pool_stats &stats)
+  {
+    stats = connection_pool_stats();
+    for (size_t i=0; i<_stripes.size(); i++)
+      {
+        connection_stripe *cs = _stripes[i];
+        mutex_lock(&cs->_mutex);
+        stats._lookups += cs->_lookups;
+        stats._hits += cs->_hits;
+        size_t idle = 0;
+        hash_map<const char*,std::vector<reusable_connection*>*,hash<const char*>,eqstr>::const_iterator hit;
+        for (hit=cs->_idle.begin(); hit!=cs->_idle.end(); ++hit)
+          idle += (*hit).second->size();
+        stats._idle += idle;
+        stats._in_use += cs->_sockets.size() - idle;
+        mutex_unlock(&cs->_mutex);
+      }
+
+    mutex_lock(&_size_mutex);
+    stats._remembered = _remembered;
+    stats._rejected = _rejected;
+    stats._reaped = _reaped;
+    mutex_unlock(&_size_mutex);
+  }
+
+} /* end of namespace. */
@@ -0,0 +1,227 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include "proxy_dts.h"
+#include "mutexes.h"
+#include "stl_hash.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * Default maximum number of connections held by a pool.
+ */
+#define MAX_REUSABLE_CONNECTIONS 100
+
+/**
+ * Default number of locks a pool is striped over.
+ */
+#define CONNECTION_POOL_STRIPES 16
+
+/**
+ * Default number of seconds between two runs of the reaper.
+ */
+#define CONNECTION_POOL_REAP_INTERVAL 10
+
+namespace sp
+{
+  /**
+   * \brief counters of a connection pool.
+   */
+  class connection_pool_stats
+  {
+    public:
+      connection_pool_stats()
+        :_lookups(0),_hits(0),_remembered(0),_rejected(0),_reaped(0),
+         _idle(0),_in_use(0)
+      {};
+
+      ~connection_pool_stats() {};
+
+      /**
+       * \brief share of the lookups that were served by a pooled connection.
+       */
+      double reuse_rate() const
+      {
+        return _lookups ? _hits / (double)_lookups : 0.0;
+      };
+
+      unsigned long _lookups; /**< requests for a connection. */
+      unsigned long _hits; /**< requests served by a pooled connection. */
+      unsigned long _remembered; /**< connections added to the pool. */
+      unsigned long _rejected; /**< connections refused because the pool was full. */
+      unsigned long _reaped; /**< idle connections closed as dead or timed out. */
+      size_t _idle; /**< connections available for reuse. */
+      size_t _in_use; /**< pooled connections handed out. */
+  };
+
+  /**
+   * \brief a lock and the connections to the destinations it covers.
+   */
+  class connection_stripe
+  {
+    public:
+      connection_stripe();
+
+      ~connection_stripe();
+
+      sp_mutex_t _mutex;
+
+      /**
+       * idle connections by destination key, most recently used last.
+       * Keys are owned.
+       */
+      hash_map<const char*,std::vector<reusable_connection*>*,hash<const char*>,eqstr> _idle;
+
+      /**
+       * every pooled connection of the stripe, idle or in use, by socket.
+       */
+      hash_map<uint32_t,reusable_connection*,id_hash_uint> _sockets;
+
+      unsigned long _lookups;
+      unsigned long _hits;
+  };
+
+  /**
+   * \brief a pool of open server connections, for reuse by the client
+   *        threads that forward requests to the same destination.
+   *
+   *        Connections are indexed by destination, i.e. host, port and
+   *        forwarding settings, so that lookups do not depend on the size
+   *        of the pool. Destinations are spread over several locks so that
+   *        threads that do not share a destination do not contend. Dead
+   *        and timed out connections are closed by a background reaper
+   *        instead of being polled on every lookup.
+   */
+  class connection_pool
+  {
+    public:
+      /**
+       * \brief creates an empty pool of at most capacity connections.
+       */
+      connection_pool(const size_t &capacity=MAX_REUSABLE_CONNECTIONS,
+                      const size_t &nstripes=CONNECTION_POOL_STRIPES);
+
+      /**
+       * \brief stops the reaper and closes the idle connections.
+       */
+      ~connection_pool();
+
+      /**
+       * \brief sets the maximum number of pooled connections. Connections
+       *        over a lowered capacity are closed as they become idle.
+       */
+      void set_capacity(const size_t &capacity);
+
+      /**
+       * \brief hands out an idle connection to a destination.
+       * @return the socket, or SP_INVALID_SOCKET if there is none.
+       */
+      sp_socket get(const http_request *http, const forward_spec *fwd);
+
+      /**
+       * \brief gives a connection free for reuse, adding it to the pool if
+       *        it was not handed out by it.
+       * @return false if the pool is full, in which case the caller keeps
+       *         the socket.
+       */
+      bool remember(const reusable_connection *connection,
+                    const http_request *http, const forward_spec *fwd);
+
+      /**
+       * \brief removes a connection, that is in use, from the pool.
+       * @return whether the socket belonged to the pool.
+       */
+      bool forget(const sp_socket &sfd);
+
+      /**
+       * \brief closes idle connections that timed out or have been closed
+       *        on the other side.
+       * @return the number of idle connections left.
+       */
+      int reap();
+
+      /**
+       * \brief starts a thread that reaps the pool every interval seconds.
+       */
+      sp_err start_reaper(const unsigned int &interval=CONNECTION_POOL_REAP_INTERVAL);
+
+      /**
+       * \brief stops the reaper thread, if any, and waits for it.
+       */
+      void stop_reaper();
+
+      /**
+       * \brief fills up the counters of the pool.
+       */
+      void get_stats(connection_pool_stats &stats);
+
+      /**
+       * \brief key of a destination, case insensitive on host names.
+       */
+      static std::string destination_key(const char *host, const int &port,
+                                         const int &forwarder_type,
+                                         const char *gateway_host, const int &gateway_port,
+                                         const char *forward_host, const int &forward_port);
+
+      static std::string destination_key(const http_request *http, const forward_spec *fwd);
+
+    private:
+      connection_pool(const connection_pool &cp); // not copyable.
+      connection_pool& operator=(const connection_pool &cp);
+
+      connection_stripe* stripe(const std::string &key) const;
+
+      static bool is_expired(const reusable_connection *connection, const time_t &now);
+
+      void drop_connection(connection_stripe *cs, reusable_connection *connection);
+
+      void close_connection(connection_stripe *cs, reusable_connection *connection,
+                            const bool &reaped);
+
+      void push_idle(connection_stripe *cs, const std::string &key,
+                     reusable_connection *connection);
+
+      reusable_connection* pop_idle(connection_stripe *cs, const std::string &key);
+
+      static void* reaper_loop(void *arg);
+
+    private:
+      std::vector<connection_stripe*> _stripes;
+
+      sp_mutex_t _size_mutex; /**< guards the capacity, size and counters below. */
+      size_t _capacity;
+      size_t _size;
+      unsigned long _remembered;
+      unsigned long _rejected;
+      unsigned long _reaped;
+
+      sp_mutex_t _reaper_mutex;
+      sp_cond_t _reaper_cond;
+      pthread_t _reaper;
+      bool _reaper_running;
+      bool _reaper_stop;
+      unsigned int _reaper_interval;
+  };
+
+} /* end of namespace. */
+
+#endif
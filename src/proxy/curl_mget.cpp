@@ -17,14 +17,14 @@
  */
 
 #include "curl_mget.h"
+#include "urlmatch.h"
 #include "miscutil.h"
 #include "errlog.h"
 
-#include <pthread.h>
-
 #include <stdlib.h>
 #include <string.h>
 #include <iostream>
+#include <map>
 
 #include <assert.h>
 
@@ -39,8 +39,26 @@ namespace sp
     if (!arg->_output)
       arg->_output = new std::string();
 
+    size_t prev_size = arg->_output->size();
     arg->_output->append(buffer,size);
 
+    // returning less than size aborts the transfer.
+    if (arg->_max_bytes > 0 && arg->_output->size() >= arg->_max_bytes)
+      {
+        arg->_stopped = true;
+        return 0;
+      }
+    if (arg->_stop_pattern && !arg->_stop_pattern->empty())
+      {
+        // the pattern may straddle two chunks.
+        size_t from = prev_size > arg->_stop_pattern->size() ? prev_size - arg->_stop_pattern->size() : 0;
+        std::string::const_iterator sit = arg->_output->begin() + from;
+        if (miscutil::ci_find(*arg->_output,*arg->_stop_pattern,sit) != std::string::npos)
+          {
+            arg->_stopped = true;
+            return 0;
+          }
+      }
     return size;
   }
 
@@ -51,7 +69,7 @@ namespace sp
                        const long &transfer_timeout_ms)
     :_nrequests(nrequests),_connect_timeout_sec(connect_timeout_sec),
      _connect_timeout_ms(connect_timeout_ms),_transfer_timeout_sec(transfer_timeout_sec),
-     _transfer_timeout_ms(transfer_timeout_ms)
+     _transfer_timeout_ms(transfer_timeout_ms),_max_parallel(0),_max_per_host(0),_max_bytes(0)
   {
     _outputs = new std::string*[_nrequests];
     for (int i=0; i<_nrequests; i++)
@@ -64,13 +82,8 @@ namespace sp
     delete[] _cbgets;
   }
 
-  void* pull_one_url(void *arg_cbget)
+  CURL* setup_one_url(cbget *arg)
   {
-    if (!arg_cbget)
-      return NULL;
-
-    cbget *arg = static_cast<cbget*>(arg_cbget);
-
     CURL *curl = NULL;
 
     if (!arg->_handler)
@@ -82,12 +95,14 @@ namespace sp
         curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0); // do not check on SSL certificate.
       }
     else curl = arg->_handler;
+    arg->_curl = curl;
 
     curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, arg->_connect_timeout_sec);
     curl_easy_setopt(curl, CURLOPT_TIMEOUT, arg->_transfer_timeout_sec);
     curl_easy_setopt(curl, CURLOPT_URL, arg->_url);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, arg);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, arg);
 
     if (!arg->_cookies.empty())
       curl_easy_setopt(curl, CURLOPT_COOKIE, arg->_cookies.c_str());
@@ -134,38 +149,25 @@ namespace sp
           }
       }
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, slist);
+    arg->_slist = slist;
 
-    char errorbuffer[CURL_ERROR_SIZE];
-    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, &errorbuffer);
-
-    try
-      {
-        int status = curl_easy_perform(curl);
-        if (status != 0)  // an error occurred.
-          {
-            arg->_status = status;
-            errlog::log_error(LOG_LEVEL_ERROR, "curl error on url %s: %s",arg->_url,errorbuffer);
+    arg->_errorbuffer[0] = '\0';
+    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, arg->_errorbuffer);
+    return curl;
+  }
 
-            if (arg->_output)
-              {
-                delete arg->_output;
-                arg->_output = NULL;
-              }
-          }
-      }
-    catch (std::exception &e)
+  void finish_one_url(cbget *arg, const int &status)
+  {
+    if (status == CURLE_WRITE_ERROR && arg->_stopped)
       {
-        arg->_status = -1;
-        errlog::log_error(LOG_LEVEL_ERROR, "Error %s in fetching remote data with curl.", e.what());
-        if (arg->_output)
-          {
-            delete arg->_output;
-            arg->_output = NULL;
-          }
+        // stopped on purpose, the content received so far is kept.
       }
-    catch (...)
+    else if (status != 0)  // an error occurred.
       {
-        arg->_status = -2;
+        arg->_status = status;
+        if (status > 0)
+          errlog::log_error(LOG_LEVEL_ERROR, "curl error on url %s: %s",arg->_url,arg->_errorbuffer);
+
         if (arg->_output)
           {
             delete arg->_output;
@@ -173,12 +175,38 @@ namespace sp
           }
       }
 
-    if (!arg->_handler)
-      curl_easy_cleanup(curl);
+    if (!arg->_handler && arg->_curl)
+      curl_easy_cleanup(arg->_curl);
+    arg->_curl = NULL;
+
+    if (arg->_slist)
+      curl_slist_free_all(arg->_slist);
+    arg->_slist = NULL;
+  }
 
-    if (slist)
-      curl_slist_free_all(slist);
+  void* pull_one_url(void *arg_cbget)
+  {
+    if (!arg_cbget)
+      return NULL;
 
+    cbget *arg = static_cast<cbget*>(arg_cbget);
+
+    CURL *curl = setup_one_url(arg);
+    int status = 0;
+    try
+      {
+        status = curl_easy_perform(curl);
+      }
+    catch (std::exception &e)
+      {
+        status = -1;
+        errlog::log_error(LOG_LEVEL_ERROR, "Error %s in fetching remote data with curl.", e.what());
+      }
+    catch (...)
+      {
+        status = -2;
+      }
+    finish_one_url(arg,status);
     return NULL;
   }
 
@@ -195,9 +223,7 @@ namespace sp
   {
     assert((int)urls.size() == nrequests); // check.
 
-    pthread_t tid[nrequests];
-
-    /* Must initialize libcurl before any threads are started */
+    /* Must initialize libcurl before any transfer is started */
     curl_global_init(CURL_GLOBAL_ALL);
 
     for (int i=0; i<nrequests; i++)
@@ -215,26 +241,146 @@ namespace sp
         if (cookies)
           arg_cbget->_cookies = cookies->at(i);
         arg_cbget->_http_method = http_method;
+        arg_cbget->_max_bytes = _max_bytes;
+        if (!_stop_pattern.empty())
+          arg_cbget->_stop_pattern = &_stop_pattern;
         if (content)
           {
             arg_cbget->_content = content;
             arg_cbget->_content_size = content_size;
           }
         _cbgets[i] = arg_cbget;
-
-        int error = pthread_create(&tid[i],
-                                   NULL, /* default attributes please */
-                                   pull_one_url,
-                                   (void *)arg_cbget);
-
-        if (error != 0)
-          errlog::log_error(LOG_LEVEL_ERROR,"Couldn't run thread number %g",i,", errno %g",error);
       }
 
-    /* now wait for all threads to terminate */
-    for (int i=0; i<nrequests; i++)
+    /*
+     * Transfers are I/O bound: rather than one thread per url, they are
+     * multiplexed over a single multi handle, driven by the calling thread.
+     */
+    if (nrequests == 1)
+      pull_one_url(_cbgets[0]);
+    else if (nrequests > 1)
       {
-        int error = pthread_join(tid[i], NULL);
+        CURLM *multi = curl_multi_init();
+
+        // transfers are started as the parallelism and per host limits allow.
+        std::vector<std::string> hosts;
+        if (_max_per_host > 0)
+          {
+            hosts.reserve(nrequests);
+            for (int i=0; i<nrequests; i++)
+              {
+                std::string host, path;
+                urlmatch::parse_url_host_and_path(urls[i],host,path);
+                hosts.push_back(host);
+              }
+          }
+        std::map<std::string,int> host_transfers;
+        std::vector<bool> started(nrequests,false);
+        int nstarted = 0;
+        int active = 0;
+
+        int running = 0;
+        try
+          {
+            while (true)
+              {
+                for (int i=0; i<nrequests && nstarted<nrequests; i++)
+                  {
+                    if (started[i])
+                      continue;
+                    if (_max_parallel > 0 && active >= _max_parallel)
+                      break;
+                    if (_max_per_host > 0 && host_transfers[hosts[i]] >= _max_per_host)
+                      continue;
+                    curl_multi_add_handle(multi,setup_one_url(_cbgets[i]));
+                    started[i] = true;
+                    nstarted++;
+                    active++;
+                    if (_max_per_host > 0)
+                      host_transfers[hosts[i]]++;
+                  }
+
+                while (curl_multi_perform(multi,&running) == CURLM_CALL_MULTI_PERFORM);
+
+                // status of finished transfers.
+                bool freed = false;
+                CURLMsg *msg = NULL;
+                int nmsgs = 0;
+                while ((msg = curl_multi_info_read(multi,&nmsgs)))
+                  {
+                    if (msg->msg != CURLMSG_DONE)
+                      continue;
+                    cbget *arg = NULL;
+                    curl_easy_getinfo(msg->easy_handle,CURLINFO_PRIVATE,(char**)&arg);
+                    curl_multi_remove_handle(multi,msg->easy_handle);
+                    finish_one_url(arg,msg->data.result);
+                    active--;
+                    freed = true;
+                    if (_max_per_host > 0)
+                      {
+                        for (int j=0; j<nrequests; j++)
+                          if (_cbgets[j] == arg)
+                            {
+                              host_transfers[hosts[j]]--;
+                              break;
+                            }
+                      }
+                  }
+                if (active == 0 && nstarted == nrequests)
+                  break;
+                if (freed && nstarted < nrequests)
+                  continue; // start the transfers that were waiting for a slot.
+
+                long timeout_ms = -1;
+                curl_multi_timeout(multi,&timeout_ms);
+                if (timeout_ms < 0 || timeout_ms > CURL_MGET_POLL_MS)
+                  timeout_ms = CURL_MGET_POLL_MS;
+
+                // curl_multi_wait polls the fds of the transfers, so that they are not
+                // limited to FD_SETSIZE as with select().
+                int numfds = 0;
+                CURLMcode mc = curl_multi_wait(multi,NULL,0,timeout_ms,&numfds);
+                if (mc != CURLM_OK)
+                  {
+                    errlog::log_error(LOG_LEVEL_ERROR,"curl_multi_wait error while fetching remote data: %s",
+                                      curl_multi_strerror(mc));
+                    break;
+                  }
+              }
+          }
+        catch (std::exception &e)
+          {
+            errlog::log_error(LOG_LEVEL_ERROR, "Error %s in fetching remote data with curl.", e.what());
+          }
+        catch (...)
+          {
+          }
+
+        // status of finished transfers.
+        CURLMsg *msg = NULL;
+        int nmsgs = 0;
+        while ((msg = curl_multi_info_read(multi,&nmsgs)))
+          {
+            if (msg->msg != CURLMSG_DONE)
+              continue;
+            cbget *arg = NULL;
+            curl_easy_getinfo(msg->easy_handle,CURLINFO_PRIVATE,(char**)&arg);
+            curl_multi_remove_handle(multi,msg->easy_handle);
+            finish_one_url(arg,msg->data.result);
+          }
+
+        // transfers that did not complete, or did not start.
+        for (int i=0; i<nrequests; i++)
+          {
+            if (_cbgets[i]->_curl)
+              {
+                curl_multi_remove_handle(multi,_cbgets[i]->_curl);
+                finish_one_url(_cbgets[i],-1);
+              }
+            else if (!started[i])
+              _cbgets[i]->_status = -1;
+          }
+        curl_multi_cleanup(multi);
       }
 
     for (int i=0; i<nrequests; i++)
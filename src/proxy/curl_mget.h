@@ -25,14 +25,22 @@
 
 #include <curl/curl.h>
 
+/**
+ * Maximum number of milliseconds between two polls of the running transfers.
+ */
+#define CURL_MGET_POLL_MS 100
+
 namespace sp
 {
   typedef struct _cbget
   {
     _cbget()
       :_url(NULL),_output(NULL),_proxy_port(0),_headers(NULL),_status(0),_handler(NULL),
-       _content(NULL),_content_size(-1)
-    {};
+       _content(NULL),_content_size(-1),_max_bytes(0),_stop_pattern(NULL),_stopped(false),
+       _curl(NULL),_slist(NULL)
+    {
+      _errorbuffer[0] = '\0';
+    };
 
     ~_cbget()
     {};
@@ -52,10 +60,26 @@ namespace sp
     std::string *_content; // optional
     int _content_size; // optional
     std::string _content_type; // optional.
+    size_t _max_bytes; // optional, transfer is stopped after this many bytes.
+    const std::string *_stop_pattern; // optional, transfer is stopped once seen (case insensitive).
+    bool _stopped; // whether the transfer was stopped early, on purpose.
+    CURL *_curl; // transfer handle.
+    struct curl_slist *_slist; // transfer headers.
+    char _errorbuffer[CURL_ERROR_SIZE];
   } cbget;
 
   void* pull_one_url(void *arg_cbget);
 
+  /**
+   * \brief sets up the transfer handle of a request.
+   */
+  CURL* setup_one_url(cbget *arg);
+
+  /**
+   * \brief records the status of a finished transfer and releases its handle.
+   */
+  void finish_one_url(cbget *arg, const int &status);
+
   class curl_mget
   {
     public:
@@ -67,7 +91,7 @@ namespace sp
 
       ~curl_mget();
 
-      // direct connection.
+      // direct connection. Transfers are multiplexed in the calling thread.
       std::string** www_mget(const std::vector<std::string> &urls, const int &nrequests,
                              const std::vector<std::list<const char*>*> *headers,
                              const std::string &proxy_addr, const short &proxy_port,
@@ -97,6 +121,11 @@ namespace sp
       std::string _lang;
       const std::list<const char*> *_headers; // forced http headers.
 
+      int _max_parallel; /**< maximum number of transfers at once, 0 for no limit. */
+      int _max_per_host; /**< maximum number of transfers at once to the same host, 0 for no limit. */
+      size_t _max_bytes; /**< bytes after which a transfer is stopped, 0 for no limit. */
+      std::string _stop_pattern; /**< content after which a transfer is stopped, case insensitive, none if empty. */
+
       std::string **_outputs;
       cbget **_cbgets;
   };
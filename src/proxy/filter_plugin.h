@@ -60,10 +60,17 @@ namespace sp
 
       virtual ~filter_plugin();
 
+      /**
+       * \brief filters a piece of content.
+       * @param csp client state.
+       * @param str content to filter, not freed by the plugin when it is
+       *        the content of csp->_iob.
+       * @param size size of str.
+       * @return newly allocated filtered content, or NULL if unmodified.
+       */
       virtual char* run(client_state *csp, char *str, size_t size)
       {
-        std::cout << "run mother run...\n";
-        return (char*) "";
+        return NULL;
       };
 
       virtual std::string print()
@@ -93,14 +93,14 @@ namespace sp
 
   unsigned int gateway::_keep_alive_timeout = DEFAULT_KEEP_ALIVE_TIMEOUT;
 
-  reusable_connection gateway::_reusable_connection[MAX_REUSABLE_CONNECTIONS];
+  connection_pool gateway::_connection_pool;
 
   /*********************************************************************
    *
    * Function    :  initialize_reusable_connections
    *
-   * Description :  Initializes the reusable_connection structures.
-   *                Must be called with connection_reuse_mutex locked.
+   * Description :  Starts the thread that closes the remembered
+   *                connections that are no longer usable.
    *
    * Parameters  : N/A
    *
@@ -109,8 +109,6 @@ namespace sp
    *********************************************************************/
   void gateway::initialize_reusable_connections(void)
   {
-    unsigned int slot = 0;
-
 #if !defined(HAVE_POLL) && !defined(_WIN32)
     errlog::log_error(LOG_LEVEL_INFO,
                       "Detecting already dead connections might not work "
@@ -118,12 +116,13 @@ namespace sp
                       "unset the keep-alive-timeout option.");
 #endif
 
-    for (slot = 0; slot < SZ(gateway::_reusable_connection); slot++)
+    if (gateway::_connection_pool.start_reaper() != SP_ERR_OK)
       {
-        gateway::mark_connection_closed(&gateway::_reusable_connection[slot]);
+        errlog::log_error(LOG_LEVEL_ERROR,
+                          "Remembered connections will only be checked on reuse.");
       }
 
-    errlog::log_error(LOG_LEVEL_CONNECT, "Initialized %d socket slots.", slot);
+    errlog::log_error(LOG_LEVEL_CONNECT, "Initialized connection pool.");
   }
 
 
@@ -142,98 +141,21 @@ namespace sp
    *********************************************************************/
   void gateway::remember_connection(const client_state *csp, const forward_spec *fwd)
   {
-    unsigned int slot = 0;
-    int free_slot_found = FALSE;
     const reusable_connection *connection = &csp->_server_connection;
     const http_request *http = &csp->_http;
 
     assert(connection->_sfd != SP_INVALID_SOCKET);
+    assert(NULL != http->_host);
 
-    if (gateway::mark_connection_unused(connection))
-      {
-        return;
-      }
-
-    mutex_lock(&seeks_proxy::_connection_reuse_mutex);
-
-    /* Find free socket slot. */
-    for (slot = 0; slot < SZ(gateway::_reusable_connection); slot++)
-      {
-        if (gateway::_reusable_connection[slot]._sfd == SP_INVALID_SOCKET)
-          {
-            assert(gateway::_reusable_connection[slot]._in_use == 0);
-            errlog::log_error(LOG_LEVEL_CONNECT,
-                              "Remembering socket %d for %s:%d in slot %d.",
-                              connection->_sfd, http->_host, http->_port, slot);
-            free_slot_found = TRUE;
-            break;
-          }
-      }
-
-    if (!free_slot_found)
+    if (!gateway::_connection_pool.remember(connection, http, fwd))
       {
         errlog::log_error(LOG_LEVEL_CONNECT,
-                          "No free slots found to remembering socket for %s:%d. Last slot %d.",
-                          http->_host, http->_port, slot);
-        mutex_unlock(&seeks_proxy::_connection_reuse_mutex);
+                          "Connection pool full, not remembering socket for %s:%d.",
+                          http->_host, http->_port);
         spsockets::close_socket(connection->_sfd);
-        return;
-      }
-
-    assert(NULL != http->_host);
-    gateway::_reusable_connection[slot]._host = strdup(http->_host);
-    if (NULL == gateway::_reusable_connection[slot]._host)
-      {
-        errlog::log_error(LOG_LEVEL_FATAL, "Out of memory saving socket.");
-      }
-    gateway::_reusable_connection[slot]._sfd = connection->_sfd;
-    gateway::_reusable_connection[slot]._port = http->_port;
-    gateway::_reusable_connection[slot]._in_use = 0;
-    gateway::_reusable_connection[slot]._timestamp = connection->_timestamp;
-    gateway::_reusable_connection->_request_sent = connection->_request_sent;
-    gateway::_reusable_connection->_response_received = connection->_response_received;
-    gateway::_reusable_connection[slot]._keep_alive_timeout = connection->_keep_alive_timeout;
-
-    assert(NULL != fwd);
-    assert(gateway::_reusable_connection[slot]._gateway_host == NULL);
-    assert(gateway::_reusable_connection[slot]._gateway_port == 0);
-    assert(gateway::_reusable_connection[slot]._forwarder_type == SOCKS_NONE);
-    assert(gateway::_reusable_connection[slot]._forward_host == NULL);
-    assert(gateway::_reusable_connection[slot]._forward_port == 0);
-
-    gateway::_reusable_connection[slot]._forwarder_type = fwd->_type;
-    if (NULL != fwd->_gateway_host)
-      {
-        gateway::_reusable_connection[slot]._gateway_host = strdup(fwd->_gateway_host);
-        if (NULL == gateway::_reusable_connection[slot]._gateway_host)
-          {
-            errlog::log_error(LOG_LEVEL_FATAL, "Out of memory saving gateway_host.");
-          }
-      }
-    else
-      {
-        gateway::_reusable_connection[slot]._gateway_host = NULL;
-      }
-    gateway::_reusable_connection[slot]._gateway_port = fwd->_gateway_port;
-
-    if (NULL != fwd->_forward_host)
-      {
-        gateway::_reusable_connection[slot]._forward_host = strdup(fwd->_forward_host);
-        if (NULL == gateway::_reusable_connection[slot]._forward_host)
-          {
-            errlog::log_error(LOG_LEVEL_FATAL, "Out of memory saving forward_host.");
-          }
       }
-    else
-      {
-        gateway::_reusable_connection[slot]._forward_host = NULL;
-      }
-    gateway::_reusable_connection[slot]._forward_port = fwd->_forward_port;
-
-    mutex_unlock(&seeks_proxy::_connection_reuse_mutex);
   }
 
-
   /*********************************************************************
    *
    * Function    :  mark_connection_closed
@@ -282,33 +204,9 @@ namespace sp
    *********************************************************************/
   void gateway::forget_connection(sp_socket sfd)
   {
-    unsigned int slot = 0;
-
     assert(sfd != SP_INVALID_SOCKET);
 
-    mutex_lock(&seeks_proxy::_connection_reuse_mutex);
-
-    for (slot = 0; slot < SZ(gateway::_reusable_connection); slot++)
-      {
-        if (gateway::_reusable_connection[slot]._sfd == sfd)
-          {
-            assert(gateway::_reusable_connection[slot]._in_use);
-
-            errlog::log_error(LOG_LEVEL_CONNECT,
-                              "Forgetting socket %d for %s:%d in slot %d.",
-                              sfd, gateway::_reusable_connection[slot]._host,
-                              gateway::_reusable_connection[slot]._port, slot);
-            gateway::mark_connection_closed(&gateway::_reusable_connection[slot]);
-            mutex_unlock(&seeks_proxy::_connection_reuse_mutex);
-
-            return;
-          }
-      }
-
-    errlog::log_error(LOG_LEVEL_CONNECT,
-                      "Socket %d already forgotten or never remembered.", sfd);
-
-    mutex_unlock(&seeks_proxy::_connection_reuse_mutex);
+    gateway::_connection_pool.forget(sfd);
   }
 
 
@@ -376,53 +274,7 @@ namespace sp
    *********************************************************************/
   int gateway::close_unusable_connections()
   {
-    unsigned int slot = 0;
-    int connections_alive = 0;
-
-    mutex_lock(&seeks_proxy::_connection_reuse_mutex);
-
-    for (slot = 0; slot < SZ(gateway::_reusable_connection); slot++)
-      {
-        if (!gateway::_reusable_connection[slot]._in_use
-            && (SP_INVALID_SOCKET != gateway::_reusable_connection[slot]._sfd))
-          {
-            time_t time_open = time(NULL) - gateway::_reusable_connection[slot]._timestamp;
-            time_t latency = gateway::_reusable_connection[slot]._response_received -
-                             gateway::_reusable_connection[slot]._request_sent;
-
-            if (gateway::_reusable_connection[slot]._keep_alive_timeout < time_open + latency)
-              {
-                errlog::log_error(LOG_LEVEL_CONNECT,
-                                  "The connection to %s:%d in slot %d timed out. "
-                                  "Closing socket %d. Timeout is: %d. Assumed latency: %d",
-                                  gateway::_reusable_connection[slot]._host,
-                                  gateway::_reusable_connection[slot]._port, slot,
-                                  gateway::_reusable_connection[slot]._sfd,
-                                  gateway::_reusable_connection[slot]._keep_alive_timeout,
-                                  latency);
-                spsockets::close_socket(gateway::_reusable_connection[slot]._sfd);
-                gateway::mark_connection_closed(&gateway::_reusable_connection[slot]);
-              }
-            else if (!spsockets::socket_is_still_usable(gateway::_reusable_connection[slot]._sfd))
-              {
-                errlog::log_error(LOG_LEVEL_CONNECT,
-                                  "The connection to %s:%d in slot %d is no longer usable. "
-                                  "Closing socket %d.", gateway::_reusable_connection[slot]._host,
-                                  gateway::_reusable_connection[slot]._port, slot,
-                                  gateway::_reusable_connection[slot]._sfd);
-                spsockets::close_socket(gateway::_reusable_connection[slot]._sfd);
-                gateway::mark_connection_closed(&gateway::_reusable_connection[slot]);
-              }
-            else
-              {
-                connections_alive++;
-              }
-          }
-      }
-
-    mutex_unlock(&seeks_proxy::_connection_reuse_mutex);
-
-    return connections_alive;
+    return gateway::_connection_pool.reap();
   }
 
 
@@ -444,96 +296,45 @@ namespace sp
   sp_socket gateway::get_reusable_connection(const http_request *http,
       const forward_spec *fwd)
   {
-    sp_socket sfd = SP_INVALID_SOCKET;
-    unsigned int slot = 0;
-
-    gateway::close_unusable_connections();
-
-    mutex_lock(&seeks_proxy::_connection_reuse_mutex);
-
-    for (slot = 0; slot < SZ(gateway::_reusable_connection); slot++)
-      {
-        if (!gateway::_reusable_connection[slot]._in_use
-            && (SP_INVALID_SOCKET != gateway::_reusable_connection[slot]._sfd))
-          {
-            if (gateway::connection_destination_matches(&gateway::_reusable_connection[slot], http, fwd))
-              {
-                gateway::_reusable_connection[slot]._in_use = TRUE;
-                sfd = gateway::_reusable_connection[slot]._sfd;
-                errlog::log_error(LOG_LEVEL_CONNECT,
-                                  "Found reusable socket %d for %s:%d in slot %d.",
-                                  sfd, gateway::_reusable_connection[slot]._host, gateway::_reusable_connection[slot]._port, slot);
-                break;
-              }
-          }
-      }
-
-    mutex_unlock(&seeks_proxy::_connection_reuse_mutex);
-
-    return sfd;
+    return gateway::_connection_pool.get(http, fwd);
   }
 
 
   /*********************************************************************
    *
-   * Function    :  mark_connection_unused
+   * Function    :  set_keep_alive_timeout
    *
-   * Description :  Gives a remembered connection free for reuse.
+   * Description :  Sets the timeout after which open
+   *                connections will no longer be reused.
    *
    * Parameters  :
-   *          1  :  connection = The connection in question.
+   *          1  :  timeout = The timeout in seconds.
    *
-   * Returns     :  TRUE => Socket found and marked as unused.
-   *                FALSE => Socket not found.
+   * Returns     :  void
    *
    *********************************************************************/
-  int gateway::mark_connection_unused(const reusable_connection *connection)
+  void gateway::set_keep_alive_timeout(unsigned int timeout)
   {
-    unsigned int slot = 0;
-    int socket_found = FALSE;
-
-    assert(connection->_sfd != SP_INVALID_SOCKET);
-
-    mutex_lock(&seeks_proxy::_connection_reuse_mutex);
-
-    for (slot = 0; slot < SZ(gateway::_reusable_connection); slot++)
-      {
-        if (gateway::_reusable_connection[slot]._sfd == connection->_sfd)
-          {
-            assert(gateway::_reusable_connection[slot]._in_use);
-            socket_found = TRUE;
-            errlog::log_error(LOG_LEVEL_CONNECT,
-                              "Marking open socket %d for %s:%d in slot %d as unused.",
-                              connection->_sfd, gateway::_reusable_connection[slot]._host,
-                              gateway::_reusable_connection[slot]._port, slot);
-            gateway::_reusable_connection[slot]._in_use = 0;
-            gateway::_reusable_connection[slot]._timestamp = connection->_timestamp;
-            break;
-          }
-      }
-
-    mutex_unlock(&seeks_proxy::_connection_reuse_mutex);
-
-    return socket_found;
+    gateway::_keep_alive_timeout = timeout;
   }
 
 
   /*********************************************************************
    *
-   * Function    :  set_keep_alive_timeout
+   * Function    :  set_max_reusable_connections
    *
-   * Description :  Sets the timeout after which open
-   *                connections will no longer be reused.
+   * Description :  Sets the maximum number of open
+   *                connections that are kept for reuse.
    *
    * Parameters  :
-   *          1  :  timeout = The timeout in seconds.
+   *          1  :  max_connections = The number of connections.
    *
    * Returns     :  void
    *
    *********************************************************************/
-  void gateway::set_keep_alive_timeout(unsigned int timeout)
+  void gateway::set_max_reusable_connections(unsigned int max_connections)
   {
-    gateway::_keep_alive_timeout = timeout;
+    gateway::_connection_pool.set_capacity(max_connections);
   }
 #endif /* def FEATURE_CONNECTION_KEEP_ALIVE */
 
@@ -37,6 +37,7 @@
 #define GATEWAY_H
 
 #include "proxy_dts.h"
+#include "connection_pool.h"
 
 namespace sp
 {
@@ -85,9 +86,8 @@ namespace sp
        */
 #define DEFAULT_KEEP_ALIVE_TIMEOUT 180
 
-#define MAX_REUSABLE_CONNECTIONS 100
-
       static void set_keep_alive_timeout(unsigned int timeout);
+      static void set_max_reusable_connections(unsigned int max_connections);
       static void initialize_reusable_connections(void);
       static void forget_connection(sp_socket sfd);
       static void remember_connection(const client_state *csp,
@@ -97,11 +97,10 @@ namespace sp
       static int connection_destination_matches(const reusable_connection *connection,
           const http_request *http,
           const forward_spec *fwd);
-      static int mark_connection_unused(const reusable_connection *connection);
       static sp_socket get_reusable_connection(const http_request *http,
           const forward_spec *fwd);
       static unsigned int _keep_alive_timeout;
-      static reusable_connection _reusable_connection[MAX_REUSABLE_CONNECTIONS];
+      static connection_pool _connection_pool;
 
 #endif /* FEATURE_CONNECTION_KEEP_ALIVE */
 
@@ -0,0 +1,203 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "header_table.h"
+#include "miscutil.h"
+#include "mem_utils.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+#include <assert.h>
+
+namespace sp
+{
+  /*- header_patterns -*/
+  header_patterns::header_patterns(const parsers_list *patterns)
+    :_patterns(patterns),_npatterns(0),_every(0),_max_name_length(0)
+  {
+    for (const parsers_list *v=patterns; v->_str!=NULL; v++)
+      {
+        size_t i = _npatterns++;
+        assert(i < HEADER_PATTERNS_MAX);
+        uint64_t bit = (uint64_t)1 << i;
+
+        if (v->_len == CHECK_EVERY_HEADER_REMAINING)
+          {
+            _every |= bit;
+            continue;
+          }
+
+        // a full header name has a single colon, at the end.
+        const char *colon = strchr(v->_str,':');
+        if (colon == NULL || (size_t)(colon - v->_str) + 1 != v->_len
+            || v->_len > HEADER_NAME_MAX)
+          {
+            _prefixes.push_back(i);
+            continue;
+          }
+
+        char *name = strdup(v->_str);
+        for (char *c=name; *c; c++)
+          *c = tolower((unsigned char)*c);
+
+        hash_map<const char*,int,hash<const char*>,eqstr>::iterator hit;
+        if ((hit = _names.find(name)) != _names.end())
+          {
+            _name_masks[(*hit).second] |= bit;
+            free(name);
+          }
+        else
+          {
+            _names.insert(std::pair<const char*,int>(name,_name_masks.size()));
+            _name_masks.push_back(bit);
+            _max_name_length = std::max(_max_name_length,v->_len);
+          }
+      }
+  }
+
+  header_patterns::~header_patterns()
+  {
+    hash_map<const char*,int,hash<const char*>,eqstr>::iterator hit = _names.begin();
+    while (hit!=_names.end())
+      {
+        const char *key = (*hit).first;
+        ++hit;
+        free_const(key);
+      }
+  }
+
+  int header_patterns::intern(const char *header) const
+  {
+    char name[HEADER_NAME_MAX + 1];
+    size_t i = 0;
+    while (i < _max_name_length && header[i] && header[i] != ':')
+      {
+        name[i] = tolower((unsigned char)header[i]);
+        i++;
+      }
+    if (i == _max_name_length || header[i] != ':')
+      return -1;
+    name[i++] = ':';
+    name[i] = '\0';
+
+    hash_map<const char*,int,hash<const char*>,eqstr>::const_iterator hit;
+    if ((hit = _names.find(name)) == _names.end())
+      return -1;
+    return (*hit).second;
+  }
+
+  uint64_t header_patterns::match(const char *header) const
+  {
+    uint64_t mask = _every;
+    int id = intern(header);
+    if (id >= 0)
+      mask |= _name_masks[id];
+    for (size_t i=0; i<_prefixes.size(); i++)
+      {
+        const parsers_list &v = _patterns[_prefixes[i]];
+        if (miscutil::strncmpic(header,v._str,v._len) == 0)
+          mask |= (uint64_t)1 << _prefixes[i];
+      }
+    return mask;
+  }
+
+  /*- header_table -*/
+  header_table::header_table(std::list<const char*> *headers, const header_patterns *patterns)
+    :_headers(headers),_patterns(patterns),_mask(0)
+  {
+    _entries.reserve(32);
+    add_new_headers();
+  }
+
+  void header_table::add_new_headers()
+  {
+    std::list<const char*>::iterator lit;
+    if (_entries.empty())
+      lit = _headers->begin();
+    else
+      {
+        // headers are only erased once all parsers have run.
+        lit = _entries.back()._lit;
+        ++lit;
+      }
+
+    while (lit!=_headers->end())
+      {
+        uint64_t mask = (*lit) ? _patterns->match(*lit) : 0; // crunch()ed headers are ignored.
+        _entries.push_back(header_entry(lit,mask));
+        _mask |= mask;
+        ++lit;
+      }
+  }
+
+  sp_err header_table::run_parser(client_state *csp, const size_t &p, const size_t &e)
+  {
+    /*
+     * The parser owns the header while it runs, it may free
+     * or replace it and look up the other headers.
+     */
+    char *header = (char*)(*_entries[e]._lit);
+    (*_entries[e]._lit) = NULL;
+    sp_err err = _patterns->pattern(p)._parser(csp,&header);
+
+    if (header)
+      {
+        // the header may now be handled by other parsers.
+        (*_entries[e]._lit) = header;
+        _entries[e]._mask = _patterns->match(header);
+        _mask |= _entries[e]._mask;
+      }
+    else
+      {
+        _entries[e]._removed = true;
+        _entries[e]._mask = 0;
+      }
+
+    // the parser may have added headers.
+    add_new_headers();
+    return err;
+  }
+
+  sp_err header_table::apply(client_state *csp)
+  {
+    sp_err err = SP_ERR_OK;
+
+    for (size_t p=0; p<_patterns->size() && err == SP_ERR_OK; p++)
+      {
+        const uint64_t bit = (uint64_t)1 << p;
+        if (!(_mask & bit))
+          continue;
+
+        // headers appended by a parser are visited as well.
+        for (size_t e=0; e<_entries.size() && err == SP_ERR_OK; e++)
+          {
+            if (_entries[e]._mask & bit)
+              err = run_parser(csp,p,e);
+          }
+      }
+
+    for (size_t e=0; e<_entries.size(); e++)
+      {
+        if (_entries[e]._removed)
+          _headers->erase(_entries[e]._lit);
+      }
+    return err;
+  }
+
+} /* end of namespace. */
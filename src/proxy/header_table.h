@@ -0,0 +1,169 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HEADER_TABLE_H
+#define HEADER_TABLE_H
+
+#include "parsers.h"
+#include "stl_hash.h"
+
+#include <stdint.h>
+
+#include <list>
+#include <vector>
+
+/**
+ * Maximum number of parsers in a list handled by a header table.
+ */
+#define HEADER_PATTERNS_MAX 64
+
+/**
+ * Maximum length of an interned header name, longer ones are matched by prefix.
+ */
+#define HEADER_NAME_MAX 63
+
+namespace sp
+{
+  /**
+   * \brief a list of header parsers compiled for dispatch by header name.
+   *
+   *        Header names the parsers look for are interned, i.e. each
+   *        lower-cased 'name:' is given an id, along with the set of parsers
+   *        that handle it. Parsers whose prefix is not a full header name
+   *        (e.g. 'ua-', 'HTTP/') are matched by prefix, and parsers of
+   *        every header ('*') match all of them.
+   */
+  class header_patterns
+  {
+    public:
+      /**
+       * \brief compiles a NULL terminated list of parsers, that must outlive
+       *        this object, with at most HEADER_PATTERNS_MAX entries.
+       */
+      header_patterns(const parsers_list *patterns);
+
+      /**
+       * \brief destructor.
+       */
+      ~header_patterns();
+
+      /**
+       * \brief interned id of the name of a header, or -1 if no parser
+       *        looks for this name.
+       */
+      int intern(const char *header) const;
+
+      /**
+       * \brief set of the parsers that handle a header, as a bitmask of
+       *        their ranks in the list.
+       */
+      uint64_t match(const char *header) const;
+
+      /**
+       * \brief number of parsers.
+       */
+      size_t size() const
+      {
+        return _npatterns;
+      };
+
+      /**
+       * \brief parser of a given rank.
+       */
+      const parsers_list& pattern(const size_t &i) const
+      {
+        return _patterns[i];
+      };
+
+    private:
+      header_patterns(const header_patterns &hp); // not copyable.
+      header_patterns& operator=(const header_patterns &hp);
+
+      const parsers_list *_patterns; /**< parsers, not owned. */
+      size_t _npatterns; /**< number of parsers. */
+      hash_map<const char*,int,hash<const char*>,eqstr> _names; /**< interned names, keys are owned. */
+      std::vector<uint64_t> _name_masks; /**< parsers of each interned name. */
+      std::vector<size_t> _prefixes; /**< ranks of the parsers matched by prefix. */
+      uint64_t _every; /**< parsers of every header. */
+      size_t _max_name_length; /**< length of the longest interned name. */
+  };
+
+  /**
+   * \brief a header of a header table.
+   */
+  class header_entry
+  {
+    public:
+      header_entry(const std::list<const char*>::iterator &lit, const uint64_t &mask)
+        :_lit(lit),_mask(mask),_removed(false)
+      {};
+
+      ~header_entry() {};
+
+      std::list<const char*>::iterator _lit; /**< header in the list. */
+      uint64_t _mask; /**< parsers that handle the header as of now. */
+      bool _removed; /**< whether a parser removed the header. */
+  };
+
+  /**
+   * \brief a list of headers indexed by parser, built in a single scan of
+   *        the list, that runs each parser only on the headers it handles.
+   *
+   *        Parsers see the headers in place, no copy is made. The result is
+   *        the same as checking every header against every parser in turn:
+   *        parsers run in list order, each one on the headers in their
+   *        order, including headers modified by previous parsers or
+   *        appended to the list by a parser.
+   */
+  class header_table
+  {
+    public:
+      /**
+       * \brief indexes a list of headers.
+       */
+      header_table(std::list<const char*> *headers, const header_patterns *patterns);
+
+      /**
+       * \brief destructor.
+       */
+      ~header_table() {};
+
+      /**
+       * \brief runs the parsers, and removes the headers they dropped.
+       * @return the error of the first parser that failed, or SP_ERR_OK.
+       */
+      sp_err apply(client_state *csp);
+
+    private:
+      header_table(const header_table &ht); // not copyable.
+      header_table& operator=(const header_table &ht);
+
+      void add_new_headers();
+
+      sp_err run_parser(client_state *csp, const size_t &p, const size_t &e);
+
+    private:
+      std::list<const char*> *_headers; /**< indexed headers, not owned. */
+      const header_patterns *_patterns; /**< parsers, not owned. */
+      std::vector<header_entry> _entries; /**< headers, in list order. */
+      uint64_t _mask; /**< parsers that handle at least one header. */
+  };
+
+} /* end of namespace. */
+
+#endif
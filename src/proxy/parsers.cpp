@@ -93,6 +93,7 @@
 #include "miscutil.h"
 #include "filters.h"
 #include "cgi.h"
+#include "header_table.h"
 
 #ifndef HAVE_STRPTIME
 #include "strptime.h"
@@ -155,6 +156,9 @@ namespace sp
     parsers_list(NULL,0, NULL)
   };
 
+  header_patterns parsers::_client_header_patterns(parsers::_client_patterns);
+  header_patterns parsers::_server_header_patterns(parsers::_server_patterns);
+
   const add_header_func_ptr parsers::_add_client_headers[] =
   {
     parsers::client_host_adder,
@@ -986,62 +990,29 @@ namespace sp
    *********************************************************************/
   sp_err parsers::sed(client_state *csp, int filter_server_headers)
   {
-    /* XXX: use more descriptive names. */
-    const parsers_list *v;
+    const header_patterns *v;
     const add_header_func_ptr *f;
     sp_err err = SP_ERR_OK;
 
     if (filter_server_headers)
       {
-        v = parsers::_server_patterns;
+        v = &parsers::_server_header_patterns;
         f = parsers::_add_server_headers;
       }
     else
       {
-        v = parsers::_client_patterns;
+        v = &parsers::_client_header_patterns;
         f = parsers::_add_client_headers;
       }
 
     //parsers::scan_headers(csp);
 
-    while ((err == SP_ERR_OK) && (v->_str != NULL))
-      {
-        std::list<const char*>::iterator lit = csp->_headers.begin();
-        while (lit!=csp->_headers.end() && err == SP_ERR_OK)
-          {
-            const char *str = (*lit);
-
-            /* Header crunch()ed in previous run? -> ignore */
-            if (str == NULL)
-              {
-                ++lit;
-                continue;
-              }
-
-            /* Does the current parser handle this header? */
-            if ((miscutil::strncmpic(str, v->_str, v->_len) == 0) ||
-                (v->_len == CHECK_EVERY_HEADER_REMAINING))
-              {
-                char *cstr = strdup(str);
-                err = v->_parser(csp, &cstr);
-                free_const((*lit));
-
-                if (cstr)
-                  {
-                    (*lit) = cstr;
-                  }
-                else
-                  {
-                    std::list<const char*>::iterator clit = lit;
-                    ++lit;
-                    csp->_headers.erase(clit);
-                    continue;
-                  }
-              }
-            ++lit;
-          }
-        v++;
-      }
+    /*
+     * Index the headers by parser in a single scan, and run
+     * each parser on the headers it handles only.
+     */
+    header_table table(&csp->_headers, v);
+    err = table.apply(csp);
 
     /* place additional headers on the csp->_headers list */
     while ((err == SP_ERR_OK) && (*f))
@@ -53,6 +53,7 @@ namespace sp
 #define FILTER_SERVER_HEADERS 1
 
   class parsers_list;
+  class header_patterns;
 
   class parsers
   {
@@ -137,6 +138,10 @@ namespace sp
       static parsers_list _client_patterns[];
       static parsers_list _server_patterns[];
 
+      /* parsers compiled for dispatch by header name. */
+      static header_patterns _client_header_patterns;
+      static header_patterns _server_header_patterns;
+
       static const add_header_func_ptr _add_client_headers[];
       static const add_header_func_ptr _add_server_headers[];
   };
@@ -50,6 +50,23 @@
 #include "encode.h"
 
 #include <algorithm> // std::copy.
+#include <string>
+#include <vector>
+
+/*
+ * Use the PCRE just-in-time compiler when available.
+ */
+#ifdef PCRE_STUDY_JIT_COMPILE
+#define PCRS_STUDY_OPTIONS PCRE_STUDY_JIT_COMPILE
+#else
+#define PCRS_STUDY_OPTIONS 0
+#endif
+
+/*
+ * Returned by pcrs_execute_literal_batch() when jobs of the
+ * batch match overlapping parts of the subject.
+ */
+#define PCRS_BATCH_OVERLAP -200
 
 namespace sp
 {
@@ -418,12 +435,90 @@ plainchar:
   pcrs_job::~pcrs_job()
   {
     if (_pattern) freez(_pattern);
+#ifdef PCRE_STUDY_JIT_COMPILE
+    if (_hints) pcre_free_study(_hints);
+#else
     if (_hints) freez(_hints);
+#endif
     if (_substitute)
       {
         if (_substitute->_text) freez(_substitute->_text);
         delete _substitute;
       }
+    if (_literal) freez(_literal);
+  }
+
+  /*-- pcrs_buffer --*/
+  pcrs_buffer::~pcrs_buffer()
+  {
+    if (_data) freez(_data);
+  }
+
+  /*********************************************************************
+   *
+   * Function    :  pcrs_buffer::reserve
+   *
+   * Description :  Makes room for at least size bytes, doubling
+   *                the allocated size as needed.
+   *
+   * Returns     :  0 on success, PCRS_ERR_NOMEM otherwise.
+   *
+   *********************************************************************/
+  int pcrs_buffer::reserve(size_t size)
+  {
+    if (size <= _size)
+      return 0;
+
+    size_t want = _size ? _size : 64;
+    while (want < size) want *= 2;
+
+    char *data = (char*) realloc(_data, want);
+    if (data == NULL)
+      return PCRS_ERR_NOMEM;
+    _data = data;
+    _size = want;
+    return 0;
+  }
+
+  /*********************************************************************
+   *
+   * Function    :  pcrs_buffer::append
+   *
+   * Description :  Appends data to the buffer, and null terminates it.
+   *
+   * Returns     :  0 on success, PCRS_ERR_NOMEM otherwise.
+   *
+   *********************************************************************/
+  int pcrs_buffer::append(const char *data, size_t length)
+  {
+    if (reserve(_length + length + 1))
+      return PCRS_ERR_NOMEM;
+    memcpy(_data + _length, data, length);
+    _length += length;
+    _data[_length] = '\0';
+    return 0;
+  }
+
+  /*********************************************************************
+   *
+   * Function    :  pcrs_buffer::release
+   *
+   * Description :  Hands the content over to the caller, who
+   *                must free it, and empties the buffer.
+   *
+   * Returns     :  The null terminated content, or NULL if out of memory.
+   *
+   *********************************************************************/
+  char* pcrs_buffer::release()
+  {
+    if (reserve(_length + 1))
+      return NULL;
+    _data[_length] = '\0';
+
+    char *data = _data;
+    _data = NULL;
+    _length = _size = 0;
+    return data;
   }
 
   /*********************************************************************
@@ -631,10 +726,11 @@ plainchar:
       }
 
     /*
-     * Generate hints. This has little overhead, since the
+     * Generate hints, and JIT compile the pattern if the pcre
+     * library supports it. This has little overhead, since the
      * hints will be NULL for a boring pattern anyway.
      */
-    newjob->_hints = pcre_study(newjob->_pattern, 0, &error);
+    newjob->_hints = pcre_study(newjob->_pattern, PCRS_STUDY_OPTIONS, &error);
     if (error != NULL)
       {
         *errptr = PCRS_ERR_STUDY;
@@ -642,6 +738,16 @@ plainchar:
         return NULL;
       }
 
+    /*
+     * Find a literal that every match contains, so that
+     * subjects without it can be skipped without running pcre.
+     */
+    if (pcrs::pcrs_required_literal(pattern, newjob->_options,
+                                    &newjob->_literal, &newjob->_literal_length))
+      {
+        newjob->_flags |= PCRS_LITERAL;
+      }
+
     /*
      * Determine the number of capturing subpatterns.
      * This is needed for handling $+ in the substitute.
@@ -678,6 +784,12 @@ plainchar:
    *                is malloc()ed and it is the caller's responsibility to free
    *                the result when it's no longer needed.
    *
+   *                Jobs write in turn into two growing buffers, and jobs
+   *                that don't match copy nothing. Jobs whose required literal
+   *                is absent from the subject are skipped without running
+   *                pcre, and runs of plain literal jobs that can't interfere
+   *                with each other are applied in a single pass.
+   *
    *                Note: For convenient string handling, a null byte is
    *                      appended to the result. It does not count towards the
    *                      result_length, though.
@@ -699,32 +811,58 @@ plainchar:
   int pcrs::pcrs_execute_list(pcrs_job *joblist, char *subject, size_t subject_length,
                               char **result, size_t *result_length)
   {
-    pcrs_job *job;
-    char *old, *newstr = NULL;
-    int hits, total_hits;
+    pcrs_buffer buffers[2];
+    const char *current = subject;
+    size_t current_length = subject_length;
+    int next = 0, hits, total_hits = 0;
+    pcrs_job *job = joblist, *end;
 
-    old = subject;
-    *result_length = subject_length;
-    total_hits = 0;
+    *result = NULL;
 
-    for (job = joblist; job != NULL; job = job->_next)
+    while (job != NULL)
       {
-        hits = pcrs::pcrs_execute(job, old, *result_length, &newstr, result_length);
+        pcrs_buffer *out = &buffers[next];
+        out->_length = 0;
 
-        if (old != subject) freez(old);
+        hits = PCRS_BATCH_OVERLAP;
+        end = pcrs::pcrs_literal_batch_end(job);
+        if (end != job->_next)
+          {
+            hits = pcrs::pcrs_execute_literal_batch(job, end, current, current_length, out);
+            if (hits != PCRS_BATCH_OVERLAP)
+              job = end;
+          }
+        if (hits == PCRS_BATCH_OVERLAP)
+          {
+            /* Run the first job alone, and try again from the next one. */
+            hits = pcrs::pcrs_execute_into(job, current, current_length, out, FALSE);
+            job = job->_next;
+          }
 
         if (hits < 0)
           {
             return(hits);
           }
-        else
+        else if (hits > 0)
           {
             total_hits += hits;
-            old = newstr;
+            current = out->_data;
+            current_length = out->_length;
+            next ^= 1;
           }
       }
 
-    *result = newstr;
+    if (current == subject)
+      {
+        /* Nothing matched, the result is a copy of the subject. */
+        if (buffers[0].append(subject, subject_length))
+          return(PCRS_ERR_NOMEM);
+        next = 1;
+      }
+
+    *result_length = current_length;
+    if (NULL == (*result = buffers[next ^ 1].release()))
+      return(PCRS_ERR_NOMEM);
     return(total_hits);
   }
 
@@ -759,176 +897,565 @@ plainchar:
   int pcrs::pcrs_execute(pcrs_job *job, const char *subject, size_t subject_length,
                          char **result, size_t *result_length)
   {
-    int offsets[3 * PCRS_MAX_SUBMATCHES],
-        offset,
-        i, k,
-        matches_found,
-        submatches,
-        max_matches = PCRS_MAX_MATCH_INIT;
-    size_t newsize;
-    pcrs_match *matches, *dummy;
-    char *result_offset;
+    pcrs_buffer out;
+    int hits;
 
-    offset = i = 0;
+    *result = NULL;
 
     /*
      * Sanity check & memory allocation
      */
     if (job == NULL || job->_pattern == NULL || job->_substitute == NULL || NULL == subject)
       {
-        *result = NULL;
         return(PCRS_ERR_BADJOB);
       }
 
-    try
+    if (out.reserve(subject_length + 1))
       {
-        matches = new pcrs_match[max_matches];
+        return(PCRS_ERR_NOMEM);
       }
-    catch (std::bad_alloc &e)
+
+    if (0 > (hits = pcrs::pcrs_execute_into(job, subject, subject_length, &out, TRUE)))
+      {
+        return(hits);
+      }
+
+    *result_length = out._length;
+    if (NULL == (*result = out.release()))
       {
-        *result = NULL;
         return(PCRS_ERR_NOMEM);
       }
+    return(hits);
+  }
+
+
+  /*********************************************************************
+   *
+   * Function    :  pcrs_execute_into
+   *
+   * Description :  Apply the regular substitution defined by the job to the
+   *                subject, appending the result to a buffer in a single
+   *                pass as matches are found.
+   *
+   * Parameters  :
+   *          1  :  job = the pcrs_job to be executed
+   *          2  :  subject = the subject string
+   *          3  :  subject_length = the subject's length
+   *          4  :  out = the buffer the result is appended to
+   *          5  :  copy_unmatched = whether to copy the subject to the
+   *                buffer when the job doesn't match.
+   *
+   * Returns     :  The number of substitutions that were made, or
+   *                a negative pcre or pcrs error code.
+   *
+   *********************************************************************/
+  int pcrs::pcrs_execute_into(pcrs_job *job, const char *subject, size_t subject_length,
+                              pcrs_buffer *out, int copy_unmatched)
+  {
+    int offsets[3 * PCRS_MAX_SUBMATCHES],
+        offset = 0,
+        k,
+        backref,
+        submatches = PCRE_ERROR_NOMATCH,
+        hits = 0;
+    size_t copied = 0; /* end of the last match */
+    const pcrs_substitute *substitute = job->_substitute;
 
     /*
-     * Find the pattern and calculate the space
-     * requirements for the result
+     * No need to run pcre on a subject without the required literal.
      */
-    newsize = subject_length;
-
-    while ((submatches = pcre_exec(job->_pattern, job->_hints,
-                                   subject, (int)subject_length, offset, 0, offsets, 3 * PCRS_MAX_SUBMATCHES)) > 0)
+    if (job->_literal == NULL
+        || NULL != pcrs::pcrs_find_literal(job, subject, subject_length, 0))
       {
-        job->_flags |= PCRS_SUCCESS;
-        matches[i]._submatches = submatches;
-
-        for (k = 0; k < submatches; k++)
+        while ((submatches = pcrs::pcrs_exec(job, subject, subject_length, offset,
+                                             offsets, 3 * PCRS_MAX_SUBMATCHES)) > 0)
           {
-            matches[i]._submatch_offset[k] = offsets[2 * k];
-
-            /* Note: Non-found optional submatches have length -1-(-1)==0 */
-            matches[i]._submatch_length[k] = (size_t)(offsets[2 * k + 1] - offsets[2 * k]);
-
-            /* reserve mem for each submatch as often as it is ref'd */
-            newsize += matches[i]._submatch_length[k] * (size_t)job->_substitute->_backref_count[k];
-          }
-        /* plus replacement text size minus match text size */
-        newsize += job->_substitute->_length - matches[i]._submatch_length[0];
+            job->_flags |= PCRS_SUCCESS;
 
-        /* chunk before match */
-        matches[i]._submatch_offset[PCRS_MAX_SUBMATCHES] = 0;
-        matches[i]._submatch_length[PCRS_MAX_SUBMATCHES] = (size_t)offsets[0];
-        newsize += (size_t)offsets[0] * (size_t)job->_substitute->_backref_count[PCRS_MAX_SUBMATCHES];
-
-        /* chunk after match */
-        matches[i]._submatch_offset[PCRS_MAX_SUBMATCHES + 1] = offsets[1];
-        matches[i]._submatch_length[PCRS_MAX_SUBMATCHES + 1] = subject_length - (size_t)offsets[1] - 1;
-        newsize += (subject_length - (size_t)offsets[1]) * (size_t)job->_substitute->_backref_count[PCRS_MAX_SUBMATCHES + 1];
+            if (++hits == 1 && out->reserve(out->_length + subject_length + 1))
+              {
+                return PCRS_ERR_NOMEM;
+              }
 
-        /* Storage for matches exhausted? -> Extend! */
-        if (++i >= max_matches)
-          {
-            int old_max_matches = max_matches;
-            max_matches = (int)(max_matches * PCRS_MAX_MATCH_GROW);
-            try
+            /* copy the chunk preceding the match */
+            if (out->append(subject + copied, (size_t)offsets[0] - copied))
               {
-                dummy = new pcrs_match[max_matches];
+                return PCRS_ERR_NOMEM;
               }
-            catch (std::bad_alloc &e)
+
+            /* For every segment of the substitute.. */
+            for (k = 0; k <= substitute->_backrefs; k++)
               {
-                delete[] matches;
-                *result = NULL;
-                return(PCRS_ERR_NOMEM);
+                /* ...copy its text.. */
+                if (out->append(substitute->_text + substitute->_block_offset[k],
+                                substitute->_block_length[k]))
+                  {
+                    return PCRS_ERR_NOMEM;
+                  }
+
+                /* ..plus, if it's not the last chunk, i.e.: There *is* a backref.. */
+                if (k == substitute->_backrefs)
+                  continue;
+                backref = substitute->_backref[k];
+
+                /* ..in legal range.. */
+                if (backref < PCRS_MAX_SUBMATCHES + 2
+                    /* ..and referencing a real submatch.. */
+                    && backref < submatches
+                    /* ..that is nonempty.. */
+                    && offsets[2 * backref + 1] > offsets[2 * backref])
+                  {
+                    /* ..copy the submatch that is ref'd. */
+                    if (out->append(subject + offsets[2 * backref],
+                                    (size_t)(offsets[2 * backref + 1] - offsets[2 * backref])))
+                      {
+                        return PCRS_ERR_NOMEM;
+                      }
+                  }
               }
-            std::copy(matches,matches+old_max_matches,dummy);
-            delete[] matches;
-            matches = dummy;
-          }
+            copied = (size_t)offsets[1];
 
-        /* Non-global search or limit reached? */
-        if (!(job->_flags & PCRS_GLOBAL)) break;
+            /* Non-global search or limit reached? */
+            if (!(job->_flags & PCRS_GLOBAL)) break;
 
-        /* Don't loop on empty matches */
-        if (offsets[1] == offset)
-          if ((size_t)offset < subject_length)
-            offset++;
-          else
-            break;
-        /* Go find the next one */
-        else
-          offset = offsets[1];
+            /* Don't loop on empty matches */
+            if (offsets[1] == offset)
+              if ((size_t)offset < subject_length)
+                offset++;
+              else
+                break;
+            /* Go find the next one */
+            else
+              offset = offsets[1];
+          }
       }
+
     /* Pass pcre error through if (bad) failiure */
     if (submatches < PCRE_ERROR_NOMATCH)
       {
-        delete[] matches;
         return submatches;
       }
-    matches_found = i;
 
-    /*
-     * Get memory for the result (must be freed by caller!)
-     * and append terminating null byte.
-     */
-    if ((*result = (char*) zalloc(newsize+1)) == NULL)
+    /* Copy the rest. */
+    if ((hits > 0 || copy_unmatched)
+        && out->append(subject + copied, subject_length - copied))
       {
-        delete[] matches;
         return PCRS_ERR_NOMEM;
       }
-    else
+
+    return hits;
+  }
+
+
+  /*********************************************************************
+   *
+   * Function    :  pcrs_exec
+   *
+   * Description :  Runs pcre_exec() for a job, falling back to the
+   *                interpreter if the JIT stack is exhausted.
+   *
+   * Returns     :  The pcre_exec() return code.
+   *
+   *********************************************************************/
+  int pcrs::pcrs_exec(const pcrs_job *job, const char *subject, size_t subject_length,
+                      int offset, int *offsets, int noffsets)
+  {
+    int rc = pcre_exec(job->_pattern, job->_hints, subject, (int)subject_length,
+                       offset, 0, offsets, noffsets);
+#if defined(PCRE_ERROR_JIT_STACKLIMIT) && defined(PCRE_EXTRA_EXECUTABLE_JIT)
+    if (rc == PCRE_ERROR_JIT_STACKLIMIT)
       {
-        (*result)[newsize] = '\0';
+        pcre_extra hints = *job->_hints;
+        hints.flags &= ~PCRE_EXTRA_EXECUTABLE_JIT;
+        rc = pcre_exec(job->_pattern, &hints, subject, (int)subject_length,
+                       offset, 0, offsets, noffsets);
       }
+#endif
+    return rc;
+  }
 
-    /*
-     * Replace
-     */
-    offset = 0;
-    result_offset = *result;
 
-    for (i = 0; i < matches_found; i++)
+  /*********************************************************************
+   *
+   * Function    :  pcrs_find_literal
+   *
+   * Description :  Finds the required literal of a job in the subject,
+   *                ignoring case if the job does.
+   *
+   * Returns     :  A pointer to the first occurrence at or after offset,
+   *                or NULL if there is none.
+   *
+   *********************************************************************/
+  const char* pcrs::pcrs_find_literal(const pcrs_job *job, const char *subject,
+                                      size_t subject_length, size_t offset)
+  {
+    const char *literal = job->_literal;
+    const size_t length = job->_literal_length;
+
+    if (offset + length > subject_length)
+      return NULL;
+
+    const char *p = subject + offset;
+    const char *last = subject + subject_length - length;
+
+    if (!(job->_options & PCRE_CASELESS))
+      {
+        while (p <= last
+               && NULL != (p = (const char*)memchr(p, literal[0], (size_t)(last - p) + 1)))
+          {
+            if (0 == memcmp(p, literal, length))
+              return p;
+            p++;
+          }
+        return NULL;
+      }
+
+    /* The literal is lower case. */
+    for (; p <= last; p++)
+      {
+        size_t i = 0;
+        while (i < length && tolower((unsigned char)p[i]) == literal[i]) i++;
+        if (i == length)
+          return p;
+      }
+    return NULL;
+  }
+
+
+  /*********************************************************************
+   *
+   * Function    :  pcrs_literal_overlaps
+   *
+   * Description :  Tells whether an occurrence of the literal of a plain
+   *                literal job could overlap the substitute text of a
+   *                previous job, once this one has been applied, in
+   *                which case the two jobs can't be applied in one pass.
+   *
+   * Returns     :  Non-zero if they could overlap.
+   *
+   *********************************************************************/
+  int pcrs::pcrs_literal_overlaps(const pcrs_job *job, const pcrs_job *previous)
+  {
+    const char *text = previous->_substitute->_text;
+    const long text_length = (long)previous->_substitute->_length;
+    const char *literal = job->_literal;
+    const long length = (long)job->_literal_length;
+    const int caseless = job->_options & PCRE_CASELESS;
+    long shift, p;
+
+    if (text_length == 0)
       {
-        /* copy the chunk preceding the match */
-        memcpy(result_offset, subject + offset, (size_t)(matches[i]._submatch_offset[0] - offset));
-        result_offset += matches[i]._submatch_offset[0] - offset;
+        /* Removed text joins what surrounds it. */
+        return length > 1;
+      }
 
-        /* For every segment of the substitute.. */
-        for (k = 0; k <= job->_substitute->_backrefs; k++)
+    /* Try every alignment sharing at least one character. */
+    for (shift = 1 - length; shift < text_length; shift++)
+      {
+        const long to = std::min(text_length, shift + length);
+        for (p = std::max(0L, shift); p < to; p++)
           {
-            /* ...copy its text.. */
-            memcpy(result_offset, job->_substitute->_text + job->_substitute->_block_offset[k],
-                   job->_substitute->_block_length[k]);
-            result_offset += job->_substitute->_block_length[k];
+            char c = caseless ? (char)tolower((unsigned char)text[p]) : text[p];
+            if (c != literal[p - shift])
+              break;
+          }
+        if (p == to)
+          return TRUE;
+      }
+    return FALSE;
+  }
 
-            /* ..plus, if it's not the last chunk, i.e.: There *is* a backref.. */
-            if (k != job->_substitute->_backrefs
-                /* ..in legal range.. */
-                && job->_substitute->_backref[k] < PCRS_MAX_SUBMATCHES + 2
-                /* ..and referencing a real submatch.. */
-                && job->_substitute->_backref[k] < matches[i]._submatches
-                /* ..that is nonempty.. */
-                && matches[i]._submatch_length[job->_substitute->_backref[k]] > 0)
+
+  /*********************************************************************
+   *
+   * Function    :  pcrs_literal_batch_end
+   *
+   * Description :  Finds the longest run of plain literal jobs with
+   *                plain substitutes at the head of the joblist, such
+   *                that no literal can overlap the substitute of an
+   *                earlier job of the run.
+   *
+   * Returns     :  The first job after the run.
+   *
+   *********************************************************************/
+  pcrs_job* pcrs::pcrs_literal_batch_end(pcrs_job *joblist)
+  {
+    pcrs_job *end, *job;
+
+#define PCRS_BATCHABLE(job) (((job)->_flags & PCRS_LITERAL) && (job)->_substitute->_backrefs == 0)
+
+    if (!PCRS_BATCHABLE(joblist))
+      return joblist->_next;
+
+    for (end = joblist->_next; end != NULL && PCRS_BATCHABLE(end); end = end->_next)
+      {
+        for (job = joblist; job != end; job = job->_next)
+          {
+            if (pcrs::pcrs_literal_overlaps(end, job))
+              return end;
+          }
+      }
+    return end;
+
+#undef PCRS_BATCHABLE
+  }
+
+
+  /* A match of a plain literal job. */
+  class pcrs_literal_match
+  {
+    public:
+      pcrs_literal_match(const size_t &offset, const pcrs_job *job)
+        :_offset(offset),_job(job)
+      {};
+
+      bool operator<(const pcrs_literal_match &m) const
+      {
+        return _offset < m._offset;
+      };
+
+      size_t _offset;
+      const pcrs_job *_job;
+  };
+
+  /*********************************************************************
+   *
+   * Function    :  pcrs_execute_literal_batch
+   *
+   * Description :  Applies a run of plain literal jobs, as returned by
+   *                pcrs_literal_batch_end(), in a single pass over the
+   *                subject. This gives the same result as applying them
+   *                in turn, as long as their matches don't overlap.
+   *
+   * Parameters  :
+   *          1  :  joblist = the first job of the run
+   *          2  :  end = the first job after the run
+   *          3  :  subject = the subject string
+   *          4  :  subject_length = the subject's length
+   *          5  :  out = the buffer the result is appended to, if any match
+   *
+   * Returns     :  The number of substitutions that were made,
+   *                PCRS_BATCH_OVERLAP if matches overlap, or PCRS_ERR_NOMEM.
+   *
+   *********************************************************************/
+  int pcrs::pcrs_execute_literal_batch(pcrs_job *joblist, pcrs_job *end,
+                                       const char *subject, size_t subject_length,
+                                       pcrs_buffer *out)
+  {
+    std::vector<pcrs_literal_match> matches;
+    pcrs_job *job;
+    const char *p;
+    size_t i, offset, copied;
+
+    for (job = joblist; job != end; job = job->_next)
+      {
+        offset = 0;
+        while (NULL != (p = pcrs::pcrs_find_literal(job, subject, subject_length, offset)))
+          {
+            matches.push_back(pcrs_literal_match((size_t)(p - subject), job));
+            if (!(job->_flags & PCRS_GLOBAL)) break;
+            offset = (size_t)(p - subject) + job->_literal_length;
+          }
+      }
+
+    if (matches.empty())
+      return 0;
+
+    std::stable_sort(matches.begin(), matches.end());
+    for (i = 1; i < matches.size(); i++)
+      {
+        if (matches[i]._offset < matches[i-1]._offset + matches[i-1]._job->_literal_length)
+          return PCRS_BATCH_OVERLAP;
+      }
+
+    if (out->reserve(out->_length + subject_length + 1))
+      return PCRS_ERR_NOMEM;
+
+    copied = 0;
+    for (i = 0; i < matches.size(); i++)
+      {
+        pcrs_job *mjob = const_cast<pcrs_job*>(matches[i]._job);
+        mjob->_flags |= PCRS_SUCCESS;
+        if (out->append(subject + copied, matches[i]._offset - copied)
+            || out->append(mjob->_substitute->_text, mjob->_substitute->_length))
+          return PCRS_ERR_NOMEM;
+        copied = matches[i]._offset + mjob->_literal_length;
+      }
+    if (out->append(subject + copied, subject_length - copied))
+      return PCRS_ERR_NOMEM;
+
+    return (int)matches.size();
+  }
+
+
+  /*********************************************************************
+   *
+   * Function    :  pcrs_required_literal
+   *
+   * Description :  Extracts from a pattern the longest literal that every
+   *                match must contain. The analysis is conservative: no
+   *                literal is found in patterns with alternatives, inline
+   *                options or extended syntax, and groups, classes, wildcards
+   *                and escapes other than quoted punctuation end literals.
+   *
+   * Parameters  :
+   *          1  :  pattern = the pattern
+   *          2  :  options = the pcre options of the pattern
+   *          3  :  literal = for returning the malloc()ed literal, lower
+   *                          case if the pattern is caseless, or NULL if
+   *                          there is none.
+   *          4  :  literal_length = for returning the literal's length
+   *
+   * Returns     :  TRUE if the pattern is the literal itself, FALSE otherwise.
+   *
+   *********************************************************************/
+  int pcrs::pcrs_required_literal(const char *pattern, int options,
+                                  char **literal, size_t *literal_length)
+  {
+    std::string best, current;
+    const size_t n = strlen(pattern);
+    size_t i = 0;
+    int plain = TRUE;
+    int last_literal = FALSE; /* whether the last atom ends current */
+    char c, d;
+
+    *literal = NULL;
+    *literal_length = 0;
+
+    if (options & PCRE_EXTENDED)
+      return FALSE;
+
+#define PCRS_END_LITERAL() { if (current.size() > best.size()) best = current; current.clear(); plain = last_literal = FALSE; }
+#define PCRS_ADD_LITERAL(c) { current += (options & PCRE_CASELESS) ? (char)tolower((unsigned char)(c)) : (c); last_literal = TRUE; }
+
+    while (i < n)
+      {
+        c = pattern[i];
+
+        if (c == '|')
+          {
+            /* Alternatives, nothing is required. */
+            return FALSE;
+          }
+        else if (c == '(' || c == '[')
+          {
+            /* Inline options, assertions, etc. */
+            if (c == '(' && pattern[i+1] == '?')
+              return FALSE;
+
+            /* Skip the group or class. */
+            int depth = 0, in_class = FALSE;
+            size_t class_start = 0;
+            for (; i < n; i++)
               {
-                /* ..copy the submatch that is ref'd. */
-                memcpy(
-                  result_offset,
-                  subject + matches[i]._submatch_offset[job->_substitute->_backref[k]],
-                  matches[i]._submatch_length[job->_substitute->_backref[k]]
-                );
-                result_offset += matches[i]._submatch_length[job->_substitute->_backref[k]];
+                if (pattern[i] == '\\')
+                  i++;
+                else if (in_class)
+                  {
+                    /* A leading ']' is part of the class. */
+                    if (pattern[i] == ']' && i > class_start)
+                      {
+                        in_class = FALSE;
+                        if (depth == 0)
+                          break;
+                      }
+                  }
+                else if (pattern[i] == '[')
+                  {
+                    in_class = TRUE;
+                    class_start = i + 1;
+                    if (pattern[class_start] == '^')
+                      class_start++;
+                  }
+                else if (pattern[i] == '(')
+                  depth++;
+                else if (pattern[i] == ')' && --depth == 0)
+                  break;
+              }
+            if (i >= n)
+              return FALSE;
+            i++;
+            PCRS_END_LITERAL();
+          }
+        else if (c == '.' || c == '^' || c == '$')
+          {
+            PCRS_END_LITERAL();
+            i++;
+          }
+        else if (c == '*' || c == '?' || c == '+'
+                 || (c == '{' && isdigit((unsigned char)pattern[i+1])))
+          {
+            /* Quantifier: the quantified char is only required by '+' and {n,}. */
+            int optional = (c != '+');
+            if (c == '{')
+              {
+                optional = (pattern[i+1] == '0' && !isdigit((unsigned char)pattern[i+2]));
+                while (i < n && pattern[i] != '}') i++;
               }
+            i++;
+            if (i < n && (pattern[i] == '?' || pattern[i] == '+'))
+              i++; /* lazy or possessive */
+
+            if (last_literal && optional && !current.empty())
+              current.erase(current.size() - 1);
+            PCRS_END_LITERAL();
+          }
+        else if (c == '\\')
+          {
+            d = pattern[i+1];
+            if (d == '\0' || d == 'Q' || d == 'E' || d == 'g' || d == 'k' || d == 'N')
+              return FALSE;
+
+            i += 2;
+            if (!isalnum((unsigned char)d))
+              {
+                /* Quoted punctuation. */
+                PCRS_ADD_LITERAL(d);
+                continue;
+              }
+
+            /* Escape sequence, class or backreference, skip its arguments. */
+            if ((d == 'x' || d == 'p' || d == 'P') && pattern[i] == '{')
+              {
+                while (i < n && pattern[i] != '}') i++;
+                i++;
+              }
+            else if (d == 'x')
+              {
+                while (i < n && isxdigit((unsigned char)pattern[i])) i++;
+              }
+            else if (d == 'c' || d == 'p' || d == 'P')
+              {
+                i++;
+              }
+            else if (isdigit((unsigned char)d))
+              {
+                while (i < n && isdigit((unsigned char)pattern[i])) i++;
+              }
+            PCRS_END_LITERAL();
+          }
+        else
+          {
+            PCRS_ADD_LITERAL(c);
+            i++;
           }
-        offset =  matches[i]._submatch_offset[0] + (int)matches[i]._submatch_length[0];
       }
+    if (current.size() > best.size())
+      best = current;
 
-    /* Copy the rest. */
-    memcpy(result_offset, subject + offset, subject_length - (size_t)offset);
+#undef PCRS_END_LITERAL
+#undef PCRS_ADD_LITERAL
+
+    if (best.empty() || (!plain && best.size() < PCRS_MIN_LITERAL))
+      return FALSE;
 
-    *result_length = newsize;
-    delete[] matches;
-    return matches_found;
+    if (NULL == (*literal = strdup(best.c_str())))
+      return FALSE;
+    *literal_length = best.size();
+    return plain;
   }
 
+
 #define is_hex_digit(x) ((x) && strchr("0123456789ABCDEF", toupper(x)))
 
   /*********************************************************************
@@ -76,6 +76,10 @@ namespace sp
 #define PCRS_GLOBAL          1      /* Job should be applied globally, as with perl's g option */
 #define PCRS_TRIVIAL         2      /* Backreferences in the substitute are ignored */
 #define PCRS_SUCCESS         4      /* Job did previously match */
+#define PCRS_LITERAL         8      /* The pattern is the plain literal in _literal */
+
+  /* Minimum length of a required literal worth a prefilter */
+#define PCRS_MIN_LITERAL     2
 
   /*
    * Data types:
@@ -135,7 +139,8 @@ namespace sp
     public:
       pcrs_job()
           :_pattern(NULL),_hints(NULL),_options(0),
-          _flags(0),_substitute(NULL),_next(NULL)
+          _flags(0),_substitute(NULL),_literal(NULL),
+          _literal_length(0),_next(NULL)
       {};
 
       ~pcrs_job();
@@ -144,13 +149,37 @@ namespace sp
       static void pcrs_free_joblist(pcrs_job *job);
 
       pcre *_pattern;                            /* The compiled pcre pattern */
-      pcre_extra *_hints;                        /* The pcre hints for the pattern */
+      pcre_extra *_hints;                        /* The pcre hints for the pattern, JIT compiled if available */
       int _options;                              /* The pcre options (numeric) */
       int _flags;                                /* The pcrs and user flags (see "Flags" above) */
       pcrs_substitute *_substitute;              /* The compiled pcrs substitute */
+      char *_literal;                            /* A literal every match contains, or NULL */
+      size_t _literal_length;                    /* Length of the literal */
       pcrs_job *_next;                    /* Pointer for chaining jobs to joblists */
   };
 
+  /*
+   * A growing output buffer, null terminated
+   * for convenient string handling.
+   */
+  class pcrs_buffer
+  {
+    public:
+      pcrs_buffer()
+          :_data(NULL),_length(0),_size(0)
+      {};
+
+      ~pcrs_buffer();
+
+      int reserve(size_t size);
+      int append(const char *data, size_t length);
+      char* release();
+
+      char *_data;     /* The content */
+      size_t _length;  /* Length of the content, without the null byte */
+      size_t _size;    /* Allocated size */
+  };
+
 
   /*
    * Prototypes:
@@ -176,7 +205,22 @@ namespace sp
       /* Info on errors: */
       static const char *pcrs_strerror(const int error);
 
+      /* Required literals */
+      static int pcrs_required_literal(const char *pattern, int options,
+                                       char **literal, size_t *literal_length);
+
     private:
+      static int pcrs_execute_into(pcrs_job *job, const char *subject, size_t subject_length,
+                                   pcrs_buffer *out, int copy_unmatched);
+      static int pcrs_exec(const pcrs_job *job, const char *subject, size_t subject_length,
+                           int offset, int *offsets, int noffsets);
+      static const char* pcrs_find_literal(const pcrs_job *job, const char *subject,
+                                           size_t subject_length, size_t offset);
+      static int pcrs_literal_overlaps(const pcrs_job *job, const pcrs_job *previous);
+      static pcrs_job* pcrs_literal_batch_end(pcrs_job *joblist);
+      static int pcrs_execute_literal_batch(pcrs_job *joblist, pcrs_job *end,
+                                            const char *subject, size_t subject_length,
+                                            pcrs_buffer *out);
       static int pcrs_parse_perl_options(const char *optstring, int *flags);
       static pcrs_substitute* pcrs_compile_replacement(const char *replacement, int trivialflag,
           int capturecount, int *errptr);
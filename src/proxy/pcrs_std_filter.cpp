@@ -50,7 +50,7 @@ namespace seeks_plugins
   {
   }
 
-  char* pcrs_std_filter_elt::run(client_state *csp, char *str)
+  char* pcrs_std_filter_elt::run(client_state *csp, char *str, size_t size)
   {
     return pcrs_plugin_response(csp, str);
   }
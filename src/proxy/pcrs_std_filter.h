@@ -54,7 +54,7 @@ namespace seeks_plugins
       ~pcrs_std_filter_elt() {};
 
       // virtual from plugin_element.
-      char* run(client_state *csp, char* str);
+      char* run(client_state *csp, char* str, size_t size);
 
     private:
   };
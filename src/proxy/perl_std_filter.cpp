@@ -38,7 +38,7 @@ namespace seeks_plugins
   {
   }
 
-  char* perl_std_filter_elt::run(client_state *csp, char *str)
+  char* perl_std_filter_elt::run(client_state *csp, char *str, size_t size)
   {
     char **output = perl_execute_subroutine(_perl_subr, &str);
     return output[0]; // beware: returns the first string ? TODO: concat.
@@ -42,7 +42,7 @@ namespace seeks_plugins
       ~perl_std_filter_elt() {};
 
       // virtual from plugin_element.
-      char* run(client_state *csp, char *str);
+      char* run(client_state *csp, char *str, size_t size);
 
     public:
       std::string _perl_subr; // Perl subroutine to be executed by the plugin.
@@ -343,50 +343,35 @@ namespace sp
     if (!_joblist)
       return NULL;
 
-    size_t size = 0, prev_size = 0;
-    int job_number = 0;
-    int hits = 0;
+    /*
+     * Run the whole job list at once: jobs that don't match
+     * copy nothing, and independent literal jobs are applied
+     * in a single pass over the content.
+     */
+    size_t prev_size = strlen(old), size = prev_size;
     char *newstr = NULL;
-    pcrs_job *job;
-    for (job = _joblist; NULL != job; job = job->_next)
+    int hits = pcrs::pcrs_execute_list(_joblist, old, prev_size, &newstr, &size);
+    if (hits < 0)
       {
-        job_number++;
-        size = strlen(old)+1;
-        int job_hits = pcrs::pcrs_execute(job, old, size, &newstr, &size);
-
-        if (job_hits >= 0)
-          {
-            /*
-             * That went well. Continue filtering
-             * and use the result of this job as
-             * input for the next one.
-             */
-            hits += job_hits;
-            if (old != csp->_iob._cur)
-              {
-                freez(old);
-              }
-            old = newstr;
-          }
-        else
-          {
-            /*
-             * This job caused an unexpected error. Inform the user
-             * and skip the rest of the jobs in this filter. We could
-             * continue with the next job, but usually the jobs
-             * depend on each other or are similar enough to
-             * fail for the same reason.
-             *
-             * At the moment our pcrs expects the error codes of pcre 3.4,
-             * but newer pcre versions can return additional error codes.
-             * As a result pcrs_strerror()'s error message might be
-             * "Unknown error ...", therefore we print the numerical value
-             * as well.
-             */
-            errlog::log_error(LOG_LEVEL_ERROR, "Skipped plugin job %u: %s (%d)",
-                              job_number, pcrs::pcrs_strerror(job_hits), job_hits);
-            break;
-          }
+        /*
+         * A job caused an unexpected error. Inform the user
+         * and skip this filter. We could continue with the
+         * next job, but usually the jobs depend on each other
+         * or are similar enough to fail for the same reason.
+         *
+         * At the moment our pcrs expects the error codes of pcre 3.4,
+         * but newer pcre versions can return additional error codes.
+         * As a result pcrs_strerror()'s error message might be
+         * "Unknown error ...", therefore we print the numerical value
+         * as well.
+         */
+        errlog::log_error(LOG_LEVEL_ERROR, "Skipped plugin jobs: %s (%d)",
+                          pcrs::pcrs_strerror(hits), hits);
+        hits = 0;
+      }
+    else if (hits > 0 && old != csp->_iob._cur)
+      {
+        freez(old);
       }
     if (_is_dynamic) pcrs_job::pcrs_free_joblist(_joblist);
 
@@ -166,6 +166,8 @@ namespace sp
 
       /**
        * \brief matches a HTTP header with this plugin element's compiled patterns.
+       *        This is a linear scan of the patterns, requests are matched against
+       *        all registered plugin elements at once by plugin_manager::get_url_plugins.
        * @return true if it matches, false otherwise.
        */
       bool match_url(const http_request *http);
@@ -66,6 +66,9 @@ namespace sp
 
   std::string plugin_manager::_config_html_template = "templates/pm_config.html";
 
+  url_matcher plugin_manager::_url_matcher;
+  sp_mutex_t plugin_manager::_url_matcher_mutex;
+
   int plugin_manager::load_all_plugins()
   {
     /**
@@ -171,6 +174,7 @@ namespace sp
     plugin_manager::_ref_interceptor_plugins.clear();
     plugin_manager::_ref_action_plugins.clear();
     plugin_manager::_ref_filter_plugins.clear();
+    plugin_manager::_url_matcher.clear();
     plugin_manager::_factory.clear();
 
     // close all the opened dynamic libs.
@@ -209,6 +213,8 @@ namespace sp
         ++vit;
       }
 
+    plugin_manager::build_url_matcher();
+
     return 0;
   }
 
@@ -271,18 +277,91 @@ namespace sp
       }
   }
 
-  void plugin_manager::get_url_plugins(client_state *csp, http_request *http)
+  void plugin_manager::build_url_matcher()
   {
+    // element e has tag 2e for its positive patterns and 2e+1 for its negative patterns,
+    // elements are numbered in the order they are visited by get_url_plugins.
+    plugin_manager::_url_matcher.clear();
+    uint32_t e = 0;
     std::vector<interceptor_plugin*>::const_iterator lit1
     = plugin_manager::_ref_interceptor_plugins.begin();
     while (lit1!=plugin_manager::_ref_interceptor_plugins.end())
       {
-        interceptor_plugin *ip = (*lit1);
+        plugin_manager::_url_matcher.add_patterns((*lit1)->_pos_patterns,2*e);
+        plugin_manager::_url_matcher.add_patterns((*lit1)->_neg_patterns,2*e+1);
+        ++e;
+        ++lit1;
+      }
+    std::vector<action_plugin*>::const_iterator lit2
+    = plugin_manager::_ref_action_plugins.begin();
+    while (lit2!=plugin_manager::_ref_action_plugins.end())
+      {
+        plugin_manager::_url_matcher.add_patterns((*lit2)->_pos_patterns,2*e);
+        plugin_manager::_url_matcher.add_patterns((*lit2)->_neg_patterns,2*e+1);
+        ++e;
+        ++lit2;
+      }
+    std::vector<filter_plugin*>::const_iterator lit3
+    = plugin_manager::_ref_filter_plugins.begin();
+    while (lit3!=plugin_manager::_ref_filter_plugins.end())
+      {
+        plugin_manager::_url_matcher.add_patterns((*lit3)->_pos_patterns,2*e);
+        plugin_manager::_url_matcher.add_patterns((*lit3)->_neg_patterns,2*e+1);
+        ++e;
+        ++lit3;
+      }
+    plugin_manager::_url_matcher.compile();
+  }
+
+  static bool element_matches(const std::vector<bool> &hits, const uint32_t &e)
+  {
+    // negative patterns have precedence, as in plugin_element::match_url.
+    return hits[2*e] && !hits[2*e+1];
+  }
+
+  void plugin_manager::get_url_plugins(client_state *csp, http_request *http)
+  {
+#ifdef PLUGIN_DEBUG
+    // plugins and the shared matcher are rebuilt on every request,
+    // so that matching is serialized.
+    mutex_lock(&plugin_manager::_url_matcher_mutex);
+    std::vector<interceptor_plugin*>::const_iterator rit1
+    = plugin_manager::_ref_interceptor_plugins.begin();
+    while (rit1!=plugin_manager::_ref_interceptor_plugins.end())
+      {
+        (*rit1)->reload();
+        ++rit1;
+      }
+    std::vector<action_plugin*>::const_iterator rit2
+    = plugin_manager::_ref_action_plugins.begin();
+    while (rit2!=plugin_manager::_ref_action_plugins.end())
+      {
+        (*rit2)->reload();
+        ++rit2;
+      }
+    std::vector<filter_plugin*>::const_iterator rit3
+    = plugin_manager::_ref_filter_plugins.begin();
+    while (rit3!=plugin_manager::_ref_filter_plugins.end())
+      {
+        (*rit3)->reload();
+        ++rit3;
+      }
+    plugin_manager::build_url_matcher();
+#endif
+
+    std::vector<bool> hits;
+    plugin_manager::_url_matcher.match(http,hits);
 #ifdef PLUGIN_DEBUG
-        ip->reload();
+    mutex_unlock(&plugin_manager::_url_matcher_mutex);
 #endif
-        if (ip->match_url(http))
-          csp->add_interceptor_plugin(ip);
+
+    uint32_t e = 0;
+    std::vector<interceptor_plugin*>::const_iterator lit1
+    = plugin_manager::_ref_interceptor_plugins.begin();
+    while (lit1!=plugin_manager::_ref_interceptor_plugins.end())
+      {
+        if (element_matches(hits,e++))
+          csp->add_interceptor_plugin((*lit1));
         ++lit1;
       }
 
@@ -290,12 +369,8 @@ namespace sp
     = plugin_manager::_ref_action_plugins.begin();
     while (lit2!=plugin_manager::_ref_action_plugins.end())
       {
-        action_plugin *ip = (*lit2);
-#ifdef PLUGIN_DEBUG
-        ip->reload();
-#endif
-        if (ip->match_url(http))
-          csp->add_action_plugin(ip);
+        if (element_matches(hits,e++))
+          csp->add_action_plugin((*lit2));
         ++lit2;
       }
 
@@ -303,12 +378,8 @@ namespace sp
     = plugin_manager::_ref_filter_plugins.begin();
     while (lit3!=plugin_manager::_ref_filter_plugins.end())
       {
-        filter_plugin *ip = (*lit3);
-#ifdef PLUGIN_DEBUG
-        ip->reload();
-#endif
-        if (ip->match_url(http))
-          csp->add_filter_plugin(ip);
+        if (element_matches(hits,e++))
+          csp->add_filter_plugin((*lit3));
         ++lit3;
       }
 
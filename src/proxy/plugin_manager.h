@@ -20,6 +20,8 @@
 #define PLUGIN_MANAGER_H
 
 #include "proxy_dts.h"
+#include "url_matcher.h"
+#include "mutexes.h"
 
 #include <vector>
 #include <string>
@@ -91,9 +93,16 @@ namespace sp
        */
       static cgi_dispatcher* find_plugin_cgi_dispatcher(const char *path);
 
+      /**
+       * \brief compiles the URL patterns of all registered plugin elements into
+       *        the shared URL matcher.
+       */
+      static void build_url_matcher();
+
       /**
        * \brief determines which plugins are activated by a client request.
        *        Activated plugins are added to the client request state object.
+       *        All plugin patterns are matched at once, with the shared URL matcher.
        * @param csp HTTP client requeset state.
        * @param http HTTP request.
        */
@@ -118,6 +127,9 @@ namespace sp
 
       static std::string _plugin_repository; /**< plugin repository. */
 
+      static url_matcher _url_matcher; /**< compiled patterns of all registered plugin elements. */
+      static sp_mutex_t _url_matcher_mutex; /**< guards the URL matcher rebuilds under PLUGIN_DEBUG. */
+
     public:
       static std::map<std::string,maker_ptr*,std::less<std::string> > _factory; /**< factory of plugins. */
 
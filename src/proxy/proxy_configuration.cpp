@@ -29,6 +29,7 @@
 #include "gateway.h"
 #include "filters.h"
 #include "plugin_manager.h"
+#include "thread_pool.h"
 
 #include <iostream>
 
@@ -72,6 +73,7 @@ namespace sp
 #define hash_plugindir                     2324026896ul /* "plugindir" */
 #define hash_datadir                       4055122953ul /* "datadir" */
 #define hash_max_client_connections        1237838806ul /* "max-client-connections" */
+#define hash_max_reusable_connections      1417664400ul /* "max-reusable-connections" */
 #define hash_permit_access                 1005955844ul /* "permit-access" */
 #define hash_proxy_info_url                 181245282ul /* "proxy-info-url" */
 #define hash_single_threaded               1186286844ul /* "single-threaded" */
@@ -79,6 +81,7 @@ namespace sp
 #define hash_split_large_cgi_forms          443436323ul /* "split-large-cgi-forms" */
 #define hash_suppress_blocklists           1452993892ul /* "suppress-blocklists" */
 #define hash_templdir                      1485902173ul /* "templdir" */
+#define hash_thread_pool_size              2007195365ul /* "thread-pool-size" */
 #define hash_toggle                        1035528941ul /* "toggle" */
 #define hash_trust_info_url                2137035860ul /* "trust-info-url" */
 #define hash_trustfile                      205192134ul /* "trustfile" */
@@ -100,6 +103,9 @@ namespace sp
 #define hash_user_db_optimize              2686859753ul /* "user-db-optimize" */
 #define hash_user_db_large                 3056519964ul /* "user-db-large" */
 #define hash_user_db_bnum                    27035057ul /* "user-db-bnum" */
+#define hash_user_db_maintenance_chunk      904450634ul /* "user-db-maintenance-chunk" */
+#define hash_user_db_maintenance_workers   3525553514ul /* "user-db-maintenance-workers" */
+#define hash_user_db_maintenance_pause     4128864534ul /* "user-db-maintenance-pause" */
 #define hash_url_source_code               1714992061ul /* "url-source-code" */
 #define hash_ct_transfer_timeout           3371661146ul /* "ct-transfer-timeout" */
 #define hash_ct_connect_timeout            3817701526ul /* "ct-connect-timeout" */
@@ -111,9 +117,10 @@ namespace sp
      _admin_address(NULL),_proxy_info_url(NULL),_usermanual(NULL),
      _hostname(NULL),
      _haddr(NULL),_hport(0),_buffer_limit(0),
-     _forward(NULL),_forwarded_connect_retries(0),_max_client_connections(0),_socket_timeout(0)
+     _forward(NULL),_forwarded_connect_retries(0),_max_client_connections(0),_socket_timeout(0),
+     _thread_pool_size(0)
 #ifdef FEATURE_CONNECTION_KEEP_ALIVE
-     ,_keep_alive_timeout(0)
+     ,_keep_alive_timeout(0),_max_reusable_connections(0)
 #endif
      ,_need_bind(0),
 #ifdef FEATURE_ACL
@@ -124,7 +131,8 @@ namespace sp
      _user_db_startup_check(true),
      _user_db_optimize(true),
      _user_db_large(false),
-     _user_db_bnum(-1)
+     _user_db_bnum(-1),_user_db_maintenance_chunk(1000),_user_db_maintenance_workers(2),
+     _user_db_maintenance_pause(20)
   {
     load_config();
   }
@@ -168,8 +176,10 @@ namespace sp
     _forwarded_connect_retries = 0;
     _max_client_connections    = 0;
     _socket_timeout            = 300; /* XXX: Should be a macro. */
+    _thread_pool_size          = 0; /* as many workers as processors. */
 #ifdef FEATURE_CONNECTION_KEEP_ALIVE
     _keep_alive_timeout        = DEFAULT_KEEP_ALIVE_TIMEOUT;
+    _max_reusable_connections  = MAX_REUSABLE_CONNECTIONS;
     _feature_flags            &= ~RUNTIME_FEATURE_CONNECTION_KEEP_ALIVE;
     _feature_flags            &= ~RUNTIME_FEATURE_CONNECTION_SHARING;
 #endif
@@ -187,6 +197,9 @@ namespace sp
     _user_db_optimize = true;
     _user_db_large = false;
     _user_db_bnum = -1;
+    _user_db_maintenance_chunk = 1000;
+    _user_db_maintenance_workers = 2;
+    _user_db_maintenance_pause = 20;
     _url_source_code = "http://seeks.git.sourceforge.net/git/gitweb.cgi?p=seeks/seeks;a=tree";
 
     _cors_enabled = false;
@@ -808,6 +821,40 @@ namespace sp
                                            "Maximum number of client connection that will be served");
         break;
 
+        /*************************************************************************
+         * max-reusable-connections number
+         *************************************************************************/
+#ifdef FEATURE_CONNECTION_KEEP_ALIVE
+      case hash_max_reusable_connections :
+        if (*arg != '\0')
+          {
+            int max_reusable_connections = atoi(arg);
+            if (0 <= max_reusable_connections)
+              {
+                _max_reusable_connections = (unsigned int)max_reusable_connections;
+              }
+          }
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "Maximum number of open server connections kept for reuse");
+        break;
+#endif
+
+        /*************************************************************************
+         * thread-pool-size number
+         *************************************************************************/
+      case hash_thread_pool_size :
+        if (*arg != '\0')
+          {
+            int thread_pool_size = atoi(arg);
+            if (0 <= thread_pool_size)
+              {
+                _thread_pool_size = (unsigned int)thread_pool_size;
+              }
+          }
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "Number of threads that run the search and ranking tasks");
+        break;
+
         /*************************************************************************
          * proxy-info-url url
          *************************************************************************/
@@ -962,6 +1009,36 @@ namespace sp
                                            "Number of initial buckets in database (-1 for automatic)");
         break;
 
+        /*************************************************************************
+         * user-db-maintenance-chunk Number of records read at once by maintenance jobs
+         *************************************************************************/
+      case hash_user_db_maintenance_chunk:
+        if (atoi(arg) > 0)
+          _user_db_maintenance_chunk = atoi(arg);
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "Number of records read at once by user db maintenance jobs");
+        break;
+
+        /*************************************************************************
+         * user-db-maintenance-workers Number of threads of maintenance jobs
+         *************************************************************************/
+      case hash_user_db_maintenance_workers:
+        if (atoi(arg) > 0)
+          _user_db_maintenance_workers = atoi(arg);
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "Number of threads that deserialize records for user db maintenance jobs");
+        break;
+
+        /*************************************************************************
+         * user-db-maintenance-pause Pause between two chunks, in milliseconds
+         *************************************************************************/
+      case hash_user_db_maintenance_pause:
+        if (atoi(arg) >= 0)
+          _user_db_maintenance_pause = atoi(arg);
+        configuration_spec::html_table_row(_config_args,cmd,arg,
+                                           "Pause of user db maintenance jobs between two chunks, in milliseconds");
+        break;
+
         /*************************************************************************
         * url-source-code URL to source code repository
         *************************************************************************/
@@ -1109,12 +1186,15 @@ namespace sp
     // TODO.
     errlog::set_debug_level(_debug);
 
+    thread_pool::set_shared_size(_thread_pool_size);
+
 #ifdef FEATURE_CONNECTION_KEEP_ALIVE
     if (_feature_flags & RUNTIME_FEATURE_CONNECTION_KEEP_ALIVE)
       {
         if (_multi_threaded)
           {
             gateway::set_keep_alive_timeout(_keep_alive_timeout);
+            gateway::set_max_reusable_connections(_max_reusable_connections);
           }
         else
           {
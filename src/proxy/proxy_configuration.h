@@ -142,9 +142,15 @@ namespace sp
       /* Timeout when waiting on sockets for data to become available. */
       int _socket_timeout;
 
+      /* Number of worker threads of the shared thread pool, 0 for one per processor. */
+      unsigned int _thread_pool_size;
+
 #ifdef FEATURE_CONNECTION_KEEP_ALIVE
       /* Maximum number of seconds after which an open connection will no longer be reused. */
       unsigned int _keep_alive_timeout;
+
+      /* Maximum number of open server connections kept for reuse. */
+      unsigned int _max_reusable_connections;
 #endif
 
       /* Nonzero if we need to bind() to the new port. */
@@ -185,6 +191,15 @@ namespace sp
       /* user db initial number of buckets. */
       int64_t _user_db_bnum;
 
+      /* number of records read at once by user db maintenance jobs. */
+      unsigned int _user_db_maintenance_chunk;
+
+      /* number of threads that deserialize records for user db maintenance jobs. */
+      unsigned int _user_db_maintenance_workers;
+
+      /* pause of user db maintenance jobs between two chunks, in milliseconds. */
+      unsigned int _user_db_maintenance_pause;
+
       /* pointer to source code. */
       std::string _url_source_code;
 
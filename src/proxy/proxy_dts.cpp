@@ -27,6 +27,7 @@
 #include "interceptor_plugin.h"
 #include "action_plugin.h"
 #include "filter_plugin.h"
+#include "stream_filter.h"
 
 #include "cgi.h" // for cgi_error_memory_response.
 #include "miscutil.h"
@@ -277,13 +278,14 @@ namespace sp
 # ifdef FEATURE_CONNECTION_KEEP_ALIVE
      _expected_content_length(0),
 # endif
-     _error_message(NULL),_next(NULL)
+     _error_message(NULL),_stream_filter(NULL),_next(NULL)
   {
   }
 
   client_state::~client_state()
   {
     freez(_error_message);
+    delete _stream_filter;
     miscutil::list_remove_all(&_headers);
     miscutil::list_remove_all(&_tags);
   }
@@ -298,21 +300,31 @@ namespace sp
         return NULL;
       }
 
+    /*
+     * plugins free their input unless it is the content of the iob,
+     * point the iob to each input so that ownership stays here.
+     */
+    char *iob_cur = _iob._cur;
     char *oldstr = _iob._cur;
 
     size_t size = (size_t)(_iob._eod - _iob._cur);
     std::list<filter_plugin*>::const_iterator fit;
     for (fit=_filter_plugins.begin(); fit!=_filter_plugins.end(); ++fit)
       {
+        _iob._cur = oldstr;
         char *newstr = (*fit)->run(this, oldstr, size); // TODO: virtual call might be inside, for allowing straight pcrs use...
-        if (oldstr != _iob._cur)
+        if (newstr && newstr != oldstr)
           {
-            freez(oldstr);
+            if (oldstr != iob_cur)
+              {
+                freez(oldstr);
+              }
+            oldstr = newstr;
+            size = strlen(oldstr);
           }
-        oldstr = newstr;
-        size = strlen(oldstr);
       }
-    return oldstr;
+    _iob._cur = _iob._buf ? iob_cur : NULL; // a plugin may have reset the iob.
+    return (oldstr != iob_cur) ? oldstr : NULL;
   }
 
   void client_state::add_plugin(plugin *p)
@@ -123,6 +123,7 @@ namespace sp
   class filter_plugin;
 
   class proxy_configuration;
+  class stream_filter;
 
   /**
    * A HTTP request.  This includes the method (GET, POST) and
@@ -852,6 +853,9 @@ namespace sp
        */
       char *_error_message;
 
+      /** Streaming content filter for the current response, or NULL. */
+      stream_filter *_stream_filter;
+
       /** Next thread in linked list. Only read or modify from the main thread! */
       client_state *_next;
   };
@@ -49,6 +49,7 @@
 #include "interceptor_plugin.h"
 #include "action_plugin.h"
 #include "filter_plugin.h"
+#include "stream_filter.h"
 #include "proxy_configuration.h"
 #include "sweeper.h"
 #include "iso639.h"
@@ -68,7 +69,6 @@ namespace sp
   std::vector<sweepable*> seeks_proxy::_recurrent = std::vector<sweepable*>();
 
 #ifdef MUTEX_LOCKS_AVAILABLE
-  sp_mutex_t seeks_proxy::_connection_reuse_mutex;
 #ifndef HAVE_GMTIME_R
   sp_mutex_t seeks_proxy::_gmtime_mutex;
 #endif
@@ -807,32 +807,6 @@ namespace sp
   }
 
 #ifdef FEATURE_CONNECTION_KEEP_ALIVE
-  /*********************************************************************
-   *
-   * Function    :  wait_for_alive_connections
-   *
-   * Description :  Waits for alive connections to timeout.
-   *
-   * Parameters  :  N/A
-   *
-   * Returns     :  N/A
-   *
-   *********************************************************************/
-  void seeks_proxy::wait_for_alive_connections(void)
-  {
-    int connections_alive = gateway::close_unusable_connections();
-    while (0 < connections_alive)
-      {
-        errlog::log_error(LOG_LEVEL_CONNECT,
-                          "Waiting for %d connections to timeout.",
-                          connections_alive);
-        sleep(60);
-        connections_alive = gateway::close_unusable_connections();
-      }
-    errlog::log_error(LOG_LEVEL_CONNECT, "No connections to wait for left.");
-  }
-
-
   /*********************************************************************
    *
    * Function    :  save_connection_destination
@@ -1428,6 +1402,7 @@ namespace sp
             errlog::log_error(LOG_LEVEL_CONNECT,
                               "Closing server socket %u. Opened for %s.",
                               csp->_sfd, csp->_server_connection._host);
+            gateway::forget_connection(csp->_sfd);
             spsockets::close_socket(csp->_sfd);
             gateway::mark_connection_closed(&csp->_server_connection);
           }
@@ -1729,12 +1704,31 @@ reading_done:
               {
                 if (server_body || http->_ssl)  // server_body seems to only depends on the KEEP_ALIVE feature.
                   {
+                    /*
+                     * If we have been streaming the document,
+                     * flush the filters and end the chunked body.
+                     */
+                    if (csp->_stream_filter)
+                      {
+                        std::string out;
+                        if (SP_ERR_OK != csp->_stream_filter->finish(out)
+                            || spsockets::write_socket(csp->_cfd, out.c_str(), out.size()))
+                          {
+                            errlog::log_error(LOG_LEVEL_ERROR, "write streamed content to client failed: %E");
+                            seeks_proxy::mark_server_socket_tainted(csp);
+                            return;
+                          }
+                        csp->_content_length = csp->_stream_filter->out_bytes();
+                        delete csp->_stream_filter;
+                        csp->_stream_filter = NULL;
+                      }
+
                     /*
                      * If we have been buffering up the document,
                      * now is the time to apply content modification
                      * and send the result to the client.
                      */
-                    if (content_filter)
+                    else if (content_filter)
                       {
                         //p = filters::execute_content_filter(csp, content_filter); // basically applies all applicable +filters.
 
@@ -1805,7 +1799,30 @@ reading_done:
              */
             if (server_body || http->_ssl)
               {
-                if (content_filter)
+                if (csp->_stream_filter)
+                  {
+                    /*
+                     * Filter the content as it comes, and write
+                     * whatever got out of the filters to the client.
+                     */
+                    std::string out;
+                    if (SP_ERR_OK != csp->_stream_filter->feed(buf, (size_t)len, out))
+                      {
+                        errlog::log_error(LOG_LEVEL_ERROR,
+                                          "Streamed filtering of %s failed, closing the connection.",
+                                          http->_url);
+                        seeks_proxy::mark_server_socket_tainted(csp);
+                        return;
+                      }
+                    if (!out.empty()
+                        && spsockets::write_socket(csp->_cfd, out.c_str(), out.size()))
+                      {
+                        errlog::log_error(LOG_LEVEL_ERROR, "write streamed content to client failed: %E");
+                        seeks_proxy::mark_server_socket_tainted(csp);
+                        return;
+                      }
+                  }
+                else if (content_filter)
                   {
                     /*
                      * If there is no memory left for buffering the content, or the buffer limit
@@ -2057,6 +2074,39 @@ reading_done:
                     long header_length = csp->_iob._cur - header_start;
                     assert(csp->_iob._cur > header_start);
                     byte_count += (unsigned long long)(len - header_length);
+
+                    /*
+                     * If the client takes chunks, stream the body through the
+                     * filters instead of buffering it whole: rewrite and send
+                     * the header now, along with what has been filtered from
+                     * the beginning of the body.
+                     */
+                    if (stream_filter::can_stream(csp))
+                      {
+                        std::string out;
+                        delete csp->_stream_filter;
+                        csp->_stream_filter = new stream_filter(csp);
+                        freez(hdr);
+                        if (SP_ERR_OK != csp->_stream_filter->update_server_headers()
+                            || NULL == (hdr = miscutil::list_to_text(&csp->_headers)))
+                          {
+                            /* FIXME Should handle error properly */
+                            errlog::log_error(LOG_LEVEL_FATAL, "Out of memory parsing server header");
+                          }
+                        if (SP_ERR_OK != csp->_stream_filter->feed(csp->_iob._cur,
+                            (size_t)(csp->_iob._eod - csp->_iob._cur), out)
+                            || spsockets::write_socket(csp->_cfd, hdr, strlen(hdr))
+                            || (!out.empty()
+                                && spsockets::write_socket(csp->_cfd, out.c_str(), out.size())))
+                          {
+                            errlog::log_error(LOG_LEVEL_CONNECT, "write streamed header to client failed: %E");
+                            freez(hdr);
+                            seeks_proxy::mark_server_socket_tainted(csp);
+                            return;
+                          }
+                        IOB_RESET(csp);
+                        content_filter = false;
+                      }
                   }
                 /* we're finished with the server's header */
                 freez(hdr);
@@ -2129,7 +2179,6 @@ reading_done:
   void seeks_proxy::serve(client_state *csp)
   {
 #ifdef FEATURE_CONNECTION_KEEP_ALIVE
-    static int monitor_thread_running = 0;
     int continue_chatting = 0;
     unsigned int latency = 0;
 
@@ -2180,6 +2229,8 @@ reading_done:
                 freez(csp->_error_message);
                 miscutil::list_remove_all(&csp->_headers);
                 miscutil::list_remove_all(&csp->_tags);
+                delete csp->_stream_filter;
+                csp->_stream_filter = NULL;
                 if (NULL != csp->_fwd)
                   {
                     delete csp->_fwd;
@@ -2200,16 +2251,6 @@ reading_done:
                     csp->_sfd = SP_INVALID_SOCKET;
                     spsockets::close_socket(csp->_cfd);
                     csp->_cfd = SP_INVALID_SOCKET;
-                    mutex_lock(&seeks_proxy::_connection_reuse_mutex);
-                    if (!monitor_thread_running)
-                      {
-                        monitor_thread_running = 1;
-                        mutex_unlock(&seeks_proxy::_connection_reuse_mutex);
-                        seeks_proxy::wait_for_alive_connections();
-                        mutex_lock(&seeks_proxy::_connection_reuse_mutex);
-                        monitor_thread_running = 0;
-                      }
-                    mutex_unlock(&seeks_proxy::_connection_reuse_mutex);
                   }
 
                 break;
@@ -2366,7 +2407,6 @@ reading_done:
      */
     mutex_init(&errlog::_log_mutex);
     //mutex_init(&seeks_proxy::_log_init_mutex);
-    mutex_init(&seeks_proxy::_connection_reuse_mutex);
 
     /*
      * XXX: The assumptions below are a bit naive
@@ -2399,6 +2439,9 @@ reading_done:
     // initialize sweeper's mutex.
     mutex_init(&sweeper::_mem_dust_mutex);
     mutex_init(&sweeper::_recur_mutex);
+
+    // initialize the plugin URL matcher's mutex.
+    mutex_init(&plugin_manager::_url_matcher_mutex);
   }
 
 #ifdef _WIN32
@@ -104,7 +104,6 @@ namespace sp
 #define MUTEX_LOCKS_AVAILABLE
 
       //static sp_mutex_t _log_init_mutex;
-      static sp_mutex_t _connection_reuse_mutex;
 
 #ifndef HAVE_GMTIME_R
       static sp_mutex_t _gmtime_mutex;
@@ -168,7 +167,6 @@ namespace sp
       static int server_response_is_complete(client_state *csp,
                                              unsigned long long content_length);
 #ifdef FEATURE_CONNECTION_KEEP_ALIVE
-      static void wait_for_alive_connections();
       static void save_connection_destination(sp_socket sfd, const http_request *http,
                                               const forward_spec *fwd,
                                               reusable_connection *server_connection);
@@ -0,0 +1,372 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stream_filter.h"
+#include "filter_plugin.h"
+#include "mem_utils.h"
+#include "miscutil.h"
+#include "errlog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <algorithm>
+
+namespace sp
+{
+  /* de-chunking states. */
+#define CHUNK_SIZE    0 /* reading the chunk size. */
+#define CHUNK_EXT     1 /* skipping chunk extensions, up to the end of line. */
+#define CHUNK_DATA    2 /* reading chunk data. */
+#define CHUNK_DATA_END 3 /* skipping the CRLF after chunk data. */
+#define CHUNK_TRAILER 4 /* at the beginning of a trailer line. */
+#define CHUNK_TRAILER_LINE 5 /* inside a trailer line. */
+#define CHUNK_DONE    6 /* last chunk and trailer read. */
+
+  stream_filter::stream_filter(client_state *csp,
+                               const size_t &window,
+                               const size_t &lookbehind)
+    :_csp(csp),_window_size(window),_lookbehind(lookbehind),
+     _chunked((csp->_flags & CSP_FLAG_CHUNKED) != 0),
+     _chunk_state(CHUNK_SIZE),_chunk_left(0),_chunk_digits(0),
+#ifdef FEATURE_ZLIB
+     _compressed((csp->_content_type & (CT_GZIP|CT_DEFLATE)) != 0),
+     _zinit(false),_zdone(false),
+#endif
+     _in_bytes(0),_out_bytes(0),_peak_memory(0)
+  {
+    if (_lookbehind > _window_size)
+      _lookbehind = _window_size;
+#ifdef FEATURE_ZLIB
+    memset(&_zstr,0,sizeof(_zstr));
+#endif
+  }
+
+  stream_filter::~stream_filter()
+  {
+#ifdef FEATURE_ZLIB
+    if (_zinit)
+      inflateEnd(&_zstr);
+#endif
+  }
+
+  bool stream_filter::can_stream(const client_state *csp)
+  {
+    if (!csp->_http._ver || miscutil::strcmpic(csp->_http._ver,"HTTP/1.1"))
+      return false; // client can't take chunks.
+    if (!csp->_http._cmd || !miscutil::strncmpic(csp->_http._cmd,"HEAD",4))
+      return false; // no body.
+    if (csp->_headers.empty() || !(*csp->_headers.begin())
+        || miscutil::strncmpic((*csp->_headers.begin()),"HTTP/1.1",8))
+      return false; // server response was downgraded.
+    if (csp->_http._status < 200 || csp->_http._status == 204
+        || csp->_http._status == 304)
+      return false; // no body.
+    return true;
+  }
+
+  sp_err stream_filter::update_server_headers()
+  {
+    std::list<const char*>::iterator lit = _csp->_headers.begin();
+    while (lit!=_csp->_headers.end())
+      {
+        const char *str = (*lit);
+        if (str
+            && (!miscutil::strncmpic(str,"Content-Length:",15)
+                || !miscutil::strncmpic(str,"Transfer-Encoding:",18)
+#ifdef FEATURE_ZLIB
+                || (_compressed && !miscutil::strncmpic(str,"Content-Encoding:",17))
+#endif
+               ))
+          {
+            errlog::log_error(LOG_LEVEL_HEADER,"Crunching for streamed filtering: %s",str);
+            free_const(str);
+            lit = _csp->_headers.erase(lit);
+            continue;
+          }
+        ++lit;
+      }
+    _csp->_flags |= CSP_FLAG_MODIFIED;
+    return miscutil::enlist(&_csp->_headers,"Transfer-Encoding: chunked");
+  }
+
+  sp_err stream_filter::feed(const char *buf, const size_t &len, std::string &out)
+  {
+    _in_bytes += len;
+    return _chunked ? dechunk(buf,len,out) : decode(buf,len,out);
+  }
+
+  sp_err stream_filter::finish(std::string &out)
+  {
+    if (_chunked && _chunk_state != CHUNK_DONE)
+      errlog::log_error(LOG_LEVEL_INFO,
+                        "Server body ended before the last chunk, filtering what we got.");
+#ifdef FEATURE_ZLIB
+    if (_compressed && !_zinit && !_zhead.empty())
+      {
+        // less than the two bytes needed to sniff deflated data.
+        errlog::log_error(LOG_LEVEL_ERROR,"Compressed body too short to be decompressed");
+        return SP_ERR_COMPRESS;
+      }
+    if (_zinit && !_zdone)
+      errlog::log_error(LOG_LEVEL_INFO,
+                        "Unexpected end of compressed body. Using what we got so far.");
+#endif
+    filter_window(true,out);
+    out.append("0\r\n\r\n");
+    errlog::log_error(LOG_LEVEL_RE_FILTER,
+                      "Streamed filtering of %s%s: %llu bytes in, %llu bytes out, %u bytes peak.",
+                      _csp->_http._hostport ? _csp->_http._hostport : "",
+                      _csp->_http._path ? _csp->_http._path : "",
+                      _in_bytes,_out_bytes,(unsigned int)_peak_memory);
+    return SP_ERR_OK;
+  }
+
+  sp_err stream_filter::dechunk(const char *buf, const size_t &len,
+                                std::string &out)
+  {
+    size_t i = 0;
+    while (i < len && _chunk_state != CHUNK_DONE)
+      {
+        char c = buf[i];
+        switch (_chunk_state)
+          {
+          case CHUNK_SIZE:
+            if (isxdigit((unsigned char)c))
+              {
+                if (++_chunk_digits > (int)(2*sizeof(size_t)-1))
+                  {
+                    errlog::log_error(LOG_LEVEL_ERROR,
+                                      "Chunk size too large in \"chunked\" transfer coding");
+                    return SP_ERR_PARSE;
+                  }
+                _chunk_left = _chunk_left * 16
+                              + (isdigit((unsigned char)c) ? c - '0' : (tolower((unsigned char)c) - 'a' + 10));
+                i++;
+                break;
+              }
+            if (_chunk_digits == 0)
+              {
+                errlog::log_error(LOG_LEVEL_ERROR,
+                                  "Invalid chunksize while stripping \"chunked\" transfer coding");
+                return SP_ERR_PARSE;
+              }
+            _chunk_state = CHUNK_EXT;
+            break;
+          case CHUNK_EXT:
+            if (c == '\n')
+              {
+                _chunk_digits = 0;
+                _chunk_state = _chunk_left > 0 ? CHUNK_DATA : CHUNK_TRAILER;
+              }
+            i++;
+            break;
+          case CHUNK_DATA:
+          {
+            size_t n = std::min(_chunk_left,len-i);
+            sp_err err = decode(buf+i,n,out);
+            if (err != SP_ERR_OK)
+              return err;
+            i += n;
+            _chunk_left -= n;
+            if (_chunk_left == 0)
+              _chunk_state = CHUNK_DATA_END;
+            break;
+          }
+          case CHUNK_DATA_END:
+            if (c == '\n')
+              _chunk_state = CHUNK_SIZE;
+            i++;
+            break;
+          case CHUNK_TRAILER:
+            if (c == '\n')
+              _chunk_state = CHUNK_DONE;
+            else if (c != '\r')
+              _chunk_state = CHUNK_TRAILER_LINE;
+            i++;
+            break;
+          case CHUNK_TRAILER_LINE:
+            if (c == '\n')
+              _chunk_state = CHUNK_TRAILER;
+            i++;
+            break;
+          }
+      }
+    return SP_ERR_OK;
+  }
+
+  sp_err stream_filter::decode(const char *buf, const size_t &len,
+                               std::string &out)
+  {
+    if (len == 0)
+      return SP_ERR_OK;
+#ifdef FEATURE_ZLIB
+    if (_compressed)
+      return inflate_data(buf,len,out);
+#endif
+    _window.append(buf,len);
+    filter_window(false,out);
+    return SP_ERR_OK;
+  }
+
+#ifdef FEATURE_ZLIB
+  sp_err stream_filter::inflate_data(const char *buf, const size_t &len,
+                                     std::string &out)
+  {
+    if (_zdone)
+      return SP_ERR_OK; // ignore anything after the end of the stream.
+
+    if (!_zinit)
+      {
+        int wbits = 16 + MAX_WBITS; // gzip header and trailer, handled by zlib.
+        if (_csp->_content_type & CT_DEFLATE)
+          {
+            /*
+             * Deflated data should begin with a zlib header (RFC 1950),
+             * but in practice raw compressed data is often sent instead.
+             * Sniff the first two bytes to tell.
+             */
+            _zhead.append(buf,len);
+            if (_zhead.size() < 2)
+              return SP_ERR_OK;
+            unsigned char cmf = _zhead[0], flg = _zhead[1];
+            wbits = ((cmf & 0x0f) == Z_DEFLATED && ((cmf << 8) + flg) % 31 == 0)
+                    ? MAX_WBITS : -MAX_WBITS;
+          }
+        if (inflateInit2(&_zstr,wbits) != Z_OK)
+          {
+            errlog::log_error(LOG_LEVEL_ERROR,"Error initializing decompression");
+            return SP_ERR_COMPRESS;
+          }
+        _zinit = true;
+        if (!_zhead.empty())
+          {
+            std::string head;
+            head.swap(_zhead);
+            return inflate_data(head.c_str(),head.size(),out);
+          }
+      }
+
+    char zbuf[BUFFER_SIZE];
+    _zstr.next_in = (Bytef*)buf;
+    _zstr.avail_in = (unsigned int)len;
+    do
+      {
+        _zstr.next_out = (Bytef*)zbuf;
+        _zstr.avail_out = sizeof(zbuf);
+        int status = inflate(&_zstr,Z_NO_FLUSH);
+        _window.append(zbuf,sizeof(zbuf) - _zstr.avail_out);
+        filter_window(false,out);
+        if (status == Z_STREAM_END)
+          {
+            _zdone = true;
+            break;
+          }
+        else if (status == Z_BUF_ERROR)
+          break; // needs more input.
+        else if (status != Z_OK)
+          {
+            errlog::log_error(LOG_LEVEL_ERROR,"Error decompressing body: %s",
+                              _zstr.msg ? _zstr.msg : "unknown error");
+            return SP_ERR_COMPRESS;
+          }
+      }
+    while (_zstr.avail_in > 0 || _zstr.avail_out == 0);
+    return SP_ERR_OK;
+  }
+#endif
+
+  void stream_filter::filter_window(const bool &last, std::string &out)
+  {
+    while (!_window.empty())
+      {
+        size_t wsize = _window.size();
+        if (wsize > _peak_memory)
+          _peak_memory = wsize;
+        if (!last && wsize < _window_size + _lookbehind)
+          return;
+
+        // cut after the last line or tag end within the lookbehind.
+        size_t cut = wsize;
+        if (!last)
+          {
+            cut = wsize - _lookbehind;
+            for (size_t i=wsize; i>wsize-_lookbehind; i--)
+              {
+                if (_window[i-1] == '\n' || _window[i-1] == '>')
+                  {
+                    cut = i;
+                    break;
+                  }
+              }
+          }
+
+        char *str = (char*) malloc(cut+1);
+        memcpy(str,_window.c_str(),cut);
+        str[cut] = '\0';
+        _window.erase(0,cut);
+
+        char *filtered = run_filters(str,cut);
+        size_t fsize = strlen(filtered);
+        if (wsize + fsize > _peak_memory)
+          _peak_memory = wsize + fsize;
+        append_chunk(filtered,fsize,out);
+        _out_bytes += fsize;
+        freez(filtered);
+      }
+  }
+
+  char* stream_filter::run_filters(char *str, size_t size)
+  {
+    /*
+     * plugins free their input unless it is the content of the iob,
+     * point the iob to each input so that ownership stays here.
+     */
+    char *iob_cur = _csp->_iob._cur;
+    char *oldstr = str;
+    std::list<filter_plugin*>::const_iterator fit;
+    for (fit=_csp->_filter_plugins.begin(); fit!=_csp->_filter_plugins.end(); ++fit)
+      {
+        _csp->_iob._cur = oldstr;
+        char *newstr = (*fit)->run(_csp,oldstr,size);
+        if (newstr && newstr != oldstr)
+          {
+            freez(oldstr);
+            oldstr = newstr;
+            size = strlen(oldstr);
+          }
+      }
+    _csp->_iob._cur = iob_cur;
+    return oldstr;
+  }
+
+  void stream_filter::append_chunk(const char *data, const size_t &size,
+                                   std::string &out)
+  {
+    if (size == 0)
+      return; // a zero-sized chunk would end the body.
+    char chunk_header[32];
+    snprintf(chunk_header,sizeof(chunk_header),"%lx\r\n",(unsigned long)size);
+    out.append(chunk_header);
+    out.append(data,size);
+    out.append("\r\n");
+  }
+
+} /* end of namespace. */
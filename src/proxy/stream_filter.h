@@ -0,0 +1,171 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STREAM_FILTER_H
+#define STREAM_FILTER_H
+
+#include "config.h"
+#include "proxy_dts.h"
+
+#ifdef FEATURE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <string>
+
+/**
+ * Size of the window of decoded content handed to the filter plugins.
+ */
+#define STREAM_FILTER_WINDOW 65536
+
+/**
+ * Maximum amount of unfiltered content carried from one window to the next.
+ */
+#define STREAM_FILTER_LOOKBEHIND 4096
+
+namespace sp
+{
+  /**
+   * \brief streaming content filter for a server response body.
+   *
+   *        The body is de-chunked and decompressed as it is read from the
+   *        server, then handed to the filter plugins by windows of
+   *        decoded content. Windows are cut after the last line or tag end
+   *        ('\n' or '>') found in the last lookbehind bytes, and what follows
+   *        the cut is carried over to the next window, so that substitutions
+   *        that do not span lines or tags see the same content as with
+   *        whole-body filtering. Filtered output is re-chunked for the client,
+   *        whose headers must be rewritten with update_server_headers().
+   *
+   *        Memory is bounded by window + lookbehind plus the filter output,
+   *        whatever the size of the body.
+   */
+  class stream_filter
+  {
+    public:
+      /**
+       * \brief constructor.
+       * @param csp client state, with server headers parsed.
+       * @param window size of the windows handed to the filters.
+       * @param lookbehind maximum size of the unfiltered tail carried over.
+       */
+      stream_filter(client_state *csp,
+                    const size_t &window=STREAM_FILTER_WINDOW,
+                    const size_t &lookbehind=STREAM_FILTER_LOOKBEHIND);
+
+      /**
+       * \brief destructor.
+       */
+      ~stream_filter();
+
+      /**
+       * \brief whether the response can be streamed to the client, i.e.
+       *        the client and server talk HTTP/1.1 and the response has a body.
+       */
+      static bool can_stream(const client_state *csp);
+
+      /**
+       * \brief rewrites the server headers for a streamed response:
+       *        removes Content-Length, Transfer-Encoding, and Content-Encoding
+       *        if the body gets decompressed, and adds 'Transfer-Encoding: chunked'.
+       */
+      sp_err update_server_headers();
+
+      /**
+       * \brief feeds a piece of the server body.
+       * @param buf data as read from the server.
+       * @param len size of buf.
+       * @param out receives the chunk-encoded output ready for the client, if any.
+       * @return SP_ERR_OK, SP_ERR_PARSE on invalid chunked encoding,
+       *         SP_ERR_COMPRESS on invalid compressed data.
+       */
+      sp_err feed(const char *buf, const size_t &len, std::string &out);
+
+      /**
+       * \brief filters what remains and terminates the chunked output.
+       * @param out receives the last output chunks for the client.
+       */
+      sp_err finish(std::string &out);
+
+      /**
+       * \brief number of body bytes read from the server.
+       */
+      unsigned long long in_bytes() const
+      {
+        return _in_bytes;
+      };
+
+      /**
+       * \brief number of filtered body bytes sent out, without chunk framing.
+       */
+      unsigned long long out_bytes() const
+      {
+        return _out_bytes;
+      };
+
+      /**
+       * \brief highest amount of body bytes held at once by the filter.
+       */
+      size_t peak_memory() const
+      {
+        return _peak_memory;
+      };
+
+    private:
+      stream_filter(const stream_filter &sf); // not copyable.
+      stream_filter& operator=(const stream_filter &sf);
+
+      sp_err dechunk(const char *buf, const size_t &len, std::string &out);
+
+      sp_err decode(const char *buf, const size_t &len, std::string &out);
+
+#ifdef FEATURE_ZLIB
+      sp_err inflate_data(const char *buf, const size_t &len, std::string &out);
+#endif
+
+      void filter_window(const bool &last, std::string &out);
+
+      char* run_filters(char *str, size_t size);
+
+      static void append_chunk(const char *data, const size_t &size,
+                               std::string &out);
+
+    private:
+      client_state *_csp;
+      size_t _window_size; /**< size of the windows handed to the filters. */
+      size_t _lookbehind; /**< maximum size of the carried over tail. */
+      bool _chunked; /**< whether the server body is chunked. */
+      int _chunk_state; /**< de-chunking state. */
+      size_t _chunk_left; /**< bytes left in the current chunk, or size being parsed. */
+      int _chunk_digits; /**< number of hex digits of the chunk size being parsed. */
+#ifdef FEATURE_ZLIB
+      bool _compressed; /**< whether the server body is gzipped or deflated. */
+      bool _zinit; /**< whether the zlib stream is initialized. */
+      bool _zdone; /**< whether the end of the zlib stream was reached. */
+      z_stream _zstr; /**< zlib inflate state. */
+      std::string _zhead; /**< first bytes of deflated data, to detect the zlib header. */
+#endif
+      std::string _window; /**< decoded, unfiltered content. */
+      unsigned long long _in_bytes;
+      unsigned long long _out_bytes;
+      size_t _peak_memory;
+  };
+
+} /* end of namespace. */
+
+#endif
@@ -0,0 +1,299 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Benchmark of the connection pool against the former fixed array of
+ * reusable connections under a single lock, polled on every lookup:
+ * many client threads forward requests to a handful of upstream servers,
+ * reusing a pooled connection when there is one and opening a new one
+ * otherwise. Server connections are local socket pairs.
+ */
+
+#include "connection_pool.h"
+#include "spsockets.h"
+#include "miscutil.h"
+#include "mem_utils.h"
+#include "errlog.h"
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+using namespace sp;
+
+/**
+ * The former pool: a fixed array of slots under a single lock,
+ * where every lookup first polls all the idle connections.
+ */
+class linear_pool
+{
+  public:
+    linear_pool()
+    {
+      mutex_init(&_mutex);
+      for (int i=0; i<MAX_REUSABLE_CONNECTIONS; i++)
+        {
+          _slots[i]._sfd = SP_INVALID_SOCKET;
+          _slots[i]._in_use = 0;
+        }
+      _lookups = _hits = 0;
+    }
+
+    ~linear_pool()
+    {
+      for (int i=0; i<MAX_REUSABLE_CONNECTIONS; i++)
+        {
+          if (_slots[i]._sfd != SP_INVALID_SOCKET && !_slots[i]._in_use)
+            close(_slots[i]._sfd);
+          freez(_slots[i]._host);
+        }
+      mutex_destroy(&_mutex);
+    }
+
+    void close_unusable()
+    {
+      mutex_lock(&_mutex);
+      time_t now = time(NULL);
+      for (int i=0; i<MAX_REUSABLE_CONNECTIONS; i++)
+        {
+          reusable_connection &rc = _slots[i];
+          if (rc._in_use || rc._sfd == SP_INVALID_SOCKET)
+            continue;
+          if (rc._keep_alive_timeout < now - rc._timestamp
+              || !spsockets::socket_is_still_usable(rc._sfd))
+            {
+              close(rc._sfd);
+              rc._sfd = SP_INVALID_SOCKET;
+              freez(rc._host);
+            }
+        }
+      mutex_unlock(&_mutex);
+    }
+
+    sp_socket get(const http_request *http, const forward_spec *fwd)
+    {
+      sp_socket sfd = SP_INVALID_SOCKET;
+      close_unusable();
+      mutex_lock(&_mutex);
+      _lookups++;
+      for (int i=0; i<MAX_REUSABLE_CONNECTIONS; i++)
+        {
+          reusable_connection &rc = _slots[i];
+          if (!rc._in_use && rc._sfd != SP_INVALID_SOCKET
+              && rc._port == http->_port && rc._forwarder_type == fwd->_type
+              && !miscutil::strcmpic(rc._host,http->_host))
+            {
+              rc._in_use = 1;
+              sfd = rc._sfd;
+              _hits++;
+              break;
+            }
+        }
+      mutex_unlock(&_mutex);
+      return sfd;
+    }
+
+    bool remember(const reusable_connection *connection,
+                  const http_request *http, const forward_spec *fwd)
+    {
+      mutex_lock(&_mutex);
+      int free_slot = -1;
+      for (int i=0; i<MAX_REUSABLE_CONNECTIONS; i++)
+        {
+          reusable_connection &rc = _slots[i];
+          if (rc._sfd == connection->_sfd)
+            {
+              rc._in_use = 0;
+              rc._timestamp = connection->_timestamp;
+              mutex_unlock(&_mutex);
+              return true;
+            }
+          if (free_slot < 0 && rc._sfd == SP_INVALID_SOCKET)
+            free_slot = i;
+        }
+      if (free_slot < 0)
+        {
+          mutex_unlock(&_mutex);
+          return false;
+        }
+      reusable_connection &rc = _slots[free_slot];
+      rc._sfd = connection->_sfd;
+      rc._in_use = 0;
+      rc._timestamp = connection->_timestamp;
+      rc._keep_alive_timeout = connection->_keep_alive_timeout;
+      rc._host = strdup(http->_host);
+      rc._port = http->_port;
+      rc._forwarder_type = fwd->_type;
+      mutex_unlock(&_mutex);
+      return true;
+    }
+
+    double reuse_rate() const
+    {
+      return _lookups ? _hits / (double)_lookups : 0.0;
+    }
+
+  private:
+    sp_mutex_t _mutex;
+    reusable_connection _slots[MAX_REUSABLE_CONNECTIONS];
+    unsigned long _lookups;
+    unsigned long _hits;
+};
+
+static const char *upstreams[] =
+{
+  "www.google.com", "www.bing.com", "search.yahoo.com", "www.exalead.com",
+  "www.seeks-project.info", "en.wikipedia.org", "www.youtube.com", "twitter.com"
+};
+
+static int nrequests = 0;
+static int nupstreams = 4;
+
+template<class P>
+class client_arg
+{
+  public:
+    client_arg()
+      :_pool(NULL),_id(0)
+    {};
+
+    P *_pool;
+    int _id;
+    std::vector<int> _peers; /**< server ends of the connections opened. */
+};
+
+template<class P>
+static void* client(void *arg)
+{
+  client_arg<P> *ca = static_cast<client_arg<P>*>(arg);
+  forward_spec fwd;
+  std::vector<http_request> http(nupstreams);
+  for (int u=0; u<nupstreams; u++)
+    {
+      http[u]._host = strdup(upstreams[u % 8]);
+      http[u]._port = 80 + u / 8;
+    }
+
+  for (int r=0; r<nrequests; r++)
+    {
+      int u = (ca->_id + r) % nupstreams;
+      reusable_connection rc;
+      rc._sfd = ca->_pool->get(&http[u],&fwd);
+      if (rc._sfd == SP_INVALID_SOCKET)
+        {
+          int sv[2];
+          if (socketpair(AF_UNIX,SOCK_STREAM,0,sv) != 0)
+            {
+              perror("socketpair");
+              exit(1);
+            }
+          rc._sfd = sv[0];
+          ca->_peers.push_back(sv[1]);
+        }
+
+      // the request is served, the connection is kept alive.
+      rc._timestamp = time(NULL);
+      rc._request_sent = rc._response_received = rc._timestamp;
+      rc._keep_alive_timeout = 180;
+      if (!ca->_pool->remember(&rc,&http[u],&fwd))
+        close(rc._sfd);
+    }
+  return NULL;
+}
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+template<class P>
+static double run(P *pool, const int &nclients)
+{
+  std::vector<client_arg<P> > args(nclients);
+  std::vector<pthread_t> threads(nclients);
+  struct timeval tv_start;
+  gettimeofday(&tv_start,NULL);
+  for (int c=0; c<nclients; c++)
+    {
+      args[c]._pool = pool;
+      args[c]._id = c;
+      pthread_create(&threads[c],NULL,&client<P>,&args[c]);
+    }
+  for (int c=0; c<nclients; c++)
+    pthread_join(threads[c],NULL);
+  double ms = elapsed_ms(tv_start);
+
+  for (int c=0; c<nclients; c++)
+    for (size_t i=0; i<args[c]._peers.size(); i++)
+      close(args[c]._peers[i]);
+  return ms;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+    {
+      std::cout << "Usage: <number of clients> <requests per client> [number of upstreams]\n";
+      exit(0);
+    }
+
+  int nclients = atoi(argv[1]);
+  nrequests = atoi(argv[2]);
+  if (argc > 3)
+    nupstreams = atoi(argv[3]);
+
+  errlog::init_log_module();
+  errlog::set_debug_level(LOG_LEVEL_FATAL | LOG_LEVEL_ERROR);
+
+  double total = nclients * (double)nrequests;
+
+  linear_pool *lp = new linear_pool();
+  double linear_ms = run(lp,nclients);
+  double linear_rate = lp->reuse_rate();
+  delete lp;
+
+  connection_pool *gp = new connection_pool(MAX_REUSABLE_CONNECTIONS,1);
+  double global_ms = run(gp,nclients);
+  connection_pool_stats global_stats;
+  gp->get_stats(global_stats);
+  delete gp;
+
+  connection_pool *cp = new connection_pool();
+  double pool_ms = run(cp,nclients);
+  connection_pool_stats stats;
+  cp->get_stats(stats);
+  delete cp;
+
+  std::cout << nclients << " clients, " << nrequests << " requests each, "
+            << nupstreams << " upstreams\n";
+  std::cout << "linear array: " << linear_ms * 1000000.0 / total << " ns/request, reuse rate "
+            << linear_rate << std::endl;
+  std::cout << "pool, 1 lock: " << global_ms * 1000000.0 / total << " ns/request, reuse rate "
+            << global_stats.reuse_rate() << std::endl;
+  std::cout << "pool, " << CONNECTION_POOL_STRIPES << " locks: " << pool_ms * 1000000.0 / total
+            << " ns/request, reuse rate " << stats.reuse_rate()
+            << ", " << stats._remembered << " connections opened\n";
+
+  return 0;
+}
@@ -0,0 +1,205 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Benchmark of header processing with the header table against the
+ * former scan of every header for every parser, with a copy of each
+ * handled header, on a typical browser request and parsers laid out as
+ * the client header parsers of parsers::sed.
+ */
+
+#include "header_table.h"
+#include "miscutil.h"
+#include "mem_utils.h"
+#include "errlog.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+using namespace sp;
+
+static unsigned long ncalls = 0;
+
+// lets the header through, as most parsers do.
+static sp_err keep(client_state *csp, char **header)
+{
+  ncalls++;
+  return SP_ERR_OK;
+}
+
+static parsers_list patterns[] =
+{
+  parsers_list("referer:",8,&keep),
+  parsers_list("user-agent:",11,&keep),
+  parsers_list("ua-",3,&keep),
+  parsers_list("from:",5,&keep),
+  parsers_list("cookie:",7,&keep),
+  parsers_list("x-forwarded-for:",16,&keep),
+  parsers_list("Accept-Encoding:",16,&keep),
+  parsers_list("TE:",3,&keep),
+  parsers_list("Host:",5,&keep),
+  parsers_list("if-modified-since:",18,&keep),
+  parsers_list("Keep-Alive:",11,&keep),
+  parsers_list("connection:",11,&keep),
+  parsers_list("proxy-connection:",17,&keep),
+  parsers_list("max-forwards:",13,&keep),
+  parsers_list("Accept-Language:",16,&keep),
+  parsers_list("if-none-match:",14,&keep),
+  parsers_list("Range:",6,&keep),
+  parsers_list("Request-Range:",14,&keep),
+  parsers_list("If-Range:",9,&keep),
+  parsers_list("X-Filter:",9,&keep),
+  parsers_list("*",0,&keep),
+  parsers_list(NULL,0,NULL)
+};
+
+static const char *request[] =
+{
+  "GET http://www.example.com/search?q=seeks HTTP/1.1",
+  "Host: www.example.com",
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:10.0) Gecko/20100101 Firefox/10.0",
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8",
+  "Accept-Language: en-us,en;q=0.5",
+  "Accept-Encoding: gzip, deflate",
+  "Accept-Charset: ISO-8859-1,utf-8;q=0.7,*;q=0.7",
+  "Proxy-Connection: keep-alive",
+  "Referer: http://www.example.com/",
+  "Cookie: session=0123456789abcdef; prefs=lang%3Den; tracking=xyz",
+  "If-Modified-Since: Sat, 29 Oct 2011 19:43:31 GMT",
+  "If-None-Match: \"abc123\"",
+  "Cache-Control: max-age=0",
+  "DNT: 1",
+  NULL
+};
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+static void fill_headers(std::list<const char*> &headers)
+{
+  for (int i=0; request[i]; i++)
+    miscutil::enlist(&headers,request[i]);
+}
+
+static void clear_headers(std::list<const char*> &headers)
+{
+  std::list<const char*>::iterator lit;
+  for (lit=headers.begin(); lit!=headers.end(); ++lit)
+    free_const(*lit);
+  headers.clear();
+}
+
+// the former parsers::sed loop.
+static sp_err linear_sed(client_state *csp, const parsers_list *v)
+{
+  sp_err err = SP_ERR_OK;
+  while ((err == SP_ERR_OK) && (v->_str != NULL))
+    {
+      std::list<const char*>::iterator lit = csp->_headers.begin();
+      while (lit!=csp->_headers.end() && err == SP_ERR_OK)
+        {
+          const char *str = (*lit);
+          if (str == NULL)
+            {
+              ++lit;
+              continue;
+            }
+          if ((miscutil::strncmpic(str, v->_str, v->_len) == 0) ||
+              (v->_len == CHECK_EVERY_HEADER_REMAINING))
+            {
+              char *cstr = strdup(str);
+              err = v->_parser(csp, &cstr);
+              free_const((*lit));
+              if (cstr)
+                (*lit) = cstr;
+              else
+                {
+                  std::list<const char*>::iterator clit = lit;
+                  ++lit;
+                  csp->_headers.erase(clit);
+                  continue;
+                }
+            }
+          ++lit;
+        }
+      v++;
+    }
+  return err;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+    {
+      std::cout << "Usage: <number of requests>\n";
+      exit(0);
+    }
+
+  int nrequests = atoi(argv[1]);
+
+  errlog::init_log_module();
+  errlog::set_debug_level(LOG_LEVEL_FATAL | LOG_LEVEL_ERROR);
+
+  client_state csp;
+  header_patterns hp(patterns);
+  struct timeval tv_start;
+
+  // list filling is measured apart and taken out.
+  gettimeofday(&tv_start,NULL);
+  for (int r=0; r<nrequests; r++)
+    {
+      fill_headers(csp._headers);
+      clear_headers(csp._headers);
+    }
+  double fill_ms = elapsed_ms(tv_start);
+
+  ncalls = 0;
+  gettimeofday(&tv_start,NULL);
+  for (int r=0; r<nrequests; r++)
+    {
+      fill_headers(csp._headers);
+      linear_sed(&csp,patterns);
+      clear_headers(csp._headers);
+    }
+  double linear_ms = elapsed_ms(tv_start) - fill_ms;
+  unsigned long linear_calls = ncalls;
+
+  ncalls = 0;
+  gettimeofday(&tv_start,NULL);
+  for (int r=0; r<nrequests; r++)
+    {
+      fill_headers(csp._headers);
+      header_table table(&csp._headers,&hp);
+      table.apply(&csp);
+      clear_headers(csp._headers);
+    }
+  double table_ms = elapsed_ms(tv_start) - fill_ms;
+
+  std::cout << nrequests << " requests, " << linear_calls / nrequests << " parser calls per request"
+            << (linear_calls == ncalls ? "" : ", MISMATCH") << std::endl;
+  std::cout << "linear scan: " << linear_ms * 1000000.0 / nrequests << " ns/request\n";
+  std::cout << "header table: " << table_ms * 1000000.0 / nrequests << " ns/request\n";
+
+  return linear_calls == ncalls ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Benchmark of pcrs_execute_list against applying the jobs of a filter
+ * one by one with pcrs_execute, as plugins used to do, on a synthetic page
+ * with a set of typical content filter jobs. Jobs can also be read from
+ * a file, one pcrs command per line, and the page from an html file.
+ */
+
+#include "pcrs.h"
+#include "errlog.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+using namespace sp;
+
+static const char *default_jobs[] =
+{
+  "s/<script[^>]*>.*?<\\/script>//sig",
+  "s/<blink>(.*?)<\\/blink>/$1/ig",
+  "s/<marquee[^>]*>/<span>/ig",
+  "s/<\\/marquee>/<\\/span>/ig",
+  "s/(<body[^>]*?)\\s+onload=\"[^\"]*\"/$1/ig",
+  "s/(<img[^>]*?)\\s+width=\"468\"/$1/g",
+  "s/\\bwindow\\.open\\(/void(/g",
+  "s/document.write/void/g",
+  "s/googleads/no-ads/g",
+  "s/doubleclick.net/localhost/g",
+  "s/adserver/localhost/g",
+  "s/pagead2/no-ads/g",
+  "s/banner_ad/no_ad/g",
+  "s/class=\"sponsored\"/class=\"hidden\"/g",
+  "s/\\.swf\"/.none\"/g",
+  "s/<embed/<noembed/ig",
+  "s/refresh/no-refresh/g",
+  "s/utm_source=[^&\"]*//g",
+  "s/onunload=/data-onunload=/g",
+  "s/onbeforeunload=/data-onbeforeunload=/g",
+  NULL
+};
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+static std::string make_page(const size_t &page_size)
+{
+  std::ostringstream page;
+  page << "<html><head><title>test</title></head><body class=\"main\" onload=\"init()\">\n";
+  for (int i=0; (size_t)page.tellp() < page_size; i++)
+    {
+      page << "<div id=\"d" << i << "\"><p>Some paragraph of text number " << i
+           << ", with a <a href=\"http://www.example.com/page" << i << ".html\">link</a>.</p>\n";
+      if (i % 20 == 0)
+        page << "<img src=\"http://adserver.example.com/banner" << i << ".gif\" width=\"468\">\n";
+      if (i % 50 == 0)
+        page << "<script type=\"text/javascript\">document.write('x" << i << "');</script>\n";
+      page << "</div>\n";
+    }
+  page << "</body></html>\n";
+  return page.str();
+}
+
+static std::string read_file(const char *filename)
+{
+  std::ifstream ifs(filename);
+  std::ostringstream content;
+  content << ifs.rdbuf();
+  return content.str();
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+    {
+      std::cout << "Usage: <page size in KB> <number of runs> [job file] [html file]\n";
+      exit(0);
+    }
+
+  size_t page_size = atoi(argv[1]) * 1024;
+  int nruns = atoi(argv[2]);
+
+  errlog::init_log_module();
+  errlog::set_debug_level(LOG_LEVEL_FATAL | LOG_LEVEL_ERROR);
+
+  std::vector<std::string> commands;
+  if (argc > 3)
+    {
+      std::istringstream lines(read_file(argv[3]));
+      std::string line;
+      while (std::getline(lines,line))
+        if (!line.empty() && line[0] != '#')
+          commands.push_back(line);
+    }
+  else
+    {
+      for (int i=0; default_jobs[i]; i++)
+        commands.push_back(default_jobs[i]);
+    }
+
+  pcrs_job *joblist = NULL, *last = NULL;
+  int njobs = 0, nliterals = 0;
+  for (size_t i=0; i<commands.size(); i++)
+    {
+      int err = 0;
+      pcrs_job *job = pcrs::pcrs_compile_command(commands[i].c_str(),&err);
+      if (!job)
+        {
+          std::cout << "failed compiling " << commands[i] << ": " << pcrs::pcrs_strerror(err) << std::endl;
+          continue;
+        }
+      if (job->_literal)
+        nliterals++;
+      if (last)
+        last->_next = job;
+      else joblist = job;
+      last = job;
+      njobs++;
+    }
+
+  std::string page = argc > 4 ? read_file(argv[4]) : make_page(page_size);
+  std::cout << njobs << " jobs (" << nliterals << " with a required literal), page of "
+            << page.size() << " bytes\n";
+
+  // jobs one by one.
+  struct timeval tv_start;
+  std::string sequential;
+  int seq_hits = 0;
+  gettimeofday(&tv_start,NULL);
+  for (int r=0; r<nruns; r++)
+    {
+      char *old = strdup(page.c_str()), *newstr = NULL;
+      size_t size = page.size();
+      seq_hits = 0;
+      for (pcrs_job *job=joblist; job!=NULL; job=job->_next)
+        {
+          int hits = pcrs::pcrs_execute(job,old,size,&newstr,&size);
+          free(old);
+          if (hits < 0)
+            {
+              std::cout << "job failed: " << pcrs::pcrs_strerror(hits) << std::endl;
+              exit(1);
+            }
+          seq_hits += hits;
+          old = newstr;
+        }
+      if (r == 0)
+        sequential = std::string(old,size);
+      free(old);
+    }
+  double seq_ms = elapsed_ms(tv_start);
+
+  // job list.
+  std::string list;
+  int list_hits = 0;
+  gettimeofday(&tv_start,NULL);
+  for (int r=0; r<nruns; r++)
+    {
+      char *subject = strdup(page.c_str()), *result = NULL;
+      size_t size = 0;
+      list_hits = pcrs::pcrs_execute_list(joblist,subject,page.size(),&result,&size);
+      free(subject);
+      if (list_hits < 0)
+        {
+          std::cout << "job list failed: " << pcrs::pcrs_strerror(list_hits) << std::endl;
+          exit(1);
+        }
+      if (r == 0)
+        list = std::string(result,size);
+      free(result);
+    }
+  double list_ms = elapsed_ms(tv_start);
+
+  bool same = (sequential == list && seq_hits == list_hits);
+  std::cout << seq_hits << " hits, results " << (same ? "identical" : "DIFFER") << std::endl;
+  std::cout << "job by job: " << seq_ms / nruns << " ms/page ("
+            << page.size() * nruns / (seq_ms * 1000.0) << " MB/s)\n";
+  std::cout << "job list: " << list_ms / nruns << " ms/page ("
+            << page.size() * nruns / (list_ms * 1000.0) << " MB/s)\n";
+
+  pcrs_job::pcrs_free_joblist(joblist);
+  return same ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Benchmark of streamed content filtering against whole-body buffering,
+ * on a gzipped and chunked synthetic page read by BUFFER_SIZE pieces.
+ * Reports the peak amount of body held in memory and the time to the
+ * first byte sent to the client.
+ */
+
+#include "stream_filter.h"
+#include "filter_plugin.h"
+#include "errlog.h"
+
+#include <zlib.h>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+using namespace sp;
+
+// replaces every 'foo' with 'bar!'.
+class foo_filter : public filter_plugin
+{
+  public:
+    foo_filter()
+      :filter_plugin(std::vector<url_spec*>(),std::vector<url_spec*>(),NULL)
+    {};
+
+    char* run(client_state *csp, char *str, size_t size)
+    {
+      std::string res;
+      const char *p = str, *q;
+      while ((q = strstr(p,"foo")))
+        {
+          res.append(p,q-p);
+          res.append("bar!");
+          p = q + 3;
+        }
+      res.append(p);
+      return strdup(res.c_str());
+    };
+};
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+static std::string make_response(const size_t &body_size, size_t &plain_size)
+{
+  std::ostringstream body;
+  for (int i=0; (size_t)body.tellp() < body_size; i++)
+    body << "<p class=\"line" << i << "\">some foo text, " << rand() << " foo</p>\n";
+  std::string plain = body.str();
+  plain_size = plain.size();
+
+  z_stream zstr;
+  memset(&zstr,0,sizeof(zstr));
+  deflateInit2(&zstr,Z_DEFAULT_COMPRESSION,Z_DEFLATED,16+MAX_WBITS,8,Z_DEFAULT_STRATEGY);
+  std::string gz(deflateBound(&zstr,plain.size()) + 32,'\0');
+  zstr.next_in = (Bytef*)plain.c_str();
+  zstr.avail_in = plain.size();
+  zstr.next_out = (Bytef*)&gz[0];
+  zstr.avail_out = gz.size();
+  deflate(&zstr,Z_FINISH);
+  gz.resize(zstr.total_out);
+  deflateEnd(&zstr);
+
+  std::ostringstream chunked;
+  for (size_t p=0; p<gz.size(); p+=8192)
+    {
+      size_t n = std::min((size_t)8192,gz.size()-p);
+      chunked << std::hex << n << "\r\n" << gz.substr(p,n) << "\r\n";
+    }
+  chunked << "0\r\n\r\n";
+  return chunked.str();
+}
+
+// runs the response through a filter, returns the total time.
+static double run(stream_filter &sf, const std::string &response,
+                  double &ttfb, size_t &out_size)
+{
+  struct timeval tv_start;
+  gettimeofday(&tv_start,NULL);
+  ttfb = -1.0;
+  out_size = 0;
+  std::string out;
+  for (size_t p=0; p<response.size(); p+=BUFFER_SIZE)
+    {
+      if (sf.feed(response.c_str()+p,std::min((size_t)BUFFER_SIZE,response.size()-p),out) != SP_ERR_OK)
+        {
+          std::cout << "filtering failed\n";
+          exit(1);
+        }
+      if (!out.empty() && ttfb < 0.0)
+        ttfb = elapsed_ms(tv_start);
+      out_size += out.size();
+      out.clear();
+    }
+  sf.finish(out);
+  if (ttfb < 0.0)
+    ttfb = elapsed_ms(tv_start);
+  out_size += out.size();
+  return elapsed_ms(tv_start);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+    {
+      std::cout << "Usage: <body size in KB> [window size in KB]\n";
+      exit(0);
+    }
+
+  size_t body_size = atoi(argv[1]) * 1024;
+  size_t window = argc > 2 ? atoi(argv[2]) * 1024 : STREAM_FILTER_WINDOW;
+
+  errlog::init_log_module();
+  errlog::set_debug_level(LOG_LEVEL_FATAL | LOG_LEVEL_ERROR);
+
+  size_t plain_size = 0;
+  std::string response = make_response(body_size,plain_size);
+  std::cout << "body: " << plain_size << " bytes, " << response.size() << " bytes gzipped and chunked\n";
+
+  client_state csp;
+  csp._http._ver = strdup("HTTP/1.1");
+  csp._http._status = 200;
+  csp._content_type = CT_TEXT | CT_GZIP;
+  csp._flags |= CSP_FLAG_CHUNKED;
+  foo_filter ff;
+  csp._filter_plugins.push_back(&ff);
+
+  // whole-body buffering, i.e. a window as large as the body.
+  double ttfb = 0.0;
+  size_t out_size = 0;
+  stream_filter whole(&csp,(size_t)-1 / 2,0);
+  double ms = run(whole,response,ttfb,out_size);
+  std::cout << "buffered: " << ms << " ms, first byte after " << ttfb << " ms, peak memory "
+            << whole.peak_memory() << " bytes, " << out_size << " bytes out\n";
+
+  stream_filter streamed(&csp,window,STREAM_FILTER_LOOKBEHIND);
+  ms = run(streamed,response,ttfb,out_size);
+  std::cout << "streamed: " << ms << " ms, first byte after " << ttfb << " ms, peak memory "
+            << streamed.peak_memory() << " bytes, " << out_size << " bytes out\n";
+
+  csp._filter_plugins.clear();
+  return whole.out_bytes() == streamed.out_bytes() ? 0 : 1;
+}
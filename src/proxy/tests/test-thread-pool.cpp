@@ -0,0 +1,218 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Benchmark of a search pipeline at high query rate, with the fan-outs of
+ * a query run either by a thread per task, as before, or by a shared
+ * thread pool of various sizes: each query parses the outputs of several
+ * search engines, then computes the features of its snippets, both
+ * spread over tasks, from many concurrent client threads.
+ */
+
+#include "thread_pool.h"
+#include "errlog.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace sp;
+
+static int nqueries = 0;
+static int nengines = 5;
+static int nsnippets = 50;
+static int work = 20000; /**< units of work of a task. */
+
+static sp_mutex_t threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int running_threads = 0;
+static int max_running_threads = 0;
+
+class stage_arg
+{
+  public:
+    stage_arg()
+      :_seed(0),_result(0)
+    {};
+
+    unsigned long _seed;
+    unsigned long _result;
+};
+
+// CPU bound task, standing for a parser or a feature generator.
+static void* task(void *arg)
+{
+  stage_arg *sa = static_cast<stage_arg*>(arg);
+  unsigned long h = sa->_seed;
+  for (int i=0; i<work; i++)
+    h = h * 2654435761ul + i;
+  sa->_result = h;
+  return NULL;
+}
+
+// thread per task, counting the threads that exist at the same time.
+static void* counted_task(void *arg)
+{
+  mutex_lock(&threads_mutex);
+  if (++running_threads > max_running_threads)
+    max_running_threads = running_threads;
+  mutex_unlock(&threads_mutex);
+  task(arg);
+  mutex_lock(&threads_mutex);
+  running_threads--;
+  mutex_unlock(&threads_mutex);
+  return NULL;
+}
+
+static void fan_out_threads(std::vector<stage_arg> &args)
+{
+  std::vector<pthread_t> threads(args.size());
+  for (size_t i=0; i<args.size(); i++)
+    {
+      if (pthread_create(&threads[i],NULL,&counted_task,&args[i]) != 0)
+        {
+          perror("pthread_create");
+          exit(1);
+        }
+    }
+  for (size_t i=0; i<args.size(); i++)
+    pthread_join(threads[i],NULL);
+}
+
+static void fan_out_pool(thread_pool *pool, std::vector<stage_arg> &args)
+{
+  task_group tg(pool);
+  for (size_t i=0; i<args.size(); i++)
+    tg.run(&task,&args[i]);
+  tg.wait();
+}
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+class client_arg
+{
+  public:
+    client_arg()
+      :_pool(NULL),_id(0)
+    {};
+
+    thread_pool *_pool; /**< NULL for a thread per task. */
+    int _id;
+    std::vector<double> _latencies;
+};
+
+static void* client(void *arg)
+{
+  client_arg *ca = static_cast<client_arg*>(arg);
+  std::vector<stage_arg> parsers(nengines);
+  std::vector<stage_arg> features(nsnippets);
+  for (int q=0; q<nqueries; q++)
+    {
+      struct timeval tv_start;
+      gettimeofday(&tv_start,NULL);
+      for (int e=0; e<nengines; e++)
+        parsers[e]._seed = ca->_id * nqueries + q + e;
+      if (ca->_pool)
+        fan_out_pool(ca->_pool,parsers);
+      else fan_out_threads(parsers);
+
+      for (int s=0; s<nsnippets; s++)
+        features[s]._seed = parsers[s % nengines]._result + s;
+      if (ca->_pool)
+        fan_out_pool(ca->_pool,features);
+      else fan_out_threads(features);
+      ca->_latencies.push_back(elapsed_ms(tv_start));
+    }
+  return NULL;
+}
+
+static void run(const char *name, thread_pool *pool, const int &nclients)
+{
+  running_threads = max_running_threads = 0;
+  std::vector<client_arg> args(nclients);
+  std::vector<pthread_t> threads(nclients);
+  struct timeval tv_start;
+  gettimeofday(&tv_start,NULL);
+  for (int c=0; c<nclients; c++)
+    {
+      args[c]._pool = pool;
+      args[c]._id = c;
+      pthread_create(&threads[c],NULL,&client,&args[c]);
+    }
+  for (int c=0; c<nclients; c++)
+    pthread_join(threads[c],NULL);
+  double ms = elapsed_ms(tv_start);
+
+  std::vector<double> latencies;
+  for (int c=0; c<nclients; c++)
+    latencies.insert(latencies.end(),args[c]._latencies.begin(),args[c]._latencies.end());
+  std::sort(latencies.begin(),latencies.end());
+  size_t n = latencies.size();
+
+  size_t nthreads = pool ? pool->size() : (size_t)max_running_threads;
+  printf("%-18s %6zu threads %9.1f queries/s   latency p50 %8.2f ms  p99 %8.2f ms\n",
+         name,nthreads,n * 1000.0 / ms,latencies[n/2],latencies[std::min(n-1,n*99/100)]);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+    {
+      std::cout << "Usage: <number of clients> <queries per client> [engines per query] [snippets per query] [work per task]\n";
+      exit(0);
+    }
+
+  int nclients = atoi(argv[1]);
+  nqueries = atoi(argv[2]);
+  if (argc > 3)
+    nengines = atoi(argv[3]);
+  if (argc > 4)
+    nsnippets = atoi(argv[4]);
+  if (argc > 5)
+    work = atoi(argv[5]);
+
+  errlog::init_log_module();
+  errlog::set_debug_level(LOG_LEVEL_FATAL | LOG_LEVEL_ERROR);
+
+  std::cout << nclients << " clients, " << nqueries << " queries each, "
+            << nengines << " engines and " << nsnippets << " snippets per query, "
+            << thread_pool::nprocessors() << " processors\n";
+
+  run("thread per task",NULL,nclients);
+
+  size_t nprocs = thread_pool::nprocessors();
+  size_t sizes[] = { 1, nprocs, 2 * nprocs, 4 * nprocs };
+  for (size_t i=0; i<sizeof(sizes)/sizeof(size_t); i++)
+    {
+      if (i > 0 && sizes[i] == sizes[i-1])
+        continue;
+      thread_pool pool(sizes[i]);
+      char name[32];
+      snprintf(name,sizeof(name),"pool of %zu",sizes[i]);
+      run(name,&pool,nclients);
+    }
+
+  return 0;
+}
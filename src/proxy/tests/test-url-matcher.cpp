@@ -0,0 +1,175 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Benchmark of the compiled URL matcher against the linear scan of
+ * patterns done by plugin_element::match_url, on a synthetic block list.
+ * Patterns can also be read from a pattern file (e.g. blocker/blocked-patterns).
+ */
+
+#include "url_matcher.h"
+#include "urlmatch.h"
+#include "loaders.h"
+#include "errlog.h"
+
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+using namespace sp;
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_now;
+  gettimeofday(&tv_now,NULL);
+  return (tv_now.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_now.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+static void generate_patterns(const int &npatterns, std::vector<url_spec*> &patterns)
+{
+  for (int i=0; i<npatterns; i++)
+    {
+      std::ostringstream spec;
+      switch (i % 5)
+        {
+        case 0:
+          spec << ".adserver" << i << ".com";
+          break;
+        case 1:
+          spec << "ads" << i << ".example.org";
+          break;
+        case 2:
+          spec << "/banners" << i << "/";
+          break;
+        case 3:
+          spec << "/.*/pixel" << i << "[0-9]*\\.gif";
+          break;
+        case 4:
+          spec << "tracker" << i << ".net/count";
+          break;
+        }
+      url_spec *usp = NULL;
+      char *buf = strdup(spec.str().c_str());
+      if (url_spec::create_url_spec(usp,buf) == SP_ERR_OK)
+        patterns.push_back(usp);
+      free(buf);
+    }
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+    {
+      std::cout << "Usage: <number of patterns> <number of requests> [pattern file]\n";
+      exit(0);
+    }
+
+  int npatterns = atoi(argv[1]);
+  int nrequests = atoi(argv[2]);
+
+  errlog::init_log_module();
+  errlog::set_debug_level(LOG_LEVEL_FATAL | LOG_LEVEL_ERROR);
+
+  std::vector<url_spec*> patterns;
+  if (argc > 3)
+    {
+      std::vector<url_spec*> neg_patterns;
+      loaders::load_pattern_file(argv[3],patterns,neg_patterns);
+      patterns.insert(patterns.end(),neg_patterns.begin(),neg_patterns.end());
+    }
+  else generate_patterns(npatterns,patterns);
+
+  struct timeval tv_start;
+  gettimeofday(&tv_start,NULL);
+  url_matcher um;
+  um.add_patterns(patterns,0);
+  um.compile();
+  std::cout << "compiled " << um.size() << " patterns in " << elapsed_ms(tv_start) << " ms\n";
+
+  // requests, roughly one in four being blocked.
+  std::vector<http_request*> requests;
+  for (int i=0; i<nrequests; i++)
+    {
+      std::ostringstream url;
+      int j = rand() % (npatterns > 0 ? npatterns : 1);
+      switch (i % 8)
+        {
+        case 0:
+          url << "http://www.adserver" << j << ".com/some/path.html";
+          break;
+        case 1:
+          url << "http://cdn.example.net/img/pixel" << j << "12.gif";
+          break;
+        default:
+          url << "http://www.site" << i << ".org/articles/" << j << "/index.html?q=" << i;
+          break;
+        }
+      http_request *http = new http_request();
+      if (urlmatch::parse_http_url(url.str().c_str(),http,REQUIRE_PROTOCOL) == SP_ERR_OK)
+        requests.push_back(http);
+      else delete http;
+    }
+
+  // linear scan.
+  std::vector<bool> linear(requests.size(),false);
+  gettimeofday(&tv_start,NULL);
+  for (size_t r=0; r<requests.size(); r++)
+    {
+      for (size_t p=0; p<patterns.size(); p++)
+        {
+          if (urlmatch::url_match(patterns[p],requests[r]))
+            {
+              linear[r] = true;
+              break;
+            }
+        }
+    }
+  double linear_ms = elapsed_ms(tv_start);
+
+  // compiled matcher.
+  std::vector<bool> compiled(requests.size(),false);
+  gettimeofday(&tv_start,NULL);
+  for (size_t r=0; r<requests.size(); r++)
+    compiled[r] = um.match_any(requests[r]);
+  double compiled_ms = elapsed_ms(tv_start);
+
+  int nmatches = 0, ndiffs = 0;
+  for (size_t r=0; r<requests.size(); r++)
+    {
+      if (linear[r])
+        nmatches++;
+      if (linear[r] != compiled[r])
+        {
+          ndiffs++;
+          std::cout << "mismatch on " << requests[r]->_host << requests[r]->_path << std::endl;
+        }
+    }
+
+  std::cout << requests.size() << " requests, " << nmatches << " matches, " << ndiffs << " mismatches\n";
+  std::cout << "linear scan: " << linear_ms << " ms (" << linear_ms * 1000.0 / requests.size() << " us/request)\n";
+  std::cout << "url matcher: " << compiled_ms << " ms (" << compiled_ms * 1000.0 / requests.size() << " us/request)\n";
+
+  for (size_t r=0; r<requests.size(); r++)
+    delete requests[r];
+  for (size_t p=0; p<patterns.size(); p++)
+    delete patterns[p];
+
+  return ndiffs == 0 ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Round-trip benchmark of user db snapshots: a db of records is exported
+ * to a snapshot file and loaded back into an empty db, with various numbers
+ * of workers and with or without compression, and the loaded records are
+ * checked against the original ones.
+ */
+
+#include "user_db.h"
+#include "user_db_snapshot.h"
+#include "thread_pool.h"
+#include "seeks_proxy.h"
+#include "miscutil.h"
+#include "errlog.h"
+
+#include <iostream>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+using namespace sp;
+
+static std::string dbfile = "seeks_test_snapshot_bench.db";
+static std::string dbfile2 = "seeks_test_snapshot_bench2.db";
+static std::string snapfile = "seeks_test_snapshot_bench.snap";
+
+static double elapsed_ms(const struct timeval &tv_start)
+{
+  struct timeval tv_end;
+  gettimeofday(&tv_end,NULL);
+  return (tv_end.tv_sec - tv_start.tv_sec) * 1000.0
+         + (tv_end.tv_usec - tv_start.tv_usec) / 1000.0;
+}
+
+// records carry query-like text, about as compressible as captured queries.
+static void fill_db(user_db *udb, const int &nrecords, const int &value_size)
+{
+  static const char *words[8] = { "seeks", "search", "engine", "peer", "privacy",
+                                  "http://www.", ".org/", "wiki"
+                                };
+  udb->set_version(user_db::_db_version);
+  unsigned int seed = 1;
+  for (int i=0; i<nrecords; i++)
+    {
+      db_record dbr(i,"query-capture");
+      std::string value;
+      dbr.serialize(value);
+      while ((int)value.size() < value_size)
+        value += words[rand_r(&seed) % 8];
+      std::string rkey = user_db::generate_rkey("key" + miscutil::to_string(i),"query-capture");
+      udb->_hdb->dbput(rkey.data(),rkey.size(),value.data(),value.size());
+    }
+}
+
+static bool check_db(user_db *udb, user_db *udb2, const int &nrecords)
+{
+  if (udb2->number_records() != udb->number_records()
+      || udb2->get_version() != udb->get_version())
+    return false;
+  for (int i=0; i<nrecords; i+=97)
+    {
+      std::string rkey = user_db::generate_rkey("key" + miscutil::to_string(i),"query-capture");
+      int s1,s2;
+      char *v1 = (char*)udb->_hdb->dbget(rkey.data(),rkey.size(),&s1);
+      char *v2 = (char*)udb2->_hdb->dbget(rkey.data(),rkey.size(),&s2);
+      bool same = v1 && v2 && std::string(v1,s1) == std::string(v2,s2);
+      free(v1);
+      free(v2);
+      if (!same)
+        return false;
+    }
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  int nrecords = argc > 1 ? atoi(argv[1]) : 200000;
+  int value_size = argc > 2 ? atoi(argv[2]) : 1000;
+
+  seeks_proxy::initialize_mutexes();
+  errlog::init_log_module();
+  errlog::set_debug_level(LOG_LEVEL_FATAL | LOG_LEVEL_ERROR);
+
+  unlink(dbfile.c_str());
+  user_db *udb = new user_db(dbfile);
+  udb->open_db();
+  fill_db(udb,nrecords,value_size);
+  std::cout << nrecords << " records of " << value_size << " bytes\n";
+
+  size_t nprocs = thread_pool::nprocessors();
+  size_t workers[4] = { 1, 2, 4, nprocs };
+  for (int level=0; level<2; level++)
+    for (int w=0; w<4; w++)
+      {
+        if (w == 3 && nprocs <= 4)
+          break;
+
+        // export.
+        user_db_snapshot uds(udb);
+        uds.set_limits(1 << 20,workers[w],level);
+        std::ofstream output(snapfile.c_str(),std::ios::out | std::ios::binary);
+        struct timeval tv;
+        gettimeofday(&tv,NULL);
+        db_err err = uds.export_db(output);
+        output.close();
+        double export_ms = elapsed_ms(tv);
+        udb_snapshot_stats stats = uds.get_stats();
+
+        // import into an empty db.
+        unlink(dbfile2.c_str());
+        user_db *udb2 = new user_db(dbfile2);
+        udb2->open_db();
+        user_db_snapshot uds2(udb2);
+        uds2.set_limits(1 << 20,workers[w],level);
+        std::ifstream input(snapfile.c_str(),std::ios::in | std::ios::binary);
+        gettimeofday(&tv,NULL);
+        db_err err2 = uds2.import_db(input);
+        input.close();
+        double import_ms = elapsed_ms(tv);
+        bool valid = err == SP_ERR_OK && err2 == SP_ERR_OK && check_db(udb,udb2,nrecords);
+        udb2->close_db();
+        delete udb2;
+
+        double mb = stats._raw_bytes / (1024.0 * 1024.0);
+        printf("level %d, %2u workers: snapshot %6.1f MB (%5.1f%%), export %7.0f ms (%6.1f MB/s), import %7.0f ms (%6.1f MB/s)%s\n",
+               level,(unsigned int)workers[w],stats._stored_bytes / (1024.0 * 1024.0),
+               100.0 * stats._stored_bytes / stats._raw_bytes,
+               export_ms,mb / (export_ms / 1000.0),import_ms,mb / (import_ms / 1000.0),
+               valid ? "" : " FAILED");
+      }
+
+  udb->close_db();
+  delete udb;
+  unlink(dbfile.c_str());
+  unlink(dbfile2.c_str());
+  unlink(snapfile.c_str());
+}
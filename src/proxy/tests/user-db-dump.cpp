@@ -0,0 +1,59 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "user_db.h"
+#include "user_db_snapshot.h"
+#include "seeks_proxy.h"
+#include "errlog.h"
+
+#include <iostream>
+#include <fstream>
+#include <stdlib.h>
+
+using namespace sp;
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+    {
+      std::cout << "Usage: <db_file> <snapshot_file> [plugin name] [workers]\n";
+      exit(0);
+    }
+
+  std::string dbfile = argv[1];
+  std::string destfile = argv[2];
+  std::string plugin_name = argc > 3 ? argv[3] : "";
+  int nworkers = argc > 4 ? atoi(argv[4]) : 0;
+
+  seeks_proxy::initialize_mutexes();
+  errlog::init_log_module();
+  errlog::set_debug_level(LOG_LEVEL_FATAL | LOG_LEVEL_ERROR | LOG_LEVEL_INFO);
+
+  user_db udb(dbfile);
+  if (udb.open_db_readonly() != SP_ERR_OK)
+    exit(1);
+
+  std::ofstream output(destfile.c_str(),std::ios::out | std::ios::binary);
+  user_db_snapshot uds(&udb);
+  if (nworkers > 0)
+    uds.set_limits(1 << 20,nworkers,1);
+  db_err err = uds.export_db(output,plugin_name);
+  output.close();
+  udb.close_db();
+  return err == SP_ERR_OK ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "user_db.h"
+#include "user_db_snapshot.h"
+#include "seeks_proxy.h"
+#include "errlog.h"
+
+#include <iostream>
+#include <fstream>
+#include <stdlib.h>
+
+using namespace sp;
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+    {
+      std::cout << "Usage: <db_file> <snapshot_file> [workers]\n";
+      std::cout << "Records of the snapshot replace those of the db that have the same keys.\n";
+      exit(0);
+    }
+
+  std::string dbfile = argv[1];
+  std::string srcfile = argv[2];
+  int nworkers = argc > 3 ? atoi(argv[3]) : 0;
+
+  seeks_proxy::initialize_mutexes();
+  errlog::init_log_module();
+  errlog::set_debug_level(LOG_LEVEL_FATAL | LOG_LEVEL_ERROR | LOG_LEVEL_INFO);
+
+  std::ifstream input(srcfile.c_str(),std::ios::in | std::ios::binary);
+  if (!input)
+    {
+      std::cout << "Could not open snapshot file " << srcfile << std::endl;
+      exit(1);
+    }
+
+  user_db udb(dbfile);
+  if (udb.open_db() != SP_ERR_OK)
+    exit(1);
+
+  user_db_snapshot uds(&udb);
+  if (nworkers > 0)
+    uds.set_limits(1 << 20,nworkers,1);
+  db_err err = uds.import_db(input);
+  input.close();
+  udb.close_db();
+  return err == SP_ERR_OK ? 0 : 1;
+}
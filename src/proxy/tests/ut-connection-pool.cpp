@@ -0,0 +1,249 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "connection_pool.h"
+#include "mem_utils.h"
+
+#include <string.h>
+#include <map>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+using namespace sp;
+
+class ConnectionPoolTest : public testing::Test
+{
+  protected:
+    ConnectionPoolTest()
+    {
+    }
+
+    virtual ~ConnectionPoolTest()
+    {
+    }
+
+    virtual void SetUp()
+    {
+      _http._host = strdup("www.seeks-project.info");
+      _http._port = 80;
+    }
+
+    virtual void TearDown()
+    {
+      std::map<int,int>::const_iterator mit;
+      for (mit=_peers.begin(); mit!=_peers.end(); ++mit)
+        close((*mit).second);
+    }
+
+    // a connected socket, whose other end is kept open.
+    sp_socket open_connection(reusable_connection &rc, const unsigned int &timeout=180)
+    {
+      int sv[2];
+      EXPECT_EQ(0,socketpair(AF_UNIX,SOCK_STREAM,0,sv));
+      _peers.insert(std::pair<int,int>(sv[0],sv[1]));
+      rc._sfd = sv[0];
+      rc._in_use = 0;
+      rc._timestamp = time(NULL);
+      rc._request_sent = rc._response_received = rc._timestamp;
+      rc._keep_alive_timeout = timeout;
+      return sv[0];
+    }
+
+    // the server closes the connection.
+    void close_peer(const sp_socket &sfd)
+    {
+      std::map<int,int>::iterator mit = _peers.find(sfd);
+      close((*mit).second);
+      _peers.erase(mit);
+    }
+
+    http_request _http;
+    forward_spec _fwd;
+    std::map<int,int> _peers; /**< other end of each connection. */
+};
+
+TEST_F(ConnectionPoolTest, remember_get)
+{
+  connection_pool pool;
+  reusable_connection rc;
+  sp_socket sfd = open_connection(rc);
+  EXPECT_TRUE(pool.remember(&rc,&_http,&_fwd));
+
+  http_request other;
+  other._host = strdup("WWW.Seeks-Project.info");
+  other._port = 8080;
+  EXPECT_EQ(SP_INVALID_SOCKET,pool.get(&other,&_fwd));
+  other._port = 80;
+  EXPECT_EQ(sfd,pool.get(&other,&_fwd));
+  EXPECT_EQ(SP_INVALID_SOCKET,pool.get(&_http,&_fwd));
+
+  connection_pool_stats stats;
+  pool.get_stats(stats);
+  EXPECT_EQ(3u,stats._lookups);
+  EXPECT_EQ(1u,stats._hits);
+  EXPECT_EQ(1u,stats._remembered);
+  EXPECT_EQ(0u,stats._idle);
+  EXPECT_EQ(1u,stats._in_use);
+}
+
+TEST_F(ConnectionPoolTest, reuse)
+{
+  connection_pool pool;
+  reusable_connection rc;
+  sp_socket sfd = open_connection(rc);
+  EXPECT_TRUE(pool.remember(&rc,&_http,&_fwd));
+
+  for (int i=0; i<3; i++)
+    {
+      EXPECT_EQ(sfd,pool.get(&_http,&_fwd));
+      EXPECT_TRUE(pool.remember(&rc,&_http,&_fwd));
+    }
+
+  connection_pool_stats stats;
+  pool.get_stats(stats);
+  EXPECT_EQ(1u,stats._remembered);
+  EXPECT_EQ(1u,stats._idle);
+  EXPECT_EQ(0u,stats._in_use);
+  EXPECT_DOUBLE_EQ(1.0,stats.reuse_rate());
+}
+
+TEST_F(ConnectionPoolTest, forwarder_mismatch)
+{
+  connection_pool pool;
+  reusable_connection rc;
+  open_connection(rc);
+  EXPECT_TRUE(pool.remember(&rc,&_http,&_fwd));
+
+  forward_spec fwd;
+  fwd._forward_host = strdup("proxy.example.org");
+  fwd._forward_port = 3128;
+  EXPECT_EQ(SP_INVALID_SOCKET,pool.get(&_http,&fwd));
+}
+
+TEST_F(ConnectionPoolTest, forget)
+{
+  connection_pool pool;
+  reusable_connection rc;
+  sp_socket sfd = open_connection(rc);
+  EXPECT_TRUE(pool.remember(&rc,&_http,&_fwd));
+  EXPECT_EQ(sfd,pool.get(&_http,&_fwd));
+  EXPECT_TRUE(pool.forget(sfd));
+  EXPECT_FALSE(pool.forget(sfd));
+  EXPECT_EQ(SP_INVALID_SOCKET,pool.get(&_http,&_fwd));
+
+  connection_pool_stats stats;
+  pool.get_stats(stats);
+  EXPECT_EQ(0u,stats._idle);
+  EXPECT_EQ(0u,stats._in_use);
+  close(sfd);
+}
+
+TEST_F(ConnectionPoolTest, capacity)
+{
+  connection_pool pool(2);
+  reusable_connection rc1, rc2, rc3;
+  open_connection(rc1);
+  open_connection(rc2);
+  sp_socket sfd3 = open_connection(rc3);
+  EXPECT_TRUE(pool.remember(&rc1,&_http,&_fwd));
+  EXPECT_TRUE(pool.remember(&rc2,&_http,&_fwd));
+  EXPECT_FALSE(pool.remember(&rc3,&_http,&_fwd));
+  close(sfd3);
+
+  connection_pool_stats stats;
+  pool.get_stats(stats);
+  EXPECT_EQ(2u,stats._remembered);
+  EXPECT_EQ(1u,stats._rejected);
+  EXPECT_EQ(2u,stats._idle);
+
+  // a lowered capacity closes connections as they come back.
+  sp_socket sfd = pool.get(&_http,&_fwd);
+  pool.set_capacity(1);
+  EXPECT_TRUE(pool.remember(sfd == rc1._sfd ? &rc1 : &rc2,&_http,&_fwd));
+  pool.get_stats(stats);
+  EXPECT_EQ(1u,stats._idle);
+  EXPECT_EQ(0u,stats._in_use);
+}
+
+TEST_F(ConnectionPoolTest, get_skips_dead)
+{
+  connection_pool pool;
+  reusable_connection rc1, rc2;
+  sp_socket sfd1 = open_connection(rc1);
+  sp_socket sfd2 = open_connection(rc2);
+  EXPECT_TRUE(pool.remember(&rc1,&_http,&_fwd));
+  EXPECT_TRUE(pool.remember(&rc2,&_http,&_fwd));
+
+  close_peer(sfd2);
+  EXPECT_EQ(sfd1,pool.get(&_http,&_fwd));
+
+  connection_pool_stats stats;
+  pool.get_stats(stats);
+  EXPECT_EQ(1u,stats._reaped);
+}
+
+TEST_F(ConnectionPoolTest, reap)
+{
+  connection_pool pool;
+  reusable_connection rc1, rc2, rc3;
+  open_connection(rc1);
+  sp_socket sfd2 = open_connection(rc2);
+  open_connection(rc3,0);
+  rc3._timestamp -= 10;
+  EXPECT_TRUE(pool.remember(&rc1,&_http,&_fwd));
+  EXPECT_TRUE(pool.remember(&rc2,&_http,&_fwd));
+  EXPECT_TRUE(pool.remember(&rc3,&_http,&_fwd));
+
+  close_peer(sfd2);
+  EXPECT_EQ(1,pool.reap());
+
+  connection_pool_stats stats;
+  pool.get_stats(stats);
+  EXPECT_EQ(2u,stats._reaped);
+  EXPECT_EQ(1u,stats._idle);
+}
+
+TEST_F(ConnectionPoolTest, reaper)
+{
+  connection_pool pool;
+  reusable_connection rc;
+  sp_socket sfd = open_connection(rc);
+  EXPECT_TRUE(pool.remember(&rc,&_http,&_fwd));
+  EXPECT_EQ(SP_ERR_OK,pool.start_reaper(1));
+
+  close_peer(sfd);
+  connection_pool_stats stats;
+  for (int i=0; i<30 && stats._reaped == 0; i++)
+    {
+      usleep(100000);
+      pool.get_stats(stats);
+    }
+  pool.stop_reaper();
+  EXPECT_EQ(1u,stats._reaped);
+  EXPECT_EQ(0u,stats._idle);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,253 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "header_table.h"
+#include "miscutil.h"
+#include "mem_utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace sp;
+
+// trace of the parser calls.
+static std::vector<std::string> calls;
+
+static sp_err trace(const char *parser, char **header)
+{
+  calls.push_back(std::string(parser) + " " + *header);
+  return SP_ERR_OK;
+}
+
+static sp_err upper_host(client_state *csp, char **header)
+{
+  trace("upper_host",header);
+  char *h = strdup(*header);
+  for (char *c=h+5; *c; c++)
+    *c = toupper(*c);
+  freez(*header);
+  *header = h;
+  return SP_ERR_OK;
+}
+
+static sp_err drop(client_state *csp, char **header)
+{
+  trace("drop",header);
+  freez(*header);
+  *header = NULL;
+  return SP_ERR_OK;
+}
+
+static sp_err rename_ua(client_state *csp, char **header)
+{
+  trace("rename_ua",header);
+  std::string h = std::string("X-UA:") + (strchr(*header,':') + 1);
+  freez(*header);
+  *header = strdup(h.c_str());
+  return SP_ERR_OK;
+}
+
+static sp_err tag_x_ua(client_state *csp, char **header)
+{
+  return trace("tag_x_ua",header);
+}
+
+static sp_err add_header(client_state *csp, char **header)
+{
+  trace("add_header",header);
+  return miscutil::enlist(&csp->_headers,"X-Added: 1");
+}
+
+static sp_err tag_added(client_state *csp, char **header)
+{
+  return trace("tag_added",header);
+}
+
+static sp_err fail(client_state *csp, char **header)
+{
+  trace("fail",header);
+  return SP_ERR_MEMORY;
+}
+
+static sp_err every(client_state *csp, char **header)
+{
+  trace("every",header);
+  // modifies in place.
+  if ((*header)[0] == 'a')
+    (*header)[0] = 'A';
+  return SP_ERR_OK;
+}
+
+static parsers_list patterns[] =
+{
+  parsers_list("Host:",5,&upper_host),
+  parsers_list("cookie:",7,&drop),
+  parsers_list("ua-",3,&rename_ua),
+  parsers_list("x-ua:",5,&tag_x_ua),
+  parsers_list("X-Add:",6,&add_header),
+  parsers_list("x-added:",8,&tag_added),
+  parsers_list("host:",5,&tag_x_ua),
+  parsers_list("X-Fail:",7,&fail),
+  parsers_list("*",0,&every),
+  parsers_list(NULL,0,NULL)
+};
+
+class HeaderTableTest : public testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+      calls.clear();
+    }
+
+    virtual void TearDown()
+    {
+      std::list<const char*>::iterator lit;
+      for (lit=_csp1._headers.begin(); lit!=_csp1._headers.end(); ++lit)
+        free_const(*lit);
+      for (lit=_csp2._headers.begin(); lit!=_csp2._headers.end(); ++lit)
+        free_const(*lit);
+      _csp1._headers.clear();
+      _csp2._headers.clear();
+    }
+
+    // reference: every header against every parser in turn.
+    static sp_err linear_sed(client_state *csp, const parsers_list *v)
+    {
+      sp_err err = SP_ERR_OK;
+      while ((err == SP_ERR_OK) && (v->_str != NULL))
+        {
+          std::list<const char*>::iterator lit = csp->_headers.begin();
+          while (lit!=csp->_headers.end() && err == SP_ERR_OK)
+            {
+              const char *str = (*lit);
+              if (str == NULL)
+                {
+                  ++lit;
+                  continue;
+                }
+              if ((miscutil::strncmpic(str, v->_str, v->_len) == 0) ||
+                  (v->_len == CHECK_EVERY_HEADER_REMAINING))
+                {
+                  char *cstr = strdup(str);
+                  err = v->_parser(csp, &cstr);
+                  free_const((*lit));
+                  if (cstr)
+                    (*lit) = cstr;
+                  else
+                    {
+                      std::list<const char*>::iterator clit = lit;
+                      ++lit;
+                      csp->_headers.erase(clit);
+                      continue;
+                    }
+                }
+              ++lit;
+            }
+          v++;
+        }
+      return err;
+    }
+
+    void check_same(const char **headers)
+    {
+      for (int i=0; headers[i]; i++)
+        {
+          miscutil::enlist(&_csp1._headers,headers[i]);
+          miscutil::enlist(&_csp2._headers,headers[i]);
+        }
+
+      sp_err err1 = linear_sed(&_csp1,patterns);
+      std::vector<std::string> calls1 = calls;
+      calls.clear();
+
+      header_patterns hp(patterns);
+      header_table table(&_csp2._headers,&hp);
+      sp_err err2 = table.apply(&_csp2);
+
+      ASSERT_EQ(err1,err2);
+      ASSERT_EQ(calls1,calls);
+      char *h1 = miscutil::list_to_text(&_csp1._headers);
+      char *h2 = miscutil::list_to_text(&_csp2._headers);
+      ASSERT_STREQ(h1,h2);
+      free(h1);
+      free(h2);
+    }
+
+    client_state _csp1;
+    client_state _csp2;
+};
+
+TEST_F(HeaderTableTest,intern)
+{
+  header_patterns hp(patterns);
+  ASSERT_EQ(9u,hp.size());
+  ASSERT_EQ(hp.intern("host: a"),hp.intern("HOST: b"));
+  ASSERT_LE(0,hp.intern("Cookie: x=y"));
+  ASSERT_EQ(-1,hp.intern("Accept: */*"));
+  ASSERT_EQ(-1,hp.intern("UA-CPU: x86"));
+  ASSERT_EQ((uint64_t)(1 | 1 << 6 | 1 << 8),hp.match("Host: www.example.com"));
+  ASSERT_EQ((uint64_t)(1 << 2 | 1 << 8),hp.match("UA-CPU: x86"));
+  ASSERT_EQ((uint64_t)(1 << 8),hp.match("Hostname: x"));
+}
+
+TEST_F(HeaderTableTest,same_as_linear)
+{
+  const char *headers[] =
+  {
+    "GET / HTTP/1.1",
+    "Host: www.example.com",
+    "accept: */*",
+    "Cookie: a=b",
+    "UA-CPU: x86",
+    "cookie: c=d",
+    "X-Add: yes",
+    "Host: again",
+    NULL
+  };
+  check_same(headers);
+}
+
+TEST_F(HeaderTableTest,error)
+{
+  const char *headers[] =
+  {
+    "Host: www.example.com",
+    "X-Fail: now",
+    "Cookie: a=b",
+    NULL
+  };
+  check_same(headers);
+}
+
+TEST_F(HeaderTableTest,empty)
+{
+  const char *headers[] = { NULL };
+  check_same(headers);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,198 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "pcrs.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+using namespace sp;
+
+class PcrsTest : public testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+      _joblist = NULL;
+    }
+
+    virtual void TearDown()
+    {
+      pcrs_job::pcrs_free_joblist(_joblist);
+      _joblist = NULL;
+    }
+
+    void add_job(const char *command)
+    {
+      int err = 0;
+      pcrs_job *job = pcrs::pcrs_compile_command(command,&err);
+      ASSERT_TRUE(job != NULL) << command;
+      if (!_joblist)
+        _joblist = job;
+      else
+        {
+          pcrs_job *last = _joblist;
+          while (last->_next)
+            last = last->_next;
+          last->_next = job;
+        }
+    }
+
+    // reference: jobs applied one after the other with pcrs_execute.
+    std::string execute_sequential(const std::string &subject, int &hits)
+    {
+      std::string str = subject;
+      hits = 0;
+      for (pcrs_job *job=_joblist; job!=NULL; job=job->_next)
+        {
+          char *result = NULL;
+          size_t length = 0;
+          int h = pcrs::pcrs_execute(job,str.c_str(),str.size(),&result,&length);
+          EXPECT_LE(0,h);
+          hits += h;
+          str = std::string(result,length);
+          free(result);
+        }
+      return str;
+    }
+
+    std::string execute_list(const std::string &subject, int &hits)
+    {
+      char *result = NULL;
+      size_t length = 0;
+      char *str = strdup(subject.c_str());
+      hits = pcrs::pcrs_execute_list(_joblist,str,subject.size(),&result,&length);
+      free(str);
+      EXPECT_TRUE(result != NULL);
+      EXPECT_EQ(length,strlen(result));
+      std::string res(result,length);
+      free(result);
+      return res;
+    }
+
+    void check_equivalent(const std::string &subject)
+    {
+      int seq_hits = 0, list_hits = 0;
+      std::string seq = execute_sequential(subject,seq_hits);
+      ASSERT_EQ(seq,execute_list(subject,list_hits));
+      ASSERT_EQ(seq_hits,list_hits);
+    }
+
+    static std::string literal(const char *pattern, int options, int &plain)
+    {
+      char *lit = NULL;
+      size_t length = 0;
+      plain = pcrs::pcrs_required_literal(pattern,options,&lit,&length);
+      std::string res = lit ? std::string(lit,length) : "";
+      free(lit);
+      return res;
+    }
+
+    pcrs_job *_joblist;
+};
+
+TEST_F(PcrsTest,required_literal)
+{
+  int plain = 0;
+  ASSERT_EQ("foo",literal("foo",0,plain));
+  ASSERT_TRUE(plain);
+  ASSERT_EQ("a.b",literal("a\\.b",0,plain));
+  ASSERT_TRUE(plain);
+  ASSERT_EQ("</script>",literal("<SCRIPT.*?</script>",PCRE_CASELESS,plain));
+  ASSERT_FALSE(plain);
+  ASSERT_EQ("onload=\"",literal("(<body[^>]*?)onload=\"[^\"]+\"",0,plain));
+  ASSERT_FALSE(plain);
+  ASSERT_EQ("abc",literal("abcd?e",0,plain)); // d is optional.
+  ASSERT_EQ("abcd",literal("abcd+e",0,plain));
+  ASSERT_EQ("",literal("abc|def",0,plain));
+  ASSERT_EQ("",literal("(?i)abc",0,plain));
+  ASSERT_EQ("",literal("foo",PCRE_EXTENDED,plain));
+  ASSERT_EQ("",literal("a\\d+b",0,plain)); // too short.
+  ASSERT_EQ("width=",literal("[]x]width=\\d+",0,plain));
+  ASSERT_EQ("",literal("\\x41\\x42",0,plain));
+}
+
+TEST_F(PcrsTest,execute)
+{
+  add_job("s/(\\w+)@(\\w+)/$2 at $1/g");
+  int hits = 0;
+  ASSERT_EQ("b at a, d at c",execute_sequential("a@b, c@d",hits));
+  ASSERT_EQ(2,hits);
+  ASSERT_EQ("no match",execute_sequential("no match",hits));
+  ASSERT_EQ(0,hits);
+  ASSERT_EQ("",execute_sequential("",hits));
+}
+
+TEST_F(PcrsTest,literal_prefilter)
+{
+  add_job("s/<blink>(.*?)<\\/blink>/$1/gi");
+  ASSERT_STREQ("</blink>",_joblist->_literal);
+  check_equivalent("some <BLINK>text</Blink> and <blink>more</blink>");
+  check_equivalent("nothing to see here");
+}
+
+TEST_F(PcrsTest,literal_batch)
+{
+  add_job("s/foo/bar/g");
+  add_job("s/hello/bye/");
+  add_job("s/WORLD/earth/gi");
+  ASSERT_TRUE(_joblist->_flags & PCRS_LITERAL);
+  check_equivalent("hello world, foo foofoo hello World");
+  check_equivalent("nothing");
+}
+
+TEST_F(PcrsTest,literal_batch_dependencies)
+{
+  // the second job matches the output of the first one.
+  add_job("s/foo/bar/g");
+  add_job("s/bar!/baz/g");
+  add_job("s/ab//g");
+  add_job("s/cd/X/g");
+  check_equivalent("foo! bar! abab acdb a cd");
+  check_equivalent("abcd");
+}
+
+TEST_F(PcrsTest,literal_batch_overlap)
+{
+  // matches overlapping in the subject.
+  add_job("s/abc/1/g");
+  add_job("s/cde/2/g");
+  check_equivalent("abcde cde abc");
+}
+
+TEST_F(PcrsTest,mixed_joblist)
+{
+  add_job("s/<script.*?<\\/script>//sig");
+  add_job("s/ad/AD/g");
+  add_job("s/banner/img/g");
+  add_job("s/(<img[^>]*?) width=\"\\d+\"/$1/g");
+  add_job("s/\\s+$//");
+  add_job("s/^/<!-- filtered -->/");
+  check_equivalent("<html><script>x</script><div class=\"ad\"><img src=\"banner.gif\" width=\"468\"></div>\n   ");
+  check_equivalent("");
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,235 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "stream_filter.h"
+#include "filter_plugin.h"
+#include "miscutil.h"
+
+#include <zlib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+
+using namespace sp;
+
+// replaces every 'foo' with 'bar!'.
+class foo_filter : public filter_plugin
+{
+  public:
+    foo_filter()
+      :filter_plugin(std::vector<url_spec*>(),std::vector<url_spec*>(),NULL)
+    {};
+
+    char* run(client_state *csp, char *str, size_t size)
+    {
+      std::string res;
+      const char *p = str, *q;
+      while ((q = strstr(p,"foo")))
+        {
+          res.append(p,q-p);
+          res.append("bar!");
+          p = q + 3;
+        }
+      if (p == str)
+        return NULL;
+      res.append(p);
+      return strdup(res.c_str());
+    };
+};
+
+class StreamFilterTest : public testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+      _csp._http._ver = strdup("HTTP/1.1");
+      _csp._http._cmd = strdup("GET http://www.example.com/ HTTP/1.1");
+      _csp._http._status = 200;
+      _csp._content_type = CT_TEXT;
+      _csp._filter_plugins.push_back(&_ff);
+    }
+
+    virtual void TearDown()
+    {
+      _csp._filter_plugins.clear();
+    }
+
+    // reference output of whole-body filtering.
+    static std::string replace_foo(const std::string &body)
+    {
+      std::string res;
+      size_t p = 0, q;
+      while ((q = body.find("foo",p)) != std::string::npos)
+        {
+          res.append(body,p,q-p);
+          res.append("bar!");
+          p = q + 3;
+        }
+      res.append(body,p,std::string::npos);
+      return res;
+    }
+
+    static std::string make_body(const int &nlines)
+    {
+      std::ostringstream body;
+      for (int i=0; i<nlines; i++)
+        body << "<p class=\"line" << i << "\">some foo text, " << i << " foo</p>\n";
+      return body.str();
+    }
+
+    static std::string chunk(const std::string &data, const size_t &csize)
+    {
+      std::ostringstream out;
+      for (size_t p=0; p<data.size(); p+=csize)
+        {
+          size_t n = std::min(csize,data.size()-p);
+          out << std::hex << n << ";ext=1\r\n" << data.substr(p,n) << "\r\n";
+        }
+      out << "0\r\nX-Trailer: yes\r\n\r\n";
+      return out.str();
+    }
+
+    static std::string compress(const std::string &data, const int &wbits)
+    {
+      z_stream zstr;
+      memset(&zstr,0,sizeof(zstr));
+      deflateInit2(&zstr,Z_DEFAULT_COMPRESSION,Z_DEFLATED,wbits,8,Z_DEFAULT_STRATEGY);
+      std::string out(deflateBound(&zstr,data.size()) + 32,'\0');
+      zstr.next_in = (Bytef*)data.c_str();
+      zstr.avail_in = data.size();
+      zstr.next_out = (Bytef*)&out[0];
+      zstr.avail_out = out.size();
+      deflate(&zstr,Z_FINISH);
+      out.resize(zstr.total_out);
+      deflateEnd(&zstr);
+      return out;
+    }
+
+    // removes the chunked transfer coding from the filter output.
+    static std::string unchunk(const std::string &out)
+    {
+      std::string res;
+      size_t p = 0;
+      while (p < out.size())
+        {
+          size_t n = strtoul(out.c_str()+p,NULL,16);
+          p = out.find("\r\n",p) + 2;
+          if (n == 0)
+            break;
+          res.append(out,p,n);
+          p += n + 2;
+        }
+      return res;
+    }
+
+    // feeds the filter by pieces of psize bytes.
+    std::string run(stream_filter &sf, const std::string &in, const size_t &psize)
+    {
+      std::string out;
+      for (size_t p=0; p<in.size(); p+=psize)
+        EXPECT_EQ(SP_ERR_OK,sf.feed(in.c_str()+p,std::min(psize,in.size()-p),out));
+      EXPECT_EQ(SP_ERR_OK,sf.finish(out));
+      EXPECT_EQ("0\r\n\r\n",out.substr(out.size()-5));
+      return unchunk(out);
+    }
+
+    client_state _csp;
+    foo_filter _ff;
+};
+
+TEST_F(StreamFilterTest,plain)
+{
+  std::string body = make_body(1000);
+  stream_filter sf(&_csp,1024,128);
+  ASSERT_EQ(replace_foo(body),run(sf,body,BUFFER_SIZE));
+  ASSERT_EQ(body.size(),sf.in_bytes());
+  ASSERT_LE(sf.peak_memory(),(size_t)4*(1024+BUFFER_SIZE));
+}
+
+TEST_F(StreamFilterTest,chunked)
+{
+  std::string body = make_body(200);
+  _csp._flags |= CSP_FLAG_CHUNKED;
+  stream_filter sf1(&_csp);
+  ASSERT_EQ(replace_foo(body),run(sf1,chunk(body,777),1));
+  stream_filter sf2(&_csp,256,64);
+  ASSERT_EQ(replace_foo(body),run(sf2,chunk(body,100),333));
+}
+
+TEST_F(StreamFilterTest,gzip)
+{
+  std::string body = make_body(5000);
+  _csp._content_type |= CT_GZIP;
+  _csp._flags |= CSP_FLAG_CHUNKED;
+  stream_filter sf(&_csp,4096,512);
+  ASSERT_EQ(replace_foo(body),run(sf,chunk(compress(body,16+MAX_WBITS),1000),BUFFER_SIZE));
+  ASSERT_LT(sf.peak_memory(),body.size() / 4);
+}
+
+TEST_F(StreamFilterTest,deflate)
+{
+  std::string body = make_body(500);
+  _csp._content_type |= CT_DEFLATE;
+  stream_filter sf1(&_csp);
+  ASSERT_EQ(replace_foo(body),run(sf1,compress(body,MAX_WBITS),1)); // zlib header.
+  stream_filter sf2(&_csp);
+  ASSERT_EQ(replace_foo(body),run(sf2,compress(body,-MAX_WBITS),100)); // raw.
+}
+
+TEST_F(StreamFilterTest,errors)
+{
+  std::string out;
+  _csp._flags |= CSP_FLAG_CHUNKED;
+  stream_filter sf1(&_csp);
+  ASSERT_EQ(SP_ERR_PARSE,sf1.feed("zz\r\n",4,out));
+  _csp._content_type |= CT_GZIP;
+  _csp._flags &= ~CSP_FLAG_CHUNKED;
+  stream_filter sf2(&_csp);
+  ASSERT_EQ(SP_ERR_COMPRESS,sf2.feed("not gzipped at all",18,out));
+}
+
+TEST_F(StreamFilterTest,headers)
+{
+  _csp._content_type |= CT_GZIP;
+  miscutil::enlist(&_csp._headers,"HTTP/1.1 200 OK");
+  miscutil::enlist(&_csp._headers,"Content-Type: text/html");
+  miscutil::enlist(&_csp._headers,"Content-Length: 1234");
+  miscutil::enlist(&_csp._headers,"Content-Encoding: gzip");
+  ASSERT_TRUE(stream_filter::can_stream(&_csp));
+  stream_filter sf(&_csp);
+  ASSERT_EQ(SP_ERR_OK,sf.update_server_headers());
+  char *hdr = miscutil::list_to_text(&_csp._headers);
+  ASSERT_STREQ("HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nTransfer-Encoding: chunked\r\n\r\n",hdr);
+  free(hdr);
+
+  _csp._http._status = 304;
+  ASSERT_FALSE(stream_filter::can_stream(&_csp));
+  _csp._http._status = 200;
+  free(_csp._http._ver);
+  _csp._http._ver = strdup("HTTP/1.0");
+  ASSERT_FALSE(stream_filter::can_stream(&_csp));
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
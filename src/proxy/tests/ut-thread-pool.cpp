@@ -0,0 +1,182 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "thread_pool.h"
+
+#include <set>
+#include <unistd.h>
+
+using namespace sp;
+
+class count_arg
+{
+  public:
+    count_arg()
+      :_count(0),_delay(0),_pool(NULL),_nsub(0)
+    {
+      mutex_init(&_mutex);
+    };
+
+    ~count_arg()
+    {
+      mutex_destroy(&_mutex);
+    };
+
+    sp_mutex_t _mutex;
+    int _count;
+    useconds_t _delay;
+    std::set<pthread_t> _threads;
+    thread_pool *_pool;
+    int _nsub;
+};
+
+static void* count(void *arg)
+{
+  count_arg *ca = static_cast<count_arg*>(arg);
+  if (ca->_delay)
+    usleep(ca->_delay);
+  mutex_lock(&ca->_mutex);
+  ca->_count++;
+  ca->_threads.insert(pthread_self());
+  mutex_unlock(&ca->_mutex);
+  return NULL;
+}
+
+// forks and joins subtasks from within a task.
+static void* nested(void *arg)
+{
+  count_arg *ca = static_cast<count_arg*>(arg);
+  task_group tg(ca->_pool);
+  for (int i=0; i<ca->_nsub; i++)
+    tg.run(&count,ca);
+  tg.wait();
+  return NULL;
+}
+
+TEST(ThreadPoolTest, fork_join)
+{
+  thread_pool pool(4);
+  EXPECT_EQ(4u,pool.size());
+
+  count_arg ca;
+  task_group tg(&pool);
+  for (int i=0; i<1000; i++)
+    tg.run(&count,&ca);
+  tg.wait();
+  EXPECT_EQ(1000,ca._count);
+
+  // a group can be reused once joined.
+  for (int i=0; i<10; i++)
+    tg.run(&count,&ca);
+  tg.wait();
+  EXPECT_EQ(1010,ca._count);
+}
+
+TEST(ThreadPoolTest, no_pool)
+{
+  count_arg ca;
+  task_group tg(NULL);
+  tg.run(&count,&ca);
+  EXPECT_EQ(1,ca._count); // run in place.
+  tg.wait();
+  ASSERT_EQ(1u,ca._threads.size());
+  EXPECT_TRUE(pthread_equal(pthread_self(),*ca._threads.begin()));
+}
+
+TEST(ThreadPoolTest, bounded_concurrency)
+{
+  // tasks run on the workers or on the thread that waits, no other.
+  thread_pool pool(2);
+  count_arg ca;
+  ca._delay = 2000;
+  task_group tg(&pool);
+  for (int i=0; i<50; i++)
+    tg.run(&count,&ca);
+  tg.wait();
+  EXPECT_EQ(50,ca._count);
+  EXPECT_LE(ca._threads.size(),3u);
+}
+
+TEST(ThreadPoolTest, nested)
+{
+  // more nested joins than workers do not deadlock.
+  thread_pool pool(2);
+  count_arg ca;
+  ca._pool = &pool;
+  ca._nsub = 20;
+  task_group tg(&pool);
+  for (int i=0; i<10; i++)
+    tg.run(&nested,&ca);
+  tg.wait();
+  EXPECT_EQ(200,ca._count);
+}
+
+TEST(ThreadPoolTest, steal)
+{
+  // subtasks forked by a worker are stolen by the idle ones.
+  thread_pool pool(4);
+  count_arg ca;
+  ca._pool = &pool;
+  ca._nsub = 64;
+  ca._delay = 1000;
+  task_group tg(&pool);
+  tg.run(&nested,&ca);
+  usleep(50000); // leaves the task to a worker.
+  tg.wait();
+  EXPECT_EQ(64,ca._count);
+  EXPECT_LT(1u,ca._threads.size());
+
+  thread_pool_stats stats;
+  pool.get_stats(stats);
+  EXPECT_EQ(4u,stats._workers);
+  EXPECT_EQ(0u,stats._queued);
+  EXPECT_LT(0u,stats._stolen);
+}
+
+TEST(ThreadPoolTest, join_on_destruction)
+{
+  thread_pool *pool = new thread_pool(1);
+  count_arg ca;
+  ca._pool = pool;
+  ca._nsub = 5;
+  {
+    task_group tg(pool);
+    for (int i=0; i<3; i++)
+      tg.run(&nested,&ca);
+  } // joined on destruction.
+  EXPECT_EQ(15,ca._count);
+  delete pool;
+}
+
+TEST(ThreadPoolTest, shared)
+{
+  thread_pool::set_shared_size(3);
+  thread_pool *pool = thread_pool::shared();
+  EXPECT_EQ(pool,thread_pool::shared());
+  EXPECT_EQ(3u,pool->size());
+  EXPECT_LE(1u,thread_pool::nprocessors());
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,133 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _PCREPOSIX_H // avoid pcreposix.h conflict with regex.h used by gtest
+#include <gtest/gtest.h>
+
+#include "url_matcher.h"
+#include "urlmatch.h"
+#include <string.h>
+
+using namespace sp;
+
+class URLMatcherTest : public testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+      const char *patterns[] =
+      {
+        ".doubleclick.net", // 0: domain and sub-domains.
+        "ads.example.com", // 1: exact domain.
+        "/banners/", // 2: host-less literal prefix.
+        "/.*/track[0-9]+\\.gif", // 3: host-less regexp with literal.
+        "ad*.example.org", // 4: wildcard domain, fallback.
+        "www.seeks-project.info/search", // 5: domain and path prefix.
+        "/[0-9]+/", // 6: regexp without literal, fallback.
+        "pixel.:8080", // 7: left-anchored domain and port.
+        NULL
+      };
+      for (int i=0; patterns[i]!=NULL; i++)
+        {
+          url_spec *usp = NULL;
+          char *buf = strdup(patterns[i]);
+          ASSERT_EQ(SP_ERR_OK,url_spec::create_url_spec(usp,buf));
+          free(buf);
+          _patterns.push_back(usp);
+          _um.add_pattern(usp,i);
+        }
+      _um.compile();
+    }
+
+    virtual void TearDown()
+    {
+      for (size_t i=0; i<_patterns.size(); i++)
+        delete _patterns[i];
+    }
+
+    // compares the matcher against the linear scan of patterns.
+    void check(const char *url, const int &expected)
+    {
+      http_request http;
+      ASSERT_EQ(SP_ERR_OK,urlmatch::parse_http_url(url,&http,REQUIRE_PROTOCOL));
+      std::vector<bool> hits;
+      bool found = _um.match(&http,hits);
+      ASSERT_EQ(_patterns.size(),hits.size());
+      bool lfound = false;
+      for (size_t i=0; i<_patterns.size(); i++)
+        {
+          bool lm = urlmatch::url_match(_patterns[i],&http);
+          ASSERT_EQ(lm,(bool)hits[i]) << url << " pattern " << _patterns[i]->_spec;
+          lfound |= lm;
+        }
+      ASSERT_EQ(lfound,found);
+      ASSERT_EQ(lfound,_um.match_any(&http));
+      if (expected >= 0)
+        {
+          ASSERT_TRUE(hits[expected]) << url;
+        }
+      else ASSERT_FALSE(found) << url;
+    }
+
+    url_matcher _um;
+    std::vector<url_spec*> _patterns;
+};
+
+TEST(url_matcher,analyze_path_pattern)
+{
+  std::string lit;
+  ASSERT_TRUE(url_matcher::analyze_path_pattern("/Banners/",lit));
+  ASSERT_EQ("/banners/",lit);
+  ASSERT_TRUE(url_matcher::analyze_path_pattern("/ads/.*",lit));
+  ASSERT_EQ("/ads/",lit);
+  ASSERT_TRUE(url_matcher::analyze_path_pattern("/ad\\.php",lit));
+  ASSERT_EQ("/ad.php",lit);
+  ASSERT_FALSE(url_matcher::analyze_path_pattern("/.*/track[0-9]+\\.gif",lit));
+  ASSERT_EQ("/track",lit);
+  ASSERT_FALSE(url_matcher::analyze_path_pattern("/adverts?/",lit));
+  ASSERT_EQ("/advert",lit);
+  ASSERT_FALSE(url_matcher::analyze_path_pattern("/(ads|pub)/",lit));
+  ASSERT_TRUE(lit.empty());
+  ASSERT_FALSE(url_matcher::analyze_path_pattern("/(ad)/x",lit));
+  ASSERT_TRUE(lit.empty());
+}
+
+TEST_F(URLMatcherTest,match)
+{
+  check("http://doubleclick.net/",0);
+  check("http://ad.g.doubleclick.net/x",0);
+  check("http://ads.example.com/",1);
+  check("http://www.ads.example.com/",-1);
+  check("http://www.example.net/banners/top.png",2);
+  check("http://www.example.net/BANNERS/top.png",2);
+  check("http://www.example.net/img/banners/top.png",-1);
+  check("http://cdn.example.net/x/y/track42.gif",3);
+  check("http://cdn.example.net/x/y/track.gif",-1);
+  check("http://adserver.example.org/",4);
+  check("http://www.seeks-project.info/search?q=seeks",5);
+  check("http://www.seeks-project.info/wiki",-1);
+  check("http://www.example.net/2012/x",6);
+  check("http://pixel.example.net:8080/",7);
+  check("http://pixel.example.net/",-1);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
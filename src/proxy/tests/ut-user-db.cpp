@@ -20,6 +20,8 @@
 #include <gtest/gtest.h>
 
 #include "user_db.h"
+#include "user_db_maintenance.h"
+#include "user_db_snapshot.h"
 #include "seeks_proxy.h"
 #include "proxy_configuration.h"
 #include "errlog.h"
@@ -30,6 +32,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 #include <sys/time.h>
 #include <sys/stat.h>
@@ -143,6 +146,297 @@ TEST(UserdbTest, all_fct)
   //delete seeks_proxy::_config;
 }
 
+TEST(UserdbTest, maintenance)
+{
+  std::string dbfile = "seeks_test_maintenance.db";
+  unlink(dbfile.c_str());
+  user_db *db = new user_db(dbfile);
+  db->open_db();
+
+  // records of two plugins, half of them older than the date.
+  time_t date = 1000000;
+  for (int i=0; i<50; i++)
+    {
+      db_record dbr(i % 2 == 0 ? date - 1 : date + 1,"plugin_a");
+      db->add_dbr("key" + miscutil::to_string(i),dbr);
+    }
+  for (int i=0; i<10; i++)
+    {
+      db_record dbr(date - 1,"plugin_b");
+      db->add_dbr("key" + miscutil::to_string(i),dbr);
+    }
+  ASSERT_EQ(60,db->number_records());
+
+  // a cancelled job removes nothing.
+  user_db_maintenance *udm = new user_db_maintenance(db,"plugin_a",date);
+  udm->set_limits(7,3,0);
+  udm->pause();
+  ASSERT_EQ(SP_ERR_OK,udm->start());
+  udm->cancel();
+  udm->wait();
+  udb_maintenance_stats stats;
+  udm->get_stats(stats);
+  ASSERT_TRUE(stats._done);
+  ASSERT_TRUE(stats._cancelled);
+  ASSERT_EQ(0,stats._removed);
+  ASSERT_EQ(60,db->number_records());
+  delete udm;
+
+  // old records of the plugin are removed, in chunks.
+  udm = new user_db_maintenance(db,"plugin_a",date);
+  udm->set_limits(7,3,1);
+  ASSERT_EQ(SP_ERR_OK,udm->start());
+  udm->wait();
+  udm->get_stats(stats);
+  ASSERT_TRUE(stats._done);
+  ASSERT_FALSE(stats._cancelled);
+  ASSERT_EQ(50,stats._total);
+  ASSERT_EQ(50,stats._scanned);
+  ASSERT_EQ(50,stats._decoded);
+  ASSERT_EQ(25,stats._removed);
+  ASSERT_EQ(0,stats._errors);
+  ASSERT_EQ(35,db->number_records());
+  delete udm;
+
+  // in the calling thread.
+  udm = new user_db_maintenance(db,"plugin_b");
+  ASSERT_EQ(SP_ERR_OK,udm->run());
+  ASSERT_EQ(25,db->number_records());
+  delete udm;
+
+  db->clear_db();
+  db->close_db();
+  unlink(dbfile.c_str());
+  delete db;
+}
+
+/* rewrites the records of a plugin under new keys, and logs the jobs
+   the fixes come from. */
+class udb_rekey : public user_db_maintenance
+{
+  public:
+    udb_rekey(user_db *udb, const std::string &plugin_name,
+              std::vector<std::string> *fixes, sp_mutex_t *fixes_mutex)
+      :user_db_maintenance(udb,plugin_name),_fixes(fixes),_fixes_mutex(fixes_mutex)
+    {};
+
+    virtual bool select(const db_record *dbr) const
+    {
+      return false;
+    };
+
+    virtual uint32_t fix(db_record *dbr, std::string &key) const
+    {
+      mutex_lock(_fixes_mutex);
+      _fixes->push_back(_plugin_name);
+      mutex_unlock(_fixes_mutex);
+      key = "fixed-" + key;
+      return 1;
+    };
+
+    std::vector<std::string> *_fixes;
+    sp_mutex_t *_fixes_mutex;
+};
+
+TEST(UserdbTest, maintenance_concurrent)
+{
+  std::string dbfile = "seeks_test_maintenance_concurrent.db";
+  unlink(dbfile.c_str());
+  user_db *db = new user_db(dbfile);
+  db->open_db();
+  for (int i=0; i<50; i++)
+    {
+      db_record dbr(i,"plugin_a");
+      db->add_dbr("key" + miscutil::to_string(i),dbr);
+    }
+  for (int i=0; i<10; i++)
+    {
+      db_record dbr(i,"plugin_b");
+      db->add_dbr("key" + miscutil::to_string(i),dbr);
+    }
+
+  // jobs started together run one after the other.
+  std::vector<std::string> fixes;
+  sp_mutex_t fixes_mutex;
+  mutex_init(&fixes_mutex);
+  udb_rekey *udm_a = new udb_rekey(db,"plugin_a",&fixes,&fixes_mutex);
+  udb_rekey *udm_b = new udb_rekey(db,"plugin_b",&fixes,&fixes_mutex);
+  udm_a->set_limits(3,2,1);
+  udm_b->set_limits(3,2,1);
+  ASSERT_EQ(SP_ERR_OK,udm_a->start());
+  ASSERT_EQ(SP_ERR_OK,udm_b->start());
+
+  // walks over the db never see a chunk half written.
+  while (!udm_a->done() || !udm_b->done())
+    {
+      ASSERT_EQ(10,db->number_records("plugin_b"));
+      std::vector<std::string> rkeys;
+      ASSERT_EQ(SP_ERR_OK,db->find_keys("plugin_a",rkeys));
+      ASSERT_EQ(50,rkeys.size());
+    }
+  udm_a->wait();
+  udm_b->wait();
+
+  ASSERT_EQ(60,fixes.size());
+  size_t switches = 0;
+  for (size_t i=1; i<fixes.size(); i++)
+    if (fixes.at(i) != fixes.at(i-1))
+      switches++;
+  ASSERT_TRUE(switches <= 1);
+
+  udb_maintenance_stats stats;
+  udm_a->get_stats(stats);
+  ASSERT_EQ(50,stats._fixed);
+  ASSERT_EQ(0,stats._errors);
+  udm_b->get_stats(stats);
+  ASSERT_EQ(10,stats._fixed);
+  ASSERT_EQ(60,db->number_records());
+  db_record *dbr = db->find_dbr("fixed-key7","plugin_b");
+  ASSERT_TRUE(dbr != NULL);
+  ASSERT_EQ(7,dbr->_creation_time);
+  delete dbr;
+  dbr = db->find_dbr("key7","plugin_b");
+  ASSERT_TRUE(dbr == NULL);
+  delete udm_a;
+  delete udm_b;
+  mutex_destroy(&fixes_mutex);
+
+  db->clear_db();
+  db->close_db();
+  unlink(dbfile.c_str());
+  delete db;
+}
+
+/* moves the records under keys a<n> to keys b<n>, and rewrites the records
+   under keys b<n> in place. */
+class udb_move : public user_db_maintenance
+{
+  public:
+    udb_move(user_db *udb)
+      :user_db_maintenance(udb,"plugin_a")
+    {};
+
+    virtual bool select(const db_record *dbr) const
+    {
+      return false;
+    };
+
+    virtual uint32_t fix(db_record *dbr, std::string &key) const
+    {
+      if (key[0] == 'a')
+        key[0] = 'b';
+      return 1;
+    };
+};
+
+TEST(UserdbTest, maintenance_fix_merge)
+{
+  std::string dbfile = "seeks_test_maintenance_merge.db";
+  unlink(dbfile.c_str());
+  user_db *db = new user_db(dbfile);
+  db->open_db();
+  for (int i=0; i<20; i++)
+    {
+      db_record dbr(1,"plugin_a");
+      db->add_dbr("a" + miscutil::to_string(i),dbr);
+      db->add_dbr("b" + miscutil::to_string(i),dbr);
+    }
+
+  // a record moved onto another one of the same chunk is merged into it,
+  // which updates its creation time: the merge is not overwritten when the
+  // other record is rewritten.
+  udb_move udm(db);
+  udm.set_limits(100,2,0);
+  ASSERT_EQ(SP_ERR_OK,udm.run());
+  ASSERT_EQ(20,db->number_records());
+  for (int i=0; i<20; i++)
+    {
+      db_record *dbr = db->find_dbr("b" + miscutil::to_string(i),"plugin_a");
+      ASSERT_TRUE(dbr != NULL);
+      ASSERT_TRUE(dbr->_creation_time > 1);
+      delete dbr;
+    }
+
+  db->clear_db();
+  db->close_db();
+  unlink(dbfile.c_str());
+  delete db;
+}
+
+TEST(UserdbTest, snapshot)
+{
+  std::string dbfile = "seeks_test_snapshot.db";
+  std::string dbfile2 = "seeks_test_snapshot2.db";
+  unlink(dbfile.c_str());
+  unlink(dbfile2.c_str());
+  user_db *db = new user_db(dbfile);
+  db->open_db();
+  db->set_version(user_db::_db_version);
+  for (int i=0; i<40; i++)
+    {
+      db_record dbr(i,"plugin_a");
+      db->add_dbr("key" + miscutil::to_string(i),dbr);
+    }
+  for (int i=0; i<10; i++)
+    {
+      db_record dbr(i,"plugin_b");
+      db->add_dbr("key" + miscutil::to_string(i),dbr);
+    }
+  ASSERT_EQ(51,db->number_records()); // with the version record.
+
+  // small blocks, so that there are several rounds of blocks.
+  std::stringstream snap;
+  user_db_snapshot *uds = new user_db_snapshot(db);
+  uds->set_limits(64,3,1);
+  ASSERT_EQ(SP_ERR_OK,uds->export_db(snap));
+  ASSERT_EQ(50,uds->get_stats()._records);
+  ASSERT_TRUE(uds->get_stats()._blocks > 3);
+  std::string snapshot = snap.str();
+  std::stringstream snap_b;
+  ASSERT_EQ(SP_ERR_OK,uds->export_db(snap_b,"plugin_b"));
+  ASSERT_EQ(10,uds->get_stats()._records);
+  delete uds;
+
+  // round trip into an empty db.
+  user_db *db2 = new user_db(dbfile2);
+  db2->open_db();
+  uds = new user_db_snapshot(db2);
+  uds->set_limits(64,3,1);
+  std::istringstream in(snapshot);
+  ASSERT_EQ(SP_ERR_OK,uds->import_db(in));
+  ASSERT_EQ(50,uds->get_stats()._records);
+  ASSERT_EQ(51,db2->number_records());
+  ASSERT_EQ(user_db::_db_version,db2->get_version());
+  for (int i=0; i<40; i++)
+    {
+      db_record *dbr = db2->find_dbr("key" + miscutil::to_string(i),"plugin_a");
+      ASSERT_TRUE(NULL != dbr);
+      ASSERT_EQ(i,dbr->_creation_time);
+      delete dbr;
+    }
+
+  // corrupted, truncated and incompatible snapshots are rejected.
+  std::string corrupted = snapshot;
+  corrupted[corrupted.size()/2] ^= 0x5a;
+  std::istringstream cdin(corrupted);
+  ASSERT_NE(SP_ERR_OK,uds->import_db(cdin));
+  std::istringstream tin(snapshot.substr(0,snapshot.size()-3));
+  ASSERT_EQ(DB_ERR_SNAPSHOT,uds->import_db(tin));
+  db2->set_version(0.1);
+  std::istringstream vin(snapshot);
+  ASSERT_EQ(DB_ERR_SNAPSHOT,uds->import_db(vin));
+  delete uds;
+
+  db2->clear_db();
+  db2->close_db();
+  unlink(dbfile2.c_str());
+  delete db2;
+  db->clear_db();
+  db->close_db();
+  unlink(dbfile.c_str());
+  delete db;
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,348 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "thread_pool.h"
+#include "errlog.h"
+
+#include <unistd.h>
+
+namespace sp
+{
+  /*- task_group_state -*/
+  task_group_state::task_group_state()
+    :_running(0),_refs(1)
+  {
+    mutex_init(&_mutex);
+    cond_init(&_cond);
+  }
+
+  task_group_state::~task_group_state()
+  {
+    mutex_destroy(&_mutex);
+    pthread_cond_destroy(&_cond);
+  }
+
+  bool task_group_state::run_one()
+  {
+    mutex_lock(&_mutex);
+    if (_tasks.empty())
+      {
+        mutex_unlock(&_mutex);
+        return false;
+      }
+    pool_task task = _tasks.front();
+    _tasks.pop_front();
+    _running++;
+    mutex_unlock(&_mutex);
+
+    task._fn(task._arg);
+
+    mutex_lock(&_mutex);
+    if (--_running == 0)
+      cond_broadcast(&_cond);
+    mutex_unlock(&_mutex);
+    return true;
+  }
+
+  void task_group_state::release()
+  {
+    mutex_lock(&_mutex);
+    int refs = --_refs;
+    mutex_unlock(&_mutex);
+    if (refs == 0)
+      delete this;
+  }
+
+  /*- pool_worker -*/
+  pool_worker::pool_worker(thread_pool *pool, const size_t &rank)
+    :_pool(pool),_rank(rank),_thread(0)
+  {
+    mutex_init(&_mutex);
+  }
+
+  pool_worker::~pool_worker()
+  {
+    mutex_destroy(&_mutex);
+  }
+
+  /*- thread_pool -*/
+  thread_pool* thread_pool::_shared = NULL;
+  size_t thread_pool::_shared_size = 0;
+  sp_mutex_t thread_pool::_shared_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+  thread_pool::thread_pool(const size_t &nworkers)
+    :_queued(0),_idle(0),_stop(false),_executed(0),_stolen(0)
+  {
+    mutex_init(&_injected_mutex);
+    mutex_init(&_mutex);
+    cond_init(&_cond);
+    pthread_key_create(&_worker_key,NULL);
+
+    size_t n = nworkers ? nworkers : thread_pool::nprocessors();
+    if (n > THREAD_POOL_MAX_WORKERS)
+      n = THREAD_POOL_MAX_WORKERS;
+
+    // workers are all created before they look for tickets to steal.
+    mutex_lock(&_mutex);
+    for (size_t i=0; i<n; i++)
+      {
+        pool_worker *pw = new pool_worker(this,_workers.size());
+        int err = pthread_create(&pw->_thread,NULL,&thread_pool::worker_loop,pw);
+        if (err != 0)
+          {
+            // tasks are run by the groups that wait on them, if need be.
+            errlog::log_error(LOG_LEVEL_ERROR,"Error creating thread pool worker: %d",err);
+            delete pw;
+            break;
+          }
+        _workers.push_back(pw);
+      }
+    mutex_unlock(&_mutex);
+  }
+
+  thread_pool::~thread_pool()
+  {
+    mutex_lock(&_mutex);
+    _stop = true;
+    cond_broadcast(&_cond);
+    mutex_unlock(&_mutex);
+
+    // workers steal from each other until they all stopped.
+    for (size_t i=0; i<_workers.size(); i++)
+      pthread_join(_workers[i]->_thread,NULL);
+    for (size_t i=0; i<_workers.size(); i++)
+      {
+        while (!_workers[i]->_tickets.empty())
+          {
+            _workers[i]->_tickets.front()->release();
+            _workers[i]->_tickets.pop_front();
+          }
+        delete _workers[i];
+      }
+    while (!_injected.empty())
+      {
+        _injected.front()->release();
+        _injected.pop_front();
+      }
+
+    pthread_key_delete(_worker_key);
+    mutex_destroy(&_injected_mutex);
+    mutex_destroy(&_mutex);
+    pthread_cond_destroy(&_cond);
+  }
+
+  void thread_pool::push(task_group_state *ts)
+  {
+    pool_worker *pw = static_cast<pool_worker*>(pthread_getspecific(_worker_key));
+    if (pw)
+      {
+        mutex_lock(&pw->_mutex);
+        pw->_tickets.push_back(ts);
+        mutex_unlock(&pw->_mutex);
+      }
+    else
+      {
+        mutex_lock(&_injected_mutex);
+        _injected.push_back(ts);
+        mutex_unlock(&_injected_mutex);
+      }
+
+    mutex_lock(&_mutex);
+    _queued++;
+    if (_idle > 0)
+      cond_signal(&_cond);
+    mutex_unlock(&_mutex);
+  }
+
+  bool thread_pool::try_take(pool_worker *pw, task_group_state *&ts, bool &stolen)
+  {
+    stolen = false;
+
+    // most recent ticket of the worker first.
+    mutex_lock(&pw->_mutex);
+    if (!pw->_tickets.empty())
+      {
+        ts = pw->_tickets.back();
+        pw->_tickets.pop_back();
+        mutex_unlock(&pw->_mutex);
+        return true;
+      }
+    mutex_unlock(&pw->_mutex);
+
+    // then tickets from outside the pool.
+    mutex_lock(&_injected_mutex);
+    if (!_injected.empty())
+      {
+        ts = _injected.front();
+        _injected.pop_front();
+        mutex_unlock(&_injected_mutex);
+        return true;
+      }
+    mutex_unlock(&_injected_mutex);
+
+    // then the oldest ticket of another worker.
+    size_t n = _workers.size();
+    for (size_t i=1; i<n; i++)
+      {
+        pool_worker *victim = _workers[(pw->_rank + i) % n];
+        mutex_lock(&victim->_mutex);
+        if (!victim->_tickets.empty())
+          {
+            ts = victim->_tickets.front();
+            victim->_tickets.pop_front();
+            mutex_unlock(&victim->_mutex);
+            stolen = true;
+            return true;
+          }
+        mutex_unlock(&victim->_mutex);
+      }
+    return false;
+  }
+
+  bool thread_pool::take(pool_worker *pw, task_group_state *&ts)
+  {
+    while (true)
+      {
+        bool stolen = false;
+        if (try_take(pw,ts,stolen))
+          {
+            mutex_lock(&_mutex);
+            _queued--;
+            if (stolen)
+              _stolen++;
+            mutex_unlock(&_mutex);
+            return true;
+          }
+
+        mutex_lock(&_mutex);
+        while (_queued == 0 && !_stop)
+          {
+            _idle++;
+            cond_wait(&_cond,&_mutex);
+            _idle--;
+          }
+        bool stop = _stop;
+        mutex_unlock(&_mutex);
+        if (stop)
+          return false;
+      }
+  }
+
+  void* thread_pool::worker_loop(void *arg)
+  {
+    pool_worker *pw = static_cast<pool_worker*>(arg);
+    thread_pool *tp = pw->_pool;
+
+    // waits for the other workers to be created.
+    mutex_lock(&tp->_mutex);
+    mutex_unlock(&tp->_mutex);
+    pthread_setspecific(tp->_worker_key,pw);
+
+    task_group_state *ts = NULL;
+    while (tp->take(pw,ts))
+      {
+        // the task may have been run by its group already.
+        if (ts->run_one())
+          {
+            mutex_lock(&tp->_mutex);
+            tp->_executed++;
+            mutex_unlock(&tp->_mutex);
+          }
+        ts->release();
+      }
+    return NULL;
+  }
+
+  void thread_pool::get_stats(thread_pool_stats &stats)
+  {
+    mutex_lock(&_mutex);
+    stats._workers = _workers.size();
+    stats._queued = _queued;
+    stats._executed = _executed;
+    stats._stolen = _stolen;
+    mutex_unlock(&_mutex);
+  }
+
+  thread_pool* thread_pool::shared()
+  {
+    mutex_lock(&_shared_mutex);
+    if (!_shared)
+      {
+        _shared = new thread_pool(_shared_size);
+        errlog::log_error(LOG_LEVEL_INFO,"Started thread pool of %d workers",
+                          (int)_shared->size());
+      }
+    thread_pool *tp = _shared;
+    mutex_unlock(&_shared_mutex);
+    return tp;
+  }
+
+  void thread_pool::set_shared_size(const size_t &nworkers)
+  {
+    mutex_lock(&_shared_mutex);
+    _shared_size = nworkers;
+    mutex_unlock(&_shared_mutex);
+  }
+
+  size_t thread_pool::nprocessors()
+  {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t)n : 1;
+  }
+
+  /*- task_group -*/
+  task_group::task_group(thread_pool *pool)
+    :_pool(pool),_state(new task_group_state())
+  {
+  }
+
+  task_group::~task_group()
+  {
+    wait();
+    _state->release();
+  }
+
+  void task_group::run(void* (*fn)(void*), void *arg)
+  {
+    if (!_pool)
+      {
+        fn(arg);
+        return;
+      }
+
+    mutex_lock(&_state->_mutex);
+    _state->_tasks.push_back(pool_task(fn,arg));
+    _state->_refs++;
+    mutex_unlock(&_state->_mutex);
+    _pool->push(_state);
+  }
+
+  void task_group::wait()
+  {
+    // tasks not picked by a worker yet are run here.
+    while (_state->run_one())
+      {
+      }
+
+    mutex_lock(&_state->_mutex);
+    while (_state->_running > 0)
+      cond_wait(&_state->_cond,&_state->_mutex);
+    mutex_unlock(&_state->_mutex);
+  }
+
+} /* end of namespace. */
@@ -0,0 +1,243 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "mutexes.h"
+
+#include <deque>
+#include <vector>
+
+/**
+ * Upper bound on the number of workers of a pool.
+ */
+#define THREAD_POOL_MAX_WORKERS 256
+
+namespace sp
+{
+  class thread_pool;
+  class task_group;
+
+  /**
+   * \brief a function and its argument, as given to pthread_create.
+   */
+  class pool_task
+  {
+    public:
+      pool_task(void* (*fn)(void*), void *arg)
+        :_fn(fn),_arg(arg)
+      {};
+
+      ~pool_task() {};
+
+      void* (*_fn)(void*);
+      void *_arg;
+  };
+
+  /**
+   * \brief tasks of a group that have not started yet, shared by the
+   *        group and the tickets queued in the pool for it.
+   */
+  class task_group_state
+  {
+    public:
+      task_group_state();
+
+      ~task_group_state();
+
+      /**
+       * \brief runs the first task not yet started, if any.
+       * @return whether a task was run.
+       */
+      bool run_one();
+
+      /**
+       * \brief drops a reference, deleting the state with the last one.
+       */
+      void release();
+
+      sp_mutex_t _mutex;
+      sp_cond_t _cond; /**< signaled when the last running task finishes. */
+      std::deque<pool_task> _tasks; /**< tasks not started yet. */
+      int _running; /**< tasks started and not finished yet. */
+      int _refs; /**< the group and its queued tickets. */
+  };
+
+  /**
+   * \brief queue of tickets of a worker. The worker takes the most recent
+   *        ticket, other workers steal the oldest one.
+   */
+  class pool_worker
+  {
+    public:
+      pool_worker(thread_pool *pool, const size_t &rank);
+
+      ~pool_worker();
+
+      thread_pool *_pool;
+      size_t _rank;
+      pthread_t _thread;
+      sp_mutex_t _mutex;
+      std::deque<task_group_state*> _tickets;
+  };
+
+  /**
+   * \brief counters of a thread pool.
+   */
+  class thread_pool_stats
+  {
+    public:
+      thread_pool_stats()
+        :_workers(0),_queued(0),_executed(0),_stolen(0)
+      {};
+
+      ~thread_pool_stats() {};
+
+      size_t _workers; /**< number of worker threads. */
+      size_t _queued; /**< tickets waiting for a worker. */
+      unsigned long _executed; /**< tasks run by the workers. */
+      unsigned long _stolen; /**< tickets taken from the queue of another worker. */
+  };
+
+  /**
+   * \brief a fixed set of worker threads that run the tasks of task groups,
+   *        so that fan-outs do not create threads and that the number of
+   *        running tasks is bounded by the size of the pool.
+   *
+   *        Tasks forked from within a worker are queued to this worker, and
+   *        idle workers steal from the others, so that nested fork/joins
+   *        spread over the pool. Tasks are run to completion, a task that
+   *        waits on a group runs the tasks of this group that have not started.
+   */
+  class thread_pool
+  {
+    public:
+      /**
+       * \brief starts nworkers threads, as many as there are processors
+       *        if nworkers is 0.
+       */
+      thread_pool(const size_t &nworkers=0);
+
+      /**
+       * \brief stops and joins the workers. Groups of pending tasks run
+       *        them when they wait.
+       */
+      ~thread_pool();
+
+      /**
+       * \brief number of workers.
+       */
+      size_t size() const
+      {
+        return _workers.size();
+      };
+
+      /**
+       * \brief fills up the counters of the pool.
+       */
+      void get_stats(thread_pool_stats &stats);
+
+      /**
+       * \brief the process-wide pool, started on first use.
+       */
+      static thread_pool* shared();
+
+      /**
+       * \brief sets the number of workers of the process-wide pool, 0 for
+       *        as many as there are processors. Has no effect once the
+       *        pool is started.
+       */
+      static void set_shared_size(const size_t &nworkers);
+
+      /**
+       * \brief number of online processors.
+       */
+      static size_t nprocessors();
+
+    private:
+      thread_pool(const thread_pool &tp); // not copyable.
+      thread_pool& operator=(const thread_pool &tp);
+
+      void push(task_group_state *ts);
+
+      bool take(pool_worker *pw, task_group_state *&ts);
+
+      bool try_take(pool_worker *pw, task_group_state *&ts, bool &stolen);
+
+      static void* worker_loop(void *arg);
+
+      friend class task_group;
+
+    private:
+      std::vector<pool_worker*> _workers;
+
+      sp_mutex_t _injected_mutex;
+      std::deque<task_group_state*> _injected; /**< tickets from outside the pool. */
+
+      sp_mutex_t _mutex; /**< guards the counters below. */
+      sp_cond_t _cond; /**< signaled when a ticket is queued. */
+      size_t _queued;
+      size_t _idle;
+      bool _stop;
+      unsigned long _executed;
+      unsigned long _stolen;
+
+      pthread_key_t _worker_key; /**< worker of the current thread. */
+
+      static thread_pool *_shared;
+      static size_t _shared_size;
+      static sp_mutex_t _shared_mutex;
+  };
+
+  /**
+   * \brief fork/join over a thread pool: tasks are forked with run() and
+   *        joined with wait(). With no pool, tasks run in run().
+   */
+  class task_group
+  {
+    public:
+      task_group(thread_pool *pool);
+
+      /**
+       * \brief waits for the tasks of the group.
+       */
+      ~task_group();
+
+      /**
+       * \brief forks fn(arg).
+       */
+      void run(void* (*fn)(void*), void *arg);
+
+      /**
+       * \brief runs the tasks of the group that have not started and waits
+       *        for the others to finish.
+       */
+      void wait();
+
+    private:
+      task_group(const task_group &tg); // not copyable.
+      task_group& operator=(const task_group &tg);
+
+      thread_pool *_pool;
+      task_group_state *_state;
+  };
+
+} /* end of namespace. */
+
+#endif
@@ -0,0 +1,488 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "url_matcher.h"
+#include "urlmatch.h"
+#include "mem_utils.h"
+#include "errlog.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <queue>
+
+namespace sp
+{
+  /*- url_matcher_domain_node -*/
+  url_matcher_domain_node::~url_matcher_domain_node()
+  {
+    hash_map<const char*,url_matcher_domain_node*,hash<const char*>,eqstr>::iterator hit
+    = _children.begin();
+    while (hit!=_children.end())
+      {
+        const char *key = (*hit).first;
+        url_matcher_domain_node *node = (*hit).second;
+        hash_map<const char*,url_matcher_domain_node*,hash<const char*>,eqstr>::iterator dhit = hit;
+        ++hit;
+        _children.erase(dhit);
+        free_const(key);
+        delete node;
+      }
+  }
+
+  /*- url_matcher -*/
+  url_matcher::url_matcher()
+    :_domains(new url_matcher_domain_node()),_ntags(0),_compiled(true)
+  {
+    _prefixes.push_back(url_matcher_trie_node()); // root.
+    _ac.push_back(url_matcher_trie_node()); // root.
+  }
+
+  url_matcher::~url_matcher()
+  {
+    delete _domains;
+  }
+
+  void url_matcher::clear()
+  {
+    _entries.clear();
+    delete _domains;
+    _domains = new url_matcher_domain_node();
+    _any.clear();
+    _prefixes.clear();
+    _prefixes.push_back(url_matcher_trie_node());
+    _ac.clear();
+    _ac.push_back(url_matcher_trie_node());
+    _fallback.clear();
+    _ntags = 0;
+    _compiled = true;
+  }
+
+  bool url_matcher::analyze_path_pattern(const char *path_pattern,
+                                         std::string &literal)
+  {
+    literal.clear();
+    if (!path_pattern || path_pattern[0] == '\0')
+      return false;
+
+    // alternations are left to the regexp engine.
+    if (strchr(path_pattern,'|'))
+      return false;
+
+    // a trailing '.*' does not change a left-anchored match.
+    std::string p = path_pattern;
+    size_t plen = p.length();
+    if (plen > 2 && p[plen-2] == '.' && p[plen-1] == '*' && p[plen-3] != '\\')
+      p = p.substr(0,plen-2);
+
+    bool plain = true;
+    int depth = 0;
+    std::string run, best;
+    size_t i = 0;
+    while (i < p.length())
+      {
+        char c = p[i];
+        if (c == '\\')
+          {
+            if (i+1 == p.length() || isalnum((unsigned char)p[i+1]))
+              {
+                // character class or assertion, e.g. '\d' or '\b'.
+                plain = false;
+                if (run.length() > best.length())
+                  best = run;
+                run.clear();
+                i += 2;
+                continue;
+              }
+            c = p[i+1];
+            i += 2;
+          }
+        else if (c == '[')
+          {
+            plain = false;
+            if (run.length() > best.length())
+              best = run;
+            run.clear();
+            size_t j = i+1;
+            if (j < p.length() && p[j] == '^')
+              j++;
+            if (j < p.length() && p[j] == ']')
+              j++;
+            while (j < p.length() && p[j] != ']')
+              {
+                if (p[j] == '\\')
+                  j++;
+                j++;
+              }
+            i = j+1;
+            continue;
+          }
+        else if (c == '*' || c == '?' || c == '{')
+          {
+            // the previous character is optional.
+            plain = false;
+            if (!run.empty())
+              run.erase(run.length()-1);
+            if (run.length() > best.length())
+              best = run;
+            run.clear();
+            if (c == '{')
+              {
+                while (i < p.length() && p[i] != '}')
+                  i++;
+              }
+            i++;
+            continue;
+          }
+        else if (c == '(' || c == ')' || c == '.' || c == '^' || c == '$'
+                 || c == '+' || c == ']' || c == '}')
+          {
+            plain = false;
+            if (c == '(')
+              depth++;
+            else if (c == ')')
+              depth--;
+            if (run.length() > best.length())
+              best = run;
+            run.clear();
+            i++;
+            continue;
+          }
+        else i++;
+
+        // literal character, only collected outside groups.
+        if (depth == 0)
+          run += (char)tolower((unsigned char)c);
+        else
+          {
+            if (run.length() > best.length())
+              best = run;
+            run.clear();
+          }
+      }
+    if (run.length() > best.length())
+      best = run;
+
+    if (plain)
+      {
+        literal = best;
+        return true;
+      }
+
+    // every path starts with '/', very short literals do not filter anything.
+    if (best.length() >= 3)
+      literal = best;
+    return false;
+  }
+
+  uint32_t url_matcher::add_trie_literal(std::vector<url_matcher_trie_node> &trie,
+                                         const std::string &literal)
+  {
+    uint32_t n = 0;
+    for (size_t i=0; i<literal.length(); i++)
+      {
+        unsigned char c = (unsigned char)literal[i];
+        std::map<unsigned char,uint32_t>::const_iterator mit = trie[n]._next.find(c);
+        if (mit != trie[n]._next.end())
+          n = (*mit).second;
+        else
+          {
+            uint32_t nn = trie.size();
+            trie.push_back(url_matcher_trie_node());
+            trie[n]._next.insert(std::pair<unsigned char,uint32_t>(c,nn));
+            n = nn;
+          }
+      }
+    return n;
+  }
+
+  void url_matcher::add_domain(const url_spec *usp, const uint32_t &e)
+  {
+#ifndef FEATURE_EXTENDED_HOST_PATTERNS
+    url_matcher_domain_node *node = _domains;
+    for (int i=usp->_dcount-1; i>=0; i--)
+      {
+        const char *label = usp->_dvec[i];
+        hash_map<const char*,url_matcher_domain_node*,hash<const char*>,eqstr>::iterator hit;
+        if ((hit = node->_children.find(label)) != node->_children.end())
+          node = (*hit).second;
+        else
+          {
+            url_matcher_domain_node *child = new url_matcher_domain_node();
+            node->_children.insert(std::pair<const char*,url_matcher_domain_node*>(strdup(label),child));
+            node = child;
+          }
+      }
+    if (usp->_unanchored & ANCHOR_LEFT)
+      node->_sub.push_back(e);
+    else node->_exact.push_back(e);
+#endif
+  }
+
+  void url_matcher::add_pattern(const url_spec *usp, const uint32_t &tag)
+  {
+    if (!usp || usp->_tag_regex != NULL)
+      return; // tag patterns never match URLs.
+
+    uint32_t e = _entries.size();
+    _entries.push_back(url_matcher_entry(usp,tag));
+    url_matcher_entry &ent = _entries.back();
+    if (tag+1 > _ntags)
+      _ntags = tag+1;
+
+    if (usp->_preg && usp->_spec)
+      {
+        const char *path_pattern = strchr(usp->_spec,'/');
+        ent._literal_only = url_matcher::analyze_path_pattern(path_pattern,ent._literal);
+        if (ent._literal_only && ent._literal.empty())
+          ent._literal_only = false;
+      }
+
+    // host part.
+    bool any_host = false;
+#ifdef FEATURE_EXTENDED_HOST_PATTERNS
+    any_host = (usp->_host_regex == NULL);
+#else
+    any_host = (usp->_dbuffer == NULL || usp->_dcount == 0);
+    if (!any_host)
+      {
+        int unanchored = usp->_unanchored & (ANCHOR_RIGHT | ANCHOR_LEFT);
+        bool plain = (unanchored == 0 || unanchored == ANCHOR_LEFT);
+        for (int i=0; plain && i<usp->_dcount; i++)
+          {
+            if (strpbrk(usp->_dvec[i],"*?[") != NULL)
+              plain = false;
+          }
+        if (plain)
+          {
+            add_domain(usp,e);
+            return;
+          }
+        _fallback.push_back(e);
+        return;
+      }
+#endif
+    if (!any_host)
+      {
+        _fallback.push_back(e);
+        return;
+      }
+
+    // path part.
+    if (!usp->_preg)
+      _any.push_back(e);
+    else if (ent._literal_only)
+      {
+        uint32_t n = add_trie_literal(_prefixes,ent._literal);
+        _prefixes[n]._entries.push_back(e);
+      }
+    else if (!ent._literal.empty())
+      {
+        uint32_t n = add_trie_literal(_ac,ent._literal);
+        _ac[n]._entries.push_back(e);
+        _compiled = false;
+      }
+    else _fallback.push_back(e);
+  }
+
+  void url_matcher::add_patterns(const std::vector<url_spec*> &patterns,
+                                 const uint32_t &tag)
+  {
+    std::vector<url_spec*>::const_iterator vit = patterns.begin();
+    while (vit!=patterns.end())
+      {
+        add_pattern((*vit),tag);
+        ++vit;
+      }
+    if (tag+1 > _ntags)
+      _ntags = tag+1;
+  }
+
+  void url_matcher::compile()
+  {
+    // breadth-first computation of failure and dictionary links.
+    std::queue<uint32_t> q;
+    std::map<unsigned char,uint32_t>::const_iterator mit = _ac[0]._next.begin();
+    while (mit!=_ac[0]._next.end())
+      {
+        _ac[(*mit).second]._fail = 0;
+        _ac[(*mit).second]._dict = 0;
+        q.push((*mit).second);
+        ++mit;
+      }
+    while (!q.empty())
+      {
+        uint32_t n = q.front();
+        q.pop();
+        mit = _ac[n]._next.begin();
+        while (mit!=_ac[n]._next.end())
+          {
+            unsigned char c = (*mit).first;
+            uint32_t child = (*mit).second;
+            uint32_t f = _ac[n]._fail;
+            std::map<unsigned char,uint32_t>::const_iterator fit;
+            while (f != 0 && (fit = _ac[f]._next.find(c)) == _ac[f]._next.end())
+              f = _ac[f]._fail;
+            if ((fit = _ac[f]._next.find(c)) != _ac[f]._next.end() && (*fit).second != child)
+              f = (*fit).second;
+            else f = 0;
+            _ac[child]._fail = f;
+            _ac[child]._dict = _ac[f]._entries.empty() ? _ac[f]._dict : f;
+            q.push(child);
+            ++mit;
+          }
+      }
+    _compiled = true;
+
+    errlog::log_error(LOG_LEVEL_INFO,
+                      "url matcher: %u patterns, %u prefix trie nodes, %u automaton nodes, %u regexp fallbacks",
+                      _entries.size(),_prefixes.size(),_ac.size(),_fallback.size());
+  }
+
+  bool url_matcher::test_entry(const url_matcher_entry &e, const http_request *http,
+                               const char *lpath, const bool &host_checked) const
+  {
+    const url_spec *usp = e._usp;
+    if (e._literal_only)
+      {
+        if (strncmp(lpath,e._literal.c_str(),e._literal.length()) != 0)
+          return false;
+      }
+    else if (!e._literal.empty() && !strstr(lpath,e._literal.c_str()))
+      return false;
+    if (!urlmatch::port_matches(http->_port,usp->_port_list))
+      return false;
+    if (!host_checked && !urlmatch::host_matches(http,usp))
+      return false;
+    if (e._literal_only)
+      return true;
+    return urlmatch::path_matches(http->_path ? http->_path : "",usp);
+  }
+
+  bool url_matcher::match(const http_request *http, std::vector<bool> &hits) const
+  {
+    return match_tags(http,hits,false);
+  }
+
+  bool url_matcher::match_any(const http_request *http) const
+  {
+    std::vector<bool> hits;
+    return match_tags(http,hits,true);
+  }
+
+  bool url_matcher::match_tags(const http_request *http, std::vector<bool> &hits,
+                               const bool &first) const
+  {
+    hits.assign(_ntags,false);
+    if (_entries.empty())
+      return false;
+
+    if (!_compiled)
+      errlog::log_error(LOG_LEVEL_ERROR,"url matcher used before compilation");
+
+    bool found = false;
+
+    // lower-cased path, for literals.
+    std::string lpath = http->_path ? http->_path : "";
+    for (size_t i=0; i<lpath.length(); i++)
+      lpath[i] = (char)tolower((unsigned char)lpath[i]);
+    const char *lp = lpath.c_str();
+
+#define URL_MATCHER_TEST(eid,host_checked)                              \
+    {                                                                   \
+      const url_matcher_entry &ent = _entries[(eid)];                   \
+      if (!hits[ent._tag] && test_entry(ent,http,lp,(host_checked)))    \
+        {                                                               \
+          hits[ent._tag] = true;                                        \
+          found = true;                                                 \
+          if (first)                                                    \
+            return true;                                                \
+        }                                                               \
+    }
+
+    std::vector<uint32_t>::const_iterator vit;
+
+    // patterns that match any host.
+    for (vit=_any.begin(); vit!=_any.end(); ++vit)
+      URL_MATCHER_TEST((*vit),true);
+
+#ifndef FEATURE_EXTENDED_HOST_PATTERNS
+    // domain trie, walked from the top-level domain down.
+    const url_matcher_domain_node *node = _domains;
+    for (int i=http->_dcount-1; i>=0 && http->_dvec; i--)
+      {
+        hash_map<const char*,url_matcher_domain_node*,hash<const char*>,eqstr>::const_iterator hit;
+        if ((hit = node->_children.find(http->_dvec[i])) == node->_children.end())
+          break;
+        node = (*hit).second;
+        for (vit=node->_sub.begin(); vit!=node->_sub.end(); ++vit)
+          URL_MATCHER_TEST((*vit),true);
+        if (i == 0)
+          {
+            for (vit=node->_exact.begin(); vit!=node->_exact.end(); ++vit)
+              URL_MATCHER_TEST((*vit),true);
+          }
+      }
+#endif
+
+    // literal path prefixes.
+    uint32_t n = 0;
+    for (size_t i=0; i<lpath.length(); i++)
+      {
+        std::map<unsigned char,uint32_t>::const_iterator mit
+        = _prefixes[n]._next.find((unsigned char)lp[i]);
+        if (mit == _prefixes[n]._next.end())
+          break;
+        n = (*mit).second;
+        for (vit=_prefixes[n]._entries.begin(); vit!=_prefixes[n]._entries.end(); ++vit)
+          URL_MATCHER_TEST((*vit),true);
+      }
+
+    // required path literals.
+    if (_ac.size() > 1)
+      {
+        n = 0;
+        for (size_t i=0; i<lpath.length(); i++)
+          {
+            unsigned char c = (unsigned char)lp[i];
+            std::map<unsigned char,uint32_t>::const_iterator mit;
+            while (n != 0 && (mit = _ac[n]._next.find(c)) == _ac[n]._next.end())
+              n = _ac[n]._fail;
+            if ((mit = _ac[n]._next.find(c)) != _ac[n]._next.end())
+              n = (*mit).second;
+            uint32_t d = _ac[n]._entries.empty() ? _ac[n]._dict : n;
+            while (d != 0)
+              {
+                for (vit=_ac[d]._entries.begin(); vit!=_ac[d]._entries.end(); ++vit)
+                  URL_MATCHER_TEST((*vit),true);
+                d = _ac[d]._dict;
+              }
+          }
+      }
+
+    // one by one.
+    for (vit=_fallback.begin(); vit!=_fallback.end(); ++vit)
+      URL_MATCHER_TEST((*vit),false);
+
+#undef URL_MATCHER_TEST
+
+    return found;
+  }
+
+} /* end of namespace. */
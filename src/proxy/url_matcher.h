@@ -0,0 +1,209 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera <ebenazer@seeks-project.info>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef URL_MATCHER_H
+#define URL_MATCHER_H
+
+#include "proxy_dts.h"
+#include "stl_hash.h"
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace sp
+{
+  /**
+   * \brief a URL pattern as seen by the matcher, with the outcome of
+   *        the analysis of its path regexp.
+   */
+  class url_matcher_entry
+  {
+    public:
+      url_matcher_entry(const url_spec *usp, const uint32_t &tag)
+        :_usp(usp),_tag(tag),_literal_only(false)
+      {};
+
+      ~url_matcher_entry() {};
+
+      const url_spec *_usp; /**< compiled pattern, not owned. */
+      uint32_t _tag; /**< tag reported when the pattern matches. */
+      std::string _literal; /**< lower-cased literal the path must contain, if any. */
+      bool _literal_only; /**< whether the path regexp is the plain literal prefix _literal. */
+  };
+
+  /**
+   * \brief node of the reversed-label domain trie, i.e. 'com' -> 'example' -> 'www'.
+   */
+  class url_matcher_domain_node
+  {
+    public:
+      url_matcher_domain_node() {};
+
+      ~url_matcher_domain_node();
+
+      hash_map<const char*,url_matcher_domain_node*,hash<const char*>,eqstr> _children; /**< sub-domains, keys are owned. */
+      std::vector<uint32_t> _exact; /**< entries for fully anchored domains ending at this node. */
+      std::vector<uint32_t> _sub; /**< entries for this domain and all of its sub-domains. */
+  };
+
+  /**
+   * \brief node of a character trie, used both for literal path prefixes
+   *        and for the Aho-Corasick automaton over path literals.
+   */
+  class url_matcher_trie_node
+  {
+    public:
+      url_matcher_trie_node()
+        :_fail(0),_dict(0)
+      {};
+
+      ~url_matcher_trie_node() {};
+
+      std::map<unsigned char,uint32_t> _next; /**< transitions. */
+      uint32_t _fail; /**< failure link (automaton only). */
+      uint32_t _dict; /**< next node with entries along failure links, 0 if none (automaton only). */
+      std::vector<uint32_t> _entries; /**< entries whose literal ends at this node. */
+  };
+
+  /**
+   * \brief compiled set of URL patterns, matched at once against a HTTP request.
+   *
+   *        Every pattern is indexed once, according to its host and path parts:
+   *        - plain domain patterns (e.g. 'example.com' or '.example.com') go into
+   *          a trie over reversed domain labels,
+   *        - host-less patterns whose path is a plain prefix go into a character trie,
+   *        - host-less patterns whose path regexp contains a required literal are
+   *          reached through an Aho-Corasick automaton over these literals,
+   *        - everything else (wildcards in hosts, extended host patterns, path regexps
+   *          without any literal) is checked one by one with urlmatch::url_match.
+   *
+   *        Regexps are only run on candidates, and matching is semantically
+   *        identical to testing every pattern with urlmatch::url_match.
+   *        Patterns are not owned, and the matcher is read-only once compiled,
+   *        so it can be used concurrently from several threads.
+   */
+  class url_matcher
+  {
+    public:
+      /**
+       * \brief constructor.
+       */
+      url_matcher();
+
+      /**
+       * \brief destructor.
+       */
+      ~url_matcher();
+
+      /**
+       * \brief adds a pattern to the matcher.
+       *        Tag patterns are ignored as they never match URLs.
+       * @param usp compiled pattern, must outlive the matcher.
+       * @param tag tag reported when the pattern matches.
+       */
+      void add_pattern(const url_spec *usp, const uint32_t &tag);
+
+      /**
+       * \brief adds a set of patterns, sharing the same tag.
+       */
+      void add_patterns(const std::vector<url_spec*> &patterns, const uint32_t &tag);
+
+      /**
+       * \brief builds the automaton, must be called after the last pattern
+       *        has been added and before any match.
+       */
+      void compile();
+
+      /**
+       * \brief removes all patterns.
+       */
+      void clear();
+
+      /**
+       * \brief matches a HTTP request against all patterns.
+       * @param http HTTP request.
+       * @param hits resized to the number of tags, hits[t] is set if at
+       *        least one pattern with tag t matches.
+       * @return true if at least one pattern matches.
+       */
+      bool match(const http_request *http, std::vector<bool> &hits) const;
+
+      /**
+       * \brief whether at least one pattern matches a HTTP request, returns
+       *        on the first match.
+       */
+      bool match_any(const http_request *http) const;
+
+      /**
+       * \brief number of indexed patterns.
+       */
+      size_t size() const
+      {
+        return _entries.size();
+      };
+
+      /**
+       * \brief number of tags, i.e. highest tag + 1.
+       */
+      uint32_t ntags() const
+      {
+        return _ntags;
+      };
+
+      /**
+       * \brief extracts a lower-cased literal from a left-anchored path regexp.
+       * @param path_pattern the path part of a URL pattern, starting with '/'.
+       * @param literal the literal prefix if the pattern is plain, the longest
+       *        literal any matching path must contain otherwise, empty if none.
+       * @return true if the pattern is the plain literal prefix.
+       */
+      static bool analyze_path_pattern(const char *path_pattern,
+                                       std::string &literal);
+
+    private:
+      url_matcher(const url_matcher &um); // not copyable.
+      url_matcher& operator=(const url_matcher &um);
+
+      bool match_tags(const http_request *http, std::vector<bool> &hits,
+                      const bool &first) const;
+
+      bool test_entry(const url_matcher_entry &e, const http_request *http,
+                      const char *lpath, const bool &host_checked) const;
+
+      uint32_t add_trie_literal(std::vector<url_matcher_trie_node> &trie,
+                                const std::string &literal);
+
+      void add_domain(const url_spec *usp, const uint32_t &e);
+
+    private:
+      std::vector<url_matcher_entry> _entries; /**< all indexed patterns. */
+      url_matcher_domain_node *_domains; /**< reversed-label domain trie. */
+      std::vector<uint32_t> _any; /**< host-less, path-less patterns. */
+      std::vector<url_matcher_trie_node> _prefixes; /**< host-less, literal path prefix patterns. */
+      std::vector<url_matcher_trie_node> _ac; /**< automaton over required path literals. */
+      std::vector<uint32_t> _fallback; /**< patterns checked one by one. */
+      uint32_t _ntags; /**< highest tag + 1. */
+      bool _compiled; /**< whether the automaton is up to date. */
+  };
+
+} /* end of namespace. */
+
+#endif
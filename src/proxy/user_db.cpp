@@ -66,6 +66,8 @@ namespace sp
                    const bool &large)
     :_opened(false),_rsc(rsc)
   {
+    mutex_init(&_iter_mutex);
+
     // create the db.
     if (local)
       {
@@ -147,6 +149,7 @@ namespace sp
   user_db::user_db(const std::string &dbname)
     :_opened(false)
   {
+    mutex_init(&_iter_mutex);
     _hdb = new db_obj_local();
     _hdb->dbsetmutex();
     static_cast<db_obj_local*>(_hdb)->dbtune(0,-1,-1,HDBTDEFLATE);
@@ -161,6 +164,7 @@ namespace sp
 
     // delete db object.
     delete _hdb;
+    mutex_destroy(&_iter_mutex);
   }
 
   db_err user_db::open_db()
@@ -332,8 +336,10 @@ namespace sp
     void *rkey = NULL;
     int rkey_size;
     std::vector<std::string> to_remove;
+    mutex_lock(&_iter_mutex);
     if (!_hdb->dbiterinit())
       {
+        mutex_unlock(&_iter_mutex);
         return DB_ERR_ITER;
       }
     while ((rkey = _hdb->dbiternext(&rkey_size)) != NULL)
@@ -351,6 +357,30 @@ namespace sp
             free(rkey);
           }
       }
+    mutex_unlock(&_iter_mutex);
+    return SP_ERR_OK;
+  }
+
+  db_err user_db::find_keys(const std::string &plugin_name,
+                            std::vector<std::string> &rkeys)
+  {
+    std::string prefix = user_db::generate_rkey("",plugin_name);
+    void *rkey = NULL;
+    int rkey_size;
+    mutex_lock(&_iter_mutex);
+    if (!_hdb->dbiterinit())
+      {
+        mutex_unlock(&_iter_mutex);
+        return DB_ERR_ITER;
+      }
+    while ((rkey = _hdb->dbiternext(&rkey_size)) != NULL)
+      {
+        if ((size_t)rkey_size >= prefix.size()
+            && memcmp(rkey,prefix.data(),prefix.size()) == 0)
+          rkeys.push_back(std::string((const char*)rkey,rkey_size));
+        free(rkey);
+      }
+    mutex_unlock(&_iter_mutex);
     return SP_ERR_OK;
   }
 
@@ -523,6 +553,7 @@ namespace sp
     void *rkey = NULL;
     int rkey_size;
     std::vector<std::string> to_remove;
+    mutex_lock(&_iter_mutex);
     _hdb->dbiterinit();
     while ((rkey = _hdb->dbiternext(&rkey_size)) != NULL)
       {
@@ -569,6 +600,7 @@ namespace sp
           }
         free(rkey);
       }
+    mutex_unlock(&_iter_mutex);
     int err = 0;
     size_t trs = to_remove.size();
     for (size_t i=0; i<trs; i++)
@@ -585,6 +617,7 @@ namespace sp
     void *rkey = NULL;
     int rkey_size;
     std::vector<std::string> to_remove;
+    mutex_lock(&_iter_mutex);
     _hdb->dbiterinit();
     while ((rkey = _hdb->dbiternext(&rkey_size)) != NULL)
       {
@@ -632,6 +665,7 @@ namespace sp
           }
         free(rkey);
       }
+    mutex_unlock(&_iter_mutex);
     int err = 0;
     size_t trs = to_remove.size();
     for (size_t i=0; i<trs; i++)
@@ -649,6 +683,7 @@ namespace sp
     void *rkey = NULL;
     int rkey_size;
     std::vector<std::string> to_remove;
+    mutex_lock(&_iter_mutex);
     _hdb->dbiterinit();
     while ((rkey = _hdb->dbiternext(&rkey_size)) != NULL)
       {
@@ -695,6 +730,7 @@ namespace sp
           }
         free(rkey);
       }
+    mutex_unlock(&_iter_mutex);
     int err = 0;
     size_t trs = to_remove.size();
     for (size_t i=0; i<trs; i++)
@@ -721,6 +757,7 @@ namespace sp
     uint64_t n = 0;
     void *rkey = NULL;
     int rkey_size;
+    mutex_lock(&_iter_mutex);
     _hdb->dbiterinit();
     while ((rkey = _hdb->dbiternext(&rkey_size)) != NULL)
       {
@@ -737,6 +774,7 @@ namespace sp
         else if (rec_pn == plugin_name)
           n++;
       }
+    mutex_unlock(&_iter_mutex);
     return n;
   }
 
@@ -775,6 +813,7 @@ namespace sp
     void *rkey = NULL;
     void *value = NULL;
     int rkey_size;
+    mutex_lock(&_iter_mutex);
     _hdb->dbiterinit();
     while ((rkey = _hdb->dbiternext(&rkey_size)) != NULL)
       {
@@ -833,6 +872,7 @@ namespace sp
           }
         free(rkey);
       }
+    mutex_unlock(&_iter_mutex);
 
     if (format == "json")
       {
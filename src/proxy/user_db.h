@@ -23,6 +23,7 @@
 #include "db_record.h"
 #include "sweeper.h"
 #include "db_obj.h"
+#include "mutexes.h"
 
 #include <vector>
 #include <ostream>
@@ -156,6 +157,14 @@ namespace sp
                         const std::string &plugin_name,
                         std::vector<std::string> &matching_rkeys);
 
+      /**
+       * \brief finds the internal keys of the records of plugin plugin_name,
+       *        in a single walk over the keys only.
+       * @return SP_ERR_OK if no error, DB_ERR_ITER otherwise.
+       */
+      db_err find_keys(const std::string &plugin_name,
+                       std::vector<std::string> &rkeys);
+
       /**
        * \brief finds a record based on its key.
        * @param key is the record key.
@@ -263,11 +272,26 @@ namespace sp
       db_record *find_dbr_rsc_sn(const std::string &key,
                                  const std::string &plugin_name);
 
+      /**
+       * \brief remote resource type ("", tt or sn).
+       */
+      const std::string& get_rsc() const
+      {
+        return _rsc;
+      };
+
     public:
       db_obj *_hdb; /**< local or remote Tokyo Cabinet hashtable db. */
       bool _opened; /**< whether the db is opened. */
       std::vector<user_db_sweepable*> _db_sweepers;
 
+      /**
+       * Serializes the walks over the records: the db handle has a single
+       * iterator, that every walk resets. Held as well by the writes that
+       * must not run in the middle of a walk.
+       */
+      mutable sp_mutex_t _iter_mutex;
+
       static std::string _db_version_key; /**< db version record key. */
       static double _db_version; /**< db record structure version. */
 
@@ -18,10 +18,13 @@
 
 #include "user_db_fix.h"
 #include "user_db.h"
+#include "user_db_maintenance.h"
 #include "plugin_manager.h"
 #include "plugin.h"
 #include "db_query_record.h"
+#include "title_resolver.h"
 using seeks_plugins::db_query_record;
+using seeks_plugins::title_resolver;
 
 #include "errlog.h"
 #include "db_obj.h"
@@ -44,6 +47,150 @@ using seeks_plugins::db_query_record;
 namespace sp
 {
 
+  /**
+   * \brief fix 263, as a maintenance job over the records of 'query_capture'.
+   */
+  class udb_fix_263 : public user_db_maintenance
+  {
+    public:
+      udb_fix_263(user_db *udb)
+        :user_db_maintenance(udb,"query-capture")
+      {};
+
+      virtual bool select(const db_record *dbr) const
+      {
+        return false;
+      };
+
+      virtual uint32_t fix(db_record *dbr, std::string &key) const
+      {
+        db_query_record *dqr = dynamic_cast<db_query_record*>(dbr);
+        if (!dqr)
+          return 0;
+        return dqr->fix_issue_263() != 0 ? 1 : 0;
+      };
+  };
+
+  /**
+   * \brief fix 281, as a maintenance job over the records of 'query_capture'.
+   */
+  class udb_fix_281 : public user_db_maintenance
+  {
+    public:
+      udb_fix_281(user_db *udb)
+        :user_db_maintenance(udb,"query-capture"),_furls(0)
+      {
+        mutex_init(&_furls_mutex);
+      };
+
+      virtual ~udb_fix_281()
+      {
+        mutex_destroy(&_furls_mutex);
+      };
+
+      virtual bool select(const db_record *dbr) const
+      {
+        return false;
+      };
+
+      virtual uint32_t fix(db_record *dbr, std::string &key) const
+      {
+        db_query_record *dqr = dynamic_cast<db_query_record*>(dbr);
+        if (!dqr)
+          return 0;
+        uint32_t fu = 0;
+        int f = dqr->fix_issue_281(fu);
+        mutex_lock(&_furls_mutex);
+        _furls += fu;
+        mutex_unlock(&_furls_mutex);
+        return f;
+      };
+
+      mutable sp_mutex_t _furls_mutex;
+      mutable uint32_t _furls; /**< fixed urls, from the decoding workers. */
+  };
+
+  /**
+   * \brief fix 154, as a maintenance job over the records of 'query_capture'.
+   */
+  class udb_fix_154 : public user_db_maintenance
+  {
+    public:
+      udb_fix_154(user_db *udb)
+        :user_db_maintenance(udb,"query-capture"),
+         _furls(0),_rurls(0),_fque(0),_ffque(0)
+      {
+        mutex_init(&_counters_mutex);
+      };
+
+      virtual ~udb_fix_154()
+      {
+        mutex_destroy(&_counters_mutex);
+      };
+
+      virtual bool select(const db_record *dbr) const
+      {
+        return false;
+      };
+
+      virtual uint32_t fix(db_record *dbr, std::string &key) const
+      {
+        db_query_record *dqr = dynamic_cast<db_query_record*>(dbr);
+        if (!dqr)
+          return 0;
+        uint32_t fu = 0;
+        uint32_t fq = 0;
+        uint32_t ru = 0;
+        int f = dqr->fix_issue_154(fu,fq,ru);
+        if (f == 0 && fu == 0)
+          return 0;
+        if (dqr->_related_queries.empty())
+          key.clear(); // record is removed.
+        mutex_lock(&_counters_mutex);
+        _furls += fu;
+        _rurls += ru;
+        _fque += f;
+        _ffque += fq;
+        mutex_unlock(&_counters_mutex);
+        return 1;
+      };
+
+      /* counters, from the decoding workers. */
+      mutable sp_mutex_t _counters_mutex;
+      mutable uint32_t _furls;
+      mutable uint32_t _rurls;
+      mutable uint32_t _fque;
+      mutable uint32_t _ffque;
+  };
+
+  /**
+   * \brief fix 575, as a maintenance job over the records of 'query_capture'.
+   */
+  class udb_fix_575 : public user_db_maintenance
+  {
+    public:
+      udb_fix_575(user_db *udb)
+        :user_db_maintenance(udb,"query-capture")
+      {};
+
+      virtual bool select(const db_record *dbr) const
+      {
+        return false;
+      };
+
+      virtual uint32_t fix(db_record *dbr, std::string &key) const
+      {
+        db_query_record *dqr = dynamic_cast<db_query_record*>(dbr);
+        if (!dqr)
+          return 0;
+        uint32_t fq = 0;
+        std::string nkey = dqr->fix_issue_575(fq);
+        if (fq > 0 && !nkey.empty())
+          key = nkey;
+        return fq;
+      };
+  };
+
   int user_db_fix::fix_issue_169()
   {
     /**
@@ -77,6 +224,7 @@ namespace sp
     void *rkey = NULL;
     void *value = NULL;
     int rkey_size;
+    mutex_lock(&udb._iter_mutex);
     udb._hdb->dbiterinit();
     while ((rkey = udb._hdb->dbiternext(&rkey_size)) != NULL)
       {
@@ -128,6 +276,7 @@ namespace sp
           }
         free(rkey);
       }
+    mutex_unlock(&udb._iter_mutex);
 
     // check that we have at least the same number of records in both db.
     bool replace = false;
@@ -162,72 +311,15 @@ namespace sp
         return -1;
       }
 
-    // traverse records.
-    size_t frec = 0;
-    std::map<std::string,db_record*> to_add;
-    void *rkey = NULL;
-    int rkey_size;
-    std::vector<std::string> to_remove;
-    udb._hdb->dbiterinit();
-    while ((rkey = udb._hdb->dbiternext(&rkey_size)) != NULL)
-      {
-        int value_size;
-        void *value = udb._hdb->dbget(rkey, rkey_size, &value_size);
-        if (value)
-          {
-            std::string str = std::string((char*)value,value_size);
-            free(value);
-            std::string key, plugin_name;
-            std::string rkey_str = std::string((char*)rkey);
-            if (rkey_str != user_db::_db_version_key
-                && user_db::extract_plugin_and_key(rkey_str,
-                                                   plugin_name,key) != 0)
-              {
-                errlog::log_error(LOG_LEVEL_ERROR,"Fix 263: could not extract record plugin and key from internal user db key");
-              }
-            else if (plugin_name != "query-capture")
-              {
-              }
-            else if (rkey_str != user_db::_db_version_key)
-              {
-                // get a proper object based on plugin name, and call the virtual function for reading the record.
-                plugin *pl = plugin_manager::get_plugin(plugin_name);
-                db_record *dbr = NULL;
-                if (!pl)
-                  {
-                    // handle error.
-                    errlog::log_error(LOG_LEVEL_ERROR,"Fix 263: could not find plugin %s for pruning user db record",
-                                      plugin_name.c_str());
-                    dbr = new db_record();
-                  }
-                else
-                  {
-                    dbr = pl->create_db_record();
-                  }
-
-                if (dbr->deserialize(str) != 0)
-                  {
-                    // deserialization error.
-                  }
-                else
-                  {
-                    int f = static_cast<db_query_record*>(dbr)->fix_issue_263();
-
-                    if (f != 0)
-                      {
-                        frec++;
-                        udb.remove_dbr(rkey_str);
-                        udb.add_dbr(key,*dbr);
-                      }
-                  }
-                delete dbr;
-              }
-          }
-        free(rkey);
-      }
+    // records are fixed in chunks, from the keys read beforehand.
+    udb_fix_263 job(&udb);
+    job.set_limits(1000,2,0);
+    err = job.run();
+    udb_maintenance_stats stats;
+    job.get_stats(stats);
 
     udb.close_db();
-    errlog::log_error(LOG_LEVEL_INFO,"Fix 263: fixed %u records in user db",frec);
+    errlog::log_error(LOG_LEVEL_INFO,"Fix 263: fixed %u records in user db",(uint32_t)stats._fixed);
     return err;
   }
 
@@ -242,78 +334,16 @@ namespace sp
         return -1;
       }
 
-    // traverse records.
-    size_t frec = 0;
-    size_t fque = 0;
-    uint32_t furls = 0;
-    std::map<std::string,db_record*> to_add;
-    void *rkey = NULL;
-    int rkey_size;
-    std::vector<std::string> to_remove;
-    udb._hdb->dbiterinit();
-    while ((rkey = udb._hdb->dbiternext(&rkey_size)) != NULL)
-      {
-        int value_size;
-        void *value = udb._hdb->dbget(rkey, rkey_size, &value_size);
-        if (value)
-          {
-            std::string str = std::string((char*)value,value_size);
-            free(value);
-            std::string key, plugin_name;
-            std::string rkey_str = std::string((char*)rkey);
-            if (rkey_str != user_db::_db_version_key
-                && user_db::extract_plugin_and_key(rkey_str,
-                                                   plugin_name,key) != 0)
-              {
-                errlog::log_error(LOG_LEVEL_ERROR,"Fix 281: could not extract record plugin and key from internal user db key");
-              }
-            else if (plugin_name != "query-capture")
-              {
-              }
-            else if (rkey_str != user_db::_db_version_key)
-              {
-                // get a proper object based on plugin name, and call the virtual function for reading the record.
-                plugin *pl = plugin_manager::get_plugin(plugin_name);
-                db_record *dbr = NULL;
-                if (!pl)
-                  {
-                    // handle error.
-                    errlog::log_error(LOG_LEVEL_ERROR,"Fix 281: could not find plugin %s for pruning user db record",
-                                      plugin_name.c_str());
-                    dbr = new db_record();
-                  }
-                else
-                  {
-                    dbr = pl->create_db_record();
-                  }
-
-                if (dbr->deserialize(str) != 0)
-                  {
-                    // deserialization error.
-                  }
-                else
-                  {
-                    uint32_t fu = 0;
-                    int f = static_cast<db_query_record*>(dbr)->fix_issue_281(fu);
-
-                    if (f != 0)
-                      {
-                        furls += fu;
-                        fque += f;
-                        frec++;
-                        udb.remove_dbr(rkey_str);
-                        udb.add_dbr(key,*dbr);
-                      }
-                  }
-                delete dbr;
-              }
-          }
-        free(rkey);
-      }
+    // records are fixed in chunks, from the keys read beforehand.
+    udb_fix_281 job(&udb);
+    job.set_limits(1000,2,0);
+    err = job.run();
+    udb_maintenance_stats stats;
+    job.get_stats(stats);
 
     udb.close_db();
     errlog::log_error(LOG_LEVEL_INFO,"Fix 281: fixed %u records in user db, %u queries fixed, %u urls fixed",
-                      frec,fque,furls);
+                      (uint32_t)stats._fixed,(uint32_t)stats._fixes,job._furls);
     return err;
   }
 
@@ -361,85 +391,16 @@ namespace sp
 
     errlog::log_error(LOG_LEVEL_INFO, "Applying fix 154 to user db");
 
-    // traverse records.
-    uint32_t furls = 0;
-    uint32_t rurls = 0;
-    size_t frec = 0;
-    size_t fque = 0;
-    size_t ffque = 0;
-    std::map<std::string,db_record*> to_add;
-    void *rkey = NULL;
-    int rkey_size;
-    std::vector<std::string> to_remove;
-    udb._hdb->dbiterinit();
-    while ((rkey = udb._hdb->dbiternext(&rkey_size)) != NULL)
-      {
-        int value_size;
-        void *value = udb._hdb->dbget(rkey, rkey_size, &value_size);
-        if (value)
-          {
-            std::string str = std::string((char*)value,value_size);
-            free(value);
-            std::string key, plugin_name;
-            std::string rkey_str = std::string((char*)rkey);
-            if (rkey_str != user_db::_db_version_key
-                && user_db::extract_plugin_and_key(rkey_str,
-                                                   plugin_name,key) != 0)
-              {
-                errlog::log_error(LOG_LEVEL_ERROR,"Fix 154: could not extract record plugin and key from internal user db key");
-              }
-            else if (plugin_name != "query-capture")
-              {
-              }
-            else if (rkey_str != user_db::_db_version_key)
-              {
-                // get a proper object based on plugin name, and call the virtual function for reading the record.
-                plugin *pl = plugin_manager::get_plugin(plugin_name);
-                db_record *dbr = NULL;
-                if (!pl)
-                  {
-                    // handle error.
-                    errlog::log_error(LOG_LEVEL_ERROR,"Fix 154: could not find plugin %s for pruning user db record",
-                                      plugin_name.c_str());
-                    dbr = new db_record();
-                  }
-                else
-                  {
-                    dbr = pl->create_db_record();
-                  }
-
-                if (dbr->deserialize(str) != 0)
-                  {
-                    // deserialization error.
-                  }
-                else
-                  {
-                    uint32_t fu = 0;
-                    uint32_t fq = 0;
-                    uint32_t ru = 0;
-                    int f = static_cast<db_query_record*>(dbr)->fix_issue_154(fu,fq,ru);
-
-                    if (f != 0 || fu != 0)
-                      {
-                        ffque += fq;
-                        furls += fu;
-                        rurls += ru;
-                        fque += f;
-                        frec++;
-                        udb.remove_dbr(rkey_str);
-                        if (!static_cast<db_query_record*>(dbr)->_related_queries.empty())
-                          udb.add_dbr(key,*dbr);
-                      }
-                  }
-                delete dbr;
-              }
-          }
-        free(rkey);
-      }
+    // records are fixed in chunks, from the keys read beforehand.
+    udb_fix_154 job(&udb);
+    job.set_limits(1000,2,0);
+    err = job.run();
+    udb_maintenance_stats stats;
+    job.get_stats(stats);
 
     udb.close_db();
     errlog::log_error(LOG_LEVEL_INFO,"Fix 154: fixed %u records in user db, dumped %u queries, dumped %u urls, fixed %u urls in %u queries",
-                      frec,fque,furls,rurls,ffque);
+                      (uint32_t)stats._fixed,job._fque,job._furls,job._rurls,job._ffque);
     return err;
   }
 
@@ -455,12 +416,17 @@ namespace sp
         return -1;
       }
 
+    // titles are shared across records, the same headers are sent along every request.
+    title_resolver tr(timeout);
+    const std::list<const char*> *lheaders = (headers && !headers->empty()) ? headers->at(0) : NULL;
+
     // traverse records.
     uint32_t furls = 0;
     std::map<std::string,db_record*> to_add;
     void *rkey = NULL;
     int rkey_size;
     std::vector<std::string> to_remove;
+    mutex_lock(&udb._iter_mutex);
     udb._hdb->dbiterinit();
     while ((rkey = udb._hdb->dbiternext(&rkey_size)) != NULL)
       {
@@ -505,7 +471,7 @@ namespace sp
                 else
                   {
                     uint32_t fu = 0;
-                    static_cast<db_query_record*>(dbr)->fetch_url_titles(fu,timeout,headers);
+                    static_cast<db_query_record*>(dbr)->fetch_url_titles(fu,tr,lheaders);
                     if (fu > 0)
                       {
                         furls += fu;
@@ -518,9 +484,11 @@ namespace sp
           }
         free(rkey);
       }
+    mutex_unlock(&udb._iter_mutex);
 
     udb.close_db();
-    errlog::log_error(LOG_LEVEL_INFO,"Filling up url titles: %u urls fetched",furls);
+    errlog::log_error(LOG_LEVEL_INFO,"Filling up url titles: %u urls fetched, %lu pages downloaded, %lu titles from cache",
+                      furls,tr._fetched,tr._hits);
     return err;
   }
 
@@ -552,6 +520,7 @@ namespace sp
     uint32_t rmer = 0;
     void *rkey = NULL;
     int rkey_size;
+    mutex_lock(&udbm._iter_mutex);
     udbm._hdb->dbiterinit();
     while ((rkey = udbm._hdb->dbiternext(&rkey_size)) != NULL)
       {
@@ -610,6 +579,7 @@ namespace sp
           }
         free(rkey);
       }
+    mutex_unlock(&udbm._iter_mutex);
     udb->close_db();
     udbm.close_db();
     errlog::log_error(LOG_LEVEL_INFO,"merged %u records", rmer);
@@ -662,80 +632,16 @@ namespace sp
 
     errlog::log_error(LOG_LEVEL_INFO, "Applying fix 575 to user db");
 
-    // traverse records.
-    size_t frec = 0;
-    size_t fque = 0;
-    size_t ffque = 0;
-    std::map<std::string,db_record*> to_add;
-    void *rkey = NULL;
-    int rkey_size;
-    std::vector<std::string> to_remove;
-    udb._hdb->dbiterinit();
-    while ((rkey = udb._hdb->dbiternext(&rkey_size)) != NULL)
-      {
-        int value_size;
-        void *value = udb._hdb->dbget(rkey, rkey_size, &value_size);
-        if (value)
-          {
-            std::string str = std::string((char*)value,value_size);
-            free(value);
-            std::string key, plugin_name;
-            std::string rkey_str = std::string((char*)rkey);
-            if (rkey_str != user_db::_db_version_key
-                && user_db::extract_plugin_and_key(rkey_str,
-                                                   plugin_name,key) != 0)
-              {
-                errlog::log_error(LOG_LEVEL_ERROR,"Fix 575: could not extract record plugin and key from internal user db key");
-              }
-            else if (plugin_name != "query-capture")
-              {
-              }
-            else if (rkey_str != user_db::_db_version_key)
-              {
-                // get a proper object based on plugin name, and call the virtual function for reading the record.
-                plugin *pl = plugin_manager::get_plugin(plugin_name);
-                db_record *dbr = NULL;
-                if (!pl)
-                  {
-                    // handle error.
-                    errlog::log_error(LOG_LEVEL_ERROR,"Fix 575: could not find plugin %s for pruning user db record",
-                                      plugin_name.c_str());
-                    dbr = new db_record();
-                  }
-                else
-                  {
-                    dbr = pl->create_db_record();
-                  }
-
-                if (dbr->deserialize(str) != 0)
-                  {
-                    // deserialization error.
-                  }
-                else
-                  {
-                    uint32_t fq = 0;
-                    std::string nkey = static_cast<db_query_record*>(dbr)->fix_issue_575(fq);
-                    if (nkey.empty())
-                      nkey = key;
-
-                    if (fq>0)
-                      {
-                        ffque += fq;
-                        fque++;
-                        frec++;
-                        udb.remove_dbr(rkey_str);
-                        udb.add_dbr(nkey,*dbr);
-                      }
-                  }
-                delete dbr;
-              }
-          }
-        free(rkey);
-      }
+    // records are fixed in chunks, from the keys read beforehand.
+    udb_fix_575 job(&udb);
+    job.set_limits(1000,2,0);
+    err = job.run();
+    udb_maintenance_stats stats;
+    job.get_stats(stats);
 
     udb.close_db();
-    errlog::log_error(LOG_LEVEL_INFO,"Fix 5775: fixed %u records in user db, dumped %u queries, fixed %u queries",
-                      frec,fque,ffque);
+    errlog::log_error(LOG_LEVEL_INFO,"Fix 575: fixed %u records in user db, fixed %u queries",
+                      (uint32_t)stats._fixed,(uint32_t)stats._fixes);
     return err;
   }
 
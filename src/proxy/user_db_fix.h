@@ -53,7 +53,8 @@ namespace sp
       static int fix_issue_154();
 
       /**
-       * \brief fill up uri titles.
+       * \brief fill up uri titles. Only the first list of headers is used,
+       *        for every request.
        */
       static int fill_up_uri_titles(const long &timeout,
                                     const std::vector<std::list<const char*>*> *headers);
@@ -0,0 +1,466 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "user_db_maintenance.h"
+#include "thread_pool.h"
+#include "seeks_proxy.h"
+#include "proxy_configuration.h"
+#include "plugin_manager.h"
+#include "plugin.h"
+#include "errlog.h"
+
+#include <sys/time.h>
+#include <errno.h>
+#include <algorithm>
+
+namespace sp
+{
+  /**
+   * \brief a record read from the db, and what is to be done with it.
+   */
+  class udb_maintenance_record
+  {
+    public:
+      udb_maintenance_record(const std::string &rkey, const std::string &value)
+        :_rkey(rkey),_value(value),_remove(false),_error(false),_fixes(0),_dbr(NULL)
+      {};
+
+      ~udb_maintenance_record()
+      {
+        delete _dbr;
+      };
+
+      std::string _rkey;
+      std::string _value;
+      bool _remove;
+      bool _error; /**< set when the record could not be deserialized. */
+      uint32_t _fixes; /**< fixes applied to the record. */
+      std::string _key; /**< key under which the fixed record is to be written. */
+      db_record *_dbr; /**< fixed record. */
+  };
+
+  /**
+   * \brief a slice of a chunk, deserialized by one worker.
+   */
+  class udb_decode_task
+  {
+    public:
+      udb_decode_task(user_db_maintenance *udm,
+                      std::vector<udb_maintenance_record*> *chunk,
+                      const size_t &begin, const size_t &end)
+        :_udm(udm),_chunk(chunk),_begin(begin),_end(end)
+      {};
+
+      ~udb_decode_task() {};
+
+      user_db_maintenance *_udm;
+      std::vector<udb_maintenance_record*> *_chunk;
+      size_t _begin;
+      size_t _end;
+  };
+
+  sp_mutex_t user_db_maintenance::_jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+  sp_cond_t user_db_maintenance::_jobs_cond = PTHREAD_COND_INITIALIZER;
+  bool user_db_maintenance::_job_running = false;
+
+  static double elapsed(const struct timeval &t1, const struct timeval &t2)
+  {
+    return (t2.tv_sec - t1.tv_sec) * 1000.0 + (t2.tv_usec - t1.tv_usec) / 1000.0;
+  }
+
+  static void deadline(const int &ms, struct timespec &ts)
+  {
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    ts.tv_sec = tv.tv_sec + ms / 1000;
+    ts.tv_nsec = tv.tv_usec * 1000 + (ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000)
+      {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+      }
+  }
+
+  user_db_maintenance::user_db_maintenance(user_db *udb,
+      const std::string &plugin_name,
+      const time_t &date)
+    :_udb(udb),_plugin_name(plugin_name),_date(date),
+     _chunk_size(1000),_nworkers(2),_pause(20),_started(false),_err(SP_ERR_OK)
+  {
+    mutex_init(&_mutex);
+    cond_init(&_cond);
+  }
+
+  user_db_maintenance::~user_db_maintenance()
+  {
+    cancel();
+    wait();
+    mutex_destroy(&_mutex);
+    pthread_cond_destroy(&_cond);
+  }
+
+  void user_db_maintenance::set_limits(const size_t &chunk_size,
+                                       const size_t &nworkers,
+                                       const int &pause)
+  {
+    _chunk_size = chunk_size > 0 ? chunk_size : 1;
+    _nworkers = nworkers > 0 ? nworkers : 1;
+    _pause = pause >= 0 ? pause : 0;
+  }
+
+  void user_db_maintenance::set_limits_from_config()
+  {
+    set_limits(seeks_proxy::_config->_user_db_maintenance_chunk,
+               seeks_proxy::_config->_user_db_maintenance_workers,
+               seeks_proxy::_config->_user_db_maintenance_pause);
+  }
+
+  sp_err user_db_maintenance::start()
+  {
+    int err = pthread_create(&_thread,NULL,&user_db_maintenance::run_job,this);
+    if (err != 0)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"Error creating thread for user db maintenance: %d",err);
+        return SP_ERR_MEMORY;
+      }
+    _started = true;
+    return SP_ERR_OK;
+  }
+
+  void* user_db_maintenance::run_job(void *arg)
+  {
+    user_db_maintenance *udm = static_cast<user_db_maintenance*>(arg);
+    udm->run();
+    return NULL;
+  }
+
+  db_err user_db_maintenance::run()
+  {
+    struct timeval start,now;
+    gettimeofday(&start,NULL);
+    if (!acquire_turn())
+      {
+        mutex_lock(&_mutex);
+        _stats._done = true;
+        mutex_unlock(&_mutex);
+        return SP_ERR_OK;
+      }
+
+    // the keys are read in a single walk, the job then works on its own list
+    // and leaves the iterator of the db to others.
+    std::vector<std::string> rkeys;
+    int err = _udb->find_keys(_plugin_name,rkeys);
+    if (err != SP_ERR_OK)
+      errlog::log_error(LOG_LEVEL_ERROR,"Could not read the keys of plugin %s for user db maintenance",
+                        _plugin_name.c_str());
+    mutex_lock(&_mutex);
+    _stats._total = rkeys.size();
+    mutex_unlock(&_mutex);
+
+    plugin *pl = plugin_manager::get_plugin(_plugin_name);
+    thread_pool *pool = NULL;
+    if (_nworkers > 1 && !rkeys.empty())
+      pool = new thread_pool(_nworkers);
+
+    std::vector<udb_maintenance_record*> chunk;
+    size_t next = 0;
+    while (next < rkeys.size() && wait_turn(_stats._chunks > 0))
+      {
+        uint64_t scanned = 0;
+        read_chunk(rkeys,next,chunk,scanned);
+        decode_chunk(chunk,pool);
+
+        // writes, in a batch that no walk over the db sees half done. Each
+        // record is read again right before it is written, as an earlier write
+        // of the chunk, or a request, may have merged into it since it was
+        // decoded.
+        uint64_t decoded = chunk.size(), removed = 0, fixed = 0, fixes = 0, errors = 0;
+        mutex_lock(&_udb->_iter_mutex);
+        for (size_t i=0; i<chunk.size(); i++)
+          {
+            udb_maintenance_record *umr = chunk.at(i);
+            db_err werr = SP_ERR_OK;
+            if (!umr->_error && (umr->_remove || umr->_fixes > 0)
+                && !reread(umr,pl))
+              ; // removed meanwhile.
+            else if (umr->_error)
+              errors++;
+            else if (umr->_remove)
+              {
+                werr = _udb->remove_dbr(umr->_rkey);
+                if (werr == SP_ERR_OK)
+                  removed++;
+              }
+            else if (umr->_fixes > 0)
+              {
+                werr = _udb->remove_dbr(umr->_rkey);
+                if (werr == SP_ERR_OK && !umr->_key.empty())
+                  werr = _udb->add_dbr(umr->_key,*umr->_dbr);
+                if (werr == SP_ERR_OK)
+                  {
+                    fixed++;
+                    fixes += umr->_fixes;
+                  }
+              }
+            if (werr != SP_ERR_OK)
+              {
+                errors++;
+                err += werr;
+              }
+            delete umr;
+          }
+        mutex_unlock(&_udb->_iter_mutex);
+        chunk.clear();
+
+        gettimeofday(&now,NULL);
+        mutex_lock(&_mutex);
+        _stats._scanned += scanned;
+        _stats._decoded += decoded;
+        _stats._removed += removed;
+        _stats._fixed += fixed;
+        _stats._fixes += fixes;
+        _stats._errors += errors;
+        _stats._chunks++;
+        _stats._elapsed = elapsed(start,now);
+        if (_stats._chunks % 100 == 0)
+          errlog::log_error(LOG_LEVEL_INFO,"user db maintenance for plugin %s: %u/%u records scanned, %u removed, %u fixed",
+                            _plugin_name.c_str(),(uint32_t)_stats._scanned,(uint32_t)_stats._total,
+                            (uint32_t)_stats._removed,(uint32_t)_stats._fixed);
+        mutex_unlock(&_mutex);
+      }
+    delete pool;
+    release_turn();
+
+    gettimeofday(&now,NULL);
+    mutex_lock(&_mutex);
+    _stats._elapsed = elapsed(start,now);
+    _stats._done = true;
+    errlog::log_error(LOG_LEVEL_INFO,"User db maintenance for plugin %s: %u records removed, %u fixed, in %u chunks and %d ms%s",
+                      _plugin_name.c_str(),(uint32_t)_stats._removed,(uint32_t)_stats._fixed,
+                      (uint32_t)_stats._chunks,(int)_stats._elapsed,_stats._cancelled ? " (cancelled)" : "");
+    mutex_unlock(&_mutex);
+
+    if (err >= DB_ERR_UNKNOWN)
+      _err = DB_ERR_UNKNOWN;
+    else _err = err;
+    return _err;
+  }
+
+  bool user_db_maintenance::acquire_turn()
+  {
+    bool go = true;
+    mutex_lock(&_jobs_mutex);
+    while (_job_running)
+      {
+        mutex_lock(&_mutex);
+        go = !_stats._cancelled;
+        mutex_unlock(&_mutex);
+        if (!go)
+          break;
+
+        // cancel() does not signal this condition, it is checked periodically.
+        struct timespec ts;
+        deadline(100,ts);
+        pthread_cond_timedwait(&_jobs_cond,&_jobs_mutex,&ts);
+      }
+    if (go)
+      _job_running = true;
+    mutex_unlock(&_jobs_mutex);
+    return go;
+  }
+
+  void user_db_maintenance::release_turn()
+  {
+    mutex_lock(&_jobs_mutex);
+    _job_running = false;
+    cond_broadcast(&_jobs_cond);
+    mutex_unlock(&_jobs_mutex);
+  }
+
+  bool user_db_maintenance::wait_turn(const bool &throttle)
+  {
+    mutex_lock(&_mutex);
+    if (throttle && _pause > 0 && !_stats._cancelled)
+      {
+        struct timespec ts;
+        deadline(_pause,ts);
+        while (!_stats._cancelled
+               && pthread_cond_timedwait(&_cond,&_mutex,&ts) != ETIMEDOUT)
+          ;
+      }
+    while (_stats._paused && !_stats._cancelled)
+      cond_wait(&_cond,&_mutex);
+    bool go = !_stats._cancelled;
+    mutex_unlock(&_mutex);
+    return go;
+  }
+
+  void user_db_maintenance::read_chunk(const std::vector<std::string> &rkeys,
+                                       size_t &next,
+                                       std::vector<udb_maintenance_record*> &chunk,
+                                       uint64_t &scanned)
+  {
+    while (chunk.size() < _chunk_size && next < rkeys.size())
+      {
+        const std::string &rkey = rkeys.at(next++);
+        scanned++;
+        int value_size;
+        void *value = _udb->_hdb->dbget(rkey.data(),rkey.size(),&value_size);
+        if (value) // records removed since the keys were read are skipped.
+          {
+            chunk.push_back(new udb_maintenance_record(rkey,std::string((char*)value,value_size)));
+            free(value);
+          }
+      }
+  }
+
+  void user_db_maintenance::decode_chunk(std::vector<udb_maintenance_record*> &chunk,
+                                         thread_pool *pool)
+  {
+    if (chunk.empty())
+      return;
+    size_t nslices = std::min(_nworkers,chunk.size());
+    size_t slice = (chunk.size() + nslices - 1) / nslices;
+    std::vector<udb_decode_task*> tasks;
+    for (size_t b=0; b<chunk.size(); b+=slice)
+      tasks.push_back(new udb_decode_task(this,&chunk,b,std::min(b+slice,chunk.size())));
+    task_group tg(pool);
+    for (size_t i=0; i<tasks.size(); i++)
+      tg.run(&user_db_maintenance::decode,tasks.at(i));
+    tg.wait();
+    for (size_t i=0; i<tasks.size(); i++)
+      delete tasks.at(i);
+  }
+
+  void* user_db_maintenance::decode(void *arg)
+  {
+    udb_decode_task *udt = static_cast<udb_decode_task*>(arg);
+    user_db_maintenance *udm = udt->_udm;
+    plugin *pl = plugin_manager::get_plugin(udm->_plugin_name);
+    for (size_t i=udt->_begin; i<udt->_end; i++)
+      udm->process(udt->_chunk->at(i),pl);
+    return NULL;
+  }
+
+  void user_db_maintenance::process(udb_maintenance_record *umr, plugin *pl) const
+  {
+    umr->_remove = false;
+    umr->_error = false;
+    umr->_fixes = 0;
+    umr->_key.clear();
+    delete umr->_dbr;
+    umr->_dbr = NULL;
+
+    // get a proper object based on plugin name, and call the virtual function for reading the record.
+    db_record *dbr = NULL;
+    if (!pl)
+      dbr = new db_record();
+    else dbr = pl->create_db_record();
+    if (dbr->deserialize(umr->_value) != 0)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"Failed deserializing record %s",umr->_rkey.c_str());
+        umr->_error = true;
+      }
+    else if (!(umr->_remove = select(dbr)))
+      {
+        umr->_key = user_db::extract_key(umr->_rkey);
+        umr->_fixes = fix(dbr,umr->_key);
+        if (umr->_fixes > 0)
+          {
+            umr->_dbr = dbr; // written back by the job.
+            dbr = NULL;
+          }
+      }
+    delete dbr;
+  }
+
+  bool user_db_maintenance::reread(udb_maintenance_record *umr, plugin *pl)
+  {
+    int value_size;
+    void *value = _udb->_hdb->dbget(umr->_rkey.data(),umr->_rkey.size(),&value_size);
+    if (!value)
+      return false;
+    std::string fresh((char*)value,value_size);
+    free(value);
+    if (fresh != umr->_value)
+      {
+        umr->_value.swap(fresh);
+        process(umr,pl);
+      }
+    return true;
+  }
+
+  bool user_db_maintenance::select(const db_record *dbr) const
+  {
+    return dbr->_plugin_name == _plugin_name
+           && (_date == 0 || dbr->_creation_time < _date);
+  }
+
+  uint32_t user_db_maintenance::fix(db_record *dbr, std::string &key) const
+  {
+    return 0;
+  }
+
+  void user_db_maintenance::pause()
+  {
+    mutex_lock(&_mutex);
+    _stats._paused = true;
+    mutex_unlock(&_mutex);
+  }
+
+  void user_db_maintenance::resume()
+  {
+    mutex_lock(&_mutex);
+    _stats._paused = false;
+    cond_broadcast(&_cond);
+    mutex_unlock(&_mutex);
+  }
+
+  void user_db_maintenance::cancel()
+  {
+    mutex_lock(&_mutex);
+    _stats._cancelled = true;
+    cond_broadcast(&_cond);
+    mutex_unlock(&_mutex);
+  }
+
+  void user_db_maintenance::wait()
+  {
+    if (_started)
+      {
+        pthread_join(_thread,NULL);
+        _started = false;
+      }
+  }
+
+  bool user_db_maintenance::done()
+  {
+    mutex_lock(&_mutex);
+    bool d = _stats._done;
+    mutex_unlock(&_mutex);
+    return d;
+  }
+
+  void user_db_maintenance::get_stats(udb_maintenance_stats &stats)
+  {
+    mutex_lock(&_mutex);
+    stats = _stats;
+    mutex_unlock(&_mutex);
+  }
+
+} /* end of namespace. */
@@ -0,0 +1,228 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USER_DB_MAINTENANCE_H
+#define USER_DB_MAINTENANCE_H
+
+#include "user_db.h"
+#include "mutexes.h"
+
+#include <string>
+#include <vector>
+
+namespace sp
+{
+  class thread_pool;
+  class plugin;
+  class udb_maintenance_record;
+
+  /**
+   * \brief progress of a user db maintenance job.
+   */
+  class udb_maintenance_stats
+  {
+    public:
+      udb_maintenance_stats()
+        :_total(0),_scanned(0),_decoded(0),_removed(0),_fixed(0),_fixes(0),_errors(0),_chunks(0),
+         _elapsed(0.0),_paused(false),_cancelled(false),_done(false)
+      {};
+
+      ~udb_maintenance_stats() {};
+
+      uint64_t _total; /**< number of records of the plugin when the job started. */
+      uint64_t _scanned; /**< keys processed. */
+      uint64_t _decoded; /**< records still in the db when their chunk was read. */
+      uint64_t _removed; /**< records removed. */
+      uint64_t _fixed; /**< records rewritten. */
+      uint64_t _fixes; /**< fixes applied to the rewritten records. */
+      uint64_t _errors; /**< records that could not be deserialized or written. */
+      uint64_t _chunks; /**< chunks processed. */
+      double _elapsed; /**< running time, in milliseconds, pauses included. */
+      bool _paused;
+      bool _cancelled;
+      bool _done; /**< whether the job has returned. */
+  };
+
+  /**
+   * \brief removes, or fixes, the records of a plugin while the db keeps
+   *        serving queries.
+   *
+   *        The keys of the plugin are read first, in a single walk over the
+   *        db, so that the job does not hold the iterator of the db, which is
+   *        shared by every walk. Records are then read by key in chunks,
+   *        deserialized in parallel on a small pool of workers, and the
+   *        selected ones are removed, or the fixed ones rewritten, in a batch
+   *        under the iteration lock of the db, so that no walk sees a chunk
+   *        half written. Each record is read again right before it is
+   *        written, and processed again if it changed, so that merges into it
+   *        since the chunk was read are not lost. Records removed since the
+   *        keys were read are skipped.
+   *        The job sleeps between chunks, so that the db and processor time it
+   *        takes away from searches is bounded, and it can be paused, resumed
+   *        and cancelled between two chunks.
+   *
+   *        Jobs run one after the other: a job that is started while another
+   *        one runs waits for it to return.
+   */
+  class user_db_maintenance
+  {
+    public:
+      /**
+       * \brief date 0 selects all records of the plugin.
+       */
+      user_db_maintenance(user_db *udb,
+                          const std::string &plugin_name,
+                          const time_t &date=0);
+
+      /**
+       * \brief cancels the job and waits for it to return.
+       */
+      virtual ~user_db_maintenance();
+
+      /**
+       * \brief sets the number of records per chunk, the number of threads that
+       *        deserialize records, and the pause between chunks in milliseconds.
+       */
+      void set_limits(const size_t &chunk_size,
+                      const size_t &nworkers,
+                      const int &pause);
+
+      /**
+       * \brief sets the limits from the proxy configuration.
+       */
+      void set_limits_from_config();
+
+      /**
+       * \brief runs the job in a background thread.
+       * @return SP_ERR_OK if the thread was started, SP_ERR_MEMORY otherwise.
+       */
+      sp_err start();
+
+      /**
+       * \brief runs the job in the calling thread.
+       * @return SP_ERR_OK if no error, DB_ERR_ITER if the keys could not be
+       *         read, DB_ERR_UNKNOWN if some records could not be written.
+       */
+      db_err run();
+
+      void pause();
+
+      void resume();
+
+      /**
+       * \brief stops the job before the next chunk.
+       */
+      void cancel();
+
+      /**
+       * \brief waits for a job started in the background to return.
+       */
+      void wait();
+
+      /**
+       * \brief whether the job has returned.
+       */
+      bool done();
+
+      void get_stats(udb_maintenance_stats &stats);
+
+      /**
+       * \brief whether a deserialized record of the plugin is to be removed.
+       */
+      virtual bool select(const db_record *dbr) const;
+
+      /**
+       * \brief fixes a deserialized record of the plugin that is not removed,
+       *        and the key it is to be stored under.
+       *        Runs in the decoding workers, it must not touch the db.
+       *        A fixed record with an empty key is removed. It runs again on
+       *        the current record if the record changed before it was written.
+       * @return the number of fixes applied, 0 leaves the record as it is.
+       */
+      virtual uint32_t fix(db_record *dbr, std::string &key) const;
+
+    private:
+      user_db_maintenance(const user_db_maintenance &udm); // not copyable.
+      user_db_maintenance& operator=(const user_db_maintenance &udm);
+
+      /**
+       * \brief waits for the pause between chunks and while the job is paused.
+       * @return false if the job was cancelled.
+       */
+      bool wait_turn(const bool &throttle);
+
+      /**
+       * \brief waits for the job that runs to return.
+       * @return false if the job was cancelled meanwhile.
+       */
+      bool acquire_turn();
+
+      void release_turn();
+
+      /**
+       * \brief reads the records of the next keys.
+       */
+      void read_chunk(const std::vector<std::string> &rkeys,
+                      size_t &next,
+                      std::vector<udb_maintenance_record*> &chunk,
+                      uint64_t &scanned);
+
+      void decode_chunk(std::vector<udb_maintenance_record*> &chunk,
+                        thread_pool *pool);
+
+      /**
+       * \brief deserializes a record, and selects or fixes it.
+       */
+      void process(udb_maintenance_record *umr, plugin *pl) const;
+
+      /**
+       * \brief reads a record again before it is written, and processes it
+       *        again if it changed since it was read.
+       * @return false if the record is no longer in the db.
+       */
+      bool reread(udb_maintenance_record *umr, plugin *pl);
+
+      static void* run_job(void *arg);
+
+      static void* decode(void *arg);
+
+    public:
+      user_db *_udb;
+      std::string _plugin_name;
+      time_t _date;
+
+    private:
+      size_t _chunk_size;
+      size_t _nworkers;
+      int _pause;
+
+      pthread_t _thread;
+      bool _started; /**< whether the job runs in a background thread to be joined. */
+      sp_mutex_t _mutex;
+      sp_cond_t _cond; /**< signaled when the job is resumed or cancelled. */
+      udb_maintenance_stats _stats;
+      db_err _err;
+
+      static sp_mutex_t _jobs_mutex;
+      static sp_cond_t _jobs_cond; /**< signaled when a job returns. */
+      static bool _job_running;
+  };
+
+} /* end of namespace. */
+
+#endif
@@ -0,0 +1,552 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "user_db_snapshot.h"
+#include "thread_pool.h"
+#include "errlog.h"
+
+#include <sys/time.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef FEATURE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace sp
+{
+  /**
+   * \brief a block of records, encoded or loaded by one worker.
+   */
+  class udb_snapshot_block
+  {
+    public:
+      udb_snapshot_block(user_db_snapshot *uds)
+        :_uds(uds),_raw_len(0),_crc(0),_nrecords(0),_err(SP_ERR_OK)
+      {};
+
+      ~udb_snapshot_block() {};
+
+      user_db_snapshot *_uds;
+      std::string _raw; /**< records, on export. */
+      std::string _stored; /**< block as written on export, stored data on import. */
+      uint32_t _raw_len;
+      uint32_t _crc;
+      uint64_t _nrecords;
+      db_err _err;
+  };
+
+  const char user_db_snapshot::_magic[8] = { 'S','E','E','K','S','U','D','B' };
+  const uint32_t user_db_snapshot::_format_version = 1;
+  const size_t user_db_snapshot::_max_block_size = 1 << 28;
+
+  static const size_t block_header_size = 12;
+
+  static void put_uint32(std::string &str, const uint32_t &v)
+  {
+    char b[4];
+    for (int i=0; i<4; i++)
+      b[i] = (char)((v >> (8*i)) & 0xff);
+    str.append(b,4);
+  }
+
+  static void put_uint64(std::string &str, const uint64_t &v)
+  {
+    put_uint32(str,(uint32_t)(v & 0xffffffff));
+    put_uint32(str,(uint32_t)(v >> 32));
+  }
+
+  static uint32_t get_uint32(const char *b)
+  {
+    const unsigned char *ub = (const unsigned char*)b;
+    return (uint32_t)ub[0] | ((uint32_t)ub[1] << 8)
+           | ((uint32_t)ub[2] << 16) | ((uint32_t)ub[3] << 24);
+  }
+
+  static uint64_t get_uint64(const char *b)
+  {
+    return (uint64_t)get_uint32(b) | ((uint64_t)get_uint32(b+4) << 32);
+  }
+
+#ifndef FEATURE_ZLIB
+  /**
+   * \brief table of the CRC-32 of zlib, for when it is not available.
+   */
+  class crc32_table
+  {
+    public:
+      crc32_table()
+      {
+        for (uint32_t n=0; n<256; n++)
+          {
+            uint32_t c = n;
+            for (int k=0; k<8; k++)
+              c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            _t[n] = c;
+          }
+      };
+
+      uint32_t _t[256];
+  };
+
+  static crc32_table snapshot_crc32_table;
+#endif
+
+  static uint32_t snapshot_crc32(const std::string &data)
+  {
+#ifdef FEATURE_ZLIB
+    return crc32(crc32(0L,Z_NULL,0),(const Bytef*)data.data(),data.size());
+#else
+    uint32_t c = 0xffffffff;
+    for (size_t i=0; i<data.size(); i++)
+      c = snapshot_crc32_table._t[(c ^ (unsigned char)data[i]) & 0xff] ^ (c >> 8);
+    return c ^ 0xffffffff;
+#endif
+  }
+
+  static std::string block_header(const uint32_t &raw_len,
+                                  const uint32_t &stored_len,
+                                  const uint32_t &crc)
+  {
+    std::string header;
+    put_uint32(header,raw_len);
+    put_uint32(header,stored_len);
+    put_uint32(header,crc);
+    return header;
+  }
+
+  static double elapsed(const struct timeval &t1, const struct timeval &t2)
+  {
+    return (t2.tv_sec - t1.tv_sec) * 1000.0 + (t2.tv_usec - t1.tv_usec) / 1000.0;
+  }
+
+  static void destroy_blocks(std::vector<udb_snapshot_block*> &blocks)
+  {
+    for (size_t i=0; i<blocks.size(); i++)
+      delete blocks.at(i);
+    blocks.clear();
+  }
+
+  user_db_snapshot::user_db_snapshot(user_db *udb)
+    :_udb(udb),_block_size(1 << 20),_nworkers(thread_pool::nprocessors()),_level(1),
+     _pool(NULL)
+  {
+  }
+
+  user_db_snapshot::~user_db_snapshot()
+  {
+  }
+
+  void user_db_snapshot::set_limits(const size_t &block_size,
+                                    const size_t &nworkers,
+                                    const int &level)
+  {
+    _block_size = block_size > 0 ? std::min(block_size,_max_block_size) : 1;
+    _nworkers = nworkers > 0 ? nworkers : 1;
+    _level = level >= 0 ? std::min(level,9) : 0;
+  }
+
+  db_err user_db_snapshot::export_db(std::ostream &output,
+                                     const std::string &plugin_name)
+  {
+    struct timeval t1,t2;
+    gettimeofday(&t1,NULL);
+    _stats = udb_snapshot_stats();
+
+    std::string header(_magic,sizeof(_magic));
+    put_uint32(header,_format_version);
+    double version = _udb->get_version();
+    uint64_t vbits;
+    memcpy(&vbits,&version,sizeof(vbits));
+    put_uint64(header,vbits);
+    output.write(header.data(),header.size());
+    if (!output)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"Failed writing user db snapshot header");
+        return SP_ERR_FILE;
+      }
+
+    // the iterator of the db is held until the last record is read.
+    mutex_lock(&_udb->_iter_mutex);
+    if (!_udb->_hdb->dbiterinit())
+      {
+        mutex_unlock(&_udb->_iter_mutex);
+        errlog::log_error(LOG_LEVEL_ERROR,"Failed starting user db iteration for snapshot: %s",
+                          _udb->_hdb->dberrmsg(_udb->_hdb->dbecode()));
+        return DB_ERR_ITER;
+      }
+
+    std::string prefix = plugin_name.empty() ? "" : user_db::generate_rkey("",plugin_name);
+    if (_nworkers > 1)
+      _pool = new thread_pool(_nworkers);
+
+    // blocks of a round are encoded while the records of the next one are read.
+    db_err err = SP_ERR_OK;
+    bool end = false;
+    std::vector<udb_snapshot_block*> blocks,next_blocks;
+    read_blocks(blocks,prefix,end);
+    while (!blocks.empty())
+      {
+        {
+          task_group tg(_pool);
+          for (size_t i=0; i<blocks.size(); i++)
+            tg.run(&user_db_snapshot::encode,blocks.at(i));
+          if (!end)
+            read_blocks(next_blocks,prefix,end);
+          tg.wait();
+        }
+        for (size_t i=0; i<blocks.size() && err == SP_ERR_OK; i++)
+          {
+            udb_snapshot_block *b = blocks.at(i);
+            if (b->_err != SP_ERR_OK)
+              {
+                err = b->_err;
+                break;
+              }
+            output.write(b->_stored.data(),b->_stored.size());
+            if (!output)
+              {
+                errlog::log_error(LOG_LEVEL_ERROR,"Failed writing user db snapshot block");
+                err = SP_ERR_FILE;
+                break;
+              }
+            _stats._records += b->_nrecords;
+            _stats._blocks++;
+            _stats._raw_bytes += b->_raw_len;
+            _stats._stored_bytes += b->_stored.size();
+          }
+        destroy_blocks(blocks);
+        blocks.swap(next_blocks);
+        if (err != SP_ERR_OK)
+          break;
+      }
+    mutex_unlock(&_udb->_iter_mutex);
+    destroy_blocks(blocks);
+    delete _pool;
+    _pool = NULL;
+
+    if (err == SP_ERR_OK)
+      {
+        // end block, holds the number of records.
+        std::string count;
+        put_uint64(count,_stats._records);
+        std::string eblock = block_header(0,count.size(),snapshot_crc32(count)) + count;
+        output.write(eblock.data(),eblock.size());
+        output.flush();
+        if (!output)
+          {
+            errlog::log_error(LOG_LEVEL_ERROR,"Failed writing user db snapshot end block");
+            err = SP_ERR_FILE;
+          }
+      }
+
+    gettimeofday(&t2,NULL);
+    _stats._elapsed = elapsed(t1,t2);
+    if (err == SP_ERR_OK)
+      errlog::log_error(LOG_LEVEL_INFO,"Exported %u records from user db in %u blocks (%u bytes, %u stored) in %u ms",
+                        (uint32_t)_stats._records,(uint32_t)_stats._blocks,(uint32_t)_stats._raw_bytes,
+                        (uint32_t)_stats._stored_bytes,(uint32_t)_stats._elapsed);
+    return err;
+  }
+
+  void user_db_snapshot::read_blocks(std::vector<udb_snapshot_block*> &blocks,
+                                     const std::string &prefix,
+                                     bool &end)
+  {
+    while (!end && blocks.size() < _nworkers)
+      {
+        udb_snapshot_block *b = new udb_snapshot_block(this);
+        while (b->_raw.size() < _block_size)
+          {
+            int rkey_size;
+            void *rkey = _udb->_hdb->dbiternext(&rkey_size);
+            if (!rkey)
+              {
+                end = true;
+                break;
+              }
+            std::string rkey_str = std::string((char*)rkey,rkey_size);
+            free(rkey);
+            if (rkey_str == user_db::_db_version_key
+                || (!prefix.empty() && rkey_str.compare(0,prefix.size(),prefix) != 0))
+              continue;
+            int value_size;
+            void *value = _udb->_hdb->dbget(rkey_str.data(),rkey_str.size(),&value_size);
+            if (!value)
+              continue; // removed since the key was read.
+            put_uint32(b->_raw,rkey_str.size());
+            b->_raw.append(rkey_str);
+            put_uint32(b->_raw,value_size);
+            b->_raw.append((char*)value,value_size);
+            free(value);
+            b->_nrecords++;
+          }
+        if (b->_nrecords == 0)
+          {
+            delete b;
+            break;
+          }
+        blocks.push_back(b);
+      }
+  }
+
+  void* user_db_snapshot::encode(void *arg)
+  {
+    udb_snapshot_block *b = static_cast<udb_snapshot_block*>(arg);
+    b->_raw_len = b->_raw.size();
+    b->_crc = snapshot_crc32(b->_raw);
+    std::string data;
+#ifdef FEATURE_ZLIB
+    if (b->_uds->_level > 0)
+      {
+        uLongf dlen = compressBound(b->_raw.size());
+        data.resize(dlen);
+        int zerr = compress2((Bytef*)&data[0],&dlen,(const Bytef*)b->_raw.data(),
+                             b->_raw.size(),b->_uds->_level);
+        if (zerr != Z_OK)
+          {
+            errlog::log_error(LOG_LEVEL_ERROR,"Failed compressing user db snapshot block: %d",zerr);
+            b->_err = SP_ERR_COMPRESS;
+            return NULL;
+          }
+        if (dlen < b->_raw.size())
+          data.resize(dlen);
+        else data.clear(); // stored as it is.
+      }
+#endif
+    const std::string &stored = data.empty() ? b->_raw : data;
+    b->_stored = block_header(b->_raw_len,stored.size(),b->_crc);
+    b->_stored.append(stored);
+    std::string().swap(b->_raw);
+    return NULL;
+  }
+
+  db_err user_db_snapshot::import_db(std::istream &input)
+  {
+    struct timeval t1,t2;
+    gettimeofday(&t1,NULL);
+    _stats = udb_snapshot_stats();
+
+    char header[sizeof(_magic)+12];
+    input.read(header,sizeof(header));
+    if (input.gcount() != (std::streamsize)sizeof(header)
+        || memcmp(header,_magic,sizeof(_magic)) != 0)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"Not a user db snapshot");
+        return DB_ERR_SNAPSHOT;
+      }
+    uint32_t format_version = get_uint32(header+sizeof(_magic));
+    if (format_version != _format_version)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"Unsupported user db snapshot format version %u",
+                          format_version);
+        return DB_ERR_SNAPSHOT;
+      }
+    uint64_t vbits = get_uint64(header+sizeof(_magic)+4);
+    double version;
+    memcpy(&version,&vbits,sizeof(version));
+    double db_version = _udb->get_version();
+    if (db_version != 0.0 && db_version != version)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"User db snapshot of db version %g cannot be loaded into a db of version %g",
+                          version,db_version);
+        return DB_ERR_SNAPSHOT;
+      }
+
+    if (_nworkers > 1)
+      _pool = new thread_pool(_nworkers);
+
+    // blocks of a round are loaded while the blocks of the next one are read.
+    bool end = false;
+    uint64_t nrecords = 0;
+    std::vector<udb_snapshot_block*> blocks,next_blocks;
+    db_err err = read_blocks(input,blocks,end,nrecords);
+    while (err == SP_ERR_OK && !blocks.empty())
+      {
+        db_err rerr = SP_ERR_OK;
+        {
+          task_group tg(_pool);
+          for (size_t i=0; i<blocks.size(); i++)
+            tg.run(&user_db_snapshot::load,blocks.at(i));
+          if (!end)
+            rerr = read_blocks(input,next_blocks,end,nrecords);
+          tg.wait();
+        }
+        for (size_t i=0; i<blocks.size(); i++)
+          {
+            udb_snapshot_block *b = blocks.at(i);
+            if (err == SP_ERR_OK)
+              err = b->_err;
+            _stats._records += b->_nrecords;
+            _stats._blocks++;
+            _stats._raw_bytes += b->_raw_len;
+            _stats._stored_bytes += block_header_size + b->_stored.size();
+          }
+        destroy_blocks(blocks);
+        blocks.swap(next_blocks);
+        if (err == SP_ERR_OK)
+          err = rerr;
+      }
+    destroy_blocks(blocks);
+    destroy_blocks(next_blocks);
+    delete _pool;
+    _pool = NULL;
+
+    if (err == SP_ERR_OK && nrecords != _stats._records)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"User db snapshot holds %u records, %u were found",
+                          (uint32_t)nrecords,(uint32_t)_stats._records);
+        err = DB_ERR_SNAPSHOT;
+      }
+    if (err == SP_ERR_OK && db_version == 0.0)
+      err = _udb->set_version(version);
+
+    gettimeofday(&t2,NULL);
+    _stats._elapsed = elapsed(t1,t2);
+    if (err == SP_ERR_OK)
+      errlog::log_error(LOG_LEVEL_INFO,"Imported %u records into user db from %u blocks in %u ms",
+                        (uint32_t)_stats._records,(uint32_t)_stats._blocks,(uint32_t)_stats._elapsed);
+    return err;
+  }
+
+  db_err user_db_snapshot::read_blocks(std::istream &input,
+                                       std::vector<udb_snapshot_block*> &blocks,
+                                       bool &end,
+                                       uint64_t &nrecords)
+  {
+    while (!end && blocks.size() < _nworkers)
+      {
+        char header[block_header_size];
+        input.read(header,block_header_size);
+        if (input.gcount() != (std::streamsize)block_header_size)
+          {
+            errlog::log_error(LOG_LEVEL_ERROR,"Truncated user db snapshot");
+            return input.bad() ? SP_ERR_FILE : DB_ERR_SNAPSHOT;
+          }
+        uint32_t raw_len = get_uint32(header);
+        uint32_t stored_len = get_uint32(header+4);
+        uint32_t crc = get_uint32(header+8);
+        if (raw_len == 0 ? stored_len != 8
+            : (raw_len > _max_block_size || stored_len > raw_len || stored_len == 0))
+          {
+            errlog::log_error(LOG_LEVEL_ERROR,"Malformed user db snapshot block");
+            return DB_ERR_SNAPSHOT;
+          }
+        udb_snapshot_block *b = new udb_snapshot_block(this);
+        b->_raw_len = raw_len;
+        b->_crc = crc;
+        b->_stored.resize(raw_len == 0 ? 8 : stored_len);
+        input.read(&b->_stored[0],b->_stored.size());
+        if (input.gcount() != (std::streamsize)b->_stored.size())
+          {
+            delete b;
+            errlog::log_error(LOG_LEVEL_ERROR,"Truncated user db snapshot");
+            return input.bad() ? SP_ERR_FILE : DB_ERR_SNAPSHOT;
+          }
+        if (raw_len == 0)
+          {
+            // end block.
+            bool valid = snapshot_crc32(b->_stored) == crc;
+            nrecords = get_uint64(b->_stored.data());
+            delete b;
+            if (!valid)
+              {
+                errlog::log_error(LOG_LEVEL_ERROR,"Corrupted user db snapshot end block");
+                return DB_ERR_SNAPSHOT;
+              }
+            end = true;
+            break;
+          }
+        blocks.push_back(b);
+      }
+    return SP_ERR_OK;
+  }
+
+  void* user_db_snapshot::load(void *arg)
+  {
+    udb_snapshot_block *b = static_cast<udb_snapshot_block*>(arg);
+    std::string data;
+    const std::string *raw = &b->_stored;
+    if (b->_stored.size() != b->_raw_len)
+      {
+#ifdef FEATURE_ZLIB
+        data.resize(b->_raw_len);
+        uLongf dlen = b->_raw_len;
+        int zerr = uncompress((Bytef*)&data[0],&dlen,(const Bytef*)b->_stored.data(),
+                              b->_stored.size());
+        if (zerr != Z_OK || dlen != b->_raw_len)
+          {
+            errlog::log_error(LOG_LEVEL_ERROR,"Failed decompressing user db snapshot block: %d",zerr);
+            b->_err = SP_ERR_COMPRESS;
+            return NULL;
+          }
+        raw = &data;
+#else
+        errlog::log_error(LOG_LEVEL_ERROR,"Compressed user db snapshot block, and no zlib support");
+        b->_err = SP_ERR_COMPRESS;
+        return NULL;
+#endif
+      }
+    if (snapshot_crc32(*raw) != b->_crc)
+      {
+        errlog::log_error(LOG_LEVEL_ERROR,"Corrupted user db snapshot block");
+        b->_err = DB_ERR_SNAPSHOT;
+        return NULL;
+      }
+
+    // records are checked before any of them is put.
+    const char *p = raw->data();
+    size_t len = raw->size();
+    size_t pos = 0;
+    while (pos < len)
+      {
+        for (int f=0; f<2; f++) // key and value.
+          {
+            if (len - pos < 4 || len - pos - 4 < get_uint32(p+pos))
+              {
+                errlog::log_error(LOG_LEVEL_ERROR,"Malformed user db snapshot block");
+                b->_err = DB_ERR_SNAPSHOT;
+                return NULL;
+              }
+            pos += 4 + get_uint32(p+pos);
+          }
+      }
+
+    db_obj *hdb = b->_uds->_udb->_hdb;
+    pos = 0;
+    while (pos < len)
+      {
+        uint32_t ksize = get_uint32(p+pos);
+        const char *key = p+pos+4;
+        pos += 4 + ksize;
+        uint32_t vsize = get_uint32(p+pos);
+        const char *value = p+pos+4;
+        pos += 4 + vsize;
+        if (!hdb->dbput(key,ksize,value,vsize))
+          {
+            errlog::log_error(LOG_LEVEL_ERROR,"Failed putting snapshot record into user db: %s",
+                              hdb->dberrmsg(hdb->dbecode()));
+            b->_err = DB_ERR_PUT;
+            return NULL;
+          }
+        b->_nrecords++;
+      }
+    return NULL;
+  }
+
+} /* end of namespace. */
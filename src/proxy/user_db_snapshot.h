@@ -0,0 +1,161 @@
+/**
+ * The Seeks proxy and plugin framework are part of the SEEKS project.
+ * Copyright (C) 2012 Emmanuel Benazera, ebenazer@seeks-project.info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USER_DB_SNAPSHOT_H
+#define USER_DB_SNAPSHOT_H
+
+#include "user_db.h"
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+
+namespace sp
+{
+  class thread_pool;
+  class udb_snapshot_block;
+
+  /**
+   * \brief counters of a snapshot export or import.
+   */
+  class udb_snapshot_stats
+  {
+    public:
+      udb_snapshot_stats()
+        :_records(0),_blocks(0),_raw_bytes(0),_stored_bytes(0),_elapsed(0.0)
+      {};
+
+      ~udb_snapshot_stats() {};
+
+      uint64_t _records; /**< records written or loaded. */
+      uint64_t _blocks; /**< data blocks written or loaded. */
+      uint64_t _raw_bytes; /**< size of keys and values, with their lengths. */
+      uint64_t _stored_bytes; /**< size of the blocks in the snapshot, with their headers. */
+      double _elapsed; /**< in milliseconds. */
+  };
+
+  /**
+   * \brief binary snapshots of the records of a user db, for backups and
+   *        for moving records between nodes.
+   *
+   *        A snapshot is a stream of:
+   *        - a header: the magic "SEEKSUDB", the format version (4 bytes)
+   *          and the db version (8 bytes, the bits of the double);
+   *        - blocks: the raw data length, the stored data length and the
+   *          CRC-32 of the raw data (4 bytes each), then the stored data.
+   *          Data are zlib-compressed unless both lengths are equal. Raw data
+   *          are a sequence of records, each one the key length (4 bytes),
+   *          the key, the value length (4 bytes) and the value, as found in
+   *          the db;
+   *        - an end block of raw length 0 whose data is the number of
+   *          records in the snapshot (8 bytes).
+   *        Integers are little-endian. The db version record is not part of
+   *        the blocks.
+   *
+   *        Records are read by a single iterator, while blocks are compressed
+   *        and checksummed in parallel and written in order. On import, blocks
+   *        are read in order and checked, decompressed and put into the db in
+   *        parallel. Records are put as they are, without merging with the
+   *        records of the db that have the same keys, which they replace.
+   *        At most two rounds of one block per worker are held in memory.
+   */
+  class user_db_snapshot
+  {
+    public:
+      user_db_snapshot(user_db *udb);
+
+      ~user_db_snapshot();
+
+      /**
+       * \brief sets the size of raw data per block, the number of threads
+       *        that encode or load blocks, and the zlib compression level,
+       *        0 for no compression.
+       */
+      void set_limits(const size_t &block_size,
+                      const size_t &nworkers,
+                      const int &level);
+
+      /**
+       * \brief writes the records of the db to output, only the records of
+       *        plugin plugin_name if not empty.
+       * @return SP_ERR_OK if no error, SP_ERR_FILE on write error,
+       *         SP_ERR_COMPRESS on compression error.
+       */
+      db_err export_db(std::ostream &output,
+                       const std::string &plugin_name="");
+
+      /**
+       * \brief loads the records of a snapshot into the db. An empty db gets
+       *        the version of the snapshot. On error, the records of the blocks
+       *        loaded so far are left in the db.
+       * @return SP_ERR_OK if no error, DB_ERR_SNAPSHOT if the snapshot is
+       *         malformed, corrupted or of a db version that is not the one
+       *         of the db, SP_ERR_FILE on read error, SP_ERR_COMPRESS on
+       *         decompression error, DB_ERR_PUT if a record could not be
+       *         put into the db.
+       */
+      db_err import_db(std::istream &input);
+
+      const udb_snapshot_stats& get_stats() const
+      {
+        return _stats;
+      };
+
+      static const char _magic[8];
+      static const uint32_t _format_version;
+      static const size_t _max_block_size; /**< upper bound on the raw data of a block on import. */
+
+    private:
+      user_db_snapshot(const user_db_snapshot &uds); // not copyable.
+      user_db_snapshot& operator=(const user_db_snapshot &uds);
+
+      /**
+       * \brief reads records from the db into up to one block per worker.
+       */
+      void read_blocks(std::vector<udb_snapshot_block*> &blocks,
+                       const std::string &prefix,
+                       bool &end);
+
+      /**
+       * \brief reads up to one block per worker from input.
+       * @return SP_ERR_OK if no error, end is set when the end block is read.
+       */
+      db_err read_blocks(std::istream &input,
+                         std::vector<udb_snapshot_block*> &blocks,
+                         bool &end,
+                         uint64_t &nrecords);
+
+      static void* encode(void *arg);
+
+      static void* load(void *arg);
+
+    public:
+      user_db *_udb;
+
+    private:
+      size_t _block_size;
+      size_t _nworkers;
+      int _level;
+      thread_pool *_pool; /**< NULL when there is a single worker. */
+      udb_snapshot_stats _stats;
+  };
+
+} /* end of namespace. */
+
+#endif